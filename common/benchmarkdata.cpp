@@ -0,0 +1,98 @@
+#include "benchmarkdata.h"
+
+#include <QFile>
+
+#include <math.h>
+
+//---------------------------------------
+// concentric shells around the centre with a little noise,
+// stored depth, width, height with height varying fastest and
+// scaled to the full range of the voxel type (0-1 for float)
+//---------------------------------------
+uchar*
+BenchmarkData::syntheticVolume(int voxelType, int n)
+{
+  int bpv = 1;
+  if (voxelType == _UShort) bpv = 2;
+  if (voxelType == _Float) bpv = 4;
+  uchar *vol = new uchar[(qint64)bpv*n*n*n];
+
+  float c = 0.5f*(n-1);
+  uint seed = 1;
+  qint64 idx = 0;
+  for(int k=0; k<n; k++)
+    for(int j=0; j<n; j++)
+      for(int i=0; i<n; i++)
+	{
+	  float r = sqrtf((k-c)*(k-c) + (j-c)*(j-c) + (i-c)*(i-c))/c;
+	  float v = 0;
+	  if (r < 1)
+	    v = 0.5f + 0.5f*cosf(3.0f*3.14159265f*r);
+
+	  seed = seed*1103515245 + 12345;
+	  v += 0.04f*(((seed>>16)&0xff)/255.0f - 0.5f);
+	  v = qBound(0.0f, v, 1.0f);
+
+	  if (voxelType == _UShort)
+	    ((ushort*)vol)[idx] = v*65535;
+	  else if (voxelType == _Float)
+	    ((float*)vol)[idx] = v;
+	  else
+	    vol[idx] = v*255;
+	  idx++;
+	}
+
+  return vol;
+}
+
+//---------------------------------------
+// same header and file naming as VolumeFileManager::createFile,
+// written directly so that no progress dialog is shown
+//---------------------------------------
+void
+BenchmarkData::writeVolume(QString baseFilename, int voxelType,
+			   int n, int slabSize, uchar *vol)
+{
+  uchar vt = (voxelType == _UShort) ? 2 : 0;
+  int bpv = (voxelType == _UShort) ? 2 : 1;
+  qint64 bps = (qint64)bpv*n*n;
+
+  int nslabs = n/slabSize;
+  if (nslabs*slabSize < n) nslabs++;
+
+  for(int ns=0; ns<nslabs; ns++)
+    {
+      QFile qfile(baseFilename +
+		  QString(".%1").arg(ns+1, 3, 10, QChar('0')));
+      qfile.open(QFile::WriteOnly);
+
+      int nslices = qMin(slabSize, n-ns*slabSize);
+      qfile.write((char*)&vt, 1);
+      qfile.write((char*)&nslices, 4);
+      qfile.write((char*)&n, 4);
+      qfile.write((char*)&n, 4);
+      qfile.write((char*)(vol + ns*slabSize*bps), nslices*bps);
+      qfile.close();
+    }
+}
+
+void
+BenchmarkData::report(QTextStream &out,
+		      QString name, QString type, int n,
+		      qint64 nsecs, qint64 bytes,
+		      qint64 items, QString unit)
+{
+  double secs = qMax((qint64)1, nsecs)*1e-9;
+
+  out << QString("%1 %2 %3^3 %4 ms").			\
+    arg(name, -16).arg(type, -6).arg(n, 4).		\
+    arg(secs*1000, 10, 'f', 2);
+
+  if (bytes > 0)
+    out << QString(" %1 MB/s").arg(bytes/secs/(1024*1024), 10, 'f', 1);
+  else
+    out << QString(" %1     ").arg("-", 10);
+
+  out << QString(" %1 M%2/s\n").arg(items/secs*1e-6, 10, 'f', 2).arg(unit);
+  out.flush();
+}
@@ -0,0 +1,31 @@
+#ifndef BENCHMARKDATA_H
+#define BENCHMARKDATA_H
+
+#include <QString>
+#include <QTextStream>
+
+//---------------------------------------
+// synthetic volumes, volume files and timing lines shared by the
+// --benchmark modes of drishti, drishtiimport and drishtipaint.
+// voxel types are numbered as in VolumeFileManager and Raw2Pvl.
+//---------------------------------------
+class BenchmarkData
+{
+ public :
+  enum VoxelType
+  {
+    _UChar = 0,
+    _UShort = 2,
+    _Float = 5
+  };
+
+  static uchar* syntheticVolume(int, int);
+  static void writeVolume(QString, int, int, int, uchar*);
+
+  // name, type, size, nsecs, bytes, items, unit of the items.
+  // bytes 0 : no throughput in MB/s
+  static void report(QTextStream&, QString, QString, int,
+		     qint64, qint64, qint64, QString unit="voxels");
+};
+
+#endif
@@ -0,0 +1,314 @@
+#include "benchmark.h"
+#include "benchmarkdata.h"
+#include "timestepcache.h"
+#include "pruneengine.h"
+
+#include <QDir>
+#include <QElapsedTimer>
+
+#include <math.h>
+#include <string.h>
+
+int
+Benchmark::run(QStringList args)
+{
+  QList<int> sizes;
+  for(int i=0; i<args.count(); i++)
+    {
+      bool ok;
+      int n = args[i].toInt(&ok);
+      if (ok && n >= 8)
+	sizes << n;
+    }
+  if (sizes.count() == 0)
+    sizes << 64 << 128 << 256;
+
+  QTextStream out(stdout);
+
+  int failed = 0;
+  for(int s=0; s<sizes.count(); s++)
+    {
+      failed += sliceTextureSlab(out, VolumeFileManager::_UChar, sizes[s]);
+      failed += sliceTextureSlab(out, VolumeFileManager::_UShort, sizes[s]);
+    }
+
+  for(int s=0; s<sizes.count(); s++)
+    failed += pruneOperations(out, sizes[s]);
+
+  return (failed > 0 ? 1 : 0);
+}
+
+int
+Benchmark::sliceTextureSlab(QTextStream &out, int voxelType, int n)
+{
+  int bpv = (voxelType == VolumeFileManager::_UShort) ? 2 : 1;
+  QString type = (bpv == 1) ? "uchar" : "ushort";
+  qint64 bps = (qint64)bpv*n*n;
+
+  // two slabs so that switching between files is part of the timing
+  int slabSize = qMax(1, (n+1)/2);
+  QString baseFilename = QDir(QDir::tempPath()).
+                           filePath(QString("drishti-benchmark-%1").arg(n));
+  uchar *vol = BenchmarkData::syntheticVolume(voxelType, n);
+  BenchmarkData::writeVolume(baseFilename, voxelType, n, slabSize, vol);
+
+  VolumeFileManager vfm;
+  vfm.setBaseFilename(baseFilename);
+  vfm.setDepth(n);
+  vfm.setWidth(n);
+  vfm.setHeight(n);
+  vfm.setHeaderSize(13);
+  vfm.setSlabSize(slabSize);
+  vfm.setVoxelType(voxelType);
+
+  //-------- whole volume in one slab with the extra
+  //-------- slice at the top and bottom
+  SlabLayout sl;
+  sl.bpv = bpv;
+  sl.subsamplingLevel = 1;
+  sl.dataMin = Vec(0, 0, 0);
+  sl.dataMax = Vec(n-1, n-1, n-1);
+  sl.subvolumeSize = Vec(n, n, n);
+  sl.maxHeight = sl.maxWidth = sl.maxDepth = n;
+  sl.texColumns = ceil(sqrt((float)(n+2)));
+  sl.texRows = (n+2)/sl.texColumns + 1;
+  sl.texWidth = sl.texColumns*n;
+  sl.texHeight = sl.texRows*n;
+
+  int dtlod = 2;
+  int dtsz = n/dtlod;
+  int dtncols = ceil(sqrt((float)dtsz));
+  int dtnrows = dtsz/dtncols + 1;
+  sl.dragTextureInfo = Vec(dtncols, dtnrows, dtlod);
+  sl.dragTexWidth = dtncols*dtsz;
+  sl.dragTexHeight = dtnrows*dtsz;
+
+  uchar *sliceTexture = new uchar[bpv*sl.texWidth*sl.texHeight];
+  uchar *dragTexture = new uchar[bpv*sl.dragTexWidth*sl.dragTexHeight];
+  float *hist1D = new float[256];
+  float *hist2D = new float[256*256];
+  memset(hist1D, 0, 256*sizeof(float));
+  memset(hist2D, 0, 256*256*sizeof(float));
+
+  QElapsedTimer timer;
+
+  //-------- slices on their own
+  timer.start();
+  for(int d=0; d<n; d++)
+    vfm.getSlice(d);
+  BenchmarkData::report(out, "getSlice", type, n, timer.nsecsElapsed(),
+			n*bps, (qint64)n*n*n);
+
+  timer.start();
+  bool ok = TimestepCache::buildSlab(sl, &vfm,
+				     n, n, n,
+				     0, n-1,
+				     sliceTexture, dragTexture,
+				     hist1D, hist2D);
+  BenchmarkData::report(out, "sliceTextureSlab", type, n, timer.nsecsElapsed(),
+			n*bps, (qint64)n*n*n);
+
+  //-------- middle slice should be packed unchanged
+  int failed = 0;
+  int k = n/2;
+  int col = (k+1)%sl.texColumns;
+  int row = (k+1)/sl.texColumns;
+  for(int j=0; j<n; j++)
+    if (memcmp(sliceTexture + bpv*((row*n + j)*sl.texWidth + col*n),
+	       vol + k*bps + bpv*j*n, bpv*n) != 0)
+      failed++;
+
+  if (!ok || failed > 0)
+    out << QString("  %1 : slab layout %2, %3 rows differ\n").	\
+      arg(baseFilename).arg(ok ? "ok" : "failed").arg(failed);
+
+  vfm.removeFile();
+  delete [] sliceTexture;
+  delete [] dragTexture;
+  delete [] hist1D;
+  delete [] hist2D;
+  delete [] vol;
+
+  return (!ok || failed > 0 ? 1 : 0);
+}
+
+//---------------------------------------
+// shader passes of PruneShaderFactory on the cpu - dilate, erode,
+// shrink (erode of channel 0 outside the mask channel moff) and
+// thicken.  one pass over all voxels with clamped lookups, reading
+// the buffer as it was before the pass.
+//---------------------------------------
+enum { ShaderDilate, ShaderErode, ShaderThicken };
+
+static void
+shaderPass(int type, uchar *buf, const int *grid,
+	   int off, int moff, bool cityBlock)
+{
+  int gridx = grid[0];
+  int gridy = grid[1];
+  int gridz = grid[2];
+  int ncols = grid[3];
+  int dtexX = grid[4];
+  int dtexY = grid[5];
+
+  uchar *src = new uchar[4*dtexX*dtexY];
+  memcpy(src, buf, 4*dtexX*dtexY);
+
+  for(int z=0; z<gridz; z++)
+    for(int y=0; y<gridy; y++)
+      for(int x=0; x<gridx; x++)
+	{
+	  int t = ((z/ncols)*gridy + y)*dtexX + (z%ncols)*gridx + x;
+	  int val = src[4*t+off];
+	  if (type == ShaderDilate && val > 0) continue;
+	  if (type == ShaderErode && val == 0) continue;
+	  if (type == ShaderErode && moff >= 0 && src[4*t+moff] > 0) continue;
+	  if (type == ShaderThicken && val > 0) continue;
+
+	  int m = 0;
+	  int nzero = 0;
+	  for(int i=-1; i<=1; i++)
+	    for(int j=-1; j<=1; j++)
+	      for(int k=-1; k<=1; k++)
+		{
+		  bool edge = (i==0 || j==0 || k==0);
+		  if (type == ShaderThicken && !cityBlock)
+		    edge = !(i==0 && j==0 && k==0);
+		  if (!edge)
+		    continue;
+		  int x1 = qBound(0, x+i, gridx-1);
+		  int y1 = qBound(0, y+j, gridy-1);
+		  int z1 = qBound(0, z+k, gridz-1);
+		  int t1 = ((z1/ncols)*gridy + y1)*dtexX + (z1%ncols)*gridx + x1;
+		  m = qMax(m, (int)src[4*t1+off]);
+		  nzero += (src[4*t1+off] == 0);
+		}
+
+	  if (type == ShaderDilate)
+	    buf[4*t+off] = m;
+	  else if (type == ShaderErode)
+	    {
+	      if (nzero > 1)
+		buf[4*t+off] = 0;
+	    }
+	  else
+	    {
+	      // t-1.2/255 written to an 8 bit texture
+	      buf[4*t+off] = qMax(0, m-1);
+	      buf[4*t+3] = 255;
+	    }
+	}
+
+  delete [] src;
+}
+
+//---------------------------------------
+// PruneEngine operations against the shader passes on an atlas of
+// the synthetic volume - channel 0 holds the shells, channel 1 the
+// brighter shells as the shrink mask.  the shader passes are slow
+// on the cpu, so at most 64^3 voxels are compared.  every operation
+// is compared for 4 and for 20 passes.
+//---------------------------------------
+int
+Benchmark::pruneOperations(QTextStream &out, int n)
+{
+  n = qMin(n, 64);
+
+  uchar *vol = BenchmarkData::syntheticVolume(VolumeFileManager::_UChar, n);
+
+  int grid[6];
+  grid[0] = grid[1] = grid[2] = n;
+  grid[3] = ceil(sqrt((float)n));
+  grid[4] = grid[3]*n;
+  grid[5] = (n/grid[3] + 1)*n;
+  qint64 ntex = (qint64)grid[4]*grid[5];
+
+  uchar *buf = new uchar[4*ntex];
+  memset(buf, 0, 4*ntex);
+  for(int z=0; z<n; z++)
+    for(int y=0; y<n; y++)
+      for(int x=0; x<n; x++)
+	{
+	  int t = ((z/grid[3])*n + y)*grid[4] + (z%grid[3])*n + x;
+	  uchar v = vol[((qint64)z*n + y)*n + x];
+	  buf[4*t+2] = (v > 100 ? v : 0);
+	  buf[4*t+1] = (v > 160 ? 255 : 0);
+	}
+
+  PruneEngine engine;
+  engine.setGrid(grid[0], grid[1], grid[2], grid[3], grid[4], grid[5]);
+
+  uchar *cpu = new uchar[4*ntex];
+  uchar *gpu = new uchar[4*ntex];
+  QElapsedTimer timer;
+
+  QStringList names;
+  names << "prune dilate" << "prune erode" << "prune shrink"
+	<< "prune thicken" << "prune thicken26"
+	<< "prune distance" << "prune distance26";
+
+  int failed = 0;
+  int sizes[2] = { 4, 20 };
+  for(int s=0; s<2; s++)
+  for(int op=0; op<names.count(); op++)
+    {
+      int sz = sizes[s];
+      QString name = QString("%1 %2").arg(names[op]).arg(sz);
+      memcpy(cpu, buf, 4*ntex);
+      memcpy(gpu, buf, 4*ntex);
+      bool cityBlock = (op != 4 && op != 6);
+
+      // the distance transform thickens the inverted channel 0
+      if (op >= 5)
+	for(qint64 i=0; i<ntex; i++)
+	  {
+	    if (cpu[4*i+2] > 0)
+	      cpu[4*i+2] = gpu[4*i+2] = 255;
+	    gpu[4*i+2] = 255 - gpu[4*i+2];
+	  }
+
+      timer.start();
+      if (op == 0) engine.dilate(cpu, sz, 0);
+      else if (op == 1) engine.erode(cpu, sz, 0);
+      else if (op == 2) engine.shrink(cpu, sz, 1);
+      else if (op <= 4) engine.thicken(cpu, sz, cityBlock);
+      else engine.distanceTransform(cpu, sz, cityBlock);
+      BenchmarkData::report(out, name, "uchar", n, timer.nsecsElapsed(),
+			    4*ntex, (qint64)n*n*n);
+
+      for(int ne=0; ne<sz; ne++)
+	{
+	  if (op == 0) shaderPass(ShaderDilate, gpu, grid, 2, -1, true);
+	  else if (op == 1) shaderPass(ShaderErode, gpu, grid, 2, -1, true);
+	  else if (op == 2) shaderPass(ShaderErode, gpu, grid, 2, 1, true);
+	  else shaderPass(ShaderThicken, gpu, grid, 2, -1, cityBlock);
+	}
+
+      if (op >= 5)
+	for(qint64 i=0; i<ntex; i++)
+	  gpu[4*i+2] = 255 - gpu[4*i+2];
+
+      // padding texels outside the grid are not compared
+      int nbad = 0;
+      for(int z=0; z<n; z++)
+	for(int y=0; y<n; y++)
+	  {
+	    int t = ((z/grid[3])*n + y)*grid[4] + (z%grid[3])*n;
+	    if (memcmp(cpu + 4*t, gpu + 4*t, 4*n) != 0)
+	      nbad++;
+	  }
+      if (nbad > 0)
+	{
+	  out << QString("  %1 : %2 rows differ from the shader passes\n"). \
+	    arg(name).arg(nbad);
+	  failed = 1;
+	}
+    }
+
+  delete [] cpu;
+  delete [] gpu;
+  delete [] buf;
+  delete [] vol;
+
+  return failed;
+}
@@ -0,0 +1,28 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <QStringList>
+#include <QTextStream>
+
+//---------------------------------------
+// drishti --benchmark [size ...]
+// times reading slices from the pvl slabs and packing them into the
+// slice texture, drag texture and histograms (the work done by
+// VolumeSingle::getSliceTextureSlab) for synthetic size^3 volumes,
+// and the cpu morphological operations of PruneEngine, checked
+// against the shader passes of PruneShaderFactory evaluated one
+// pass at a time on the cpu.
+// runs before the main window and gl context are created, one line
+// is printed per case.
+//---------------------------------------
+class Benchmark
+{
+ public :
+  static int run(QStringList);
+
+ private :
+  static int sliceTextureSlab(QTextStream&, int, int);
+  static int pruneOperations(QTextStream&, int);
+};
+
+#endif
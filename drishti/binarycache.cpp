@@ -0,0 +1,110 @@
+#include "binarycache.h"
+#include "global.h"
+
+#include <QDir>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QCryptographicHash>
+
+QString
+BinaryCache::cacheFile(QString flnm, QString ext)
+{
+  if (Global::cacheDir().isEmpty())
+    return QString();
+
+  QFileInfo src(flnm);
+  QByteArray key = QCryptographicHash::hash(src.absoluteFilePath().toUtf8(),
+					    QCryptographicHash::Md5).toHex();
+
+  return QDir(Global::cacheDir()).filePath(QString("%1-%2.%3").	\
+					    arg(src.fileName()).	\
+					    arg(QString(key.left(12))).	\
+					    arg(ext));
+}
+
+uchar*
+BinaryCache::map(QFile &fd, QString flnm, QString ext,
+		 const char *magic, qint64 &size)
+{
+  QString cflnm = cacheFile(flnm, ext);
+  if (cflnm.isEmpty())
+    return 0;
+
+  QFileInfo src(flnm);
+  fd.setFileName(cflnm);
+  if (!src.exists() || !fd.exists() || !fd.open(QFile::ReadOnly))
+    return 0;
+
+  qint64 fsize = fd.size();
+  if (fsize < headerSize)
+    {
+      fd.close();
+      return 0;
+    }
+
+  uchar *data = fd.map(0, fsize);
+  if (!data)
+    {
+      fd.close();
+      return 0;
+    }
+
+  qint64 srcSize, srcTime;
+  memcpy(&srcSize, data+4, 8);
+  memcpy(&srcTime, data+12, 8);
+
+  if (memcmp(data, magic, 4) != 0 ||
+      srcSize != src.size() ||
+      srcTime != src.lastModified().toMSecsSinceEpoch())
+    {
+      fd.unmap(data);
+      fd.close();
+      return 0;
+    }
+
+  size = fsize - headerSize;
+  return data + headerSize;
+}
+
+void
+BinaryCache::unmap(QFile &fd, uchar *data)
+{
+  if (data)
+    fd.unmap(data - headerSize);
+  fd.close();
+}
+
+bool
+BinaryCache::create(QFile &fd, QString flnm, QString ext,
+		    const char *magic)
+{
+  QFileInfo src(flnm);
+  if (src.size() <= minSourceSize)
+    return false;
+
+  QString cflnm = cacheFile(flnm, ext);
+  if (cflnm.isEmpty() || !QDir().mkpath(QFileInfo(cflnm).absolutePath()))
+    return false;
+
+  fd.setFileName(cflnm);
+  if (!fd.open(QFile::WriteOnly | QFile::Truncate))
+    return false;
+
+  qint64 srcSize = src.size();
+  qint64 srcTime = src.lastModified().toMSecsSinceEpoch();
+  fd.write(magic, 4);
+  fd.write((char*)&srcSize, 8);
+  fd.write((char*)&srcTime, 8);
+
+  return true;
+}
+
+bool
+BinaryCache::finish(QFile &fd, bool ok)
+{
+  fd.close();
+  if (!ok)
+    fd.remove();
+
+  return ok;
+}
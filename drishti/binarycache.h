@@ -0,0 +1,38 @@
+#ifndef BINARYCACHE_H
+#define BINARYCACHE_H
+
+#include <QFile>
+#include <QString>
+
+//---------------------------------------
+// binary caches of decoded meshes, paths and networks.
+// caches are written to the directory set with the cachedir
+// command, named after the full path of the source; nothing is
+// cached when no cache directory is set (the default).
+// every cache starts with a 4 byte magic and the size and
+// modification time of the source, and is ignored once
+// either of them changes.  only sources larger than
+// minSourceSize are cached.
+//---------------------------------------
+class BinaryCache
+{
+ public :
+  static const int headerSize = 4 + 2*8;
+  static const qint64 minSourceSize = 16*1024*1024;
+
+  static QString cacheFile(QString, QString);
+
+  // maps a valid cache and returns the data that follows the
+  // header together with its size, 0 when there is none
+  static uchar* map(QFile&, QString, QString, const char*, qint64&);
+  // takes the pointer returned by map
+  static void unmap(QFile&, uchar*);
+
+  // creates the cache and writes the header, false when the
+  // source is not cached
+  static bool create(QFile&, QString, QString, const char*);
+  // closes the cache, an incomplete one is removed
+  static bool finish(QFile&, bool);
+};
+
+#endif
@@ -0,0 +1,234 @@
+#include "blobstore.h"
+
+#include <QFile>
+#include <QCryptographicHash>
+
+#include <stdio.h>
+#include <string.h>
+
+QHash<QByteArray, BlobStore::Blob*> BlobStore::m_blobs;
+
+void
+BlobStore::clear()
+{
+  QHash<QByteArray, Blob*>::iterator it;
+  for(it=m_blobs.begin(); it!=m_blobs.end(); it++)
+    delete it.value();
+  m_blobs.clear();
+}
+
+BlobStore::Blob*
+BlobStore::entry(QByteArray key)
+{
+  Blob *blob = m_blobs.value(key, 0);
+  if (!blob)
+    {
+      blob = new Blob;
+      blob->refs = 0;
+      blob->offset = 0;
+      blob->size = 0;
+      m_blobs[key] = blob;
+    }
+  return blob;
+}
+
+QByteArray
+BlobStore::insert(QByteArray data)
+{
+  QByteArray key = QCryptographicHash::hash(data, QCryptographicHash::Sha1);
+
+  Blob *blob = entry(key);
+
+  // shares the buffer with the caller, no copy is made
+  if (blob->data.isEmpty())
+    blob->data = data;
+
+  blob->refs++;
+
+  return key;
+}
+
+void
+BlobStore::addRef(QByteArray key)
+{
+  if (key.isEmpty())
+    return;
+
+  entry(key)->refs++;
+}
+
+void
+BlobStore::release(QByteArray key)
+{
+  if (key.isEmpty())
+    return;
+
+  // unreferenced blobs are dropped by purge(), a project being
+  // loaded may still refer to them after the old keyframes go
+  Blob *blob = m_blobs.value(key, 0);
+  if (blob && blob->refs > 0)
+    blob->refs--;
+}
+
+bool
+BlobStore::fetchPacked(Blob *blob)
+{
+  if (!blob->packed.isEmpty())
+    return true;
+
+  if (blob->file.isEmpty() || blob->size <= 0)
+    return false;
+
+  QFile fin(blob->file);
+  if (!fin.open(QFile::ReadOnly))
+    return false;
+
+  fin.seek(blob->offset);
+  blob->packed = fin.read(blob->size);
+  fin.close();
+
+  return (blob->packed.size() == blob->size);
+}
+
+QByteArray
+BlobStore::data(QByteArray key)
+{
+  Blob *blob = m_blobs.value(key, 0);
+  if (!blob)
+    return QByteArray();
+
+  if (blob->data.isEmpty() && fetchPacked(blob))
+    blob->data = qUncompress(blob->packed);
+
+  return blob->data;
+}
+
+bool
+BlobStore::fetchAll()
+{
+  purge();
+
+  bool ok = true;
+  QHash<QByteArray, Blob*>::iterator it;
+  for(it=m_blobs.begin(); it!=m_blobs.end(); it++)
+    {
+      Blob *blob = it.value();
+      if (blob->data.isEmpty() && !fetchPacked(blob))
+	{
+	  blob->packed.clear();
+	  ok = false;
+	  continue;
+	}
+      blob->file.clear();
+    }
+
+  return ok;
+}
+
+void
+BlobStore::save(fstream &fout)
+{
+  char keyword[100];
+
+  memset(keyword, 0, 100);
+  sprintf(keyword, "blobs");
+  fout.write((char*)keyword, strlen(keyword)+1);
+
+  QList<QByteArray> keys;
+  QHash<QByteArray, Blob*>::iterator it;
+  for(it=m_blobs.begin(); it!=m_blobs.end(); it++)
+    {
+      Blob *blob = it.value();
+      if (blob->packed.isEmpty() && !blob->data.isEmpty())
+	blob->packed = qCompress(blob->data);
+      if (!blob->packed.isEmpty())
+	keys << it.key();
+    }
+
+  int n = keys.count();
+  fout.write((char*)&n, sizeof(int));
+  for(int i=0; i<n; i++)
+    {
+      Blob *blob = m_blobs[keys[i]];
+
+      int klen = keys[i].size();
+      fout.write((char*)&klen, sizeof(int));
+      fout.write(keys[i].constData(), klen);
+
+      int size = blob->packed.size();
+      fout.write((char*)&size, sizeof(int));
+      fout.write(blob->packed.constData(), size);
+    }
+}
+
+void
+BlobStore::load(fstream &fin, QString flnm)
+{
+  int n;
+  fin.read((char*)&n, sizeof(int));
+  for(int i=0; i<n; i++)
+    {
+      int klen;
+      fin.read((char*)&klen, sizeof(int));
+      QByteArray key(klen, 0);
+      fin.read(key.data(), klen);
+
+      int size;
+      fin.read((char*)&size, sizeof(int));
+      qint64 offset = fin.tellg();
+      fin.seekg(size, ios::cur);
+
+      // contents are read when first asked for
+      Blob *blob = entry(key);
+      if (blob->data.isEmpty() && blob->packed.isEmpty())
+	{
+	  blob->file = flnm;
+	  blob->offset = offset;
+	  blob->size = size;
+	}
+    }
+}
+
+void
+BlobStore::purge()
+{
+  QList<QByteArray> keys = m_blobs.keys();
+  for(int i=0; i<keys.count(); i++)
+    {
+      Blob *blob = m_blobs[keys[i]];
+      if (blob->refs <= 0)
+	{
+	  m_blobs.remove(keys[i]);
+	  delete blob;
+	}
+    }
+}
+
+QString
+BlobStore::statistics()
+{
+  int resident = 0;
+  qint64 bytes = 0;
+  qint64 packed = 0;
+  int refs = 0;
+  QHash<QByteArray, Blob*>::iterator it;
+  for(it=m_blobs.begin(); it!=m_blobs.end(); it++)
+    {
+      Blob *blob = it.value();
+      refs += blob->refs;
+      if (!blob->data.isEmpty())
+	{
+	  resident++;
+	  bytes += blob->data.size();
+	}
+      packed += qMax(blob->packed.size(), blob->size);
+    }
+
+  QString str;
+  str += QString("Blobs : %1 (%2 references)\n").arg(m_blobs.count()).arg(refs);
+  str += QString("In memory : %1 blobs, %2 Mb\n").\
+    arg(resident).arg((float)bytes/(1024*1024), 0, 'f', 1);
+  str += QString("Compressed : %1 Mb").arg((float)packed/(1024*1024), 0, 'f', 1);
+
+  return str;
+}
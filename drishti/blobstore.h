@@ -0,0 +1,64 @@
+#ifndef BLOBSTORE_H
+#define BLOBSTORE_H
+
+#include <QHash>
+#include <QByteArray>
+#include <QString>
+
+#include <fstream>
+using namespace std;
+
+//---------------------------------------
+// shared store for large keyframe buffers (lookup tables,
+// prune buffers, thumbnails).  blobs are keyed by a hash of
+// their contents so identical buffers are written only once,
+// compressed, ahead of the keyframes in the .keyframes file.
+// blobs read from a project stay on disk until someone asks
+// for them.  keyframes holding a key keep a reference, blobs
+// nobody refers to are dropped when a project is loaded or saved.
+//---------------------------------------
+class BlobStore
+{
+ public :
+  static void clear();
+
+  // returns key for data, adds a reference
+  static QByteArray insert(QByteArray);
+
+  static void addRef(QByteArray);
+  static void release(QByteArray);
+
+  // contents of blob, read from the project file on first use
+  static QByteArray data(QByteArray);
+
+  // pull in all blobs still on disk, the project
+  // file is about to be overwritten.  false when
+  // some could not be read - they stay on disk
+  static bool fetchAll();
+
+  static void save(fstream&);
+  static void load(fstream&, QString);
+
+  // drop blobs nobody refers to
+  static void purge();
+
+  static QString statistics();
+
+ private :
+  struct Blob
+  {
+    QByteArray data;
+    QByteArray packed;
+    int refs;
+    QString file;
+    qint64 offset;
+    int size;
+  };
+
+  static QHash<QByteArray, Blob*> m_blobs;
+
+  static Blob* entry(QByteArray);
+  static bool fetchPacked(Blob*);
+};
+
+#endif
@@ -0,0 +1,469 @@
+#include "componentlabeller.h"
+
+#include <QThread>
+#include <QtConcurrentMap>
+
+ComponentLabeller::ComponentLabeller()
+{
+  clear();
+}
+
+void
+ComponentLabeller::clear()
+{
+  m_nx = m_ny = m_nz = 0;
+  m_rowStart.clear();
+  m_runX0.clear();
+  m_runX1.clear();
+  m_parent.clear();
+  m_runSurface.clear();
+  m_surfRowStart.clear();
+  m_surfX0.clear();
+  m_surfX1.clear();
+  m_components.clear();
+  m_voxels = 0;
+  m_surfaceVoxels = 0;
+}
+
+int ComponentLabeller::count() { return m_components.count(); }
+qint64 ComponentLabeller::voxels() { return m_voxels; }
+qint64 ComponentLabeller::surfaceVoxels() { return m_surfaceVoxels; }
+QList<ComponentLabeller::Component> ComponentLabeller::components() { return m_components; }
+
+ComponentLabeller::Component
+ComponentLabeller::component(int i)
+{
+  if (i >= 0 && i < m_components.count())
+    return m_components[i];
+
+  Component c;
+  c.voxels = c.surfaceVoxels = 0;
+  return c;
+}
+
+int
+ComponentLabeller::findRoot(int a)
+{
+  // path halving - parent index is never larger than child index
+  while (m_parent[a] != a)
+    {
+      m_parent[a] = m_parent[m_parent[a]];
+      a = m_parent[a];
+    }
+  return a;
+}
+
+void
+ComponentLabeller::unite(int a, int b)
+{
+  a = findRoot(a);
+  b = findRoot(b);
+  if (a == b)
+    return;
+
+  // smallest run index becomes the root so that
+  // labels follow the z,y,x scan order
+  if (a < b)
+    m_parent[b] = a;
+  else
+    m_parent[a] = b;
+}
+
+void
+ComponentLabeller::mergeRows(int ra, int rb)
+{
+  // two runs are 26-connected across rows when
+  // they overlap after dilating one of them by a voxel
+  int i = m_rowStart[ra];
+  int iend = m_rowStart[ra+1];
+  int j = m_rowStart[rb];
+  int jend = m_rowStart[rb+1];
+  while (i < iend && j < jend)
+    {
+      if (m_runX1[i]+1 < m_runX0[j])
+	i++;
+      else if (m_runX1[j]+1 < m_runX0[i])
+	j++;
+      else
+	{
+	  unite(i, j);
+	  if (m_runX1[i] < m_runX1[j])
+	    i++;
+	  else
+	    j++;
+	}
+    }
+}
+
+void
+ComponentLabeller::encodeBlock(BlockJob &job)
+{
+  int nx = job.labeller->m_nx;
+  int ny = job.labeller->m_ny;
+  const QBitArray &bits = *job.bitmask;
+
+  job.runX0.clear();
+  job.runX1.clear();
+  job.rowRuns.fill(0, (job.z1-job.z0+1)*ny);
+
+  int row = 0;
+  for(int z=job.z0; z<=job.z1; z++)
+    for(int y=0; y<ny; y++)
+      {
+	int bidx = (z*ny + y)*nx;
+	int nruns = 0;
+	int x = 0;
+	while (x < nx)
+	  {
+	    while (x < nx && !bits.testBit(bidx+x)) x++;
+	    if (x == nx)
+	      break;
+	    int x0 = x;
+	    while (x < nx && bits.testBit(bidx+x)) x++;
+	    job.runX0.append(x0);
+	    job.runX1.append(x-1);
+	    nruns++;
+	  }
+	job.rowRuns[row] = nruns;
+	row++;
+      }
+}
+
+void
+ComponentLabeller::labelBlock(BlockJob &job)
+{
+  // runs of this block only refer to runs of this block,
+  // so blocks can be labelled concurrently
+  ComponentLabeller *cl = job.labeller;
+  int ny = cl->m_ny;
+  for(int z=job.z0; z<=job.z1; z++)
+    for(int y=0; y<ny; y++)
+      {
+	int r = z*ny + y;
+	if (cl->m_rowStart[r] == cl->m_rowStart[r+1])
+	  continue;
+
+	if (y > 0)
+	  cl->mergeRows(r, r-1);
+
+	if (z > job.z0)
+	  {
+	    int y0 = qMax(y-1, 0);
+	    int y1 = qMin(y+1, ny-1);
+	    for(int y2=y0; y2<=y1; y2++)
+	      cl->mergeRows(r, (z-1)*ny + y2);
+	  }
+      }
+}
+
+void
+ComponentLabeller::surfaceBlock(BlockJob &job)
+{
+  ComponentLabeller *cl = job.labeller;
+  int nx = cl->m_nx;
+  int ny = cl->m_ny;
+  int nz = cl->m_nz;
+
+  job.runX0.clear();
+  job.runX1.clear();
+  job.rowRuns.fill(0, (job.z1-job.z0+1)*ny);
+
+  // cnt[x] counts the neighbour rows in which x and both
+  // its x-neighbours are set.  a voxel is interior when
+  // every neighbour row inside the box contributes.
+  QVector<uchar> cnt(nx);
+
+  int row = 0;
+  for(int z=job.z0; z<=job.z1; z++)
+    for(int y=0; y<ny; y++, row++)
+      {
+	int r = z*ny + y;
+	int rs = cl->m_rowStart[r];
+	int re = cl->m_rowStart[r+1];
+	if (rs == re)
+	  continue;
+
+	cnt.fill(0);
+	int z0 = qMax(z-1, 0);
+	int z1 = qMin(z+1, nz-1);
+	int y0 = qMax(y-1, 0);
+	int y1 = qMin(y+1, ny-1);
+	uchar nused = (z1-z0+1)*(y1-y0+1);
+	for(int z2=z0; z2<=z1; z2++)
+	  for(int y2=y0; y2<=y1; y2++)
+	    {
+	      int r2 = z2*ny + y2;
+	      for(int i=cl->m_rowStart[r2]; i<cl->m_rowStart[r2+1]; i++)
+		{
+		  // erode along x, clamped to the box
+		  int a = cl->m_runX0[i];
+		  int b = cl->m_runX1[i];
+		  if (a > 0) a++;
+		  if (b < nx-1) b--;
+		  for(int x=a; x<=b; x++)
+		    cnt[x]++;
+		}
+	    }
+
+	int nruns = 0;
+	for(int i=rs; i<re; i++)
+	  {
+	    int ns = 0;
+	    int x = cl->m_runX0[i];
+	    int xe = cl->m_runX1[i];
+	    while (x <= xe)
+	      {
+		while (x <= xe && cnt[x] == nused) x++;
+		if (x > xe)
+		  break;
+		int x0 = x;
+		while (x <= xe && cnt[x] < nused) x++;
+		job.runX0.append(x0);
+		job.runX1.append(x-1);
+		ns += x-x0;
+		nruns++;
+	      }
+	    cl->m_runSurface[i] = ns;
+	  }
+	job.rowRuns[row] = nruns;
+      }
+}
+
+void
+ComponentLabeller::label(const QBitArray &bitmask,
+			 int nx, int ny, int nz)
+{
+  clear();
+
+  if (nx <= 0 || ny <= 0 || nz <= 0 ||
+      bitmask.size() < (qint64)nx*ny*nz)
+    return;
+
+  m_nx = nx;
+  m_ny = ny;
+  m_nz = nz;
+
+  //----------------------------
+  // split volume into slabs along z
+  int nblocks = qMin(nz, qMax(1, 4*QThread::idealThreadCount()));
+  QList<BlockJob> jobs;
+  for(int b=0; b<nblocks; b++)
+    {
+      BlockJob job;
+      job.labeller = this;
+      job.bitmask = &bitmask;
+      job.z0 = (qint64)b*nz/nblocks;
+      job.z1 = (qint64)(b+1)*nz/nblocks - 1;
+      jobs << job;
+    }
+  //----------------------------
+
+  //----------------------------
+  // run-length encode rows
+  QtConcurrent::blockingMap(jobs, ComponentLabeller::encodeBlock);
+
+  int nrows = ny*nz;
+  m_rowStart.resize(nrows+1);
+  int nruns = 0;
+  int r = 0;
+  for(int b=0; b<nblocks; b++)
+    for(int i=0; i<jobs[b].rowRuns.count(); i++)
+      {
+	m_rowStart[r++] = nruns;
+	nruns += jobs[b].rowRuns[i];
+      }
+  m_rowStart[nrows] = nruns;
+
+  m_runX0.reserve(nruns);
+  m_runX1.reserve(nruns);
+  for(int b=0; b<nblocks; b++)
+    {
+      m_runX0 += jobs[b].runX0;
+      m_runX1 += jobs[b].runX1;
+      jobs[b].runX0.clear();
+      jobs[b].runX1.clear();
+    }
+  //----------------------------
+
+  if (nruns == 0)
+    return;
+
+  //----------------------------
+  // union-find within blocks, then merge across block boundaries
+  m_parent.resize(nruns);
+  for(int i=0; i<nruns; i++)
+    m_parent[i] = i;
+
+  QtConcurrent::blockingMap(jobs, ComponentLabeller::labelBlock);
+
+  for(int b=1; b<nblocks; b++)
+    {
+      int z = jobs[b].z0;
+      for(int y=0; y<ny; y++)
+	{
+	  int r = z*ny + y;
+	  if (m_rowStart[r] == m_rowStart[r+1])
+	    continue;
+	  int y0 = qMax(y-1, 0);
+	  int y1 = qMin(y+1, ny-1);
+	  for(int y2=y0; y2<=y1; y2++)
+	    mergeRows(r, (z-1)*ny + y2);
+	}
+    }
+
+  // parent index never exceeds run index, so a single
+  // forward sweep points every run at its root and
+  // then replaces roots by consecutive labels
+  for(int i=0; i<nruns; i++)
+    m_parent[i] = m_parent[m_parent[i]];
+
+  int ncomp = 0;
+  for(int i=0; i<nruns; i++)
+    {
+      if (m_parent[i] == i)
+	m_parent[i] = ncomp++;
+      else
+	m_parent[i] = m_parent[m_parent[i]];
+    }
+  //----------------------------
+
+  //----------------------------
+  // surface voxels
+  m_runSurface.fill(0, nruns);
+  QtConcurrent::blockingMap(jobs, ComponentLabeller::surfaceBlock);
+
+  m_surfRowStart.resize(nrows+1);
+  int nsruns = 0;
+  r = 0;
+  for(int b=0; b<nblocks; b++)
+    for(int i=0; i<jobs[b].rowRuns.count(); i++)
+      {
+	m_surfRowStart[r++] = nsruns;
+	nsruns += jobs[b].rowRuns[i];
+      }
+  m_surfRowStart[nrows] = nsruns;
+
+  m_surfX0.reserve(nsruns);
+  m_surfX1.reserve(nsruns);
+  for(int b=0; b<nblocks; b++)
+    {
+      m_surfX0 += jobs[b].runX0;
+      m_surfX1 += jobs[b].runX1;
+    }
+  jobs.clear();
+  //----------------------------
+
+  //----------------------------
+  // per component statistics
+  QVector<double> sx(ncomp, 0.0), sy(ncomp, 0.0), sz(ncomp, 0.0);
+  for(int c=0; c<ncomp; c++)
+    {
+      Component comp;
+      comp.voxels = 0;
+      comp.surfaceVoxels = 0;
+      comp.bmin = Vec(nx, ny, nz);
+      comp.bmax = Vec(-1, -1, -1);
+      m_components << comp;
+    }
+
+  for(int z=0; z<nz; z++)
+    for(int y=0; y<ny; y++)
+      {
+	int r = z*ny + y;
+	for(int i=m_rowStart[r]; i<m_rowStart[r+1]; i++)
+	  {
+	    int a = m_runX0[i];
+	    int b = m_runX1[i];
+	    qint64 len = b-a+1;
+	    Component &comp = m_components[m_parent[i]];
+	    comp.voxels += len;
+	    comp.surfaceVoxels += m_runSurface[i];
+	    comp.bmin = Vec(qMin((int)comp.bmin.x, a),
+			    qMin((int)comp.bmin.y, y),
+			    qMin((int)comp.bmin.z, z));
+	    comp.bmax = Vec(qMax((int)comp.bmax.x, b),
+			    qMax((int)comp.bmax.y, y),
+			    qMax((int)comp.bmax.z, z));
+	    sx[m_parent[i]] += 0.5*len*(a+b);
+	    sy[m_parent[i]] += (double)len*y;
+	    sz[m_parent[i]] += (double)len*z;
+	    m_voxels += len;
+	    m_surfaceVoxels += m_runSurface[i];
+	  }
+      }
+
+  for(int c=0; c<ncomp; c++)
+    {
+      double nv = m_components[c].voxels;
+      m_components[c].centroid = Vec(sx[c]/nv, sy[c]/nv, sz[c]/nv);
+    }
+  //----------------------------
+}
+
+int
+ComponentLabeller::labelAt(int x, int y, int z)
+{
+  if (x < 0 || x >= m_nx ||
+      y < 0 || y >= m_ny ||
+      z < 0 || z >= m_nz ||
+      m_parent.count() == 0)
+    return -1;
+
+  int r = z*m_ny + y;
+  int lo = m_rowStart[r];
+  int hi = m_rowStart[r+1]-1;
+  while (lo <= hi)
+    {
+      int mid = (lo+hi)/2;
+      if (x < m_runX0[mid])
+	hi = mid-1;
+      else if (x > m_runX1[mid])
+	lo = mid+1;
+      else
+	return m_parent[mid];
+    }
+
+  return -1;
+}
+
+QBitArray
+ComponentLabeller::componentMask(QList<int> labels)
+{
+  QBitArray mask;
+  mask.resize(m_nx*m_ny*m_nz);
+  if (labels.count() == 0 || m_parent.count() == 0)
+    return mask;
+
+  QVector<bool> wanted(m_components.count(), false);
+  for(int i=0; i<labels.count(); i++)
+    if (labels[i] >= 0 && labels[i] < wanted.count())
+      wanted[labels[i]] = true;
+
+  int nrows = m_ny*m_nz;
+  for(int r=0; r<nrows; r++)
+    for(int i=m_rowStart[r]; i<m_rowStart[r+1]; i++)
+      if (wanted[m_parent[i]])
+	mask.fill(true,
+		  r*m_nx + m_runX0[i],
+		  r*m_nx + m_runX1[i] + 1);
+
+  return mask;
+}
+
+QBitArray
+ComponentLabeller::surfaceMask()
+{
+  QBitArray mask;
+  mask.resize(m_nx*m_ny*m_nz);
+  if (m_surfRowStart.count() == 0)
+    return mask;
+
+  int nrows = m_ny*m_nz;
+  for(int r=0; r<nrows; r++)
+    for(int i=m_surfRowStart[r]; i<m_surfRowStart[r+1]; i++)
+      mask.fill(true,
+		r*m_nx + m_surfX0[i],
+		r*m_nx + m_surfX1[i] + 1);
+
+  return mask;
+}
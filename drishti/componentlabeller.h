@@ -0,0 +1,84 @@
+#ifndef COMPONENTLABELLER_H
+#define COMPONENTLABELLER_H
+
+#include <QBitArray>
+#include <QVector>
+#include <QList>
+
+#include <QGLViewer/vec.h>
+using namespace qglviewer;
+
+//---------------------------------------
+// 26-connected component labelling of a bitmask.
+// bitmask is stored as runs of set voxels per row
+// and labelled block-parallel along z with union-find;
+// block boundaries are merged in a final serial pass.
+// all coordinates are relative to the bitmask origin.
+//---------------------------------------
+class ComponentLabeller
+{
+ public :
+  struct Component
+  {
+    qint64 voxels;
+    qint64 surfaceVoxels;
+    Vec bmin, bmax;
+    Vec centroid;
+  };
+
+  ComponentLabeller();
+
+  void clear();
+
+  // label bitmask of size nx*ny*nz, x varying fastest
+  void label(const QBitArray&, int, int, int);
+
+  int count();
+  qint64 voxels();
+  qint64 surfaceVoxels();
+  Component component(int);
+  QList<Component> components();
+
+  // component id at voxel, -1 for background
+  int labelAt(int, int, int);
+
+  QBitArray componentMask(QList<int>);
+
+  // set voxels having at least one unset voxel
+  // in their 3x3x3 neighbourhood clamped to the box
+  QBitArray surfaceMask();
+
+ private :
+  struct BlockJob
+  {
+    ComponentLabeller *labeller;
+    const QBitArray *bitmask;
+    int z0, z1;
+    QVector<int> runX0, runX1;
+    QVector<int> rowRuns;
+  };
+
+  int m_nx, m_ny, m_nz;
+
+  // runs of row (y,z) are m_rowStart[z*ny+y] .. m_rowStart[z*ny+y+1]-1
+  QVector<int> m_rowStart;
+  QVector<int> m_runX0, m_runX1;
+  QVector<int> m_parent;
+  QVector<int> m_runSurface;
+
+  QVector<int> m_surfRowStart;
+  QVector<int> m_surfX0, m_surfX1;
+
+  QList<Component> m_components;
+  qint64 m_voxels, m_surfaceVoxels;
+
+  int findRoot(int);
+  void unite(int, int);
+  void mergeRows(int, int);
+
+  static void encodeBlock(BlockJob&);
+  static void labelBlock(BlockJob&);
+  static void surfaceBlock(BlockJob&);
+};
+
+#endif
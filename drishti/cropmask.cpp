@@ -0,0 +1,254 @@
+#include "cropmask.h"
+#include "staticfunctions.h"
+
+#include <QThread>
+#include <QtConcurrentMap>
+
+// rows handled together by one job
+static const int rowChunk = 8;
+
+CropMask::CropMask()
+{
+  m_scale = Vec(1,1,1);
+  m_uniteCrops = false;
+  m_unitePaths = false;
+  m_minx = m_miny = 0;
+  m_nx = m_ny = 0;
+  m_mask = 0;
+  m_runs = 0;
+  m_nruns = 0;
+}
+
+CropMask::~CropMask()
+{
+  clear();
+}
+
+void
+CropMask::clear()
+{
+  if (m_mask)
+    delete [] m_mask;
+  if (m_runs)
+    delete [] m_runs;
+  if (m_nruns)
+    delete [] m_nruns;
+  m_mask = 0;
+  m_runs = 0;
+  m_nruns = 0;
+  m_nx = m_ny = 0;
+}
+
+void CropMask::setScaling(Vec s) { m_scale = s; }
+uchar* CropMask::mask() { return m_mask; }
+
+void
+CropMask::setClips(QList<Vec> clipPos, QList<Vec> clipNormal)
+{
+  m_clipPos = clipPos;
+  m_clipNormal = clipNormal;
+}
+
+void
+CropMask::setCrops(QList<CropObject> crops, bool unite)
+{
+  m_crops = crops;
+  m_uniteCrops = unite;
+}
+
+void
+CropMask::setPaths(QList<PathObject> paths, bool unite)
+{
+  m_paths = paths;
+  m_unitePaths = unite;
+}
+
+void
+CropMask::setup(Vec scale,
+		 QList<Vec> clipPos, QList<Vec> clipNormal,
+		 QList<CropObject> crops, QList<PathObject> paths,
+		 bool unite)
+{
+  QList<CropObject> maskCrops;
+  for(int ci=0; ci<crops.count(); ci++)
+    if (crops[ci].cropType() < CropObject::Tear_Tear)
+      maskCrops << crops[ci];
+
+  QList<PathObject> maskPaths;
+  for(int i=0; i<paths.count(); i++)
+    if (paths[i].crop())
+      maskPaths << paths[i];
+
+  setScaling(scale);
+  setClips(clipPos, clipNormal);
+  setCrops(maskCrops, unite);
+  setPaths(maskPaths, unite);
+}
+
+int
+CropMask::runs(int y, int* &run)
+{
+  run = m_runs + (y-m_miny)*(m_nx+1);
+  return m_nruns[y-m_miny];
+}
+
+void
+CropMask::evaluate(int z,
+		   int minx, int maxx,
+		   int miny, int maxy)
+{
+  int nx = maxx-minx+1;
+  int ny = maxy-miny+1;
+  if (nx != m_nx || ny != m_ny)
+    {
+      clear();
+      m_nx = nx;
+      m_ny = ny;
+      m_mask = new uchar[m_nx*m_ny];
+      // a row has at most (nx+1)/2 runs
+      m_runs = new int[(m_nx+1)*m_ny];
+      m_nruns = new int[m_ny];
+    }
+  m_minx = minx;
+  m_miny = miny;
+
+  RowJob job;
+  job.mask = m_mask;
+  job.runs = m_runs;
+  job.nruns = m_nruns;
+  job.z = z;
+  job.minx = minx;
+  job.maxx = maxx;
+  job.miny = miny;
+  job.scale = m_scale;
+  job.clipPos = m_clipPos;
+  job.clipNormal = m_clipNormal;
+  job.uniteCrops = m_uniteCrops;
+  job.unitePaths = m_unitePaths;
+
+  // clip planes alone are cheap - no need for threads
+  if (m_crops.count() == 0 && m_paths.count() == 0)
+    {
+      job.y0 = miny;
+      job.y1 = maxy;
+      evaluateRows(job);
+      return;
+    }
+
+  // every job works on its own copy of crops and paths
+  // because evaluating them may detach their internal lists
+  job.crops = m_crops;
+  job.paths = m_paths;
+
+  int nthreads = qMax(1, QThread::idealThreadCount());
+  int nrows = qMax(rowChunk, ny/(4*nthreads));
+
+  QList<RowJob> jobs;
+  for(int y0=miny; y0<=maxy; y0+=nrows)
+    {
+      job.y0 = y0;
+      job.y1 = qMin(maxy, y0+nrows-1);
+      jobs << job;
+    }
+
+  if (jobs.count() == 1)
+    evaluateRows(jobs[0]);
+  else
+    QtConcurrent::blockingMap(jobs, CropMask::evaluateRows);
+}
+
+bool
+CropMask::inside(RowJob &job, Vec po)
+{
+  if (job.crops.count() > 0)
+    {
+      bool ok = !job.uniteCrops;
+      for(int ci=0; ci<job.crops.count(); ci++)
+	{
+	  if (job.crops[ci].checkCropped(po) == job.uniteCrops)
+	    {
+	      ok = job.uniteCrops;
+	      break;
+	    }
+	}
+      if (!ok)
+	return false;
+    }
+
+  if (job.paths.count() > 0)
+    {
+      bool ok = !job.unitePaths;
+      for(int ci=0; ci<job.paths.count(); ci++)
+	{
+	  if (job.paths[ci].checkCropped(po) == job.unitePaths)
+	    {
+	      ok = job.unitePaths;
+	      break;
+	    }
+	}
+      if (!ok)
+	return false;
+    }
+
+  return true;
+}
+
+void
+CropMask::evaluateRows(RowJob &job)
+{
+  int nx = job.maxx-job.minx+1;
+  bool crop = (job.crops.count() > 0 || job.paths.count() > 0);
+
+  for(int y=job.y0; y<=job.y1; y++)
+    {
+      uchar *row = job.mask + (y-job.miny)*nx;
+      int *run = job.runs + (y-job.miny)*(nx+1);
+      int nr = 0;
+
+      memset(row, 0, nx);
+
+      int x0, x1;
+      if (StaticFunctions::getClipSpan(y, job.z, job.minx, job.maxx,
+				       job.scale,
+				       job.clipPos, job.clipNormal,
+				       x0, x1))
+	{
+	  if (!crop)
+	    {
+	      memset(row+x0-job.minx, 1, x1-x0+1);
+	      run[0] = x0;
+	      run[1] = x1;
+	      nr = 1;
+	    }
+	  else
+	    {
+	      int rs = -1;
+	      for(int x=x0; x<=x1; x++)
+		{
+		  Vec po = VECPRODUCT(Vec(x, y, job.z), job.scale);
+		  if (inside(job, po))
+		    {
+		      row[x-job.minx] = 1;
+		      if (rs < 0)
+			rs = x;
+		    }
+		  else if (rs >= 0)
+		    {
+		      run[2*nr] = rs;
+		      run[2*nr+1] = x-1;
+		      nr++;
+		      rs = -1;
+		    }
+		}
+	      if (rs >= 0)
+		{
+		  run[2*nr] = rs;
+		  run[2*nr+1] = x1;
+		  nr++;
+		}
+	    }
+	}
+
+      job.nruns[y-job.miny] = nr;
+    }
+}
@@ -0,0 +1,79 @@
+#ifndef CROPMASK_H
+#define CROPMASK_H
+
+#include <QList>
+
+#include "cropobject.h"
+#include "pathobject.h"
+
+//---------------------------------------
+// inside/outside mask for one slice after clip planes, crops and
+// path-crops are applied.  clip planes reduce to a single x-range
+// per row, crops and paths are evaluated only within that range and
+// rows are evaluated in parallel.  the result is available as a byte
+// mask and as runs of inside voxels per row, so that exporters only
+// touch voxels that survive.
+//---------------------------------------
+class CropMask
+{
+ public :
+  CropMask();
+  ~CropMask();
+
+  void clear();
+
+  // voxel (x,y,z) is tested at VECPRODUCT(Vec(x,y,z), scale)
+  void setScaling(Vec);
+  void setClips(QList<Vec>, QList<Vec>);
+
+  // unite : voxel has to be inside any one of the objects
+  // instead of inside all of them
+  void setCrops(QList<CropObject>, bool unite=false);
+  void setPaths(QList<PathObject>, bool unite=false);
+
+  // scaling, clip planes, crops and paths of a plugin in one go -
+  // tears and paths that do not crop are left out
+  void setup(Vec, QList<Vec>, QList<Vec>,
+	     QList<CropObject>, QList<PathObject>, bool unite=false);
+
+  // z, minx, maxx, miny, maxy
+  void evaluate(int, int, int, int, int);
+
+  // one byte per voxel of the evaluated box, row by row,
+  // 1 for voxels that survive
+  uchar* mask();
+
+  // runs of surviving voxels for row y as inclusive x0,x1 pairs
+  int runs(int, int*&);
+
+ private :
+  struct RowJob
+  {
+    uchar *mask;
+    int *runs, *nruns;
+    int z, minx, maxx, miny;
+    int y0, y1;
+    Vec scale;
+    QList<Vec> clipPos, clipNormal;
+    QList<CropObject> crops;
+    QList<PathObject> paths;
+    bool uniteCrops, unitePaths;
+  };
+
+  Vec m_scale;
+  QList<Vec> m_clipPos, m_clipNormal;
+  QList<CropObject> m_crops;
+  QList<PathObject> m_paths;
+  bool m_uniteCrops, m_unitePaths;
+
+  int m_minx, m_miny;
+  int m_nx, m_ny;
+  uchar *m_mask;
+  int *m_runs;
+  int *m_nruns;
+
+  static void evaluateRows(RowJob&);
+  static bool inside(RowJob&, Vec);
+};
+
+#endif
@@ -1818,22 +1818,17 @@ CropObject::checkBlend(Vec v)
 {
   int viewType = cropType();
 
-  QList<Vec> pts;
-  QList<float> radX;
-  QList<float> radY;
-  QList<int> lift;
-
-  float srad1 = m_pointRadX[0];
-  float srad2 = m_pointRadX[1];
-  float trad1 = m_pointRadY[0];
-  float trad2 = m_pointRadY[1];
-  float lift1 = m_lift[0];
-  float lift2 = m_lift[1];
-
-  pts = m_points;
-  radX = m_pointRadX;
-  radY = m_pointRadY;
-  
+  // evaluated per voxel, possibly from several threads -
+  // read the lists in place instead of copying/detaching them
+  const QList<Vec> &pts = m_points;
+
+  float srad1 = m_pointRadX.at(0);
+  float srad2 = m_pointRadX.at(1);
+  float trad1 = m_pointRadY.at(0);
+  float trad2 = m_pointRadY.at(1);
+  float lift1 = m_lift.at(0);
+  float lift2 = m_lift.at(1);
+
   Vec pvec = m_tang;
   Vec saxis = m_xaxis;
   Vec taxis = m_yaxis;
@@ -1970,22 +1965,15 @@ CropObject::hatched(float c, float s, float t,
 bool
 CropObject::checkCropped(Vec v)
 {
-  QList<Vec> pts;
-  QList<float> radX;
-  QList<float> radY;
-  QList<int> lift;
-
-  float srad1 = m_pointRadX[0];
-  float srad2 = m_pointRadX[1];
-  float trad1 = m_pointRadY[0];
-  float trad2 = m_pointRadY[1];
-  float lift1 = m_lift[0];
-  float lift2 = m_lift[1];
-
-  pts = m_points;
-  radX = m_pointRadX;
-  radY = m_pointRadY;
-  
+  const QList<Vec> &pts = m_points;
+
+  float srad1 = m_pointRadX.at(0);
+  float srad2 = m_pointRadX.at(1);
+  float trad1 = m_pointRadY.at(0);
+  float trad2 = m_pointRadY.at(1);
+  float lift1 = m_lift.at(0);
+  float lift2 = m_lift.at(1);
+
   Vec pvec = m_tang;
   Vec saxis = m_xaxis;
   Vec taxis = m_yaxis;
@@ -2304,22 +2292,15 @@ CropObject::checkTear(Vec v, Vec &newV)
 
   int viewType = cropType();
 
-  QList<Vec> pts;
-  QList<float> radX;
-  QList<float> radY;
-  QList<int> lift;
-
-  float srad1 = m_pointRadX[0];
-  float srad2 = m_pointRadX[1];
-  float trad1 = m_pointRadY[0];
-  float trad2 = m_pointRadY[1];
-  float lift1 = m_lift[0];
-  float lift2 = m_lift[1];
-
-  pts = m_points;
-  radX = m_pointRadX;
-  radY = m_pointRadY;
-  
+  const QList<Vec> &pts = m_points;
+
+  float srad1 = m_pointRadX.at(0);
+  float srad2 = m_pointRadX.at(1);
+  float trad1 = m_pointRadY.at(0);
+  float trad2 = m_pointRadY.at(1);
+  float lift1 = m_lift.at(0);
+  float lift2 = m_lift.at(1);
+
   Vec pvec = m_tang;
   Vec saxis = m_xaxis;
   Vec taxis = m_yaxis;
@@ -18,6 +18,7 @@
 #include <QInputDialog>
 #include <QFileDialog>
 #include <QDataStream>
+#include <QElapsedTimer>
 
 void
 DrawHiresVolume::saveImage2Volume(QString pfile)
@@ -49,9 +50,7 @@ bool DrawHiresVolume::raised() { return m_showing; }
 void DrawHiresVolume::lower() { m_showing = false; }
 void DrawHiresVolume::raise()
 {
-  for(int bno=0; bno<m_polygon.size(); bno++)
-    delete m_polygon[bno];
-  m_polygon.clear();  
+  m_sliceGeometry.reset();
 
   initShadowBuffers();
   m_showing = true;
@@ -165,6 +164,10 @@ DrawHiresVolume::DrawHiresVolume(Viewer *viewer,
   m_slcTex[0] = 0;
   m_slcTex[1] = 0;
 
+  m_unpackBuffer[0] = 0;
+  m_unpackBuffer[1] = 0;
+  m_loadStatistics.clear();
+
   renew();
 }
 
@@ -201,9 +204,7 @@ DrawHiresVolume::renew()
   m_histogramDrag1D = QImage(256, 256, QImage::Format_RGB32);
   m_histogramDrag2D = QImage(256, 256, QImage::Format_RGB32);
 
-  for(int bno=0; bno<m_polygon.size(); bno++)
-    delete m_polygon[bno];
-  m_polygon.clear();
+  m_sliceGeometry.clear();
   
   m_dataTexSize = 0;
   m_dataTex = 0;
@@ -262,6 +263,10 @@ DrawHiresVolume::cleanup()
   m_shdTex[0] = m_shdTex[1] = 0;
   m_shdNum = 0;
 
+  m_slabLoader.finish();
+  if (m_unpackBuffer[0]) glDeleteBuffers(2, m_unpackBuffer);
+  m_unpackBuffer[0] = m_unpackBuffer[1] = 0;
+
   if (m_histData1D) delete [] m_histData1D;
   if (m_histData2D) delete [] m_histData2D;
   if (m_histDragData1D) delete [] m_histDragData1D;
@@ -671,6 +676,81 @@ DrawHiresVolume::updateAndLoadLightTexture()
 					  m_Viewer->lookupTable());
 }
 
+void
+DrawHiresVolume::updateOccupancy()
+{
+  m_slabOccupied.clear();
+  m_slabOccMin.clear();
+  m_slabOccMax.clear();
+
+  if (!m_occupancy.valid())
+    return;
+
+  m_occupancy.evaluate(m_Viewer->lookupTable(), Global::lutSize());
+
+  int lod = m_Volume->getSubvolumeSubsamplingLevel();
+  Vec draginfo = m_Volume->getDragTextureInfo();
+  float dlod = qMax(1.0, draginfo.z);
+
+  for(int b=0; b<m_dataTexSize; b++)
+    {
+      float tminz = m_dataMin.z;
+      float tmaxz = m_dataMax.z;
+      if (m_dataTexSize > 1 && b > 0)
+	{
+	  tminz = m_textureSlab[b].y;
+	  tmaxz = m_textureSlab[b].z;
+	}
+
+      // same z range that renderSlicedSlice clips the slab to
+      Vec omin, omax;
+      bool occ = m_occupancy.occupiedBox(tminz-lod, tmaxz+lod,
+					 omin, omax);
+
+      // drag texture samples are spread further apart
+      if (occ && m_dataTexSize > 1 && b == 0)
+	{
+	  omin -= Vec(2*dlod, 2*dlod, 2*dlod);
+	  omax += Vec(2*dlod, 2*dlod, 2*dlod);
+	}
+
+      m_slabOccupied.append(occ);
+      m_slabOccMin.append(omin);
+      m_slabOccMax.append(omax);
+    }
+}
+
+void
+DrawHiresVolume::addSlabToOccupancy(uchar *textureSlab,
+				    int minz, int maxz,
+				    int texX, int texY,
+				    int bpv)
+{
+  int ncols, nrows;
+  m_Volume->getColumnsAndRows(ncols, nrows);
+  if (ncols < 1 || nrows < 1)
+    return;
+
+  int lod = m_Volume->getSubvolumeSubsamplingLevel();
+  int maxlenx2 = texX/ncols;
+  int maxleny2 = texY/nrows;
+
+  // slab holds an additional slice at the top and bottom
+  int kmin = minz/lod;
+  int kmax = maxz/lod;
+  for(int t=0; t<=kmax-kmin+2; t++)
+    {
+      int col = t%ncols;
+      int row = t/ncols;
+      if (row >= nrows)
+	break;
+
+      uchar *slice = textureSlab + bpv*((qint64)col*maxlenx2 +
+					(qint64)row*maxleny2*texX);
+      m_occupancy.addSlice(kmin-1+t, slice, texX);
+    }
+}
+
 void
 DrawHiresVolume::loadDragTexture()
 {
@@ -772,6 +852,8 @@ DrawHiresVolume::loadTextureMemory()
       m_textureSlab.append(Vec(1,1,1));
       m_dataTex = 0;
       m_dataTexSize = 0;
+      m_occupancy.clear();
+      m_slabOccupied.clear();
       return;
     }
 
@@ -823,6 +905,22 @@ DrawHiresVolume::loadTextureMemory()
     }
       
   m_dataTexSize = m_textureSlab.count();
+
+  //-- min/max occupancy is gathered as the slabs stream in
+  int bpv = 1;
+  if (m_Volume->pvlVoxelType(0) > 0) bpv = 2;
+  int lod = m_Volume->getSubvolumeSubsamplingLevel();
+  m_slabOccupied.clear();
+  if (Global::volumeType() == Global::SingleVolume)
+    m_occupancy.reset(m_dataMin, lod,
+		      (int)(m_dataSize.x+1)/lod,
+		      (int)(m_dataSize.y+1)/lod,
+		      (int)m_dataMax.z/lod - (int)m_dataMin.z/lod + 1,
+		      bpv);
+  else
+    m_occupancy.clear();
+  //--
+
   if (m_dataTexSize <= 0)
     return;
 
@@ -841,9 +939,38 @@ DrawHiresVolume::loadTextureMemory()
     setWindowTitle(QString("Uploading slices"));
   Global::progressBar()->show();
 
+  // do not load drag texture right now
+  QList<int> slabIdx;
+  QList<Vec> slabs;
   for(int i=0; i<m_dataTexSize; i++)
+    if (m_dataTexSize == 1 || i > 0)
+      {
+	slabIdx << i;
+	slabs << m_textureSlab[i];
+      }
+
+  //-- slabs are prepared by the loader thread while the previous
+  //-- one is uploaded through a pixel unpack buffer
+  int slabBytes = nvol*bpv*textureX*textureY;
+  bool pipelined = (!Global::loadDragOnly() &&
+		    slabIdx.count() > 1 &&
+		    m_Volume->canPrepareSlabs());
+  bool usePbo = (pipelined && GLEW_ARB_pixel_buffer_object);
+  if (usePbo && !m_unpackBuffer[0])
+    glGenBuffers(2, m_unpackBuffer);
+  int pbo = 0;
+
+  QElapsedTimer totalTimer, timer;
+  totalTimer.start();
+  qint64 prepareTime = 0;
+  qint64 uploadTime = 0;
+
+  if (pipelined)
+    m_slabLoader.load(m_Volume, slabs, slabBytes, 2);
+
+  for(int si=0; si<slabIdx.count(); si++)
     {      
-      if (m_dataTexSize > 1 && i == 0) i++; // do not load drag texture right now
+      int i = slabIdx[si];
 
       int minz, maxz, texX, texY; 
       minz = m_textureSlab[i].y;
@@ -854,6 +981,27 @@ DrawHiresVolume::loadTextureMemory()
       MainWindowUI::mainWindowUI()->statusBar->showMessage(	      \
 			    QString("loading slab %1 [%2 %3]"). \
 			    arg(i).arg(minz).arg(maxz));
+      Global::progressBar()->setValue((int)(100.0*(float)si/(float)slabIdx.count()));
+
+      uchar *textureSlab = NULL;
+
+      if (pipelined)
+	{
+	  bool ok;
+	  textureSlab = m_slabLoader.takeSlab(ok);
+	  if (!ok)
+	    QMessageBox::information(0, "ERROR",
+				     QString("row, col ?? slab %1 %2").\
+				     arg(minz).arg(maxz));
+	}
+      else if (!Global::loadDragOnly())
+	{
+	  timer.start();
+	  textureSlab = m_Volume->getSliceTextureSlab(minz, maxz);
+	  prepareTime += timer.nsecsElapsed();
+	}
+
+      timer.start();
 
       glActiveTexture(GL_TEXTURE1);
       glEnable(GL_TEXTURE_RECTANGLE_ARB);
@@ -872,11 +1020,24 @@ DrawHiresVolume::loadTextureMemory()
 	  glTexParameteri(GL_TEXTURE_RECTANGLE_ARB, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
 	  glTexParameteri(GL_TEXTURE_RECTANGLE_ARB, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
 	}
-      
-      uchar *textureSlab = NULL;
 
-      if (!Global::loadDragOnly())
-	textureSlab = m_Volume->getSliceTextureSlab(minz, maxz);
+      //-- copy slab into an unpack buffer so that the driver can
+      //-- transfer it while the next slab is being prepared
+      uchar *pixels = textureSlab;
+      if (usePbo && textureSlab)
+	{
+	  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_unpackBuffer[pbo]);
+	  glBufferData(GL_PIXEL_UNPACK_BUFFER, slabBytes, 0, GL_STREAM_DRAW);
+	  void *ptr = glMapBuffer(GL_PIXEL_UNPACK_BUFFER, GL_WRITE_ONLY);
+	  if (ptr)
+	    {
+	      memcpy(ptr, textureSlab, slabBytes);
+	      glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+	      pixels = 0; // offset into the unpack buffer
+	    }
+	  else
+	    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	}
       
       glTexImage2D(GL_TEXTURE_RECTANGLE_ARB,
 		   0, // single resolution
@@ -885,12 +1046,52 @@ DrawHiresVolume::loadTextureMemory()
 		   0, // no border
 		   format,
 		   vtype,
-		   textureSlab);
+		   pixels);
+
+      if (usePbo)
+	{
+	  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	  pbo = (pbo+1)%2;
+	}
 
       glFlush();
-      glFinish();
+
+      uploadTime += timer.nsecsElapsed();
+
+      if (textureSlab &&
+	  Global::volumeType() == Global::SingleVolume)
+	addSlabToOccupancy(textureSlab, minz, maxz,
+			   textureX, textureY, bpv);
+
+      if (pipelined)
+	m_slabLoader.giveBack(textureSlab);
     }
 
+  timer.start();
+  glFinish();
+  uploadTime += timer.nsecsElapsed();
+
+  //-- per stage timings
+  m_loadStatistics = QString("Slabs : %1 of %2 Mb each\n").\
+    arg(slabIdx.count()).arg((float)slabBytes/(1024*1024), 0, 'f', 1);
+  if (pipelined)
+    {
+      m_loadStatistics += QString("Prepare (loader thread) : %1 ms\n").\
+	arg(m_slabLoader.prepareTime(), 0, 'f', 1);
+      m_loadStatistics += QString("Waiting for slabs : %1 ms\n").\
+	arg(m_slabLoader.waitTime(), 0, 'f', 1);
+      m_slabLoader.finish();
+    }
+  else
+    m_loadStatistics += QString("Prepare : %1 ms\n").\
+      arg(prepareTime/1000000.0, 0, 'f', 1);
+  m_loadStatistics += QString("Upload%1 : %2 ms\n").\
+    arg(usePbo ? " (unpack buffers)" : "").\
+    arg(uploadTime/1000000.0, 0, 'f', 1);
+  m_loadStatistics += QString("Total : %1 ms").\
+    arg(totalTimer.nsecsElapsed()/1000000.0, 0, 'f', 1);
+  //--
+
   Global::hideProgressBar();
   MainWindowUI::mainWindowUI()->statusBar->showMessage("Ready");
 
@@ -898,6 +1099,8 @@ DrawHiresVolume::loadTextureMemory()
 
   m_Volume->deleteTextureSlab();
 
+  updateOccupancy();
+
   if (uv)
     {
       Global::enableViewerUpdate();
@@ -2566,9 +2769,7 @@ DrawHiresVolume::drawSlicesDefault(Vec pn, Vec minvert, Vec maxvert,
 
   //----------------------------------------------------------------
   // for polygons generated from bricks
-  for(int bno=0; bno<m_polygon.size(); bno++)
-    delete m_polygon[bno];
-  m_polygon.clear();  
+  m_sliceGeometry.reset();
   //----------------------------------------------------------------
 
   Vec step = stepsize*pn;
@@ -2777,6 +2978,11 @@ DrawHiresVolume::drawSlicesDefault(Vec pn, Vec minvert, Vec maxvert,
 
   int shadowRenderSteps = qMax(1, (int)(1.0/stepsize));
 
+  bool skipEmpty = (Global::emptySpaceSkip() &&
+		    Global::volumeType() == Global::SingleVolume &&
+		    m_slabOccupied.count() == m_dataTexSize);
+  ViewAlignedPolygon ovap;
+
   Vec pnDir = step;
   if (m_backlit)
     pnDir = -step;
@@ -2836,7 +3042,7 @@ DrawHiresVolume::drawSlicesDefault(Vec pn, Vec minvert, Vec maxvert,
 					 clips,
 					 brickPivot, brickScale);
 	  
-	      ViewAlignedPolygon *vap = m_polygon[pno];
+	      ViewAlignedPolygon *vap = m_sliceGeometry.polygon(pno);
 	      pno++;
 	  
 	      //---------------------------------
@@ -2861,6 +3067,20 @@ DrawHiresVolume::drawSlicesDefault(Vec pn, Vec minvert, Vec maxvert,
 
 		  for(int b=slabstart; b<slabend; b++)
 		    {
+		      // skip slabs and parts of slices that are
+		      // transparent for the current transfer functions
+		      ViewAlignedPolygon *rvap = vap;
+		      if (skipEmpty)
+			{
+			  if (!m_slabOccupied[b])
+			    continue;
+			  ovap = *vap;
+			  clipToBox(m_slabOccMin[b], m_slabOccMax[b], &ovap);
+			  if (ovap.edges == 0)
+			    continue;
+			  rvap = &ovap;
+			}
+
 		      float tminz = m_dataMin.z;
 		      float tmaxz = m_dataMax.z;
 		      if (slabend > 1)
@@ -2891,10 +3111,10 @@ DrawHiresVolume::drawSlicesDefault(Vec pn, Vec minvert, Vec maxvert,
 		      if (m_drawImageType != Enums::DragImage ||
 			  m_dataTexSize == 1)
 			renderSlicedSlice(0,
-					  vap, false,
+					  rvap, false,
 					  lenx2, leny2, b, lod);
 		      else
-			renderDragSlice(vap, false, dragTexsize);
+			renderDragSlice(rvap, false, dragTexsize);
 		      
 		    } // loop over b
 		}
@@ -3233,6 +3453,72 @@ DrawHiresVolume::clipSlab(Vec vp0, Vec vp1,
   //---- clipping applied
 }
 
+void
+DrawHiresVolume::clipToBox(Vec bmin, Vec bmax,
+			   ViewAlignedPolygon *vap)
+{
+  Vec poly[100];
+  Vec tex[100];
+  int edges = vap->edges;
+  for(int pi=0; pi<edges; pi++) poly[pi] = vap->vertex[pi];
+  for(int pi=0; pi<edges; pi++) tex[pi] = vap->texcoord[pi];
+
+  // clip on texture coordinates against the six box faces
+  for(int ci=0; ci<6 && edges>0; ci++)
+    {
+      Vec cpo = bmin;
+      Vec cpn;
+      if (ci == 0) cpn = Vec(-1,0,0);
+      else if (ci == 1) cpn = Vec(0,-1,0);
+      else if (ci == 2) cpn = Vec(0,0,-1);
+      else
+	{
+	  cpo = bmax;
+	  if (ci == 3) cpn = Vec(1,0,0);
+	  else if (ci == 4) cpn = Vec(0,1,0);
+	  else cpn = Vec(0,0,1);
+	}
+
+      int tedges = edges;
+      Vec tpoly[100];
+      Vec ttex[100];
+      for(int pi=0; pi<tedges; pi++) tpoly[pi] = poly[pi];
+      for(int pi=0; pi<tedges; pi++) ttex[pi] = tex[pi];
+
+      edges = 0;
+      for(int pi=0; pi<tedges; pi++)
+	{
+	  Vec v0 = tpoly[pi];
+	  Vec t0 = ttex[pi];
+	  Vec v1 = tpoly[(pi+1)%tedges];
+	  Vec t1 = ttex[(pi+1)%tedges];
+
+	  int ret = StaticFunctions::intersectType2WithTexture(cpo, cpn,
+							       t0, t1,
+							       v0, v1);
+	  if (ret)
+	    {
+	      poly[edges] = v0;
+	      tex[edges] = t0;
+	      edges ++;
+	      if (ret == 2)
+		{
+		  poly[edges] = v1;
+		  tex[edges] = t1;
+		  edges ++;
+		}
+	    }
+	}
+    }
+
+  vap->edges = edges;
+  for(int pi=0; pi<edges; pi++)
+    {
+      vap->vertex[pi] = poly[pi];
+      vap->texcoord[pi] = tex[pi];
+    }
+}
+
 QList<int>
 DrawHiresVolume::getSlices(Vec poStart,
 			   Vec step,
@@ -3262,8 +3548,8 @@ DrawHiresVolume::getSlices(Vec poStart,
 
   QList<int> tfSet;
   QList< QList<bool> > clips;
-  QList<Vec> subvol;
-  QList<Vec> texture;
+  QVector<Vec> subvol;
+  QVector<Vec> texture;
 
   for (int bno=0; bno<m_numBricks; bno++)
     {
@@ -3300,28 +3586,16 @@ DrawHiresVolume::getSlices(Vec poStart,
   Vec pnDir = step;
   if (m_backlit)
     pnDir = -step;
-  Vec po = poStart;
-  for(int s=0; s<layers; s++)
-    { 
-      po += pnDir;
-
-      for (int bno=0; bno<m_numBricks; bno++)
-	{
-	  Vec bsubvol[8],btexture[8];
 
-	  for (int j=0; j<8; j++)
-	    bsubvol[j] = subvol[8*bno + j];
-	  for (int j=0; j<8; j++)
-	    btexture[j] = texture[8*bno + j];
+  QList<Vec> clipNormal;
+  for(int ci=0; ci<m_clipNormal.count(); ci++)
+    clipNormal << VECPRODUCT(m_clipNormal[ci], voxelScaling);
 
-	  ViewAlignedPolygon *vap = new ViewAlignedPolygon;
-	  drawpoly(po, pn,
-		   bsubvol, btexture,
-		   clips[bno],
-		   vap);
-	  m_polygon.append(vap);
-	}
-    }
+  m_sliceGeometry.generate(poStart, pnDir, pn, layers,
+			   m_numBricks, subvol.data(), texture.data(),
+			   clips,
+			   m_clipPos, clipNormal,
+			   m_clipPos.count());
 
 
   //-----------------------------------
@@ -3343,18 +3617,128 @@ DrawHiresVolume::getSlices(Vec poStart,
 
       Vec cpos = VECPRODUCT(m_clipPos[ic], voxelScaling);
 
-      ViewAlignedPolygon *vap = new ViewAlignedPolygon;
+      ViewAlignedPolygon *vap = m_sliceGeometry.append();
       drawpoly(cpos, cnorm,
 	       bsubvol, btexture,
 	       dummyclips,
 	       vap);
-      m_polygon.append(vap);
     }
   //-----------------------------------
 
   return tfSet;
 }
 
+QString DrawHiresVolume::textureLoadStatistics() { return m_loadStatistics; }
+
+QString
+DrawHiresVolume::benchmarkSliceGeometry(int frames)
+{
+  if (Global::volumeType() == Global::DummyVolume)
+    return "No volume loaded";
+
+  frames = qMax(1, frames);
+
+  collectBrickInformation(true);
+
+  float zdepth;
+  Vec minvert, maxvert;
+  Vec pn = m_Viewer->camera()->viewDirection();
+  getMinMaxVertices(zdepth, minvert, maxvert);
+
+  float stepsize = Global::stepsizeStill();
+  stepsize *= m_Volume->getSubvolumeSubsamplingLevel();
+  int layers = zdepth/stepsize;
+  Vec step = stepsize*pn;
+  Vec poStart = maxvert;
+
+  // sets up clip planes for drawpoly as well
+  getSlices(poStart, step, pn, layers);
+
+  QList<bool> applyclip = GeometryObjects::clipplanes()->applyClip();
+
+  QElapsedTimer timer;
+
+  //-----------------------------------
+  // one heap allocated polygon per slice per brick.
+  // brick information is fetched once per frame, as getSlices does
+  timer.start();
+  int npoly = 0;
+  for(int f=0; f<frames; f++)
+    {
+      QList< QList<bool> > clips;
+      QVector<Vec> subvol;
+      QVector<Vec> texture;
+      for (int bno=0; bno<m_numBricks; bno++)
+	{
+	  QList<bool> bclips;
+	  int tfset;
+	  Vec bsubvol[8], btexture[8], subcorner, subdim;
+	  Vec brickPivot, brickScale;
+	  m_drawBrickInformation.get(bno,
+				     tfset,
+				     bsubvol, btexture,
+				     subcorner, subdim,
+				     bclips,
+				     brickPivot, brickScale);
+	  for(int ci=bclips.count(); ci<applyclip.count(); ci++)
+	    bclips << false;
+	  for(int ci=0; ci<applyclip.count(); ci++)
+	    bclips[ci] = bclips[ci] && applyclip[ci];
+	  clips.append(bclips);
+
+	  for (int j=0; j<8; j++)
+	    subvol.append(bsubvol[j]);
+	  for (int j=0; j<8; j++)
+	    texture.append(btexture[j]);
+	}
+
+      QList<ViewAlignedPolygon*> polygon;
+      Vec po = poStart;
+      for(int s=0; s<layers; s++)
+	{
+	  po += step;
+	  for (int bno=0; bno<m_numBricks; bno++)
+	    {
+	      ViewAlignedPolygon *vap = new ViewAlignedPolygon;
+	      drawpoly(po, pn,
+		       subvol.data() + 8*bno, texture.data() + 8*bno,
+		       clips[bno],
+		       vap);
+	      polygon.append(vap);
+	    }
+	}
+      npoly = polygon.count();
+      for(int i=0; i<polygon.count(); i++)
+	delete polygon[i];
+    }
+  qint64 tref = timer.nsecsElapsed();
+  //-----------------------------------
+
+  //-----------------------------------
+  timer.restart();
+  for(int f=0; f<frames; f++)
+    {
+      m_sliceGeometry.reset();
+      getSlices(poStart, step, pn, layers);
+    }
+  qint64 tarena = timer.nsecsElapsed();
+  m_sliceGeometry.reset();
+  //-----------------------------------
+
+  float msref = tref/(1000000.0*frames);
+  float msarena = tarena/(1000000.0*frames);
+
+  QString mesg;
+  mesg += QString("%1 layers x %2 bricks = %3 polygons per frame, %4 frames\n"). \
+    arg(layers).arg(m_numBricks).arg(npoly).arg(frames);
+  mesg += QString("per slice drawpoly : %1 ms/frame\n").arg(msref, 0, 'f', 3);
+  mesg += QString("slice geometry     : %1 ms/frame\n").arg(msarena, 0, 'f', 3);
+  if (msarena > 0)
+    mesg += QString("speedup : %1x\n").arg(msref/msarena, 0, 'f', 2);
+
+  return mesg;
+}
+
 void
 DrawHiresVolume::emptySpaceSkip()
 {
@@ -4014,7 +4398,7 @@ DrawHiresVolume::drawClipPlaneDefault(int s, int layers,
 	  tfset[ic] >= 0 &&
 	  tfset[ic] < Global::lutSize())
 	{
-	  ViewAlignedPolygon *vap = m_polygon[clipOffset + ic];
+	  ViewAlignedPolygon *vap = m_sliceGeometry.polygon(clipOffset + ic);
 	  
 	  if (Global::volumeType() != Global::RGBVolume &&
 	      Global::volumeType() != Global::RGBAVolume)
@@ -12,6 +12,9 @@ using namespace qglviewer;
 #include "cropobject.h"
 #include "pathobject.h"
 #include "volumefilemanager.h"
+#include "occupancytree.h"
+#include "slicegeometry.h"
+#include "slabloader.h"
 
 #include <QGLFramebufferObject>
 
@@ -96,6 +99,7 @@ class DrawHiresVolume : public QObject
   void collectBrickInformation(bool force=false);
   void updateAndLoadPruneTexture();
   void updateAndLoadLightTexture();
+  void updateOccupancy();
   void loadTextureMemory();  
   void loadDragTexture();  
   void updateScaling();
@@ -147,6 +151,12 @@ class DrawHiresVolume : public QObject
 
   void saveForDrishtiPrayog(QString);
 
+  // times slice polygon generation for the current view
+  QString benchmarkSliceGeometry(int);
+
+  // per stage timings of the last texture load
+  QString textureLoadStatistics();
+
   void createDefaultShader();
 
  signals :
@@ -211,6 +221,14 @@ class DrawHiresVolume : public QObject
   int m_loadFromDisk;
   QList<Vec> m_textureSlab;
 
+  SlabLoader m_slabLoader;
+  GLuint m_unpackBuffer[2];
+  QString m_loadStatistics;
+
+  OccupancyTree m_occupancy;
+  QList<bool> m_slabOccupied;
+  QList<Vec> m_slabOccMin, m_slabOccMax;
+
   GLhandleARB m_lutShader;
   GLhandleARB m_passthruShader;
   GLhandleARB m_defaultShader;
@@ -224,7 +242,7 @@ class DrawHiresVolume : public QObject
   GLint m_backplaneParm1[50];
   GLint m_backplaneParm2[50];
 
-  QList<ViewAlignedPolygon*> m_polygon;
+  SliceGeometry m_sliceGeometry;
 
   Vec m_enclosingBox[8];
   Vec m_axisArrow[3];
@@ -297,6 +315,8 @@ class DrawHiresVolume : public QObject
   void drawBackground();
 
   void clipSlab(Vec, Vec, int&, Vec*, Vec*, Vec*);
+  void clipToBox(Vec, Vec, ViewAlignedPolygon*);
+  void addSlabToOccupancy(uchar*, int, int, int, int, int);
 
   QList<int> getSlices(Vec, Vec, Vec, int);
 
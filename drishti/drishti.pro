@@ -4,6 +4,7 @@ RESOURCES = drishti.qrc
 
 QT += opengl xml network
 QT += multimedia multimediawidgets
+QT += concurrent
 
 CONFIG += release
 
@@ -91,9 +92,16 @@ LIBS += -lGLEW -lnetcdf -lnetcdf_c++ -framework QGLViewer -framework GLUT
 
 
 
+# benchmark helpers shared with the tools
+INCLUDEPATH += ../common
+
 # Input
-HEADERS += boundingbox.h \
+HEADERS += ../common/benchmarkdata.h \
+	   benchmark.h \
+	   binarycache.h \
+	   boundingbox.h \
            blendshaderfactory.h \
+	   blobstore.h \
 	   brickinformation.h \
 	   bricks.h \
 	   brickswidget.h \
@@ -111,6 +119,7 @@ HEADERS += boundingbox.h \
 	   clipobject.h \
 	   clipgrabber.h \
 	   coloreditor.h \
+	   componentlabeller.h \
 	   connectbricks.h \
 	   connectbrickswidget.h \	
 	   connectclipplanes.h \
@@ -128,6 +137,7 @@ HEADERS += boundingbox.h \
 	   connectvolinfowidget.h \
 	   crops.h \
 	   cropobject.h \
+	   cropmask.h \
 	   cropgrabber.h \
            cropshaderfactory.h \
            dcolordialog.h \
@@ -144,6 +154,7 @@ HEADERS += boundingbox.h \
            glewinitialisation.h \
            global.h \
            glowshaderfactory.h \
+	   gradientprovider.h \
            gradienteditor.h \
            gradienteditorwidget.h \
 	   grids.h \
@@ -174,6 +185,8 @@ HEADERS += boundingbox.h \
 	   networks.h \
 	   networkgrabber.h \
 	   networkobject.h \
+	   networkreader.h \
+	   occupancytree.h \
 	   opacityeditor.h \
 	   paintball.h \
 	   propertyeditor.h \
@@ -183,6 +196,8 @@ HEADERS += boundingbox.h \
 	   pathgroups.h \
 	   pathgroupobject.h \
 	   pathgroupgrabber.h \
+	   pathbvh.h \
+	   pathcache.h \
 	   pathshaderfactory.h \
 	   ply.h \
 	   plugininterface.h \
@@ -190,6 +205,7 @@ HEADERS += boundingbox.h \
 	   preferenceswidget.h \
 	   profileviewer.h \
            prunehandler.h \
+	   pruneengine.h \
            pruneshaderfactory.h \
 	   rawvolume.h \
 	   saveimageseqdialog.h \
@@ -200,6 +216,8 @@ HEADERS += boundingbox.h \
            shaderfactory.h \
            shaderfactory2.h \
            shaderfactoryrgb.h \
+	   slabloader.h \
+	   slicegeometry.h \
            splineeditor.h \
            splineeditorwidget.h \
 	   splineinformation.h \
@@ -208,6 +226,7 @@ HEADERS += boundingbox.h \
 	   tagcoloreditor.h \
            tearshaderfactory.h \
 	   tick.h \
+	   timestepcache.h \
            transferfunctioncontainer.h \
            transferfunctioneditorwidget.h \
            transferfunctionmanager.h \
@@ -215,6 +234,8 @@ HEADERS += boundingbox.h \
 	   trisets.h \
 	   trisetgrabber.h \
 	   trisetobject.h \
+	   meshstore.h \
+	   meshreader.h \
            viewer.h \
 	   viewinformation.h \
 	   viewseditor.h \
@@ -231,6 +252,7 @@ HEADERS += boundingbox.h \
 	   16bit/remaphistogramwidget.h \
 	   mopplugininterface.h \
 	   itksegmentation.h \
+	   lightengine.h \
            lighthandler.h \
            lightshaderfactory.h \
 	   gilights.h \
@@ -240,8 +262,12 @@ HEADERS += boundingbox.h \
 	   gilightobjectinfo.h \
 	   videoplayer.h
 
-SOURCES += boundingbox.cpp \
+SOURCES += ../common/benchmarkdata.cpp \
+	   benchmark.cpp \
+	   binarycache.cpp \
+	   boundingbox.cpp \
            blendshaderfactory.cpp \
+	   blobstore.cpp \
 	   brickinformation.cpp \
 	   bricks.cpp \
 	   brickswidget.cpp \
@@ -259,8 +285,10 @@ SOURCES += boundingbox.cpp \
 	   clipobject.cpp \
 	   clipgrabber.cpp \
 	   coloreditor.cpp \
+	   componentlabeller.cpp \
 	   crops.cpp \
 	   cropobject.cpp \
+	   cropmask.cpp \
 	   cropgrabber.cpp \
            cropshaderfactory.cpp \
            dcolordialog.cpp \
@@ -276,6 +304,7 @@ SOURCES += boundingbox.cpp \
            glewinitialisation.cpp \
            global.cpp \
            glowshaderfactory.cpp \
+	   gradientprovider.cpp \
            gradienteditor.cpp \
            gradienteditorwidget.cpp \
 	   grids.cpp \
@@ -307,6 +336,8 @@ SOURCES += boundingbox.cpp \
 	   networks.cpp \
 	   networkgrabber.cpp \
 	   networkobject.cpp \
+	   networkreader.cpp \
+	   occupancytree.cpp \
 	   opacityeditor.cpp \
 	   paintball.cpp \
 	   propertyeditor.cpp \
@@ -316,12 +347,15 @@ SOURCES += boundingbox.cpp \
 	   pathgroups.cpp \
 	   pathgroupobject.cpp \
 	   pathgroupgrabber.cpp \
+	   pathbvh.cpp \
+	   pathcache.cpp \
 	   pathshaderfactory.cpp \
 	   ply.c \
 	   pluginthread.cpp \
 	   preferenceswidget.cpp \
 	   profileviewer.cpp \
            prunehandler.cpp \
+	   pruneengine.cpp \
            pruneshaderfactory.cpp \
 	   rawvolume.cpp \
 	   saveimageseqdialog.cpp \
@@ -332,6 +366,8 @@ SOURCES += boundingbox.cpp \
            shaderfactory.cpp \
            shaderfactory2.cpp \
            shaderfactoryrgb.cpp \
+	   slabloader.cpp \
+	   slicegeometry.cpp \
            splineeditor.cpp \
            splineeditorwidget.cpp \
 	   splineinformation.cpp \
@@ -340,6 +376,7 @@ SOURCES += boundingbox.cpp \
 	   tagcoloreditor.cpp \
            tearshaderfactory.cpp \
 	   tick.cpp \
+	   timestepcache.cpp \
            transferfunctioncontainer.cpp \
            transferfunctioneditorwidget.cpp \
            transferfunctionmanager.cpp \
@@ -347,6 +384,8 @@ SOURCES += boundingbox.cpp \
 	   trisets.cpp \
 	   trisetgrabber.cpp \
 	   trisetobject.cpp \
+	   meshstore.cpp \
+	   meshreader.cpp \
            viewer.cpp \
 	   viewinformation.cpp \
 	   viewseditor.cpp \
@@ -362,6 +401,7 @@ SOURCES += boundingbox.cpp \
 	   16bit/remaphistogramline.cpp \
 	   16bit/remaphistogramwidget.cpp \
 	   itksegmentation.cpp \
+	   lightengine.cpp \
            lighthandler.cpp \
            lightshaderfactory.cpp \
 	   gilights.cpp \
@@ -969,6 +969,10 @@ QString Global::m_tempDir = "";
 QString Global::tempDir() { return m_tempDir; }
 void Global::setTempDir(QString d) { m_tempDir = d; }
 
+QString Global::m_cacheDir = "";
+QString Global::cacheDir() { return m_cacheDir; }
+void Global::setCacheDir(QString d) { m_cacheDir = d; }
+
 int Global::m_floatPrecision = 2;
 int Global::floatPrecision() { return m_floatPrecision; }
 void Global::setFloatPrecision(int p) { m_floatPrecision = qMax(0, p); }
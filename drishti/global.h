@@ -255,6 +255,9 @@ class Global
   static QString tempDir();
   static void setTempDir(QString);
 
+  static QString cacheDir();
+  static void setCacheDir(QString);
+
   static int floatPrecision();
   static void setFloatPrecision(int);
 
@@ -376,6 +379,7 @@ class Global
   static bool m_batchMode;
 
   static QString m_tempDir;
+  static QString m_cacheDir;
 
   static int m_floatPrecision;
   static int m_geoRenderSteps;
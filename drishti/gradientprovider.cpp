@@ -0,0 +1,409 @@
+#include "gradientprovider.h"
+
+#include <math.h>
+#include <QtConcurrentMap>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+GradientProvider::GradientProvider()
+{
+  m_vfm = 0;
+  m_bpv = 1;
+  m_operator = CentralDifference;
+  m_depth = m_width = m_height = 0;
+  m_slabDepth = 16;
+  m_memoryLimit = 256*1024*1024;
+  m_hits = m_misses = 0;
+}
+
+GradientProvider::~GradientProvider()
+{
+  clear();
+}
+
+int GradientProvider::hits() { return m_hits; }
+int GradientProvider::misses() { return m_misses; }
+
+void
+GradientProvider::clear()
+{
+  QMap<int, uchar*>::iterator it;
+  for(it=m_slabs.begin(); it!=m_slabs.end(); it++)
+    delete [] it.value();
+  m_slabs.clear();
+  m_lru.clear();
+  m_hits = m_misses = 0;
+}
+
+void
+GradientProvider::setVolume(VolumeFileManager *vfm, int voxelType)
+{
+  clear();
+
+  m_vfm = vfm;
+  m_bpv = (voxelType > 0 ? 2 : 1);
+  if (m_vfm)
+    {
+      m_depth = m_vfm->depth();
+      m_width = m_vfm->width();
+      m_height = m_vfm->height();
+    }
+  else
+    m_depth = m_width = m_height = 0;
+}
+
+void
+GradientProvider::setOperator(int op)
+{
+  if (op == m_operator)
+    return;
+
+  clear();
+  m_operator = op;
+}
+
+void
+GradientProvider::setSlabDepth(int d)
+{
+  d = qMax(1, d);
+  if (d == m_slabDepth)
+    return;
+
+  clear();
+  m_slabDepth = d;
+}
+
+void
+GradientProvider::setMemoryLimit(int mb)
+{
+  m_memoryLimit = (qint64)qMax(1, mb)*1024*1024;
+}
+
+qint64
+GradientProvider::sliceBytes()
+{
+  return (qint64)m_bpv*m_width*m_height;
+}
+
+//---------------------------------------
+// 3x3x3 sobel - difference along one axis smoothed with 1 2 1
+// weights along the other two, divided by 16 so that values
+// are on the same scale as central differences
+//---------------------------------------
+void
+GradientProvider::sobelVector(uchar *g0, uchar *g1, uchar *g2,
+			      int nx, int bpv, int i, int j,
+			      float &gx, float &gy, float &gz)
+{
+  static const int w[3] = { 1, 2, 1 };
+  uchar *g[3] = { g0, g1, g2 };
+
+  int sx = 0, sy = 0, sz = 0;
+  for(int c=0; c<3; c++)
+    for(int b=0; b<3; b++)
+      {
+	int wt = w[c]*w[b];
+	qint64 xm, xp, ym, yp;
+	// x difference, smoothed along y (b) and z (c)
+	xm = (qint64)(j-1+b)*nx + i-1;
+	xp = xm + 2;
+	// y difference, smoothed along x (b) and z (c)
+	ym = (qint64)(j-1)*nx + i-1+b;
+	yp = ym + 2*nx;
+	if (bpv == 1)
+	  {
+	    sx += wt*(g[c][xp] - g[c][xm]);
+	    sy += wt*(g[c][yp] - g[c][ym]);
+	  }
+	else
+	  {
+	    sx += wt*(((ushort*)g[c])[xp] - ((ushort*)g[c])[xm]);
+	    sy += wt*(((ushort*)g[c])[yp] - ((ushort*)g[c])[ym]);
+	  }
+      }
+  // z difference, smoothed along x (b) and y (c)
+  for(int c=0; c<3; c++)
+    for(int b=0; b<3; b++)
+      {
+	qint64 idx = (qint64)(j-1+c)*nx + i-1+b;
+	if (bpv == 1)
+	  sz += w[c]*w[b]*(g2[idx] - g0[idx]);
+	else
+	  sz += w[c]*w[b]*(((ushort*)g2)[idx] - ((ushort*)g0)[idx]);
+      }
+
+  gx = sx/16.0f;
+  gy = sy/16.0f;
+  gz = sz/16.0f;
+}
+
+void
+GradientProvider::gradientMagnitude(uchar *g0, uchar *g1, uchar *g2,
+				    int nx, int ny, int bpv,
+				    uchar *out, int op)
+{
+  memset(out, 0, (qint64)bpv*nx*ny);
+  if (nx < 3 || ny < 3)
+    return;
+
+  if (op == Sobel)
+    {
+      int gmax = (bpv == 1 ? 255 : 65535);
+      for(int j=1; j<ny-1; j++)
+	for(int i=1; i<nx-1; i++)
+	  {
+	    float gx, gy, gz;
+	    sobelVector(g0, g1, g2, nx, bpv, i, j, gx, gy, gz);
+	    int gsum = sqrtf(gx*gx+gy*gy+gz*gz);
+	    gsum = qMin(gsum, gmax);
+	    if (bpv == 1)
+	      out[j*nx+i] = gsum;
+	    else
+	      ((ushort*)out)[j*nx+i] = gsum;
+	  }
+      return;
+    }
+
+  if (bpv == 1)
+    {
+      for(int j=1; j<ny-1; j++)
+	{
+	  uchar *c = g1 + j*nx;
+	  uchar *u = g1 + (j+1)*nx;
+	  uchar *d = g1 + (j-1)*nx;
+	  uchar *f = g2 + j*nx;
+	  uchar *b = g0 + j*nx;
+	  uchar *o = out + j*nx;
+
+	  int i = 1;
+#if defined(__SSE2__)
+	  // 8 voxels at a time - squares are exact in float and
+	  // sqrt/truncation match the scalar path below
+	  __m128i zero = _mm_setzero_si128();
+	  for(; i+8<=nx-1; i+=8)
+	    {
+	      __m128i xp = _mm_unpacklo_epi8(_mm_loadl_epi64((__m128i*)(c+i+1)), zero);
+	      __m128i xm = _mm_unpacklo_epi8(_mm_loadl_epi64((__m128i*)(c+i-1)), zero);
+	      __m128i yp = _mm_unpacklo_epi8(_mm_loadl_epi64((__m128i*)(u+i)), zero);
+	      __m128i ym = _mm_unpacklo_epi8(_mm_loadl_epi64((__m128i*)(d+i)), zero);
+	      __m128i zp = _mm_unpacklo_epi8(_mm_loadl_epi64((__m128i*)(f+i)), zero);
+	      __m128i zm = _mm_unpacklo_epi8(_mm_loadl_epi64((__m128i*)(b+i)), zero);
+	      __m128i gx = _mm_sub_epi16(xp, xm);
+	      __m128i gy = _mm_sub_epi16(yp, ym);
+	      __m128i gz = _mm_sub_epi16(zp, zm);
+
+	      __m128i res[2];
+	      for(int h=0; h<2; h++)
+		{
+		  __m128i ax, ay, az;
+		  if (h == 0)
+		    {
+		      ax = _mm_srai_epi32(_mm_unpacklo_epi16(gx, gx), 16);
+		      ay = _mm_srai_epi32(_mm_unpacklo_epi16(gy, gy), 16);
+		      az = _mm_srai_epi32(_mm_unpacklo_epi16(gz, gz), 16);
+		    }
+		  else
+		    {
+		      ax = _mm_srai_epi32(_mm_unpackhi_epi16(gx, gx), 16);
+		      ay = _mm_srai_epi32(_mm_unpackhi_epi16(gy, gy), 16);
+		      az = _mm_srai_epi32(_mm_unpackhi_epi16(gz, gz), 16);
+		    }
+		  __m128 fx = _mm_cvtepi32_ps(ax);
+		  __m128 fy = _mm_cvtepi32_ps(ay);
+		  __m128 fz = _mm_cvtepi32_ps(az);
+		  __m128 s = _mm_add_ps(_mm_add_ps(_mm_mul_ps(fx, fx),
+						   _mm_mul_ps(fy, fy)),
+					_mm_mul_ps(fz, fz));
+		  res[h] = _mm_cvttps_epi32(_mm_sqrt_ps(s));
+		}
+	      __m128i g16 = _mm_packs_epi32(res[0], res[1]);
+	      _mm_storel_epi64((__m128i*)(o+i), _mm_packus_epi16(g16, g16));
+	    }
+#endif
+	  for(; i<nx-1; i++)
+	    {
+	      int gx = c[i+1] - c[i-1];
+	      int gy = u[i] - d[i];
+	      int gz = f[i] - b[i];
+	      int gsum = sqrtf(gx*gx+gy*gy+gz*gz);
+	      o[i] = qBound(0, gsum, 255);
+	    }
+	}
+    }
+  else
+    {
+      ushort *s0 = (ushort*)g0;
+      ushort *s1 = (ushort*)g1;
+      ushort *s2 = (ushort*)g2;
+      ushort *o = (ushort*)out;
+      for(int j=1; j<ny-1; j++)
+	for(int i=1; i<nx-1; i++)
+	  {
+	    int idx = j*nx+i;
+	    float gx = s1[idx+1] - s1[idx-1];
+	    float gy = s1[idx+nx] - s1[idx-nx];
+	    float gz = s2[idx] - s0[idx];
+	    int gsum = sqrtf(gx*gx+gy*gy+gz*gz);
+	    o[idx] = qMin(gsum, 65535);
+	  }
+    }
+}
+
+void
+GradientProvider::gradientDirection(uchar *g0, uchar *g1, uchar *g2,
+				    int nx, int ny, int bpv,
+				    float *out, int op)
+{
+  memset(out, 0, (qint64)3*nx*ny*sizeof(float));
+  if (nx < 3 || ny < 3)
+    return;
+
+  for(int j=1; j<ny-1; j++)
+    for(int i=1; i<nx-1; i++)
+      {
+	qint64 idx = (qint64)j*nx+i;
+	float gx, gy, gz;
+	if (op == Sobel)
+	  sobelVector(g0, g1, g2, nx, bpv, i, j, gx, gy, gz);
+	else if (bpv == 1)
+	  {
+	    gx = g1[idx+1] - g1[idx-1];
+	    gy = g1[idx+nx] - g1[idx-nx];
+	    gz = g2[idx] - g0[idx];
+	  }
+	else
+	  {
+	    ushort *s1 = (ushort*)g1;
+	    gx = s1[idx+1] - s1[idx-1];
+	    gy = s1[idx+nx] - s1[idx-nx];
+	    gz = ((ushort*)g2)[idx] - ((ushort*)g0)[idx];
+	  }
+
+	float len = sqrtf(gx*gx+gy*gy+gz*gz);
+	if (len > 0)
+	  {
+	    out[3*idx+0] = gx/len;
+	    out[3*idx+1] = gy/len;
+	    out[3*idx+2] = gz/len;
+	  }
+      }
+}
+
+void
+GradientProvider::computeSlice(SliceJob &job)
+{
+  if (job.g0 == 0) // first or last slice of the volume
+    memset(job.out, 0, (qint64)job.bpv*job.nx*job.ny);
+  else
+    gradientMagnitude(job.g0, job.g1, job.g2,
+		      job.nx, job.ny, job.bpv,
+		      job.out, job.op);
+}
+
+uchar*
+GradientProvider::computeSlab(int slab)
+{
+  qint64 nbytes = sliceBytes();
+  int k0 = slab*m_slabDepth;
+  int k1 = qMin(m_depth-1, k0+m_slabDepth-1);
+  int nslc = k1-k0+1;
+
+  // volume slices k0-1 .. k1+1
+  int r0 = qMax(0, k0-1);
+  int r1 = qMin(m_depth-1, k1+1);
+  uchar *vol = new uchar[(r1-r0+1)*nbytes];
+  for(int k=r0; k<=r1; k++)
+    memcpy(vol + (k-r0)*nbytes, m_vfm->getSlice(k), nbytes);
+
+  uchar *grad = new uchar[nslc*nbytes];
+
+  QList<SliceJob> jobs;
+  for(int k=k0; k<=k1; k++)
+    {
+      SliceJob job;
+      job.nx = m_height;
+      job.ny = m_width;
+      job.bpv = m_bpv;
+      job.op = m_operator;
+      job.out = grad + (k-k0)*nbytes;
+      if (k == 0 || k == m_depth-1)
+	job.g0 = job.g1 = job.g2 = 0;
+      else
+	{
+	  job.g0 = vol + (k-1-r0)*nbytes;
+	  job.g1 = vol + (k-r0)*nbytes;
+	  job.g2 = vol + (k+1-r0)*nbytes;
+	}
+      jobs << job;
+    }
+  QtConcurrent::blockingMap(jobs, GradientProvider::computeSlice);
+
+  delete [] vol;
+
+  return grad;
+}
+
+uchar*
+GradientProvider::getSlice(int k)
+{
+  if (!m_vfm || k < 0 || k >= m_depth)
+    return 0;
+
+  int slab = k/m_slabDepth;
+  uchar *grad;
+  if (m_slabs.contains(slab))
+    {
+      m_hits++;
+      grad = m_slabs[slab];
+      m_lru.removeOne(slab);
+      m_lru.append(slab);
+    }
+  else
+    {
+      m_misses++;
+
+      // evict least recently used slabs, always keep room for one
+      qint64 slabBytes = m_slabDepth*sliceBytes();
+      while (m_lru.count() > 0 &&
+	     (m_lru.count()+1)*slabBytes > m_memoryLimit)
+	{
+	  int s = m_lru.takeFirst();
+	  delete [] m_slabs[s];
+	  m_slabs.remove(s);
+	}
+
+      grad = computeSlab(slab);
+      m_slabs[slab] = grad;
+      m_lru.append(slab);
+    }
+
+  return grad + (k-slab*m_slabDepth)*sliceBytes();
+}
+
+bool
+GradientProvider::getDirectionSlice(int k, float *out)
+{
+  if (!m_vfm || k < 0 || k >= m_depth)
+    return false;
+
+  qint64 nbytes = sliceBytes();
+  if (k == 0 || k == m_depth-1)
+    {
+      memset(out, 0, (qint64)3*m_width*m_height*sizeof(float));
+      return true;
+    }
+
+  uchar *vol = new uchar[3*nbytes];
+  for(int i=0; i<3; i++)
+    memcpy(vol + i*nbytes, m_vfm->getSlice(k-1+i), nbytes);
+
+  gradientDirection(vol, vol+nbytes, vol+2*nbytes,
+		    m_height, m_width, m_bpv,
+		    out, m_operator);
+
+  delete [] vol;
+
+  return true;
+}
@@ -0,0 +1,86 @@
+#ifndef GRADIENTPROVIDER_H
+#define GRADIENTPROVIDER_H
+
+#include <QMap>
+#include <QList>
+
+#include "volumefilemanager.h"
+
+//---------------------------------------
+// central-difference or sobel gradient magnitude computed on
+// demand from the volume file in slabs of slices.  recently
+// used slabs are kept in an LRU cache, so nothing is written
+// to the temporary directory.
+//---------------------------------------
+class GradientProvider
+{
+ public :
+  GradientProvider();
+  ~GradientProvider();
+
+  enum Operator
+  {
+    CentralDifference = 0,
+    Sobel
+  };
+
+  // gradient magnitude for the middle slice g1 given
+  // slices g0 and g2 on either side; border voxels are 0.
+  // slices are nx*ny with x varying fastest, bpv 1 or 2
+  static void gradientMagnitude(uchar*, uchar*, uchar*,
+				int, int, int,
+				uchar*, int op = CentralDifference);
+
+  // unit gradient direction (x, y, z per voxel) for the
+  // middle slice, zero where the gradient vanishes
+  static void gradientDirection(uchar*, uchar*, uchar*,
+				int, int, int,
+				float*, int op = CentralDifference);
+
+  void setVolume(VolumeFileManager*, int);
+  void setOperator(int);
+  void setSlabDepth(int);
+  void setMemoryLimit(int);
+  void clear();
+
+  // gradient magnitude slice, same layout as the volume slice.
+  // pointer is valid until the next call
+  uchar* getSlice(int);
+
+  // direction for slice k into a 3*width*height buffer,
+  // not cached because it is 12 bytes per voxel
+  bool getDirectionSlice(int, float*);
+
+  int hits();
+  int misses();
+
+ private :
+  struct SliceJob
+  {
+    uchar *g0, *g1, *g2;
+    uchar *out;
+    int nx, ny, bpv, op;
+  };
+
+  VolumeFileManager *m_vfm;
+  int m_bpv;
+  int m_operator;
+  int m_depth, m_width, m_height;
+  int m_slabDepth;
+  qint64 m_memoryLimit;
+
+  QMap<int, uchar*> m_slabs;
+  QList<int> m_lru;
+
+  int m_hits, m_misses;
+
+  qint64 sliceBytes();
+  uchar* computeSlab(int);
+
+  static void computeSlice(SliceJob&);
+  static void sobelVector(uchar*, uchar*, uchar*,
+			  int, int, int, int,
+			  float&, float&, float&);
+};
+
+#endif
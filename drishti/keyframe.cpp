@@ -1292,6 +1292,14 @@ KeyFrame::load(fstream &fin)
   // ----------------------------------
 }
 
+void
+KeyFrame::storeBlobs()
+{
+  m_savedKeyFrame.storeBlobs();
+  for(int kf=0; kf<numberOfKeyFrames(); kf++)
+    m_keyFrameInfo[kf]->storeBlobs();
+}
+
 void
 KeyFrame::save(fstream& fout)
 {
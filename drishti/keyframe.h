@@ -18,6 +18,9 @@ class KeyFrame : public QObject
 
   void save(fstream&);
 
+  // register keyframe buffers with the blob store before saving
+  void storeBlobs();
+
   void draw(float);
 
   KeyFrameInformation interpolate(int);
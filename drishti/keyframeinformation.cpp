@@ -1,6 +1,7 @@
 #include "keyframeinformation.h"
 #include "global.h"
 #include "enums.h"
+#include "blobstore.h"
 
 void KeyFrameInformation::setTitle(QString s) { m_title = s; }
 void KeyFrameInformation::setDrawBox(bool flag) { m_drawBox = flag; }
@@ -17,16 +18,21 @@ void KeyFrameInformation::setPosition(Vec pos) { m_position = pos; }
 void KeyFrameInformation::setOrientation(Quaternion rot) { m_rotation = rot; }
 void KeyFrameInformation::setLut(unsigned char* lut)
 {
-  if (!m_lut)
-    m_lut = new unsigned char[Global::lutSize()*256*256*4];
-  memcpy(m_lut, lut, Global::lutSize()*256*256*4);
+  BlobStore::release(m_lutKey);
+  m_lutKey.clear();
+  m_lut = QByteArray((char*)lut, Global::lutSize()*256*256*4);
 }
 void KeyFrameInformation::setLandmarkInfo(LandmarkInformation li) { m_landmarkInfo = li; }
 void KeyFrameInformation::setLightInfo(LightingInformation li) { m_lightInfo = li; }
 void KeyFrameInformation::setGiLightInfo(GiLightInfo li) { m_giLightInfo = li; }
 void KeyFrameInformation::setClipInfo(ClipInformation ci) { m_clipInfo = ci; }
 void KeyFrameInformation::setVolumeBounds(Vec bmin, Vec bmax) { m_volMin = bmin; m_volMax = bmax; }
-void KeyFrameInformation::setImage(QImage pix) { m_image = pix; }
+void KeyFrameInformation::setImage(QImage pix)
+{
+  BlobStore::release(m_imageKey);
+  m_imageKey.clear();
+  m_image = pix;
+}
 void KeyFrameInformation::setSplineInfo(QList<SplineInformation> si) { m_splineInfo = si; }
 void KeyFrameInformation::setTick(int sz, int st,
 				  QString xl, QString yl, QString zl)
@@ -63,7 +69,12 @@ void KeyFrameInformation::setPathGroups(QList<PathGroupObject> paths) { m_pathgr
 void KeyFrameInformation::setTrisets(QList<TrisetInformation> tinfo) { m_trisets = tinfo; }
 void KeyFrameInformation::setNetworks(QList<NetworkInformation> ninfo) { m_networks = ninfo; }
 void KeyFrameInformation::setTagColors(unsigned char* tc) { memcpy(m_tagColors, tc, 1024); }
-void KeyFrameInformation::setPruneBuffer(QByteArray pb) { m_pruneBuffer = pb; }
+void KeyFrameInformation::setPruneBuffer(QByteArray pb)
+{
+  BlobStore::release(m_pruneKey);
+  m_pruneKey.clear();
+  m_pruneBuffer = pb;
+}
 void KeyFrameInformation::setPruneBlend(bool pb) { m_pruneBlend = pb; }
 
 
@@ -81,13 +92,39 @@ int KeyFrameInformation::volumeNumber3() { return m_volumeNumber3; }
 int KeyFrameInformation::volumeNumber4() { return m_volumeNumber4; }
 Vec KeyFrameInformation::position() { return m_position; }
 Quaternion KeyFrameInformation::orientation() { return m_rotation; }
-unsigned char* KeyFrameInformation::lut() { return m_lut; }
+unsigned char*
+KeyFrameInformation::lut()
+{
+  if (m_lut.isEmpty() && !m_lutKey.isEmpty())
+    {
+      m_lut = BlobStore::data(m_lutKey);
+      int lsz = Global::lutSize()*256*256*4;
+      if (!m_lut.isEmpty() && m_lut.size() != lsz)
+	m_lut.resize(lsz);
+    }
+
+  // lookup table is shared between copies, it is only read
+  if (m_lut.isEmpty())
+    return 0;
+  return (unsigned char*)m_lut.constData();
+}
 LandmarkInformation KeyFrameInformation::landmarkInfo() { return m_landmarkInfo; }
 LightingInformation KeyFrameInformation::lightInfo() { return m_lightInfo; }
 GiLightInfo KeyFrameInformation::giLightInfo() { return m_giLightInfo; }
 ClipInformation KeyFrameInformation::clipInfo() { return m_clipInfo; }
 void KeyFrameInformation::volumeBounds(Vec &bmin, Vec &bmax) { bmin = m_volMin; bmax = m_volMax; }
-QImage KeyFrameInformation::image() { return m_image; }
+QImage
+KeyFrameInformation::image()
+{
+  if (m_image.isNull() && !m_imageKey.isEmpty())
+    {
+      QByteArray bytes = BlobStore::data(m_imageKey);
+      m_image = QImage::fromData(bytes, "PNG");
+      if (m_image.isNull())
+	m_image = QImage(100, 100, QImage::Format_RGB32);
+    }
+  return m_image;
+}
 QList<SplineInformation> KeyFrameInformation::splineInfo() { return m_splineInfo; }
 void KeyFrameInformation::getTick(int &sz, int &st,
 				  QString &xl, QString &yl, QString &zl)
@@ -122,7 +159,13 @@ QList<PathGroupObject> KeyFrameInformation::pathgroups() { return m_pathgroups;
 QList<TrisetInformation> KeyFrameInformation::trisets() { return m_trisets; }
 QList<NetworkInformation> KeyFrameInformation::networks() { return m_networks; }
 unsigned char* KeyFrameInformation::tagColors() { return m_tagColors; }
-QByteArray KeyFrameInformation::pruneBuffer() { return m_pruneBuffer; }
+QByteArray
+KeyFrameInformation::pruneBuffer()
+{
+  if (m_pruneBuffer.isEmpty() && !m_pruneKey.isEmpty())
+    m_pruneBuffer = BlobStore::data(m_pruneKey);
+  return m_pruneBuffer;
+}
 bool KeyFrameInformation::pruneBlend() { return m_pruneBlend; }
 
 
@@ -189,8 +232,10 @@ KeyFrameInformation::KeyFrameInformation()
   m_volumeNumber4 = 0;
   m_position = Vec(0,0,0);
   m_rotation = Quaternion(Vec(1,0,0), 0);
-  //m_lut = new unsigned char[Global::lutSize()*256*256*4];
-  m_lut = 0;
+  m_lut.clear();
+  m_lutKey.clear();
+  m_pruneKey.clear();
+  m_imageKey.clear();
   m_tagColors = new unsigned char[1024];
   m_pruneBuffer.clear();
   m_pruneBlend = false;
@@ -258,9 +303,8 @@ KeyFrameInformation::clear()
   m_volumeNumber4 = 0;
   m_position = Vec(0,0,0);
   m_rotation = Quaternion(Vec(1,0,0), 0);
-  if (m_lut) delete [] m_lut;
-  m_lut = 0;
-  //m_lut = new unsigned char[Global::lutSize()*256*256*4];
+  releaseBlobKeys();
+  m_lut.clear();
   if (m_tagColors) delete [] m_tagColors;
   m_tagColors = new unsigned char[1024];
   m_pruneBuffer.clear();
@@ -315,6 +359,35 @@ KeyFrameInformation::clear()
   m_interpMop = Enums::KFIT_None;
 }
 
+void
+KeyFrameInformation::releaseBlobKeys()
+{
+  BlobStore::release(m_lutKey);
+  BlobStore::release(m_pruneKey);
+  BlobStore::release(m_imageKey);
+  m_lutKey.clear();
+  m_pruneKey.clear();
+  m_imageKey.clear();
+}
+
+void
+KeyFrameInformation::setBlobKeys(const KeyFrameInformation& kfi)
+{
+  // keys are copied first in case kfi is this keyframe
+  QByteArray lutKey = kfi.m_lutKey;
+  QByteArray pruneKey = kfi.m_pruneKey;
+  QByteArray imageKey = kfi.m_imageKey;
+
+  BlobStore::addRef(lutKey);
+  BlobStore::addRef(pruneKey);
+  BlobStore::addRef(imageKey);
+  releaseBlobKeys();
+
+  m_lutKey = lutKey;
+  m_pruneKey = pruneKey;
+  m_imageKey = imageKey;
+}
+
 KeyFrameInformation::KeyFrameInformation(const KeyFrameInformation& kfi)
 {
   m_title = kfi.m_title;
@@ -338,8 +411,8 @@ KeyFrameInformation::KeyFrameInformation(const KeyFrameInformation& kfi)
   m_position = kfi.m_position;
   m_rotation = kfi.m_rotation;
 
-  m_lut = new unsigned char[Global::lutSize()*256*256*4];
-  memcpy(m_lut, kfi.m_lut, Global::lutSize()*256*256*4);
+  m_lut = kfi.m_lut;
+  setBlobKeys(kfi);
 
   m_tagColors = new unsigned char[1024];
   memcpy(m_tagColors, kfi.m_tagColors, 1024);
@@ -409,8 +482,8 @@ KeyFrameInformation::KeyFrameInformation(const KeyFrameInformation& kfi)
 KeyFrameInformation::~KeyFrameInformation()
 {
   m_title.clear();
-  if (m_lut)
-    delete [] m_lut;
+  releaseBlobKeys();
+  m_lut.clear();
   if (m_tagColors)
     delete [] m_tagColors;
   m_clipInfo.clear();
@@ -459,9 +532,8 @@ KeyFrameInformation::operator=(const KeyFrameInformation& kfi)
   m_position = kfi.m_position;
   m_rotation = kfi.m_rotation;
 
-  if (!m_lut)
-    m_lut = new unsigned char[Global::lutSize()*256*256*4];
-  memcpy(m_lut, kfi.m_lut, Global::lutSize()*256*256*4);
+  m_lut = kfi.m_lut;
+  setBlobKeys(kfi);
 
   memcpy(m_tagColors, kfi.m_tagColors, 1024);
 
@@ -533,6 +605,47 @@ KeyFrameInformation::operator=(const KeyFrameInformation& kfi)
 //---- load and save -------------
 //--------------------------------
 
+static QByteArray
+readBlobKey(fstream &fin)
+{
+  int len;
+  fin.read((char*)&len, sizeof(int));
+  QByteArray key(len, 0);
+  fin.read(key.data(), len);
+  return key;
+}
+
+static void
+writeBlobKey(fstream &fout, const char *name, QByteArray key)
+{
+  char keyword[100];
+  memset(keyword, 0, 100);
+  sprintf(keyword, "%s", name);
+  fout.write((char*)keyword, strlen(keyword)+1);
+  int len = key.size();
+  fout.write((char*)&len, sizeof(int));
+  fout.write(key.constData(), len);
+}
+
+void
+KeyFrameInformation::storeBlobs()
+{
+  if (m_lutKey.isEmpty() && !m_lut.isEmpty())
+    m_lutKey = BlobStore::insert(m_lut);
+
+  if (m_pruneKey.isEmpty() && !m_pruneBuffer.isEmpty())
+    m_pruneKey = BlobStore::insert(m_pruneBuffer);
+
+  if (m_imageKey.isEmpty())
+    {
+      QByteArray bytes;
+      QBuffer buffer(&bytes);
+      buffer.open(QIODevice::WriteOnly);
+      m_image.save(&buffer, "PNG");
+      m_imageKey = BlobStore::insert(bytes);
+    }
+}
+
 void
 KeyFrameInformation::load(fstream &fin)
 {
@@ -547,6 +660,9 @@ KeyFrameInformation::load(fstream &fin)
   m_pruneBuffer.clear();
   m_pruneBlend = false;
 
+  releaseBlobKeys();
+  m_lut.clear();
+
   m_interpBGColor = Enums::KFIT_Linear;
   m_interpCaptions = Enums::KFIT_Linear;
   m_interpFocus = Enums::KFIT_Linear;
@@ -639,12 +755,17 @@ KeyFrameInformation::load(fstream &fin)
 	}
       else if (strcmp(keyword, "lookuptable") == 0)
 	{
-	  if (!m_lut)
-	    m_lut = new unsigned char[Global::lutSize()*256*256*4];
 	  int n;
 	  fin.read((char*)&n, sizeof(int));
-	  n = qMin(n, Global::lutSize());
-	  fin.read((char*)m_lut, n*256*256*4);
+	  m_lut = QByteArray(n*256*256*4, 0);
+	  fin.read(m_lut.data(), n*256*256*4);
+	  m_lut.resize(Global::lutSize()*256*256*4);
+	}
+      else if (strcmp(keyword, "lookuptableblob") == 0)
+	{
+	  // fetched from the blob store when first needed
+	  m_lutKey = readBlobKey(fin);
+	  BlobStore::addRef(m_lutKey);
 	}
       else if (strcmp(keyword, "image") == 0)
 	{
@@ -655,6 +776,12 @@ KeyFrameInformation::load(fstream &fin)
 	  m_image = QImage::fromData(tmp, n);	 
 	  delete [] tmp;
 	}
+      else if (strcmp(keyword, "imageblob") == 0)
+	{
+	  m_imageKey = readBlobKey(fin);
+	  BlobStore::addRef(m_imageKey);
+	  m_image = QImage();
+	}
       else if (strcmp(keyword, "landmarks") == 0)
 	m_landmarkInfo.load(fin);
       else if (strcmp(keyword, "lightinginformation") == 0)
@@ -830,6 +957,11 @@ KeyFrameInformation::load(fstream &fin)
 	  m_pruneBuffer = QByteArray(data, n);
 	  delete [] data;
 	}
+      else if (strcmp(keyword, "prunebufferblob") == 0)
+	{
+	  m_pruneKey = readBlobKey(fin);
+	  BlobStore::addRef(m_pruneKey);
+	}
       else if (strcmp(keyword, "interpbgcolor") == 0)
 	fin.read((char*)&m_interpBGColor, sizeof(int));
       else if (strcmp(keyword, "interpcaptions") == 0)
@@ -862,7 +994,7 @@ KeyFrameInformation::load(fstream &fin)
 	fin.read((char*)&m_interpMop, sizeof(int));
     }
 
-  if(pbcompressed)
+  if(pbcompressed && !m_pruneBuffer.isEmpty())
     {
       QByteArray pb;
       pb = qUncompress(m_pruneBuffer);
@@ -1007,26 +1139,11 @@ KeyFrameInformation::save(fstream &fout)
   fout.write((char*)&fangle, sizeof(float));
 
 
-  if (m_lut)
-    {
-      memset(keyword, 0, 100);
-      sprintf(keyword, "lookuptable");
-      fout.write((char*)keyword, strlen(keyword)+1);
-      int n = Global::lutSize();
-      fout.write((char*)&n, sizeof(int));
-      fout.write((char*)m_lut, Global::lutSize()*256*256*4);
-    }
-
-  memset(keyword, 0, 100);
-  sprintf(keyword, "image");
-  fout.write((char*)keyword, strlen(keyword)+1);
-  QByteArray bytes;
-  QBuffer buffer(&bytes);
-  buffer.open(QIODevice::WriteOnly);
-  m_image.save(&buffer, "PNG");
-  int n = bytes.size();
-  fout.write((char*)&n, sizeof(int));
-  fout.write((char*)bytes.data(), n);
+  //-- lookup table and image are written to the blob store
+  storeBlobs();
+  if (!m_lutKey.isEmpty())
+    writeBlobKey(fout, "lookuptableblob", m_lutKey);
+  writeBlobKey(fout, "imageblob", m_imageKey);
 
 
   m_landmarkInfo.save(fout);
@@ -1155,7 +1272,7 @@ KeyFrameInformation::save(fstream &fout)
   fout.write((char*)m_tagColors, 1024);
 
 
-  if (!m_pruneBuffer.isEmpty())
+  if (!m_pruneBuffer.isEmpty() || !m_pruneKey.isEmpty())
     {
       memset(keyword, 0, 100);
       sprintf(keyword, "pruneblend");
@@ -1168,12 +1285,7 @@ KeyFrameInformation::save(fstream &fout)
       fout.write((char*)keyword, strlen(keyword)+1);
       fout.write((char*)&pbc, sizeof(bool));
 
-      int pn = m_pruneBuffer.count();
-      memset(keyword, 0, 100);
-      sprintf(keyword, "prunebuffer");
-      fout.write((char*)keyword, strlen(keyword)+1);
-      fout.write((char*)&pn, sizeof(int));
-      fout.write((char*)m_pruneBuffer.data(), pn);
+      writeBlobKey(fout, "prunebufferblob", m_pruneKey);
     }
   
   //------------------------------------------------------
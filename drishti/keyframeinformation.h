@@ -41,6 +41,9 @@ class KeyFrameInformation
   void load(fstream&);
   void save(fstream&);
 
+  // hand lookup table, prune buffer and image to the blob store
+  void storeBlobs();
+
   void setTitle(QString);
   void setDrawBox(bool);
   void setDrawAxis(bool);
@@ -172,7 +175,7 @@ class KeyFrameInformation
   int m_volumeNumber4;
   Vec m_position;
   Quaternion m_rotation;
-  uchar *m_lut;
+  QByteArray m_lut;
   LightingInformation m_lightInfo;
   GiLightInfo m_giLightInfo;
   ClipInformation m_clipInfo;
@@ -207,6 +210,12 @@ class KeyFrameInformation
   bool m_pruneBlend;
   LandmarkInformation m_landmarkInfo;
 
+  // blob store keys for lookup table, prune buffer and image.
+  // an empty buffer with a valid key is fetched on first use
+  QByteArray m_lutKey, m_pruneKey, m_imageKey;
+  void setBlobKeys(const KeyFrameInformation&);
+  void releaseBlobKeys();
+
   //-- keyframe interpolation parameters
   int m_interpBGColor;
   int m_interpCaptions;
@@ -0,0 +1,967 @@
+#include "lightengine.h"
+
+#include <QThread>
+#include <QtMath>
+#include <QtConcurrentMap>
+
+// stored values are 8 bit just like the light textures
+static inline float
+unorm(uchar v)
+{
+  return v*(1.0f/255.0f);
+}
+
+static inline uchar
+toUnorm(float v)
+{
+  if (!(v > 0.0f)) return 0;
+  if (v >= 1.0f) return 255;
+  return (uchar)(v*255.0f + 0.5f);
+}
+
+// same integer arithmetic as the shaders - z outside the grid
+// ends up in a neighbouring tile or outside the atlas
+static inline void
+tileOrigin(int gridx, int gridy, int ncols, int z, int &ox, int &oy)
+{
+  int row = z/ncols;
+  int col = z - row*ncols;
+  ox = col*gridx;
+  oy = row*gridy;
+}
+
+// clamped atlas rows and tile origins of the 3x3x3 neighbourhood
+// of row y of tile z
+struct TileNbrs
+{
+  int ox[3];
+  int row[3][3];
+};
+
+static inline void
+tileNeighbours(int sX, int sY,
+	       int gridx, int gridy, int ncols,
+	       int y, int z,
+	       TileNbrs &t)
+{
+  for(int k=0; k<3; k++)
+    {
+      int ox, oy;
+      tileOrigin(gridx, gridy, ncols, z+k-1, ox, oy);
+      t.ox[k] = ox;
+      for(int j=0; j<3; j++)
+	t.row[k][j] = qBound(0, oy+y+j-1, sY-1)*sX;
+    }
+}
+
+// unit vectors to the neighbours, i + 3*j + 9*k
+static float nbrDir[27][3];
+// light passing through a texel - (1-opacity)*light
+// indexed by light + 256*opacity
+static float transmitted[256*256];
+static bool tablesInit = false;
+
+static void
+initTables()
+{
+  if (tablesInit)
+    return;
+
+  for(int o=0; o<256; o++)
+    for(int l=0; l<256; l++)
+      transmitted[l + 256*o] = (1.0f-unorm(o))*unorm(l);
+
+  for(int k=-1; k<=1; k++)
+    for(int j=-1; j<=1; j++)
+      for(int i=-1; i<=1; i++)
+	{
+	  int n = 9*(k+1)+3*(j+1)+(i+1);
+	  float len = sqrt((float)(i*i+j*j+k*k));
+	  if (len > 0.1f)
+	    {
+	      nbrDir[n][0] = i/len;
+	      nbrDir[n][1] = j/len;
+	      nbrDir[n][2] = k/len;
+	    }
+	  else
+	    nbrDir[n][0] = nbrDir[n][1] = nbrDir[n][2] = 0;
+	}
+  tablesInit = true;
+}
+
+// sum of table values over x0-x1, y0-y1 (inclusive)
+static inline int
+rectSum(const int *sat, int sX, int x0, int x1, int y0, int y1)
+{
+  int w = sX+1;
+  return (sat[(y1+1)*w + x1+1] - sat[y0*w + x1+1] -
+	  sat[(y1+1)*w + x0] + sat[y0*w + x0]);
+}
+
+// split a-b into texels inside 0-(n-1) and the repeated edge
+// texels that clamped lookups fall on
+static inline int
+clampedSegments(int a, int b, int n, int *s0, int *s1, int *m)
+{
+  if (b < 0)
+    {
+      s0[0] = s1[0] = 0; m[0] = b-a+1;
+      return 1;
+    }
+  if (a > n-1)
+    {
+      s0[0] = s1[0] = n-1; m[0] = b-a+1;
+      return 1;
+    }
+  int ns = 0;
+  if (a < 0)
+    {
+      s0[ns] = s1[ns] = 0; m[ns] = -a;
+      ns++;
+    }
+  s0[ns] = qMax(a, 0); s1[ns] = qMin(b, n-1); m[ns] = 1;
+  ns++;
+  if (b > n-1)
+    {
+      s0[ns] = s1[ns] = n-1; m[ns] = b-(n-1);
+      ns++;
+    }
+  return ns;
+}
+
+// number of texels above threshold seen by clamped lookups
+// over x0-x1, y0-y1
+static inline int
+clampedSum(const int *sat, int sX, int sY,
+	   int x0, int x1, int y0, int y1)
+{
+  int xs0[3], xs1[3], xm[3];
+  int ys0[3], ys1[3], ym[3];
+  int nx = clampedSegments(x0, x1, sX, xs0, xs1, xm);
+  int ny = clampedSegments(y0, y1, sY, ys0, ys1, ym);
+
+  int sum = 0;
+  for(int j=0; j<ny; j++)
+    for(int i=0; i<nx; i++)
+      sum += xm[i]*ym[j]*rectSum(sat, sX, xs0[i], xs1[i], ys0[j], ys1[j]);
+  return sum;
+}
+
+//-------------------------------------------------
+
+LightEngine::LightEngine()
+{
+  m_sX = m_sY = m_dtexX = 0;
+  m_grid.gridx = m_grid.gridy = m_grid.gridz = 0;
+  m_grid.ncols = 1;
+  m_op = 0;
+  m_light[0] = m_light[1] = 0;
+  m_final = 0;
+
+  initTables();
+}
+
+LightEngine::~LightEngine()
+{
+  clear();
+}
+
+void
+LightEngine::clear()
+{
+  if (m_op) delete [] m_op;
+  if (m_light[0]) delete [] m_light[0];
+  if (m_light[1]) delete [] m_light[1];
+  if (m_final) delete [] m_final;
+  m_op = 0;
+  m_light[0] = m_light[1] = 0;
+  m_final = 0;
+  m_sX = m_sY = 0;
+}
+
+int LightEngine::width() { return m_sX; }
+int LightEngine::height() { return m_sY; }
+uchar* LightEngine::finalLight() { return m_final; }
+
+void
+LightEngine::setGrid(int gridx, int gridy, int gridz,
+		     int ncols, int nrows,
+		     int dtexX)
+{
+  int sX = ncols*gridx;
+  int sY = nrows*gridy;
+  if (sX != m_sX || sY != m_sY)
+    {
+      clear();
+      m_sX = sX;
+      m_sY = sY;
+      m_op = new uchar[m_sX*m_sY];
+      m_light[0] = new uchar[2*m_sX*m_sY];
+      m_light[1] = new uchar[2*m_sX*m_sY];
+      m_final = new uchar[4*m_sX*m_sY];
+      memset(m_op, 0, m_sX*m_sY);
+      memset(m_final, 0, 4*m_sX*m_sY);
+    }
+
+  m_grid.gridx = gridx;
+  m_grid.gridy = gridy;
+  m_grid.gridz = gridz;
+  m_grid.ncols = ncols;
+  m_dtexX = dtexX;
+}
+
+void
+LightEngine::setOpacity(uchar *op)
+{
+  memcpy(m_op, op, m_sX*m_sY);
+}
+
+void
+LightEngine::clearFinal()
+{
+  memset(m_final, 0, 4*m_sX*m_sY);
+}
+
+void
+LightEngine::clearLight(int i)
+{
+  memset(m_light[i], 0, 2*m_sX*m_sY);
+}
+
+LightEngine::Layout
+LightEngine::lodLayout(float llod, int &w, int &h)
+{
+  if (llod == 1)
+    {
+      w = m_sX;
+      h = m_sY;
+      return m_grid;
+    }
+
+  Layout lg;
+  lg.gridx = qMax(1, (int)(m_grid.gridx*llod));
+  lg.gridy = qMax(1, (int)(m_grid.gridy*llod));
+  lg.gridz = qMax(1, (int)(m_grid.gridz*llod));
+  lg.ncols = qMax(1, m_dtexX/lg.gridx);
+  int lnrows = 1;
+  if (lg.ncols > lg.gridz)
+    lg.ncols = lg.gridz;
+  else
+    lnrows = lg.gridz/lg.ncols + (lg.gridz%lg.ncols > 0);
+
+  // light textures are only as large as the atlas
+  w = qMin(m_sX, lg.ncols*lg.gridx);
+  h = qMin(m_sY, lnrows*lg.gridy);
+
+  return lg;
+}
+
+bool
+LightEngine::run(Pass &p)
+{
+  int nthreads = qMax(1, QThread::idealThreadCount());
+  int nrows = qMax(1, p.h/(4*nthreads));
+
+  QList<PassJob> jobs;
+  for(int y0=0; y0<p.h; y0+=nrows)
+    {
+      PassJob job;
+      job.pass = &p;
+      job.y0 = y0;
+      job.y1 = qMin(p.h, y0+nrows)-1;
+      job.changed = true;
+      jobs << job;
+    }
+
+  if (jobs.count() == 1)
+    runRows(jobs[0]);
+  else
+    QtConcurrent::blockingMap(jobs, LightEngine::runRows);
+
+  for(int i=0; i<jobs.count(); i++)
+    if (jobs[i].changed)
+      return true;
+  return false;
+}
+
+int
+LightEngine::propagate(Pass &p, int ntimes, int ct)
+{
+  for(int nt=0; nt<ntimes; nt++)
+    {
+      p.in = m_light[ct];
+      p.out = m_light[(ct+1)%2];
+      bool changed = run(p);
+      ct = (ct+1)%2;
+
+      // light front has stopped moving - the remaining
+      // passes would give the same result
+      if (!changed)
+	break;
+    }
+  return ct;
+}
+
+void
+LightEngine::accumulate(int ct, Vec lcol)
+{
+  const uchar *light = m_light[ct];
+  float col[3];
+  col[0] = lcol.x;
+  col[1] = lcol.y;
+  col[2] = lcol.z;
+
+  int n = m_sX*m_sY;
+  for(int i=0; i<n; i++)
+    {
+      float l = unorm(light[2*i]);
+      uchar *f = m_final + 4*i;
+      for(int c=0; c<3; c++)
+	f[c] = toUnorm(unorm(f[c]) + qBound(0.0f, col[c]*l, 1.0f));
+      f[3] = 255;
+    }
+}
+
+void
+LightEngine::runRows(PassJob &job)
+{
+  const Pass *p = job.pass;
+  switch (p->type)
+    {
+    case InitAO : initAO(p, job.y0, job.y1); break;
+    case InitDirectional : initDirectional(p, job.y0, job.y1); break;
+    case Directional : job.changed = directional(p, job.y0, job.y1); break;
+    case InitPoint : initPoint(p, job.y0, job.y1); break;
+    case PointDirections : pointDirections(p, job.y0, job.y1); break;
+    case Point : job.changed = point(p, job.y0, job.y1); break;
+    case Expand : expand(p, job.y0, job.y1); break;
+    case Diffuse : diffuse(p, job.y0, job.y1); break;
+    }
+}
+
+//-------------------------------------------------
+// ambient occlusion
+//-------------------------------------------------
+void
+LightEngine::ambientOcclusion(int orad, float ofrac,
+			      float den1, float den2,
+			      int ntimes, Vec lcol)
+{
+  // count of opaque texels over any window is read from a
+  // summed area table instead of looking at every texel
+  int *sat = new int[(m_sX+1)*(m_sY+1)];
+  memset(sat, 0, (m_sX+1)*sizeof(int));
+  for(int y=0; y<m_sY; y++)
+    {
+      int *srow = sat + (y+1)*(m_sX+1);
+      const int *prow = sat + y*(m_sX+1);
+      const uchar *op = m_op + y*m_sX;
+      int rsum = 0;
+      srow[0] = 0;
+      for(int x=0; x<m_sX; x++)
+	{
+	  rsum += (unorm(op[x]) >= 0.1f);
+	  srow[x+1] = prow[x+1] + rsum;
+	}
+    }
+
+  Pass p;
+  p.type = InitAO;
+  p.sX = m_sX;
+  p.sY = m_sY;
+  p.w = m_sX;
+  p.h = m_sY;
+  p.grid = m_grid;
+  p.op = m_op;
+  p.sat = sat;
+  p.orad = orad;
+  p.ofrac = ofrac;
+  p.den1 = den1;
+  p.den2 = den2;
+  p.out = m_light[1];
+  run(p);
+
+  delete [] sat;
+
+  p.type = Diffuse;
+  int ct = propagate(p, ntimes-1, 1);
+
+  accumulate(ct, lcol);
+}
+
+void
+LightEngine::initAO(const Pass *p, int y0, int y1)
+{
+  int sX = p->sX;
+  int sY = p->sY;
+  int gridx = p->grid.gridx;
+  int gridy = p->grid.gridy;
+  int gridz = p->grid.gridz;
+  int ncols = p->grid.ncols;
+  int orad = p->orad;
+  float ni = 2*orad+1;
+  float e1 = ni*ni*ni*p->ofrac;
+
+  int *ox = new int[2*orad+1];
+  int *oy = new int[2*orad+1];
+  int lastz = -1;
+
+  for(int ty=y0; ty<=y1; ty++)
+    for(int tx=0; tx<p->w; tx++)
+      {
+	int col = tx/gridx;
+	int row = ty/gridy;
+	int x = tx - col*gridx;
+	int y = ty - row*gridy;
+	int z = row*ncols + col;
+
+	int idx = ty*sX + tx;
+	uchar op = p->op[idx];
+
+	if (x < 1 || y < 1 || z < 1 ||
+	    x > gridx-2 || y > gridy-2 || z > gridz-2)
+	  {
+	    p->out[2*idx] = 255;
+	    p->out[2*idx+1] = op;
+	    continue;
+	  }
+
+	if (z != lastz)
+	  {
+	    for(int k=-orad; k<=orad; k++)
+	      tileOrigin(gridx, gridy, ncols, z+k, ox[k+orad], oy[k+orad]);
+	    lastz = z;
+	  }
+
+	int fop = 0;
+	for(int k=0; k<=2*orad; k++)
+	  fop += clampedSum(p->sat, sX, sY,
+			    ox[k]+x-orad, ox[k]+x+orad,
+			    oy[k]+y-orad, oy[k]+y+orad);
+
+	float t;
+	if (e1 > 0)
+	  {
+	    t = qBound(0.0f, fop/e1, 1.0f);
+	    t = t*t*(3.0f-2.0f*t);
+	  }
+	else
+	  t = (fop > 0 ? 1.0f : 0.0f);
+	float den = p->den2 + (p->den1-p->den2)*t;
+
+	p->out[2*idx] = toUnorm(den);
+	p->out[2*idx+1] = op;
+      }
+
+  delete [] ox;
+  delete [] oy;
+}
+
+//-------------------------------------------------
+// directional light
+//-------------------------------------------------
+void
+LightEngine::directionalLight(Vec ldir, float cangle, Vec lcol,
+			      float llod, int smooth)
+{
+  int lw, lh;
+  Layout lg = lodLayout(llod, lw, lh);
+
+  Pass p;
+  p.type = InitDirectional;
+  p.sX = m_sX;
+  p.sY = m_sY;
+  p.w = m_sX;
+  p.h = m_sY;
+  p.grid = lg;
+  p.src = m_grid;
+  p.lod = llod;
+  p.op = m_op;
+  p.ldir = ldir;
+  p.cangle = cangle;
+  p.out = m_light[1];
+  run(p);
+
+  clearLight(0);
+
+  p.nwt = 0;
+  for(int n=0; n<27; n++)
+    {
+      float dotdl = (nbrDir[n][0]*ldir.x +
+		     nbrDir[n][1]*ldir.y +
+		     nbrDir[n][2]*ldir.z);
+      if (n != 13 && dotdl > cangle)
+	{
+	  p.wtidx[p.nwt] = n;
+	  p.wt[p.nwt] = dotdl;
+	  p.nwt++;
+	}
+    }
+
+  // propagation runs with the full light grid like the shader does
+  p.type = Directional;
+  p.grid = m_grid;
+  int ntimes = qMax(lg.gridx, qMax(lg.gridy, lg.gridz));
+  int ct = propagate(p, ntimes, 1);
+
+  if (llod != 1)
+    {
+      p.type = Expand;
+      p.grid = m_grid;
+      p.src = lg;
+      ct = propagate(p, 1, ct);
+    }
+
+  if (smooth > 0)
+    {
+      p.type = Diffuse;
+      p.grid = m_grid;
+      ct = propagate(p, smooth, ct);
+    }
+
+  accumulate(ct, lcol);
+}
+
+void
+LightEngine::initDirectional(const Pass *p, int y0, int y1)
+{
+  const Layout &g = p->grid;
+  const Layout &s = p->src;
+  Vec lim = Vec(g.gridx-1.5f, g.gridy-1.5f, g.gridz-1.5f);
+
+  for(int ty=y0; ty<=y1; ty++)
+    for(int tx=0; tx<p->w; tx++)
+      {
+	int col = tx/g.gridx;
+	int row = ty/g.gridy;
+	float x = tx+0.5f - col*g.gridx;
+	float y = ty+0.5f - row*g.gridy;
+	float z = row*g.ncols + col;
+
+	// position in opacity atlas
+	float xo = x/p->lod;
+	float yo = y/p->lod;
+	float zo = z/p->lod;
+	int oprow = (int)zo/s.ncols;
+	int opcol = (int)zo - oprow*s.ncols;
+	int ox = qBound(0, (int)floor(opcol*s.gridx + xo), p->sX-1);
+	int oy = qBound(0, (int)floor(oprow*s.gridy + yo), p->sY-1);
+
+	Vec pos = Vec(x,y,z) + p->ldir;
+	float den = 0;
+	if (pos.x < 0.5f || pos.y < 0.5f || pos.z < 0.5f ||
+	    pos.x > lim.x || pos.y > lim.y || pos.z > lim.z)
+	  den = 1;
+
+	int idx = ty*p->sX + tx;
+	p->out[2*idx] = toUnorm(den);
+	p->out[2*idx+1] = p->op[oy*p->sX + ox];
+      }
+}
+
+bool
+LightEngine::directional(const Pass *p, int y0, int y1)
+{
+  const Layout &g = p->grid;
+  const uchar *in = p->in;
+  int sX = p->sX;
+
+  int nwt = p->nwt;
+  int wi[26], wj[26], wk[26];
+  float fx = 0;
+  for(int n=0; n<nwt; n++)
+    {
+      wk[n] = p->wtidx[n]/9;
+      wj[n] = (p->wtidx[n]/3)%3;
+      wi[n] = p->wtidx[n]%3 - 1;
+      fx += p->wt[n];
+    }
+
+  bool changed = false;
+  for(int ty=y0; ty<=y1; ty++)
+    {
+      int row = ty/g.gridy;
+      int y = ty - row*g.gridy;
+      for(int tx0=0, col=0; tx0<p->w; tx0+=g.gridx, col++)
+	{
+	  TileNbrs t;
+	  tileNeighbours(sX, p->sY, g.gridx, g.gridy, g.ncols,
+			 y, row*g.ncols + col, t);
+
+	  int tx1 = qMin(p->w, tx0+g.gridx);
+	  for(int tx=tx0; tx<tx1; tx++)
+	    {
+	      int idx = ty*sX + tx;
+	      p->out[2*idx+1] = in[2*idx+1];
+	      if (unorm(in[2*idx]) > 0.98f)
+		{
+		  p->out[2*idx] = in[2*idx];
+		  continue;
+		}
+
+	      int x = tx - tx0;
+	      float fy = 0;
+	      for(int n=0; n<nwt; n++)
+		{
+		  int ni = (t.row[wk[n]][wj[n]] +
+			    qBound(0, t.ox[wk[n]]+x+wi[n], sX-1));
+		  fy += p->wt[n]*transmitted[in[2*ni] + 256*in[2*ni+1]];
+		}
+
+	      float l = 2.0f/255.0f;
+	      if (fx > 0)
+		l = qMax(l, fy/fx);
+	      uchar lv = toUnorm(l);
+	      changed |= (lv != in[2*idx]);
+	      p->out[2*idx] = lv;
+	    }
+	}
+    }
+
+  return changed;
+}
+
+//-------------------------------------------------
+// point lights
+//-------------------------------------------------
+void
+LightEngine::pointLight(QList<Vec> lpos, float lradius,
+			float ldecay, float cangle,
+			Vec lcol, float llod, int smooth,
+			bool doshadows)
+{
+  if (lpos.count() == 0)
+    return;
+
+  int lw, lh;
+  Layout lg = lodLayout(llod, lw, lh);
+
+  // texels outside the lower resolution part of the atlas are
+  // never written - keep them dark
+  clearLight(1);
+
+  Pass p;
+  p.type = InitPoint;
+  p.sX = m_sX;
+  p.sY = m_sY;
+  p.w = lw;
+  p.h = lh;
+  p.grid = lg;
+  p.src = m_grid;
+  p.lod = llod;
+  p.op = m_op;
+  p.lpos = lpos;
+  p.lradius = lradius;
+  p.ldecay = (doshadows ? ldecay : qPow(ldecay, 0.1f));
+  p.cangle = cangle;
+  p.doshadows = doshadows;
+  p.out = m_light[1];
+  run(p);
+
+  int ct = 1;
+  if (doshadows)
+    {
+      // direction to the nearest light does not change between passes
+      float *dir = new float[3*m_sX*m_sY];
+      uint *nbrs = new uint[m_sX*m_sY];
+      p.type = PointDirections;
+      p.dir = dir;
+      p.nbrs = nbrs;
+      run(p);
+
+      clearLight(0);
+      p.type = Point;
+      p.ldecay = ldecay;
+      int ntimes = qMax(lg.gridx, qMax(lg.gridy, lg.gridz));
+      ct = propagate(p, ntimes, 1);
+
+      delete [] dir;
+      delete [] nbrs;
+    }
+
+  p.w = m_sX;
+  p.h = m_sY;
+  if (llod != 1)
+    {
+      p.type = Expand;
+      p.grid = m_grid;
+      p.src = lg;
+      ct = propagate(p, 1, ct);
+    }
+
+  if (smooth > 0)
+    {
+      p.type = Diffuse;
+      p.grid = m_grid;
+      ct = propagate(p, smooth, ct);
+    }
+
+  accumulate(ct, lcol);
+}
+
+void
+LightEngine::initPoint(const Pass *p, int y0, int y1)
+{
+  const Layout &g = p->grid;
+  const Layout &s = p->src;
+  Vec lim = Vec(g.gridx-1.5f, g.gridy-1.5f, g.gridz-1.5f);
+  int npts = p->lpos.count();
+
+  for(int ty=y0; ty<=y1; ty++)
+    for(int tx=0; tx<p->w; tx++)
+      {
+	int col = tx/g.gridx;
+	int row = ty/g.gridy;
+	float x = tx+0.5f - col*g.gridx;
+	float y = ty+0.5f - row*g.gridy;
+	float z = row*g.ncols + col;
+	Vec pt = Vec(x,y,z);
+
+	// position in opacity atlas
+	float xo = x/p->lod;
+	float yo = y/p->lod;
+	float zo = z/p->lod;
+	int oprow = (int)zo/s.ncols;
+	int opcol = (int)zo - oprow*s.ncols;
+	int ox = qBound(0, (int)floor(opcol*s.gridx + xo), p->sX-1);
+	int oy = qBound(0, (int)floor(oprow*s.gridy + yo), p->sY-1);
+
+	int idx = ty*p->sX + tx;
+	uchar op = p->op[oy*p->sX + ox];
+	p->out[2*idx] = 0;
+	p->out[2*idx+1] = op;
+
+	// nearest light
+	Vec cpt = p->lpos.at(0);
+	float cdist = (pt-cpt).norm();
+	for(int i=1; i<npts; i++)
+	  {
+	    float dist = (pt-p->lpos.at(i)).norm();
+	    if (dist < cdist)
+	      {
+		cpt = p->lpos.at(i);
+		cdist = dist;
+	      }
+	  }
+
+	if (cdist < p->lradius)
+	  {
+	    p->out[2*idx] = 255;
+	    continue;
+	  }
+
+	bool outside = (cpt.x < 0.5f || cpt.y < 0.5f || cpt.z < 0.5f ||
+			cpt.x > lim.x || cpt.y > lim.y || cpt.z > lim.z);
+	if (p->doshadows && !outside)
+	  continue;
+
+	// light border voxels, and interior as well
+	// when there are no shadows
+	Vec ldir = (cpt-pt).unit();
+	Vec pos = pt + 2.0f*ldir;
+	if (!p->doshadows ||
+	    pos.x < 0 || pos.y < 0 || pos.z < 0 ||
+	    pos.x > lim.x || pos.y > lim.y || pos.z > lim.z)
+	  p->out[2*idx] = toUnorm(qPow(p->ldecay, cdist-p->lradius));
+      }
+}
+
+void
+LightEngine::pointDirections(const Pass *p, int y0, int y1)
+{
+  const Layout &g = p->grid;
+  int npts = p->lpos.count();
+
+  for(int ty=y0; ty<=y1; ty++)
+    for(int tx=0; tx<p->w; tx++)
+      {
+	int col = tx/g.gridx;
+	int row = ty/g.gridy;
+	Vec pt = Vec(tx - col*g.gridx,
+		     ty - row*g.gridy,
+		     row*g.ncols + col);
+
+	Vec cpt = p->lpos.at(0);
+	float cdist = (pt-cpt).norm();
+	for(int i=1; i<npts; i++)
+	  {
+	    float dist = (pt-p->lpos.at(i)).norm();
+	    if (dist < cdist)
+	      {
+		cpt = p->lpos.at(i);
+		cdist = dist;
+	      }
+	  }
+	Vec ldir = cpt-pt;
+	if (cdist > 0)
+	  ldir /= cdist;
+
+	int idx = ty*p->sX + tx;
+	float *d = p->dir + 3*idx;
+	d[0] = ldir.x;
+	d[1] = ldir.y;
+	d[2] = ldir.z;
+
+	// neighbours within the collection angle
+	uint mask = 0;
+	for(int n=0; n<27; n++)
+	  {
+	    float dotdl = (nbrDir[n][0]*d[0] +
+			   nbrDir[n][1]*d[1] +
+			   nbrDir[n][2]*d[2]);
+	    if (n != 13 && dotdl > p->cangle)
+	      mask |= (1 << n);
+	  }
+	p->nbrs[idx] = mask;
+      }
+}
+
+bool
+LightEngine::point(const Pass *p, int y0, int y1)
+{
+  const Layout &g = p->grid;
+  const uchar *in = p->in;
+  int sX = p->sX;
+
+  bool changed = false;
+  for(int ty=y0; ty<=y1; ty++)
+    {
+      int row = ty/g.gridy;
+      int y = ty - row*g.gridy;
+      for(int tx0=0, col=0; tx0<p->w; tx0+=g.gridx, col++)
+	{
+	  TileNbrs t;
+	  tileNeighbours(sX, p->sY, g.gridx, g.gridy, g.ncols,
+			 y, row*g.ncols + col, t);
+
+	  int tx1 = qMin(p->w, tx0+g.gridx);
+	  for(int tx=tx0; tx<tx1; tx++)
+	    {
+	      int idx = ty*sX + tx;
+	      p->out[2*idx+1] = in[2*idx+1];
+	      if (unorm(in[2*idx]) > 0.98f)
+		{
+		  p->out[2*idx] = in[2*idx];
+		  continue;
+		}
+
+	      int x = tx - tx0;
+	      const float *ld = p->dir + 3*idx;
+	      uint mask = p->nbrs[idx];
+	      float fx = 0, fy = 0;
+	      for(int n=0; mask; n++, mask>>=1)
+		{
+		  if (!(mask & 1))
+		    continue;
+		  const float *dr = nbrDir[n];
+		  float dotdl = dr[0]*ld[0] + dr[1]*ld[1] + dr[2]*ld[2];
+		  int k = n/9;
+		  int ni = (t.row[k][(n/3)%3] +
+			    qBound(0, t.ox[k]+x+n%3-1, sX-1));
+		  fx += dotdl;
+		  fy += dotdl*transmitted[in[2*ni] + 256*in[2*ni+1]];
+		}
+
+	      float l = 2.0f/255.0f;
+	      if (fx > 0)
+		l = qBound(l, p->ldecay*fy/fx, 1.0f);
+	      uchar lv = toUnorm(l);
+	      changed |= (lv != in[2*idx]);
+	      p->out[2*idx] = lv;
+	    }
+	}
+    }
+
+  return changed;
+}
+
+//-------------------------------------------------
+// common passes
+//-------------------------------------------------
+void
+LightEngine::expand(const Pass *p, int y0, int y1)
+{
+  const Layout &g = p->grid;
+  const Layout &s = p->src;
+  const uchar *in = p->in;
+
+  for(int ty=y0; ty<=y1; ty++)
+    for(int tx=0; tx<p->w; tx++)
+      {
+	int col = tx/g.gridx;
+	int row = ty/g.gridy;
+	float x = (tx+0.5f - col*g.gridx)*p->lod;
+	float y = (ty+0.5f - row*g.gridy)*p->lod;
+	float z = (row*g.ncols + col)*p->lod;
+	int lrow = (int)z/s.ncols;
+	int lcol = (int)z - lrow*s.ncols;
+
+	// bilinear lookup in the lower resolution atlas
+	float u = lcol*s.gridx + x - 0.5f;
+	float v = lrow*s.gridy + y - 0.5f;
+	int u0 = (int)floor(u);
+	int v0 = (int)floor(v);
+	float fu = u - u0;
+	float fv = v - v0;
+	int u1 = qBound(0, u0+1, p->sX-1);
+	int v1 = qBound(0, v0+1, p->sY-1);
+	u0 = qBound(0, u0, p->sX-1);
+	v0 = qBound(0, v0, p->sY-1);
+
+	int i00 = 2*(v0*p->sX + u0);
+	int i10 = 2*(v0*p->sX + u1);
+	int i01 = 2*(v1*p->sX + u0);
+	int i11 = 2*(v1*p->sX + u1);
+
+	int idx = ty*p->sX + tx;
+	for(int c=0; c<2; c++)
+	  {
+	    float a = unorm(in[i00+c])*(1-fu) + unorm(in[i10+c])*fu;
+	    float b = unorm(in[i01+c])*(1-fu) + unorm(in[i11+c])*fu;
+	    p->out[2*idx+c] = toUnorm(a*(1-fv) + b*fv);
+	  }
+      }
+}
+
+void
+LightEngine::diffuse(const Pass *p, int y0, int y1)
+{
+  const Layout &g = p->grid;
+  const uchar *in = p->in;
+  int sX = p->sX;
+
+  for(int ty=y0; ty<=y1; ty++)
+    {
+      int row = ty/g.gridy;
+      int y = ty - row*g.gridy;
+      for(int tx0=0, col=0; tx0<p->w; tx0+=g.gridx, col++)
+	{
+	  TileNbrs t;
+	  tileNeighbours(sX, p->sY, g.gridx, g.gridy, g.ncols,
+			 y, row*g.ncols + col, t);
+
+	  int tx1 = qMin(p->w, tx0+g.gridx);
+	  for(int tx=tx0; tx<tx1; tx++)
+	    {
+	      int x = tx - tx0;
+	      int sl = 0, so = 0;
+	      for(int k=0; k<3; k++)
+		{
+		  int c0 = qBound(0, t.ox[k]+x-1, sX-1);
+		  int c1 = qBound(0, t.ox[k]+x, sX-1);
+		  int c2 = qBound(0, t.ox[k]+x+1, sX-1);
+		  for(int j=0; j<3; j++)
+		    {
+		      const uchar *r = in + 2*t.row[k][j];
+		      sl += r[2*c0] + r[2*c1] + r[2*c2];
+		      so += r[2*c0+1] + r[2*c1+1] + r[2*c2+1];
+		    }
+		}
+
+	      int idx = ty*sX + tx;
+	      p->out[2*idx] = toUnorm(sl*(1.0f/(255.0f*27.0f)));
+	      p->out[2*idx+1] = toUnorm(so*(1.0f/(255.0f*27.0f)));
+	    }
+	}
+    }
+}
@@ -0,0 +1,133 @@
+#ifndef LIGHTENGINE_H
+#define LIGHTENGINE_H
+
+#include <QGLViewer/qglviewer.h>
+using namespace qglviewer;
+
+#include <QList>
+
+//---------------------------------------
+// cpu version of the light volume computations done by LightHandler.
+// works on the same 2D atlas of z slices as the light textures and
+// follows the shaders pass for pass - every pass is stored as 8 bit
+// values just like the RGBA textures, texture lookups are clamped to
+// the atlas edges and lookups between texels are bilinear.  rows of
+// the atlas are split among threads for every pass.
+//---------------------------------------
+class LightEngine
+{
+ public :
+  LightEngine();
+  ~LightEngine();
+
+  void clear();
+
+  // gridx, gridy, gridz, ncols, nrows of the light grid
+  // and width of the drag texture it was generated from
+  void setGrid(int, int, int, int, int, int);
+
+  int width();
+  int height();
+
+  // pruned opacity - one byte per texel of the atlas
+  void setOpacity(uchar*);
+
+  // accumulated light - rgba per texel of the atlas
+  uchar* finalLight();
+  void clearFinal();
+
+  // radius, fraction, dark level, bright level, smoothing, color
+  void ambientOcclusion(int, float, float, float, int, Vec);
+
+  // direction, cos(collection angle), color,
+  // lod ratio (light lod/lower resolution light lod), smoothing
+  void directionalLight(Vec, float, Vec, float, int);
+
+  // positions in lower resolution light grid, radius, decay,
+  // cos(collection angle), color, lod ratio, smoothing, shadows
+  void pointLight(QList<Vec>, float, float, float,
+		  Vec, float, int, bool);
+
+ private :
+  struct Layout
+  {
+    int gridx, gridy, gridz, ncols;
+  };
+
+  enum PassType
+  {
+    InitAO,
+    InitDirectional,
+    Directional,
+    InitPoint,
+    PointDirections,
+    Point,
+    Expand,
+    Diffuse
+  };
+
+  struct Pass
+  {
+    int type;
+    int sX, sY; // atlas size
+    int w, h; // part of the atlas that is rendered
+    Layout grid; // layout of the rendered atlas
+    Layout src; // layout of the sampled atlas for init and expand
+    float lod;
+    const uchar *op;
+    const uchar *in;
+    uchar *out;
+
+    // summed area table of opacity above the ao threshold
+    const int *sat;
+    int orad;
+    float ofrac, den1, den2;
+
+    Vec ldir;
+    float cangle;
+    // neighbours within the collection angle of a directional light
+    int nwt;
+    int wtidx[26];
+    float wt[26];
+
+    QList<Vec> lpos;
+    float lradius, ldecay;
+    bool doshadows;
+    // direction to nearest light and neighbours within
+    // the collection angle of that direction per texel
+    float *dir;
+    uint *nbrs;
+  };
+
+  struct PassJob
+  {
+    const Pass *pass;
+    int y0, y1;
+    bool changed;
+  };
+
+  int m_sX, m_sY, m_dtexX;
+  Layout m_grid;
+
+  uchar *m_op;
+  uchar *m_light[2]; // light and opacity per texel
+  uchar *m_final;
+
+  Layout lodLayout(float, int&, int&);
+  void clearLight(int);
+  bool run(Pass&);
+  int propagate(Pass&, int, int);
+  void accumulate(int, Vec);
+
+  static void runRows(PassJob&);
+  static void initAO(const Pass*, int, int);
+  static void initDirectional(const Pass*, int, int);
+  static bool directional(const Pass*, int, int);
+  static void initPoint(const Pass*, int, int);
+  static void pointDirections(const Pass*, int, int);
+  static bool point(const Pass*, int, int);
+  static void expand(const Pass*, int, int);
+  static void diffuse(const Pass*, int, int);
+};
+
+#endif
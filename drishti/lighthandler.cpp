@@ -10,6 +10,10 @@
 #include "cropshaderfactory.h"
 #include "blendshaderfactory.h"
 
+#include <QElapsedTimer>
+#include <QThread>
+#include <QtMath>
+
 #define VECDIVIDE(a, b) Vec(a.x/b.x, a.y/b.y, a.z/b.z)
 
 QGLFramebufferObject *LightHandler::m_opacityBuffer=0;
@@ -90,6 +94,8 @@ float LightHandler::m_aoDensity1 = 0.3;
 float LightHandler::m_aoDensity2 = 1.0;
 int LightHandler::m_aoTimes = 5;
 bool LightHandler::m_onlyAOLight = false;
+bool LightHandler::m_cpuLight = false;
+LightEngine* LightHandler::m_lightEngine = 0;
 bool LightHandler::m_basicLight = false;
 bool LightHandler::m_applyClip = false;
 bool LightHandler::m_applyCrop = false;
@@ -449,6 +455,9 @@ void LightHandler::clean()
   if (m_lightTex[0]) glDeleteTextures(2, m_lightTex);
   m_lightTex[0] = m_lightTex[1] = 0;
 
+  if (m_lightEngine) delete m_lightEngine;
+  m_lightEngine = 0;
+
   if (m_emisTex[0]) glDeleteTextures(2, m_emisTex);
   m_emisTex[0] = m_emisTex[1] = 0;
 
@@ -1690,6 +1699,77 @@ LightHandler::updatePruneBuffer()
 }
 
 
+void
+LightHandler::clearFinalLightBuffer()
+{
+  m_finalLightBuffer->bind();
+  glDrawBuffer(GL_COLOR_ATTACHMENT0_EXT);
+  glClearColor(0, 0, 0, 0);
+  glClear(GL_COLOR_BUFFER_BIT);
+  m_finalLightBuffer->release();
+}
+
+float
+LightHandler::lightLodRatio(int clod)
+{
+  return (float)m_lightLod/(float)qMax(clod, m_lightLod);
+}
+
+QList<Vec>
+LightHandler::lightGridPositions(QList<Vec> pts, int lod)
+{
+  Vec voxelScaling = Global::voxelScaling();
+  QList<Vec> gpos;
+  for(int i=0; i<pts.count(); i++)
+    {
+      Vec v = VECDIVIDE(pts[i], voxelScaling);
+      v = (v-m_dataMin)/m_dragInfo.z/lod;
+      gpos << v;
+    }
+  return gpos;
+}
+
+void
+LightHandler::setupLightEngine()
+{
+  int sX = m_pruneBuffer->width();
+  int sY = m_pruneBuffer->height();
+
+  if (!m_lightEngine)
+    m_lightEngine = new LightEngine();
+  m_lightEngine->setGrid(m_gridx, m_gridy, m_gridz,
+			 m_ncols, m_nrows,
+			 m_dtexX);
+
+  uchar *op = new uchar[sX*sY];
+  m_pruneBuffer->bind();
+  glPixelStorei(GL_PACK_ALIGNMENT, 1);
+  glReadPixels(0, 0, sX, sY, GL_RED, GL_UNSIGNED_BYTE, op);
+  glPixelStorei(GL_PACK_ALIGNMENT, 4);
+  m_pruneBuffer->release();
+
+  m_lightEngine->setOpacity(op);
+  m_lightEngine->clearFinal();
+
+  delete [] op;
+}
+
+void
+LightHandler::loadLightEngineBuffer()
+{
+  int sX = m_finalLightBuffer->width();
+  int sY = m_finalLightBuffer->height();
+
+  glActiveTexture(GL_TEXTURE2);
+  glBindTexture(GL_TEXTURE_RECTANGLE_ARB, m_finalLightBuffer->texture());
+  glTexSubImage2D(GL_TEXTURE_RECTANGLE_ARB, 0,
+		  0, 0, sX, sY,
+		  GL_RGBA, GL_UNSIGNED_BYTE,
+		  m_lightEngine->finalLight());
+  glBindTexture(GL_TEXTURE_RECTANGLE_ARB, 0);
+}
+
+
 void
 LightHandler::updateLightBuffers()
 {
@@ -1704,28 +1784,34 @@ LightHandler::updateLightBuffers()
 
   updatePruneBuffer();
 
-  //---------------------------------------------
-  // clear final light buffer
-  m_finalLightBuffer->bind();
-  glDrawBuffer(GL_COLOR_ATTACHMENT0_EXT);
-  glClearColor(0, 0, 0, 0);
-  glClear(GL_COLOR_BUFFER_BIT);
-  m_finalLightBuffer->release();
-  //---------------------------------------------
+  clearFinalLightBuffer();
+
+  if (m_cpuLight)
+    setupLightEngine();
 
   if (m_aoLightColor.squaredNorm() > 0.02)
-    updateAmbientOcclusionLightBuffer(m_aoRad, m_aoFrac,
-				      m_aoDensity1, m_aoDensity2, m_aoTimes,
-				      m_aoLightColor);
+    {
+      if (m_cpuLight)
+	m_lightEngine->ambientOcclusion(m_aoRad, m_aoFrac,
+					m_aoDensity1, m_aoDensity2, m_aoTimes,
+					m_aoLightColor);
+      else
+	updateAmbientOcclusionLightBuffer(m_aoRad, m_aoFrac,
+					  m_aoDensity1, m_aoDensity2, m_aoTimes,
+					  m_aoLightColor);
+    }
 
   if (m_onlyAOLight)
     {
+      if (m_cpuLight)
+	loadLightEngineBuffer();
       MainWindowUI::mainWindowUI()->menubar->parentWidget()->	\
 	setWindowTitle(Global::DrishtiVersion());
       return;
     }
 
-  if (m_emisTF >=0 && m_emisTF <= Global::lutSize())
+  bool emissive = (m_emisTF >=0 && m_emisTF <= Global::lutSize());
+  if (emissive && !m_cpuLight)
     updateEmissiveBuffer(m_emisDecay);
 
   QList<GiLightGrabber*> lightsPtr = m_giLights->giLightsPtr();
@@ -1744,23 +1830,41 @@ LightHandler::updateLightBuffers()
 	      if (lightsPtr[i]->lightType() == 1) // direction light
 		{
 		  Vec lv = (pts[0] - pts[1]).unit();
-		  updateDirectionalLightBuffer(lv, angle, color,
-					       clod, smooth);
+		  if (m_cpuLight)
+		    m_lightEngine->directionalLight(lv, angle, color,
+						    lightLodRatio(clod), smooth);
+		  else
+		    updateDirectionalLightBuffer(lv, angle, color,
+						 clod, smooth);
 		}
 	      else // point light
 		{
 		  bool doshadows = lightsPtr[i]->doShadows();
 		  float rad = lightsPtr[i]->rad();
 		  float decay = lightsPtr[i]->decay();
-		  updatePointLightBuffer(pts, rad,
-					 decay, angle,
-					 color, clod, smooth,
-					 doshadows);
+		  if (m_cpuLight)
+		    m_lightEngine->pointLight(lightGridPositions(pts, qMax(clod, m_lightLod)),
+					      rad, decay, angle,
+					      color, lightLodRatio(clod), smooth,
+					      doshadows);
+		  else
+		    updatePointLightBuffer(pts, rad,
+					   decay, angle,
+					   color, clod, smooth,
+					   doshadows);
 		}
 	    }
 	}
     }
   
+  if (m_cpuLight)
+    {
+      loadLightEngineBuffer();
+      // emissive light adds on to the loaded light buffer
+      if (emissive)
+	updateEmissiveBuffer(m_emisDecay);
+    }
+
   if (m_lightDiffuse > 1)
     diffuseLightBuffer(m_lightDiffuse);
 
@@ -2023,16 +2127,13 @@ LightHandler::updatePointLightBuffer(QList<Vec> olpos, float lradius,
   // take care of different light buffer size for point lights
   int pointLightLod = qMax(clod, m_lightLod);
 
-  Vec voxelScaling = Global::voxelScaling();
+  QList<Vec> gpos = lightGridPositions(olpos, pointLightLod);
   float *lpos = new float[3*npts];
   for(int i=0; i<npts; i++)
     {
-      Vec v = olpos[i];
-      v = VECDIVIDE(v, voxelScaling);
-      v = (v-m_dataMin)/m_dragInfo.z/pointLightLod;
-      lpos[3*i+0] = v.x;
-      lpos[3*i+1] = v.y;
-      lpos[3*i+2] = v.z;
+      lpos[3*i+0] = gpos[i].x;
+      lpos[3*i+1] = gpos[i].y;
+      lpos[3*i+2] = gpos[i].z;
     }
 
   float llod;
@@ -2469,6 +2570,11 @@ LightHandler::openPropertyEditor()
   vlist << QVariant(m_basicLight);
   plist["only basic light"] = vlist;
   
+  vlist.clear();
+  vlist << QVariant("checkbox");
+  vlist << QVariant(m_cpuLight);
+  plist["cpu light"] = vlist;
+  
   vlist.clear();
   vlist << QVariant("checkbox");
   vlist << QVariant(m_applyClip);
@@ -2513,6 +2619,7 @@ LightHandler::openPropertyEditor()
   QStringList keys;
   keys << "only basic light";
   keys << "only ao light";
+  keys << "cpu light";
   keys << "apply clip";
   keys << "apply crop";
   keys << "gap";
@@ -2548,6 +2655,7 @@ LightHandler::openPropertyEditor()
   keys = vmap.keys();
 
   bool basicLightChanged = false;
+  bool cpuLightChanged = false;
   bool emisChanged = false;
   bool dilateChanged = false;
   bool lightlodChanged = false;
@@ -2565,6 +2673,14 @@ LightHandler::openPropertyEditor()
 	      m_basicLight = pair.first.toBool();
 	      basicLightChanged = true;
 	    }
+	  else if (keys[ik] == "cpu light")
+	    {
+	      if (m_cpuLight != pair.first.toBool())
+		{
+		  m_cpuLight = pair.first.toBool();
+		  cpuLightChanged = true;
+		}
+	    }
 	  else if (keys[ik] == "apply clip")
 	    {
 	      m_applyClip = pair.first.toBool();
@@ -2629,6 +2745,15 @@ LightHandler::openPropertyEditor()
 	}
     }
   
+  // the cpu light engine is only kept while cpu light is on.
+  // every path below recomputes the light buffers, with the
+  // engine or with the shaders
+  if (cpuLightChanged && !m_cpuLight && m_lightEngine)
+    {
+      delete m_lightEngine;
+      m_lightEngine = 0;
+    }
+
   if (lightlodChanged)
     updateAndLoadLightTexture(m_dataTex,
 			      m_dtexX, m_dtexY,
@@ -2687,3 +2812,163 @@ LightHandler::lightBufferCalculations(int ntimes, int lct, int lX, int lY)
 
   return ct;
 }
+
+QString
+LightHandler::benchmarkLightBuffers(int runs)
+{
+  if (!m_finalLightBuffer || m_basicLight || !standardChecks())
+    return "Light buffers not available - switch off \"only basic light\" in GI Light Parameters";
+
+  runs = qMax(1, runs);
+
+  updatePruneBuffer();
+
+  int sX = m_finalLightBuffer->width();
+  int sY = m_finalLightBuffer->height();
+  qint64 nvox = (qint64)m_gridx*m_gridy*m_gridz;
+
+  QElapsedTimer timer;
+  timer.start();
+  setupLightEngine();
+  float tread = timer.nsecsElapsed()/1000000.0;
+
+  // light coming from a corner and a point light at the center
+  Vec lcol = Vec(1,1,1);
+  Vec ldir = Vec(1,1,1).unit();
+  float cangle = cos(3.14159265*60.0/180.0);
+  float prad = 5;
+  float pdecay = 1.0;
+  Vec vcen = (m_dataMin+m_dataMax)/2;
+  QList<Vec> pts;
+  pts << VECPRODUCT(vcen, Global::voxelScaling());
+  QList<Vec> gpts = lightGridPositions(pts, m_lightLod);
+
+  QString mesg;
+  mesg += QString("light grid %1x%2x%3 (%4x%5 atlas), %6 threads, %7 runs\n"). \
+    arg(m_gridx).arg(m_gridy).arg(m_gridz).arg(sX).arg(sY).	\
+    arg(QThread::idealThreadCount()).arg(runs);
+  mesg += QString("prune buffer readback : %1 ms\n\n").arg(tread, 0, 'f', 2);
+
+  QStringList names;
+  names << "ambient occlusion" << "directional" << "point";
+
+  uchar *gpu = new uchar[4*sX*sY];
+  for(int lt=0; lt<3; lt++)
+    {
+      timer.restart();
+      for(int r=0; r<runs; r++)
+	{
+	  clearFinalLightBuffer();
+	  if (lt == 0)
+	    updateAmbientOcclusionLightBuffer(m_aoRad, m_aoFrac,
+					      m_aoDensity1, m_aoDensity2, m_aoTimes,
+					      lcol);
+	  else if (lt == 1)
+	    updateDirectionalLightBuffer(ldir, cangle, lcol, m_lightLod, 0);
+	  else
+	    updatePointLightBuffer(pts, prad, pdecay, cangle,
+				   lcol, m_lightLod, 0, true);
+	}
+      float tgpu = timer.nsecsElapsed()/(1000000.0*runs);
+
+      m_finalLightBuffer->bind();
+      glReadPixels(0, 0, sX, sY, GL_RGBA, GL_UNSIGNED_BYTE, gpu);
+      m_finalLightBuffer->release();
+
+      timer.restart();
+      for(int r=0; r<runs; r++)
+	{
+	  m_lightEngine->clearFinal();
+	  if (lt == 0)
+	    m_lightEngine->ambientOcclusion(m_aoRad, m_aoFrac,
+					    m_aoDensity1, m_aoDensity2, m_aoTimes,
+					    lcol);
+	  else if (lt == 1)
+	    m_lightEngine->directionalLight(ldir, cangle, lcol, 1, 0);
+	  else
+	    m_lightEngine->pointLight(gpts, prad, pdecay, cangle,
+				      lcol, 1, 0, true);
+	}
+      float tcpu = timer.nsecsElapsed()/(1000000.0*runs);
+
+      uchar *cpu = m_lightEngine->finalLight();
+      int maxdiff = 0;
+      double sumdiff = 0;
+      for(int i=0; i<sX*sY; i++)
+	for(int c=0; c<3; c++)
+	  {
+	    int d = qAbs((int)gpu[4*i+c] - (int)cpu[4*i+c]);
+	    maxdiff = qMax(maxdiff, d);
+	    sumdiff += d;
+	  }
+
+      mesg += QString("%1\n").arg(names[lt]);
+      mesg += QString("  gpu : %1 ms  (%2 Mvoxels/s)\n").		\
+	arg(tgpu, 0, 'f', 2).arg(nvox/(tgpu*1000.0), 0, 'f', 1);
+      mesg += QString("  cpu : %1 ms  (%2 Mvoxels/s)\n").		\
+	arg(tcpu, 0, 'f', 2).arg(nvox/(tcpu*1000.0), 0, 'f', 1);
+      mesg += QString("  difference : max %1/255  mean %2/255\n"). \
+	arg(maxdiff).arg(sumdiff/(3.0*sX*sY), 0, 'f', 3);
+    }
+  delete [] gpu;
+
+  //-----------------------------------
+  // cpu engine on synthetic hollow spheres of increasing size
+  mesg += "\ncpu throughput on synthetic grids (Mvoxels/s)\n";
+  mesg += "grid      ao      directional  point\n";
+  for(int g=32; g<=128; g*=2)
+    {
+      int ncols = qCeil(qSqrt((float)g));
+      int nrows = g/ncols + (g%ncols > 0);
+      int gX = ncols*g;
+      int gY = nrows*g;
+
+      uchar *op = new uchar[gX*gY];
+      memset(op, 0, gX*gY);
+      for(int z=0; z<g; z++)
+	for(int y=0; y<g; y++)
+	  for(int x=0; x<g; x++)
+	    {
+	      float r = (Vec(x,y,z) - Vec(g/2,g/2,g/2)).norm();
+	      if (r > 0.25*g && r < 0.4*g)
+		op[((z/ncols)*g + y)*gX + (z%ncols)*g + x] = 255;
+	    }
+
+      LightEngine engine;
+      engine.setGrid(g, g, g, ncols, nrows, gX);
+      engine.setOpacity(op);
+      delete [] op;
+
+      QList<Vec> cpts;
+      cpts << Vec(g/2, g/2, g/2);
+
+      float mvox[3];
+      for(int lt=0; lt<3; lt++)
+	{
+	  timer.restart();
+	  for(int r=0; r<runs; r++)
+	    {
+	      engine.clearFinal();
+	      if (lt == 0)
+		engine.ambientOcclusion(m_aoRad, m_aoFrac,
+					m_aoDensity1, m_aoDensity2, m_aoTimes,
+					lcol);
+	      else if (lt == 1)
+		engine.directionalLight(ldir, cangle, lcol, 1, 0);
+	      else
+		engine.pointLight(cpts, prad, pdecay, cangle,
+				  lcol, 1, 0, true);
+	    }
+	  float ms = timer.nsecsElapsed()/(1000000.0*runs);
+	  mvox[lt] = (float)g*g*g/(ms*1000.0);
+	}
+      mesg += QString("%1^3  %2  %3  %4\n").arg(g, 3).		\
+	arg(mvox[0], 8, 'f', 1).arg(mvox[1], 11, 'f', 1).arg(mvox[2], 8, 'f', 1);
+    }
+  //-----------------------------------
+
+  // put back the light buffers of the current lights
+  updateLightBuffers();
+
+  return mesg;
+}
@@ -11,6 +11,7 @@ using namespace qglviewer;
 #include "gilights.h"
 #include "gilightinfo.h"
 #include "geometryobjects.h"
+#include "lightengine.h"
 
 class LightHandler
 {
@@ -63,6 +64,9 @@ class LightHandler
     static bool willUpdateLightBuffers() { return (m_doAll || m_onlyLightBuffers); }
     static bool lightsChanged();
     static void updateLightBuffers();
+
+    // time gpu and cpu light buffer computations - runs
+    static QString benchmarkLightBuffers(int);
     
     static bool inPool;
     static bool showLights;
@@ -91,6 +95,8 @@ class LightHandler
 
     static bool m_basicLight;
     static bool m_onlyAOLight;
+    static bool m_cpuLight;
+    static LightEngine *m_lightEngine;
     static int m_lightLod;
     static int m_lightDiffuse;
 
@@ -192,6 +198,13 @@ class LightHandler
     static void createBlendShader();
 
     static void updatePruneBuffer();
+    static void clearFinalLightBuffer();
+
+    static void setupLightEngine();
+    static void loadLightEngineBuffer();
+
+    static float lightLodRatio(int);
+    static QList<Vec> lightGridPositions(QList<Vec>, int);
 
     static void updateAmbientOcclusionLightBuffer(int, float,
 						  float, float,
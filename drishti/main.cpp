@@ -2,6 +2,7 @@
 
 #include <QApplication>
 #include "mainwindow.h"
+#include "benchmark.h"
 
 int main(int argc, char** argv)
 {
@@ -9,6 +10,14 @@ int main(int argc, char** argv)
 
   QApplication application(argc,argv);
   
+  // drishti --benchmark [size ...]
+  // times slab preparation for synthetic volumes
+  // without creating the main window
+  QStringList arguments = application.arguments();
+  int bidx = arguments.indexOf("--benchmark");
+  if (bidx > 0)
+    return Benchmark::run(arguments.mid(bidx+1));
+
   QGLFormat glFormat;
   glFormat.setSampleBuffers(true);
   glFormat.setDoubleBuffer(true);
@@ -19,6 +19,7 @@
 #include "prunehandler.h"
 #include "xmlheaderfunctions.h"
 #include "cropshaderfactory.h"
+#include "blobstore.h"
 
 #include <QDockWidget>
 #include <QFileDialog>
@@ -2799,6 +2800,14 @@ MainWindow::saveSettings()
     topElement.appendChild(de0);
   }
 
+  {
+    QDomElement de0 = doc.createElement("cachedirectory");
+    QDomText tn0;
+    tn0 = doc.createTextNode(Global::cacheDir());
+    de0.appendChild(tn0);
+    topElement.appendChild(de0);
+  }
+
   {
     QDomElement de0 = doc.createElement("previousdirectory");
     QDomText tn0;
@@ -2898,6 +2907,11 @@ MainWindow::loadSettings()
 	  QString str = dlist.at(i).toElement().text();
 	  Global::setTempDir(str);
 	}
+      else if (dlist.at(i).nodeName() == "cachedirectory")
+	{
+	  QString str = dlist.at(i).toElement().text();
+	  Global::setCacheDir(str);
+	}
       else if (dlist.at(i).nodeName() == "previousdirectory")
 	{
 	  QString str = dlist.at(i).toElement().text();
@@ -3672,10 +3686,15 @@ MainWindow::loadViewsAndKeyFrames(const char* flnm)
       fin.getline(keyword, 100, 0);
       if (strcmp(keyword, "views") == 0)
 	m_gallery->load(fin);
+      else if (strcmp(keyword, "blobs") == 0)
+	BlobStore::load(fin, sflnm);
       else if (strcmp(keyword, "keyframes") == 0)
 	m_keyFrame->load(fin);
     }
   fin.close();
+
+  // keep only blobs referred to by the keyframes
+  BlobStore::purge();
 }
 
 void
@@ -3687,6 +3706,15 @@ MainWindow::saveViewsAndKeyFrames(const char* flnm)
   else
     sflnm.replace(QString(".xml"), QString(".keyframes"));
 
+  // blobs not yet read are still in the file being overwritten
+  if (!BlobStore::fetchAll())
+    {
+      QMessageBox::critical(0, "Error",
+			    QString("Cannot read all keyframe buffers from ")+sflnm+
+			    QString("\nKeyframes not saved"));
+      return;
+    }
+
   fstream fout(sflnm.toLatin1().data(), ios::binary|ios::out);
 
   QString keyword;
@@ -3694,6 +3722,11 @@ MainWindow::saveViewsAndKeyFrames(const char* flnm)
   fout.write((char*)(keyword.toLatin1().data()), keyword.length()+1);  
 
   m_gallery->save(fout);
+
+  // shared buffers are written once, ahead of the keyframes
+  m_keyFrame->storeBlobs();
+  BlobStore::save(fout);
+
   m_keyFrame->save(fout);
 
   fout.close();
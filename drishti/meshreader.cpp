@@ -0,0 +1,927 @@
+#include "meshreader.h"
+#include "binarycache.h"
+
+#include <QFile>
+#include <QStringList>
+#include <QSysInfo>
+#include <QtConcurrentMap>
+
+#include <math.h>
+
+static const char cacheMagic[4] = { 'D', 'M', 'C', '1' };
+
+// records per parallel chunk
+static const qint64 chunkRecords = 256*1024;
+
+// bytes per parallel chunk for ascii files
+static const qint64 chunkBytes = 4*1024*1024;
+
+static const uint invalidIndex = 0xffffffff;
+
+int
+MeshReader::typeSize(int type)
+{
+  if (type == Int8 || type == Uint8) return 1;
+  if (type == Int16 || type == Uint16) return 2;
+  if (type == Float64) return 8;
+  return 4;
+}
+
+int
+MeshReader::typeFromName(QString name)
+{
+  if (name == "char" || name == "int8") return Int8;
+  if (name == "uchar" || name == "uint8") return Uint8;
+  if (name == "short" || name == "int16") return Int16;
+  if (name == "ushort" || name == "uint16") return Uint16;
+  if (name == "int" || name == "int32") return Int32;
+  if (name == "uint" || name == "uint32") return Uint32;
+  if (name == "float" || name == "float32") return Float32;
+  if (name == "double" || name == "float64") return Float64;
+  return -1;
+}
+
+bool
+MeshReader::readHeader(const uchar *data, qint64 size, Header &hdr)
+{
+  hdr.format = -1;
+  hdr.elements.clear();
+  hdr.dataStart = 0;
+  hdr.px = hdr.py = hdr.pz = -1;
+  hdr.pnx = hdr.pny = hdr.pnz = -1;
+  hdr.pr = hdr.pg = hdr.pb = -1;
+  hdr.pfaces = -1;
+
+  if (size < 4 || memcmp(data, "ply", 3) != 0)
+    return false;
+
+  qint64 pos = 0;
+  qint64 maxHeader = qMin(size, (qint64)1024*1024);
+  bool done = false;
+  while (pos < maxHeader && !done)
+    {
+      qint64 e = pos;
+      while (e < maxHeader && data[e] != '\n')
+	e++;
+      if (e >= maxHeader)
+	return false;
+
+      QString line = QString::fromLatin1((const char*)data+pos, e-pos).trimmed();
+      pos = e+1;
+
+      QStringList words = line.split(" ", QString::SkipEmptyParts);
+      if (words.count() == 0)
+	continue;
+
+      if (words[0] == "end_header")
+	done = true;
+      else if (words[0] == "format" && words.count() > 1)
+	{
+	  if (words[1] == "ascii") hdr.format = 0;
+	  else if (words[1] == "binary_little_endian") hdr.format = 1;
+	  else if (words[1] == "binary_big_endian") hdr.format = 2;
+	}
+      else if (words[0] == "element" && words.count() > 2)
+	{
+	  Element el;
+	  el.name = words[1];
+	  el.count = words[2].toLongLong();
+	  el.size = 0;
+	  hdr.elements << el;
+	}
+      else if (words[0] == "property" && hdr.elements.count() > 0)
+	{
+	  Property prop;
+	  prop.list = (words.count() > 4 && words[1] == "list");
+	  if (prop.list)
+	    {
+	      prop.countType = typeFromName(words[2]);
+	      prop.type = typeFromName(words[3]);
+	      prop.name = words[4];
+	      if (prop.countType < 0)
+		return false;
+	    }
+	  else if (words.count() > 2)
+	    {
+	      prop.countType = -1;
+	      prop.type = typeFromName(words[1]);
+	      prop.name = words[2];
+	    }
+	  else
+	    return false;
+
+	  if (prop.type < 0)
+	    return false;
+
+	  Element &el = hdr.elements.last();
+	  prop.offset = el.size;
+	  if (prop.list || el.size < 0)
+	    el.size = -1;
+	  else
+	    el.size += typeSize(prop.type);
+	  el.props << prop;
+	}
+    }
+
+  if (!done || hdr.format < 0)
+    return false;
+
+  hdr.dataStart = pos;
+
+  //--------
+  // locate the properties we read
+  int ve = -1, fe = -1;
+  for(int i=0; i<hdr.elements.count(); i++)
+    {
+      if (hdr.elements[i].name == "vertex") ve = i;
+      if (hdr.elements[i].name == "face") fe = i;
+    }
+  if (ve < 0)
+    return false;
+
+  const Element &vel = hdr.elements[ve];
+  if (vel.size < 0)
+    return false;
+
+  for(int i=0; i<vel.props.count(); i++)
+    {
+      QString n = vel.props[i].name;
+      if (n == "x") hdr.px = i;
+      else if (n == "y") hdr.py = i;
+      else if (n == "z") hdr.pz = i;
+      else if (n == "nx") hdr.pnx = i;
+      else if (n == "ny") hdr.pny = i;
+      else if (n == "nz") hdr.pnz = i;
+      else if (n == "red" || n == "r") hdr.pr = i;
+      else if (n == "green" || n == "g") hdr.pg = i;
+      else if (n == "blue" || n == "b") hdr.pb = i;
+    }
+  if (hdr.px < 0 || hdr.py < 0 || hdr.pz < 0)
+    return false;
+
+  if (fe >= 0)
+    {
+      const Element &fel = hdr.elements[fe];
+      for(int i=0; i<fel.props.count(); i++)
+	if (fel.props[i].list &&
+	    (fel.props[i].name == "vertex_indices" ||
+	     fel.props[i].name == "vertex_index"))
+	  hdr.pfaces = i;
+      if (hdr.pfaces < 0)
+	return false;
+    }
+  //--------
+
+  return true;
+}
+
+double
+MeshReader::binaryValue(const uchar *p, int type, bool swap)
+{
+  uchar b[8];
+  int n = typeSize(type);
+  if (swap)
+    {
+      for(int i=0; i<n; i++)
+	b[i] = p[n-1-i];
+    }
+  else
+    memcpy(b, p, n);
+
+  switch (type)
+    {
+    case Int8 : return (double)(*(signed char*)b);
+    case Uint8 : return (double)b[0];
+    case Int16 : { short v; memcpy(&v, b, 2); return v; }
+    case Uint16 : { ushort v; memcpy(&v, b, 2); return v; }
+    case Int32 : { int v; memcpy(&v, b, 4); return v; }
+    case Uint32 : { uint v; memcpy(&v, b, 4); return v; }
+    case Float32 : { float v; memcpy(&v, b, 4); return v; }
+    default : { double v; memcpy(&v, b, 8); return v; }
+    }
+}
+
+const uchar*
+MeshReader::skipRecord(const uchar *p, const uchar *end,
+		       const Element &el, bool swap)
+{
+  for(int k=0; k<el.props.count(); k++)
+    {
+      const Property &prop = el.props[k];
+      if (prop.list)
+	{
+	  if (p + typeSize(prop.countType) > end)
+	    return 0;
+	  qint64 n = binaryValue(p, prop.countType, swap);
+	  p += typeSize(prop.countType) + n*typeSize(prop.type);
+	}
+      else
+	p += typeSize(prop.type);
+      if (p > end)
+	return 0;
+    }
+  return p;
+}
+
+//---------------------------------------
+// binary
+//---------------------------------------
+void
+MeshReader::vertexJob(ChunkJob &job)
+{
+  const Header *hdr = job.hdr;
+  const Element *el = 0;
+  for(int i=0; i<hdr->elements.count(); i++)
+    if (hdr->elements[i].name == "vertex")
+      el = &hdr->elements[i];
+
+  bool swap = (hdr->format == 2) != (QSysInfo::ByteOrder == QSysInfo::BigEndian);
+  const QList<Property> &props = el->props;
+  int size = el->size;
+  bool normals = job.mesh->hasNormals();
+  bool colors = job.mesh->hasColors();
+
+  for(qint64 r=0; r<job.count; r++)
+    {
+      const uchar *rec = job.data + r*size;
+      int i = job.first + r;
+
+      job.mesh->setVertex(i,
+			  binaryValue(rec+props[hdr->px].offset, props[hdr->px].type, swap),
+			  binaryValue(rec+props[hdr->py].offset, props[hdr->py].type, swap),
+			  binaryValue(rec+props[hdr->pz].offset, props[hdr->pz].type, swap));
+
+      if (normals)
+	{
+	  float n[3] = { 0, 0, 0 };
+	  int pn[3] = { hdr->pnx, hdr->pny, hdr->pnz };
+	  for(int k=0; k<3; k++)
+	    if (pn[k] >= 0)
+	      n[k] = binaryValue(rec+props[pn[k]].offset, props[pn[k]].type, swap);
+	  job.mesh->setNormal(i, n[0], n[1], n[2]);
+	}
+
+      if (colors)
+	{
+	  int c[3] = { 0, 0, 0 };
+	  int pc[3] = { hdr->pr, hdr->pg, hdr->pb };
+	  for(int k=0; k<3; k++)
+	    if (pc[k] >= 0)
+	      c[k] = qBound(0, (int)binaryValue(rec+props[pc[k]].offset,
+						props[pc[k]].type, swap), 255);
+	  job.mesh->setColor(i, c[0], c[1], c[2]);
+	}
+    }
+  job.ok = true;
+}
+
+// job.end is where the chunk should finish
+void
+MeshReader::faceJob(ChunkJob &job)
+{
+  const Header *hdr = job.hdr;
+  const Element *el = 0;
+  for(int i=0; i<hdr->elements.count(); i++)
+    if (hdr->elements[i].name == "face")
+      el = &hdr->elements[i];
+
+  bool swap = (hdr->format == 2) != (QSysInfo::ByteOrder == QSysInfo::BigEndian);
+
+  const uchar *p = job.data;
+  for(qint64 r=0; r<job.count; r++)
+    {
+      uint *t = job.tri + 3*(job.first + r);
+      t[0] = invalidIndex;
+      for(int k=0; k<el->props.count(); k++)
+	{
+	  const Property &prop = el->props[k];
+	  if (!prop.list)
+	    {
+	      p += typeSize(prop.type);
+	      continue;
+	    }
+
+	  if (p + typeSize(prop.countType) > job.end)
+	    {
+	      job.ok = false;
+	      return;
+	    }
+	  int n = binaryValue(p, prop.countType, swap);
+	  p += typeSize(prop.countType);
+	  int isz = typeSize(prop.type);
+	  if (n < 0 || p + n*isz > job.end)
+	    {
+	      job.ok = false;
+	      return;
+	    }
+	  if (k == hdr->pfaces && n >= 3)
+	    {
+	      t[0] = binaryValue(p, prop.type, swap);
+	      t[1] = binaryValue(p+isz, prop.type, swap);
+	      t[2] = binaryValue(p+2*isz, prop.type, swap);
+	    }
+	  p += n*isz;
+	}
+    }
+
+  job.ok = (p == job.end);
+}
+
+bool
+MeshReader::readBinary(const uchar *data, qint64 size,
+		       Header &hdr, MeshStore &mesh)
+{
+  bool swap = (hdr.format == 2) != (QSysInfo::ByteOrder == QSysInfo::BigEndian);
+
+  const uchar *p = data + hdr.dataStart;
+  const uchar *end = data + size;
+
+  for(int e=0; e<hdr.elements.count(); e++)
+    {
+      const Element &el = hdr.elements[e];
+
+      if (el.name == "vertex")
+	{
+	  if (p + el.count*el.size > end)
+	    return false;
+
+	  mesh.resize(el.count,
+		      hdr.pnx >= 0 || hdr.pny >= 0 || hdr.pnz >= 0,
+		      hdr.pr >= 0 || hdr.pg >= 0 || hdr.pb >= 0);
+
+	  QList<ChunkJob> jobs;
+	  for(qint64 r=0; r<el.count; r+=chunkRecords)
+	    {
+	      ChunkJob job;
+	      job.hdr = &hdr;
+	      job.mesh = &mesh;
+	      job.tri = 0;
+	      job.data = p + r*el.size;
+	      job.end = end;
+	      job.first = r;
+	      job.count = qMin(chunkRecords, el.count-r);
+	      job.ok = false;
+	      jobs << job;
+	    }
+	  QtConcurrent::blockingMap(jobs, MeshReader::vertexJob);
+
+	  p += el.count*el.size;
+	}
+      else if (el.name == "face")
+	{
+	  QVector<uint> &tri = mesh.triangles();
+	  tri.resize(3*el.count);
+
+	  //--------
+	  // chunk starts, guessed first for the common case of
+	  // triangles only, walked record by record otherwise
+	  QList<const uchar*> starts;
+	  const uchar *fend = 0;
+	  if (el.props.count() == 1)
+	    {
+	      qint64 stride = typeSize(el.props[0].countType) + 3*typeSize(el.props[0].type);
+	      if (p + el.count*stride <= end)
+		{
+		  for(qint64 r=0; r<el.count; r+=chunkRecords)
+		    starts << p + r*stride;
+		  fend = p + el.count*stride;
+		}
+	    }
+
+	  bool ok = false;
+	  for(int pass=0; pass<2 && !ok; pass++)
+	    {
+	      if (pass == 1 || starts.count() == 0)
+		{
+		  starts.clear();
+		  const uchar *q = p;
+		  for(qint64 r=0; r<el.count; r++)
+		    {
+		      if (r%chunkRecords == 0)
+			starts << q;
+		      q = skipRecord(q, end, el, swap);
+		      if (!q)
+			return false;
+		    }
+		  fend = q;
+		  pass = 1;
+		}
+
+	      QList<ChunkJob> jobs;
+	      for(int c=0; c<starts.count(); c++)
+		{
+		  ChunkJob job;
+		  job.hdr = &hdr;
+		  job.mesh = &mesh;
+		  job.tri = tri.data();
+		  job.data = starts[c];
+		  job.end = (c < starts.count()-1 ? starts[c+1] : fend);
+		  job.first = c*chunkRecords;
+		  job.count = qMin(chunkRecords, el.count-job.first);
+		  job.ok = false;
+		  jobs << job;
+		}
+	      QtConcurrent::blockingMap(jobs, MeshReader::faceJob);
+
+	      ok = true;
+	      for(int c=0; c<jobs.count(); c++)
+		ok &= jobs[c].ok;
+	    }
+	  if (!ok)
+	    return false;
+	  //--------
+
+	  p = fend;
+	}
+      else if (el.size >= 0)
+	p += el.count*el.size;
+      else
+	{
+	  for(qint64 r=0; r<el.count && p; r++)
+	    p = skipRecord(p, end, el, swap);
+	  if (!p)
+	    return false;
+	}
+
+      if (p > end)
+	return false;
+    }
+
+  return true;
+}
+//---------------------------------------
+
+
+//---------------------------------------
+// ascii
+//---------------------------------------
+// parse one number, returns 0 when there is none before the line end
+static const uchar*
+scanNumber(const uchar *p, const uchar *end, double &v)
+{
+  while (p < end && (*p == ' ' || *p == '\t' || *p == '\r'))
+    p++;
+  if (p >= end || *p == '\n')
+    return 0;
+
+  bool neg = false;
+  if (*p == '-' || *p == '+')
+    {
+      neg = (*p == '-');
+      p++;
+    }
+
+  double m = 0;
+  int exp10 = 0;
+  bool digits = false;
+  while (p < end && *p >= '0' && *p <= '9')
+    {
+      m = m*10 + (*p - '0');
+      digits = true;
+      p++;
+    }
+  if (p < end && *p == '.')
+    {
+      p++;
+      while (p < end && *p >= '0' && *p <= '9')
+	{
+	  m = m*10 + (*p - '0');
+	  exp10--;
+	  digits = true;
+	  p++;
+	}
+    }
+  if (!digits)
+    return 0;
+
+  if (p < end && (*p == 'e' || *p == 'E'))
+    {
+      p++;
+      bool eneg = false;
+      if (p < end && (*p == '-' || *p == '+'))
+	{
+	  eneg = (*p == '-');
+	  p++;
+	}
+      int e = 0;
+      while (p < end && *p >= '0' && *p <= '9')
+	{
+	  e = e*10 + (*p - '0');
+	  p++;
+	}
+      exp10 += (eneg ? -e : e);
+    }
+
+  if (exp10 != 0)
+    m *= pow(10.0, exp10);
+  v = (neg ? -m : m);
+
+  return p;
+}
+
+void
+MeshReader::countLinesJob(ChunkJob &job)
+{
+  qint64 n = 0;
+  const uchar *p = job.data;
+  while (p < job.end)
+    {
+      const uchar *q = (const uchar*)memchr(p, '\n', job.end-p);
+      if (!q)
+	break;
+      n++;
+      p = q+1;
+    }
+  job.count = n;
+  job.ok = true;
+}
+
+void
+MeshReader::asciiJob(ChunkJob &job)
+{
+  const Header *hdr = job.hdr;
+  MeshStore *mesh = job.mesh;
+  bool normals = mesh->hasNormals();
+  bool colors = mesh->hasColors();
+
+  // line ranges of the elements
+  QList<qint64> lstart;
+  qint64 nl = 0;
+  for(int e=0; e<hdr->elements.count(); e++)
+    {
+      lstart << nl;
+      nl += hdr->elements[e].count;
+    }
+  lstart << nl;
+
+  QVector<double> val(64);
+
+  const uchar *p = job.data;
+  qint64 line = job.first;
+  while (p < job.end && line < nl)
+    {
+      int e = 0;
+      while (line >= lstart[e+1])
+	e++;
+      const Element &el = hdr->elements[e];
+      qint64 r = line - lstart[e];
+
+      if (el.name == "vertex")
+	{
+	  if (val.count() < el.props.count())
+	    val.resize(el.props.count());
+	  for(int k=0; k<el.props.count(); k++)
+	    {
+	      p = scanNumber(p, job.end, val[k]);
+	      if (!p)
+		{
+		  job.ok = false;
+		  return;
+		}
+	    }
+
+	  mesh->setVertex(r, val[hdr->px], val[hdr->py], val[hdr->pz]);
+	  if (normals)
+	    mesh->setNormal(r,
+			    hdr->pnx >= 0 ? val[hdr->pnx] : 0,
+			    hdr->pny >= 0 ? val[hdr->pny] : 0,
+			    hdr->pnz >= 0 ? val[hdr->pnz] : 0);
+	  if (colors)
+	    mesh->setColor(r,
+			   hdr->pr >= 0 ? qBound(0, (int)val[hdr->pr], 255) : 0,
+			   hdr->pg >= 0 ? qBound(0, (int)val[hdr->pg], 255) : 0,
+			   hdr->pb >= 0 ? qBound(0, (int)val[hdr->pb], 255) : 0);
+	}
+      else if (el.name == "face")
+	{
+	  uint *t = job.tri + 3*r;
+	  t[0] = invalidIndex;
+	  for(int k=0; k<el.props.count(); k++)
+	    {
+	      double v;
+	      p = scanNumber(p, job.end, v);
+	      if (!p)
+		{
+		  job.ok = false;
+		  return;
+		}
+	      if (!el.props[k].list)
+		continue;
+
+	      int n = v;
+	      for(int j=0; j<n; j++)
+		{
+		  p = scanNumber(p, job.end, v);
+		  if (!p)
+		    {
+		      job.ok = false;
+		      return;
+		    }
+		  if (k == hdr->pfaces && n >= 3 && j < 3)
+		    t[j] = v;
+		}
+	    }
+	}
+
+      // next line
+      const uchar *q = (const uchar*)memchr(p, '\n', job.end-p);
+      p = (q ? q+1 : job.end);
+      line++;
+    }
+
+  job.ok = true;
+}
+
+bool
+MeshReader::readAscii(const uchar *data, qint64 size,
+		      Header &hdr, MeshStore &mesh)
+{
+  const uchar *body = data + hdr.dataStart;
+  const uchar *end = data + size;
+
+  for(int e=0; e<hdr.elements.count(); e++)
+    {
+      if (hdr.elements[e].name == "vertex")
+	mesh.resize(hdr.elements[e].count,
+		    hdr.pnx >= 0 || hdr.pny >= 0 || hdr.pnz >= 0,
+		    hdr.pr >= 0 || hdr.pg >= 0 || hdr.pb >= 0);
+      else if (hdr.elements[e].name == "face")
+	mesh.triangles().resize(3*hdr.elements[e].count);
+    }
+
+  //--------
+  // split the body at line starts
+  QList<ChunkJob> jobs;
+  const uchar *p = body;
+  while (p < end)
+    {
+      const uchar *q = p + qMin(chunkBytes, (qint64)(end-p));
+      if (q < end)
+	{
+	  const uchar *nl = (const uchar*)memchr(q, '\n', end-q);
+	  q = (nl ? nl+1 : end);
+	}
+
+      ChunkJob job;
+      job.hdr = &hdr;
+      job.mesh = &mesh;
+      job.tri = mesh.triangles().data();
+      job.data = p;
+      job.end = q;
+      job.first = 0;
+      job.count = 0;
+      job.ok = false;
+      jobs << job;
+
+      p = q;
+    }
+  //--------
+
+  QtConcurrent::blockingMap(jobs, MeshReader::countLinesJob);
+
+  qint64 line = 0;
+  for(int c=0; c<jobs.count(); c++)
+    {
+      qint64 n = jobs[c].count;
+      jobs[c].first = line;
+      line += n;
+    }
+
+  QtConcurrent::blockingMap(jobs, MeshReader::asciiJob);
+
+  for(int c=0; c<jobs.count(); c++)
+    if (!jobs[c].ok)
+      return false;
+
+  return true;
+}
+//---------------------------------------
+
+bool
+MeshReader::readPLY(QString flnm, MeshStore &mesh)
+{
+  QFile fd(flnm);
+  if (!fd.open(QFile::ReadOnly))
+    return false;
+
+  qint64 size = fd.size();
+  uchar *data = fd.map(0, size);
+  if (!data)
+    return false;
+
+  Header hdr;
+  bool ok = readHeader(data, size, hdr);
+  if (ok)
+    {
+      mesh.clear();
+      if (hdr.format == 0)
+	ok = readAscii(data, size, hdr, mesh);
+      else
+	ok = readBinary(data, size, hdr, mesh);
+    }
+
+  fd.unmap(data);
+  fd.close();
+
+  if (!ok)
+    {
+      mesh.clear();
+      return false;
+    }
+
+  //--------
+  // keep triangles only, and only those with valid indices
+  QVector<uint> &tri = mesh.triangles();
+  uint nv = mesh.vertexCount();
+  int nt = 0;
+  for(int i=0; i<tri.count()/3; i++)
+    {
+      if (tri[3*i] < nv && tri[3*i+1] < nv && tri[3*i+2] < nv)
+	{
+	  if (nt != i)
+	    {
+	      tri[3*nt+0] = tri[3*i+0];
+	      tri[3*nt+1] = tri[3*i+1];
+	      tri[3*nt+2] = tri[3*i+2];
+	    }
+	  nt++;
+	}
+    }
+  tri.resize(3*nt);
+  //--------
+
+  return true;
+}
+
+void
+MeshReader::trisetJob(ChunkJob &job)
+{
+  const float *v = (const float*)job.data;
+  const float *n = (const float*)job.end;
+  for(qint64 r=0; r<job.count; r++)
+    {
+      qint64 i = job.first + r;
+      float f[6];
+      memcpy(f, v + 3*i, 12);
+      memcpy(f+3, n + 3*i, 12);
+      job.mesh->setVertex(i, f[0], f[1], f[2]);
+      job.mesh->setNormal(i, f[3], f[4], f[5]);
+    }
+  job.ok = true;
+}
+
+bool
+MeshReader::readTriset(QString flnm, MeshStore &mesh,
+		       int &nx, int &ny, int &nz)
+{
+  QFile fd(flnm);
+  if (!fd.open(QFile::ReadOnly))
+    return false;
+
+  qint64 size = fd.size();
+  if (size < 21)
+    return false;
+
+  uchar *data = fd.map(0, size);
+  if (!data)
+    return false;
+
+  int hdr[5];
+  memcpy(hdr, data+1, 20);
+  int nvert = hdr[3];
+  int ntri = hdr[4];
+  if (data[0] != 0 || nvert <= 0 || ntri < 0 ||
+      size < 21 + (qint64)nvert*24 + (qint64)ntri*12)
+    {
+      fd.unmap(data);
+      return false;
+    }
+
+  nx = hdr[0];
+  ny = hdr[1];
+  nz = hdr[2];
+
+  const uchar *vert = data + 21;
+  const uchar *norm = vert + (qint64)nvert*12;
+  const uchar *tri = norm + (qint64)nvert*12;
+
+  mesh.clear();
+  mesh.resize(nvert, true, false);
+
+  QList<ChunkJob> jobs;
+  for(qint64 r=0; r<nvert; r+=chunkRecords)
+    {
+      ChunkJob job;
+      job.hdr = 0;
+      job.mesh = &mesh;
+      job.tri = 0;
+      job.data = vert;
+      job.end = norm;
+      job.first = r;
+      job.count = qMin(chunkRecords, nvert-r);
+      job.ok = false;
+      jobs << job;
+    }
+  QtConcurrent::blockingMap(jobs, MeshReader::trisetJob);
+
+  mesh.triangles().resize(3*ntri);
+  memcpy(mesh.triangles().data(), tri, (qint64)ntri*12);
+
+  fd.unmap(data);
+  fd.close();
+
+  return true;
+}
+
+//---------------------------------------
+// native cache
+//---------------------------------------
+bool
+MeshReader::readCache(QString flnm, MeshStore &mesh)
+{
+  QFile fd;
+  qint64 size;
+  uchar *data = BinaryCache::map(fd, flnm, "mcache", cacheMagic, size);
+  if (!data)
+    return false;
+
+  qint64 hsize = 4*4;
+  int nvert, ntri, normals, colors;
+  nvert = ntri = -1;
+  normals = colors = 0;
+  if (size >= hsize)
+    {
+      memcpy(&nvert, data, 4);
+      memcpy(&ntri, data+4, 4);
+      memcpy(&normals, data+8, 4);
+      memcpy(&colors, data+12, 4);
+    }
+
+  qint64 expected = hsize +
+    (qint64)nvert*(12 + (normals ? 6 : 0) + (colors ? 3 : 0)) +
+    (qint64)ntri*12;
+
+  if (nvert < 0 || ntri < 0 || size != expected)
+    {
+      BinaryCache::unmap(fd, data);
+      return false;
+    }
+
+  mesh.clear();
+  mesh.resize(nvert, normals, colors);
+
+  const uchar *p = data + hsize;
+  for(int c=0; c<3; c++)
+    {
+      memcpy(mesh.positionData(c), p, (qint64)nvert*4);
+      p += (qint64)nvert*4;
+    }
+  if (normals)
+    for(int c=0; c<3; c++)
+      {
+	memcpy(mesh.normalData(c), p, (qint64)nvert*2);
+	p += (qint64)nvert*2;
+      }
+  if (colors)
+    {
+      memcpy(mesh.colorData(), p, (qint64)nvert*3);
+      p += (qint64)nvert*3;
+    }
+  mesh.triangles().resize(3*ntri);
+  memcpy(mesh.triangles().data(), p, (qint64)ntri*12);
+
+  BinaryCache::unmap(fd, data);
+
+  return true;
+}
+
+bool
+MeshReader::writeCache(QString flnm, MeshStore &mesh)
+{
+  QFile fd;
+  if (!BinaryCache::create(fd, flnm, "mcache", cacheMagic))
+    return false;
+
+  int nvert = mesh.vertexCount();
+  int ntri = mesh.triangleCount();
+  int normals = mesh.hasNormals();
+  int colors = mesh.hasColors();
+
+  fd.write((char*)&nvert, 4);
+  fd.write((char*)&ntri, 4);
+  fd.write((char*)&normals, 4);
+  fd.write((char*)&colors, 4);
+
+  bool ok = true;
+  for(int c=0; c<3; c++)
+    ok &= (fd.write((char*)mesh.positionData(c), (qint64)nvert*4) == (qint64)nvert*4);
+  if (normals)
+    for(int c=0; c<3; c++)
+      ok &= (fd.write((char*)mesh.normalData(c), (qint64)nvert*2) == (qint64)nvert*2);
+  if (colors)
+    ok &= (fd.write((char*)mesh.colorData(), (qint64)nvert*3) == (qint64)nvert*3);
+  ok &= (fd.write((char*)mesh.triangles().constData(), (qint64)ntri*12) == (qint64)ntri*12);
+
+  return BinaryCache::finish(fd, ok);
+}
+//---------------------------------------
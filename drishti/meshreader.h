@@ -0,0 +1,101 @@
+#ifndef MESHREADER_H
+#define MESHREADER_H
+
+#include <QString>
+#include <QList>
+
+#include "meshstore.h"
+
+//---------------------------------------
+// fast mesh ingest.
+// files are memory mapped and vertex and face records are
+// decoded in parallel chunks.  binary (either endian) and
+// ascii ply files are handled as long as the vertex element has
+// no list properties.  readPLY returns false for anything it
+// cannot read so that the caller can fall back to ply.c.
+// a decoded mesh can be kept in a BinaryCache in a native
+// layout that loads with a single map and copy.
+//---------------------------------------
+class MeshReader
+{
+ public :
+  static bool readPLY(QString, MeshStore&);
+  static bool readTriset(QString, MeshStore&, int&, int&, int&);
+
+  static bool readCache(QString, MeshStore&);
+  static bool writeCache(QString, MeshStore&);
+
+ private :
+  enum PropertyType
+  {
+    Int8 = 0,
+    Uint8,
+    Int16,
+    Uint16,
+    Int32,
+    Uint32,
+    Float32,
+    Float64
+  };
+
+  struct Property
+  {
+    QString name;
+    int type;
+    bool list;
+    int countType;
+    int offset; // byte offset within a fixed size record
+  };
+
+  struct Element
+  {
+    QString name;
+    qint64 count;
+    QList<Property> props;
+    int size; // record size, -1 when it has list properties
+  };
+
+  struct Header
+  {
+    int format; // 0 ascii, 1 little endian, 2 big endian
+    QList<Element> elements;
+    qint64 dataStart;
+
+    // property indices in the vertex element
+    int px, py, pz;
+    int pnx, pny, pnz;
+    int pr, pg, pb;
+    int pfaces; // list property in the face element
+  };
+
+  struct ChunkJob
+  {
+    const Header *hdr;
+    MeshStore *mesh;
+    uint *tri;
+    const uchar *data;
+    const uchar *end;
+    qint64 first;     // first record, or first line for ascii
+    qint64 count;
+    bool ok;
+  };
+
+  static int typeSize(int);
+  static int typeFromName(QString);
+  static bool readHeader(const uchar*, qint64, Header&);
+
+  static double binaryValue(const uchar*, int, bool);
+  static const uchar* skipRecord(const uchar*, const uchar*,
+				 const Element&, bool);
+
+  static void vertexJob(ChunkJob&);
+  static void faceJob(ChunkJob&);
+  static void countLinesJob(ChunkJob&);
+  static void asciiJob(ChunkJob&);
+  static void trisetJob(ChunkJob&);
+
+  static bool readBinary(const uchar*, qint64, Header&, MeshStore&);
+  static bool readAscii(const uchar*, qint64, Header&, MeshStore&);
+};
+
+#endif
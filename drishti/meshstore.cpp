@@ -0,0 +1,170 @@
+#include "meshstore.h"
+
+#include <math.h>
+
+MeshStore::MeshStore()
+{
+  clear();
+}
+
+void
+MeshStore::clear()
+{
+  m_x.clear();
+  m_y.clear();
+  m_z.clear();
+  m_nx.clear();
+  m_ny.clear();
+  m_nz.clear();
+  m_color.clear();
+  m_triangles.clear();
+  m_tv.clear();
+  m_shadow.clear();
+
+  for(int i=0; i<9; i++)
+    m_rot[i] = (i%4 == 0 ? 1.0f/32767.0f : 0.0f);
+}
+
+void
+MeshStore::resize(int n, bool normals, bool colors)
+{
+  m_x.clear();
+  m_y.clear();
+  m_z.clear();
+  m_nx.clear();
+  m_ny.clear();
+  m_nz.clear();
+  m_color.clear();
+  m_tv.clear();
+  m_shadow.clear();
+
+  m_x.resize(n);
+  m_y.resize(n);
+  m_z.resize(n);
+  if (normals)
+    {
+      m_nx.resize(n);
+      m_ny.resize(n);
+      m_nz.resize(n);
+    }
+  if (colors)
+    m_color.resize(3*n);
+}
+
+void
+MeshStore::setNormal(int i, float nx, float ny, float nz)
+{
+  float len = sqrt(nx*nx + ny*ny + nz*nz);
+  if (len > 0)
+    {
+      nx /= len;
+      ny /= len;
+      nz /= len;
+    }
+  m_nx[i] = qRound(nx*32767);
+  m_ny[i] = qRound(ny*32767);
+  m_nz[i] = qRound(nz*32767);
+}
+
+void
+MeshStore::fillColor(uchar r, uchar g, uchar b)
+{
+  int n = m_x.count();
+  m_color.resize(3*n);
+  uchar *c = m_color.data();
+  for(int i=0; i<n; i++)
+    {
+      c[3*i] = r;
+      c[3*i+1] = g;
+      c[3*i+2] = b;
+    }
+}
+
+void
+MeshStore::bounds(Vec &bmin, Vec &bmax)
+{
+  int n = m_x.count();
+  if (n == 0)
+    {
+      bmin = bmax = Vec(0,0,0);
+      return;
+    }
+
+  float mnx = m_x[0], mny = m_y[0], mnz = m_z[0];
+  float mxx = mnx, mxy = mny, mxz = mnz;
+  for(int i=1; i<n; i++)
+    {
+      mnx = qMin(mnx, m_x[i]); mxx = qMax(mxx, m_x[i]);
+      mny = qMin(mny, m_y[i]); mxy = qMax(mxy, m_y[i]);
+      mnz = qMin(mnz, m_z[i]); mxz = qMax(mxz, m_z[i]);
+    }
+  bmin = Vec(mnx, mny, mnz);
+  bmax = Vec(mxx, mxy, mxz);
+}
+
+void
+MeshStore::transform(double *xform, bool flip)
+{
+  int n = m_x.count();
+  if (m_tv.count() != 3*n)
+    m_tv.resize(3*n);
+
+  float m[12];
+  for(int i=0; i<12; i++)
+    m[i] = xform[i];
+
+  const float *x = m_x.constData();
+  const float *y = m_y.constData();
+  const float *z = m_z.constData();
+  float *tv = m_tv.data();
+  for(int i=0; i<n; i++)
+    {
+      tv[3*i+0] = m[0]*x[i] + m[1]*y[i] + m[2]*z[i] + m[3];
+      tv[3*i+1] = m[4]*x[i] + m[5]*y[i] + m[6]*z[i] + m[7];
+      tv[3*i+2] = m[8]*x[i] + m[9]*y[i] + m[10]*z[i] + m[11];
+    }
+
+  // fold flip and dequantisation into the normal rotation
+  float s = (flip ? -1.0f : 1.0f)/32767.0f;
+  for(int r=0; r<3; r++)
+    for(int c=0; c<3; c++)
+      m_rot[3*r+c] = s*m[4*r+c];
+}
+
+void
+MeshStore::tnormal(int i, float *n)
+{
+  float nx = m_nx[i];
+  float ny = m_ny[i];
+  float nz = m_nz[i];
+  n[0] = m_rot[0]*nx + m_rot[1]*ny + m_rot[2]*nz;
+  n[1] = m_rot[3]*nx + m_rot[4]*ny + m_rot[5]*nz;
+  n[2] = m_rot[6]*nx + m_rot[7]*ny + m_rot[8]*nz;
+}
+
+void
+MeshStore::allocateShadowCoords()
+{
+  if (m_shadow.count() != 2*m_x.count())
+    m_shadow.resize(2*m_x.count());
+}
+
+void
+MeshStore::releaseShadowCoords()
+{
+  m_shadow.clear();
+  m_shadow.squeeze();
+}
+
+qint64
+MeshStore::memoryUsed()
+{
+  qint64 mem = 0;
+  mem += 3*(qint64)m_x.capacity()*sizeof(float);
+  mem += 3*(qint64)m_nx.capacity()*sizeof(short);
+  mem += (qint64)m_color.capacity();
+  mem += (qint64)m_triangles.capacity()*sizeof(uint);
+  mem += (qint64)m_tv.capacity()*sizeof(float);
+  mem += (qint64)m_shadow.capacity()*sizeof(float);
+  return mem;
+}
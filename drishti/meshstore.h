@@ -0,0 +1,95 @@
+#ifndef MESHSTORE_H
+#define MESHSTORE_H
+
+#include <QVector>
+
+#include <QGLViewer/vec.h>
+using namespace qglviewer;
+
+//---------------------------------------
+// compact vertex storage for large triangle meshes.
+// positions are float arrays per component, normals are
+// quantised to 16 bits per component and colours to 8 bits,
+// 21 bytes per vertex in all.
+// transform() keeps transformed positions (12 bytes per
+// vertex, allocated on first use); transformed normals are
+// rotated when asked for.  shadow texture coordinates are
+// only allocated for blended drawing with shadows.
+//---------------------------------------
+class MeshStore
+{
+ public :
+  MeshStore();
+
+  void clear();
+
+  // allocate n vertices, normals and colours are optional.
+  // triangles are left as they are
+  void resize(int n, bool normals, bool colors);
+
+  int vertexCount() { return m_x.count(); }
+  bool hasNormals() { return m_nx.count() > 0; }
+  bool hasColors() { return m_color.count() > 0; }
+
+  void setVertex(int i, float x, float y, float z)
+  {
+    m_x[i] = x; m_y[i] = y; m_z[i] = z;
+  }
+  Vec vertex(int i) { return Vec(m_x[i], m_y[i], m_z[i]); }
+
+  void setNormal(int, float, float, float);
+  Vec normal(int i)
+  {
+    return Vec(m_nx[i], m_ny[i], m_nz[i])/32767.0f;
+  }
+
+  void setColor(int i, uchar r, uchar g, uchar b)
+  {
+    m_color[3*i] = r; m_color[3*i+1] = g; m_color[3*i+2] = b;
+  }
+  uchar* color(int i) { return m_color.data() + 3*i; }
+  void fillColor(uchar, uchar, uchar);
+
+  // raw component arrays for bulk loading
+  float* positionData(int c) { return (c==0 ? m_x : (c==1 ? m_y : m_z)).data(); }
+  short* normalData(int c) { return (c==0 ? m_nx : (c==1 ? m_ny : m_nz)).data(); }
+  uchar* colorData() { return m_color.data(); }
+
+  QVector<uint>& triangles() { return m_triangles; }
+  int triangleCount() { return m_triangles.count()/3; }
+
+  void bounds(Vec&, Vec&);
+
+  // 4x4 row major transform, normals are negated when flip is set
+  void transform(double*, bool);
+  bool isTransformed() { return m_tv.count() == 3*m_x.count(); }
+  Vec tvertex(int i)
+  {
+    return Vec(m_tv[3*i], m_tv[3*i+1], m_tv[3*i+2]);
+  }
+  const float* tvertexPtr(int i) { return m_tv.constData() + 3*i; }
+  void tnormal(int, float*);
+
+  void allocateShadowCoords();
+  void releaseShadowCoords();
+  bool hasShadowCoords() { return m_shadow.count() > 0; }
+  void setShadowCoord(int i, float tx, float ty)
+  {
+    m_shadow[2*i] = tx; m_shadow[2*i+1] = ty;
+  }
+  const float* shadowCoord(int i) { return m_shadow.constData() + 2*i; }
+
+  qint64 memoryUsed();
+
+ private :
+  QVector<float> m_x, m_y, m_z;
+  QVector<short> m_nx, m_ny, m_nz;
+  QVector<uchar> m_color;
+  QVector<uint> m_triangles;
+
+  QVector<float> m_tv; // interleaved for glVertex3fv
+  float m_rot[9];      // normal rotation including flip and quantisation
+  QVector<float> m_shadow;
+};
+
+#endif
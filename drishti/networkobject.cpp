@@ -213,50 +213,31 @@ NetworkObject::load(QString flnm)
 }
 
 bool
-NetworkObject::loadTextNetwork(QString flnm)
+NetworkObject::readNetwork(QString flnm,
+			   NetworkReader::Network &net,
+			   bool graphml)
 {
-  m_fileName = flnm;
-  
-  m_nodeAtt.clear();
-  m_edgeAtt.clear();
+  if (NetworkReader::readCache(flnm, net))
+    return true;
 
-  QFile fl(m_fileName);
-  if (!fl.open(QIODevice::ReadOnly | QIODevice::Text))
-    return false;
+  bool ok;
+  if (graphml)
+    ok = NetworkReader::readGraphML(flnm, net);
+  else
+    ok = NetworkReader::readText(flnm, net);
 
-  QTextStream in(&fl);
-  QString line;
-  QStringList words;
-  int nvert = 0;
-  int nedge = 0;
-  int nva = 0;
-  int nea = 0;
-
-  line = in.readLine();
-  words = line.split(" ", QString::SkipEmptyParts);
-  nvert = words[0].toInt();
-  if (words.count() > 1)
-    nva = words[1].toInt();
-
-  line = in.readLine();
-  words = line.split(" ", QString::SkipEmptyParts);
-  nedge = words[0].toInt();
-  if (words.count() > 1)
-    nea = words[1].toInt();
-
-  for(int i=0; i<nva; i++)
-    {
-      line = in.readLine();
-      words = line.split("#", QString::SkipEmptyParts);
-      m_nodeAtt << words[0];
-    }
-    
-  for(int i=0; i<nea; i++)
-    {
-      line = in.readLine();
-      words = line.split("#", QString::SkipEmptyParts);
-      m_edgeAtt << words[0];
-    }
+  if (ok)
+    NetworkReader::writeCache(flnm, net);
+
+  return ok;
+}
+
+void
+NetworkObject::setNetwork(NetworkReader::Network &net,
+			  bool halveVertexDiameter)
+{
+  m_nodeAtt = net.nodeAtt;
+  m_edgeAtt = net.edgeAtt;
 
   m_vertexRadiusAttribute = -1;
   m_edgeRadiusAttribute = -1;
@@ -281,113 +262,75 @@ NetworkObject::loadTextNetwork(QString flnm)
     }
 
   //------------------------------------
-  // read node information
-  {
-    m_vertexAttribute.clear();
-    m_vertexCenters.clear();
+  // node information
+  m_vertexAttribute.clear();
+  m_vertexCenters = net.centers;
 
-    QVector<float> *vat; // not expecting more than 20 attributes
-    int nvat = m_nodeAtt.count();
-    vat = new QVector<float> [nvat];
+  for(int vi=0; vi<m_nodeAtt.count(); vi++)
+    {
+      QVector<float> vat = net.nodeValues[vi];
+      if (halveVertexDiameter &&
+	  m_nodeAtt[vi].contains("diameter", Qt::CaseInsensitive))
+	{
+	  for(int i=0; i<vat.count(); i++)
+	    vat[i] /= 2;
+	}
+      m_vertexAttribute << qMakePair(m_nodeAtt[vi], vat);
+    }
 
-    for(int i=0; i<nvert; i++)
-      {
-	line = in.readLine();
-	line = line.simplified();
-	words = line.split(" ", QString::SkipEmptyParts);
-	float x, y, z;
-	x = words[0].toFloat();
-	y = words[1].toFloat();
-	z = words[2].toFloat();
-	m_vertexCenters << Vec(x,y,z);
-	for (int j=0; j<qMin((int)(words.count()-3),nvat); j++)
-	  vat[j] << words[3+j].toFloat();
-      }
-    
-    int nv = m_vertexCenters.count();
-    for(int c=0; c<m_nodeAtt.count(); c++)
-      {
-	if (vat[c].count() < nv)
-	  vat[c] << 0.0;
-      }
-    
-    for(int vi=0; vi<m_nodeAtt.count(); vi++)
-      m_vertexAttribute << qMakePair(m_nodeAtt[vi], vat[vi]);      
+  if (m_vertexRadiusAttribute == -1)
+    {
+      m_vertexRadiusAttribute = m_nodeAtt.count();
+      QVector<float> rad;
+      rad.resize(m_vertexCenters.count());
+      rad.fill(2);
+      m_nodeAtt << "vertex_radius";
+      m_vertexAttribute << qMakePair(QString("vertex_radius"), rad);
+    }
+  //------------------------------------
 
-    if (m_vertexRadiusAttribute == -1)
-      {
-	m_vertexRadiusAttribute = m_nodeAtt.count();
-	QVector<float> rad;
-	rad.resize(m_vertexCenters.count());
-	rad.fill(2);
-	m_nodeAtt << "vertex_radius";
-	m_vertexAttribute << qMakePair(QString("vertex_radius"), rad);
-      }
-    
-    for(int i=0; i<nvat; i++)
-      vat[i].clear();
-    delete [] vat;
-  }
   //------------------------------------
-  
+  // edge information
+  m_edgeAttribute.clear();
+  m_edgeNeighbours = net.edges;
+
+  for(int e=0; e<m_edgeAtt.count(); e++)
+    {
+      QVector<float> vat = net.edgeValues[e];
+      if (m_edgeAtt[e].contains("diameter", Qt::CaseInsensitive))
+	{
+	  for(int i=0; i<vat.count(); i++)
+	    vat[i] /= 2;
+	}
+      m_edgeAttribute << qMakePair(m_edgeAtt[e], vat);
+    }
+
+  if (m_edgeRadiusAttribute == -1)
+    {
+      m_edgeRadiusAttribute = m_edgeAtt.count();
+      QVector<float> rad;
+      rad.resize(m_edgeNeighbours.count());
+      rad.fill(2);
+      m_edgeAtt << "edge_radius";
+      m_edgeAttribute << qMakePair(QString("edge_radius"), rad);
+    }
   //------------------------------------
-  // read edge information
-  {
-    m_edgeAttribute.clear();
-    m_edgeNeighbours.clear();
+}
 
-    QVector<float> *vat; // not expecting more than 20 attributes
-    int nvat = m_edgeAtt.count();
-    vat = new QVector<float> [nvat];
+bool
+NetworkObject::loadTextNetwork(QString flnm)
+{
+  m_fileName = flnm;
 
-    for(int i=0; i<nedge; i++)
-      {
-	line = in.readLine();
-	line = line.simplified();
-	words = line.split(" ", QString::SkipEmptyParts);
-	int a, b;
-	a = words[0].toInt();
-	b = words[1].toInt();
-	m_edgeNeighbours << qMakePair(a,b);
-	for (int j=0; j<qMin((int)(words.count()-2),nvat); j++)
-	  vat[j] << words[2+j].toFloat();
-      }
-    
-    int nv = m_edgeNeighbours.count();
-    for(int c=0; c<m_edgeAtt.count(); c++)
-      {
-	if (vat[c].count() < nv)
-	  vat[c] << 0.0;
-      }
+  NetworkReader::Network net;
+  if (!readNetwork(flnm, net, false))
+    return false;
 
-    for(int e=0; e<m_edgeAtt.count(); e++)
-      {
-	if (m_edgeAtt[e].contains("diameter", Qt::CaseInsensitive))
-	  {
-	    for(int vi=0; vi<vat[e].count(); vi++)
-	      vat[e][vi] /= 2;
-	  }
-      }
+  // vertex diameters are used as they are in text networks
+  setNetwork(net, false);
+  if (m_vertexCenters.count() == 0)
+    return false;
 
-    for(int vi=0; vi<m_edgeAtt.count(); vi++)
-      m_edgeAttribute << qMakePair(m_edgeAtt[vi], vat[vi]);      
-    
-    if (m_edgeRadiusAttribute == -1)
-      {
-	m_edgeRadiusAttribute = m_edgeAtt.count();
-	QVector<float> rad;
-	rad.resize(m_edgeNeighbours.count());
-	rad.fill(2);
-	m_edgeAtt << "edge_radius";
-	m_edgeAttribute << qMakePair(QString("edge_radius"), rad);
-      }
-    
-    for(int i=0; i<nvat; i++)
-      vat[i].clear();
-    delete [] vat;
-  }
-  //------------------------------------
-    
   //---------------------
   Vec bmin = m_vertexCenters[0];
   Vec bmax = m_vertexCenters[0];
@@ -1510,270 +1453,18 @@ NetworkObject::set(NetworkInformation ti)
   return ok;
 }
 
-void
-NetworkObject::getKey(QDomElement main)
-{
-  m_nodeAtt.clear();
-  m_edgeAtt.clear();
-
-  QDomNodeList dlist = main.childNodes();
-  for(int i=0; i<dlist.count(); i++)
-    {
-      if (dlist.at(i).isElement())
-	{
-	  QDomElement ele = dlist.at(i).toElement();
-	  QString str = ele.nodeName();
-	  if (str == "key")
-	    {
-	      QDomNamedNodeMap attr = ele.attributes();
-	      int nattr = attr.count();
-	      bool isnode = false;
-	      bool isedge = false;
-	      for(int na=0; na<nattr; na++)
-		{
-		  QDomNode node = attr.item(na);
-		  QString name = node.nodeName();
-		  QString val = node.nodeValue();
-		  if (val == "node") { isnode = true; break; }
-		  if (val == "edge") { isedge = true; break; }
-		}
-	      for(int na=0; na<nattr; na++)
-		{
-		  QDomNode node = attr.item(na);
-		  QString name = node.nodeName();
-		  QString val = node.nodeValue();
-		  if (isnode && name == "id")
-		    {
-		      if (val != "x" &&
-			  val != "y" &&
-			  val != "z")
-			m_nodeAtt << val;
-		    }
-		  if (isedge && name == "id")
-		    m_edgeAtt << val;
-		}
-	    }
-	}
-    }
-
-  m_vertexRadiusAttribute = -1;
-  m_edgeRadiusAttribute = -1;
-
-  for(int i=0; i<m_nodeAtt.count(); i++)
-    {
-      if (m_nodeAtt[i].contains("radius", Qt::CaseInsensitive) ||
-	  m_nodeAtt[i].contains("diameter", Qt::CaseInsensitive))
-	{
-	  m_vertexRadiusAttribute = i;
-	  break;
-	}
-    }
-  for(int i=0; i<m_edgeAtt.count(); i++)
-    {
-      if (m_edgeAtt[i].contains("radius", Qt::CaseInsensitive) ||
-	  m_edgeAtt[i].contains("diameter", Qt::CaseInsensitive))
-	{
-	  m_edgeRadiusAttribute = i;
-	  break;
-	}
-    }
-}
-
-void
-NetworkObject::loadNodeInfo(QDomNodeList nnodes)
-{
-  m_vertexAttribute.clear();
-  m_vertexCenters.clear();
-  m_nodeId.clear();
-
-  QVector<float> *vat; // not expecting more than 20 attributes
-  int nvat = m_nodeAtt.count();
-  vat = new QVector<float> [nvat];
-
-  int nn = nnodes.count();
-  for(int n=0; n<nn; n++)
-    {
-      QDomElement ele = nnodes.item(n).toElement();
-      QString id = ele.attributeNode("id").value();
-      m_nodeId << id;
-
-      Vec pos;
-
-      QDomNodeList nlist = nnodes.item(n).childNodes();
-      int nc = nlist.count();
-      for(int c=0; c<nc; c++)
-	{
-	  QDomNode node = nlist.item(c);
-	  QDomElement ele = node.toElement();
-	  QString et = ele.text();
-
-	  QDomNamedNodeMap attr = ele.attributes();
-	  QString name = attr.item(0).nodeName();
-	  QString val = attr.item(0).nodeValue();
-	  if (val == "x") pos.x = et.toFloat();
-	  else if (val == "y") pos.y = et.toFloat();
-	  else if (val == "z") pos.z = et.toFloat();
-	  else 
-	    {
-	      int vi = m_nodeAtt.indexOf(val);
-	      if (vi >= 0)
-		vat[vi] << et.toFloat();
-	    }
-	}
-      m_vertexCenters << pos;
-
-      int nv = m_vertexCenters.count();
-      for(int c=0; c<m_nodeAtt.count(); c++)
-	{
-	  if (vat[c].count() < nv)
-	    vat[c] << 0.0;
-	}
-    }
-
-  for(int e=0; e<m_nodeAtt.count(); e++)
-    {
-      if (m_nodeAtt[e].contains("diameter", Qt::CaseInsensitive))
-	{
-	  for(int vi=0; vi<vat[e].count(); vi++)
-	    vat[e][vi] /= 2;
-	}
-    }
-
-
-  for(int vi=0; vi<m_nodeAtt.count(); vi++)
-    m_vertexAttribute << qMakePair(m_nodeAtt[vi], vat[vi]);      
-
-  if (m_vertexRadiusAttribute == -1)
-    {
-      m_vertexRadiusAttribute = m_nodeAtt.count();
-      QVector<float> rad;
-      rad.resize(m_vertexCenters.count());
-      rad.fill(2);
-      m_nodeAtt << "vertex_radius";
-      m_vertexAttribute << qMakePair(QString("vertex_radius"), rad);
-    }
-
-  for(int i=0; i<nvat; i++)
-    vat[i].clear();
-  delete [] vat;
-}
-
-void
-NetworkObject::loadEdgeInfo(QDomNodeList nnodes)
-{
-  m_edgeAttribute.clear();
-  m_edgeNeighbours.clear();
-
-  QVector<float> *vat; // not expecting more than 20 attributes
-  int nvat = m_edgeAtt.count();
-  vat = new QVector<float> [nvat];
-
-  int nn = nnodes.count();
-  for(int n=0; n<nn; n++)
-    {
-      QDomElement ele = nnodes.item(n).toElement();
-      QString id = ele.attributeNode("id").value();
-      QString src = ele.attributeNode("source").value();
-      QString tar = ele.attributeNode("target").value();
-      int a,b;
-      a = m_nodeId.indexOf(src);
-      b = m_nodeId.indexOf(tar);
-      if (a >= 0 && b >= 0)
-	m_edgeNeighbours << qMakePair(a,b);
-
-      QDomNodeList nlist = nnodes.item(n).childNodes();
-      int nc = nlist.count();
-      for(int c=0; c<nc; c++)
-	{
-	  QDomNode node = nlist.item(c);
-	  QDomElement ele = node.toElement();
-	  QString et = ele.text();
-	  QDomNamedNodeMap attr = ele.attributes();
-	  QString name = attr.item(0).nodeName();
-	  QString val = attr.item(0).nodeValue();
-
-	  int vi = m_edgeAtt.indexOf(val);
-	  if (vi >= 0)
-	    vat[vi] << et.toFloat();
-	}
-
-      int nv = m_edgeNeighbours.count();
-      for(int c=0; c<m_edgeAtt.count(); c++)
-	{
-	  if (vat[c].count() < nv)
-	    vat[c] << 0.0;
-	}
-    }
-
-  for(int e=0; e<m_edgeAtt.count(); e++)
-    {
-      if (m_edgeAtt[e].contains("diameter", Qt::CaseInsensitive))
-	{
-	  for(int vi=0; vi<vat[e].count(); vi++)
-	    vat[e][vi] /= 2;
-	}
-    }
-
-  for(int vi=0; vi<m_edgeAtt.count(); vi++)
-    m_edgeAttribute << qMakePair(m_edgeAtt[vi], vat[vi]);      
-
-  if (m_edgeRadiusAttribute == -1)
-    {
-      m_edgeRadiusAttribute = m_edgeAtt.count();
-      QVector<float> rad;
-      rad.resize(m_edgeNeighbours.count());
-      rad.fill(2);
-      m_edgeAtt << "edge_radius";
-      m_edgeAttribute << qMakePair(QString("edge_radius"), rad);
-    }
-
-  for(int i=0; i<nvat; i++)
-    vat[i].clear();
-  delete [] vat;
-}
-
 bool
 NetworkObject::loadGraphML(QString flnm)
 {
   m_fileName = flnm;
 
-  QDomDocument doc;
-  QFile f(flnm.toLatin1().data());
-  if (f.open(QIODevice::ReadOnly))
-    {
-      doc.setContent(&f);
-      f.close();
-    }
-
-  QDomElement main = doc.documentElement();
-  getKey(main);
-
-//  m_log->insertPlainText("Node Attributes \n");
-//  for(int i=0; i<m_nodeAtt.count(); i++)
-//    m_log->insertPlainText("     "+m_nodeAtt[i]+"\n");
-//  m_log->insertPlainText("\n");
-//  m_log->insertPlainText("Edge Attributes \n");
-//  for(int i=0; i<m_edgeAtt.count(); i++)
-//    m_log->insertPlainText("     "+m_edgeAtt[i]+"\n");
-//  m_log->insertPlainText("\n");
- 
-  QDomNodeList dlist = main.childNodes();
-  for(int i=0; i<dlist.count(); i++)
-    {
-      if (dlist.at(i).isElement())
-	{
-	  QDomElement ele = dlist.at(i).toElement();
-	  QString str = ele.nodeName();
-	  if (str == "graph")
-	    {
-	      QDomNodeList nnodes = ele.elementsByTagName("node");
-	      loadNodeInfo(nnodes);
+  NetworkReader::Network net;
+  if (!readNetwork(flnm, net, true))
+    return false;
 
-	      QDomNodeList nedges = ele.elementsByTagName("edge");
-	      loadEdgeInfo(nedges);
-	    }
-	}
-    }
+  setNetwork(net, true);
+  if (m_vertexCenters.count() == 0)
+    return false;
 
   //---------------------
   Vec bmin = m_vertexCenters[0];
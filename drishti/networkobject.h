@@ -5,6 +5,7 @@
 
 #include "networkinformation.h"
 #include "cropobject.h"
+#include "networkreader.h"
 #include <QDomDocument>
 
 class NetworkObject
@@ -132,7 +133,6 @@ class NetworkObject
   QVector< QPair<QString, QVector<float> > > m_edgeAttribute;
   QVector<Vec> m_vertexCenters;
   QVector< QPair<int, int> > m_edgeNeighbours;
-  QStringList m_nodeId;
   QStringList m_nodeAtt;
   QStringList m_edgeAtt;
   //-------------------
@@ -161,9 +161,8 @@ class NetworkObject
   bool loadGraphML(QString);
   bool loadNetCDF(QString);
 
-  void loadEdgeInfo(QDomNodeList);
-  void loadNodeInfo(QDomNodeList);
-  void getKey(QDomElement);
+  bool readNetwork(QString, NetworkReader::Network&, bool);
+  void setNetwork(NetworkReader::Network&, bool);
 };
 
 #endif
@@ -0,0 +1,542 @@
+#include "networkreader.h"
+#include "binarycache.h"
+
+#include <QFile>
+#include <QHash>
+#include <QXmlStreamReader>
+
+#include <math.h>
+
+static const char cacheMagic[4] = { 'D', 'N', 'C', '1' };
+
+void
+NetworkReader::clear(Network &net)
+{
+  net.nodeAtt.clear();
+  net.edgeAtt.clear();
+  net.centers.clear();
+  net.edges.clear();
+  net.nodeValues.clear();
+  net.edgeValues.clear();
+}
+
+//---------------------------------------
+// text networks
+//---------------------------------------
+static const uchar*
+lineEnd(const uchar *p, const uchar *end)
+{
+  while (p < end && *p != '\n')
+    p++;
+  return p;
+}
+
+// parse one value, returns 0 when there is none before the line
+// end.  tokens that are not numbers are skipped and read as 0
+static const uchar*
+scanValue(const uchar *p, const uchar *end, double &v)
+{
+  while (p < end && (*p == ' ' || *p == '\t' || *p == '\r'))
+    p++;
+  if (p >= end || *p == '\n')
+    return 0;
+
+  const uchar *start = p;
+  bool neg = false;
+  if (*p == '-' || *p == '+')
+    {
+      neg = (*p == '-');
+      p++;
+    }
+
+  double m = 0;
+  int exp10 = 0;
+  bool digits = false;
+  while (p < end && *p >= '0' && *p <= '9')
+    {
+      m = m*10 + (*p - '0');
+      digits = true;
+      p++;
+    }
+  if (p < end && *p == '.')
+    {
+      p++;
+      while (p < end && *p >= '0' && *p <= '9')
+	{
+	  m = m*10 + (*p - '0');
+	  exp10--;
+	  digits = true;
+	  p++;
+	}
+    }
+  if (digits && p < end && (*p == 'e' || *p == 'E'))
+    {
+      p++;
+      bool eneg = false;
+      if (p < end && (*p == '-' || *p == '+'))
+	{
+	  eneg = (*p == '-');
+	  p++;
+	}
+      int e = 0;
+      while (p < end && *p >= '0' && *p <= '9')
+	{
+	  e = e*10 + (*p - '0');
+	  p++;
+	}
+      exp10 += (eneg ? -e : e);
+    }
+
+  if (!digits ||
+      (p < end && *p != ' ' && *p != '\t' && *p != '\r' && *p != '\n'))
+    {
+      p = start;
+      while (p < end && *p != ' ' && *p != '\t' && *p != '\r' && *p != '\n')
+	p++;
+      v = 0;
+      return p;
+    }
+
+  if (exp10 != 0)
+    m *= pow(10.0, exp10);
+  v = (neg ? -m : m);
+
+  return p;
+}
+
+static QString
+headerLine(const uchar *&p, const uchar *end)
+{
+  const uchar *e = lineEnd(p, end);
+  QString line = QString::fromLatin1((const char*)p, e-p);
+  p = (e < end ? e+1 : end);
+  return line;
+}
+
+bool
+NetworkReader::readText(QString flnm, Network &net)
+{
+  clear(net);
+
+  QFile fd(flnm);
+  if (!fd.open(QFile::ReadOnly))
+    return false;
+
+  qint64 size = fd.size();
+  if (size <= 0)
+    return false;
+
+  uchar *data = fd.map(0, size);
+  if (!data)
+    return false;
+
+  const uchar *p = data;
+  const uchar *end = data + size;
+
+  QStringList words;
+  int nvert = 0;
+  int nedge = 0;
+  int nva = 0;
+  int nea = 0;
+
+  words = headerLine(p, end).split(" ", QString::SkipEmptyParts);
+  if (words.count() > 0) nvert = words[0].toInt();
+  if (words.count() > 1) nva = words[1].toInt();
+
+  words = headerLine(p, end).split(" ", QString::SkipEmptyParts);
+  if (words.count() > 0) nedge = words[0].toInt();
+  if (words.count() > 1) nea = words[1].toInt();
+
+  for(int i=0; i<nva; i++)
+    {
+      QString line = headerLine(p, end);
+      words = line.split("#", QString::SkipEmptyParts);
+      net.nodeAtt << (words.count() > 0 ? words[0] : line);
+    }
+  for(int i=0; i<nea; i++)
+    {
+      QString line = headerLine(p, end);
+      words = line.split("#", QString::SkipEmptyParts);
+      net.edgeAtt << (words.count() > 0 ? words[0] : line);
+    }
+
+  nvert = qMax(0, nvert);
+  nedge = qMax(0, nedge);
+
+  //---------------
+  // one line per vertex : x y z attributes
+  net.centers.reserve(nvert);
+  net.nodeValues.resize(nva);
+  for(int a=0; a<nva; a++)
+    net.nodeValues[a].reserve(nvert);
+
+  double v;
+  for(int i=0; i<nvert && p<end; i++)
+    {
+      const uchar *e = lineEnd(p, end);
+      double x[3] = { 0, 0, 0 };
+      for(int c=0; c<3 && p; c++)
+	if ((p = scanValue(p, e, v)))
+	  x[c] = v;
+      net.centers << Vec(x[0], x[1], x[2]);
+
+      for(int a=0; a<nva; a++)
+	{
+	  if (p && (p = scanValue(p, e, v)))
+	    net.nodeValues[a] << v;
+	  else
+	    net.nodeValues[a] << 0.0f;
+	}
+      p = (e < end ? e+1 : end);
+    }
+  //---------------
+
+  //---------------
+  // one line per edge : a b attributes
+  net.edges.reserve(nedge);
+  net.edgeValues.resize(nea);
+  for(int a=0; a<nea; a++)
+    net.edgeValues[a].reserve(nedge);
+
+  for(int i=0; i<nedge && p<end; i++)
+    {
+      const uchar *e = lineEnd(p, end);
+      double x[2] = { 0, 0 };
+      for(int c=0; c<2 && p; c++)
+	if ((p = scanValue(p, e, v)))
+	  x[c] = v;
+      net.edges << qMakePair((int)x[0], (int)x[1]);
+
+      for(int a=0; a<nea; a++)
+	{
+	  if (p && (p = scanValue(p, e, v)))
+	    net.edgeValues[a] << v;
+	  else
+	    net.edgeValues[a] << 0.0f;
+	}
+      p = (e < end ? e+1 : end);
+    }
+  //---------------
+
+  fd.unmap(data);
+  fd.close();
+
+  return true;
+}
+
+//---------------------------------------
+// graphml
+//---------------------------------------
+bool
+NetworkReader::readGraphML(QString flnm, Network &net)
+{
+  clear(net);
+
+  QFile fd(flnm);
+  if (!fd.open(QIODevice::ReadOnly))
+    return false;
+
+  QXmlStreamReader xml(&fd);
+
+  // key ids to attribute index
+  QHash<QString, int> nodeKey;
+  QHash<QString, int> edgeKey;
+
+  QHash<QString, int> nodeIndex;
+
+  // edges that refer to nodes which come later in the file
+  QList<int> pending;
+  QStringList pendingSrc, pendingTar;
+
+  bool inNode = false;
+  bool inEdge = false;
+  int cur = -1;
+
+  while (!xml.atEnd())
+    {
+      xml.readNext();
+
+      if (xml.isEndElement())
+	{
+	  if (xml.name() == QLatin1String("node"))
+	    inNode = false;
+	  else if (xml.name() == QLatin1String("edge"))
+	    inEdge = false;
+	  continue;
+	}
+
+      if (!xml.isStartElement())
+	continue;
+
+      QXmlStreamAttributes attr = xml.attributes();
+
+      if (xml.name() == QLatin1String("key"))
+	{
+	  // the first attribute with value node or edge decides
+	  bool isnode = false;
+	  bool isedge = false;
+	  for(int na=0; na<attr.count(); na++)
+	    {
+	      if (attr[na].value() == QLatin1String("node")) { isnode = true; break; }
+	      if (attr[na].value() == QLatin1String("edge")) { isedge = true; break; }
+	    }
+	  QString id = attr.value("id").toString();
+	  if (isnode && id != "x" && id != "y" && id != "z")
+	    {
+	      if (!nodeKey.contains(id))
+		{
+		  nodeKey.insert(id, net.nodeAtt.count());
+		  net.nodeAtt << id;
+		  net.nodeValues << QVector<float>(net.centers.count(), 0.0f);
+		}
+	    }
+	  if (isedge && !edgeKey.contains(id))
+	    {
+	      edgeKey.insert(id, net.edgeAtt.count());
+	      net.edgeAtt << id;
+	      net.edgeValues << QVector<float>(net.edges.count(), 0.0f);
+	    }
+	}
+      else if (xml.name() == QLatin1String("node"))
+	{
+	  QString id = attr.value("id").toString();
+	  cur = net.centers.count();
+	  if (!nodeIndex.contains(id))
+	    nodeIndex.insert(id, cur);
+	  net.centers << Vec(0,0,0);
+	  for(int a=0; a<net.nodeValues.count(); a++)
+	    net.nodeValues[a] << 0.0f;
+	  inNode = true;
+	}
+      else if (xml.name() == QLatin1String("edge"))
+	{
+	  QString src = attr.value("source").toString();
+	  QString tar = attr.value("target").toString();
+	  cur = net.edges.count();
+	  int a = nodeIndex.value(src, -1);
+	  int b = nodeIndex.value(tar, -1);
+	  if (a < 0 || b < 0)
+	    {
+	      pending << cur;
+	      pendingSrc << src;
+	      pendingTar << tar;
+	    }
+	  net.edges << qMakePair(a, b);
+	  for(int e=0; e<net.edgeValues.count(); e++)
+	    net.edgeValues[e] << 0.0f;
+	  inEdge = true;
+	}
+      else if (xml.name() == QLatin1String("data") && (inNode || inEdge))
+	{
+	  QString key;
+	  if (attr.count() > 0)
+	    key = attr[0].value().toString();
+	  float v = xml.readElementText().toFloat();
+	  if (inNode)
+	    {
+	      int k = nodeKey.value(key, -4);
+	      if (key == "x") net.centers[cur].x = v;
+	      else if (key == "y") net.centers[cur].y = v;
+	      else if (key == "z") net.centers[cur].z = v;
+	      else if (k >= 0)
+		net.nodeValues[k][cur] = v;
+	    }
+	  else
+	    {
+	      int k = edgeKey.value(key, -1);
+	      if (k >= 0)
+		net.edgeValues[k][cur] = v;
+	    }
+	}
+    }
+
+  bool ok = !xml.hasError();
+  fd.close();
+  if (!ok)
+    {
+      clear(net);
+      return false;
+    }
+
+  //---------------
+  // resolve forward references and drop edges to unknown nodes
+  if (pending.count() > 0)
+    {
+      QVector<bool> keep(net.edges.count(), true);
+      for(int i=0; i<pending.count(); i++)
+	{
+	  int a = nodeIndex.value(pendingSrc[i], -1);
+	  int b = nodeIndex.value(pendingTar[i], -1);
+	  net.edges[pending[i]] = qMakePair(a, b);
+	  keep[pending[i]] = (a >= 0 && b >= 0);
+	}
+
+      int ne = 0;
+      for(int i=0; i<net.edges.count(); i++)
+	if (keep[i])
+	  {
+	    net.edges[ne] = net.edges[i];
+	    for(int e=0; e<net.edgeValues.count(); e++)
+	      net.edgeValues[e][ne] = net.edgeValues[e][i];
+	    ne++;
+	  }
+      net.edges.resize(ne);
+      for(int e=0; e<net.edgeValues.count(); e++)
+	net.edgeValues[e].resize(ne);
+    }
+  //---------------
+
+  return true;
+}
+
+//---------------------------------------
+// binary cache
+//---------------------------------------
+static bool
+readBytes(const uchar *&p, const uchar *end, void *dst, qint64 n)
+{
+  if (n < 0 || end-p < n)
+    return false;
+  memcpy(dst, p, n);
+  p += n;
+  return true;
+}
+
+static bool
+readNames(const uchar *&p, const uchar *end, QStringList &names)
+{
+  int n;
+  if (!readBytes(p, end, &n, 4) || n < 0)
+    return false;
+  for(int i=0; i<n; i++)
+    {
+      int len;
+      if (!readBytes(p, end, &len, 4) || len < 0 || end-p < len)
+	return false;
+      names << QString::fromUtf8((const char*)p, len);
+      p += len;
+    }
+  return true;
+}
+
+static void
+writeNames(QFile &fd, QStringList &names)
+{
+  int n = names.count();
+  fd.write((char*)&n, 4);
+  for(int i=0; i<n; i++)
+    {
+      QByteArray b = names[i].toUtf8();
+      int len = b.size();
+      fd.write((char*)&len, 4);
+      fd.write(b.constData(), len);
+    }
+}
+
+bool
+NetworkReader::readCache(QString flnm, Network &net)
+{
+  QFile fd;
+  qint64 size;
+  uchar *data = BinaryCache::map(fd, flnm, "ncache", cacheMagic, size);
+  if (!data)
+    return false;
+
+  clear(net);
+
+  const uchar *p = data;
+  const uchar *end = data + size;
+
+  bool ok = readNames(p, end, net.nodeAtt);
+  ok = ok && readNames(p, end, net.edgeAtt);
+
+  int nv = 0, ne = 0;
+  ok = ok && readBytes(p, end, &nv, 4) && readBytes(p, end, &ne, 4);
+  ok = ok && nv >= 0 && ne >= 0;
+
+  // everything that follows has a known size
+  qint64 rest = (qint64)nv*(3*8 + 4*net.nodeAtt.count()) +
+                (qint64)ne*(2*4 + 4*net.edgeAtt.count());
+  ok = ok && (end-p == rest);
+
+  if (ok)
+    {
+      net.centers.resize(nv);
+      double *c = new double[3*(qint64)nv];
+      readBytes(p, end, c, (qint64)nv*24);
+      for(int i=0; i<nv; i++)
+	net.centers[i] = Vec(c[3*i], c[3*i+1], c[3*i+2]);
+      delete [] c;
+
+      net.edges.resize(ne);
+      int *e = new int[2*(qint64)ne];
+      readBytes(p, end, e, (qint64)ne*8);
+      for(int i=0; i<ne; i++)
+	net.edges[i] = qMakePair(e[2*i], e[2*i+1]);
+      delete [] e;
+
+      net.nodeValues.resize(net.nodeAtt.count());
+      for(int a=0; a<net.nodeAtt.count(); a++)
+	{
+	  net.nodeValues[a].resize(nv);
+	  readBytes(p, end, net.nodeValues[a].data(), (qint64)nv*4);
+	}
+      net.edgeValues.resize(net.edgeAtt.count());
+      for(int a=0; a<net.edgeAtt.count(); a++)
+	{
+	  net.edgeValues[a].resize(ne);
+	  readBytes(p, end, net.edgeValues[a].data(), (qint64)ne*4);
+	}
+    }
+
+  BinaryCache::unmap(fd, data);
+
+  if (!ok)
+    clear(net);
+
+  return ok;
+}
+
+bool
+NetworkReader::writeCache(QString flnm, Network &net)
+{
+  QFile fd;
+  if (!BinaryCache::create(fd, flnm, "ncache", cacheMagic))
+    return false;
+
+  int nv = net.centers.count();
+  int ne = net.edges.count();
+
+  writeNames(fd, net.nodeAtt);
+  writeNames(fd, net.edgeAtt);
+  fd.write((char*)&nv, 4);
+  fd.write((char*)&ne, 4);
+
+  bool ok = true;
+
+  double *c = new double[3*(qint64)nv];
+  for(int i=0; i<nv; i++)
+    {
+      c[3*i+0] = net.centers[i].x;
+      c[3*i+1] = net.centers[i].y;
+      c[3*i+2] = net.centers[i].z;
+    }
+  ok &= (fd.write((char*)c, (qint64)nv*24) == (qint64)nv*24);
+  delete [] c;
+
+  int *e = new int[2*(qint64)ne];
+  for(int i=0; i<ne; i++)
+    {
+      e[2*i+0] = net.edges[i].first;
+      e[2*i+1] = net.edges[i].second;
+    }
+  ok &= (fd.write((char*)e, (qint64)ne*8) == (qint64)ne*8);
+  delete [] e;
+
+  for(int a=0; a<net.nodeValues.count(); a++)
+    ok &= (fd.write((char*)net.nodeValues[a].constData(), (qint64)nv*4) == (qint64)nv*4);
+  for(int a=0; a<net.edgeValues.count(); a++)
+    ok &= (fd.write((char*)net.edgeValues[a].constData(), (qint64)ne*4) == (qint64)ne*4);
+
+  return BinaryCache::finish(fd, ok);
+}
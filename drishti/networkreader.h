@@ -0,0 +1,43 @@
+#ifndef NETWORKREADER_H
+#define NETWORKREADER_H
+
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <QPair>
+
+#include <QGLViewer/vec.h>
+using namespace qglviewer;
+
+//---------------------------------------
+// streaming network ingest.
+// graphml files are read with QXmlStreamReader and text networks
+// from a mapped file, attribute values go straight into one flat
+// array per attribute.  values are as in the file, diameters are
+// not halved and no default radius is added.
+// networks can be kept in a BinaryCache in a flat binary layout.
+//---------------------------------------
+class NetworkReader
+{
+ public :
+  struct Network
+  {
+    QStringList nodeAtt;
+    QStringList edgeAtt;
+    QVector<Vec> centers;
+    QVector< QPair<int, int> > edges;
+    QVector< QVector<float> > nodeValues; // one array per node attribute
+    QVector< QVector<float> > edgeValues; // one array per edge attribute
+  };
+
+  static bool readText(QString, Network&);
+  static bool readGraphML(QString, Network&);
+
+  static bool readCache(QString, Network&);
+  static bool writeCache(QString, Network&);
+
+ private :
+  static void clear(Network&);
+};
+
+#endif
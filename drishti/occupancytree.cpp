@@ -0,0 +1,339 @@
+#include "occupancytree.h"
+
+#include <string.h>
+
+// block edge in subsampled voxels
+static const int blockSize = 16;
+
+OccupancyTree::OccupancyTree()
+{
+  m_min = m_max = 0;
+  m_smin = m_smax = 0;
+  m_seen = 0;
+  clear();
+}
+
+OccupancyTree::~OccupancyTree()
+{
+  clear();
+}
+
+void
+OccupancyTree::clearLevels()
+{
+  for(int l=0; l<m_level.count(); l++)
+    delete [] m_level[l];
+  m_level.clear();
+  m_levelX.clear();
+  m_levelY.clear();
+  m_levelZ.clear();
+  m_evaluated = false;
+}
+
+void
+OccupancyTree::clear()
+{
+  clearLevels();
+
+  if (m_min) delete [] m_min;
+  if (m_max) delete [] m_max;
+  if (m_smin) delete [] m_smin;
+  if (m_smax) delete [] m_smax;
+  if (m_seen) delete [] m_seen;
+  m_min = m_max = 0;
+  m_smin = m_smax = 0;
+  m_seen = 0;
+  m_seenCount = 0;
+
+  m_dataMin = Vec(0,0,0);
+  m_lod = 1;
+  m_bpv = 1;
+  m_nx = m_ny = m_nz = 0;
+  m_kmin = 0;
+  m_bx = m_by = m_bz = 0;
+}
+
+void
+OccupancyTree::reset(Vec dataMin, int lod,
+		     int nx, int ny, int nz,
+		     int bpv)
+{
+  clear();
+
+  if (nx < 1 || ny < 1 || nz < 1)
+    return;
+
+  m_dataMin = dataMin;
+  m_lod = qMax(1, lod);
+  m_bpv = bpv;
+  m_nx = nx;
+  m_ny = ny;
+  m_nz = nz;
+  m_kmin = (int)dataMin.z/m_lod;
+
+  m_bx = (nx+blockSize-1)/blockSize;
+  m_by = (ny+blockSize-1)/blockSize;
+  m_bz = (nz+blockSize-1)/blockSize;
+
+  int nblocks = m_bx*m_by*m_bz;
+  m_min = new ushort[nblocks];
+  m_max = new ushort[nblocks];
+  for(int b=0; b<nblocks; b++)
+    {
+      m_min[b] = 65535;
+      m_max[b] = 0;
+    }
+
+  m_smin = new ushort[m_bx*m_by];
+  m_smax = new ushort[m_bx*m_by];
+
+  m_seen = new uchar[nz];
+  memset(m_seen, 0, nz);
+  m_seenCount = 0;
+}
+
+bool OccupancyTree::valid() { return (m_nz > 0 && m_seenCount == m_nz); }
+bool OccupancyTree::evaluated() { return m_evaluated; }
+
+//---------------------------------------
+// row j contributes to block rows whose apron covers it
+//---------------------------------------
+#define APRONBLOCKS(j, n, b0, b1)			\
+  {							\
+    b0 = (j >= 1 ? (j-1)/blockSize : 0);		\
+    b1 = qMin(n-1, (j+1)/blockSize);			\
+  }
+
+#define SLICEMINMAX(T)						\
+  {								\
+    for(int j=0; j<m_ny; j++)					\
+      {								\
+	T *row = (T*)slice + j*rowLength;			\
+	int by0, by1;						\
+	APRONBLOCKS(j, m_by, by0, by1);				\
+	for(int bx=0; bx<m_bx; bx++)				\
+	  {							\
+	    int i0 = qMax(0, bx*blockSize-1);			\
+	    int i1 = qMin(m_nx-1, bx*blockSize+blockSize);	\
+	    int rmin = row[i0];					\
+	    int rmax = row[i0];					\
+	    for(int i=i0+1; i<=i1; i++)				\
+	      {							\
+		int v = row[i];					\
+		if (v < rmin) rmin = v;				\
+		if (v > rmax) rmax = v;				\
+	      }							\
+	    for(int by=by0; by<=by1; by++)			\
+	      {							\
+		int idx = by*m_bx + bx;				\
+		if (rmin < m_smin[idx]) m_smin[idx] = rmin;	\
+		if (rmax > m_smax[idx]) m_smax[idx] = rmax;	\
+	      }							\
+	  }							\
+      }								\
+  }
+
+void
+OccupancyTree::addSlice(int k, uchar *slice, int rowLength)
+{
+  if (m_nz <= 0 || !slice)
+    return;
+
+  int kk = k - m_kmin;
+  if (kk < -1 || kk > m_nz)
+    return;
+
+  for(int b=0; b<m_bx*m_by; b++)
+    {
+      m_smin[b] = 65535;
+      m_smax[b] = 0;
+    }
+
+  if (m_bpv == 1)
+    SLICEMINMAX(uchar)
+  else
+    SLICEMINMAX(ushort)
+
+  mergeSlice(kk);
+
+  if (kk >= 0 && kk < m_nz && !m_seen[kk])
+    {
+      m_seen[kk] = 1;
+      m_seenCount++;
+    }
+
+  m_evaluated = false;
+}
+
+void
+OccupancyTree::mergeSlice(int kk)
+{
+  int bz0, bz1;
+  APRONBLOCKS(kk, m_bz, bz0, bz1);
+
+  int bxy = m_bx*m_by;
+  for(int bz=bz0; bz<=bz1; bz++)
+    {
+      ushort *bmin = m_min + bz*bxy;
+      ushort *bmax = m_max + bz*bxy;
+      for(int b=0; b<bxy; b++)
+	{
+	  if (m_smin[b] < bmin[b]) bmin[b] = m_smin[b];
+	  if (m_smax[b] > bmax[b]) bmax[b] = m_smax[b];
+	}
+    }
+}
+
+void
+OccupancyTree::evaluate(uchar *lut, int lutSize)
+{
+  clearLevels();
+
+  if (!valid() || !lut)
+    return;
+
+  //---------------------------------------
+  // values that are not fully transparent in any of the
+  // transfer function sets.  for 8 bit data the lookup table
+  // rows are gradient magnitudes, for 16 bit data they hold
+  // the upper byte of the value.
+  int nvals = (m_bpv == 1 ? 256 : 65536);
+  uchar *vis = new uchar[nvals];
+  memset(vis, 0, nvals);
+  for(int l=0; l<lutSize; l++)
+    {
+      uchar *lt = lut + l*256*256*4;
+      for(int i=0; i<256*256; i++)
+	{
+	  if (lt[4*i+3] > 0)
+	    vis[m_bpv == 1 ? i%256 : i] = 1;
+	}
+    }
+
+  // neighbouring values are counted as visible to allow
+  // for interpolation in the lookup table, cnt is the
+  // running count of visible values
+  int *cnt = new int[nvals+1];
+  cnt[0] = 0;
+  for(int v=0; v<nvals; v++)
+    {
+      bool visible = (vis[v] ||
+		      (v > 0 && vis[v-1]) ||
+		      (v < nvals-1 && vis[v+1]));
+      cnt[v+1] = cnt[v] + (visible ? 1 : 0);
+    }
+  delete [] vis;
+  //---------------------------------------
+
+  int nblocks = m_bx*m_by*m_bz;
+  uchar *occ = new uchar[nblocks];
+  for(int b=0; b<nblocks; b++)
+    occ[b] = (m_max[b] >= m_min[b] &&
+	      cnt[m_max[b]+1] - cnt[m_min[b]] > 0);
+  delete [] cnt;
+
+  m_level.append(occ);
+  m_levelX.append(m_bx);
+  m_levelY.append(m_by);
+  m_levelZ.append(m_bz);
+
+  // coarser levels mark nodes with at least one occupied child
+  while (m_levelX.last() > 1 ||
+	 m_levelY.last() > 1 ||
+	 m_levelZ.last() > 1)
+    {
+      int px = m_levelX.last();
+      int py = m_levelY.last();
+      int pz = m_levelZ.last();
+      uchar *prev = m_level.last();
+
+      int nx = (px+1)/2;
+      int ny = (py+1)/2;
+      int nz = (pz+1)/2;
+      uchar *cur = new uchar[nx*ny*nz];
+      memset(cur, 0, nx*ny*nz);
+
+      for(int z=0; z<pz; z++)
+	for(int y=0; y<py; y++)
+	  for(int x=0; x<px; x++)
+	    if (prev[(z*py + y)*px + x])
+	      cur[((z/2)*ny + y/2)*nx + x/2] = 1;
+
+      m_level.append(cur);
+      m_levelX.append(nx);
+      m_levelY.append(ny);
+      m_levelZ.append(nz);
+    }
+
+  m_evaluated = true;
+}
+
+void
+OccupancyTree::occupiedBlocks(int l, int x, int y, int z,
+			      int bz0, int bz1,
+			      int *lo, int *hi)
+{
+  if (!m_level[l][(z*m_levelY[l] + y)*m_levelX[l] + x])
+    return;
+
+  // range of level 0 block slices covered by this node
+  if ((z << l) > bz1 || (((z+1) << l) - 1) < bz0)
+    return;
+
+  // nothing to gain inside the box found so far
+  if (l > 0 &&
+      (x << l) >= lo[0] && (((x+1) << l) - 1) <= hi[0] &&
+      (y << l) >= lo[1] && (((y+1) << l) - 1) <= hi[1] &&
+      qMax(z << l, bz0) >= lo[2] && qMin(((z+1) << l) - 1, bz1) <= hi[2])
+    return;
+
+  if (l == 0)
+    {
+      lo[0] = qMin(lo[0], x);  hi[0] = qMax(hi[0], x);
+      lo[1] = qMin(lo[1], y);  hi[1] = qMax(hi[1], y);
+      lo[2] = qMin(lo[2], z);  hi[2] = qMax(hi[2], z);
+      return;
+    }
+
+  int cx = m_levelX[l-1];
+  int cy = m_levelY[l-1];
+  int cz = m_levelZ[l-1];
+  for(int k=2*z; k<qMin(2*z+2, cz); k++)
+    for(int j=2*y; j<qMin(2*y+2, cy); j++)
+      for(int i=2*x; i<qMin(2*x+2, cx); i++)
+	occupiedBlocks(l-1, i, j, k, bz0, bz1, lo, hi);
+}
+
+bool
+OccupancyTree::occupiedBox(float minz, float maxz,
+			   Vec &bmin, Vec &bmax)
+{
+  if (!m_evaluated)
+    return false;
+
+  int kz0 = (int)(minz/m_lod) - m_kmin;
+  int kz1 = (int)(maxz/m_lod) + 1 - m_kmin;
+  int bz0 = qMax(0, kz0/blockSize);
+  int bz1 = qMin(m_bz-1, qMax(0, kz1)/blockSize);
+  if (kz1 < 0 || bz0 > bz1)
+    return false;
+
+  int lo[3], hi[3];
+  lo[0] = m_bx; lo[1] = m_by; lo[2] = m_bz;
+  hi[0] = hi[1] = hi[2] = -1;
+
+  occupiedBlocks(m_level.count()-1, 0, 0, 0,
+		 bz0, bz1,
+		 lo, hi);
+
+  if (hi[0] < 0)
+    return false;
+
+  // block edges in volume coordinates, widened by one
+  // subsampled voxel on either side
+  float bs = blockSize*m_lod;
+  bmin = m_dataMin + Vec(lo[0]*bs, lo[1]*bs, lo[2]*bs) - Vec(m_lod, m_lod, m_lod);
+  bmax = m_dataMin + Vec((hi[0]+1)*bs, (hi[1]+1)*bs, (hi[2]+1)*bs);
+
+  return true;
+}
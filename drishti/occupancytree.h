@@ -0,0 +1,75 @@
+#ifndef OCCUPANCYTREE_H
+#define OCCUPANCYTREE_H
+
+#include <QList>
+
+#include <QGLViewer/vec.h>
+using namespace qglviewer;
+
+//---------------------------------------
+// min/max hierarchy over the subvolume for empty-space skipping.
+// slices are added as the slice textures are streamed in.
+// blocks hold the value range of their voxels plus a one voxel
+// apron, so that interpolated samples are covered as well.
+// evaluate() marks blocks whose value range hits a non-transparent
+// entry of the lookup table, occupiedBox() returns the bounding
+// box of occupied blocks for a range of slices.
+//---------------------------------------
+class OccupancyTree
+{
+ public :
+  OccupancyTree();
+  ~OccupancyTree();
+
+  void clear();
+
+  // dataMin, lod, subsampled size of the subvolume
+  // and bytes per voxel of the slice textures
+  void reset(Vec, int,
+	     int, int, int,
+	     int);
+
+  // subsampled slice number, slice data, row length in voxels
+  void addSlice(int, uchar*, int);
+
+  // true once every slice of the subvolume has been added
+  bool valid();
+
+  // lookup table with lutSize sets of 256x256 rgba entries
+  void evaluate(uchar*, int);
+  bool evaluated();
+
+  // bounding box in volume coordinates of occupied blocks
+  // between given minz and maxz (volume coordinates).
+  // returns false if nothing is occupied
+  bool occupiedBox(float, float, Vec&, Vec&);
+
+ private :
+  Vec m_dataMin;
+  int m_lod;
+  int m_bpv;
+  int m_nx, m_ny, m_nz;
+  int m_kmin;
+
+  int m_bx, m_by, m_bz;
+  ushort *m_min;
+  ushort *m_max;
+
+  ushort *m_smin;
+  ushort *m_smax;
+
+  uchar *m_seen;
+  int m_seenCount;
+
+  bool m_evaluated;
+  QList<int> m_levelX, m_levelY, m_levelZ;
+  QList<uchar*> m_level;
+
+  void clearLevels();
+  void mergeSlice(int);
+  void occupiedBlocks(int, int, int, int,
+		      int, int,
+		      int*, int*);
+};
+
+#endif
@@ -0,0 +1,293 @@
+#include "pathbvh.h"
+
+#include <algorithm>
+#include <float.h>
+
+// paths per leaf
+static const int leafSize = 8;
+
+class CentroidLess
+{
+ public :
+  CentroidLess(const float *cen, int axis) : m_cen(cen), m_axis(axis) {}
+  bool operator()(int a, int b) const
+  {
+    return m_cen[3*a+m_axis] < m_cen[3*b+m_axis];
+  }
+ private :
+  const float *m_cen;
+  int m_axis;
+};
+
+PathBVH::PathBVH()
+{
+  m_step = 1;
+  m_clip = m_crops = m_filterLen = false;
+  m_minLen = m_maxLen = 0;
+  m_valid = 0;
+  m_check = 0;
+}
+
+void
+PathBVH::clear()
+{
+  m_nodes.clear();
+  m_order.clear();
+  m_box.clear();
+  m_length.clear();
+}
+
+void
+PathBVH::build(QList<Vec> &path,
+	       QList<int> &index,
+	       QList<float> &length)
+{
+  clear();
+
+  int npaths = index.count()-1;
+  if (npaths < 1)
+    return;
+
+  m_box.resize(6*npaths);
+  m_length.resize(npaths);
+  m_order.resize(npaths);
+
+  float *cen = new float[3*npaths];
+  for(int ci=0; ci<npaths; ci++)
+    {
+      double *box = m_box.data() + 6*ci;
+      int sidx = index[ci];
+      int eidx = index[ci+1];
+      if (sidx >= eidx)
+	{
+	  for(int a=0; a<6; a++)
+	    box[a] = 0;
+	}
+      else
+	{
+	  for(int a=0; a<3; a++)
+	    box[a] = box[3+a] = path[sidx][a];
+	  for(int i=sidx+1; i<eidx; i++)
+	    {
+	      const Vec &pt = path[i];
+	      for(int a=0; a<3; a++)
+		{
+		  box[a] = qMin(box[a], pt[a]);
+		  box[3+a] = qMax(box[3+a], pt[a]);
+		}
+	    }
+	}
+
+      for(int a=0; a<3; a++)
+	cen[3*ci+a] = 0.5*(box[a]+box[3+a]);
+
+      m_length[ci] = (ci < length.count() ? length[ci] : 0);
+      m_order[ci] = ci;
+    }
+
+  m_nodes.reserve(2*(npaths/leafSize + 1));
+  buildNode(0, npaths, cen);
+
+  delete [] cen;
+}
+
+int
+PathBVH::buildNode(int first, int count, float *cen)
+{
+  Node node;
+  node.first = first;
+  node.count = count;
+  node.left = node.right = -1;
+  for(int a=0; a<3; a++)
+    {
+      node.bmin[a] = DBL_MAX;
+      node.bmax[a] = -DBL_MAX;
+    }
+  node.lmin = FLT_MAX;
+  node.lmax = -FLT_MAX;
+
+  float cmin[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+  float cmax[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+  for(int i=first; i<first+count; i++)
+    {
+      int ci = m_order[i];
+      const double *box = m_box.constData() + 6*ci;
+      for(int a=0; a<3; a++)
+	{
+	  node.bmin[a] = qMin(node.bmin[a], box[a]);
+	  node.bmax[a] = qMax(node.bmax[a], box[3+a]);
+	  cmin[a] = qMin(cmin[a], cen[3*ci+a]);
+	  cmax[a] = qMax(cmax[a], cen[3*ci+a]);
+	}
+      node.lmin = qMin(node.lmin, m_length[ci]);
+      node.lmax = qMax(node.lmax, m_length[ci]);
+    }
+
+  int n = m_nodes.count();
+  m_nodes.append(node);
+
+  if (count <= leafSize)
+    return n;
+
+  // median split along the longest extent of the centroids
+  int axis = 0;
+  for(int a=1; a<3; a++)
+    if (cmax[a]-cmin[a] > cmax[axis]-cmin[axis])
+      axis = a;
+  if (cmax[axis] <= cmin[axis])
+    return n;
+
+  int mid = first + count/2;
+  int *order = m_order.data();
+  std::nth_element(order+first, order+mid, order+first+count,
+		   CentroidLess(cen, axis));
+
+  int left = buildNode(first, mid-first, cen);
+  int right = buildNode(mid, first+count-mid, cen);
+  m_nodes[n].left = left;
+  m_nodes[n].right = right;
+
+  return n;
+}
+
+int
+PathBVH::classify(const double *bmin, const double *bmax,
+		  float lmin, float lmax,
+		  bool single)
+{
+  bool inside = true;
+
+  if (m_filterLen)
+    {
+      if (lmax < m_minLen || lmin > m_maxLen)
+	return Outside;
+      inside &= (lmin >= m_minLen && lmax <= m_maxLen);
+    }
+
+  if (!m_clip)
+    return (inside ? Inside : Partial);
+
+  // a path is clipped as soon as one of its points is outside
+  // the bounds, which is exact for the box of a single path
+  bool contained = true;
+  for(int a=0; a<3; a++)
+    {
+      if (bmax[a] < m_bmin[a] || bmin[a] > m_bmax[a])
+	return Outside;
+      contained &= (bmin[a] >= m_bmin[a] && bmax[a] <= m_bmax[a]);
+    }
+  if (!contained)
+    {
+      if (single)
+	return Outside;
+      inside = false;
+    }
+
+  // points with (pt-cpos)*cnorm >= 0 are clipped.  the terms are
+  // summed in the same order as for a point so that the extremes
+  // bound the per point values exactly
+  for(int ci=0; ci<m_cpos.count(); ci++)
+    {
+      const Vec &c = m_cpos[ci];
+      const Vec &nrm = m_cnorm[ci];
+      double dmin = 0, dmax = 0;
+      for(int a=0; a<3; a++)
+	{
+	  double d0 = (bmin[a]-c[a])*nrm[a];
+	  double d1 = (bmax[a]-c[a])*nrm[a];
+	  dmin += qMin(d0, d1);
+	  dmax += qMax(d0, d1);
+	}
+      if (dmin >= 0)
+	return Outside;
+      if (dmax >= 0)
+	inside = false;
+    }
+
+  if (m_crops)
+    inside = false;
+
+  return (inside ? Inside : Partial);
+}
+
+void
+PathBVH::accept(int n)
+{
+  const Node &node = m_nodes[n];
+  for(int i=node.first; i<node.first+node.count; i++)
+    {
+      int ci = m_order[i];
+      if (ci%m_step == 0)
+	(*m_valid)[ci] = true;
+    }
+}
+
+void
+PathBVH::cullNode(int n)
+{
+  const Node &node = m_nodes[n];
+  int c = classify(node.bmin, node.bmax, node.lmin, node.lmax, false);
+  if (c == Outside)
+    return;
+
+  if (c == Inside)
+    {
+      accept(n);
+      return;
+    }
+
+  if (node.left >= 0)
+    {
+      int right = node.right;
+      cullNode(node.left);
+      cullNode(right);
+      return;
+    }
+
+  for(int i=node.first; i<node.first+node.count; i++)
+    {
+      int ci = m_order[i];
+      if (ci%m_step != 0)
+	continue;
+
+      const double *box = m_box.constData() + 6*ci;
+      int pc = classify(box, box+3, m_length[ci], m_length[ci], true);
+      if (pc == Inside)
+	(*m_valid)[ci] = true;
+      else if (pc == Partial)
+	m_check->append(ci);
+    }
+}
+
+void
+PathBVH::cull(int step,
+	      bool clip, Vec bmin, Vec bmax,
+	      QList<Vec> &cpos, QList<Vec> &cnorm,
+	      bool crops,
+	      bool filterLen, float minLen, float maxLen,
+	      QVector<bool> &valid,
+	      QList<int> &check)
+{
+  int npaths = m_length.count();
+  if (valid.count() < npaths)
+    valid.resize(npaths);
+
+  m_step = qMax(1, step);
+  m_clip = clip;
+  m_crops = clip && crops;
+  m_filterLen = filterLen;
+  m_bmin = bmin;
+  m_bmax = bmax;
+  m_cpos = cpos;
+  m_cnorm = cnorm;
+  m_minLen = minLen;
+  m_maxLen = maxLen;
+  m_valid = &valid;
+  m_check = &check;
+
+  if (m_nodes.count() > 0)
+    cullNode(0);
+
+  m_valid = 0;
+  m_check = 0;
+}
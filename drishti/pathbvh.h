@@ -0,0 +1,75 @@
+#ifndef PATHBVH_H
+#define PATHBVH_H
+
+#include <QList>
+#include <QVector>
+
+#include <QGLViewer/vec.h>
+using namespace qglviewer;
+
+//---------------------------------------
+// bounding volume hierarchy over the paths of a path group.
+// every node keeps the bounding box of its paths together with
+// the range of their lengths, so that clipping, cropping and
+// length filtering can accept or reject whole subtrees.  only
+// paths that straddle a clip plane (or all surviving paths when
+// there are crops) have to be tested point by point.
+//---------------------------------------
+class PathBVH
+{
+ public :
+  PathBVH();
+
+  void clear();
+
+  // paths are path[index[i]] ... path[index[i+1]-1]
+  void build(QList<Vec>&, QList<int>&, QList<float>&);
+
+  // classify every step'th path.  accepted paths are flagged in
+  // valid, paths that need a per point test are appended to check
+  void cull(int step,
+	    bool clip, Vec bmin, Vec bmax,
+	    QList<Vec>& cpos, QList<Vec>& cnorm,
+	    bool crops,
+	    bool filterLen, float minLen, float maxLen,
+	    QVector<bool>& valid,
+	    QList<int>& check);
+
+ private :
+  struct Node
+  {
+    double bmin[3], bmax[3];
+    float lmin, lmax;
+    int first, count; // range of paths in m_order
+    int left, right;  // children, -1 for leaves
+  };
+
+  enum
+  {
+    Outside = 0,
+    Partial,
+    Inside
+  };
+
+  QVector<Node> m_nodes;
+  QVector<int> m_order;
+  QVector<double> m_box; // 6 per path
+  QVector<float> m_length;
+
+  int buildNode(int, int, float*);
+
+  int classify(const double*, const double*, float, float, bool);
+  void cullNode(int);
+  void accept(int);
+
+  // query state for cullNode
+  int m_step;
+  bool m_clip, m_crops, m_filterLen;
+  Vec m_bmin, m_bmax;
+  QList<Vec> m_cpos, m_cnorm;
+  float m_minLen, m_maxLen;
+  QVector<bool> *m_valid;
+  QList<int> *m_check;
+};
+
+#endif
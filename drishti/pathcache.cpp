@@ -0,0 +1,100 @@
+#include "pathcache.h"
+#include "binarycache.h"
+
+static const char cacheMagic[4] = { 'D', 'P', 'C', '1' };
+
+bool
+PathCache::read(QString flnm, QList<Vec> &pts, QList<int> &index)
+{
+  QFile fd;
+  qint64 size;
+  uchar *data = BinaryCache::map(fd, flnm, "pcache", cacheMagic, size);
+  if (!data)
+    return false;
+
+  qint64 hsize = 2*4;
+  int npaths, npoints;
+  npaths = npoints = -1;
+  if (size >= hsize)
+    {
+      memcpy(&npaths, data, 4);
+      memcpy(&npoints, data+4, 4);
+    }
+
+  if (npaths < 0 || npoints < 0 ||
+      size != hsize + (qint64)(npaths+1)*4 + (qint64)npoints*12)
+    {
+      BinaryCache::unmap(fd, data);
+      return false;
+    }
+
+  const int *offsets = (const int*)(data + hsize);
+  const float *p = (const float*)(data + hsize + (qint64)(npaths+1)*4);
+
+  // offsets have to run from 0 to npoints without going back
+  bool ok = (offsets[0] == 0 && offsets[npaths] == npoints);
+  for(int i=0; i<npaths && ok; i++)
+    ok = (offsets[i+1] >= offsets[i]);
+  if (!ok)
+    {
+      BinaryCache::unmap(fd, data);
+      return false;
+    }
+
+  pts.clear();
+  index.clear();
+  pts.reserve(npoints);
+  index.reserve(npaths+1);
+  for(int i=0; i<=npaths; i++)
+    index << offsets[i];
+  for(int i=0; i<npoints; i++)
+    pts << Vec(p[3*i], p[3*i+1], p[3*i+2]);
+
+  BinaryCache::unmap(fd, data);
+
+  return true;
+}
+
+bool
+PathCache::write(QString flnm, QList<Vec> &pts, QList<int> &index)
+{
+  if (index.count() < 1 || index.last() != pts.count())
+    return false;
+
+  QFile fd;
+  if (!BinaryCache::create(fd, flnm, "pcache", cacheMagic))
+    return false;
+
+  int npaths = index.count()-1;
+  int npoints = pts.count();
+
+  fd.write((char*)&npaths, 4);
+  fd.write((char*)&npoints, 4);
+
+  bool ok = true;
+
+  int *offsets = new int[npaths+1];
+  for(int i=0; i<=npaths; i++)
+    offsets[i] = index[i];
+  ok &= (fd.write((char*)offsets, (qint64)(npaths+1)*4) == (qint64)(npaths+1)*4);
+  delete [] offsets;
+
+  // write points in blocks to keep the staging buffer small
+  int blk = 1024*1024;
+  float *p = new float[3*blk];
+  for(int b=0; b<npoints && ok; b+=blk)
+    {
+      int n = qMin(blk, npoints-b);
+      for(int i=0; i<n; i++)
+	{
+	  const Vec &v = pts[b+i];
+	  p[3*i+0] = v.x;
+	  p[3*i+1] = v.y;
+	  p[3*i+2] = v.z;
+	}
+      ok &= (fd.write((char*)p, (qint64)n*12) == (qint64)n*12);
+    }
+  delete [] p;
+
+  return BinaryCache::finish(fd, ok);
+}
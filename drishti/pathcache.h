@@ -0,0 +1,23 @@
+#ifndef PATHCACHE_H
+#define PATHCACHE_H
+
+#include <QString>
+#include <QList>
+
+#include <QGLViewer/vec.h>
+using namespace qglviewer;
+
+//---------------------------------------
+// binary streamline cache.
+// the points of all paths are stored as a float array together
+// with an offset array (npaths+1 entries, first 0, last npoints)
+// in a BinaryCache.
+//---------------------------------------
+class PathCache
+{
+ public :
+  static bool read(QString, QList<Vec>&, QList<int>&);
+  static bool write(QString, QList<Vec>&, QList<int>&);
+};
+
+#endif
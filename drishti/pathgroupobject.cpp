@@ -4,6 +4,8 @@
 #include "staticfunctions.h"
 #include "volumeinformation.h"
 
+#include <QtConcurrentMap>
+
 //------------------------------------------------------------------
 PathGroupObjectUndo::PathGroupObjectUndo() { clear(); }
 PathGroupObjectUndo::~PathGroupObjectUndo() { clear(); }
@@ -441,6 +443,11 @@ PathGroupObject::PathGroupObject()
 
   m_displayList = 0;
 
+  m_tubeDirty = true;
+  m_tubeSections = 0;
+  m_tubeCapType = -1;
+  m_tubeArrowForAll = false;
+
   m_indexGrabbed = -1;
 
   m_minUserPathLen = m_maxUserPathLen = -1;
@@ -828,6 +835,67 @@ void PathGroupObject::addPoints(QList<Vec> pts)
   if (!m_disableUndo)
     m_undo.append(m_index, m_points, m_pointRadX, m_pointRadY, m_pointAngle);
 }
+void PathGroupObject::setPathPoints(QList<Vec> pts, QList<int> index)
+{
+  // all paths in one go, index runs from 0 to pts.count()
+  m_pointPressed = -1;
+
+  if (index.count() < 2 || index.last() != pts.count())
+    return;
+
+  // paths need at least 2 points
+  int nsingle = 0;
+  int npts = 0;
+  for(int ci=0; ci<index.count()-1; ci++)
+    {
+      if (index[ci+1]-index[ci] < 2)
+	nsingle++;
+      else
+	npts += index[ci+1]-index[ci];
+    }
+
+  if (nsingle > 0)
+    QMessageBox::information(0, QString("%1 points").arg(1),
+			     QString("%1 paths skipped\n").arg(nsingle) +
+			     "Number of points must be greater than 1");
+  if (npts == 0)
+    return;
+
+  // paths are appended one at a time so that computeTangents
+  // sees them exactly as it does when they come through addPoints
+  m_points.clear();
+  m_points.reserve(npts);
+  m_tgP.resize(npts);
+  m_index.clear();
+  m_index << 0;
+  for(int ci=0; ci<index.count()-1; ci++)
+    {
+      if (index[ci+1]-index[ci] < 2)
+	continue;
+      int sidx = m_points.count();
+      for(int i=index[ci]; i<index[ci+1]; i++)
+	m_points.append(pts[i]);
+      computeTangents(sidx, m_points.count());
+      m_index << m_points.count();
+    }
+
+  m_pointRadX.clear();
+  m_pointRadY.clear();
+  m_pointAngle.clear();
+  m_pointRadX.reserve(npts);
+  m_pointRadY.reserve(npts);
+  m_pointAngle.reserve(npts);
+  for(int i=0; i<npts; i++)
+    {
+      m_pointRadX.append(1);
+      m_pointRadY.append(1);
+      m_pointAngle.append(0);
+    }
+
+  m_updateFlag = true;
+  if (!m_disableUndo)
+    m_undo.append(m_index, m_points, m_pointRadX, m_pointRadY, m_pointAngle);
+}
 void PathGroupObject::setRadX(QList<float> rad)
 {
   m_pointRadX = rad;  
@@ -914,6 +982,9 @@ PathGroupObject::computePathLength()
       computePath();
     }
 
+  m_bvh.build(m_path, m_pathIndex, m_pathLength);
+  m_tubeDirty = true;
+
   generateImages();
 
   if (m_displayList > 0)
@@ -1061,6 +1132,7 @@ PathGroupObject::computePath()
 
   m_path.clear();
   m_pathIndex.clear();
+  m_pathLength.clear();
   m_radX.clear();
   m_radY.clear();
   m_angle.clear();
@@ -1404,7 +1476,10 @@ PathGroupObject::drawTube(QGLViewer *viewer,
       glMaterialfv(GL_FRONT_AND_BACK, GL_EMISSION, emiss);
     }
 
-  glCallList(m_displayList);
+  if (m_displayList > 0)
+    glCallList(m_displayList);
+  else
+    drawTubeMesh();
 
   { // reset emissivity
     float emiss[] = { 0.0, 0.0, 0.0, 1.0 };
@@ -1438,35 +1513,72 @@ PathGroupObject::predraw(QGLViewer *viewer,
   // filter points on sparseness
   for(int i=0; i<m_points.count(); i+=m_sparseness)
     m_validPoint[i] = true;
-
-  // filter paths on sparseness
-  for (int ci=0; ci<m_pathIndex.count()-1; ci+=m_sparseness)
-    m_valid[ci] = true;
   //-----------------------------------------------------------
 
+  Vec bmin, bmax;
+  Global::bounds(bmin, bmax);
+
   //-----------------------------------------------------------
-  // filter based on user limits
-  if (m_filterPathLen)
+  // filter paths on sparseness, user limits and clip/crop.
+  // most paths are settled by the bounding volume hierarchy,
+  // only those returned in check are tested point by point
+  QList<int> check;
+  m_bvh.cull(m_sparseness,
+	     m_clip, bmin, bmax,
+	     cpos, cnorm,
+	     crops.count() > 0,
+	     m_filterPathLen, m_minUserPathLen, m_maxUserPathLen,
+	     m_valid, check);
+
+  for(int k=0; k<check.count(); k++)
     {
-      for (int ci=0; ci<m_pathIndex.count()-1; ci+=m_sparseness)
-	if (m_valid[ci])
-	  {
-	    float pl = m_pathLength[ci];
-	    if (pl < m_minUserPathLen || pl > m_maxUserPathLen)
-	      m_valid[ci] = false;
-	  }
+      int ci = check[k];
+      bool ok = true;
+      int sidx = m_pathIndex[ci];
+      int eidx = m_pathIndex[ci+1];
+      for(int i=sidx; i<eidx; i++)
+	{
+	  Vec pt = m_path[i];
+	  if (pt.x >= bmin.x &&
+	      pt.y >= bmin.y &&
+	      pt.z >= bmin.z &&
+	      pt.x <= bmax.x &&
+	      pt.y <= bmax.y &&
+	      pt.z <= bmax.z)
+	    {
+	      for (int pi=0; pi<cpos.count(); pi++)
+		{
+		  if ((pt-cpos[pi])*cnorm[pi] >= 0)
+		    {
+		      ok = false;
+		      break;
+		    }
+		}
+	      if (ok)
+		{
+		  for(int pi=0; pi<crops.count(); pi++)
+		    {
+		      ok &= crops[pi].checkCropped(pt);
+		      if (!ok) break;
+		    }
+		}
+	    }
+	  else
+	    ok = false;
+
+	  if (!ok) break;
+	}
+
+      m_valid[ci] = ok;
     }
   //-----------------------------------------------------------
 
   //-----------------------------------------------------------
-  if (m_clip)
+  // filter points on clip/crop, they are drawn only with showPoints
+  if (m_clip && m_showPoints)
     {
-      Vec bmin, bmax;
-      Global::bounds(bmin, bmax);
-
       Vec voxelScaling = Global::voxelScaling();
 
-      // filter points on clip/crop
       for(int i=0; i<m_points.count();i+=m_sparseness)
 	{
 	  if (m_validPoint[i])
@@ -1503,51 +1615,6 @@ PathGroupObject::predraw(QGLViewer *viewer,
 	      m_validPoint[i] = ok;
 	    }
 	}
-
-      // filter paths on clip/crop
-      for (int ci=0; ci<m_pathIndex.count()-1; ci+=m_sparseness)
-	{
-	  if (m_valid[ci])
-	    {
-	      bool ok = true;
-	      int sidx = m_pathIndex[ci];
-	      int eidx = m_pathIndex[ci+1];
-	      for(int i=sidx; i<eidx; i++)
-		{
-		  Vec pt = m_path[i];
-		  if (pt.x >= bmin.x &&
-		      pt.y >= bmin.y &&
-		      pt.z >= bmin.z &&
-		      pt.x <= bmax.x &&
-		      pt.y <= bmax.y &&
-		      pt.z <= bmax.z)
-		    {
-		      for (int ci=0; ci<cpos.count(); ci++)
-			{
-			  if ((pt-cpos[ci])*cnorm[ci] >= 0)
-			    {
-			      ok = false;
-			      break;
-			    }
-			}
-		      if (ok)
-			{
-			  for(int ci=0; ci<crops.count(); ci++)
-			    {
-			      ok &= crops[ci].checkCropped(pt);
-			      if (!ok) break;
-			    }
-			}
-		    }
-		  else
-		    ok = false;
-		  
-		  if (!ok) break;
-		}
-	      
-	      m_valid[ci] = ok;
-	    }
-	}
     }
   //-----------------------------------------------------------
 
@@ -1639,8 +1706,19 @@ PathGroupObject::predraw(QGLViewer *viewer,
 
 
   //-----------------------------------------------------------
-  if (m_displayList == 0)
-    glDeleteLists(m_displayList, 1); 
+  if (m_displayList > 0)
+    {
+      glDeleteLists(m_displayList, 1);
+      m_displayList = 0;
+    }
+
+  if (m_tube && staticTube())
+    {
+      // cached geometry, only colours and path ranges change
+      updateTubeMesh();
+      updateTubeDraw(viewer);
+      return;
+    }
 
   generateSphereSprite();
 
@@ -2071,270 +2149,508 @@ PathGroupObject::drawLines(QGLViewer *viewer,
   //  glDisable(GL_LINE_SMOOTH);
 }
 
+bool
+PathGroupObject::staticTube()
+{
+  // segments are stretched in screen space unless the scale is
+  // absolute and 1, only then the tube is independent of the view
+  return (m_scaleType && m_maxScale == 1);
+}
+
+float
+PathGroupObject::lengthFraction(int ci) const
+{
+  int nci = m_pathIndex.count()-1;
+  float deno = 1;
+  if (m_minUserPathLen < m_maxUserPathLen)
+    deno = m_maxUserPathLen-m_minUserPathLen;
+
+  float frc;
+  if (m_arrowDirection)
+    frc = (m_pathLength[ci]-m_minUserPathLen)/deno;
+  else
+    frc = (m_pathLength[nci-1-ci]-m_minUserPathLen)/deno;
+  return qBound(0.0f, frc, 1.0f);
+}
+
+Vec
+PathGroupObject::tubeColor(QGLViewer *viewer, int ci, float frc)
+{
+  int stopsCount = m_resampledStops.count()-1;
+  QColor col = m_resampledStops[frc*stopsCount].second;
+  float r = m_opacity*col.red()/255.0;
+  float g = m_opacity*col.green()/255.0;
+  float b = m_opacity*col.blue()/255.0;
+  if (m_depthcue)
+    {
+      float depthdeno = m_minDepth-m_maxDepth;
+      if (qAbs(depthdeno) < 0.000001)
+	depthdeno = 1;
+
+      Vec pt = m_path[m_pathIndex[ci]];
+      float scd = viewer->camera()->projectedCoordinatesOf(pt).z;
+      float darken = qMin(1.0f, 0.2f + (scd-m_maxDepth)/depthdeno);
+      r *= darken;
+      g *= darken;
+      b *= darken;
+    }
+  return Vec(r, g, b);
+}
+
+void
+PathGroupObject::addTubeVertex(TubeMesh &mesh, Vec v, Vec n)
+{
+  mesh.vertices << v.x << v.y << v.z << n.x << n.y << n.z;
+}
+
+// triangles for count vertices from base in triangle strip order
+void
+PathGroupObject::addTubeStrip(TubeMesh &mesh, int base, int count)
+{
+  for(int k=0; k<count-2; k++)
+    {
+      if (k%2 == 0)
+	mesh.indices << base+k << base+k+1 << base+k+2;
+      else
+	mesh.indices << base+k+1 << base+k << base+k+2;
+    }
+}
+
+// quads between two rings of sections+1 vertices, same
+// triangles as a strip alternating between the rings
+void
+PathGroupObject::addTubeRings(TubeMesh &mesh, int ring1, int ring2,
+			      int sections)
+{
+  for(int j=0; j<sections; j++)
+    {
+      uint a = ring1+j;
+      uint b = ring2+j;
+      mesh.indices << a << b << a+1
+		   << a+1 << b << b+1;
+    }
+}
+
+void
+PathGroupObject::tubeJob(TubeJob &job)
+{
+  PathGroupObject *po = job.po;
+  TubeMesh &mesh = job.mesh;
+  for(int ci=job.first; ci<job.last; ci++)
+    {
+      mesh.vertexStart << mesh.vertices.count()/6;
+      mesh.indexStart << mesh.indices.count();
+      po->buildTube(ci, 0, 1.0, po->lengthFraction(ci), mesh);
+    }
+}
+
+void
+PathGroupObject::updateTubeMesh()
+{
+  if (!m_tubeDirty &&
+      m_tubeSections == m_sections &&
+      m_tubeCapType == m_capType &&
+      m_tubeArrowForAll == m_arrowForAll)
+    return;
+
+  m_tubeDirty = false;
+  m_tubeSections = m_sections;
+  m_tubeCapType = m_capType;
+  m_tubeArrowForAll = m_arrowForAll;
+
+  m_tubeMesh.vertices.clear();
+  m_tubeMesh.indices.clear();
+  m_tubeMesh.vertexStart.clear();
+  m_tubeMesh.indexStart.clear();
+
+  int nci = m_pathIndex.count()-1;
+  if (nci < 1)
+    return;
+
+  //---------------
+  // build blocks of paths in parallel
+  int blk = 256;
+  int njobs = (nci+blk-1)/blk;
+  QVector<TubeJob> jobs(njobs);
+  for(int j=0; j<njobs; j++)
+    {
+      jobs[j].po = this;
+      jobs[j].first = j*blk;
+      jobs[j].last = qMin(nci, (j+1)*blk);
+    }
+  QtConcurrent::blockingMap(jobs, PathGroupObject::tubeJob);
+  //---------------
+
+  //---------------
+  // and join them
+  int nv = 0, ni = 0;
+  for(int j=0; j<njobs; j++)
+    {
+      nv += jobs[j].mesh.vertices.count();
+      ni += jobs[j].mesh.indices.count();
+    }
+  m_tubeMesh.vertices.resize(nv);
+  m_tubeMesh.indices.resize(ni);
+  m_tubeMesh.vertexStart.resize(nci+1);
+  m_tubeMesh.indexStart.resize(nci+1);
+
+  nv = ni = 0;
+  for(int j=0; j<njobs; j++)
+    {
+      TubeMesh &mesh = jobs[j].mesh;
+      int voff = nv/6;
+      memcpy(m_tubeMesh.vertices.data()+nv,
+	     mesh.vertices.constData(),
+	     mesh.vertices.count()*sizeof(float));
+
+      uint *idx = m_tubeMesh.indices.data()+ni;
+      for(int i=0; i<mesh.indices.count(); i++)
+	idx[i] = mesh.indices[i] + voff;
+
+      for(int ci=jobs[j].first; ci<jobs[j].last; ci++)
+	{
+	  m_tubeMesh.vertexStart[ci] = mesh.vertexStart[ci-jobs[j].first] + voff;
+	  m_tubeMesh.indexStart[ci] = mesh.indexStart[ci-jobs[j].first] + ni;
+	}
+
+      nv += mesh.vertices.count();
+      ni += mesh.indices.count();
+      mesh.vertices.clear();
+      mesh.indices.clear();
+    }
+  m_tubeMesh.vertexStart[nci] = nv/6;
+  m_tubeMesh.indexStart[nci] = ni;
+  //---------------
+}
+
+void
+PathGroupObject::updateTubeDraw(QGLViewer *viewer)
+{
+  int nci = m_pathIndex.count()-1;
+  if (nci < 1 || m_tubeMesh.vertexStart.count() != nci+1)
+    {
+      m_tubeIndices.clear();
+      return;
+    }
+
+  int nidx = 0;
+  for (int ci=0; ci<nci; ci++)
+    if (m_valid[ci])
+      nidx += m_tubeMesh.indexStart[ci+1]-m_tubeMesh.indexStart[ci];
+
+  m_tubeIndices.resize(nidx);
+  m_tubeColors.resize(4*m_tubeMesh.vertexStart[nci]);
+
+  uchar alpha = qBound(0, (int)(255*m_opacity), 255);
+  uint *idx = m_tubeIndices.data();
+  for (int ci=0; ci<nci; ci++)
+    {
+      if (!m_valid[ci])
+	continue;
+
+      int is = m_tubeMesh.indexStart[ci];
+      int ni = m_tubeMesh.indexStart[ci+1]-is;
+      memcpy(idx, m_tubeMesh.indices.constData()+is, ni*sizeof(uint));
+      idx += ni;
+
+      Vec col = 255*tubeColor(viewer, ci, lengthFraction(ci));
+      uchar r = qBound(0, (int)col.x, 255);
+      uchar g = qBound(0, (int)col.y, 255);
+      uchar b = qBound(0, (int)col.z, 255);
+      uchar *c = m_tubeColors.data();
+      for(int v=m_tubeMesh.vertexStart[ci]; v<m_tubeMesh.vertexStart[ci+1]; v++)
+	{
+	  c[4*v+0] = r;
+	  c[4*v+1] = g;
+	  c[4*v+2] = b;
+	  c[4*v+3] = alpha;
+	}
+    }
+}
+
+void
+PathGroupObject::drawTubeMesh()
+{
+  if (m_tubeIndices.count() == 0)
+    return;
+
+  const float *v = m_tubeMesh.vertices.constData();
+
+  glEnableClientState(GL_VERTEX_ARRAY);
+  glEnableClientState(GL_NORMAL_ARRAY);
+  glEnableClientState(GL_COLOR_ARRAY);
+  glVertexPointer(3, GL_FLOAT, 6*sizeof(float), v);
+  glNormalPointer(GL_FLOAT, 6*sizeof(float), v+3);
+  glColorPointer(4, GL_UNSIGNED_BYTE, 0, m_tubeColors.constData());
+
+  glDrawElements(GL_TRIANGLES, m_tubeIndices.count(),
+		 GL_UNSIGNED_INT, m_tubeIndices.constData());
+
+  glDisableClientState(GL_COLOR_ARRAY);
+  glDisableClientState(GL_NORMAL_ARRAY);
+  glDisableClientState(GL_VERTEX_ARRAY);
+}
+
 void
 PathGroupObject::generateTube(QGLViewer *viewer,
 			      float scale)
+{
+  // view dependent tubes are rebuilt every time
+  int nci = m_pathIndex.count()-1;
+  for (int ci=0; ci<nci; ci++)
+    {
+      if (m_valid[ci])
+	{
+	  float frc = lengthFraction(ci);
+	  Vec col = tubeColor(viewer, ci, frc);
+	  glColor4f(col.x, col.y, col.z, m_opacity);
+
+	  TubeMesh mesh;
+	  buildTube(ci, viewer->camera(), scale, frc, mesh);
+	  if (mesh.indices.count() == 0)
+	    continue;
+
+	  const float *v = mesh.vertices.constData();
+	  glEnableClientState(GL_VERTEX_ARRAY);
+	  glEnableClientState(GL_NORMAL_ARRAY);
+	  glVertexPointer(3, GL_FLOAT, 6*sizeof(float), v);
+	  glNormalPointer(GL_FLOAT, 6*sizeof(float), v+3);
+	  glDrawElements(GL_TRIANGLES, mesh.indices.count(),
+			 GL_UNSIGNED_INT, mesh.indices.constData());
+	  glDisableClientState(GL_NORMAL_ARRAY);
+	  glDisableClientState(GL_VERTEX_ARRAY);
+	}
+    }
+}
+
+void
+PathGroupObject::buildTube(int ci,
+			   Camera *camera,
+			   float scale, float frc,
+			   TubeMesh &mesh) const
 {
   QList<Vec> csec1, norm1;
   Vec ptang, pxaxis, pyaxis;
 
+  // every path starts from the same frame
   pxaxis = Vec(1,0,0);
   pyaxis = Vec(0,1,0);
   ptang = Vec(0,0,1);
 
+  int sidx = m_pathIndex[ci];
+  int eidx = m_pathIndex[ci+1];
 
-  int stopsCount = m_resampledStops.count()-1;
-  int nci = m_pathIndex.count()-1;
-  float deno = 1;
-//  if (m_minPathLen < m_maxPathLen)
-//    deno = m_maxPathLen-m_minPathLen;
-  if (m_minUserPathLen < m_maxUserPathLen)
-    deno = m_maxUserPathLen-m_minUserPathLen;
-
-  float depthdeno = m_minDepth-m_maxDepth;
-  if (qAbs(depthdeno) < 0.000001)
-    depthdeno = 1;
+  int nextArrowIdx=sidx;
+  Vec nextArrowHead;
+  float nextArrowHeight = 1;
 
-  for (int ci=0; ci<nci; ci++)
+  int ring1 = -1;
+  for(int i=sidx; i<eidx; i++)
     {
-      if (m_valid[ci])
-	{
-	  int sidx = m_pathIndex[ci];
-	  int eidx = m_pathIndex[ci+1];
+      QList<Vec> csec2, norm2;
+      Vec tang, xaxis, yaxis;
 
-	  float frc;
-	  if (m_arrowDirection)
-	    frc = (m_pathLength[ci]-m_minUserPathLen)/deno;
+      if (m_closed)
+	{
+	  if (i==sidx || i == eidx-1)
+	    // both points are actually the same
+	    tang = m_path[sidx+1]-m_path[eidx-2];
 	  else
-	    frc = (m_pathLength[nci-1-ci]-m_minUserPathLen)/deno;
-	  frc = qBound(0.0f, frc, 1.0f);
-	  QColor col = m_resampledStops[frc*stopsCount].second;
-	  float r = m_opacity*col.red()/255.0;
-	  float g = m_opacity*col.green()/255.0;
-	  float b = m_opacity*col.blue()/255.0;
-	  if (m_depthcue)
+	    tang = m_path[i+1]-m_path[i-1];
+	}
+      else
+	{
+	  if (i== sidx)
+	    tang = m_path[i+1]-m_path[i];
+	  else if (i== eidx-1)
+	    tang = m_path[i]-m_path[i-1];
+	  else
+	    tang = m_path[i+1]-m_path[i-1];
+	}
+
+      if (tang.norm() > 0)
+	tang.normalize();
+      else
+	tang = Vec(1,0,0); // should really scold the user
+
+      if (m_closed && i==eidx-1)
+	{ // restore settings of zeroeth point
+	  pxaxis = Vec(1,0,0);
+	  pyaxis = Vec(0,1,0);
+	  ptang = Vec(0,0,1);
+	}
+
+
+      //---------------------------------------------
+      csec2 = getCrossSection(scale,
+			      m_angle[i], m_radX[i], m_radY[i],
+			      m_sections,
+			      ptang, pxaxis, pyaxis,
+			      tang, xaxis, yaxis);
+      norm2 = getNormals(csec2, tang);
+      //---------------------------------------------
+
+
+      //---------------------------------------------
+      if (m_capType == FLAT)
+	{
+	  if (!m_closed && (i == sidx || i==eidx-1))
+	    addFlatCaps(mesh, i, tang, csec2);
+	}
+      //---------------------------------------------
+
+      //---------------------------------------------
+      if (m_capType == ROUND)
+	{
+	  if (!m_closed && (i == sidx || i==eidx-1))
+	    addRoundCaps(mesh, i, tang, csec2, norm2);
+	}
+      //---------------------------------------------
+
+
+      //---------------------------------------------
+      // ring around this point, shared by the segments on
+      // either side when the segments are not stretched
+      int ring2 = mesh.vertices.count()/6;
+      for(int j=0; j<m_sections+1; j++)
+	addTubeVertex(mesh, m_path[i] + csec2[j], norm2[j]);
+      //---------------------------------------------
+
+
+      //---------------------------------------------
+      // generate the tubular mesh
+      if (i > sidx)
+	{
+	  Vec v0 = m_path[i];
+	  if (camera)
 	    {
-	      float scd = viewer->camera()->projectedCoordinatesOf(m_path[sidx]).z;
-	      float darken = qMin(1.0f, 0.2f + (scd-m_maxDepth)/depthdeno);
-	      r *= darken;
-	      g *= darken;
-	      b *= darken;
+	      //---------------------------------------
+	      // extend based on scale
+	      Vec sc0, sc1;
+	      sc0 = camera->projectedCoordinatesOf(v0);
+	      sc1 = camera->projectedCoordinatesOf(m_path[i-1]);
+	      Vec dv = (sc0-sc1);
+	      float rl = dv.norm();
+	      dv.normalize();
+	      //--------
+	      if (m_scaleType) // absolute scale
+		rl = m_maxScale*rl;
+	      else // relative scale
+		rl = (1-frc)*m_minScale + frc*m_maxScale;
+	      //--------
+	      v0 = camera->unprojectedCoordinatesOf(sc1+rl*dv);
+	      //---------------------------------------
 	    }
-	  glColor4f(r,g,b, m_opacity);
-
-	  int nextArrowIdx=sidx;
-	  Vec nextArrowHead;
-	  float nextArrowHeight;
 
-	  for(int i=sidx; i<eidx; i++)
+	  float frc1 = 2;
+	  float frc2 = 2;
+	  if (m_capType == ARROW)
 	    {
-	      QList<Vec> csec2, norm2;
-	      Vec tang, xaxis, yaxis;
-	      
-	      if (m_closed)
+	      if (m_arrowForAll || i == eidx-1) nextArrowHead = v0;
+	      frc1 = (m_path[i-1]-nextArrowHead).norm()/nextArrowHeight;
+	      frc2 = (v0-nextArrowHead).norm()/nextArrowHeight;
+	    }
+	  if (frc1 >= 1 && frc2 < 1)
+	    addArrowHead(mesh, i, scale,
+			 nextArrowHead,
+			 ptang, pxaxis, pyaxis,
+			 frc1, frc2, v0,
+			 csec1, norm1);
+	  else if (frc2 >= 1)
+	    {
+	      int ring = ring2;
+	      if (camera)
 		{
-		  if (i==sidx || i == eidx-1)
-		    // both points are actually the same
-		    tang = m_path[sidx+1]-m_path[eidx-2];
-		  else
-		    tang = m_path[i+1]-m_path[i-1];
+		  ring = mesh.vertices.count()/6;
+		  for(int j=0; j<m_sections+1; j++)
+		    addTubeVertex(mesh, v0 + csec2[j], norm2[j]);
 		}
-	      else
+	      addTubeRings(mesh, ring1, ring, m_sections);
+	    }
+	}
+      //---------------------------------------------
+
+      ptang = tang;
+      pxaxis = xaxis;
+      pyaxis = yaxis;
+      csec1 = csec2;
+      norm1 = norm2;
+      ring1 = ring2;
+
+      if (m_capType == ARROW)
+	{
+	  // calculate nextArrowHead
+	  if (!m_arrowForAll && i == sidx)
+	    {
+	      if (!m_closed)
 		{
-		  if (i== sidx)
-		    tang = m_path[i+1]-m_path[i];
-		  else if (i== eidx-1)
-		    tang = m_path[i]-m_path[i-1];
-		  else
-		    tang = m_path[i+1]-m_path[i-1];
+		  nextArrowIdx = eidx-1;
+		  nextArrowHead = m_path[eidx-1];
+		  nextArrowHeight = 2*qMax(m_radX[eidx-1],
+					   m_radY[eidx-1]);
 		}
-	      
-	      if (tang.norm() > 0)
-		tang.normalize();
 	      else
-		tang = Vec(1,0,0); // should really scold the user
-	      
-	      if (m_closed && i==eidx-1)
-		{ // restore settings of zeroeth point
-		  pxaxis = Vec(1,0,0);
-		  pyaxis = Vec(0,1,0);
-		  ptang = Vec(0,0,1);
-		}
-	      
-	      
-	      //---------------------------------------------
-	      csec2 = getCrossSection(scale,
-				      m_angle[i], m_radX[i], m_radY[i],
-				      m_sections,
-				      ptang, pxaxis, pyaxis,
-				      tang, xaxis, yaxis);
-	      norm2 = getNormals(csec2, tang);
-	      //---------------------------------------------
-	      
-	      
-	      //---------------------------------------------
-	      if (m_capType == FLAT)
-		{
-		  if (!m_closed && (i == sidx || i==eidx-1))
-		    addFlatCaps(i, tang, csec2);
-		}
-	      //---------------------------------------------
-	      
-	      //---------------------------------------------
-	      if (m_capType == ROUND)
-		{
-		  if (!m_closed && (i == sidx || i==eidx-1))
-		    addRoundCaps(i, tang, csec2, norm2);
-		}
-	      //---------------------------------------------
-	      
-	      
-	      
-	      //---------------------------------------------
-	      // generate the tubular mesh
-	      if (i > sidx)
 		{
-		  //---------------------------------------
-		  // extend based on scale
-		  Vec v0 = m_path[i];
-		  Vec sc0, sc1;
-		  sc0 = viewer->camera()->projectedCoordinatesOf(v0);
-		  sc1 = viewer->camera()->projectedCoordinatesOf(m_path[i-1]);
-		  Vec dv = (sc0-sc1);
-		  float rl = dv.norm();
-		  dv.normalize();
-		  //--------
-		  if (m_scaleType) // absolute scale
-		    rl = m_maxScale*rl;
-		  else // relative scale
-		    rl = (1-frc)*m_minScale + frc*m_maxScale;
-		  //-------- 
-		  v0 = viewer->camera()->unprojectedCoordinatesOf(sc1+rl*dv);
-		  //---------------------------------------
-
-		  float frc1 = 2;
-		  float frc2 = 2;
-		  if (m_capType == ARROW)
-		    {
-		      if (m_arrowForAll || i == eidx-1) nextArrowHead = v0;
-		      frc1 = (m_path[i-1]-nextArrowHead).norm()/nextArrowHeight;
-		      frc2 = (v0-nextArrowHead).norm()/nextArrowHeight;
-		    }
-		  if (frc1 >= 1 && frc2 < 1)
-		    addArrowHead(i, scale,
-				 nextArrowHead,
-				 ptang, pxaxis, pyaxis,
-				 frc1, frc2, v0,
-				 csec1, norm1);
-		  else if (frc2 >= 1)
-		    {
-		      glBegin(GL_TRIANGLE_STRIP);
-		      for(int j=0; j<m_sections+1; j++)
-			{
-			  Vec vox1 = m_path[i-1] + csec1[j];
-			  glNormal3dv(norm1[j]);
-			  glVertex3dv(vox1);
-			  
-			  Vec vox2 = v0 + csec2[j];
-			  glNormal3dv(norm2[j]);
-			  glVertex3dv(vox2);
-			}	      
-		      glEnd();
-		    }
+		  nextArrowIdx = eidx-2;
+		  nextArrowHead = m_path[eidx-2];
+		  nextArrowHeight = 2*qMax(m_radX[eidx-2],
+					   m_radY[eidx-2]);
 		}
-	      //---------------------------------------------
-	      
-	      ptang = tang;
-	      pxaxis = xaxis;
-	      pyaxis = yaxis;
-	      csec1 = csec2;
-	      norm1 = norm2;      
-	      
-	      if (m_capType == ARROW)
+	    }
+	  else if (m_arrowForAll)
+	    {
+	      if ((i-sidx)%m_segments == 0)
 		{
-		  // calculate nextArrowHead
-		  if (!m_arrowForAll && i == sidx)
-		    {
-		      if (!m_closed)
-			{
-			  nextArrowIdx = eidx-1;
-			  nextArrowHead = m_path[eidx-1];
-			  nextArrowHeight = 2*qMax(m_radX[eidx-1],
-						   m_radY[eidx-1]);
-			}
-		      else
-			{
-			  nextArrowIdx = eidx-2;
-			  nextArrowHead = m_path[eidx-2];
-			  nextArrowHeight = 2*qMax(m_radX[eidx-2],
-						   m_radY[eidx-2]);
-			}
-		    }
-		  else if (m_arrowForAll)
-		    {
-		      if ((i-sidx)%m_segments == 0)
-			{
-			  nextArrowIdx += m_segments;
-			  if (nextArrowIdx > eidx-1)
-			    nextArrowIdx = eidx-1;
-			  nextArrowHead = m_path[nextArrowIdx];
-			  nextArrowHeight = 2*qMax(m_radX[nextArrowIdx],
-						   m_radY[nextArrowIdx]);
-			}
-		    }
+		  nextArrowIdx += m_segments;
+		  if (nextArrowIdx > eidx-1)
+		    nextArrowIdx = eidx-1;
+		  nextArrowHead = m_path[nextArrowIdx];
+		  nextArrowHeight = 2*qMax(m_radX[nextArrowIdx],
+					   m_radY[nextArrowIdx]);
 		}
-	      
 	    }
-	  
-	  csec1.clear();
-	  norm1.clear();
 	}
     }
 }
 
 void
-PathGroupObject::addFlatCaps(int i,
+PathGroupObject::addFlatCaps(TubeMesh &mesh,
+			     int i,
 			     Vec tang,
-			     QList<Vec> csec)
+			     QList<Vec> csec) const
 {
   Vec norm = -tang;
   int halfway = m_sections/2;
-  glBegin(GL_TRIANGLE_STRIP);
+  int base = mesh.vertices.count()/6;
   for(int j=0; j<=halfway; j++)
     {
-      Vec vox2 = m_path[i] + csec[j];
-      glNormal3dv(norm);
-      glVertex3dv(vox2);
+      addTubeVertex(mesh, m_path[i] + csec[j], norm);
 
       if (j < halfway)
-	{
-	  vox2 = m_path[i] + csec[m_sections-j];
-	  glNormal3dv(norm);
-	  glVertex3dv(vox2);
-	}
+	addTubeVertex(mesh, m_path[i] + csec[m_sections-j], norm);
     }
-  glEnd();
+  addTubeStrip(mesh, base, mesh.vertices.count()/6 - base);
 }
 
 void
-PathGroupObject::addRoundCaps(int i,
+PathGroupObject::addRoundCaps(TubeMesh &mesh,
+			      int i,
 			      Vec tang,
 			      QList<Vec> csec2,
-			      QList<Vec> norm2)
+			      QList<Vec> norm2) const
 {
   int npaths = m_path.count();
   int ksteps = 4;
   Vec ctang = -tang;
   if (i==0) ctang = tang;
-  QList<Vec> csec = csec2;
   float rad = qMin(m_radX[i], m_radY[i]);
-  glBegin(GL_TRIANGLE_STRIP);	  
   for(int k=0; k<ksteps-1; k++)
     {
       float ct1 = cos(1.57*(float)k/(float)ksteps);
       float ct2 = cos(1.57*(float)(k+1)/(float)ksteps);
       float st1 = sin(1.57*(float)k/(float)ksteps);
       float st2 = sin(1.57*(float)(k+1)/(float)ksteps);
+      int base = mesh.vertices.count()/6;
       for(int j=0; j<m_sections+1; j++)
 	{
 	  Vec norm = csec2[j]*ct1 - ctang*rad*st1;
@@ -2342,42 +2658,39 @@ PathGroupObject::addRoundCaps(int i,
 	  if (k==0)
 	    {
 	      if (i==0)
-		glNormal3dv(-norm2[j]);
+		addTubeVertex(mesh, vox2, -norm2[j]);
 	      else
-		glNormal3dv(norm2[j]);
+		addTubeVertex(mesh, vox2, norm2[j]);
 	    }
 	  else
-	    {  
+	    {
 	      norm.normalize();
 	      if (i==npaths-1) norm=-norm;
-	      glNormal3dv(norm);
+	      addTubeVertex(mesh, vox2, norm);
 	    }
-	  glVertex3dv(vox2);
-	  
+
 	  norm = csec2[j]*ct2 - ctang*rad*st2;
 	  vox2 = m_path[i] + norm;
 	  norm.normalize();
 	  if (i==npaths-1) norm=-norm;
-	  glNormal3dv(norm);
-	  glVertex3dv(vox2);
+	  addTubeVertex(mesh, vox2, norm);
 	}
+      addTubeStrip(mesh, base, mesh.vertices.count()/6 - base);
     }
-  glEnd();
-  
+
   // add flat ends
   float ct2 = cos(1.57*(float)(ksteps-1)/(float)ksteps);
   float st2 = sin(1.57*(float)(ksteps-1)/(float)ksteps);
   int halfway = m_sections/2;
-  glBegin(GL_TRIANGLE_STRIP);
+  int base = mesh.vertices.count()/6;
   for(int j=0; j<=halfway; j++)
     {
       Vec norm = csec2[j]*ct2 - ctang*rad*st2;
       Vec vox2 = m_path[i] + norm;
       norm.normalize();
       if (i==npaths-1) norm=-norm;
-      glNormal3dv(norm);
-      glVertex3dv(vox2);
-      
+      addTubeVertex(mesh, vox2, norm);
+
       if (j < halfway)
 	{
 	  norm = csec2[m_sections-j]*ct2 -
@@ -2385,20 +2698,20 @@ PathGroupObject::addRoundCaps(int i,
 	  vox2 = m_path[i] + norm;
 	  norm.normalize();
 	  if (i==npaths-1) norm=-norm;
-	  glNormal3dv(norm);
-	  glVertex3dv(vox2);
+	  addTubeVertex(mesh, vox2, norm);
 	}
     }
-  glEnd();
+  addTubeStrip(mesh, base, mesh.vertices.count()/6 - base);
 }
 
 void
-PathGroupObject::addArrowHead(int i, float scale,
+PathGroupObject::addArrowHead(TubeMesh &mesh,
+			      int i, float scale,
 			      Vec nextArrowHead,
 			      Vec ptang, Vec pxaxis, Vec pyaxis,
 			      float frc1, float frc2, Vec v0,
 			      QList<Vec> csec1,
-			      QList<Vec> norm1)
+			      QList<Vec> norm1) const
 {
   //---------------------------------------------
   Vec tangm, xaxism, yaxism;
@@ -2420,44 +2733,29 @@ PathGroupObject::addArrowHead(int i, float scale,
   float t = (1.0-frc2)/(frc1-frc2);
   Vec mid = v0 + t*(m_path[i-1]-v0);
 
-  glBegin(GL_TRIANGLE_STRIP);
+  int base = mesh.vertices.count()/6;
   for(int j=0; j<m_sections+1; j++)
     {
-      Vec vox1 = m_path[i-1] + csec1[j];
-      glNormal3dv(norm1[j]);
-      glVertex3dv(vox1);
-      
-      Vec vox2 = mid + csecm[j];
-      glNormal3dv(normm[j]);
-      glVertex3dv(vox2);
+      addTubeVertex(mesh, m_path[i-1] + csec1[j], norm1[j]);
+      addTubeVertex(mesh, mid + csecm[j], normm[j]);
     }
-  glEnd();
+  addTubeStrip(mesh, base, mesh.vertices.count()/6 - base);
 
-  glBegin(GL_TRIANGLE_STRIP);
+  base = mesh.vertices.count()/6;
   for(int j=0; j<m_sections+1; j++)
     {
-      Vec vox1 = mid + csecm[j];
-      glNormal3dv(normm[j]);
-      glVertex3dv(vox1);
-      
-      Vec vox2 = mid + 2*csecm[j];
-      glNormal3dv(normm[j]);
-      glVertex3dv(vox2);
+      addTubeVertex(mesh, mid + csecm[j], normm[j]);
+      addTubeVertex(mesh, mid + 2*csecm[j], normm[j]);
     }
-  glEnd();
+  addTubeStrip(mesh, base, mesh.vertices.count()/6 - base);
 
-  glBegin(GL_TRIANGLE_STRIP);
+  base = mesh.vertices.count()/6;
   for(int j=0; j<m_sections+1; j++)
     {
-      Vec vox1 = mid + 2*csecm[j];
-      glNormal3dv(normm[j]);
-      glVertex3dv(vox1);
-      
-      Vec vox2 = nextArrowHead;
-      glNormal3dv(tangm);
-      glVertex3dv(vox2);
+      addTubeVertex(mesh, mid + 2*csecm[j], normm[j]);
+      addTubeVertex(mesh, nextArrowHead, tangm);
     }
-  glEnd();
+  addTubeStrip(mesh, base, mesh.vertices.count()/6 - base);
 }
 
 QList<Vec>
@@ -2465,7 +2763,7 @@ PathGroupObject::getCrossSection(float scale,
 				 float offsetAngle, float a, float b,
 				 int sections,
 				 Vec ptang, Vec pxaxis, Vec pyaxis,
-				 Vec tang, Vec &xaxis, Vec &yaxis)
+				 Vec tang, Vec &xaxis, Vec &yaxis) const
 {
   Vec axis;
   float angle;
@@ -2520,7 +2818,7 @@ PathGroupObject::getCrossSection(float scale,
 }
 
 QList<Vec>
-PathGroupObject::getNormals(QList<Vec> csec, Vec tang)
+PathGroupObject::getNormals(QList<Vec> csec, Vec tang) const
 {
   QList<Vec> norm;
   int sections = csec.count();
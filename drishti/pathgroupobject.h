@@ -8,6 +8,7 @@ using namespace qglviewer;
 using namespace std;
 
 #include "cropobject.h"
+#include "pathbvh.h"
 
 class PathGroupObjectUndo
 {
@@ -139,6 +140,7 @@ class PathGroupObject
   void setPoints(QList<Vec>);
   void replacePoints(QList<Vec>);
   void addPoints(QList<Vec>);
+  void setPathPoints(QList<Vec>, QList<int>);
   void setRadX(QList<float>);
   void setRadY(QList<float>);
   void setAngle(QList<float>);
@@ -239,6 +241,7 @@ class PathGroupObject
   GLuint m_displayList;
 
   QList<float> m_pathLength;
+  PathBVH m_bvh;
   float m_minPathLen, m_maxPathLen;
   float m_minUserPathLen, m_maxUserPathLen;
 
@@ -264,10 +267,53 @@ class PathGroupObject
   float computeLength(QList<Vec>);
   void computeTangents(int, int);
   Vec interpolate(int, int, float);
+  //---------------------------------------
+  // tube geometry as indexed triangles.  every path owns a
+  // contiguous vertex and index range so that filtering only
+  // has to select ranges.
+  struct TubeMesh
+  {
+    QVector<float> vertices;  // position and normal, 6 floats each
+    QVector<uint> indices;    // triangles
+    QVector<int> vertexStart; // per path, one extra at the end
+    QVector<int> indexStart;
+  };
+
+  struct TubeJob
+  {
+    PathGroupObject *po;
+    int first, last;
+    TubeMesh mesh;
+  };
+
+  // cached geometry for tubes that do not depend on the view
+  TubeMesh m_tubeMesh;
+  bool m_tubeDirty;
+  int m_tubeSections;
+  int m_tubeCapType;
+  bool m_tubeArrowForAll;
+  QVector<uchar> m_tubeColors;
+  QVector<uint> m_tubeIndices; // triangles of the valid paths
+
+  bool staticTube();
+  void updateTubeMesh();
+  void updateTubeDraw(QGLViewer*);
+  void drawTubeMesh();
+  static void tubeJob(TubeJob&);
+
+  float lengthFraction(int) const;
+  Vec tubeColor(QGLViewer*, int, float);
+
   void generateTube(QGLViewer*, float);
+  void buildTube(int, Camera*, float, float, TubeMesh&) const;
+
+  static void addTubeVertex(TubeMesh&, Vec, Vec);
+  static void addTubeStrip(TubeMesh&, int, int);
+  static void addTubeRings(TubeMesh&, int, int, int);
+  //---------------------------------------
 
-  void addFlatCaps(int, Vec, QList<Vec>);
-  void addRoundCaps(int, Vec, QList<Vec>, QList<Vec>);
+  void addFlatCaps(TubeMesh&, int, Vec, QList<Vec>) const;
+  void addRoundCaps(TubeMesh&, int, Vec, QList<Vec>, QList<Vec>) const;
 
   void drawPoints();
   void drawTube(QGLViewer*, bool, Vec);
@@ -280,15 +326,15 @@ class PathGroupObject
 			     float, float, float,
 			     int,
 			     Vec, Vec, Vec,
-			     Vec, Vec&, Vec&);
-  QList<Vec> getNormals(QList<Vec>, Vec);
+			     Vec, Vec&, Vec&) const;
+  QList<Vec> getNormals(QList<Vec>, Vec) const;
 
-  void addArrowHead(int, float,
+  void addArrowHead(TubeMesh&, int, float,
 		    Vec,
 		    Vec, Vec, Vec,
 		    float, float, Vec,
 		    QList<Vec>,
-		    QList<Vec>);
+		    QList<Vec>) const;
 
 };
 
@@ -3,6 +3,7 @@
 #include "dcolordialog.h"
 #include "staticfunctions.h"
 #include "propertyeditor.h"
+#include "pathcache.h"
 
 int PathGroups::count() { return m_paths.count(); }
 
@@ -137,7 +138,9 @@ PathGroups::checkForMultiplePaths(QString flnm)
 }
 
 void
-PathGroups::addIndexedPath(QString flnm)
+PathGroups::readIndexedPaths(QString flnm,
+			     QList<Vec> &paths,
+			     QList<int> &index)
 {
   QFile fpath(flnm);
   fpath.open(QFile::ReadOnly);
@@ -145,8 +148,6 @@ PathGroups::addIndexedPath(QString flnm)
 
   QString line = fd.readLine(); // ignore first line
 
-  PathGroupGrabber *pg = new PathGroupGrabber();
-
   QList<Vec> pts;
   // first read all points
   while (! fd.atEnd())
@@ -156,6 +157,7 @@ PathGroups::addIndexedPath(QString flnm)
       if (list.count() == 1)
 	{
 	  int npts = list[0].toInt();
+	  pts.reserve(npts);
 	  for(int i=0; i<npts; i++)
 	    {
 	      if (fd.atEnd())
@@ -178,53 +180,48 @@ PathGroups::addIndexedPath(QString flnm)
     }
 
   // now read indices
+  index.append(0);
   while (! fd.atEnd())
     {
       line = fd.readLine();
       QStringList list = line.split(" ", QString::SkipEmptyParts);
       if (list.count() > 1)
 	{
-	  QList<Vec> ipts;
+	  int np = 0;
 	  for(int i=0; i<list.count(); i++)
 	    {
 	      int j = list[i].toInt();
 	      if (j>=0 && j<pts.count())
-		ipts.append(pts[j]);
+		{
+		  paths.append(pts[j]);
+		  np++;
+		}
 	    }
-	  if (ipts.count() > 0)
-	    pg->addPoints(ipts);		  
+	  if (np > 0)
+	    index.append(paths.count());
 	}
     }
-
-  m_paths.append(pg);
-  
-  makePathConnections();
 }
 
 void
-PathGroups::addPath(QString flnm)
+PathGroups::readPaths(QString flnm,
+		      QList<Vec> &paths,
+		      QList<int> &index)
 {
   QFile fpath(flnm);
   fpath.open(QFile::ReadOnly);
   QTextStream fd(&fpath);
 
-  QString line = fd.readLine();
-  if (line.contains("#indexed", Qt::CaseInsensitive))
-    {
-      addIndexedPath(flnm);
-      return;
-    }
-
-
-  PathGroupGrabber *pg = new PathGroupGrabber();
+  index.append(0);
 
+  QString line = fd.readLine();
   while (! fd.atEnd())
     {
       QStringList list = line.split(" ", QString::SkipEmptyParts);
       if (list.count() == 1)
 	{
 	  int npts = list[0].toInt();
-	  QList<Vec> pts;
+	  int np = 0;
 	  for(int i=0; i<npts; i++)
 	    {
 	      if (fd.atEnd())
@@ -238,16 +235,52 @@ PathGroups::addPath(QString flnm)
 		      float x = list[0].toFloat();
 		      float y = list[1].toFloat();
 		      float z = list[2].toFloat();
-		      pts.append(Vec(x,y,z));
+		      paths.append(Vec(x,y,z));
+		      np++;
 		    }
 		}
 	    }
 
-	  if (pts.count() > 0)
-	    pg->addPoints(pts);		  
+	  // single point paths are kept - setPathPoints
+	  // tells the user about them
+	  if (np > 0)
+	    index.append(paths.count());
 	}
       line = fd.readLine();
     }
+}
+
+void
+PathGroups::addPath(QString flnm)
+{
+  QFile fpath(flnm);
+  fpath.open(QFile::ReadOnly);
+  QTextStream fd(&fpath);
+
+  QString line = fd.readLine();
+  bool indexed = line.contains("#indexed", Qt::CaseInsensitive);
+  fpath.close();
+
+  //---------------
+  // large files are converted to a binary cache on first load
+  QList<Vec> pts;
+  QList<int> index;
+  if (!PathCache::read(flnm, pts, index))
+    {
+      pts.clear();
+      index.clear();
+      if (indexed)
+	readIndexedPaths(flnm, pts, index);
+      else
+	readPaths(flnm, pts, index);
+
+      PathCache::write(flnm, pts, index);
+    }
+  //---------------
+
+  PathGroupGrabber *pg = new PathGroupGrabber();
+  if (index.count() > 1)
+    pg->setPathPoints(pts, index);
 
   m_paths.append(pg);
   
@@ -60,7 +60,8 @@ class PathGroups : public QObject
   void makePathConnections();
   void processCommand(int, QString);
 
-  void addIndexedPath(QString);
+  void readPaths(QString, QList<Vec>&, QList<int>&);
+  void readIndexedPaths(QString, QList<Vec>&, QList<int>&);
 };
 
 
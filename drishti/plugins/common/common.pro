@@ -4,6 +4,7 @@ DRISHTI_DEFINES = RENDERER NETCDF
 include( ../../../drishti.pri )
 
 QT += opengl xml network
+QT += concurrent
 
 CONFIG += release staticlib
 
@@ -49,6 +50,7 @@ macx {
 
 HEADERS = ..\..\mainwindowui.h \
 	..\..\cropobject.h \	 
+	..\..\cropmask.h \
 	..\..\pathobject.h \	 
 	..\..\dcolordialog.h \
 	..\..\dcolorwheel.h \
@@ -65,6 +67,7 @@ HEADERS = ..\..\mainwindowui.h \
 
 SOURCES = ..\..\mainwindowui.cpp \
 	..\..\cropobject.cpp \	 
+	..\..\cropmask.cpp \
 	..\..\pathobject.cpp \	 
 	..\..\dcolordialog.cpp \
 	..\..\dcolorwheel.cpp \
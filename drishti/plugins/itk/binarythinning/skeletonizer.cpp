@@ -1,4 +1,5 @@
 #include "staticfunctions.h"
+#include "cropmask.h"
 #include "skeletonizer.h"
 
 #include "itkImage.h"
@@ -306,20 +307,6 @@ Skeletonizer::checkBlend(Vec po, ushort v, uchar* lut)
   return true;
 }
 
-bool
-Skeletonizer::checkCrop(Vec po)
-{
-  for(int ci=0; ci<m_crops.count(); ci++)
-    {
-      if (m_crops[ci].cropType() < CropObject::Tear_Tear)
-	{
-	  if (m_crops[ci].checkCropped(po) == false)
-	    return false;
-	}
-    }
-  return true;
-}
-
 bool
 Skeletonizer::checkPathBlend(Vec po, ushort v, uchar* lut)
 {
@@ -351,20 +338,6 @@ Skeletonizer::checkPathBlend(Vec po, ushort v, uchar* lut)
   return true;
 }
 
-bool
-Skeletonizer::checkPathCrop(Vec po)
-{
-  for(int ci=0; ci<m_paths.count(); ci++)
-    {
-      if (m_paths[ci].crop())
-	{
-	  if (m_paths[ci].checkCropped(po) == false)
-	    return false;
-	}
-    }
-  return true;
-}
-
 void
 Skeletonizer::applyBinaryThinning(QString flnm,
 				   QList<Vec> clipPos,
@@ -405,6 +378,13 @@ Skeletonizer::applyBinaryThinning(QString flnm,
       if (m_paths[i].crop()) m_pathCropPresent = true;
     }
 
+  bool maskPresent = (clipPresent || m_cropPresent || m_pathCropPresent);
+  int maskx = qRound(m_dataMin.x);
+  int masky = qRound(m_dataMin.y);
+  CropMask cropMask;
+  cropMask.setup(Vec(m_samplingLevel, m_samplingLevel, m_samplingLevel),
+		 clipPos, clipNormal, m_crops, m_paths);
+
   m_meshLog->moveCursor(QTextCursor::End);
   int d0 = 0;
   int d1 = m_nX-1;
@@ -447,6 +427,15 @@ Skeletonizer::applyBinaryThinning(QString flnm,
 	    }
 	}
 
+      uchar *inside = 0;
+      if (maskPresent)
+	{
+	  cropMask.evaluate(iv,
+			    maskx, maskx+m_nZ-1,
+			    masky, masky+m_nY-1);
+	  inside = cropMask.mask();
+	}
+
       int jk = 0;
       for(int j=0; j<m_nY; j++)
 	for(int k=0; k<m_nZ; k++)
@@ -471,14 +460,8 @@ Skeletonizer::applyBinaryThinning(QString flnm,
 	    
 	    po *= m_samplingLevel;
 
-	    if (ok && clipPresent)
-	      ok = StaticFunctions::getClip(po, clipPos, clipNormal);
-	    
-	    if (ok && m_cropPresent)
-	      ok = checkCrop(po);
-	    
-	    if (ok && m_pathCropPresent)
-	      ok = checkPathCrop(po);
+	    if (ok && inside)
+	      ok = inside[jk];
 	    
 	    if (ok && m_blendPresent)
 	      {
@@ -4,6 +4,7 @@ DRISHTI_DEFINES = RENDERER ITK
 include( ../../../../drishti.pri )
 
 QT += opengl xml network
+QT += concurrent
 
 CONFIG += release plugin
 
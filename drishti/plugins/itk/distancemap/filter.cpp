@@ -1,4 +1,5 @@
 #include "staticfunctions.h"
+#include "cropmask.h"
 #include "filter.h"
 #include "propertyeditor.h"
 
@@ -287,20 +288,6 @@ DistanceMapFilter::checkBlend(Vec po, ushort v, uchar* lut)
   return true;
 }
 
-bool
-DistanceMapFilter::checkCrop(Vec po)
-{
-  for(int ci=0; ci<m_crops.count(); ci++)
-    {
-      if (m_crops[ci].cropType() < CropObject::Tear_Tear)
-	{
-	  if (m_crops[ci].checkCropped(po) == false)
-	    return false;
-	}
-    }
-  return true;
-}
-
 bool
 DistanceMapFilter::checkPathBlend(Vec po, ushort v, uchar* lut)
 {
@@ -332,20 +319,6 @@ DistanceMapFilter::checkPathBlend(Vec po, ushort v, uchar* lut)
   return true;
 }
 
-bool
-DistanceMapFilter::checkPathCrop(Vec po)
-{
-  for(int ci=0; ci<m_paths.count(); ci++)
-    {
-      if (m_paths[ci].crop())
-	{
-	  if (m_paths[ci].checkCropped(po) == false)
-	    return false;
-	}
-    }
-  return true;
-}
-
 void
 DistanceMapFilter::applyDistanceMapFilter(QString flnm,
 					  QList<Vec> clipPos,
@@ -386,6 +359,13 @@ DistanceMapFilter::applyDistanceMapFilter(QString flnm,
       if (m_paths[i].crop()) m_pathCropPresent = true;
     }
 
+  bool maskPresent = (clipPresent || m_cropPresent || m_pathCropPresent);
+  int maskx = qRound(m_dataMin.x);
+  int masky = qRound(m_dataMin.y);
+  CropMask cropMask;
+  cropMask.setup(Vec(m_samplingLevel, m_samplingLevel, m_samplingLevel),
+		 clipPos, clipNormal, m_crops, m_paths);
+
   m_meshLog->moveCursor(QTextCursor::End);
   int d0 = 0;
   int d1 = m_nX-1;
@@ -428,6 +408,15 @@ DistanceMapFilter::applyDistanceMapFilter(QString flnm,
 	    }
 	}
 
+      uchar *inside = 0;
+      if (maskPresent)
+	{
+	  cropMask.evaluate(iv,
+			    maskx, maskx+m_nZ-1,
+			    masky, masky+m_nY-1);
+	  inside = cropMask.mask();
+	}
+
       int jk = 0;
       for(int j=0; j<m_nY; j++)
 	for(int k=0; k<m_nZ; k++)
@@ -452,14 +441,8 @@ DistanceMapFilter::applyDistanceMapFilter(QString flnm,
 	    
 	    po *= m_samplingLevel;
 	    
-	    if (ok && clipPresent)
-	      ok = StaticFunctions::getClip(po, clipPos, clipNormal);
-	    
-	    if (ok && m_cropPresent)
-	      ok = checkCrop(po);
-	    
-	    if (ok && m_pathCropPresent)
-	      ok = checkPathCrop(po);
+	    if (ok && inside)
+	      ok = inside[jk];
 	    
 	    if (ok && m_blendPresent)
 	      {
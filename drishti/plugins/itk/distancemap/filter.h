@@ -67,9 +67,7 @@ class DistanceMapFilter
   void applyTear(int, int, int,
 		 uchar*, uchar*, bool);
 
-  bool checkPathCrop(Vec);
   bool checkPathBlend(Vec, ushort, uchar*);
-  bool checkCrop(Vec);
   bool checkBlend(Vec, ushort, uchar*);
   void applyOpacity(int, uchar*, uchar*, uchar*);
 };
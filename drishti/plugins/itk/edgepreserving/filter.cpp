@@ -1,4 +1,5 @@
 #include "staticfunctions.h"
+#include "cropmask.h"
 #include "filter.h"
 #include "propertyeditor.h"
 
@@ -261,6 +262,13 @@ SmoothingFilter::applyFilter(QString flnm,
       if (m_paths[i].crop()) m_pathCropPresent = true;
     }
 
+  bool maskPresent = (clipPresent || m_cropPresent || m_pathCropPresent);
+  int maskx = qRound(m_dataMin.x);
+  int masky = qRound(m_dataMin.y);
+  CropMask cropMask;
+  cropMask.setup(Vec(m_samplingLevel, m_samplingLevel, m_samplingLevel),
+		 clipPos, clipNormal, m_crops, m_paths);
+
   m_meshLog->moveCursor(QTextCursor::End);
   int d0 = 0;
   int d1 = m_nX-1;
@@ -302,6 +310,15 @@ SmoothingFilter::applyFilter(QString flnm,
 
       if (usePruneData)
 	{
+	  uchar *inside = 0;
+	  if (maskPresent)
+	    {
+	      cropMask.evaluate(iv,
+				maskx, maskx+m_nZ-1,
+				masky, masky+m_nY-1);
+	      inside = cropMask.mask();
+	    }
+
 	  int jk = 0;
 	  for(int j=0; j<m_nY; j++)
 	    for(int k=0; k<m_nZ; k++)
@@ -326,14 +343,8 @@ SmoothingFilter::applyFilter(QString flnm,
 		
 		po *= m_samplingLevel;
 		
-		if (ok && clipPresent)
-		  ok = StaticFunctions::getClip(po, clipPos, clipNormal);
-		
-		if (ok && m_cropPresent)
-		  ok = checkCrop(po);
-		
-		if (ok && m_pathCropPresent)
-		  ok = checkPathCrop(po);
+		if (ok && inside)
+		  ok = inside[jk];
 		
 		if (ok && m_blendPresent)
 		  {
@@ -878,20 +889,6 @@ SmoothingFilter::checkBlend(Vec po, ushort v, uchar* lut)
   return true;
 }
 
-bool
-SmoothingFilter::checkCrop(Vec po)
-{
-  for(int ci=0; ci<m_crops.count(); ci++)
-    {
-      if (m_crops[ci].cropType() < CropObject::Tear_Tear)
-	{
-	  if (m_crops[ci].checkCropped(po) == false)
-	    return false;
-	}
-    }
-  return true;
-}
-
 bool
 SmoothingFilter::checkPathBlend(Vec po, ushort v, uchar* lut)
 {
@@ -922,18 +919,3 @@ SmoothingFilter::checkPathBlend(Vec po, ushort v, uchar* lut)
     }
   return true;
 }
-
-bool
-SmoothingFilter::checkPathCrop(Vec po)
-{
-  for(int ci=0; ci<m_paths.count(); ci++)
-    {
-      if (m_paths[ci].crop())
-	{
-	  if (m_paths[ci].checkCropped(po) == false)
-	    return false;
-	}
-    }
-  return true;
-}
-
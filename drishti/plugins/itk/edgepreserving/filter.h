@@ -73,9 +73,7 @@ class SmoothingFilter
   void BilateralFilter(uchar*);
 
 
-  bool checkPathCrop(Vec);
   bool checkPathBlend(Vec, ushort, uchar*);
-  bool checkCrop(Vec);
   bool checkBlend(Vec, ushort, uchar*);
 
   void savePvl(QString);
@@ -72,9 +72,7 @@ class SmoothingFilter
   void DiscreteGaussianFilter(uchar*);
   void RecursiveGaussianFilter(uchar*);
 
-  bool checkPathCrop(Vec);
   bool checkPathBlend(Vec, ushort, uchar*);
-  bool checkCrop(Vec);
   bool checkBlend(Vec, ushort, uchar*);
 
   void savePvl(QString);
@@ -62,9 +62,7 @@ class VEDFilter
 		   float, float, int, int,
 		   bool);
 
-  bool checkPathCrop(Vec);
   bool checkPathBlend(Vec, ushort, uchar*);
-  bool checkCrop(Vec);
   bool checkBlend(Vec, ushort, uchar*);
 
   void savePvl(QString);
@@ -1,6 +1,7 @@
 TEMPLATE = lib
 
 QT += opengl xml network
+QT += concurrent
 
 CONFIG += release plugin
 
@@ -6,6 +6,7 @@ include( ../../../drishti.pri )
 RESOURCES = mesh.qrc
 
 QT += opengl xml network
+QT += concurrent
 
 CONFIG += release plugin
 
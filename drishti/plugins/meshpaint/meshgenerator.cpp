@@ -1,4 +1,5 @@
 #include "staticfunctions.h"
+#include "cropmask.h"
 #include "meshgenerator.h"
 
 MeshGenerator::MeshGenerator()
@@ -740,21 +741,6 @@ MeshGenerator::checkBlend(Vec po, ushort v, uchar* lut)
   return true;
 }
 
-bool
-MeshGenerator::checkCrop(Vec po)
-{
-  bool cropped = false;
-  for(int ci=0; ci<m_crops.count(); ci++)
-    {
-      if (m_crops[ci].cropType() < CropObject::Tear_Tear)
-	{
-	  // take union
-	  cropped |= m_crops[ci].checkCropped(po);
-	}
-    }
-  return cropped;
-}
-
 bool
 MeshGenerator::checkPathBlend(Vec po, ushort v, uchar* lut)
 {
@@ -786,21 +772,6 @@ MeshGenerator::checkPathBlend(Vec po, ushort v, uchar* lut)
   return true;
 }
 
-bool
-MeshGenerator::checkPathCrop(Vec po)
-{
-  bool cropped = false;
-  for(int ci=0; ci<m_paths.count(); ci++)
-    {
-      if (m_paths[ci].crop())
-	{
-	  // take union
-	  cropped |= m_paths[ci].checkCropped(po);
-	}
-    }
-  return cropped;
-}
-
 void
 MeshGenerator::generateMesh(int nSlabs,
 			    QStringList volumeFiles,
@@ -872,6 +843,13 @@ MeshGenerator::generateMesh(int nSlabs,
       if (m_paths[i].crop()) m_pathCropPresent = true;
     }
 
+  bool maskPresent = (clipPresent || m_cropPresent || m_pathCropPresent);
+  int maskx = qRound(m_dataMin.x);
+  int masky = qRound(m_dataMin.y);
+  CropMask cropMask;
+  cropMask.setup(Vec(m_samplingLevel, m_samplingLevel, m_samplingLevel),
+		 clipPos, clipNormal, m_crops, m_paths, true);
+
   int nextra = depth;
   int blockStep = m_nX/nSlabs;
 
@@ -944,6 +922,15 @@ MeshGenerator::generateMesh(int nSlabs,
 		}
 	      
 	      
+	      uchar *inside = 0;
+	      if (maskPresent)
+		{
+		  cropMask.evaluate(iv,
+				    maskx, maskx+m_nZ-1,
+				    masky, masky+m_nY-1);
+		  inside = cropMask.mask();
+		}
+
 	      int jk = 0;
 	      for(int j=0; j<m_nY; j++)
 		for(int k=0; k<m_nZ; k++)
@@ -956,14 +943,8 @@ MeshGenerator::generateMesh(int nSlabs,
 
 		    po *= m_samplingLevel;
 		    
-		    if (ok && clipPresent)
-		      ok = StaticFunctions::getClip(po, clipPos, clipNormal);
-		    
-		    if (ok && m_cropPresent)
-		      ok = checkCrop(po);
-		    
-		    if (ok && m_pathCropPresent)
-		      ok = checkPathCrop(po);
+		    if (ok && inside)
+		      ok = inside[jk];
 		    
 		    if (ok && m_blendPresent)
 		      {
@@ -1419,4 +1400,3 @@ MeshGenerator::loadPLY(QString flnm)
 
   return true;
 }
-
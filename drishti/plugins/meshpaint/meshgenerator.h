@@ -120,9 +120,7 @@ class MeshGenerator
   void applyTear(int, int, int,
 		 uchar*, uchar*, bool);
 
-  bool checkPathCrop(Vec);
   bool checkPathBlend(Vec, ushort, uchar*);
-  bool checkCrop(Vec);
   bool checkBlend(Vec, ushort, uchar*);
 };
 
@@ -7,6 +7,7 @@ include( ../../../drishti.pri )
 RESOURCES = meshpaint.qrc
 
 QT += opengl xml network
+QT += concurrent
 
 CONFIG += release plugin
 
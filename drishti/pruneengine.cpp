@@ -0,0 +1,922 @@
+#include "pruneengine.h"
+
+#include <QList>
+#include <QVector>
+#include <QThread>
+#include <QtMath>
+#include <QtConcurrentMap>
+
+// distance of voxels that have no seed
+static const int INF = 0x3fffffff;
+
+// texel of voxel x,y,z - same layout as the shaders
+static inline int
+texel(const int gridx, const int gridy, const int ncols, const int dtexX,
+      int x, int y, int z)
+{
+  int row = z/ncols;
+  int col = z - row*ncols;
+  return (row*gridy + y)*dtexX + col*gridx + x;
+}
+
+// squared distance to a seed at i from position x with squared
+// distance g to the seed along the previous axes
+static inline int
+fdist(int x, int i, int g)
+{
+  return (x-i)*(x-i) + g;
+}
+
+// first position from where the seed at u is nearer than the seed at i
+// (Meijster, Roerdink and Hesselink)
+static inline int
+fsep(int i, int u, int gi, int gu)
+{
+  return (u*u - i*i + gu - gi)/(2*(u-i));
+}
+
+PruneEngine::PruneEngine()
+{
+  m_gridx = m_gridy = m_gridz = 0;
+  m_ncols = 1;
+  m_dtexX = m_dtexY = 0;
+  m_nvox = 0;
+  m_dist = 0;
+  m_feat = 0;
+}
+
+PruneEngine::~PruneEngine()
+{
+  clear();
+}
+
+void
+PruneEngine::clear()
+{
+  if (m_dist) delete [] m_dist;
+  if (m_feat) delete [] m_feat;
+  m_dist = 0;
+  m_feat = 0;
+  m_nvox = 0;
+}
+
+void
+PruneEngine::setGrid(int gridx, int gridy, int gridz,
+		     int ncols,
+		     int dtexX, int dtexY)
+{
+  int nvox = gridx*gridy*gridz;
+  if (nvox != m_nvox)
+    {
+      clear();
+      m_nvox = nvox;
+      m_dist = new int[m_nvox];
+      m_feat = new int[m_nvox];
+    }
+
+  m_gridx = gridx;
+  m_gridy = gridy;
+  m_gridz = gridz;
+  m_ncols = qMax(1, ncols);
+  m_dtexX = dtexX;
+  m_dtexY = dtexY;
+}
+
+// channels are numbered as rgba, the buffer is bgra
+int
+PruneEngine::offset(int chan)
+{
+  if (chan < 0) return 2;
+  if (chan < 3) return 2-chan;
+  return 3;
+}
+
+PruneEngine::Pass
+PruneEngine::newPass(int type)
+{
+  Pass p;
+  memset(&p, 0, sizeof(Pass));
+  p.type = type;
+  p.gridx = m_gridx;
+  p.gridy = m_gridy;
+  p.gridz = m_gridz;
+  p.ncols = m_ncols;
+  p.dtexX = m_dtexX;
+  p.off = 2;
+  p.dist = m_dist;
+  return p;
+}
+
+void
+PruneEngine::run(Pass &p)
+{
+  // columns along z are independent for every y, the wavefront
+  // is split by voxels, everything else into slabs of slices
+  int n = p.gridz;
+  if (p.type == AlongZ) n = p.gridy;
+  if (p.type == Wave || p.type == Erode) n = p.count;
+  int nthreads = qMax(1, QThread::idealThreadCount());
+  int nslab = qMax(1, n/(4*nthreads));
+
+  QList<PassJob> jobs;
+  for(int i0=0; i0<n; i0+=nslab)
+    {
+      PassJob job;
+      job.pass = &p;
+      job.i0 = i0;
+      job.i1 = qMin(n, i0+nslab)-1;
+      jobs << job;
+    }
+
+  if (jobs.count() == 1)
+    runSlab(jobs[0]);
+  else
+    QtConcurrent::blockingMap(jobs, PruneEngine::runSlab);
+}
+
+void
+PruneEngine::runSlab(PassJob &job)
+{
+  const Pass *p = job.pass;
+  switch (p->type)
+    {
+    case Seed : seed(p, job.i0, job.i1); break;
+    case AlongX : alongX(p, job.i0, job.i1); break;
+    case AlongY : alongY(p, job.i0, job.i1); break;
+    case AlongZ : alongZ(p, job.i0, job.i1); break;
+    case Wave : waveSlab(p, job.i0, job.i1); break;
+    case Erode : erodeSlab(p, job.i0, job.i1); break;
+    case Border : border(p, job.i0); break;
+    case Scatter : scatter(p, job.i0); break;
+    case Collect : collect(p, job.i0); break;
+    default : apply(p, job.i0, job.i1); break;
+    }
+}
+
+//-------------------------------------------------
+// euclidean distance transform
+//-------------------------------------------------
+void
+PruneEngine::distanceField(const uchar *buf, int off, bool seedNonZero,
+			   bool features)
+{
+  Pass p = newPass(Seed);
+  p.src = buf;
+  p.off = off;
+  p.seedNonZero = seedNonZero;
+  if (features)
+    p.feat = m_feat;
+  run(p);
+
+  p.type = AlongX;
+  run(p);
+  p.type = AlongY;
+  run(p);
+  p.type = AlongZ;
+  run(p);
+}
+
+void
+PruneEngine::seed(const Pass *p, int z0, int z1)
+{
+  for(int z=z0; z<=z1; z++)
+    for(int y=0; y<p->gridy; y++)
+      {
+	int t = texel(p->gridx, p->gridy, p->ncols, p->dtexX, 0, y, z);
+	int v = (z*p->gridy + y)*p->gridx;
+	const uchar *s = p->src + 4*t + p->off;
+	for(int x=0; x<p->gridx; x++)
+	  {
+	    bool on = (s[4*x] > 0);
+	    p->dist[v+x] = (on == p->seedNonZero ? 0 : INF);
+	    if (p->feat)
+	      p->feat[v+x] = t+x;
+	  }
+      }
+}
+
+// lower envelope of the distances to the seeds along one line -
+// g and f are the distance and seed texel along the previous axes.
+// seeds with infinite distance are left out of the envelope.
+void
+PruneEngine::envelope(int n,
+		      const int *g, const int *f,
+		      int *gout, int *fout,
+		      int *s, int *t)
+{
+  int q = -1;
+  for(int u=0; u<n; u++)
+    {
+      if (g[u] >= INF)
+	continue;
+
+      while (q >= 0 &&
+	     fdist(t[q], s[q], g[s[q]]) > fdist(t[q], u, g[u]))
+	q--;
+
+      if (q < 0)
+	{
+	  q = 0;
+	  s[0] = u;
+	  t[0] = 0;
+	}
+      else
+	{
+	  int w = 1 + fsep(s[q], u, g[s[q]], g[u]);
+	  if (w < n)
+	    {
+	      q++;
+	      s[q] = u;
+	      t[q] = w;
+	    }
+	}
+    }
+
+  if (q < 0)
+    {
+      for(int u=0; u<n; u++)
+	gout[u] = INF;
+      if (f)
+	memcpy(fout, f, n*sizeof(int));
+      return;
+    }
+
+  for(int u=n-1; u>=0; u--)
+    {
+      gout[u] = fdist(u, s[q], g[s[q]]);
+      if (f)
+	fout[u] = f[s[q]];
+      if (u == t[q])
+	q--;
+    }
+}
+
+void
+PruneEngine::alongX(const Pass *p, int z0, int z1)
+{
+  int n = p->gridx;
+  int *g = new int[4*n];
+  int *s = g + n;
+  int *t = g + 2*n;
+  int *f = g + 3*n;
+
+  for(int z=z0; z<=z1; z++)
+    for(int y=0; y<p->gridy; y++)
+      {
+	int v = (z*p->gridy + y)*p->gridx;
+	int *dist = p->dist + v;
+	int *feat = (p->feat ? p->feat + v : 0);
+	memcpy(g, dist, n*sizeof(int));
+	if (feat)
+	  memcpy(f, feat, n*sizeof(int));
+	envelope(n, g, (feat ? f : 0), dist, feat, s, t);
+      }
+
+  delete [] g;
+}
+
+void
+PruneEngine::alongY(const Pass *p, int z0, int z1)
+{
+  int n = p->gridy;
+  int *g = new int[6*n];
+  int *s = g + n;
+  int *t = g + 2*n;
+  int *f = g + 3*n;
+  int *gout = g + 4*n;
+  int *fout = g + 5*n;
+
+  for(int z=z0; z<=z1; z++)
+    for(int x=0; x<p->gridx; x++)
+      {
+	int v = z*p->gridy*p->gridx + x;
+	for(int y=0; y<n; y++)
+	  g[y] = p->dist[v + y*p->gridx];
+	if (p->feat)
+	  for(int y=0; y<n; y++)
+	    f[y] = p->feat[v + y*p->gridx];
+
+	envelope(n, g, (p->feat ? f : 0), gout, fout, s, t);
+
+	for(int y=0; y<n; y++)
+	  p->dist[v + y*p->gridx] = gout[y];
+	if (p->feat)
+	  for(int y=0; y<n; y++)
+	    p->feat[v + y*p->gridx] = fout[y];
+      }
+
+  delete [] g;
+}
+
+void
+PruneEngine::alongZ(const Pass *p, int y0, int y1)
+{
+  int n = p->gridz;
+  int stride = p->gridx*p->gridy;
+  int *g = new int[6*n];
+  int *s = g + n;
+  int *t = g + 2*n;
+  int *f = g + 3*n;
+  int *gout = g + 4*n;
+  int *fout = g + 5*n;
+
+  for(int y=y0; y<=y1; y++)
+    for(int x=0; x<p->gridx; x++)
+      {
+	int v = y*p->gridx + x;
+	for(int z=0; z<n; z++)
+	  g[z] = p->dist[v + z*stride];
+	if (p->feat)
+	  for(int z=0; z<n; z++)
+	    f[z] = p->feat[v + z*stride];
+
+	envelope(n, g, (p->feat ? f : 0), gout, fout, s, t);
+
+	for(int z=0; z<n; z++)
+	  p->dist[v + z*stride] = gout[z];
+	if (p->feat)
+	  for(int z=0; z<n; z++)
+	    p->feat[v + z*stride] = fout[z];
+      }
+
+  delete [] g;
+}
+
+//-------------------------------------------------
+// wavefronts - every shader pass reaches the 18 (city block) or 26
+// (chessboard) neighbours of the voxels changed by the pass before,
+// so only those are visited by the next pass.
+//-------------------------------------------------
+int
+PruneEngine::neighbours(int nbr, int *ox, int *oy, int *oz)
+{
+  int n = 0;
+  for(int k=-1; k<=1; k++)
+    for(int j=-1; j<=1; j++)
+      for(int i=-1; i<=1; i++)
+	{
+	  if (i==0 && j==0 && k==0)
+	    continue;
+	  if (nbr == 18 && i!=0 && j!=0 && k!=0)
+	    continue;
+	  ox[n] = i;
+	  oy[n] = j;
+	  oz[n] = k;
+	  n++;
+	}
+  return n;
+}
+
+// voxels of the next level in cand, stamped with p.level in m_dist.
+// for the first level the slabs of slices are scanned for voxels
+// next to the seeds.  after that the jobs take parts of the front
+// and sort its neighbours into buckets by slab, and every slab then
+// collects its buckets - so each voxel is only stamped by one thread.
+void
+PruneEngine::gather(Pass &p, const QVector<int> &front, bool first,
+		    QVector<int> &cand)
+{
+  int nthreads = qMax(1, QThread::idealThreadCount());
+  int nslab = qMax(1, qMin(m_gridz, 4*nthreads));
+  p.slabSize = (m_gridz + nslab-1)/nslab;
+  p.nslab = (m_gridz + p.slabSize-1)/p.slabSize;
+  p.list = front.constData();
+  p.count = front.count();
+  p.bucket = new QVector<int>[p.nslab*p.nslab];
+  p.found = new QVector<int>[p.nslab];
+
+  QList<PassJob> jobs;
+  for(int s=0; s<p.nslab; s++)
+    {
+      PassJob job;
+      job.pass = &p;
+      job.i0 = job.i1 = s;
+      jobs << job;
+    }
+
+  p.type = (first ? Border : Scatter);
+  QtConcurrent::blockingMap(jobs, PruneEngine::runSlab);
+  p.type = Collect;
+  QtConcurrent::blockingMap(jobs, PruneEngine::runSlab);
+
+  cand.clear();
+  for(int s=0; s<p.nslab; s++)
+    cand += p.found[s];
+
+  delete [] p.bucket;
+  delete [] p.found;
+  p.bucket = 0;
+  p.found = 0;
+}
+
+// voxels of slab s next to the seeds - level 0 when unreached,
+// zero voxels otherwise
+void
+PruneEngine::border(const Pass *p, int s)
+{
+  int ox[26], oy[26], oz[26];
+  int no = neighbours(p->nbr, ox, oy, oz);
+  int gxy = p->gridx*p->gridy;
+  QVector<int> &out = p->bucket[s*p->nslab + s];
+
+  int z0 = s*p->slabSize;
+  int z1 = qMin(p->gridz, z0+p->slabSize)-1;
+  for(int z=z0; z<=z1; z++)
+    for(int y=0; y<p->gridy; y++)
+      for(int x=0; x<p->gridx; x++)
+	{
+	  int v = z*gxy + y*p->gridx + x;
+	  if (p->unreached)
+	    {
+	      if (p->dist[v] != INF)
+		continue;
+	    }
+	  else if (p->val[v] == 0 || (p->mask && p->mask[v]))
+	    continue;
+
+	  for(int o=0; o<no; o++)
+	    {
+	      int x1 = x+ox[o];
+	      int y1 = y+oy[o];
+	      int z1 = z+oz[o];
+	      if (x1 < 0 || x1 >= p->gridx ||
+		  y1 < 0 || y1 >= p->gridy ||
+		  z1 < 0 || z1 >= p->gridz)
+		continue;
+	      int v1 = z1*gxy + y1*p->gridx + x1;
+	      if (p->unreached ? p->dist[v1] == 0 : p->val[v1] == 0)
+		{
+		  out << v;
+		  break;
+		}
+	    }
+	}
+}
+
+// neighbours of part j of the front, by slab
+void
+PruneEngine::scatter(const Pass *p, int j)
+{
+  int ox[26], oy[26], oz[26];
+  int no = neighbours(p->nbr, ox, oy, oz);
+  int gxy = p->gridx*p->gridy;
+  QVector<int> *out = p->bucket + j*p->nslab;
+
+  int i0 = (qint64)j*p->count/p->nslab;
+  int i1 = (qint64)(j+1)*p->count/p->nslab;
+  for(int i=i0; i<i1; i++)
+    {
+      int v = p->list[i];
+      int z = v/gxy;
+      int y = (v - z*gxy)/p->gridx;
+      int x = v - z*gxy - y*p->gridx;
+      for(int o=0; o<no; o++)
+	{
+	  int x1 = x+ox[o];
+	  int y1 = y+oy[o];
+	  int z1 = z+oz[o];
+	  if (x1 < 0 || x1 >= p->gridx ||
+	      y1 < 0 || y1 >= p->gridy ||
+	      z1 < 0 || z1 >= p->gridz)
+	    continue;
+	  int v1 = z1*gxy + y1*p->gridx + x1;
+	  if (p->unreached)
+	    {
+	      if (p->dist[v1] != INF)
+		continue;
+	    }
+	  else if (p->val[v1] == 0 || (p->mask && p->mask[v1]))
+	    continue;
+	  out[z1/p->slabSize] << v1;
+	}
+    }
+}
+
+// voxels of slab s found by all jobs, each one taken once
+void
+PruneEngine::collect(const Pass *p, int s)
+{
+  QVector<int> &out = p->found[s];
+  for(int j=0; j<p->nslab; j++)
+    {
+      const QVector<int> &in = p->bucket[j*p->nslab + s];
+      for(int i=0; i<in.count(); i++)
+	{
+	  int v = in[i];
+	  if (p->unreached ? p->dist[v] == INF : p->dist[v] != p->level)
+	    {
+	      p->dist[v] = p->level;
+	      out << v;
+	    }
+	}
+    }
+}
+
+//-------------------------------------------------
+// results from the distance field
+//-------------------------------------------------
+void
+PruneEngine::apply(const Pass *p, int z0, int z1)
+{
+  for(int z=z0; z<=z1; z++)
+    for(int y=0; y<p->gridy; y++)
+      {
+	int t = texel(p->gridx, p->gridy, p->ncols, p->dtexX, 0, y, z);
+	int v = (z*p->gridy + y)*p->gridx;
+	for(int x=0; x<p->gridx; x++, t++, v++)
+	  {
+	    uchar *b = p->buf + 4*t;
+	    int dist = p->dist[v];
+
+	    if (p->type == Distance)
+	      {
+		// chamfer distance
+		if (b[2] > 0)
+		  {
+		    b[3] = 255;
+		    if (dist <= p->sz)
+		      b[2] = qMin(dist, 255);
+		    else
+		      b[2] = 255;
+		  }
+	      }
+	    else if (p->type == Accumulate)
+	      {
+		p->acc[v] += p->wt*sqrtf((float)dist);
+		if (p->val)
+		  p->val[v] = p->src[4*p->feat[v] + p->off];
+	      }
+	    else if (p->type == Blend)
+	      {
+		float sd = p->acc[v] + p->wt*sqrtf((float)dist);
+		if (sd < 0)
+		  b[p->off] = (1.0f-p->frc)*p->val[v] +
+		              p->frc*p->src[4*p->feat[v] + p->off];
+		else
+		  b[p->off] = 0;
+	      }
+	  }
+      }
+}
+
+//-------------------------------------------------
+// dilate and thicken - every shader pass sets zero voxels next to
+// the voxels set so far to their largest neighbour less dec.
+// voxels are added level by level, one level per shader pass, and
+// only the new voxels are visited.  m_dist holds the level.
+//-------------------------------------------------
+void
+PruneEngine::wave(uchar *buf, int off, int sz, int nbr, int dec)
+{
+  uchar *val = new uchar[m_nvox];
+  for(int z=0; z<m_gridz; z++)
+    for(int y=0; y<m_gridy; y++)
+      {
+	int t = texel(m_gridx, m_gridy, m_ncols, m_dtexX, 0, y, z);
+	int v = (z*m_gridy + y)*m_gridx;
+	for(int x=0; x<m_gridx; x++)
+	  {
+	    val[v+x] = buf[4*(t+x)+off];
+	    m_dist[v+x] = (val[v+x] > 0 ? 0 : INF);
+	  }
+      }
+
+  Pass p = newPass(Wave);
+  p.dec = dec;
+  p.nbr = nbr;
+  p.val = val;
+  p.unreached = true;
+
+  QVector<int> front, cand;
+  QVector<uchar> newval;
+  for(int level=1; level<=sz; level++)
+    {
+      p.level = level;
+      gather(p, front, level == 1, cand);
+      if (cand.count() == 0)
+	break;
+
+      newval.resize(cand.count());
+      p.type = Wave;
+      p.list = cand.constData();
+      p.count = cand.count();
+      p.newval = newval.data();
+      run(p);
+
+      // voxels left at zero can still be reached by a later pass
+      front.clear();
+      for(int i=0; i<cand.count(); i++)
+	{
+	  val[cand[i]] = newval[i];
+	  if (newval[i] == 0)
+	    m_dist[cand[i]] = INF;
+	  else if (newval[i] > dec)
+	    front << cand[i];
+	}
+      if (front.count() == 0)
+	break;
+    }
+
+  for(int z=0; z<m_gridz; z++)
+    for(int y=0; y<m_gridy; y++)
+      {
+	int t = texel(m_gridx, m_gridy, m_ncols, m_dtexX, 0, y, z);
+	int v = (z*m_gridy + y)*m_gridx;
+	for(int x=0; x<m_gridx; x++)
+	  buf[4*(t+x)+off] = val[v+x];
+      }
+
+  delete [] val;
+}
+
+void
+PruneEngine::waveSlab(const Pass *p, int i0, int i1)
+{
+  int ox[26], oy[26], oz[26];
+  int no = neighbours(p->nbr, ox, oy, oz);
+  int gxy = p->gridx*p->gridy;
+
+  for(int i=i0; i<=i1; i++)
+    {
+      int v = p->list[i];
+      int z = v/gxy;
+      int y = (v - z*gxy)/p->gridx;
+      int x = v - z*gxy - y*p->gridx;
+
+      // lookups outside the grid are clamped onto voxels
+      // that are neighbours already
+      int m = 0;
+      for(int o=0; o<no; o++)
+	{
+	  int x1 = x+ox[o];
+	  int y1 = y+oy[o];
+	  int z1 = z+oz[o];
+	  if (x1 < 0 || x1 >= p->gridx ||
+	      y1 < 0 || y1 >= p->gridy ||
+	      z1 < 0 || z1 >= p->gridz)
+	    continue;
+	  int v1 = z1*gxy + y1*p->gridx + x1;
+	  if (p->dist[v1] < p->level)
+	    m = qMax(m, (int)p->val[v1]);
+	}
+      p->newval[i] = qMax(0, m - p->dec);
+    }
+}
+
+//-------------------------------------------------
+// operations
+//-------------------------------------------------
+void
+PruneEngine::invert(uchar *buf, int chan)
+{
+  int off = offset(chan);
+  int n = m_dtexX*m_dtexY;
+  for(int i=0; i<n; i++)
+    buf[4*i+off] = 255 - buf[4*i+off];
+}
+
+void
+PruneEngine::dilate(uchar *buf, int sz, int chan)
+{
+  if (sz < 1 || m_nvox == 0) return;
+
+  wave(buf, offset(chan), sz, 18, 0);
+}
+
+void
+PruneEngine::erode(uchar *buf, int sz, int chan)
+{
+  if (sz < 1 || m_nvox == 0) return;
+
+  int off = offset(chan);
+  iterate(buf, off, sz, -1);
+}
+
+void
+PruneEngine::open(uchar *buf, int sz, int chan)
+{
+  erode(buf, sz, chan);
+  dilate(buf, sz, chan);
+}
+
+void
+PruneEngine::close(uchar *buf, int sz, int chan)
+{
+  dilate(buf, sz, chan);
+  erode(buf, sz, chan);
+}
+
+void
+PruneEngine::thicken(uchar *buf, int sz, bool cityBlock)
+{
+  if (sz < 1 || m_nvox == 0) return;
+
+  // every pass marks the zero voxels
+  int n = m_dtexX*m_dtexY;
+  for(int i=0; i<n; i++)
+    if (buf[4*i+2] == 0)
+      buf[4*i+3] = 255;
+
+  // values drop by one for every step away from the seeds
+  wave(buf, 2, sz, (cityBlock ? 18 : 26), 1);
+}
+
+void
+PruneEngine::distanceTransform(uchar *buf, int sz, bool cityBlock)
+{
+  if (sz < 1 || m_nvox == 0) return;
+
+  // channel 0 values are either 0 or 255
+  int n = m_dtexX*m_dtexY;
+  for(int i=0; i<n; i++)
+    if (buf[4*i+2] > 0)
+      buf[4*i+2] = 255;
+
+  // steps to the nearest zero voxel, one level per shader pass -
+  // voxels further than sz are set to 255
+  Pass p = newPass(Seed);
+  p.src = buf;
+  p.seedNonZero = false;
+  run(p);
+
+  p.nbr = (cityBlock ? 18 : 26);
+  p.unreached = true;
+  QVector<int> front, cand;
+  for(int level=1; level<=sz; level++)
+    {
+      p.level = level;
+      gather(p, front, level == 1, cand);
+      if (cand.count() == 0)
+	break;
+      front = cand;
+    }
+
+  p.type = Distance;
+  p.buf = buf;
+  p.sz = sz;
+  run(p);
+}
+
+void
+PruneEngine::interpolate(const uchar *buf1, const uchar *buf2,
+			 float frc, uchar *out)
+{
+  int n = 4*m_dtexX*m_dtexY;
+  for(int i=0; i<n; i++)
+    out[i] = (1.0f-frc)*buf1[i] + frc*buf2[i];
+
+  if (m_nvox == 0)
+    return;
+
+  // interpolate signed distance to the surfaces of the two
+  // channel 0 masks - inside voxels take the values of the
+  // nearest voxels in the two masks
+  float *acc = new float[m_nvox];
+  uchar *val = new uchar[m_nvox];
+  memset(acc, 0, m_nvox*sizeof(float));
+
+  Pass p = newPass(Accumulate);
+  p.acc = acc;
+  p.frc = frc;
+
+  bool ok = true;
+  for(int i=0; i<4 && ok; i++)
+    {
+      const uchar *src = (i < 2 ? buf1 : buf2);
+      bool inside = (i%2 == 1);
+
+      // empty or full mask has no surface - keep linear blend
+      distanceField(src, 2, inside, inside);
+      ok = (m_dist[0] < INF);
+      if (!ok)
+	break;
+
+      p.type = (i == 3 ? Blend : Accumulate);
+      p.wt = (i < 2 ? 1.0f-frc : frc);
+      if (!inside)
+	p.wt = -p.wt;
+      p.src = src;
+      p.feat = (inside ? m_feat : 0);
+      p.val = (i == 1 || i == 3 ? val : 0);
+      p.buf = out;
+      run(p);
+    }
+
+  delete [] acc;
+  delete [] val;
+}
+
+void
+PruneEngine::shrink(uchar *buf, int sz, int chan)
+{
+  if (sz < 1 || m_nvox == 0) return;
+
+  iterate(buf, 2, sz, offset(chan));
+}
+
+//-------------------------------------------------
+// erode and shrink follow the gpu passes - a non-zero voxel
+// is removed when more than one of its 18 neighbours is zero.
+// shrink only works on channel 0 voxels that are not in the mask
+// channel, so it removes voxels connected to the outside through
+// unmasked voxels.  maskOff is -1 when there is no mask.
+// a pass can only remove voxels next to those removed by the pass
+// before, so only they are looked at.  m_dist holds the last pass
+// that looked at a voxel.
+//-------------------------------------------------
+void
+PruneEngine::iterate(uchar *buf, int off, int sz, int maskOff)
+{
+  uchar *vol = new uchar[m_nvox];
+  uchar *mask = (maskOff >= 0 ? new uchar[m_nvox] : 0);
+  for(int z=0; z<m_gridz; z++)
+    for(int y=0; y<m_gridy; y++)
+      {
+	int t = texel(m_gridx, m_gridy, m_ncols, m_dtexX, 0, y, z);
+	int v = (z*m_gridy + y)*m_gridx;
+	for(int x=0; x<m_gridx; x++)
+	  {
+	    vol[v+x] = buf[4*(t+x)+off];
+	    m_dist[v+x] = 0;
+	    if (mask)
+	      mask[v+x] = (buf[4*(t+x)+maskOff] > 0);
+	  }
+      }
+
+  Pass p = newPass(Erode);
+  p.val = vol;
+  p.mask = mask;
+  p.nbr = 18;
+  p.unreached = false;
+
+  QVector<int> front, cand;
+  QVector<uchar> removed;
+  for(int ne=1; ne<=sz; ne++)
+    {
+      p.level = ne;
+      gather(p, front, ne == 1, cand);
+      if (cand.count() == 0)
+	break;
+
+      removed.resize(cand.count());
+      p.type = Erode;
+      p.list = cand.constData();
+      p.count = cand.count();
+      p.newval = removed.data();
+      run(p);
+
+      front.clear();
+      for(int i=0; i<cand.count(); i++)
+	if (removed[i])
+	  {
+	    vol[cand[i]] = 0;
+	    front << cand[i];
+	  }
+      if (front.count() == 0)
+	break;
+    }
+
+  for(int z=0; z<m_gridz; z++)
+    for(int y=0; y<m_gridy; y++)
+      {
+	int t = texel(m_gridx, m_gridy, m_ncols, m_dtexX, 0, y, z);
+	int v = (z*m_gridy + y)*m_gridx;
+	for(int x=0; x<m_gridx; x++)
+	  buf[4*(t+x)+off] = vol[v+x];
+      }
+
+  delete [] vol;
+  if (mask) delete [] mask;
+}
+
+void
+PruneEngine::erodeSlab(const Pass *p, int i0, int i1)
+{
+  int gridx = p->gridx;
+  int gridy = p->gridy;
+  int gridz = p->gridz;
+  int gxy = gridx*gridy;
+
+  for(int n=i0; n<=i1; n++)
+    {
+      int v = p->list[n];
+      int z = v/gxy;
+      int y = (v - z*gxy)/gridx;
+      int x = v - z*gxy - y*gridx;
+
+      // zero voxels among the 18 neighbours - lookups are clamped
+      int t = 0;
+      for(int k=-1; k<=1; k++)
+	for(int j=-1; j<=1; j++)
+	  for(int i=-1; i<=1; i++)
+	    {
+	      if (i!=0 && j!=0 && k!=0)
+		continue;
+	      int x1 = qBound(0, x+i, gridx-1);
+	      int y1 = qBound(0, y+j, gridy-1);
+	      int z1 = qBound(0, z+k, gridz-1);
+	      t += (p->val[(z1*gridy + y1)*gridx + x1] == 0);
+	    }
+      p->newval[n] = (t > 1);
+    }
+}
@@ -0,0 +1,144 @@
+#ifndef PRUNEENGINE_H
+#define PRUNEENGINE_H
+
+#include <QtGlobal>
+#include <QVector>
+
+//---------------------------------------
+// cpu version of the morphological operations done by PruneHandler.
+// works in place on the packed BGRA prune buffer (as returned by
+// PruneHandler::getPruneBuffer) laid out as a 2D atlas of z slices.
+// results are the same as those of the shader passes.  every
+// operation advances a wavefront one level per shader pass and
+// only visits the voxels that the pass can change:
+//   distance transform counts the steps to the 18 (city block) or
+//     26 (chessboard) neighbours up to the size,
+//   dilate and thicken add the voxels next to the current ones,
+//   erode and shrink apply the 18 neighbour shader rule to the
+//     voxels next to the ones removed by the previous pass.
+// channels are numbered as in the shaders - 0 is red.  the voxels
+// of a pass, and slabs of slices, are split among threads.
+//---------------------------------------
+class PruneEngine
+{
+ public :
+  PruneEngine();
+  ~PruneEngine();
+
+  void clear();
+
+  // gridx, gridy, gridz, ncols of the tiles
+  // and width, height of the atlas
+  void setGrid(int, int, int, int, int, int);
+
+  void invert(uchar*, int chan=-1);
+  void dilate(uchar*, int, int);
+  void erode(uchar*, int, int);
+  void open(uchar*, int, int);
+  void close(uchar*, int, int);
+  void shrink(uchar*, int, int);
+  void thicken(uchar*, int, bool cityBlock=true);
+  void distanceTransform(uchar*, int, bool cityBlock=true);
+
+  // shape based interpolation of channel 0 between
+  // two buffers - other channels are blended linearly
+  void interpolate(const uchar*, const uchar*, float, uchar*);
+
+ private :
+  enum PassType
+  {
+    Seed,
+    AlongX,
+    AlongY,
+    AlongZ,
+    Wave,
+    Distance,
+    Accumulate,
+    Blend,
+    Erode,
+    Border,
+    Scatter,
+    Collect
+  };
+
+  struct Pass
+  {
+    int type;
+    int gridx, gridy, gridz, ncols, dtexX;
+
+    // byte offset of the channel within a texel
+    int off;
+    // seeds are voxels with non-zero values
+    bool seedNonZero;
+    int sz;
+
+    const uchar *src;
+    uchar *buf;
+    int *dist;
+    int *feat;
+
+    // shape interpolation
+    float wt, frc;
+    float *acc;
+    uchar *val;
+
+    // erode and shrink - voxels in the mask are left alone
+    const uchar *mask;
+
+    // wavefront - values of the voxels in list are pulled from
+    // neighbours reached before level, less dec.  erode sets
+    // newval for the voxels in list that are removed
+    const int *list;
+    int count;
+    int level, dec, nbr;
+    uchar *newval;
+
+    // gathering the voxels of the next level - not reached yet
+    // (unreached) or non-zero in val.  bucket[j*nslab+s] holds the
+    // voxels of slab s found by job j, found[s] those accepted
+    bool unreached;
+    int nslab, slabSize;
+    QVector<int> *bucket;
+    QVector<int> *found;
+  };
+
+  struct PassJob
+  {
+    const Pass *pass;
+    int i0, i1;
+  };
+
+  int m_gridx, m_gridy, m_gridz, m_ncols;
+  int m_dtexX, m_dtexY;
+  int m_nvox;
+
+  // squared euclidean or chamfer distance to the nearest seed, or
+  // wavefront level, and texel index of the nearest seed, per voxel
+  int *m_dist;
+  int *m_feat;
+
+  Pass newPass(int);
+  void run(Pass&);
+  void distanceField(const uchar*, int, bool, bool);
+  void gather(Pass&, const QVector<int>&, bool, QVector<int>&);
+  void wave(uchar*, int, int, int, int);
+  void iterate(uchar*, int, int, int);
+
+  static int offset(int);
+  static int neighbours(int, int*, int*, int*);
+  static void runSlab(PassJob&);
+  static void envelope(int, const int*, const int*,
+		       int*, int*, int*, int*);
+  static void seed(const Pass*, int, int);
+  static void alongX(const Pass*, int, int);
+  static void alongY(const Pass*, int, int);
+  static void alongZ(const Pass*, int, int);
+  static void apply(const Pass*, int, int);
+  static void waveSlab(const Pass*, int, int);
+  static void erodeSlab(const Pass*, int, int);
+  static void border(const Pass*, int);
+  static void scatter(const Pass*, int);
+  static void collect(const Pass*, int);
+};
+
+#endif
@@ -21,6 +21,9 @@ uchar* PruneHandler::m_lut=0;
 bool PruneHandler::m_useSavedBuffer = false;
 bool PruneHandler::m_mopActive = false;
 
+bool PruneHandler::m_cpuMop = false;
+PruneEngine* PruneHandler::m_pruneEngine = 0;
+
 bool PruneHandler::m_blendActive = false;
 bool PruneHandler::m_paintActive = false;
 int  PruneHandler::m_tag = 0;
@@ -100,6 +103,9 @@ GLuint PruneHandler::texture() { return m_pruneBuffer->texture(); }
 void PruneHandler::setUseSavedBuffer(bool b) { m_useSavedBuffer = b; }
 bool PruneHandler::useSavedBuffer() { return m_useSavedBuffer; }
 
+void PruneHandler::setCpuMop(bool b) { m_cpuMop = b; }
+bool PruneHandler::cpuMop() { return m_cpuMop; }
+
 int PruneHandler::m_dtexX = 0;
 int PruneHandler::m_dtexY = 0;
 Vec PruneHandler::m_dragInfo;
@@ -150,6 +156,9 @@ void PruneHandler::clean()
   m_savedPruneBuffer = 0;
   m_lutTex = 0;
 
+  if (m_pruneEngine) delete m_pruneEngine;
+  m_pruneEngine = 0;
+
   m_clipShader = 0;
   m_cropShader = 0;
   m_pruneShader = 0;
@@ -186,6 +195,23 @@ void PruneHandler::clean()
     fbo2 = tpb;					\
   }
 
+PruneEngine*
+PruneHandler::pruneEngine()
+{
+  int ncols = m_dragInfo.x;
+  int nrows = m_dragInfo.y;
+  int lod = m_dragInfo.z;
+  int gridx = m_dtexX/ncols;
+  int gridy = m_dtexY/nrows;
+  int gridz = m_subVolSize.z/lod;
+
+  if (!m_pruneEngine)
+    m_pruneEngine = new PruneEngine();
+  m_pruneEngine->setGrid(gridx, gridy, gridz, ncols,
+			 m_dtexX, m_dtexY);
+  return m_pruneEngine;
+}
+
 QGLFramebufferObject*
 PruneHandler::newFBO()
 {
@@ -1757,6 +1783,14 @@ PruneHandler::invert(int chan)
   if (!standardChecks()) return;
   m_mopActive = true;
 
+  if (m_cpuMop)
+    {
+      QByteArray pb = getPruneBuffer();
+      pruneEngine()->invert((uchar*)pb.data(), chan);
+      setPruneBuffer(pb);
+      return;
+    }
+
   QGLFramebufferObject *pruneBuffer1 = newFBO();
 
   QVariantList vlist;
@@ -1823,6 +1857,14 @@ PruneHandler::dilate(int sz, int chan)
   if (!standardChecks()) return;
   m_mopActive = true;
 
+  if (m_cpuMop)
+    {
+      QByteArray pb = getPruneBuffer();
+      pruneEngine()->dilate((uchar*)pb.data(), sz, chan);
+      setPruneBuffer(pb);
+      return;
+    }
+
   QGLFramebufferObject *pruneBuffer1 = newFBO();
 
   DILATE(sz, chan)
@@ -1836,6 +1878,14 @@ PruneHandler::erode(int sz, int chan)
   if (!standardChecks()) return;
   m_mopActive = true;
 
+  if (m_cpuMop)
+    {
+      QByteArray pb = getPruneBuffer();
+      pruneEngine()->erode((uchar*)pb.data(), sz, chan);
+      setPruneBuffer(pb);
+      return;
+    }
+
   QGLFramebufferObject *pruneBuffer1 = newFBO();
 
   ERODE(sz, chan)
@@ -1849,6 +1899,14 @@ PruneHandler::shrink(int sz, int chan)
   if (!standardChecks()) return;
   m_mopActive = true;
 
+  if (m_cpuMop)
+    {
+      QByteArray pb = getPruneBuffer();
+      pruneEngine()->shrink((uchar*)pb.data(), sz, chan);
+      setPruneBuffer(pb);
+      return;
+    }
+
   QGLFramebufferObject *pruneBuffer1 = newFBO();
 
   QVariantList vlist;
@@ -1873,6 +1931,14 @@ PruneHandler::open(int sz, int chan)
   if (!standardChecks()) return;
   m_mopActive = true;
 
+  if (m_cpuMop)
+    {
+      QByteArray pb = getPruneBuffer();
+      pruneEngine()->open((uchar*)pb.data(), sz, chan);
+      setPruneBuffer(pb);
+      return;
+    }
+
   QGLFramebufferObject *pruneBuffer1 = newFBO();
 
   ERODE(sz, chan)
@@ -1887,6 +1953,14 @@ PruneHandler::close(int sz, int chan)
   if (!standardChecks()) return;
   m_mopActive = true;
 
+  if (m_cpuMop)
+    {
+      QByteArray pb = getPruneBuffer();
+      pruneEngine()->close((uchar*)pb.data(), sz, chan);
+      setPruneBuffer(pb);
+      return;
+    }
+
   QGLFramebufferObject *pruneBuffer1 = newFBO();
 
   DILATE(sz, chan)
@@ -1901,6 +1975,14 @@ PruneHandler::thicken(int sz, bool cityBlock)
   if (!standardChecks()) return;
   m_mopActive = true;
 
+  if (m_cpuMop)
+    {
+      QByteArray pb = getPruneBuffer();
+      pruneEngine()->thicken((uchar*)pb.data(), sz, cityBlock);
+      setPruneBuffer(pb);
+      return;
+    }
+
   QProgressDialog progress("Thicken",
 			   QString(),
 			   0, 100,
@@ -2021,6 +2103,14 @@ PruneHandler::distanceTransform(int sz,  bool cityBlock)
 
   if (sz < 1) return;
 
+  if (m_cpuMop)
+    {
+      QByteArray pb = getPruneBuffer();
+      pruneEngine()->distanceTransform((uchar*)pb.data(), sz, cityBlock);
+      setPruneBuffer(pb);
+      return;
+    }
+
   QString cbstr;
   if (cityBlock) cbstr = "city-block : ";
   else cbstr = "chess-board : ";
@@ -2425,8 +2515,9 @@ PruneHandler::interpolate(QByteArray cpb1, QByteArray cpb2, float frc)
       return pb;
     }
 
-  QByteArray pb1 = qUncompress(cpb1);
-  QByteArray pb2 = qUncompress(cpb2);
+  // keyframes hold uncompressed buffers - see getPruneBuffer
+  const QByteArray pb1 = cpb1;
+  const QByteArray pb2 = cpb2;
   
   if (pb1.count() != pb2.count())
     {
@@ -2434,15 +2525,23 @@ PruneHandler::interpolate(QByteArray cpb1, QByteArray cpb2, float frc)
       return pb;
     }
 
-  uchar *tmp = new uchar[pb1.count()];
-  for (int i=0; i<pb1.count(); i++)
-    tmp[i] = (1.0f-frc)*(uchar)pb1[i] + frc*(uchar)pb2[i];
-
-  pb = QByteArray((char*)tmp, pb1.count());
-  QByteArray cpb = qCompress(pb, 0); // no compression
+  pb.resize(pb1.count());
+  if (pb1.count() == 4*m_dtexX*m_dtexY)
+    {
+      // mask shapes are interpolated - no gl needed
+      pruneEngine()->interpolate((const uchar*)pb1.constData(),
+				 (const uchar*)pb2.constData(),
+				 frc,
+				 (uchar*)pb.data());
+    }
+  else
+    {
+      uchar *tmp = (uchar*)pb.data();
+      for (int i=0; i<pb1.count(); i++)
+	tmp[i] = (1.0f-frc)*(uchar)pb1[i] + frc*(uchar)pb2[i];
+    }
 
-  delete [] tmp;
-  return cpb;
+  return pb;
 }
 
 void
@@ -9,6 +9,8 @@ using namespace qglviewer;
 #include <QGLWidget>
 #include <QGLFramebufferObject>
 
+#include "pruneengine.h"
+
 class PruneHandler
 {
   public :
@@ -145,6 +147,11 @@ class PruneHandler
 
     static void pattern(bool, int, int, int, int, int, int);
 
+    // run invert, dilate, erode, open, close, shrink, thicken
+    // and distance transform with the cpu prune engine
+    static void setCpuMop(bool);
+    static bool cpuMop();
+
   private :
     static bool m_mopActive;
 
@@ -171,6 +178,9 @@ class PruneHandler
 
     static bool m_useSavedBuffer;
 
+    static bool m_cpuMop;
+    static PruneEngine *m_pruneEngine;
+
     static GLuint m_lutTex;
 
     static GLhandleARB m_pruneShader;
@@ -250,6 +260,8 @@ class PruneHandler
     static bool standardChecks();
     static void genBuffer(int, int);
 
+    static PruneEngine* pruneEngine();
+
 };
 
 #endif
@@ -0,0 +1,140 @@
+#include "slabloader.h"
+#include "volume.h"
+
+#include <QElapsedTimer>
+
+SlabLoader::SlabLoader(QObject *parent) : QThread(parent)
+{
+  m_abort = false;
+  m_volume = 0;
+  m_slabs.clear();
+  m_slabBytes = 0;
+  m_prepareTime = 0;
+  m_waitTime = 0;
+}
+
+SlabLoader::~SlabLoader()
+{
+  finish();
+}
+
+void
+SlabLoader::clearBuffers()
+{
+  // buffers may have been swapped by the timestep cache,
+  // so free whatever is currently held
+  QList<uchar*> bufs = m_freeBuffers;
+  bufs += m_readyBuffers;
+  for(int i=0; i<bufs.count(); i++)
+    delete [] bufs[i];
+
+  m_freeBuffers.clear();
+  m_readyBuffers.clear();
+  m_readyOk.clear();
+}
+
+void
+SlabLoader::load(Volume *vol, QList<Vec> slabs,
+		 int slabBytes, int ahead)
+{
+  finish();
+
+  m_abort = false;
+  m_volume = vol;
+  m_slabs = slabs;
+  m_slabBytes = slabBytes;
+  m_prepareTime = 0;
+  m_waitTime = 0;
+
+  // one buffer being uploaded plus the ones prepared ahead
+  int nbuf = qMin(qMax(1, ahead)+1, m_slabs.count());
+  for(int i=0; i<nbuf; i++)
+    {
+      uchar *buf = new uchar[m_slabBytes];
+      m_freeBuffers.append(buf);
+    }
+
+  start();
+}
+
+void
+SlabLoader::run()
+{
+  for(int i=0; i<m_slabs.count(); i++)
+    {
+      m_mutex.lock();
+      while (!m_abort && m_freeBuffers.count() == 0)
+	m_free.wait(&m_mutex);
+      if (m_abort)
+	{
+	  m_mutex.unlock();
+	  return;
+	}
+      uchar *buf = m_freeBuffers.takeFirst();
+      m_mutex.unlock();
+
+      QElapsedTimer timer;
+      timer.start();
+      bool ok = m_volume->prepareSliceTextureSlab(m_slabs[i].y,
+						  m_slabs[i].z,
+						  buf);
+      qint64 t = timer.nsecsElapsed();
+
+      m_mutex.lock();
+      m_prepareTime += t;
+      m_readyBuffers.append(buf);
+      m_readyOk.append(ok);
+      m_ready.wakeOne();
+      m_mutex.unlock();
+    }
+}
+
+uchar*
+SlabLoader::takeSlab(bool &ok)
+{
+  QElapsedTimer timer;
+  timer.start();
+
+  QMutexLocker locker(&m_mutex);
+  while (m_readyBuffers.count() == 0)
+    {
+      if (isFinished())
+	{
+	  ok = false;
+	  return 0;
+	}
+      m_ready.wait(&m_mutex, 100);
+    }
+
+  m_waitTime += timer.nsecsElapsed();
+
+  ok = m_readyOk.takeFirst();
+  return m_readyBuffers.takeFirst();
+}
+
+void
+SlabLoader::giveBack(uchar *buf)
+{
+  if (!buf)
+    return;
+
+  QMutexLocker locker(&m_mutex);
+  m_freeBuffers.append(buf);
+  m_free.wakeOne();
+}
+
+void
+SlabLoader::finish()
+{
+  m_mutex.lock();
+  m_abort = true;
+  m_free.wakeOne();
+  m_mutex.unlock();
+
+  wait();
+
+  clearBuffers();
+}
+
+float SlabLoader::prepareTime() { return m_prepareTime/1000000.0; }
+float SlabLoader::waitTime() { return m_waitTime/1000000.0; }
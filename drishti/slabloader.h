@@ -0,0 +1,66 @@
+#ifndef SLABLOADER_H
+#define SLABLOADER_H
+
+#include <QMutex>
+#include <QThread>
+#include <QWaitCondition>
+
+#include <QGLViewer/vec.h>
+using namespace qglviewer;
+
+class Volume;
+
+//---------------------------------------
+// prepares slice texture slabs ahead of the gl thread.
+// slabs are read, subsampled and packed in order into a small
+// ring of buffers, the gl thread takes them one at a time and
+// hands the buffer back once it has been uploaded.
+//---------------------------------------
+class SlabLoader : public QThread
+{
+  Q_OBJECT
+
+ public :
+  SlabLoader(QObject *parent=0);
+  ~SlabLoader();
+
+  // volume, (-, minz, maxz) for each slab, bytes per slab,
+  // number of slabs that may be prepared ahead
+  void load(Volume*, QList<Vec>, int, int);
+
+  // blocks till the next slab is ready, ok is false
+  // if the slab did not fit the texture layout
+  uchar* takeSlab(bool&);
+  void giveBack(uchar*);
+
+  // waits for the loader and releases buffers
+  void finish();
+
+  // time spent preparing slabs and waiting for them (ms)
+  float prepareTime();
+  float waitTime();
+
+ protected :
+  void run();
+
+ private :
+  QMutex m_mutex;
+  QWaitCondition m_ready;
+  QWaitCondition m_free;
+  bool m_abort;
+
+  Volume *m_volume;
+  QList<Vec> m_slabs;
+  int m_slabBytes;
+
+  QList<uchar*> m_freeBuffers;
+  QList<uchar*> m_readyBuffers;
+  QList<bool> m_readyOk;
+
+  qint64 m_prepareTime;
+  qint64 m_waitTime;
+
+  void clearBuffers();
+};
+
+#endif
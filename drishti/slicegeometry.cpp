@@ -0,0 +1,364 @@
+#include "slicegeometry.h"
+#include "staticfunctions.h"
+
+#include <math.h>
+#include <QThread>
+#include <QtConcurrentMap>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// slices handled together by one job
+static const int sliceChunk = 64;
+
+SliceGeometry::SliceGeometry()
+{
+  m_arena = 0;
+  m_capacity = 0;
+  m_count = 0;
+}
+
+SliceGeometry::~SliceGeometry()
+{
+  clear();
+}
+
+void
+SliceGeometry::clear()
+{
+  if (m_arena)
+    delete [] m_arena;
+  m_arena = 0;
+  m_capacity = 0;
+  m_count = 0;
+}
+
+void SliceGeometry::reset() { m_count = 0; }
+int SliceGeometry::count() { return m_count; }
+ViewAlignedPolygon* SliceGeometry::polygon(int i) { return &m_arena[i]; }
+
+void
+SliceGeometry::reserve(int n)
+{
+  if (n <= m_capacity)
+    return;
+
+  int ncap = qMax(n, m_capacity + m_capacity/4);
+  ViewAlignedPolygon *arena = new ViewAlignedPolygon[ncap];
+  for(int i=0; i<m_count; i++)
+    arena[i] = m_arena[i];
+
+  if (m_arena)
+    delete [] m_arena;
+  m_arena = arena;
+  m_capacity = ncap;
+}
+
+ViewAlignedPolygon*
+SliceGeometry::append()
+{
+  reserve(m_count+1);
+  ViewAlignedPolygon *vap = &m_arena[m_count];
+  vap->edges = 0;
+  m_count++;
+  return vap;
+}
+
+void
+SliceGeometry::generate(Vec poStart, Vec pnDir, Vec pn,
+			int layers,
+			int nbricks, Vec *subvol, Vec *texture,
+			QList< QList<bool> > clips,
+			QList<Vec> clipPos, QList<Vec> clipNormal,
+			int extra)
+{
+  m_count = 0;
+  if (layers <= 0 || nbricks <= 0)
+    {
+      reserve(extra);
+      return;
+    }
+
+  reserve(layers*nbricks + extra);
+  m_count = layers*nbricks;
+
+  // split each brick into pieces so that a single brick
+  // still keeps all threads busy
+  int nthreads = qMax(1, QThread::idealThreadCount());
+  int pieces = qMax(1, (2*nthreads + nbricks-1)/nbricks);
+  int nslc = qMax(sliceChunk, (layers+pieces-1)/pieces);
+
+  QList<SliceJob> jobs;
+  for(int b=0; b<nbricks; b++)
+    for(int s0=0; s0<layers; s0+=nslc)
+      {
+	SliceJob job;
+	job.arena = m_arena;
+	job.nbricks = nbricks;
+	job.brick = b;
+	job.s0 = s0;
+	job.s1 = qMin(layers, s0+nslc);
+	job.poStart = poStart;
+	job.pnDir = pnDir;
+	job.pn = pn;
+	for(int j=0; j<8; j++) job.subvol[j] = subvol[8*b+j];
+	for(int j=0; j<8; j++) job.texture[j] = texture[8*b+j];
+	job.clips = clips[b];
+	job.clipPos = clipPos;
+	job.clipNormal = clipNormal;
+	jobs << job;
+      }
+
+  if (jobs.count() == 1)
+    sliceBrick(jobs[0]);
+  else
+    QtConcurrent::blockingMap(jobs, SliceGeometry::sliceBrick);
+}
+
+void
+SliceGeometry::sliceBrick(SliceJob &job)
+{
+  int sidx[] = { 0, 1,
+		 0, 3,
+		 2, 1,
+		 2, 3,
+		 4, 5,
+		 4, 7,
+		 6, 5,
+		 6, 7,
+		 0, 4,
+		 1, 5,
+		 2, 6,
+		 3, 7 };
+
+  //---------------------------------------
+  // for slice s the plane passes through poStart + (s+1)*pnDir,
+  // so the intersection parameter along an edge is A + (s+1)*B
+  float v0[36], dv[36], t0[36], dt[36];
+  float A[12], B[12];
+  bool active[12];
+  for(int e=0; e<12; e++)
+    {
+      Vec a = job.subvol[sidx[2*e]];
+      Vec b = job.subvol[sidx[2*e+1]];
+      Vec ta = job.texture[sidx[2*e]];
+      Vec tb = job.texture[sidx[2*e+1]];
+
+      float deno = job.pn*(b-a);
+      active[e] = (fabs(deno) > 0.0001);
+      if (!active[e])
+	continue;
+
+      A[e] = job.pn*(job.poStart - a)/deno;
+      B[e] = job.pn*job.pnDir/deno;
+
+      v0[3*e+0] = a.x;  dv[3*e+0] = b.x-a.x;
+      v0[3*e+1] = a.y;  dv[3*e+1] = b.y-a.y;
+      v0[3*e+2] = a.z;  dv[3*e+2] = b.z-a.z;
+      t0[3*e+0] = ta.x;  dt[3*e+0] = tb.x-ta.x;
+      t0[3*e+1] = ta.y;  dt[3*e+1] = tb.y-ta.y;
+      t0[3*e+2] = ta.z;  dt[3*e+2] = tb.z-ta.z;
+    }
+  //---------------------------------------
+
+  float *pts = new float[sliceChunk*36];
+  float *tex = new float[sliceChunk*36];
+  int cnt[sliceChunk];
+
+  for(int c0=job.s0; c0<job.s1; c0+=sliceChunk)
+    {
+      int n = qMin(sliceChunk, job.s1-c0);
+      for(int s=0; s<n; s++)
+	cnt[s] = 0;
+
+      for(int e=0; e<12; e++)
+	{
+	  if (!active[e])
+	    continue;
+
+	  // edge is not cut by any slice of this chunk
+	  float aFirst = A[e] + (c0+1)*B[e];
+	  float aLast = A[e] + (c0+n)*B[e];
+	  if ((aFirst < 0 && aLast < 0) ||
+	      (aFirst > 1 && aLast > 1))
+	    continue;
+
+	  int i = 0;
+#if defined(__SSE2__)
+	  __m128 va = _mm_set1_ps(aFirst);
+	  __m128 vb = _mm_set1_ps(B[e]);
+	  __m128 lane = _mm_set_ps(3, 2, 1, 0);
+	  __m128 zero = _mm_setzero_ps();
+	  __m128 one = _mm_set1_ps(1.0f);
+	  for(; i+4<=n; i+=4)
+	    {
+	      __m128 si = _mm_add_ps(lane, _mm_set1_ps((float)i));
+	      __m128 a = _mm_add_ps(va, _mm_mul_ps(si, vb));
+	      int mask = _mm_movemask_ps(_mm_and_ps(_mm_cmpge_ps(a, zero),
+						    _mm_cmple_ps(a, one)));
+	      if (!mask)
+		continue;
+
+	      float r[6][4];
+	      for(int c=0; c<3; c++)
+		{
+		  _mm_storeu_ps(r[c],
+				_mm_add_ps(_mm_set1_ps(v0[3*e+c]),
+					   _mm_mul_ps(_mm_set1_ps(dv[3*e+c]), a)));
+		  _mm_storeu_ps(r[3+c],
+				_mm_add_ps(_mm_set1_ps(t0[3*e+c]),
+					   _mm_mul_ps(_mm_set1_ps(dt[3*e+c]), a)));
+		}
+
+	      for(int l=0; l<4; l++)
+		if (mask & (1<<l))
+		  {
+		    int s = i+l;
+		    float *p = pts + 36*s + 3*cnt[s];
+		    float *t = tex + 36*s + 3*cnt[s];
+		    p[0] = r[0][l];  p[1] = r[1][l];  p[2] = r[2][l];
+		    t[0] = r[3][l];  t[1] = r[4][l];  t[2] = r[5][l];
+		    cnt[s]++;
+		  }
+	    }
+#endif
+	  for(; i<n; i++)
+	    {
+	      float a = aFirst + i*B[e];
+	      if (a >= 0 && a <= 1)
+		{
+		  float *p = pts + 36*i + 3*cnt[i];
+		  float *t = tex + 36*i + 3*cnt[i];
+		  for(int c=0; c<3; c++)
+		    {
+		      p[c] = v0[3*e+c] + dv[3*e+c]*a;
+		      t[c] = t0[3*e+c] + dt[3*e+c]*a;
+		    }
+		  cnt[i]++;
+		}
+	    }
+	}
+
+      for(int s=0; s<n; s++)
+	finishPolygon(cnt[s], pts + 36*s, tex + 36*s,
+		      job,
+		      job.arena + (c0+s)*job.nbricks + job.brick);
+    }
+
+  delete [] pts;
+  delete [] tex;
+}
+
+//---------------------------------------
+// order the intersection points around their centre and apply
+// the clip planes, the same way DrawHiresVolume::drawpoly does
+//---------------------------------------
+void
+SliceGeometry::finishPolygon(int edges, float *pts, float *tex,
+			     SliceJob &job,
+			     ViewAlignedPolygon *vap)
+{
+  vap->edges = 0;
+  if (edges < 3)
+    return;
+
+  int i;
+  float cen[3] = { 0, 0, 0 };
+  for(i=0; i<edges; i++)
+    {
+      cen[0] += pts[3*i+0];
+      cen[1] += pts[3*i+1];
+      cen[2] += pts[3*i+2];
+    }
+  cen[0] /= edges;
+  cen[1] /= edges;
+  cen[2] /= edges;
+
+  Vec c(cen[0], cen[1], cen[2]);
+  Vec vaxis = Vec(pts[0], pts[1], pts[2]) - c;
+  vaxis.normalize();
+
+  Vec vperp = vaxis^(Vec(pts[3], pts[4], pts[5]) - c);
+  vperp = vperp^vaxis;
+  vperp.normalize();
+
+  float angle[12];
+  angle[0] = 1;
+  for(i=1; i<edges; i++)
+    {
+      Vec v = Vec(pts[3*i], pts[3*i+1], pts[3*i+2]) - c;
+      v.normalize();
+      angle[i] = vaxis*v;
+      if (vperp*v < 0)
+	angle[i] = -2 - angle[i];
+    }
+
+  // sort angle
+  int order[] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11};
+  for(i=edges-1; i>=0; i--)
+    for(int j=1; j<=i; j++)
+      {
+	if (angle[order[i]] < angle[order[j]])
+	  {
+	    int tmp = order[i];
+	    order[i] = order[j];
+	    order[j] = tmp;
+	  }
+      }
+
+  Vec *poly = vap->vertex;
+  Vec *ptex = vap->texcoord;
+  for(i=0; i<edges; i++)
+    {
+      int o = order[i];
+      poly[i] = Vec(pts[3*o], pts[3*o+1], pts[3*o+2]);
+      ptex[i] = Vec(tex[3*o], tex[3*o+1], tex[3*o+2]);
+    }
+
+  //---- apply clipping
+  for(int ci=0; ci<job.clips.count(); ci++)
+    {
+      if (!job.clips[ci])
+	continue;
+
+      Vec cpo = job.clipPos[ci];
+      Vec cpn = job.clipNormal[ci];
+
+      int tedges = 0;
+      Vec tpoly[100];
+      Vec ttex[100];
+      for(i=0; i<edges; i++)
+	{
+	  Vec v0 = poly[i];
+	  Vec t0 = ptex[i];
+	  Vec v1 = poly[(i+1)%edges];
+	  Vec t1 = ptex[(i+1)%edges];
+
+	  // clip on texture coordinates
+	  int ret = StaticFunctions::intersectType2WithTexture(cpo, cpn,
+							       t0, t1,
+							       v0, v1);
+	  if (ret)
+	    {
+	      tpoly[tedges] = v0;
+	      ttex[tedges] = t0;
+	      tedges ++;
+	      if (ret == 2)
+		{
+		  tpoly[tedges] = v1;
+		  ttex[tedges] = t1;
+		  tedges ++;
+		}
+	    }
+	}
+      edges = tedges;
+      for(i=0; i<tedges; i++)
+	poly[i] = tpoly[i];
+      for(i=0; i<tedges; i++)
+	ptex[i] = ttex[i];
+    }
+  //---- clipping applied
+
+  vap->edges = edges;
+}
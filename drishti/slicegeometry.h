@@ -0,0 +1,65 @@
+#ifndef SLICEGEOMETRY_H
+#define SLICEGEOMETRY_H
+
+#include <QList>
+
+#include "classes.h"
+
+//---------------------------------------
+// view aligned slice polygons for all bricks of a frame.
+// polygons live in an arena that is reused from frame to frame,
+// polygon s*nbricks + b is slice s through brick b.
+// plane/edge intersections are evaluated for several slices at
+// once (the intersection parameter is linear in the slice number)
+// and bricks are sliced in parallel in chunks of slices.
+//---------------------------------------
+class SliceGeometry
+{
+ public :
+  SliceGeometry();
+  ~SliceGeometry();
+
+  void clear();
+  void reset();
+
+  int count();
+  ViewAlignedPolygon* polygon(int);
+
+  // poStart, step between slices, slicing normal, layers,
+  // number of bricks, 8 corners and texture coordinates per brick,
+  // per brick clip flags, clip positions and scaled clip normals,
+  // extra slots to keep for append()
+  void generate(Vec, Vec, Vec, int,
+		int, Vec*, Vec*,
+		QList< QList<bool> >,
+		QList<Vec>, QList<Vec>,
+		int extra=0);
+
+  // next free polygon after the generated slices
+  ViewAlignedPolygon* append();
+
+ private :
+  struct SliceJob
+  {
+    ViewAlignedPolygon *arena;
+    int nbricks, brick;
+    int s0, s1;
+    Vec poStart, pnDir, pn;
+    Vec subvol[8], texture[8];
+    QList<bool> clips;
+    QList<Vec> clipPos, clipNormal;
+  };
+
+  ViewAlignedPolygon *m_arena;
+  int m_capacity;
+  int m_count;
+
+  void reserve(int);
+
+  static void sliceBrick(SliceJob&);
+  static void finishPolygon(int, float*, float*,
+			    SliceJob&,
+			    ViewAlignedPolygon*);
+};
+
+#endif
@@ -1031,6 +1031,58 @@ StaticFunctions::getClip(Vec po,
   return ok;
 }
 
+// range x0-x1 of voxels (x, y, z), minx<=x<=maxx, that are
+// not clipped - same result as calling getClip for every voxel.
+// returns false when the whole row is clipped
+bool
+StaticFunctions::getClipSpan(int y, int z,
+			     int minx, int maxx,
+			     Vec voxelScaling,
+			     QList<Vec> clipPos,
+			     QList<Vec> clipNormal,
+			     int &x0, int &x1)
+{
+  x0 = minx;
+  x1 = maxx;
+  for(int ci=0; ci<clipPos.size(); ci++)
+    {
+      Vec cpo = clipPos[ci];
+      Vec cpn = clipNormal[ci];
+
+      // plane distance is linear along the row : a + b*x
+      Vec p0 = VECPRODUCT(Vec(0, y, z), voxelScaling);
+      double a = (p0-cpo)*cpn;
+      double b = voxelScaling.x*cpn.x;
+      if (qAbs(b) < 1e-12)
+	{
+	  if (a > 0)
+	    return false;
+	  continue;
+	}
+
+      double xc = qBound((double)minx-2, -a/b, (double)maxx+2);
+      if (b > 0)
+	{
+	  x1 = qMin(x1, (int)floor(xc)+1);
+	  while (x1 >= x0 &&
+		 (VECPRODUCT(Vec(x1, y, z), voxelScaling)-cpo)*cpn > 0)
+	    x1--;
+	}
+      else
+	{
+	  x0 = qMax(x0, (int)ceil(xc)-1);
+	  while (x0 <= x1 &&
+		 (VECPRODUCT(Vec(x0, y, z), voxelScaling)-cpo)*cpn > 0)
+	    x0++;
+	}
+
+      if (x0 > x1)
+	return false;
+    }
+
+  return true;
+}
+
 QSize
 StaticFunctions::getImageSize(int width, int height)
 {
@@ -86,6 +86,9 @@ class StaticFunctions
   static void generateHistograms(float*, float*, int*, int*);
 
   static bool getClip(Vec, QList<Vec>, QList<Vec>);
+  static bool getClipSpan(int, int, int, int, Vec,
+			  QList<Vec>, QList<Vec>,
+			  int&, int&);
 
   static QSize getImageSize(int, int);
 
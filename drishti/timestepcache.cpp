@@ -0,0 +1,805 @@
+#include "timestepcache.h"
+#include "staticfunctions.h"
+#include "xmlheaderfunctions.h"
+
+#include <math.h>
+
+SlabLayout::SlabLayout()
+{
+  bpv = 1;
+  subsamplingLevel = 1;
+  dataMin = Vec(0,0,0);
+  dataMax = Vec(0,0,0);
+  subvolumeSize = Vec(0,0,0);
+  maxHeight = maxWidth = maxDepth = 0;
+  texWidth = texHeight = 0;
+  texColumns = texRows = 0;
+  dragTextureInfo = Vec(0,0,0);
+  dragTexWidth = dragTexHeight = 0;
+}
+
+bool
+SlabLayout::operator==(const SlabLayout& sl) const
+{
+  return (bpv == sl.bpv &&
+	  subsamplingLevel == sl.subsamplingLevel &&
+	  (dataMin-sl.dataMin).squaredNorm() < 0.1 &&
+	  (dataMax-sl.dataMax).squaredNorm() < 0.1 &&
+	  maxHeight == sl.maxHeight &&
+	  maxWidth == sl.maxWidth &&
+	  maxDepth == sl.maxDepth &&
+	  texWidth == sl.texWidth &&
+	  texHeight == sl.texHeight &&
+	  texColumns == sl.texColumns &&
+	  texRows == sl.texRows &&
+	  (dragTextureInfo-sl.dragTextureInfo).squaredNorm() < 0.1 &&
+	  dragTexWidth == sl.dragTexWidth &&
+	  dragTexHeight == sl.dragTexHeight);
+}
+
+bool
+SlabLayout::operator!=(const SlabLayout& sl) const
+{
+  return !(*this == sl);
+}
+
+static QMutex lodFileMutex;
+QMutex* TimestepCache::lodMutex() { return &lodFileMutex; }
+
+TimestepCache::TimestepCache(QObject *parent) : QThread(parent)
+{
+  m_abort = false;
+  m_generation.store(0);
+
+  m_prefetch = 0;
+  m_memoryLimit = (qint64)512*1024*1024;
+  m_usedBytes = 0;
+
+  m_volumeFiles.clear();
+  m_voxelType = 0;
+
+  m_slabs.clear();
+  m_lodSlabSize = 0;
+  m_tempDir.clear();
+  m_validLayout = false;
+
+  m_current = -1;
+  m_wanted.clear();
+  m_cache.clear();
+  m_freeBuffers.clear();
+
+  m_hits = m_misses = 0;
+  m_frameTimes.clear();
+}
+
+TimestepCache::~TimestepCache()
+{
+  m_mutex.lock();
+  m_abort = true;
+  m_generation.ref();
+  m_condition.wakeOne();
+  m_mutex.unlock();
+
+  wait();
+
+  clear();
+}
+
+int TimestepCache::prefetch() { return m_prefetch; }
+int TimestepCache::memoryLimit() { return m_memoryLimit/(1024*1024); }
+int TimestepCache::hits() { return m_hits; }
+int TimestepCache::misses() { return m_misses; }
+
+void
+TimestepCache::setPrefetch(int nsteps, int mb)
+{
+  QMutexLocker locker(&m_mutex);
+
+  m_prefetch = qMax(0, nsteps);
+  if (mb > 0)
+    m_memoryLimit = (qint64)mb*1024*1024;
+
+  if (m_prefetch == 0)
+    {
+      m_wanted.clear();
+      clearCache();
+      clearFreeBuffers();
+      m_generation.ref();
+    }
+
+  m_hits = m_misses = 0;
+  m_frameTimes.clear();
+  m_frameTimer.invalidate();
+}
+
+void
+TimestepCache::setVolumeFiles(QList<QString> vfiles, int voxelType)
+{
+  QMutexLocker locker(&m_mutex);
+
+  m_volumeFiles = vfiles;
+  m_voxelType = voxelType;
+
+  m_current = -1;
+  m_wanted.clear();
+  clearCache();
+  clearFreeBuffers();
+  m_validLayout = false;
+  m_generation.ref();
+}
+
+void
+TimestepCache::setLayout(SlabLayout layout,
+			 QList<Vec> slabs,
+			 int lodSlabSize,
+			 QString tempDir)
+{
+  QMutexLocker locker(&m_mutex);
+
+  bool same = (m_validLayout &&
+	       m_layout == layout &&
+	       m_slabs.count() == slabs.count() &&
+	       m_lodSlabSize == lodSlabSize &&
+	       m_tempDir == tempDir);
+  for(int i=0; same && i<slabs.count(); i++)
+    same = ((int)m_slabs[i].y == (int)slabs[i].y &&
+	    (int)m_slabs[i].z == (int)slabs[i].z);
+  if (same)
+    return;
+
+  // all prepared slabs are invalid for the new subvolume
+  clearCache();
+  clearFreeBuffers();
+
+  m_layout = layout;
+  m_slabs = slabs;
+  m_lodSlabSize = lodSlabSize;
+  m_tempDir = tempDir;
+  m_validLayout = true;
+  m_generation.ref();
+}
+
+void
+TimestepCache::requestTimesteps(int current, QList<int> vnums)
+{
+  QMutexLocker locker(&m_mutex);
+
+  if (m_prefetch <= 0 || !m_validLayout)
+    return;
+
+  m_current = current;
+  m_wanted = vnums;
+
+  // evict timesteps that are not going to be played next
+  QList<int> keys = m_cache.keys();
+  for(int i=0; i<keys.count(); i++)
+    {
+      if (keys[i] != m_current &&
+	  !m_wanted.contains(keys[i]))
+	{
+	  TimestepSlabs *ts = m_cache.take(keys[i]);
+	  m_usedBytes -= ts->bytes;
+	  deleteTimestep(ts);
+	}
+    }
+
+  if (!isRunning())
+    start(QThread::LowPriority);
+  else
+    m_condition.wakeOne();
+}
+
+void
+TimestepCache::clear()
+{
+  QMutexLocker locker(&m_mutex);
+
+  m_wanted.clear();
+  clearCache();
+  clearFreeBuffers();
+  m_generation.ref();
+}
+
+void
+TimestepCache::clearCache()
+{
+  QList<int> keys = m_cache.keys();
+  for(int i=0; i<keys.count(); i++)
+    deleteTimestep(m_cache[keys[i]]);
+  m_cache.clear();
+  m_usedBytes = 0;
+}
+
+void
+TimestepCache::clearFreeBuffers()
+{
+  for(int i=0; i<m_freeBuffers.count(); i++)
+    delete [] m_freeBuffers[i];
+  m_freeBuffers.clear();
+}
+
+void
+TimestepCache::deleteTimestep(TimestepSlabs *ts)
+{
+  if (!ts)
+    return;
+
+  for(int i=0; i<ts->slab.count(); i++)
+    {
+      if (ts->slab[i]) delete [] ts->slab[i];
+      if (ts->hist1D[i]) delete [] ts->hist1D[i];
+      if (ts->hist2D[i]) delete [] ts->hist2D[i];
+    }
+  if (ts->dragTexture) delete [] ts->dragTexture;
+
+  delete ts;
+}
+
+qint64
+TimestepCache::slabBytes()
+{
+  qint64 texBytes = m_layout.bpv;
+  texBytes *= m_layout.texWidth;
+  texBytes *= m_layout.texHeight;
+
+  return texBytes + 4*(256 + 256*256);
+}
+
+qint64
+TimestepCache::timestepBytes()
+{
+  qint64 dragBytes = m_layout.bpv;
+  dragBytes *= m_layout.dragTexWidth;
+  dragBytes *= m_layout.dragTexHeight;
+
+  return m_slabs.count()*slabBytes() + dragBytes;
+}
+
+bool
+TimestepCache::fetchSlab(int volnum, int minz, int maxz,
+			 uchar* &sliceTexture,
+			 uchar *dragTexture,
+			 float *hist1D, float *hist2D)
+{
+  QMutexLocker locker(&m_mutex);
+
+  if (m_prefetch <= 0 || !m_validLayout)
+    return false;
+
+  int si = -1;
+  for(int i=0; i<m_slabs.count(); i++)
+    {
+      if ((int)m_slabs[i].y == minz &&
+	  (int)m_slabs[i].z == maxz)
+	{
+	  si = i;
+	  break;
+	}
+    }
+
+  TimestepSlabs *ts = m_cache.value(volnum, 0);
+  if (si < 0 || !ts || !ts->slab[si])
+    {
+      m_misses++;
+      return false;
+    }
+
+  // hand over the prepared slab and keep the old buffer for reuse
+  uchar *old = sliceTexture;
+  sliceTexture = ts->slab[si];
+  ts->slab[si] = 0;
+  if (old)
+    {
+      if (m_freeBuffers.count() < m_slabs.count())
+	m_freeBuffers.append(old);
+      else
+	delete [] old;
+    }
+
+  memcpy(dragTexture, ts->dragTexture,
+	 m_layout.bpv*m_layout.dragTexWidth*m_layout.dragTexHeight);
+
+  for(int i=0; i<256; i++)
+    hist1D[i] += ts->hist1D[si][i];
+  for(int i=0; i<256*256; i++)
+    hist2D[i] += ts->hist2D[si][i];
+  delete [] ts->hist1D[si];
+  delete [] ts->hist2D[si];
+  ts->hist1D[si] = 0;
+  ts->hist2D[si] = 0;
+
+  ts->bytes -= slabBytes();
+  m_usedBytes -= slabBytes();
+
+  // remove timestep once all its slabs have been handed over
+  bool consumed = true;
+  for(int i=0; i<ts->slab.count(); i++)
+    if (ts->slab[i]) consumed = false;
+  if (consumed)
+    {
+      m_cache.remove(volnum);
+      m_usedBytes -= ts->bytes;
+      deleteTimestep(ts);
+    }
+
+  m_hits++;
+
+  // memory has been freed, worker can continue
+  m_condition.wakeOne();
+
+  return true;
+}
+
+void
+TimestepCache::frameShown()
+{
+  QMutexLocker locker(&m_mutex);
+
+  if (m_prefetch <= 0)
+    return;
+
+  if (!m_frameTimer.isValid())
+    {
+      m_frameTimer.start();
+      return;
+    }
+
+  m_frameTimes << m_frameTimer.restart();
+  if (m_frameTimes.count() > 20)
+    m_frameTimes.removeFirst();
+}
+
+float
+TimestepCache::framesPerSecond()
+{
+  QMutexLocker locker(&m_mutex);
+
+  if (m_frameTimes.count() == 0)
+    return 0;
+
+  qint64 total = 0;
+  for(int i=0; i<m_frameTimes.count(); i++)
+    total += m_frameTimes[i];
+
+  if (total == 0)
+    return 0;
+
+  return 1000.0f*m_frameTimes.count()/(float)total;
+}
+
+QString
+TimestepCache::statistics()
+{
+  float fps = framesPerSecond();
+
+  QMutexLocker locker(&m_mutex);
+
+  QString str;
+  str += QString("Prefetch timesteps : %1\n").arg(m_prefetch);
+  str += QString("Cache : %1 timesteps (%2 of %3 Mb)\n").\
+    arg(m_cache.count()).\
+    arg(m_usedBytes/(1024*1024)).\
+    arg(m_memoryLimit/(1024*1024));
+  str += QString("Slab hits : %1  misses : %2\n").arg(m_hits).arg(m_misses);
+  str += QString("Timestep rate : %1 fps").arg(fps, 0, 'f', 2);
+
+  return str;
+}
+
+void
+TimestepCache::run()
+{
+  forever
+    {
+      m_mutex.lock();
+
+      if (m_abort)
+	{
+	  m_mutex.unlock();
+	  return;
+	}
+
+      // pick the nearest upcoming timestep that is not ready yet
+      int volnum = -1;
+      if (m_validLayout && m_prefetch > 0)
+	{
+	  for(int i=0; i<m_wanted.count(); i++)
+	    {
+	      if (!m_cache.contains(m_wanted[i]))
+		{
+		  if (m_usedBytes + timestepBytes() <= m_memoryLimit)
+		    volnum = m_wanted[i];
+		  break;
+		}
+	    }
+	}
+
+      if (volnum < 0)
+	{
+	  m_condition.wait(&m_mutex);
+	  m_mutex.unlock();
+	  continue;
+	}
+
+      int gen = m_generation.load();
+      QString vfile = m_volumeFiles.value(volnum);
+      SlabLayout layout = m_layout;
+      QList<Vec> slabs = m_slabs;
+      int lodSlabSize = m_lodSlabSize;
+      QString tempDir = m_tempDir;
+      int voxelType = m_voxelType;
+
+      m_mutex.unlock();
+
+      TimestepSlabs *ts = prepareTimestep(vfile,
+					  layout, slabs,
+					  lodSlabSize, tempDir,
+					  voxelType, gen);
+
+      m_mutex.lock();
+      if (ts)
+	{
+	  if (!m_abort &&
+	      gen == m_generation.load() &&
+	      !m_cache.contains(volnum) &&
+	      (volnum == m_current || m_wanted.contains(volnum)))
+	    {
+	      m_cache[volnum] = ts;
+	      m_usedBytes += ts->bytes;
+	    }
+	  else
+	    deleteTimestep(ts);
+	}
+      else if (gen == m_generation.load())
+	{
+	  // timestep cannot be prepared in the background,
+	  // leave it for the render thread
+	  m_wanted.removeAll(volnum);
+	}
+      m_mutex.unlock();
+    }
+}
+
+TimestepCache::TimestepSlabs*
+TimestepCache::prepareTimestep(QString vfile,
+			       SlabLayout layout,
+			       QList<Vec> slabs,
+			       int lodSlabSize,
+			       QString tempDir,
+			       int voxelType,
+			       int gen)
+{
+  if (vfile.isEmpty() || slabs.count() == 0)
+    return 0;
+
+  int svsl = layout.subsamplingLevel;
+
+  int depth, width, height;
+  XmlHeaderFunctions::getDimensionsFromHeader(vfile,
+					      depth, width, height);
+
+  VolumeFileManager vfm;
+  if (svsl > 1)
+    {
+      // subsampled volumes are generated on the render thread,
+      // only use the ones that are already available on disk.
+      // createFile sizes the files before they are written, so
+      // skip the timestep while a lod volume is being generated
+      QString lodflnm = vfile + QString(".lod%1").arg(svsl);
+      lodflnm = StaticFunctions::replaceDirectory(tempDir, lodflnm);
+      vfm.setBaseFilename(lodflnm);
+      vfm.setDepth(depth/svsl);
+      vfm.setWidth(width/svsl);
+      vfm.setHeight(height/svsl);
+      vfm.setVoxelType(voxelType);
+      vfm.setHeaderSize(13);
+      vfm.setSlabSize(lodSlabSize);
+      if (lodSlabSize <= 0 || !lodMutex()->tryLock())
+	return 0;
+      bool available = vfm.exists();
+      lodMutex()->unlock();
+      if (!available)
+	return 0;
+    }
+  else
+    {
+      QStringList pvlnames = XmlHeaderFunctions::getPvlNamesFromHeader(vfile);
+      if (pvlnames.count() > 0)
+	vfm.setFilenameList(pvlnames);
+      vfm.setBaseFilename(vfile);
+      vfm.setDepth(depth);
+      vfm.setWidth(width);
+      vfm.setHeight(height);
+      vfm.setVoxelType(voxelType);
+      vfm.setHeaderSize(XmlHeaderFunctions::getPvlHeadersizeFromHeader(vfile));
+      vfm.setSlabSize(XmlHeaderFunctions::getSlabsizeFromHeader(vfile));
+    }
+
+  qint64 texBytes = layout.bpv;
+  texBytes *= layout.texWidth;
+  texBytes *= layout.texHeight;
+
+  qint64 dragBytes = layout.bpv;
+  dragBytes *= layout.dragTexWidth;
+  dragBytes *= layout.dragTexHeight;
+
+  TimestepSlabs *ts = new TimestepSlabs;
+  ts->dragTexture = new uchar[dragBytes];
+  memset(ts->dragTexture, 0, dragBytes);
+  ts->bytes = dragBytes;
+
+  for(int i=0; i<slabs.count(); i++)
+    {
+      // subvolume changed or thread is shutting down
+      if (m_abort || gen != m_generation.load())
+	{
+	  deleteTimestep(ts);
+	  return 0;
+	}
+
+      uchar *slab = 0;
+      m_mutex.lock();
+      if (gen == m_generation.load() &&
+	  m_freeBuffers.count() > 0)
+	slab = m_freeBuffers.takeLast();
+      m_mutex.unlock();
+      if (!slab)
+	slab = new uchar[texBytes];
+
+      float *h1 = new float[256];
+      float *h2 = new float[256*256];
+      memset(h1, 0, 256*4);
+      memset(h2, 0, 256*256*4);
+
+      ts->slab << slab;
+      ts->hist1D << h1;
+      ts->hist2D << h2;
+      ts->bytes += texBytes + 4*(256 + 256*256);
+
+      if (! buildSlab(layout, &vfm,
+		      depth, width, height,
+		      slabs[i].y, slabs[i].z,
+		      slab, ts->dragTexture,
+		      h1, h2))
+	{
+	  deleteTimestep(ts);
+	  return 0;
+	}
+    }
+
+  return ts;
+}
+
+bool
+TimestepCache::buildSlab(const SlabLayout &sl,
+			 VolumeFileManager *vfm,
+			 int depth, int width, int height,
+			 int minz, int maxz,
+			 uchar *sliceTexture,
+			 uchar *dragTexture,
+			 float *hist1D, float *hist2D)
+{
+  bool layoutOk = true;
+
+  int bpv = sl.bpv;
+  int svsl = sl.subsamplingLevel;
+
+  int minx = sl.dataMin.x;
+  int miny = sl.dataMin.y;
+  int lenx = sl.subvolumeSize.x;
+  int leny = sl.subvolumeSize.y;
+  int lenz = sl.subvolumeSize.z;
+  int lenx2 = lenx/svsl;
+  int leny2 = leny/svsl;
+
+  int ncols = sl.texColumns;
+  int nrows = sl.texRows;
+
+  int maxlenx2 = sl.texWidth/sl.texColumns;
+  int maxleny2 = sl.texHeight/sl.texRows;
+
+  memset(sliceTexture, 0, bpv*sl.texWidth*sl.texHeight);
+
+  uchar *g0, *g1, *g2;
+  g0 = new uchar [bpv*sl.maxWidth*sl.maxHeight];
+  g1 = new uchar [bpv*sl.maxWidth*sl.maxHeight];
+  g2 = new uchar [bpv*sl.maxWidth*sl.maxHeight];
+
+  //-------- for dragTexure ---------------
+  int dtncols = sl.dragTextureInfo.x;
+  int dtnrows = sl.dragTextureInfo.y;
+  int dtlod = sl.dragTextureInfo.z;
+  int dtlenx2 = lenx/dtlod;
+  int dtleny2 = leny/dtlod;
+  int dtlenz2 = lenz/dtlod;
+  float stp = (float)dtlod/(float)svsl;
+  int dtmaxlenx2 = sl.dragTexWidth/dtncols;
+  int dtmaxleny2 = sl.dragTexHeight/dtnrows;
+  uchar *tmp = new uchar[bpv*dtlenx2*dtleny2];
+
+  //---------------------------------------------------------
+  // slices come from the subsampled volume when svsl > 1
+  int kmin = minz/svsl;
+  int kmax = maxz/svsl;
+
+  int leni2 = height/svsl;
+  int lenj2 = width/svsl;
+  int lenk2 = depth/svsl;
+
+  int imin = minx/svsl;
+  int jmin = miny/svsl;
+
+  int kbytes = bpv*leni2*lenj2;
+
+  int offD = ((sl.maxDepth - depth)/2)/svsl;
+  int offW = ((sl.maxWidth - width)/2)/svsl;
+  int offH = ((sl.maxHeight - height)/2)/svsl;
+
+  int maxHsl = sl.maxHeight/svsl;
+  int maxWsl = sl.maxWidth/svsl;
+
+  int dtkmin = sl.dataMin.z/svsl;
+  int dtkmax = sl.dataMax.z/svsl;
+
+  uchar *sliceTemp = new uchar [bpv*sl.maxWidth*sl.maxHeight];
+  uchar *sliceTemp1 = new uchar [bpv*maxWsl*maxHsl];
+
+  int kslc = 0;
+
+  // additional slice at the top and bottom
+  for(int k0=kmin-1; k0<=kmax+1; k0++)
+    {
+      int k = k0 - offD; // shift slice by given depth offset
+
+      if (k >= 0 && k < lenk2)
+	{
+	  uchar *vslice = vfm->getSlice(k);
+	  memcpy(sliceTemp, vslice, kbytes);
+	}
+      else
+	memset(sliceTemp, 0, kbytes);
+
+      //---
+      memset(sliceTemp1, 0, bpv*maxWsl*maxHsl);
+      for(int j=0; j<lenj2; j++)
+	memcpy(sliceTemp1 + bpv*((j+offW)*maxHsl + offH),
+	       sliceTemp + bpv*j*leni2,
+	       bpv*leni2);
+
+      for(int j=0; j<leny2; j++)
+	memcpy(sliceTemp + bpv*j*lenx2,
+	       sliceTemp1 + bpv*((j+jmin)*maxHsl + imin),
+	       bpv*lenx2);
+
+      int col = (k0-kmin+1)%ncols;
+      int row = (k0-kmin+1)/ncols;
+      if (row == nrows && col > 0)
+	layoutOk = false;
+      else
+	{
+	  int grow = row*maxleny2;
+	  for(int j=0; j<leny2; j++)
+	    memcpy(sliceTexture + bpv*(col*maxlenx2 +
+				       (grow+j)*sl.texWidth),
+		   sliceTemp + bpv*j*lenx2,
+		   bpv*lenx2);
+	}
+      //---
+
+      memcpy(g2, sliceTemp, bpv*lenx2*leny2);
+
+      //-------- form dragTexure ---------------
+      if (k >= dtkmin && k <= dtkmax)
+	{
+	  int ji=0;
+	  if (bpv == 1)
+	    {
+	      for(int j=0; j<dtleny2; j++)
+		{
+		  int y = j*stp;
+		  for(int i=0; i<dtlenx2; i++)
+		    {
+		      int x = i*stp;
+		      tmp[ji] = g2[y*lenx2+x];
+		      ji++;
+		    }
+		}
+	    }
+	  else
+	    {
+	      for(int j=0; j<dtleny2; j++)
+		{
+		  int y = j*stp;
+		  for(int i=0; i<dtlenx2; i++)
+		    {
+		      int x = i*stp;
+		      ((ushort*)tmp)[ji] = ((ushort*)g2)[y*lenx2+x];
+		      ji++;
+		    }
+		}
+	    }
+
+	  int dtkslc;
+	  if (svsl > 1)
+	    dtkslc = qBound(0,
+			    (int)((k0-(sl.dataMin.z/svsl))/stp),
+			    dtlenz2-1);
+	  else
+	    dtkslc = qMin(dtlenz2-1, (int)((k0-(int)sl.dataMin.z)/stp));
+	  int col = dtkslc%dtncols;
+	  int row = dtkslc/dtncols;
+	  int grow = row*dtmaxleny2;
+	  for(int j=0; j<dtleny2; j++)
+	    memcpy(dragTexture + bpv*(col*dtmaxlenx2 +
+				      (grow+j)*sl.dragTexWidth),
+		   tmp + bpv*(j*dtlenx2),
+		   bpv*dtlenx2);
+	}
+      //---------------------------------------
+
+      if (bpv == 1)
+	{
+	  for(int j=0; j<lenx2*leny2; j++)
+	    hist1D[g2[j]]++;
+
+	  if (kslc >= 2)
+	    {
+	      for(int j=1; j<leny2-1; j++)
+		for(int i=1; i<lenx2-1; i++)
+		  {
+		    int gx = g1[j*lenx2+(i+1)] - g1[j*lenx2+(i-1)];
+		    int gy = g1[(j+1)*lenx2+i] - g1[(j-1)*lenx2+i];
+		    int gz = g2[j*lenx2+i] - g0[j*lenx2+i];
+		    int gsum = sqrtf(gx*gx+gy*gy+gz*gz);
+		    gsum = qBound(0, gsum, 255);
+		    int v = g1[j*lenx2+i];
+		    hist2D[gsum*256 + v]++;
+		  }
+	    }
+	}
+      else
+	{
+	  for(int j=0; j<lenx2*leny2; j++)
+	    hist1D[((ushort*)g2)[j]/256]++;
+
+	  if (svsl == 1)
+	    {
+	      for(int j=0; j<lenx2*leny2; j++)
+		hist2D[((ushort*)g2)[j]]++;
+	    }
+	  else if (kslc >= 2)
+	    {
+	      for(int j=1; j<leny2-1; j++)
+		for(int i=1; i<lenx2-1; i++)
+		  {
+		    int gx = ((ushort*)g1)[j*lenx2+(i+1)] -
+		             ((ushort*)g1)[j*lenx2+(i-1)];
+		    int gy = ((ushort*)g1)[(j+1)*lenx2+i] -
+		             ((ushort*)g1)[(j-1)*lenx2+i];
+		    int gz = ((ushort*)g2)[j*lenx2+i] -
+		             ((ushort*)g0)[j*lenx2+i];
+		    int gsum = sqrtf(gx*gx+gy*gy+gz*gz);
+		    gsum = qBound(0, gsum/256, 255);
+		    int v = ((ushort*)g1)[j*lenx2+i]/256;
+		    hist2D[gsum*256 + v]++;
+		  }
+	    }
+	}
+
+      uchar *gt = g0;
+      g0 = g1;
+      g1 = g2;
+      g2 = gt;
+
+      kslc ++;
+    }
+
+  delete [] g0;
+  delete [] g1;
+  delete [] g2;
+  delete [] tmp;
+  delete [] sliceTemp;
+  delete [] sliceTemp1;
+
+  return layoutOk;
+}
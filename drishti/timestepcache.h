@@ -0,0 +1,135 @@
+#ifndef TIMESTEPCACHE_H
+#define TIMESTEPCACHE_H
+
+#include <QMutex>
+#include <QThread>
+#include <QWaitCondition>
+#include <QElapsedTimer>
+#include <QAtomicInt>
+#include <QMap>
+
+#include "volumefilemanager.h"
+
+#include <QGLViewer/vec.h>
+using namespace qglviewer;
+
+//---------------------------------------
+// geometry of the slice texture slabs for the current subvolume
+//---------------------------------------
+class SlabLayout
+{
+ public :
+  SlabLayout();
+
+  bool operator==(const SlabLayout&) const;
+  bool operator!=(const SlabLayout&) const;
+
+  int bpv;
+  int subsamplingLevel;
+  Vec dataMin, dataMax;
+  Vec subvolumeSize;
+  int maxHeight, maxWidth, maxDepth;
+  int texWidth, texHeight;
+  int texColumns, texRows;
+  Vec dragTextureInfo;
+  int dragTexWidth, dragTexHeight;
+};
+
+//---------------------------------------
+// prepares slice-texture slabs for upcoming timesteps
+// in the background so that playback of time-series
+// data only has to swap buffers on the render thread
+//---------------------------------------
+class TimestepCache : public QThread
+{
+  Q_OBJECT
+
+ public :
+  TimestepCache(QObject *parent=0);
+  ~TimestepCache();
+
+  // pack slices minz-maxz into the slab texture,
+  // fill drag texture and accumulate histograms.
+  // returns false if slab does not fit the texture layout
+  static bool buildSlab(const SlabLayout&,
+			VolumeFileManager*,
+			int, int, int,
+			int, int,
+			uchar*, uchar*,
+			float*, float*);
+
+  // held by the render thread while it checks for and writes a
+  // subsampled (lod) volume, so that a partly written one is not read
+  static QMutex* lodMutex();
+
+  void setPrefetch(int, int);
+  int prefetch();
+  int memoryLimit();
+
+  void setVolumeFiles(QList<QString>, int);
+  void setLayout(SlabLayout, QList<Vec>, int, QString);
+  void requestTimesteps(int, QList<int>);
+  void clear();
+
+  bool fetchSlab(int, int, int,
+		 uchar*&, uchar*,
+		 float*, float*);
+
+  void frameShown();
+  int hits();
+  int misses();
+  float framesPerSecond();
+  QString statistics();
+
+ protected :
+  void run();
+
+ private :
+  struct TimestepSlabs
+  {
+    QList<uchar*> slab;
+    QList<float*> hist1D;
+    QList<float*> hist2D;
+    uchar *dragTexture;
+    qint64 bytes;
+  };
+
+  QMutex m_mutex;
+  QWaitCondition m_condition;
+  bool m_abort;
+  QAtomicInt m_generation;
+
+  int m_prefetch;
+  qint64 m_memoryLimit;
+  qint64 m_usedBytes;
+
+  QList<QString> m_volumeFiles;
+  int m_voxelType;
+
+  SlabLayout m_layout;
+  QList<Vec> m_slabs;
+  int m_lodSlabSize;
+  QString m_tempDir;
+  bool m_validLayout;
+
+  int m_current;
+  QList<int> m_wanted;
+  QMap<int, TimestepSlabs*> m_cache;
+  QList<uchar*> m_freeBuffers;
+
+  int m_hits, m_misses;
+  QElapsedTimer m_frameTimer;
+  QList<qint64> m_frameTimes;
+
+  qint64 slabBytes();
+  qint64 timestepBytes();
+  void deleteTimestep(TimestepSlabs*);
+  void clearCache();
+  void clearFreeBuffers();
+  TimestepSlabs* prepareTimestep(QString,
+				 SlabLayout, QList<Vec>,
+				 int, QString,
+				 int, int);
+};
+
+#endif
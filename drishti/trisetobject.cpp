@@ -5,6 +5,7 @@
 #include "ply.h"
 #include "matrix.h"
 #include "volumeinformation.h"
+#include "meshreader.h"
 
 #include <QFileDialog>
 
@@ -18,6 +19,20 @@ TrisetObject::gridSize(int &nx, int &ny, int &nz)
 
 void TrisetObject::setOpacity(float op) { m_opacity = op; }
 
+// colours are premultiplied by opacity
+static inline void
+vertexColor(uchar *c, float opacity)
+{
+  float s = opacity/255.0f;
+  glColor4f(c[0]*s, c[1]*s, c[2]*s, opacity);
+}
+
+static inline float
+vertexDepth(const float *v, Vec pn)
+{
+  return pn.x*v[0] + pn.y*v[1] + pn.z*v[2];
+}
+
 TrisetObject::TrisetObject()
 {
   QStringList ps;
@@ -78,14 +93,8 @@ TrisetObject::clear()
   m_screenDoor = false;
   m_pointSize = 5;
   m_pointStep = 1;
-  m_vertices.clear();
-  m_vcolor.clear();
-  m_drawcolor.clear();
-  m_normals.clear();
-  m_triangles.clear();
-  m_texValues.clear();
-  m_tvertices.clear();
-  m_tnormals.clear();
+  m_mesh.clear();
+  m_pn = Vec(0,0,0);
 
   if (m_scrV) delete [] m_scrV;
   if (m_scrD) delete [] m_scrD;
@@ -104,12 +113,10 @@ TrisetObject::load(QString flnm)
   return false;
 }
 
+// generic ply.c path for files MeshReader cannot read
 bool
-TrisetObject::loadPLY(QString flnm)
+TrisetObject::readPLYElements(QString flnm)
 {
-  m_position = Vec(0,0,0);
-  m_scale = Vec(1,1,1);
-
   typedef struct Vertex {
     float x,y,z;
     float r,g,b;
@@ -143,11 +150,6 @@ TrisetObject::loadPLY(QString flnm)
 
   /*** the PLY object ***/
 
-  int nverts,nfaces;
-  Vertex **vlist;
-  Face **flist;
-
-  PlyOtherProp *vert_other,*face_other;
 
   bool per_vertex_color = false;
   bool has_normals = false;
@@ -157,9 +159,12 @@ TrisetObject::loadPLY(QString flnm)
   char *elem_name;
   PlyFile *in_ply;
 
+  m_mesh.clear();
 
   /*** Read in the original PLY object ***/
   FILE *fp = fopen(flnm.toLatin1().data(), "rb");
+  if (!fp)
+    return false;
 
   in_ply  = read_ply (fp);
 
@@ -171,10 +176,6 @@ TrisetObject::loadPLY(QString flnm)
 
     if (QString("vertex") == QString(elem_name)) {
 
-      /* create a vertex list to hold all the vertices */
-      vlist = (Vertex **) malloc (sizeof (Vertex *) * elem_count);
-      nverts = elem_count;
-
       /* set up for getting vertex elements */
 
       setup_property_ply (in_ply, &vert_props[0]);
@@ -213,31 +214,53 @@ TrisetObject::loadPLY(QString flnm)
 	}
       }
 
-      vert_other = get_other_properties_ply (in_ply, 
-					     offsetof(Vertex,other_props));
+      get_other_properties_ply (in_ply, 
+				offsetof(Vertex,other_props));
 
-      /* grab all the vertex elements */
+      /* grab all the vertex elements straight into the mesh store */
+      m_mesh.resize(elem_count, has_normals, per_vertex_color);
       for (j = 0; j < elem_count; j++) {
-        vlist[j] = (Vertex *) malloc (sizeof (Vertex));
-        get_element_ply (in_ply, (void *) vlist[j]);
+	Vertex v;
+	v.r = v.g = v.b = 0;
+	v.nx = v.ny = v.nz = 0;
+	v.other_props = 0;
+        get_element_ply (in_ply, (void *) &v);
+
+	m_mesh.setVertex(j, v.x, v.y, v.z);
+	if (has_normals)
+	  m_mesh.setNormal(j, v.nx, v.ny, v.nz);
+	if (per_vertex_color)
+	  m_mesh.setColor(j,
+			  qBound(0, (int)v.r, 255),
+			  qBound(0, (int)v.g, 255),
+			  qBound(0, (int)v.b, 255));
+	if (v.other_props)
+	  free(v.other_props);
       }
     }
     else if (QString("face") == QString(elem_name)) {
 
-      /* create a list to hold all the face elements */
-      flist = (Face **) malloc (sizeof (Face *) * elem_count);
-      nfaces = elem_count;
-
       /* set up for getting face elements */
 
       setup_property_ply (in_ply, &face_props[0]);
-      face_other = get_other_properties_ply (in_ply, 
-					     offsetof(Face,other_props));
+      get_other_properties_ply (in_ply, 
+				offsetof(Face,other_props));
 
-      /* grab all the face elements */
+      /* grab all the face elements, only triangles considered */
+      QVector<uint>& triangles = m_mesh.triangles();
+      triangles.reserve(3*elem_count);
       for (j = 0; j < elem_count; j++) {
-        flist[j] = (Face *) malloc (sizeof (Face));
-        get_element_ply (in_ply, (void *) flist[j]);
+	Face f;
+	f.verts = 0;
+	f.other_props = 0;
+        get_element_ply (in_ply, (void *) &f);
+
+	if (f.nverts >= 3)
+	  triangles << f.verts[0] << f.verts[1] << f.verts[2];
+	if (f.verts)
+	  free(f.verts);
+	if (f.other_props)
+	  free(f.other_props);
       }
     }
     else
@@ -246,30 +269,50 @@ TrisetObject::loadPLY(QString flnm)
 
   close_ply (in_ply);
   free_ply (in_ply);
-  
+
+  return true;
+}
+
+bool
+TrisetObject::loadPLY(QString flnm)
+{
+  m_position = Vec(0,0,0);
+  m_scale = Vec(1,1,1);
+
+  //--------
+  // cached native copy, then the mapped parallel reader,
+  // then ply.c
+  bool loaded = MeshReader::readCache(flnm, m_mesh);
+  if (!loaded && MeshReader::readPLY(flnm, m_mesh))
+    {
+      loaded = true;
+      MeshReader::writeCache(flnm, m_mesh);
+    }
+  if (!loaded && !readPLYElements(flnm))
+    {
+      QMessageBox::critical(0, "Cannot load PLY", flnm);
+      return false;
+    }
+  //--------
+
+  int nverts = m_mesh.vertexCount();
+  if (nverts == 0)
+    {
+      QMessageBox::critical(0, "Cannot load PLY", "No vertices");
+      return false;
+    }
+
+  Vec bmin, bmax;
+  m_mesh.bounds(bmin, bmax);
+
   if (Global::volumeType() == Global::DummyVolume)
     {
-      float minX, maxX;
-      float minY, maxY;
-      float minZ, maxZ;
-      minX = maxX = vlist[0]->x;
-      minY = maxY = vlist[0]->y;
-      minZ = maxZ = vlist[0]->z;
-      for(int i=0; i<nverts; i++)
-	{
-	  minX = qMin(minX, vlist[i]->x);
-	  maxX = qMax(maxX, vlist[i]->x);
-	  minY = qMin(minY, vlist[i]->y);
-	  maxY = qMax(maxY, vlist[i]->y);
-	  minZ = qMin(minZ, vlist[i]->z);
-	  maxZ = qMax(maxZ, vlist[i]->z);
-	}
-      minX = floor(minX);
-      minY = floor(minY);
-      minZ = floor(minZ);
-      maxX = ceil(maxX);
-      maxY = ceil(maxY);
-      maxZ = ceil(maxZ);
+      float minX = floor(bmin.x);
+      float minY = floor(bmin.y);
+      float minZ = floor(bmin.z);
+      float maxX = ceil(bmax.x);
+      float maxY = ceil(bmax.y);
+      float maxZ = ceil(bmax.z);
       int h = maxX-minX+1;
       int w = maxY-minY+1;
       int d = maxZ-minZ+1;
@@ -278,42 +321,6 @@ TrisetObject::loadPLY(QString flnm)
       m_nY = w;
       m_nZ = h;
       m_position = Vec(-minX, -minY, -minZ);
-
-//      bool ok;
-//      QString text = QInputDialog::getText(0,
-//					   "Please enter grid size",
-//					   "Grid Size",
-//					   QLineEdit::Normal,
-//					   QString("%1 %2 %3").\
-//					   arg(d).arg(w).arg(h),
-//					   &ok);
-//      if (!ok || text.isEmpty())
-//	{
-//	  QMessageBox::critical(0, "Cannot load PLY", "No grid");
-//	  return false;
-//	}
-//      
-//      int nx=0;
-//      int ny=0;
-//      int nz=0;
-//      QStringList gs = text.split(" ", QString::SkipEmptyParts);
-//      if (gs.count() > 0) nx = gs[0].toInt();
-//      if (gs.count() > 1) ny = gs[1].toInt();
-//      if (gs.count() > 2) nz = gs[2].toInt();
-//      if (nx > 0 && ny > 0 && nz > 0)
-//	{
-//	  m_nX = nx;
-//	  m_nY = ny;
-//	  m_nZ = nz;
-//	}
-//      else
-//	{
-//	  QMessageBox::critical(0, "Cannot load triset", "No grid");
-//	  return false;
-//	}
-//
-//      if (d == m_nX && w == m_nY && h == m_nZ)
-//	m_position = Vec(-minX, -minY, -minZ);
     }
   else
     {
@@ -323,68 +330,6 @@ TrisetObject::loadPLY(QString flnm)
       m_nX = dim.z;
     }
 
-  m_vertices.resize(nverts);
-  for(int i=0; i<nverts; i++)
-    m_vertices[i] = Vec(vlist[i]->x,
-			vlist[i]->y,
-			vlist[i]->z);
-
-
-  m_normals.clear();
-  if (has_normals)
-    {
-      m_normals.resize(nverts);
-      for(int i=0; i<nverts; i++)
-	m_normals[i] = Vec(vlist[i]->nx,
-			   vlist[i]->ny,
-			   vlist[i]->nz);
-    }
-
-  m_vcolor.clear();
-  if (per_vertex_color)
-    {
-      m_vcolor.resize(nverts);
-      for(int i=0; i<nverts; i++)
-	m_vcolor[i] = Vec(vlist[i]->r/255.0f,
-			  vlist[i]->g/255.0f,
-			  vlist[i]->b/255.0f);
-    }
-
-  // only triangles considered
-  int ntri=0;
-  for (int i=0; i<nfaces; i++)
-    {
-      if (flist[i]->nverts >= 3)
-	ntri++;
-    }
-  m_triangles.resize(3*ntri);
-
-  int tri=0;
-  for(int i=0; i<nfaces; i++)
-    {
-      if (flist[i]->nverts >= 3)
-	{
-	  m_triangles[3*tri+0] = flist[i]->verts[0];
-	  m_triangles[3*tri+1] = flist[i]->verts[1];
-	  m_triangles[3*tri+2] = flist[i]->verts[2];
-	  tri++;
-	}
-    }
-
-
-
-  m_tvertices.resize(nverts);
-  m_tnormals.resize(nverts);
-  m_texValues.resize(nverts);
-
-
-  Vec bmin = m_vertices[0];
-  Vec bmax = m_vertices[0];
-  for(int i=0; i<nverts; i++)
-    {
-      bmin = StaticFunctions::minVec(bmin, m_vertices[i]);
-      bmax = StaticFunctions::maxVec(bmax, m_vertices[i]);
-    }
   m_centroid = (bmin + bmax)/2;
 
   m_enclosingBox[0] = Vec(bmin.x, bmin.y, bmin.z);
@@ -399,12 +344,6 @@ TrisetObject::loadPLY(QString flnm)
 
   m_pointStep = qMax(1, nverts/50000);
 
-//  QMessageBox::information(0, "", QString("%1 %2 %3\n%4 %5").	\
-//			   arg(m_nX).arg(m_nY).arg(m_nZ).	\
-//			   arg(m_vertices.count()).		\
-//			   arg(m_triangles.count()/3));
-
-
   m_fileName = flnm;
 
   return true;
@@ -413,78 +352,16 @@ TrisetObject::loadPLY(QString flnm)
 bool
 TrisetObject::loadTriset(QString flnm)
 {
-  QFile fd(flnm);
-  fd.open(QFile::ReadOnly);
-
-  uchar stype = 0;
-  fd.read((char*)&stype, sizeof(uchar));
-  if (stype != 0)
+  if (!MeshReader::readTriset(flnm, m_mesh, m_nX, m_nY, m_nZ))
     {
       QMessageBox::critical(0, "Cannot load triset",
-			    "Wrong input format : First byte not equal to 0");
+			    "Wrong input format : First byte not equal to 0 or file truncated");
       return false;
     }
+  int nvert = m_mesh.vertexCount();
 
-  fd.read((char*)&m_nX, sizeof(int));
-  fd.read((char*)&m_nY, sizeof(int));
-  fd.read((char*)&m_nZ, sizeof(int));
-
-
-  int nvert, ntri;
-  fd.read((char*)&nvert, sizeof(int));
-  fd.read((char*)&ntri, sizeof(int));
-   
-
-//  QMessageBox::information(0, "", QString("%1 %2 %3\n%4 %5").	\
-//			   arg(m_nX).arg(m_nY).arg(m_nZ).\
-//			   arg(nvert).\
-//			   arg(ntri));
-
-
-  float *vert = new float[nvert*3];
-  fd.read((char*)vert, sizeof(float)*3*nvert);
-
-  float *vnorm = new float[nvert*3];
-  fd.read((char*)vnorm, sizeof(float)*3*nvert);
-
-  int *tri = new int[ntri*3];
-  fd.read((char*)tri, sizeof(int)*3*ntri);
-
-  fd.close();
-
-
-  m_vertices.resize(nvert);
-  for(int i=0; i<nvert; i++)
-    m_vertices[i] = Vec(vert[3*i],
-			vert[3*i+1],
-			vert[3*i+2]);
-  delete [] vert;
-
-  m_normals.resize(nvert);
-  for(int i=0; i<nvert; i++)
-    m_normals[i] = Vec(vnorm[3*i],
-		       vnorm[3*i+1],
-		       vnorm[3*i+2]);
-  delete [] vnorm;
-
-  m_triangles.resize(3*ntri);
-  for(int i=0; i<3*ntri; i++)
-    m_triangles[i] = tri[i];
-  delete [] tri;
-
-
-  m_tvertices.resize(nvert);
-  m_tnormals.resize(nvert);
-  m_texValues.resize(nvert);
-
-
-  Vec bmin = m_vertices[0];
-  Vec bmax = m_vertices[0];
-  for(int i=0; i<nvert; i++)
-    {
-      bmin = StaticFunctions::minVec(bmin, m_vertices[i]);
-      bmax = StaticFunctions::maxVec(bmax, m_vertices[i]);
-    }
+  Vec bmin, bmax;
+  m_mesh.bounds(bmin, bmax);
   m_centroid = (bmin + bmax)/2;
 
   m_position = Vec(0,0,0);
@@ -502,17 +379,11 @@ TrisetObject::loadTriset(QString flnm)
 
   m_pointStep = qMax(1, nvert/50000);
 
-//  QMessageBox::information(0, "", QString("%1 %2 %3\n%4 %5").	\
-//			   arg(m_nX).arg(m_nY).arg(m_nZ).\
-//			   arg(m_vertices.count()).\
-//			   arg(m_triangles.count()));
-
   m_fileName = flnm;
 
   return true;
 }
 
-
 void
 TrisetObject::postdraw(QGLViewer *viewer,
 		       int x, int y,
@@ -673,49 +544,21 @@ TrisetObject::predraw(QGLViewer *viewer,
   for(int i=0; i<8; i++)
     m_tenclosingBox[i] = Matrix::xformVec(localXform, m_enclosingBox[i]);
 
-  for(int i=0; i<m_vertices.count(); i++)
-    m_tvertices[i] = Matrix::xformVec(localXform, m_vertices[i]);
-
-
-  if (m_normals.count() > 0)
-    {  int fn = 1;
-      if (m_flipNormals)
-	fn = -1;
-      for(int i=0; i<m_normals.count(); i++)
-	m_tnormals[i] = Matrix::rotateVec(localXform, (fn*m_normals[i]));
-    }
+  m_mesh.transform(localXform, m_flipNormals);
 
-  if (m_blendMode)
+  // depth is worked out at draw time, shadow lookups are stored
+  m_pn = pn;
+  if (m_blendMode && shadows && m_shadows)
     {
-      if (!shadows || !m_shadows)
+      m_mesh.allocateShadowCoords();
+      for(int i=0; i<m_mesh.vertexCount(); i++)
 	{
-	  for(int i=0; i<m_vertices.count(); i++)
-	    m_texValues[i] = Vec(pn*m_tvertices[i], 0, 0);
+	  Vec scr = viewer->camera()->projectedCoordinatesOf(m_mesh.tvertex(i));
+	  m_mesh.setShadowCoord(i, scr.x, shadowHeight-scr.y);
 	}
-      else
-	{
-	  for(int i=0; i<m_vertices.count(); i++)
-	    {
-	      Vec scr = viewer->camera()->projectedCoordinatesOf(m_tvertices[i]);
-	      float tx = scr.x;
-	      float ty = shadowHeight-scr.y;
-	      
-	      float d = pn * m_tvertices[i];
-	      
-	      m_texValues[i] = Vec(d, tx, ty);
-	    }
-	}
-    }
-
-  bool black = (m_color.x<0.1 && m_color.y<0.1 && m_color.z<0.1);
-  if (black)
-    {
-      m_drawcolor.clear();
-      m_drawcolor = m_vcolor;
-      for(int i=0; i<m_drawcolor.count(); i++)
-	m_drawcolor[i] *= m_opacity;
     }
-
+  else
+    m_mesh.releaseShadowCoords();
 
   delete [] localXform;
 }
@@ -736,9 +579,11 @@ TrisetObject::makeReadyForPainting(QGLViewer *viewer)
   for(int i=0; i<swd*sht; i++)
     m_scrV[i] = 1000000000; // a very large number - we will not have billion vertices
 
-  for(int i=0; i<m_tvertices.count(); i++)
+  // nothing drawn yet when there are no transformed vertices
+  int nv = (m_mesh.isTransformed() ? m_mesh.vertexCount() : 0);
+  for(int i=0; i<nv; i++)
     {
-      Vec scr = viewer->camera()->projectedCoordinatesOf(m_tvertices[i]);
+      Vec scr = viewer->camera()->projectedCoordinatesOf(m_mesh.tvertex(i));
       int tx = scr.x;
       int ty = sht-scr.y;
       if (tx>0 && tx<swd && ty>0 && ty<sht)
@@ -751,11 +596,8 @@ TrisetObject::makeReadyForPainting(QGLViewer *viewer)
 	}
     }
 
-  if (m_vcolor.count() == 0)
-    { // create per vertex color and fill with white
-      m_vcolor.resize(m_vertices.count());
-      m_vcolor.fill(Vec(1,1,1));
-    }
+  if (!m_mesh.hasColors()) // create per vertex color and fill with white
+    m_mesh.fillColor(255, 255, 255);
 
   bool black = (m_color.x<0.1 && m_color.y<0.1 && m_color.z<0.1);
   if (!black) // make it black so that actual vertex colors are displayed
@@ -780,9 +622,12 @@ TrisetObject::paint(QGLViewer *viewer,
   int swd = viewer->camera()->screenWidth();
   int sht = viewer->camera()->screenHeight();
 
-  for(int i=0; i<m_tvertices.count(); i++)
+  if (!m_mesh.hasColors() || !m_mesh.isTransformed())
+    return;
+
+  for(int i=0; i<m_mesh.vertexCount(); i++)
     {
-      Vec scr = viewer->camera()->projectedCoordinatesOf(m_tvertices[i]);
+      Vec scr = viewer->camera()->projectedCoordinatesOf(m_mesh.tvertex(i));
       int tx = scr.x;
       int ty = sht-scr.y;
       float td = scr.z;
@@ -793,7 +638,11 @@ TrisetObject::paint(QGLViewer *viewer,
 	    {
 	      float zd = depthMap[idx];
 	      if (fabs(zd-td) < 0.0002)
-		m_vcolor[i] = tmix*tcolor + (1.0-tmix)*m_vcolor[i];
+		{
+		  uchar *c = m_mesh.color(i);
+		  for(int k=0; k<3; k++)
+		    c[k] = 255*tmix*tcolor[k] + (1.0-tmix)*c[k];
+		}
 	    }
 	}
     }
@@ -805,8 +654,12 @@ TrisetObject::drawTriset(float pnear, float pfar, Vec step)
   glEnable(GL_DEPTH_TEST);
 
   bool black = (m_color.x<0.1 && m_color.y<0.1 && m_color.z<0.1);
-  bool has_normals = (m_normals.count() > 0);
-  bool per_vertex_color = (m_vcolor.count() > 0 && black);
+  bool has_normals = m_mesh.hasNormals();
+  bool per_vertex_color = (m_mesh.hasColors() && black);
+  bool has_shadow = m_mesh.hasShadowCoords();
+  QVector<uint>& triangles = m_mesh.triangles();
+  int ntri = m_mesh.triangleCount();
+  float nrm[3];
   if (m_pointMode)
     {
       glEnable(GL_POINT_SPRITE);
@@ -818,20 +671,22 @@ TrisetObject::drawTriset(float pnear, float pfar, Vec step)
       glEnable(GL_POINT_SMOOTH);
       glPointSize(m_pointSize);
       glBegin(GL_POINTS);
-      for(int i=0; i<m_triangles.count()/3; i+=m_pointStep)
+      for(int i=0; i<ntri; i+=m_pointStep)
 	{
-	  int v0 = m_triangles[3*i];
-	  if ( m_texValues[v0].x >= pnear &&
-	       m_texValues[v0].x <= pfar )
+	  int v0 = triangles[3*i];
+	  const float *tv = m_mesh.tvertexPtr(v0);
+	  float d = vertexDepth(tv, m_pn);
+	  if (d >= pnear && d <= pfar)
 	    {
-	      if (has_normals) glNormal3dv(m_tnormals[v0]);
+	      if (has_normals)
+		{
+		  m_mesh.tnormal(v0, nrm);
+		  glNormal3fv(nrm);
+		}
 	      if (per_vertex_color)
-		glColor4f(m_drawcolor[v0].x, 
-			  m_drawcolor[v0].y, 
-			  m_drawcolor[v0].z,
-			  m_opacity);
+		vertexColor(m_mesh.color(v0), m_opacity);
 
-	      glVertex3dv(m_tvertices[v0]);
+	      glVertex3fv(tv);
 	    }
 	}
       glEnd();
@@ -843,56 +698,37 @@ TrisetObject::drawTriset(float pnear, float pfar, Vec step)
   else
     {
       glBegin(GL_TRIANGLES);
-      for(int i=0; i<m_triangles.count()/3; i++)
+      for(int i=0; i<ntri; i++)
 	{
-	  int v0 = m_triangles[3*i];
-	  int v1 = m_triangles[3*i+1];
-	  int v2 = m_triangles[3*i+2];
-	  
-	  if ( ! ((m_texValues[v0].x < pnear &&
-		   m_texValues[v1].x < pnear &&
-		   m_texValues[v2].x < pnear) ||
-		  (m_texValues[v0].x > pfar  &&
-		   m_texValues[v1].x > pfar  &&
-		   m_texValues[v2].x > pfar)) )
+	  int v[3];
+	  float d[3];
+	  for(int k=0; k<3; k++)
 	    {
-	      glMultiTexCoord2d(GL_TEXTURE0,
-				m_texValues[v0].y,
-				m_texValues[v0].z);
-	      if (has_normals) glNormal3dv(m_tnormals[v0]);
-	      if (per_vertex_color)
-		glColor4f(m_drawcolor[v0].x, 
-			  m_drawcolor[v0].y, 
-			  m_drawcolor[v0].z,
-			  m_opacity);
-	      glMultiTexCoord3dv(GL_TEXTURE2, m_tvertices[v0]);
-	      glVertex3dv(m_tvertices[v0]+step);
-	      
-	      glMultiTexCoord2d(GL_TEXTURE0,
-				m_texValues[v1].y,
-				m_texValues[v1].z);
-	      if (has_normals) glNormal3dv(m_tnormals[v1]);
-	      if (per_vertex_color)
-		glColor4f(m_drawcolor[v1].x, 
-			  m_drawcolor[v1].y, 
-			  m_drawcolor[v1].z,
-			  m_opacity);
-	      glMultiTexCoord3dv(GL_TEXTURE2, m_tvertices[v1]);
-	      glVertex3dv(m_tvertices[v1]+step);
-	      
-	      glMultiTexCoord2d(GL_TEXTURE0,
-				m_texValues[v2].y,
-				m_texValues[v2].z);
-	      if (has_normals) glNormal3dv(m_tnormals[v2]);
-	      if (per_vertex_color)
-		glColor4f(m_drawcolor[v2].x, 
-			  m_drawcolor[v2].y, 
-			  m_drawcolor[v2].z,
-			  m_opacity);
-	      glMultiTexCoord3dv(GL_TEXTURE2, m_tvertices[v2]);
-	      glVertex3dv(m_tvertices[v2]+step);
+	      v[k] = triangles[3*i+k];
+	      d[k] = vertexDepth(m_mesh.tvertexPtr(v[k]), m_pn);
 	    }
 	  
+	  if ( ! ((d[0] < pnear && d[1] < pnear && d[2] < pnear) ||
+		  (d[0] > pfar  && d[1] > pfar  && d[2] > pfar)) )
+	    {
+	      for(int k=0; k<3; k++)
+		{
+		  const float *tv = m_mesh.tvertexPtr(v[k]);
+		  if (has_shadow)
+		    glMultiTexCoord2fv(GL_TEXTURE0, m_mesh.shadowCoord(v[k]));
+		  else
+		    glMultiTexCoord2f(GL_TEXTURE0, 0, 0);
+		  if (has_normals)
+		    {
+		      m_mesh.tnormal(v[k], nrm);
+		      glNormal3fv(nrm);
+		    }
+		  if (per_vertex_color)
+		    vertexColor(m_mesh.color(v[k]), m_opacity);
+		  glMultiTexCoord3fv(GL_TEXTURE2, tv);
+		  glVertex3f(tv[0]+step.x, tv[1]+step.y, tv[2]+step.z);
+		}
+	    }
 	}
       glEnd();
     }
@@ -904,8 +740,11 @@ void
 TrisetObject::drawTriset()
 {
   bool black = (m_color.x<0.1 && m_color.y<0.1 && m_color.z<0.1);
-  bool has_normals = (m_normals.count() > 0);
-  bool per_vertex_color = (m_vcolor.count() > 0 && black);
+  bool has_normals = m_mesh.hasNormals();
+  bool per_vertex_color = (m_mesh.hasColors() && black);
+  QVector<uint>& triangles = m_mesh.triangles();
+  int ntri = m_mesh.triangleCount();
+  float nrm[3];
   if (m_pointMode)
     {
       glEnable(GL_DEPTH_TEST);
@@ -918,16 +757,17 @@ TrisetObject::drawTriset()
       glEnable(GL_POINT_SMOOTH);
       glPointSize(m_pointSize);
       glBegin(GL_POINTS);
-      for(int i=0; i<m_triangles.count()/3; i+=m_pointStep)
+      for(int i=0; i<ntri; i+=m_pointStep)
 	{
-	  int v0 = m_triangles[3*i];
-	  if (has_normals) glNormal3dv(m_tnormals[v0]);
+	  int v0 = triangles[3*i];
+	  if (has_normals)
+	    {
+	      m_mesh.tnormal(v0, nrm);
+	      glNormal3fv(nrm);
+	    }
 	  if (per_vertex_color)
-	    glColor4f(m_drawcolor[v0].x, 
-		      m_drawcolor[v0].y, 
-		      m_drawcolor[v0].z,
-		      m_opacity);
-	  glVertex3dv(m_tvertices[v0]);
+	    vertexColor(m_mesh.color(v0), m_opacity);
+	  glVertex3fv(m_mesh.tvertexPtr(v0));
 	}
       glEnd();
       glPointSize(1);
@@ -938,35 +778,17 @@ TrisetObject::drawTriset()
   else
     {
       glBegin(GL_TRIANGLES);
-      for(int i=0; i<m_triangles.count()/3; i++)
+      for(int i=0; i<3*ntri; i++)
 	{
-	  int v0 = m_triangles[3*i];
-	  int v1 = m_triangles[3*i+1];
-	  int v2 = m_triangles[3*i+2];
-	  
-	  if (has_normals) glNormal3fv(m_tnormals[v0]);
-	  if (per_vertex_color)
-	    glColor4f(m_drawcolor[v0].x, 
-		      m_drawcolor[v0].y, 
-		      m_drawcolor[v0].z,
-		      m_opacity);
-	  glVertex3fv(m_tvertices[v0]);
-	      
-	  if (has_normals) glNormal3fv(m_tnormals[v1]);
-	  if (per_vertex_color)
-	    glColor4f(m_drawcolor[v1].x, 
-		      m_drawcolor[v1].y, 
-		      m_drawcolor[v1].z,
-		      m_opacity);
-	  glVertex3fv(m_tvertices[v1]);
-	      
-	  if (has_normals) glNormal3fv(m_tnormals[v2]);
+	  int v0 = triangles[i];
+	  if (has_normals)
+	    {
+	      m_mesh.tnormal(v0, nrm);
+	      glNormal3fv(nrm);
+	    }
 	  if (per_vertex_color)
-	    glColor4f(m_drawcolor[v2].x, 
-		      m_drawcolor[v2].y, 
-		      m_drawcolor[v2].z,
-		      m_opacity);
-	  glVertex3fv(m_tvertices[v2]);	  
+	    vertexColor(m_mesh.color(v0), m_opacity);
+	  glVertex3fv(m_mesh.tvertexPtr(v0));
 	}
       glEnd();
     }
@@ -1241,8 +1063,8 @@ TrisetObject::set(TrisetInformation ti)
 void
 TrisetObject::save()
 {
-  bool has_normals = (m_normals.count() > 0);
-  bool per_vertex_color = (m_vcolor.count() > 0);
+  bool has_normals = m_mesh.hasNormals();
+  bool per_vertex_color = m_mesh.hasColors();
 
   QString flnm = QFileDialog::getSaveFileName(0,
 					      "Export mesh to file",
@@ -1282,6 +1104,7 @@ TrisetObject::save()
      1, Uint8, Uint8, offsetof(PlyFace,nverts)},
   };
 
+  bool bin = true;
   PlyFile    *ply;
   FILE       *fp = fopen(flnm.toLatin1().data(), bin ? "wb" : "w");
 
@@ -1293,7 +1116,7 @@ TrisetObject::save()
 		   elem_names,
 		   bin ? PLY_BINARY_LE : PLY_ASCII );
 
-  int nvertices = m_vertices.count();
+  int nvertices = m_mesh.vertexCount();
   /* describe what properties go into the PlyVertex elements */
   describe_element_ply ( ply, plyStrings[10], nvertices );
   describe_property_ply ( ply, &vert_props[0] );
@@ -1307,7 +1130,7 @@ TrisetObject::save()
   describe_property_ply ( ply, &vert_props[8] );
 
   /* describe PlyFace properties (just list of PlyVertex indices) */
-  int ntriangles = m_triangles.count()/3;
+  int ntriangles = m_mesh.triangleCount();
   describe_element_ply ( ply, plyStrings[11], ntriangles );
   describe_property_ply ( ply, &face_props[0] );
 
@@ -1317,23 +1140,26 @@ TrisetObject::save()
   /* set up and write the PlyVertex elements */
   put_element_setup_ply ( ply, plyStrings[10] );
 
-  for(int i=0; i<m_vertices.count(); i++)
+  for(int i=0; i<nvertices; i++)
     {
       myVertex vertex;
-      vertex.x = m_vertices[i].x*m_scale.x;
-      vertex.y = m_vertices[i].y*m_scale.y;
-      vertex.z = m_vertices[i].z*m_scale.z;
+      Vec v = m_mesh.vertex(i);
+      vertex.x = v.x*m_scale.x;
+      vertex.y = v.y*m_scale.y;
+      vertex.z = v.z*m_scale.z;
       if (has_normals)
 	{
-	  vertex.nx = m_normals[i].x;
-	  vertex.ny = m_normals[i].y;
-	  vertex.nz = m_normals[i].z;
+	  Vec n = m_mesh.normal(i);
+	  vertex.nx = n.x;
+	  vertex.ny = n.y;
+	  vertex.nz = n.z;
 	}
       if (per_vertex_color)
 	{
-	  vertex.r = 255*m_vcolor[i].x;
-	  vertex.g = 255*m_vcolor[i].y;
-	  vertex.b = 255*m_vcolor[i].z;
+	  uchar *c = m_mesh.color(i);
+	  vertex.r = c[0];
+	  vertex.g = c[1];
+	  vertex.b = c[2];
 	}
       put_element_ply ( ply, ( void * ) &vertex );
     }
@@ -1341,11 +1167,12 @@ TrisetObject::save()
   put_element_setup_ply ( ply, plyStrings[11] );
   face.nverts = 3 ;
   face.verts  = verts ;
-  for(int i=0; i<m_triangles.count()/3; i++)
+  QVector<uint>& triangles = m_mesh.triangles();
+  for(int i=0; i<ntriangles; i++)
     {
-      int v0 = m_triangles[3*i];
-      int v1 = m_triangles[3*i+1];
-      int v2 = m_triangles[3*i+2];
+      int v0 = triangles[3*i];
+      int v1 = triangles[3*i+1];
+      int v2 = triangles[3*i+2];
 
       face.verts[0] = v0;
       face.verts[1] = v1;
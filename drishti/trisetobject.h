@@ -4,6 +4,7 @@
 #include <QFile>
 
 #include "trisetinformation.h"
+#include "meshstore.h"
 
 class TrisetObject
 {
@@ -63,8 +64,8 @@ class TrisetObject
   Vec scale() { return m_scale; }
   void setScale(Vec scl) { m_scale = scl; }
 
-  int vertexCount() { return m_vertices.count(); }
-  int triangleCount() { return m_triangles.count()/3; }
+  int vertexCount() { return m_mesh.vertexCount(); }
+  int triangleCount() { return m_mesh.triangleCount(); }
 
   bool load(QString);
   void save();
@@ -114,17 +115,11 @@ class TrisetObject
   float m_diffuse;
   float m_ambient;
   int m_pointSize;
-  QVector<Vec> m_vertices;
-  QVector<Vec> m_normals;
-  QVector<uint> m_triangles;
-  QVector<Vec> m_vcolor;
-  QVector<Vec> m_drawcolor;
+  MeshStore m_mesh;
 
   Vec m_tcentroid;
   Vec m_tenclosingBox[8];
-  QVector<Vec> m_tvertices;
-  QVector<Vec> m_tnormals;
-  QVector<Vec> m_texValues;
+  Vec m_pn; // depth direction for blended drawing
 
   QList<char*> plyStrings;
 
@@ -136,6 +131,7 @@ class TrisetObject
 
   bool loadTriset(QString);
   bool loadPLY(QString);
+  bool readPLYElements(QString);
 };
 
 #endif
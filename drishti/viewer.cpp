@@ -13,6 +13,7 @@
 #include "prunehandler.h"
 #include "itksegmentation.h"
 #include "mainwindowui.h"
+#include "blobstore.h"
 
 #include <stdio.h>
 #include <math.h>
@@ -967,6 +968,11 @@ Viewer::updateLookupTable()
       //if (fboBound) releaseFBOs(Enums::StillImage);
     }
 
+  // opacity changed between zero and non-zero somewhere,
+  // re-evaluate the brick occupancy used for slicing
+  if (prune)
+    m_hiresVolume->updateOccupancy();
+
   loadLookupTable(lut);
 
   if (m_hiresVolume->raised() &&
@@ -3752,6 +3758,28 @@ Viewer::processCommand(QString cmd)
 	  QMessageBox::information(0, "", QString("Temp directory set to %1").arg(flnm));
 	}
     }
+  else if (list[0].contains("cachedir"))
+    {
+      if (list[0].contains("reset"))
+	{
+	  Global::setCacheDir("");
+	  QMessageBox::information(0, "", "No cache directory set.");
+	}
+      else
+	{
+	  QString flnm;
+	  flnm = QFileDialog::getExistingDirectory(0,
+						   "Select Directory to save mesh, path and network caches",
+						   Global::previousDirectory(),
+						   QFileDialog::ShowDirsOnly |
+						   QFileDialog::DontUseNativeDialog);
+	  if (!flnm.isEmpty())
+	    Global::setCacheDir(flnm);
+      
+	  flnm = Global::cacheDir();
+	  QMessageBox::information(0, "", QString("Cache directory set to %1").arg(flnm));
+	}
+    }
   else if (list[0] == "resetcamera")
     {
       // if in fly mode switch it off 
@@ -3827,6 +3855,50 @@ Viewer::processCommand(QString cmd)
       Global::setLod(rlod);
       reloadData();
     }
+  else if (list[0] == "timestepprefetch")
+    {
+      int nsteps = 2;
+      int mb = 0;
+      if (list.size() > 1)
+	{
+	  if (list[1] == "off" || list[1] == "no")
+	    nsteps = 0;
+	  else
+	    nsteps = list[1].toInt(&ok);
+	}
+      if (list.size() > 2) mb = list[2].toInt(&ok);
+      m_Volume->setTimestepPrefetch(nsteps, mb);
+      reloadData();
+    }
+  else if (list[0] == "timestepstats")
+    {
+      QMessageBox::information(0, "Timestep Prefetch",
+			       m_Volume->timestepCacheStatistics());
+    }
+  else if (list[0] == "blobstats")
+    {
+      QMessageBox::information(0, "Keyframe Blobs",
+			       BlobStore::statistics());
+    }
+  else if (list[0] == "loadstats")
+    {
+      QMessageBox::information(0, "Texture Loading",
+			       m_hiresVolume->textureLoadStatistics());
+    }
+  else if (list[0] == "slicebenchmark")
+    {
+      int frames = 20;
+      if (list.size() > 1) frames = list[1].toInt(&ok);
+      QMessageBox::information(0, "Slice Geometry",
+			       m_hiresVolume->benchmarkSliceGeometry(frames));
+    }
+  else if (list[0] == "lightbenchmark")
+    {
+      int runs = 3;
+      if (list.size() > 1) runs = list[1].toInt(&ok);
+      QMessageBox::information(0, "Light Buffers",
+			       LightHandler::benchmarkLightBuffers(runs));
+    }
   else if (list[0] == "addrotationanimation")
     {
       int axis = 0;
@@ -5398,6 +5470,15 @@ Viewer::handleMorphologicalOperations(QStringList list)
       else PruneHandler::setBlend(true);
       m_hiresVolume->createDefaultShader();
     }
+  else if (list[0] == "cpu")
+    {
+      if (list.size() > 1) PruneHandler::setCpuMop(false);
+      else PruneHandler::setCpuMop(true);
+      if (PruneHandler::cpuMop())
+	emit showMessage("Morphological operations on cpu", false);
+      else
+	emit showMessage("Morphological operations on gpu", false);
+    }
   else if (list[0] == "carve")
     {
       if (list.size() > 1)
@@ -60,16 +60,6 @@ Volume::pvlFileManager(int vol)
   return m_volume[vol]->pvlFileManager();
 }
 VolumeFileManager*
-Volume::gradFileManager(int vol)
-{
-  if (Global::volumeType() == Global::DummyVolume ||
-      Global::volumeType() == Global::RGBVolume ||
-      Global::volumeType() == Global::RGBAVolume)
-    return 0;
-
-  return m_volume[vol]->gradFileManager();
-}
-VolumeFileManager*
 Volume::lodFileManager(int vol)
 {
   if (Global::volumeType() == Global::DummyVolume ||
@@ -484,6 +474,22 @@ Volume::getSliceTextureSlab(int minz, int maxz)
     }
 }
 
+bool
+Volume::canPrepareSlabs()
+{
+  return (m_volume.count() > 0 &&
+	  Global::volumeType() == Global::SingleVolume);
+}
+
+bool
+Volume::prepareSliceTextureSlab(int minz, int maxz, uchar* &tex)
+{
+  if (!canPrepareSlabs())
+    return false;
+
+  return m_volume[0]->prepareSliceTextureSlab(minz, maxz, tex);
+}
+
 void Volume::forceCreateLowresVolume()
 {
   if (!valid())
@@ -899,6 +905,29 @@ Volume::setRepeatType(int vol, bool rt)
   m_volume[vol]->setRepeatType(rt);
 }
 
+void
+Volume::setTimestepPrefetch(int nsteps, int mb)
+{
+  if (m_volume.count() == 0)
+    return;
+
+  // background timestep streaming is only for single volumes
+  if (Global::volumeType() != Global::SingleVolume)
+    return;
+
+  m_volume[0]->setTimestepPrefetch(nsteps, mb);
+}
+
+QString
+Volume::timestepCacheStatistics()
+{
+  if (m_volume.count() == 0 ||
+      Global::volumeType() != Global::SingleVolume)
+    return QString("Timestep prefetch only available for single volumes");
+
+  return m_volume[0]->timestepCacheStatistics();
+}
+
 bool
 Volume::setSubvolume(Vec boxMin, Vec boxMax,
 		     int volnum,
@@ -27,7 +27,6 @@ class Volume : public QObject
 
   void closePvlFileManager();
   VolumeFileManager* pvlFileManager(int);
-  VolumeFileManager* gradFileManager(int);
   VolumeFileManager* lodFileManager(int);
 
   bool loadVolumeRGB(const char*, bool);
@@ -66,6 +65,9 @@ class Volume : public QObject
   void setRepeatType(int, bool);
   void setRepeatType(QList<bool>);
 
+  void setTimestepPrefetch(int, int);
+  QString timestepCacheStatistics();
+
   Vec getSubvolumeSize();
   Vec getSubvolumeTextureSize();
   int getSubvolumeSubsamplingLevel();
@@ -127,6 +129,10 @@ class Volume : public QObject
   uchar* getSliceTextureSlab(int, int);
   void deleteTextureSlab();
 
+  // slabs can be prepared off the gui thread into caller buffers
+  bool canPrepareSlabs();
+  bool prepareSliceTextureSlab(int, int, uchar*&);
+
   uchar* getDragTexture();
   Vec getDragTextureInfo();
   void getDragTextureSize(int&, int&);
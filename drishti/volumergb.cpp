@@ -3,6 +3,7 @@
 #include "staticfunctions.h"
 #include "mainwindowui.h"
 #include "xmlheaderfunctions.h"
+#include "cropmask.h"
 
 #include <QFileDialog>
 
@@ -1023,6 +1024,11 @@ VolumeRGB::maskRawVolume(unsigned char *lut,
 
   Vec voxelScaling = Global::voxelScaling();
 
+  CropMask cropMask;
+  cropMask.setScaling(voxelScaling);
+  cropMask.setClips(clipPos, clipNormal);
+  cropMask.setCrops(crops);
+
   uchar *vol;
   vol = new uchar[4*leny*lenx];
 
@@ -1055,22 +1061,16 @@ VolumeRGB::maskRawVolume(unsigned char *lut,
 	}
 
 
+      cropMask.evaluate(z, minx, maxx, miny, maxy);
       for(int y=miny; y<=maxy; y++)
-	for(int x=minx; x<=maxx; x++)
-	  {
-	    int idx = (y-miny)*lenx + (x-minx);
-
-	    Vec po = Vec(x, y, z);
-	    po = VECPRODUCT(po, voxelScaling);
-
-	    bool ok = StaticFunctions::getClip(po, clipPos, clipNormal);
-
-	    for(int ci=0; ci<crops.count(); ci++)
-	      ok &= crops[ci].checkCropped(po);
-
-	    // apply clipping
-	    if (ok)
+	{
+	  int *run;
+	  int nruns = cropMask.runs(y, run);
+	  for(int ri=0; ri<nruns; ri++)
+	    for(int x=run[2*ri]; x<=run[2*ri+1]; x++)
 	      {
+		int idx = (y-miny)*lenx + (x-minx);
+
 		uchar r = vol[4*idx+0];
 		uchar g = vol[4*idx+1];
 		uchar b = vol[4*idx+2];
@@ -1094,7 +1094,7 @@ VolumeRGB::maskRawVolume(unsigned char *lut,
 		    rgb[4*idx+3] = a * opac;
 		  }
 	      }
-	  }
+	}
 
       QString flname = f.absolutePath() + QDir::separator() +
 	               f.baseName();
@@ -1156,6 +1156,11 @@ VolumeRGB::saveOpacityVolume(unsigned char *lut,
 
   Vec voxelScaling = Global::voxelScaling();
 
+  CropMask cropMask;
+  cropMask.setScaling(voxelScaling);
+  cropMask.setClips(clipPos, clipNormal);
+  cropMask.setCrops(crops);
+
 
   //*** max 1Gb per slab
   int opslabSize;
@@ -1180,6 +1185,7 @@ VolumeRGB::saveOpacityVolume(unsigned char *lut,
   for(int z=minz; z<=maxz; z++)
     {
       memset(vol, 255, 4*leny*lenx);
+      memset(opacity, 0, leny*lenx);
 
       for (int q=0; q<nRGB; q++)
 	{
@@ -1195,22 +1201,16 @@ VolumeRGB::saveOpacityVolume(unsigned char *lut,
 	}
 
 
+      cropMask.evaluate(z, minx, maxx, miny, maxy);
       for(int y=miny; y<=maxy; y++)
-	for(int x=minx; x<=maxx; x++)
-	  {
-	    int idx = (y-miny)*lenx + (x-minx);
-
-	    Vec po = Vec(x, y, z);
-	    po = VECPRODUCT(po, voxelScaling);
-
-	    bool ok = StaticFunctions::getClip(po, clipPos, clipNormal);
-
-	    for(int ci=0; ci<crops.count(); ci++)
-	      ok &= crops[ci].checkCropped(po);
-
-	    // apply clipping
-	    if (ok)
+	{
+	  int *run;
+	  int nruns = cropMask.runs(y, run);
+	  for(int ri=0; ri<nruns; ri++)
+	    for(int x=run[2*ri]; x<=run[2*ri+1]; x++)
 	      {
+		int idx = (y-miny)*lenx + (x-minx);
+
 		uchar r = vol[4*idx+0];
 		uchar g = vol[4*idx+1];
 		uchar b = vol[4*idx+2];
@@ -1228,7 +1228,7 @@ VolumeRGB::saveOpacityVolume(unsigned char *lut,
 
 		opacity[idx] = opac*255;
 	      }
-	  }
+	}
 
       opFileManager.setSlice(z-minz, opacity);
       Global::progressBar()->setValue((int)(100*(float)(z-minz)/(float)lenz));
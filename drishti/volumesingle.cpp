@@ -7,13 +7,13 @@
 #include "prunehandler.h"
 #include "mainwindowui.h"
 #include "xmlheaderfunctions.h"
+#include "cropmask.h"
 
 #include <QFileDialog>
 #include <QInputDialog>
 
 void VolumeSingle::closePvlFileManager() { m_pvlFileManager.closeQFile(); }
 VolumeFileManager* VolumeSingle::pvlFileManager() { return &m_pvlFileManager; }
-VolumeFileManager* VolumeSingle::gradFileManager() { return &m_gradFileManager; }
 VolumeFileManager* VolumeSingle::lodFileManager() { return &m_lodFileManager; }
 
 Vec VolumeSingle::getSubvolumeMin() { return m_dataMin; }
@@ -63,6 +63,7 @@ VolumeSingle::VolumeSingle() :
 {
   m_repeatType = true;
   m_volnum = 0;
+  m_frameNumber = 0;
   m_dataMin = Vec(0,0,0);
   m_dataMax = Vec(0,0,0);
   
@@ -151,6 +152,9 @@ VolumeSingle::loadVolume(QList<QString> vfiles, bool redo)
   bool ok = VolumeBase::loadVolume(m_volumeFiles[0].toLatin1().data(),
 				   redo);
 
+  m_frameNumber = 0;
+  m_timestepCache.setVolumeFiles(m_volumeFiles, m_pvlVoxelType);
+
   //int bpv = 1;
   //if (m_pvlVoxelType > 0) bpv = 2;
   //m_sliceTemp = new uchar [bpv*m_width*m_height];
@@ -169,6 +173,7 @@ VolumeSingle::loadDummyVolume(int nx, int ny, int nz)
   m_dataMax = Vec(nx, ny, nz);
 
   m_volumeFiles.clear();
+  m_timestepCache.setVolumeFiles(m_volumeFiles, 0);
 
   VolumeInformation vInfo;
   VolumeInformation::setVolumeInformation(vInfo);
@@ -207,18 +212,8 @@ VolumeSingle::setBasicInformation(int volnum)
   RawVolume::setHeight(n_height);
   RawVolume::setSlabSize(slabSize);
 
-  QString vgfile = m_volumeFiles[volnum];
-  vgfile.chop(6);
-  vgfile += QString("grad");
-  vgfile = StaticFunctions::replaceDirectory(Global::tempDir(),
-					     vgfile);
-  m_gradFileManager.setBaseFilename(vgfile);
-  m_gradFileManager.setDepth(n_depth);
-  m_gradFileManager.setWidth(n_width);
-  m_gradFileManager.setHeight(n_height);
-  m_gradFileManager.setVoxelType(m_pvlVoxelType);
-  m_gradFileManager.setHeaderSize(13);
-  m_gradFileManager.setSlabSize(slabSize);
+  // gradients are evaluated from the pvl file on demand
+  m_gradient.setVolume(&m_pvlFileManager, m_pvlVoxelType);
   //---------------------------------------------------------
   //---------------------------------------------------------
 }
@@ -262,6 +257,7 @@ VolumeSingle::setSubvolume(Vec boxMin, Vec boxMax,
     }
 
   int volnum = timestepNumber(volnum1);  
+  m_frameNumber = volnum1;
 
 //  int n_depth, n_width, n_height;
 //  XmlHeaderFunctions::getDimensionsFromHeader(m_volumeFiles[volnum],
@@ -457,60 +453,22 @@ VolumeSingle::getSurfaceBitmask(int minx, int maxx,
 				int miny, int maxy,
 				int minz, int maxz)
 {
-  int bmx = maxx-minx+1;
-  int bmy = maxy-miny+1;
-
-  m_nonZeroVoxels = 0;
-
   MainWindowUI::mainWindowUI()->menubar->parentWidget()->\
     setWindowTitle(QString("Generating Surface Voxels"));
   Global::progressBar()->show();
+  Global::progressBar()->setValue(10);
 
-  QBitArray bitcopy = m_bitmask;
-  m_bitmask.fill(false);
-
-  int bidx = 0;
-  for(int k=minz; k<=maxz; k++)
-    {
-      Global::progressBar()->setValue((int)(100.0*(float)(k-minz)/(float)(maxz-minz+1)));
+  ComponentLabeller labeller;
+  labeller.label(m_bitmask,
+		 maxx-minx+1,
+		 maxy-miny+1,
+		 maxz-minz+1);
 
-      for(int y=miny; y<=maxy; y++)
-	for(int x=minx; x<=maxx; x++)
-	  {
-	    if (bitcopy.testBit(bidx))
-	      {
-		int k0 = qMax(k-1, minz);
-		int k1 = qMin(k+1, maxz);
-		int y0 = qMax(y-1, miny);
-		int y1 = qMin(y+1, maxy);
-		int x0 = qMax(x-1, minx);
-		int x1 = qMin(x+1, maxx);
+  m_bitmask = labeller.surfaceMask();
 
-		bool ok = true;
-		for(int k2=k0; k2<=k1; k2++)
-		  for(int y2=y0; y2<=y1; y2++)
-		    for(int x2=x0; x2<=x1; x2++)
-		      {
-			int idx = (k2-minz)*bmy*bmx +
-			          (y2-miny)*bmx +
-			          (x2-minx);
-			bool bc = bitcopy.testBit(idx);
-			ok &= bc;
-		      }
-	    
-		if (!ok)
-		  {
-		    m_bitmask.setBit(bidx);
-		    
-		    // count number of nonzero voxels
-		    // that will give us surface area
-		    m_nonZeroVoxels++;
-		  }
-	      }
-	    
-	    bidx ++;
-	  }
-    }
+  // count number of surface voxels
+  // that will give us surface area
+  m_nonZeroVoxels = labeller.surfaceVoxels();
 
   MainWindowUI::mainWindowUI()->menubar->parentWidget()->\
     setWindowTitle(QString("Drishti"));
@@ -528,10 +486,6 @@ VolumeSingle::createBitmask(int minx, int maxx,
 			    QList<CropObject> crops,
 			    QList<PathObject> paths)
 {
-  // -- check and generate gradient information
-  if (m_pvlVoxelType == 0)
-    checkGradients();
-
   MainWindowUI::mainWindowUI()->menubar->parentWidget()->\
     setWindowTitle(QString("Generating Non-Zero Voxels"));
   Global::progressBar()->show();
@@ -550,6 +504,12 @@ VolumeSingle::createBitmask(int minx, int maxx,
   
   m_nonZeroVoxels = 0;
 
+  CropMask cropMask;
+  cropMask.setScaling(voxelScaling);
+  cropMask.setClips(clipPos, clipNormal);
+  cropMask.setCrops(crops);
+  cropMask.setPaths(paths);
+
   int bidx = 0;
   for(int k=minz; k<=maxz; k++)
     {
@@ -563,7 +523,7 @@ VolumeSingle::createBitmask(int minx, int maxx,
 	  for(int t=0; t<nbytes; t++)
 	    vg[2*t] = vslice[t];
 
-	  vslice = m_gradFileManager.getSlice(k);
+	  vslice = m_gradient.getSlice(k);
 
 	  for(int t=0; t<nbytes; t++)
 	    vg[2*t+1] = vslice[t];
@@ -571,44 +531,21 @@ VolumeSingle::createBitmask(int minx, int maxx,
       else
 	memcpy(vg, vslice, 2*nbytes); // ushort
 
+      cropMask.evaluate(k, minx, maxx, miny, maxy);
       for(int y=miny; y<=maxy; y++)
-	for(int x=minx; x<=maxx; x++)
-	  {
-	    Vec po = Vec(x, y, k);
-	    po = VECPRODUCT(po, voxelScaling);
-
-	    bool ok = StaticFunctions::getClip(po, clipPos, clipNormal);
-
-	    if (ok)
-	      {
-		for(int ci=0; ci<crops.count(); ci++)
-		  {
-		    ok &= crops[ci].checkCropped(po);
-		    if (ok == false)
-		      break;
-		  }
-	      }
-	    if (ok)
-	      {
-		for(int ci=0; ci<paths.count(); ci++)
-		  {
-		    ok &= paths[ci].checkCropped(po);
-		    if (ok == false)
-		      break;
-		  }
-	      }
-
-
-	    // apply clipping
-	    if (ok)
+	{
+	  int *run;
+	  int nruns = cropMask.runs(y, run);
+	  for(int r=0; r<nruns; r++)
+	    for(int x=run[2*r]; x<=run[2*r+1]; x++)
 	      {
 		ushort v,g;
 		int idx = (y*m_height + x);
 		if (m_pvlVoxelType == 0)
-		{
-		  v = vg[2*idx];
-		  g = vg[2*idx+1];
-		}
+		  {
+		    v = vg[2*idx];
+		    g = vg[2*idx+1];
+		  }
 		else
 		  {
 		    v = ((ushort*)vg)[idx];
@@ -618,17 +555,15 @@ VolumeSingle::createBitmask(int minx, int maxx,
 		bool op = (lut[4*(256*g + v)+3] > 0);	   
 		if (op)
 		  {
-		    m_bitmask.setBit(bidx);
+		    m_bitmask.setBit(bidx + x-minx);
 		    
 		    // count number of nonzero voxels
 		    // that will give us volume
 		    m_nonZeroVoxels++;
-		    
 		  }
 	      }
-
-	    bidx++;
-	  }
+	  bidx += bmx;
+	}
     }
   
   delete [] vg;
@@ -643,91 +578,36 @@ void
 VolumeSingle::findConnectedRegion(QList<Vec> pos,
 				  int minx, int maxx,
 				  int miny, int maxy,
-				  int minz, int maxz,
-				  int bmx, int bmy,
-				  QList<Vec> clipPos,
-				  QList<Vec> clipNormal)
+				  int minz, int maxz)
 {
-  Vec voxelScaling = Global::voxelScaling();
-
+  // clipping has already been applied to m_bitmask
+  // by createBitmask, so seeds only pick components
   MainWindowUI::mainWindowUI()->menubar->parentWidget()->\
     setWindowTitle(QString("Identifying Connected Regions"));
   Global::progressBar()->show();
+  Global::progressBar()->setValue(10);
 
-  QBitArray bitcopy = m_bitmask;
-  m_bitmask.fill(false);
-
-  QList<Vec> seeds1;
-  QList<Vec> seeds2;
-  seeds1.clear();
-  seeds2.clear();
+  ComponentLabeller labeller;
+  labeller.label(m_bitmask,
+		 maxx-minx+1,
+		 maxy-miny+1,
+		 maxz-minz+1);
 
+  QList<int> labels;
   for(int pi=0; pi<pos.count(); pi++)
     {
-      Vec point = VECPRODUCT(pos[pi], voxelScaling);
-      // apply clipping
-      if (StaticFunctions::getClip(point, clipPos, clipNormal))
-	{
-	  int i = pos[pi].x;
-	  int j = pos[pi].y;
-	  int k = pos[pi].z;
-	  int idx = (k-minz)*bmy*bmx + (j-miny)*bmx + (i-minx);
-	  if (bitcopy.testBit(idx))
-	    {
-	      m_bitmask.setBit(idx);
-	      seeds2 << pos[pi];
-	    }
-	}
+      int lbl = labeller.labelAt((int)pos[pi].x-minx,
+				 (int)pos[pi].y-miny,
+				 (int)pos[pi].z-minz);
+      if (lbl >= 0 && !labels.contains(lbl))
+	labels << lbl;
     }
 
-  int di = 0;
+  m_bitmask = labeller.componentMask(labels);
 
-  seeds1 = seeds2;
-  seeds2.clear();
-  while (seeds1.count())
-    {
-      di = (++di)%100;
-      Global::progressBar()->setValue(di);
-      
-      for(int si=0; si<seeds1.count(); si++)
-	{
-	  int i = seeds1[si].x;
-	  int j = seeds1[si].y;
-	  int k = seeds1[si].z;
-
-	  int k0 = qMax(k-1, minz);
-	  int k1 = qMin(k+1, maxz);
-	  int y0 = qMax(j-1, miny);
-	  int y1 = qMin(j+1, maxy);
-	  int x0 = qMax(i-1, minx);
-	  int x1 = qMin(i+1, maxx);
-	      
-	  for(int k2=k0; k2<=k1; k2++)
-	    for(int y2=y0; y2<=y1; y2++)
-	      for(int x2=x0; x2<=x1; x2++)
-		{
-		  Vec po = Vec(x2, y2, k2);
-		  Vec point = VECPRODUCT(po, voxelScaling);
-		  // apply clipping
-		  if (StaticFunctions::getClip(point, clipPos, clipNormal))
-		    {
-		      int idx = (k2-minz)*bmy*bmx +
-			        (y2-miny)*bmx +
-			        (x2-minx);
-		      if (bitcopy.testBit(idx) &&
-			  !m_bitmask.testBit(idx))
-			{
-			  m_bitmask.setBit(idx);
-			  seeds2 << po;
-			}
-		    }
-	    }
-	}
-
-      seeds1 = seeds2;
-      seeds2.clear();
-
-    } // while (!done)
+  m_nonZeroVoxels = 0;
+  for(int i=0; i<labels.count(); i++)
+    m_nonZeroVoxels += labeller.component(labels[i]).voxels;
 
   MainWindowUI::mainWindowUI()->menubar->parentWidget()->\
     setWindowTitle(QString("Drishti"));
@@ -831,12 +711,6 @@ VolumeSingle::saveVolume(uchar *lut,
 	}
     }
   //----------------------------
-  if (!savePvl)
-    {
-      if (m_pvlVoxelType == 0)
-	checkGradients();
-    }
-
 
 
   MainWindowUI::mainWindowUI()->menubar->parentWidget()->\
@@ -918,6 +792,12 @@ VolumeSingle::saveVolume(uchar *lut,
   uchar *opacity = new uchar [2*ny*nx];
 
   Vec voxelScaling = Global::voxelScaling();
+  CropMask cropMask;
+  cropMask.setScaling(voxelScaling);
+  cropMask.setClips(clipPos, clipNormal);
+  cropMask.setCrops(crops);
+  cropMask.setPaths(paths);
+
   for(int k=minz; k<=maxz; k++)
     {
       Global::progressBar()->setValue((int)(100.0*(float)(k-minz)/(float)nz));
@@ -933,7 +813,7 @@ VolumeSingle::saveVolume(uchar *lut,
 	      for(int t=0; t<nbytes; t++)
 		vg[2*t] = vslice[t];
 	      
-	      vslice = m_gradFileManager.getSlice(k);
+	      vslice = m_gradient.getSlice(k);
 	      
 	      for(int t=0; t<nbytes; t++)
 		vg[2*t+1] = vslice[t];
@@ -945,99 +825,80 @@ VolumeSingle::saveVolume(uchar *lut,
 	memcpy(vg, vslice, 2*nbytes); // ushort
 
       int tag=0;
-      int idx=0;
       memset(opacity, 0, 2*ny*nx);
+      cropMask.evaluate(k, minx, maxx, miny, maxy);
       for(int y=miny; y<=maxy; y++)
-	for(int x=minx; x<=maxx; x++)
-	  { 
-	    Vec po = Vec(x, y, k);
-	    bool ok = true;
+	{
+	  int *run;
+	  int nruns = cropMask.runs(y, run);
+	  for(int r=0; r<nruns; r++)
+	    for(int x=run[2*r]; x<=run[2*r+1]; x++)
+	      {
+		int idx = (y-miny)*nx + (x-minx);
+		Vec po = Vec(x, y, k);
+		bool ok = true;
 
-	    // we don't want to scale it before pruning
-	    float mop = 0;
-	    {
-	      Vec pp = po - m_dataMin;
-	      int ppi = floor(pp.x)/lod;
-	      int ppj = floor(pp.y)/lod;
-	      int ppk = floor(pp.z)/lod;
-	      ppi = qMin(gridx-1,ppi);
-	      ppj = qMin(gridy-1,ppj);
-	      ppk = qMin(gridz-1,ppk);
-	      mop = prune[ppk*gridy*gridx + ppj*gridx + ppi];
-	      ok = (mop > 0);
-	      if (saveTagged)
+		// we don't want to scale it before pruning
+		float mop = 0;
 		{
-		  tag = tagData[ppk*gridy*gridx + ppj*gridx + ppi];
-		  ok &= (tag >= tagMin && tag <= tagMax);		    
+		  Vec pp = po - m_dataMin;
+		  int ppi = floor(pp.x)/lod;
+		  int ppj = floor(pp.y)/lod;
+		  int ppk = floor(pp.z)/lod;
+		  ppi = qMin(gridx-1,ppi);
+		  ppj = qMin(gridy-1,ppj);
+		  ppk = qMin(gridz-1,ppk);
+		  mop = prune[ppk*gridy*gridx + ppj*gridx + ppi];
+		  ok = (mop > 0);
+		  if (saveTagged)
+		    {
+		      tag = tagData[ppk*gridy*gridx + ppj*gridx + ppi];
+		      ok &= (tag >= tagMin && tag <= tagMax);		    
+		    }
 		}
-	    }
-	    mop /= 255.0;
-
-	    po = VECPRODUCT(po, voxelScaling);
+		mop /= 255.0;
 
-	    if (ok)
-	      ok = StaticFunctions::getClip(po, clipPos, clipNormal);
-
-	    if (ok)
-	      {
-		for(int ci=0; ci<crops.count(); ci++)
+		// apply clipping
+		if (ok)
 		  {
-		    ok &= crops[ci].checkCropped(po);
-		    if (ok == false)
-		      break;
-		  }
-	      }
-	    if (ok)
-	      {
-		for(int ci=0; ci<paths.count(); ci++)
-		  {
-		    ok &= paths[ci].checkCropped(po);
-		    if (ok == false)
-		      break;
-		  }
-	      }
-
-	    // apply clipping
-	    if (ok)
-	      {
-		int lx = (y*m_height + x);
-		if (savePvl)
-		  {
-		    if (m_pvlVoxelType == 0)
+		    int lx = (y*m_height + x);
+		    if (savePvl)
 		      {
-			if (saveTagged && saveTagValue)
-			  opacity[idx] = tag;
+			if (m_pvlVoxelType == 0)
+			  {
+			    if (saveTagged && saveTagValue)
+			      opacity[idx] = tag;
+			    else
+			      opacity[idx] = vg[lx];
+			  }
 			else
-			  opacity[idx] = vg[lx];
+			    if (saveTagged && saveTagValue)
+			      ((ushort*)opacity)[idx] = tag;
+			    else
+			      ((ushort*)opacity)[idx] = ((ushort*)vg)[lx];
 		      }
 		    else
+		      {
+			ushort v,g;
+			if (m_pvlVoxelType == 0)
+			  {
+			    v = vg[2*lx];
+			    g = vg[2*lx+1];
+			  }
+			else
+			  {
+			    v = ((ushort*)vg)[lx];
+			    g = v%256;
+			    v = v/256;
+			  }	      
 			if (saveTagged && saveTagValue)
-			  ((ushort*)opacity)[idx] = tag;
+			  opacity[idx] = tag;
 			else
-			  ((ushort*)opacity)[idx] = ((ushort*)vg)[lx];
-		  }
-		else
-		  {
-		    ushort v,g;
-		    if (m_pvlVoxelType == 0)
-		      {
-			v = vg[2*lx];
-			g = vg[2*lx+1];
+			  opacity[idx] = mop*lut[4*(256*g + v)+3];
 		      }
-		    else
-		      {
-			v = ((ushort*)vg)[lx];
-			g = v%256;
-			v = v/256;
-		      }	      
-		    if (saveTagged && saveTagValue)
-		      opacity[idx] = tag;
-		    else
-		      opacity[idx] = mop*lut[4*(256*g + v)+3];
 		  }
 	      }
-	    idx++;
-	  }
+	}
       opFileManager.setSlice(k-minz, opacity);
     }
   delete [] vg;
@@ -1257,6 +1118,7 @@ VolumeSingle::getSliceTextureSizeSlabs()
   m_dragTexture = new uchar[bpv*m_dragTexWidth*m_dragTexHeight];
   memset(m_dragTexture, 0, bpv*m_dragTexWidth*m_dragTexHeight);
 
+  requestTimesteps(slabinfo);
 
   MainWindowUI::mainWindowUI()->menubar->parentWidget()->\
     setWindowTitle(QString("Drishti"));
@@ -1307,6 +1169,9 @@ VolumeSingle::saveSubsampledVolume()
   m_lodFileManager.setVoxelType(m_pvlVoxelType);
   m_lodFileManager.setHeaderSize(13);
   m_lodFileManager.setSlabSize(lodslabSize);
+
+  // TimestepCache checks for lod volumes from its own thread
+  QMutexLocker lodLocker(TimestepCache::lodMutex());
   if (m_lodFileManager.exists())
     return;
   m_lodFileManager.createFile(true);
@@ -1395,368 +1260,107 @@ VolumeSingle::deleteTextureSlab()
   m_sliceTexture = 0;
 }
 
-uchar*
-VolumeSingle::getSliceTextureSlab(int minz, int maxz)
+SlabLayout
+VolumeSingle::slabLayout()
 {
-  int bpv = 1;
-  if (m_pvlVoxelType > 0) bpv = 2;
-
-  int minx = m_dataMin.x;
-  int miny = m_dataMin.y;
-  int lenx = m_subvolumeSize.x;
-  int leny = m_subvolumeSize.y;
-  int lenz = m_subvolumeSize.z;
-  int lenx2 = lenx/m_subvolumeSubsamplingLevel;
-  int leny2 = leny/m_subvolumeSubsamplingLevel;
-  int lenz2 = lenz/m_subvolumeSubsamplingLevel;
-
-  int ncols = m_texColumns;
-  int nrows = m_texRows;
-
-  int maxlenx2 = m_texWidth/m_texColumns;
-  int maxleny2 = m_texHeight/m_texRows;
-
-  memset(m_sliceTexture, 0, bpv*m_texWidth*m_texHeight);  
-
-  uchar *g0, *g1, *g2, *g3;
-  g0 = new uchar [bpv*m_maxWidth*m_maxHeight];
-  g1 = new uchar [bpv*m_maxWidth*m_maxHeight];
-  g2 = new uchar [bpv*m_maxWidth*m_maxHeight];
-  g3 = new uchar [bpv*m_maxWidth*m_maxHeight];
-
-  //-------- for dragTexure ---------------
-  int dtncols = m_dragTextureInfo.x;
-  int dtnrows = m_dragTextureInfo.y;
-  int dtlod = m_dragTextureInfo.z;
-  int dtminz = m_dataMin.z;
-  int dtlenx2 = lenx/dtlod;
-  int dtleny2 = leny/dtlod;
-  int dtlenz2 = lenz/dtlod;
-  float stp = (float)dtlod/(float)m_subvolumeSubsamplingLevel;
-  int dtmaxlenx2 = m_dragTexWidth/dtncols;
-  int dtmaxleny2 = m_dragTexHeight/dtnrows;
-  uchar *tmp = new uchar[bpv*dtlenx2*dtleny2];
-
-  //---------------------------------------------------------
-  if (m_subvolumeSubsamplingLevel > 1)
-    {
-      int kmin = minz/m_subvolumeSubsamplingLevel;
-      int kmax = maxz/m_subvolumeSubsamplingLevel;
-
-      int leni2 = m_height/m_subvolumeSubsamplingLevel;
-      int lenj2 = m_width/m_subvolumeSubsamplingLevel;
-      int lenk2 = m_depth/m_subvolumeSubsamplingLevel;
-
-      int imin = minx/m_subvolumeSubsamplingLevel;
-      int jmin = miny/m_subvolumeSubsamplingLevel;
-
-      int kbytes = bpv*leni2*lenj2;
-
-      int kslc = 0;
-
-      int offD = m_offD/m_subvolumeSubsamplingLevel;
-      int offW = m_offW/m_subvolumeSubsamplingLevel;
-      int offH = m_offH/m_subvolumeSubsamplingLevel;
-
-      int maxHsl = m_maxHeight/m_subvolumeSubsamplingLevel;
-      int maxWsl = m_maxWidth/m_subvolumeSubsamplingLevel;
-
-      uchar *sliceTemp1 = new uchar [bpv*maxWsl*maxHsl];
-
-      // additional slice at the top and bottom
-      for(int k0=kmin-1; k0<=kmax+1; k0++)
-	{
-	  int k = k0 - offD; // shift slice by given depth offset
-
-	  if (k >= 0 && k<lenk2)
-	    {
-	      uchar *vslice = m_lodFileManager.getSlice(k);
-	      memcpy(m_sliceTemp, vslice, kbytes);
-	    }
-	  else
-	    {
-	      memset(m_sliceTemp, 0, kbytes);
-	    }
-
-	  //---
-	  memset(sliceTemp1, 0, bpv*maxWsl*maxHsl);
-	  for(int j=0; j<lenj2; j++)
-	    memcpy(sliceTemp1 + bpv*((j+offW)*maxHsl + offH),
-		   m_sliceTemp + bpv*j*leni2,
-		   bpv*leni2);
-	  
-	  for(int j=0; j<leny2; j++)
-	    memcpy(m_sliceTemp + bpv*j*lenx2,
-		   sliceTemp1 + bpv*((j+jmin)*maxHsl + imin),
-		   bpv*lenx2);
-	  
-	  int col = (k0-kmin+1)%ncols;
-	  int row = (k0-kmin+1)/ncols; 
-	  if (row == nrows && col > 0)
-	    QMessageBox::information(0, "ERROR", QString("row, col ?? %1 %2 , %3").\
-				     arg(row).arg(nrows).arg(col));
-	  int grow = row*maxleny2;
-	  for(int j=0; j<leny2; j++)
-	    memcpy(m_sliceTexture + bpv*(col*maxlenx2 +
-					 (grow+j)*m_texWidth),
-		   m_sliceTemp + bpv*j*lenx2,
-		   bpv*lenx2);
-	  //---
-
-
-	  memcpy(g2, m_sliceTemp, bpv*lenx2*leny2);
-	  memset(tmp, 0, bpv*dtlenx2*dtleny2);
-
-	  //-------- form dragTexure ---------------
-	  if (k >= (int)(m_dataMin.z/m_subvolumeSubsamplingLevel) &&
-	      k <= (int)(m_dataMax.z/m_subvolumeSubsamplingLevel))
-	    {
-	      int ji=0;
-	      if (bpv == 1)
-		{
-		  for(int j=0; j<dtleny2; j++)
-		    { 
-		      int y = j*stp;
-		      for(int i=0; i<dtlenx2; i++) 
-			{ 
-			  int x = i*stp; 
-			  tmp[ji] = g2[y*lenx2+x];
-			  ji++;
-			}
-		    }
-		}
-	      else
-		{
-		  for(int j=0; j<dtleny2; j++)
-		    { 
-		      int y = j*stp;
-		    for(int i=0; i<dtlenx2; i++) 
-		      { 
-			int x = i*stp; 
-			((ushort*)tmp)[ji] = ((ushort*)g2)[y*lenx2+x];
-			ji++;
-		      }
-		  }
-		}
-
-	      int dtkslc = qBound(0,
-				  (int)((k0-(m_dataMin.z/m_subvolumeSubsamplingLevel))/stp),
-				  dtlenz2-1);
-	      int col = dtkslc%dtncols;
-	      int row = dtkslc/dtncols; 	      
-	      int grow = row*dtmaxleny2;
-	      for(int j=0; j<dtleny2; j++)
-		memcpy(m_dragTexture + bpv*(col*dtmaxlenx2 +
-					    (grow+j)*m_dragTexWidth),
-		       tmp + bpv*(j*dtlenx2),
-		       bpv*dtlenx2);
-	    }
-	  //---------------------------------------
-
-	  if (bpv == 1)
-	    {
-	      for(int j=0; j<lenx2*leny2; j++)
-		m_flhist1D[g2[j]]++;
-
-	      if (kslc >= 2)
-		{
-		  for(int j=1; j<leny2-1; j++)
-		    for(int i=1; i<lenx2-1; i++)
-		      {
-			int gx = g1[j*lenx2+(i+1)] - g1[j*lenx2+(i-1)];
-			int gy = g1[(j+1)*lenx2+i] - g1[(j-1)*lenx2+i];
-			int gz = g2[j*lenx2+i] - g0[j*lenx2+i];
-			int gsum = sqrtf(gx*gx+gy*gy+gz*gz);
-			gsum = qBound(0, gsum, 255);
-			int v = g1[j*lenx2+i];
-			m_flhist2D[gsum*256 + v]++;
-		      }
-		}
-	    }
-	  else
-	    {
-	      for(int j=0; j<lenx2*leny2; j++)
-		m_flhist1D[((ushort*)g2)[j]/256]++;
-
-	      if (kslc >= 2)
-		{
-		  for(int j=1; j<leny2-1; j++)
-		    for(int i=1; i<lenx2-1; i++)
-		      {
-			int gx = ((ushort*)g1)[j*lenx2+(i+1)] -
-			         ((ushort*)g1)[j*lenx2+(i-1)];
-			int gy = ((ushort*)g1)[(j+1)*lenx2+i] -
-			         ((ushort*)g1)[(j-1)*lenx2+i];
-			int gz = ((ushort*)g2)[j*lenx2+i] -
-			         ((ushort*)g0)[j*lenx2+i];
-			int gsum = sqrtf(gx*gx+gy*gy+gz*gz);
-			gsum = qBound(0, gsum/256, 255);
-			int v = ((ushort*)g1)[j*lenx2+i]/256;
-			m_flhist2D[gsum*256 + v]++;
-		      }
-		}
-	    }
-
-	  
-	  uchar *gt = g0;
-	  g0 = g1;
-	  g1 = g2;
-	  g2 = gt;
+  SlabLayout sl;
+  sl.bpv = (m_pvlVoxelType > 0) ? 2 : 1;
+  sl.subsamplingLevel = m_subvolumeSubsamplingLevel;
+  sl.dataMin = m_dataMin;
+  sl.dataMax = m_dataMax;
+  sl.subvolumeSize = m_subvolumeSize;
+  sl.maxHeight = m_maxHeight;
+  sl.maxWidth = m_maxWidth;
+  sl.maxDepth = m_maxDepth;
+  sl.texWidth = m_texWidth;
+  sl.texHeight = m_texHeight;
+  sl.texColumns = m_texColumns;
+  sl.texRows = m_texRows;
+  sl.dragTextureInfo = m_dragTextureInfo;
+  sl.dragTexWidth = m_dragTexWidth;
+  sl.dragTexHeight = m_dragTexHeight;
+
+  return sl;
+}
 
-	  kslc ++;
-	}
+void
+VolumeSingle::setTimestepPrefetch(int nsteps, int mb)
+{
+  m_timestepCache.setPrefetch(nsteps, mb);
+}
 
-      delete [] g0;
-      delete [] g1;
-      delete [] g2;
-      delete [] g3;
-      delete [] tmp;
-      delete [] sliceTemp1;
+QString
+VolumeSingle::timestepCacheStatistics()
+{
+  return m_timestepCache.statistics();
+}
 
-      return m_sliceTexture;
-    }
-  //---------------------------------------------------------
+void
+VolumeSingle::requestTimesteps(QList<Vec> slabinfo)
+{
+  if (m_timestepCache.prefetch() <= 0 ||
+      m_volumeFiles.count() < 2)
+    return;
 
+  m_timestepCache.frameShown();
 
-  //---------------------------------------------------------
-  //m_subvolumeSubsamplingLevel == 1
-  //---------------------------------------------------------
-  int nbytes = bpv*m_width*m_height;
-  int kslc = 0;
+  // first entry is drag texture information when there are multiple slabs
+  QList<Vec> slabs = slabinfo;
+  if (slabs.count() > 1)
+    slabs.removeFirst();
 
-  uchar *sliceTemp1 = new uchar [bpv*m_maxWidth*m_maxHeight];
+  m_timestepCache.setLayout(slabLayout(), slabs,
+			    m_lodFileManager.slabSize(),
+			    Global::tempDir());
 
-  // additional slice at the top and bottom
-  //-------------------------------------------------------
-  for(int k0=minz-1; k0<=maxz+1; k0++)
+  // upcoming timesteps follow cycle/wave repeat type
+  QList<int> vnums;
+  for(int i=1; i<=m_timestepCache.prefetch(); i++)
     {
-      int k = k0 - m_offD; // shift slice by given depth offset
-      
-      if (k >= 0 && k < m_depth)
-	{
-	  uchar *vslice = m_pvlFileManager.getSlice(k);
-	  memcpy(m_sliceTemp, vslice, nbytes);
-	}
-      else
-	{
-	  memset(m_sliceTemp, 0, nbytes);
-	}
-
-      //---
-      memset(sliceTemp1, 0, bpv*m_maxWidth*m_maxHeight);
-      for(int j=0; j<m_width; j++)
-	memcpy(sliceTemp1 + bpv*((j+m_offW)*m_maxHeight + m_offH),
-	       m_sliceTemp + bpv*j*m_height,
-	       bpv*m_height);
-
-      for(int j=0; j<leny2; j++)
-	memcpy(m_sliceTemp + bpv*j*lenx2,
-	       sliceTemp1 + bpv*((j+miny)*m_maxHeight + minx),
-	       bpv*lenx2);
+      int vn = timestepNumber(m_frameNumber+i);
+      if (vn != m_volnum && !vnums.contains(vn))
+	vnums << vn;
+    }
 
-      int col = (k0-minz+1)%ncols;
-      int row = (k0-minz+1)/ncols; 
-      if (row == nrows && col > 0)
-	QMessageBox::information(0, "ERROR", QString("row, col ?? %1 %2 , %3").	\
-				 arg(row).arg(nrows).arg(col));      
-      int grow = row*maxleny2;
-      for(int j=0; j<leny2; j++)
-	memcpy(m_sliceTexture + bpv*(col*maxlenx2 +
-				     (grow+j)*m_texWidth),
-	       m_sliceTemp + bpv*j*lenx2,
-	       bpv*lenx2);
-      //---
-      
-      memcpy(g2, m_sliceTemp, bpv*lenx2*leny2);
+  m_timestepCache.requestTimesteps(m_volnum, vnums);
+}
 
-      //-------- form dragTexure ---------------
-      if (k >= (int)m_dataMin.z && k <= (int)m_dataMax.z)
-	{
-	  int ji=0;
-	  if (bpv == 1)
-	    {
-	      for(int j=0; j<dtleny2; j++)
-		{ 
-		  int y = j*stp;
-		  for(int i=0; i<dtlenx2; i++) 
-		    { 
-		      int x = i*stp; 
-		      tmp[ji] = g2[y*lenx2+x];
-		      ji++;
-		    }
-		}
-	    }
-	  else
-	    {
-	      for(int j=0; j<dtleny2; j++)
-		{ 
-		  int y = j*stp;
-		  for(int i=0; i<dtlenx2; i++) 
-		    { 
-		      int x = i*stp; 
-		      ((ushort*)tmp)[ji] = ((ushort*)g2)[y*lenx2+x];
-		      ji++;
-		    }
-		}
-	    }
-	  
-	  int dtkslc = qMin(dtlenz2-1, (int)((k0-(int)m_dataMin.z)/stp));
-	  int col = dtkslc%dtncols;
-	  int row = dtkslc/dtncols; 	      
-	  int grow = row*dtmaxleny2;
-	  for(int j=0; j<dtleny2; j++)
-	    memcpy(m_dragTexture + bpv*(col*dtmaxlenx2 +
-					(grow+j)*m_dragTexWidth),
-		   tmp + bpv*(j*dtlenx2),
-		   bpv*dtlenx2);
-	}
-      //---------------------------------------
+uchar*
+VolumeSingle::getSliceTextureSlab(int minz, int maxz)
+{
+  if (! prepareSliceTextureSlab(minz, maxz, m_sliceTexture))
+    QMessageBox::information(0, "ERROR",
+			     QString("row, col ?? slab %1 %2 : %3 rows %4 cols").\
+			     arg(minz).arg(maxz).arg(m_texRows).arg(m_texColumns));
 
-      if (bpv == 1)
-	{
-	  for(int j=0; j<lenx2*leny2; j++)
-	    m_flhist1D[g2[j]]++;
-	  
-	  if (kslc >= 2)
-	    {
-	      for(int j=1; j<leny2-1; j++)
-		for(int i=1; i<lenx2-1; i++)
-		  {
-		    int gx = g1[j*lenx2+(i+1)] - g1[j*lenx2+(i-1)];
-		    int gy = g1[(j+1)*lenx2+i] - g1[(j-1)*lenx2+i];
-		    int gz = g2[j*lenx2+i] - g0[j*lenx2+i];
-		    int gsum = sqrtf(gx*gx+gy*gy+gz*gz);
-		    gsum = qBound(0, gsum, 255);
-		    int v = g1[j*lenx2+i];
-		    m_flhist2D[gsum*256 + v]++;
-		  }	  
-	    }
-	}
-      else
-	{
-	  for(int j=0; j<lenx2*leny2; j++)
-	    m_flhist1D[((ushort*)g2)[j]/256]++;
-	  
-	  for(int j=0; j<lenx2*leny2; j++)
-	    m_flhist2D[((ushort*)g2)[j]]++;
-	}
- 
-      uchar *gt = g0;
-      g0 = g1;
-      g1 = g2;
-      g2 = gt;
+  return m_sliceTexture;
+}
 
-      kslc ++;
-    }
+//---------------------------------------
+// fills the given slab sized buffer, also updates the drag texture
+// and histograms.  does not touch the gui so it may be called from
+// a loader thread as long as only one slab is prepared at a time.
+// the buffer may be swapped for one prepared by the timestep cache.
+//---------------------------------------
+bool
+VolumeSingle::prepareSliceTextureSlab(int minz, int maxz,
+				      uchar* &sliceTexture)
+{
+  // just swap in the slab if it was prepared in the background
+  if (m_timestepCache.fetchSlab(m_volnum, minz, maxz,
+				sliceTexture, m_dragTexture,
+				m_flhist1D, m_flhist2D))
+    return true;
 
-  delete [] g0;
-  delete [] g1;
-  delete [] g2;
-  delete [] g3;
-  delete [] tmp;
-  delete [] sliceTemp1;
+  VolumeFileManager *vfm = &m_pvlFileManager;
+  if (m_subvolumeSubsamplingLevel > 1)
+    vfm = &m_lodFileManager;
 
-  return m_sliceTexture;
+  return TimestepCache::buildSlab(slabLayout(), vfm,
+				  m_depth, m_width, m_height,
+				  minz, maxz,
+				  sliceTexture, m_dragTexture,
+				  m_flhist1D, m_flhist2D);
 }
 
 void
@@ -1840,6 +1444,8 @@ VolumeSingle::calculateGradientsForDragTexture()
   memset(g1, 0, bpv*m_maxWidth*m_maxHeight);
   memset(g2, 0, bpv*m_maxWidth*m_maxHeight);
 
+  uchar *gm = new uchar [m_maxWidth*m_maxHeight];
+
   //-----
   // for drag histogram calculation
   memset(m_flhist1D, 0, 256*4);
@@ -1866,15 +1472,14 @@ VolumeSingle::calculateGradientsForDragTexture()
 	{
 	  if (bpv == 1)
 	    {
+	      GradientProvider::gradientMagnitude(g0, g1, g2,
+						  lenx2, leny2, 1,
+						  gm);
 	      for(int j=1; j<leny2-1; j++)
 		for(int i=1; i<lenx2-1; i++)
 		  {
 		    int idx = j*lenx2+i;
-		    int gx = g1[idx+1] - g1[idx-1];
-		    int gy = g1[(j+1)*lenx2+i] - g1[(j-1)*lenx2+i];
-		    int gz = g2[idx] - g0[idx];
-		    int g = sqrtf(gx*gx+gy*gy+gz*gz);
-		    g = qBound(0, g, 255);
+		    int g = gm[idx];
 		    int v = m_sliceTemp[idx];
 		    m_flhist1D[v]++;
 		    m_flhist2D[g*256 + v]++;
@@ -1908,6 +1513,7 @@ VolumeSingle::calculateGradientsForDragTexture()
   delete [] g0;
   delete [] g1;
   delete [] g2;
+  delete [] gm;
 
   //-----
   // for drag histogram calculation
@@ -1933,160 +1539,6 @@ VolumeSingle::calculateGradientsForDragTexture()
   Global::hideProgressBar();
 }
 
-void
-VolumeSingle::checkGradients()
-{
-  //---- check with grad file manager -------------
-  int n_depth, n_width, n_height;
-  int slabSize;
-  XmlHeaderFunctions::getDimensionsFromHeader(m_volumeFiles[m_volnum],
-					      n_depth, n_width, n_height);
-  slabSize = XmlHeaderFunctions::getSlabsizeFromHeader(m_volumeFiles[m_volnum]);
-
-  QString vgfile = m_volumeFiles[m_volnum];
-  vgfile.chop(6);
-  vgfile += QString("grad");
-  vgfile = StaticFunctions::replaceDirectory(Global::tempDir(),
-					     vgfile);
-  m_gradFileManager.setBaseFilename(vgfile);
-  m_gradFileManager.setDepth(n_depth);
-  m_gradFileManager.setWidth(n_width);
-  m_gradFileManager.setHeight(n_height);
-  m_gradFileManager.setVoxelType(m_pvlVoxelType);
-  m_gradFileManager.setHeaderSize(13);
-  m_gradFileManager.setSlabSize(slabSize);
-  if (! m_gradFileManager.exists())
-    createGradVolume();
-}
-
-
-void
-VolumeSingle::createGradVolume()
-{
-  int bpv = 1;
-  if (m_pvlVoxelType > 0) bpv = 2;
-
-  //---- create grad file manager -------------
-  int n_depth, n_width, n_height;
-  int slabSize;
-  XmlHeaderFunctions::getDimensionsFromHeader(m_volumeFiles[m_volnum],
-					      n_depth, n_width, n_height);
-  slabSize = XmlHeaderFunctions::getSlabsizeFromHeader(m_volumeFiles[m_volnum]);
-
-
-  MainWindowUI::mainWindowUI()->menubar->parentWidget()->\
-    setWindowTitle(QString("Allocating space for gradient values on disk"));
-
-  QString vgfile = m_volumeFiles[m_volnum];
-  vgfile.chop(6);
-  vgfile += QString("grad");
-  vgfile = StaticFunctions::replaceDirectory(Global::tempDir(),
-					     vgfile);
-  m_gradFileManager.setBaseFilename(vgfile);
-  m_gradFileManager.setDepth(n_depth);
-  m_gradFileManager.setWidth(n_width);
-  m_gradFileManager.setHeight(n_height);
-  m_gradFileManager.setVoxelType(m_pvlVoxelType);
-  m_gradFileManager.setHeaderSize(13);
-  m_gradFileManager.setSlabSize(slabSize);
-  m_gradFileManager.createFile(true);
-  //-------------------------------------------
-
-  int minx = 0;
-  int miny = 0;
-  int minz = 0;
-  int maxx = m_height;
-  int maxy = m_width;
-  int maxz = m_depth;
-
-  int lenx = m_height;
-  int leny = m_width;
-  int lenz = m_depth;
-  
-  MainWindowUI::mainWindowUI()->menubar->parentWidget()->\
-    setWindowTitle(QString("Saving gradient magnitude volume"));
-  Global::progressBar()->show();
-  qApp->processEvents();
-
-
-  int nbytes = bpv*m_width*m_height;
-  uchar *tmp, *g0, *g1, *g2;
-  tmp = new uchar [nbytes];
-  g0  = new uchar [nbytes];
-  g1  = new uchar [nbytes];
-  g2  = new uchar [nbytes];
-
-  memset(g0, 0, nbytes);
-  memset(g1, 0, nbytes);
-  memset(g2, 0, nbytes);
-
-  for(int kslc=0; kslc<m_depth; kslc++)
-    {
-      Global::progressBar()->setValue((int)(100.0*(float)kslc/(float)m_depth));
-      if (kslc%100==0) qApp->processEvents();
-
-      uchar *vslice;
-      vslice = m_pvlFileManager.getSlice(kslc);
-
-      memcpy(g2, vslice, nbytes);
-
-      memset(tmp, 0, nbytes);
-
-      if (kslc >= 2)
-	{
-	  if (bpv == 1)
-	    {
-	      for(int j=1; j<m_width-1; j++)
-		for(int i=1; i<m_height-1; i++)
-		  {
-		    int gx = g1[j*m_height+(i+1)] - g1[j*m_height+(i-1)];
-		    int gy = g1[(j+1)*m_height+i] - g1[(j-1)*m_height+i];
-		    int gz = g2[j*m_height+i] - g0[j*m_height+i];
-		    int gsum = sqrtf(gx*gx+gy*gy+gz*gz);
-		    gsum = qBound(0, gsum, 255);
-		    tmp[j*m_height+i] = gsum;
-		  }
-	    }
-	  else
-	    {
-	      for(int j=1; j<m_width-1; j++)
-		for(int i=1; i<m_height-1; i++)
-		  {
-		    int gx = ((ushort*)g1)[j*m_height+(i+1)] -
-		             ((ushort*)g1)[j*m_height+(i-1)];
-		    int gy = ((ushort*)g1)[(j+1)*m_height+i] -
-		             ((ushort*)g1)[(j-1)*m_height+i];
-		    int gz = ((ushort*)g2)[j*m_height+i] -
-		             ((ushort*)g0)[j*m_height+i];
-		    int gsum = sqrtf(gx*gx+gy*gy+gz*gz);
-		    //gsum = qBound(0, gsum, 255);
-		    ((ushort*)tmp)[j*m_height+i] = gsum;
-		  }
-	    }
-	}
-
-      if (kslc==0 || kslc==m_depth-1) // first or last slice
-	m_gradFileManager.setSlice(kslc, tmp);
-      else
-	m_gradFileManager.setSlice(kslc-1, tmp);
-
-      uchar *gt = g0;
-      g0 = g1;
-      g1 = g2;
-      g2 = gt;
-    }
-
-  delete [] tmp;
-  delete [] g0;
-  delete [] g1;
-  delete [] g2;
-
-  MainWindowUI::mainWindowUI()->menubar->parentWidget()->\
-    setWindowTitle(QString("Drishti"));
-  Global::progressBar()->setValue(100);
-  Global::hideProgressBar();
-}
-
 void
 VolumeSingle::saveSliceImage(Vec pos,
 			     Vec normal, Vec xaxis, Vec yaxis,
@@ -2454,13 +1906,6 @@ VolumeSingle::getThicknessProfile(int searchType,
   QList<float> thickness;
   QList<Vec> tcrd;
 
-//-----------------------------
-//  do not use gradient information
-//  use only voxel intensity information
-//  // -- check and generate gradient information
-//  checkGradients();
-//-----------------------------
-
   Vec voxelScaling = Global::voxelScaling();
 
   for(int p=0; p<voxel.count(); p++)
@@ -2517,7 +1962,6 @@ VolumeSingle::getThicknessProfile(int searchType,
 //-----------------------------
 //	      do not use gradient information
 //            use only voxel intensity information
-//	      g = (ushort)*m_gradFileManager.rawValue(d, w, h);
 //-----------------------------
 
 	      if (m_pvlVoxelType > 0) // modify v & g
@@ -2594,13 +2038,6 @@ VolumeSingle::stickToSurface(uchar *lut,
 			     int rad,
 			     QList< QPair<Vec,Vec> > pn)
 {
-//-----------------------------
-//  do not use gradient information
-//  use only voxel intensity information
-//  // -- check and generate gradient information
-//  checkGradients();
-//-----------------------------
-
   Vec voxelScaling = Global::voxelScaling();
 
   QList<Vec> pts;
@@ -2652,7 +2089,6 @@ VolumeSingle::stickToSurface(uchar *lut,
 //-----------------------------
 //	      do not use gradient information
 //            use only voxel intensity information
-//	      g = *m_gradFileManager.rawValue(d, w, h);
 //-----------------------------
 	  
 	      if (m_pvlVoxelType > 0) // modify v & g
@@ -2712,19 +2148,12 @@ VolumeSingle::countIsolatedRegions(uchar *lut,
 				   QList<CropObject> crops,
 				   QList<PathObject> paths)
 {
-  MainWindowUI::mainWindowUI()->menubar->parentWidget()->\
-    setWindowTitle(QString("Counting Isolated Regions"));
-  Global::progressBar()->show();
-  
   int minx = m_dataMin.x;
   int maxx = m_dataMax.x;
   int miny = m_dataMin.y;
   int maxy = m_dataMax.y;
   int minz = m_dataMin.z;
   int maxz = m_dataMax.z;
-  int lenx = m_subvolumeSize.x;
-  int leny = m_subvolumeSize.y;
-  int lenz = m_subvolumeSize.z;
 
   createBitmask(minx, maxx,
 		miny, maxy,
@@ -2734,82 +2163,38 @@ VolumeSingle::countIsolatedRegions(uchar *lut,
 		crops,
 		paths);
 
-  
+  MainWindowUI::mainWindowUI()->menubar->parentWidget()->\
+    setWindowTitle(QString("Counting Isolated Regions"));
   Global::progressBar()->show();
+  Global::progressBar()->setValue(10);
 
-  QBitArray bitcopy = m_bitmask;
-  int ncells = 0;
-  bool done = false;
-  while (!done)
-    {
-      bool gotseed = false;
-      Vec pos;
-      int bidx = 0;
-      for(int z=minz; z<=maxz; z++)
-	for(int y=miny; y<=maxy; y++)
-	  for(int x=minx; x<=maxx; x++)
-	    {
-	      if (bitcopy.testBit(bidx))
-		{
-		  bitcopy.clearBit(bidx);
-		  gotseed = true;
-		  pos = Vec(x,y,z);
-		  z = maxz+1;
-		  y = maxy+1;
-		  x = maxx+1;
-		  break;
-		}
-	      bidx ++;
-	    }
-
-
-      if (!gotseed)
-	{
-	  done = true;
-	  break;
-	}
-
-      ncells ++;
+  ComponentLabeller labeller;
+  labeller.label(m_bitmask,
+		 maxx-minx+1,
+		 maxy-miny+1,
+		 maxz-minz+1);
 
-      QStack<Vec> posStack;
-      posStack.push(pos);
-      int pb = 0;
-      while(!posStack.isEmpty())
-	{
-	  Global::progressBar()->setValue(pb*0.1);
-	  if (pb%10==0) qApp->processEvents();
-
-	  pb = pb%1000;
-
-	  pos = posStack.pop();
-	  int x = pos.x;
-	  int y = pos.y;
-	  int z = pos.z;
-
-	  int z0 = qMax(z-1, minz);
-	  int z1 = qMin(z+1, maxz);
-	  int y0 = qMax(y-1, miny);
-	  int y1 = qMin(y+1, maxy);
-	  int x0 = qMax(x-1, minx);
-	  int x1 = qMin(x+1, maxx);
-	      
-	  for(int z2=z0; z2<=z1; z2++)
-	    for(int y2=y0; y2<=y1; y2++)
-	      for(int x2=x0; x2<=x1; x2++)
-		{
-		  int idx = z2*leny*lenx + y2*lenx + x2;
-		  if (bitcopy.testBit(idx))
-		    {
-		      bitcopy.clearBit(idx);
-		      Vec po = Vec(x2, y2, z2);
-		      posStack.push(po);
-		    }
-		}
-	} // while (!posStack.isEmpty())
-    } // while (!done)
+  int ncells = labeller.count();
+  int largest = -1;
+  for(int i=0; i<ncells; i++)
+    if (largest < 0 ||
+	labeller.component(i).voxels > labeller.component(largest).voxels)
+      largest = i;
 
+  MainWindowUI::mainWindowUI()->menubar->parentWidget()->\
+    setWindowTitle(QString("Drishti"));
   Global::progressBar()->setValue(100);
   Global::hideProgressBar();
 
-  QMessageBox::information(0, "", QString("Number of cells : %1").arg(ncells));
+  QString str = QString("Number of cells : %1").arg(ncells);
+  if (largest >= 0)
+    {
+      ComponentLabeller::Component c = labeller.component(largest);
+      Vec cen = c.centroid + Vec(minx, miny, minz);
+      str += QString("\nLargest cell : %1 voxels (%2 surface)").\
+	     arg(c.voxels).arg(c.surfaceVoxels);
+      str += QString("\nLargest cell centroid : %1 %2 %3").\
+	     arg(cen.x).arg(cen.y).arg(cen.z);
+    }
+  QMessageBox::information(0, "", str);
 }
@@ -8,6 +8,9 @@
 #include "volumefilemanager.h"
 #include "cropobject.h"
 #include "pathobject.h"
+#include "timestepcache.h"
+#include "componentlabeller.h"
+#include "gradientprovider.h"
 
 #include <QGLViewer/qglviewer.h>
 using namespace qglviewer;
@@ -20,7 +23,6 @@ class VolumeSingle : public VolumeBase
 
   void closePvlFileManager();
   VolumeFileManager* pvlFileManager();
-  VolumeFileManager* gradFileManager();
   VolumeFileManager* lodFileManager();
 
   void forMultipleVolumes(int,
@@ -44,6 +46,7 @@ class VolumeSingle : public VolumeBase
 
   QList<Vec> getSliceTextureSizeSlabs();
   uchar* getSliceTextureSlab(int, int);
+  bool prepareSliceTextureSlab(int, int, uchar*&);
   void deleteTextureSlab();
 
   bool loadVolume(QList<QString>, bool);
@@ -52,6 +55,9 @@ class VolumeSingle : public VolumeBase
   void setRepeatType(bool);
   int actualVolumeNumber(int);
 
+  void setTimestepPrefetch(int, int);
+  QString timestepCacheStatistics();
+
   bool setSubvolume(Vec, Vec,
 		    int subsamplingLevel = 0,
 		    int volnum1 = 0,
@@ -117,7 +123,7 @@ class VolumeSingle : public VolumeBase
 
  private :
   VolumeFileManager m_pvlFileManager;
-  VolumeFileManager m_gradFileManager;
+  GradientProvider m_gradient;
   VolumeFileManager m_lodFileManager;
 
   float *m_flhist1D, *m_flhist2D;
@@ -145,12 +151,15 @@ class VolumeSingle : public VolumeBase
   QBitArray m_bitmask;
 
   int m_volnum;
+  int m_frameNumber;
   QList<QString> m_volumeFiles;
   
   bool m_repeatType;
 
   QMutex m_mutex;
 
+  TimestepCache m_timestepCache;
+
   void createBitmask(int, int,
 		     int, int,
 		     int, int,
@@ -166,20 +175,18 @@ class VolumeSingle : public VolumeBase
   void findConnectedRegion(QList<Vec>,
 			   int, int,
 			   int, int,
-			   int, int,
-			   int, int,
-			   QList<Vec>,
-			   QList<Vec>);
+			   int, int);
 
   void saveSubsampledVolume();
   void createSubsampledVolume();
 
-  void checkGradients();
-  void createGradVolume();
 
   void calculateGradientsForDragTexture();
 
   void setBasicInformation(int);
+
+  SlabLayout slabLayout();
+  void requestTimesteps(QList<Vec>);
 };
 
 #endif
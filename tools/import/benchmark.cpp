@@ -0,0 +1,181 @@
+#include "benchmark.h"
+#include "benchmarkdata.h"
+#include "raw2pvl.h"
+#include "volumefilemanager.h"
+
+#include <QDir>
+#include <QElapsedTimer>
+
+#include <string.h>
+
+static int
+bytesPerVoxel(int voxelType)
+{
+  if (voxelType == Raw2Pvl::_UShort) return 2;
+  if (voxelType == Raw2Pvl::_Float) return 4;
+  return 1;
+}
+
+static QString
+typeName(int voxelType)
+{
+  if (voxelType == Raw2Pvl::_UShort) return "ushort";
+  if (voxelType == Raw2Pvl::_Float) return "float";
+  return "uchar";
+}
+
+int
+Benchmark::run(QStringList args)
+{
+  QList<int> sizes;
+  for(int i=0; i<args.count(); i++)
+    {
+      bool ok;
+      int n = args[i].toInt(&ok);
+      if (ok && n >= 8)
+	sizes << n;
+    }
+  if (sizes.count() == 0)
+    sizes << 64 << 128 << 256;
+
+  QList<int> types;
+  types << Raw2Pvl::_UChar << Raw2Pvl::_UShort << Raw2Pvl::_Float;
+
+  QTextStream out(stdout);
+
+  for(int s=0; s<sizes.count(); s++)
+    for(int t=0; t<types.count(); t++)
+      {
+	meanFilter(out, types[t], sizes[s], 1);
+	meanFilter(out, types[t], sizes[s], 2);
+	mapping(out, types[t], sizes[s], 1);
+	if (types[t] != Raw2Pvl::_UChar)
+	  mapping(out, types[t], sizes[s], 2);
+      }
+
+  int failed = 0;
+  for(int s=0; s<sizes.count(); s++)
+    {
+      failed += writeSlices(out, 1, sizes[s]);
+      failed += writeSlices(out, 2, sizes[s]);
+    }
+
+  return (failed > 0 ? 1 : 0);
+}
+
+//---------------------------------------
+// same order of work as the filter stage of ImportEngine - every
+// slice is smoothed in place and then averaged across neighbouring
+// slices into a new buffer
+//---------------------------------------
+void
+Benchmark::meanFilter(QTextStream &out, int voxelType, int n, int spread)
+{
+  int bpv = bytesPerVoxel(voxelType);
+  qint64 bps = (qint64)bpv*n*n;
+  uchar *vol = BenchmarkData::syntheticVolume(voxelType, n);
+  uchar *scratch = new uchar[bps];
+  uchar *filtered = new uchar[bps];
+  int nval = 2*spread+1;
+  uchar **val = new uchar*[nval];
+
+  QElapsedTimer timer;
+  timer.start();
+  for(int d=0; d<n; d++)
+    Raw2Pvl::applyMeanFilterToSlice(vol + d*bps, scratch,
+				    voxelType, n, n,
+				    spread, false);
+  for(int d=0; d<n; d++)
+    {
+      for(int i=0; i<nval; i++)
+	val[i] = vol + qBound(0, d-spread+i, n-1)*bps;
+      Raw2Pvl::applyMeanFilter(val, filtered,
+			       voxelType, n, n,
+			       spread, false);
+    }
+  qint64 nsecs = timer.nsecsElapsed();
+
+  BenchmarkData::report(out, QString("meanFilter %1").arg(spread),
+			typeName(voxelType), n, nsecs, n*bps, (qint64)n*n*n);
+
+  delete [] val;
+  delete [] filtered;
+  delete [] scratch;
+  delete [] vol;
+}
+
+void
+Benchmark::mapping(QTextStream &out, int voxelType, int n, int pvlbpv)
+{
+  int bpv = bytesPerVoxel(voxelType);
+  qint64 bps = (qint64)bpv*n*n;
+  uchar *vol = BenchmarkData::syntheticVolume(voxelType, n);
+  uchar *pvl = new uchar[(qint64)pvlbpv*n*n];
+
+  // three point maps so that the copy shortcut is never taken
+  float rmax = 255;
+  if (voxelType == Raw2Pvl::_UShort) rmax = 65535;
+  if (voxelType == Raw2Pvl::_Float) rmax = 1;
+  int pmax = (pvlbpv == 1) ? 255 : 65535;
+
+  QList<float> rawMap;
+  rawMap << 0 << 0.4f*rmax << rmax;
+  QList<int> pvlMap;
+  pvlMap << 0 << (int)(0.6f*pmax) << pmax;
+
+  QElapsedTimer timer;
+  timer.start();
+  for(int d=0; d<n; d++)
+    Raw2Pvl::applyMapping(vol + d*bps, voxelType, rawMap,
+			  pvl, pvlbpv, pvlMap,
+			  n, n);
+  qint64 nsecs = timer.nsecsElapsed();
+
+  BenchmarkData::report(out, QString("mapping pvl%1").arg(8*pvlbpv),
+			typeName(voxelType), n, nsecs, n*bps, (qint64)n*n*n);
+
+  delete [] pvl;
+  delete [] vol;
+}
+
+int
+Benchmark::writeSlices(QTextStream &out, int pvlbpv, int n)
+{
+  int voxelType = (pvlbpv == 1) ? Raw2Pvl::_UChar : Raw2Pvl::_UShort;
+  qint64 bps = (qint64)pvlbpv*n*n;
+  uchar *vol = BenchmarkData::syntheticVolume(voxelType, n);
+
+  QString baseFilename = QDir(QDir::tempPath()).
+                           filePath(QString("drishtiimport-benchmark-%1").arg(n));
+
+  // two slabs so that switching between files is part of the timing
+  VolumeFileManager vfm;
+  vfm.setBaseFilename(baseFilename);
+  vfm.setDepth(n);
+  vfm.setWidth(n);
+  vfm.setHeight(n);
+  vfm.setHeaderSize(13);
+  vfm.setSlabSize(qMax(1, (n+1)/2));
+  vfm.setVoxelType(voxelType);
+
+  QElapsedTimer timer;
+  timer.start();
+  for(int d=0; d<n; d++)
+    vfm.setSlice(d, vol + d*bps);
+  qint64 nsecs = timer.nsecsElapsed();
+
+  BenchmarkData::report(out, "setSlice", typeName(voxelType), n,
+			nsecs, n*bps, (qint64)n*n*n);
+
+  int failed = 0;
+  for(int d=0; d<n; d++)
+    if (memcmp(vfm.getSlice(d), vol + d*bps, bps) != 0)
+      failed++;
+  if (failed > 0)
+    out << QString("  %1 : %2 slices differ\n").arg(baseFilename).arg(failed);
+
+  vfm.removeFile();
+  delete [] vol;
+
+  return (failed > 0 ? 1 : 0);
+}
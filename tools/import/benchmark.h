@@ -0,0 +1,25 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <QStringList>
+#include <QTextStream>
+
+//---------------------------------------
+// drishtiimport --benchmark [size ...]
+// times the stages that savePvl runs for every slice - mean filter,
+// remapping to pvl values and writing the slabs - on synthetic
+// size^3 volumes of several voxel types.  no window or dialog is
+// opened and one line is printed per case.
+//---------------------------------------
+class Benchmark
+{
+ public :
+  static int run(QStringList);
+
+ private :
+  static void meanFilter(QTextStream&, int, int, int);
+  static void mapping(QTextStream&, int, int, int);
+  static int writeSlices(QTextStream&, int, int);
+};
+
+#endif
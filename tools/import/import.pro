@@ -7,6 +7,9 @@ RESOURCES = import.qrc
 
 DEPENDPATH += .
 
+# benchmark helpers shared with drishti and drishtipaint
+INCLUDEPATH += ../../common
+
 QT += widgets core gui xml
 
 CONFIG += release
@@ -66,6 +69,10 @@ HEADERS += global.h \
 	   savepvldialog.h \
 	   volumefilemanager.h \
 	   volumedata.h \
+	   proxyvolume.h \
+	   importengine.h \
+	   benchmark.h \
+	   ../../common/benchmarkdata.h \
 	   volinterface.h \
 	   lookuptable.h
 
@@ -86,5 +93,9 @@ SOURCES += global.cpp \
 	   raw2pvl.cpp \
 	   savepvldialog.cpp \
 	   volumedata.cpp \
+	   proxyvolume.cpp \
+	   importengine.cpp \
+	   benchmark.cpp \
+	   ../../common/benchmarkdata.cpp \
 	   volumefilemanager.cpp
 
@@ -0,0 +1,1101 @@
+#include "common.h"
+#include "importengine.h"
+#include "raw2pvl.h"
+
+#include <QtXml>
+#include <QElapsedTimer>
+#include <QTextStream>
+
+#include <string.h>
+
+ImportJob::ImportJob()
+{
+  plugin.clear();
+  files.clear();
+  timeseries = false;
+
+  pvlFile.clear();
+  rawFile.clear();
+  sliceZeroAtTop = false;
+  overwrite = false;
+
+  dmin = dmax = wmin = wmax = hmin = hmax = -1;
+  zSubsampling = xySubsampling = 1;
+
+  spread = 0;
+  dilateFilter = false;
+
+  vx = vy = vz = -1;
+  voxelUnit = -1;
+  hasDescription = false;
+  description.clear();
+
+  rawMap.clear();
+  pvlMap.clear();
+
+  slabSize = -1;
+  queueSize = 4;
+}
+
+//-------------------------------
+//-------------------------------
+SliceQueue::SliceQueue()
+{
+  m_capacity = 1;
+  m_closed = false;
+  m_abort = false;
+}
+
+void
+SliceQueue::reset(int capacity)
+{
+  QMutexLocker locker(&m_mutex);
+  m_items.clear();
+  m_capacity = qMax(1, capacity);
+  m_closed = false;
+  m_abort = false;
+}
+
+bool
+SliceQueue::push(Item item)
+{
+  QMutexLocker locker(&m_mutex);
+  while (!m_abort && m_items.count() >= m_capacity)
+    m_notFull.wait(&m_mutex);
+
+  if (m_abort)
+    return false;
+
+  m_items.append(item);
+  m_notEmpty.wakeOne();
+  return true;
+}
+
+bool
+SliceQueue::pop(Item &item)
+{
+  QMutexLocker locker(&m_mutex);
+  while (!m_abort && !m_closed && m_items.count() == 0)
+    m_notEmpty.wait(&m_mutex);
+
+  if (m_abort || m_items.count() == 0)
+    return false;
+
+  item = m_items.takeFirst();
+  m_notFull.wakeOne();
+  return true;
+}
+
+void
+SliceQueue::close()
+{
+  QMutexLocker locker(&m_mutex);
+  m_closed = true;
+  m_notEmpty.wakeAll();
+}
+
+void
+SliceQueue::abort()
+{
+  QMutexLocker locker(&m_mutex);
+  m_abort = true;
+  m_notEmpty.wakeAll();
+  m_notFull.wakeAll();
+}
+
+QList<SliceQueue::Item>
+SliceQueue::takeAll()
+{
+  QMutexLocker locker(&m_mutex);
+  QList<Item> items = m_items;
+  m_items.clear();
+  return items;
+}
+
+//-------------------------------
+//-------------------------------
+ImportStage::ImportStage(ImportEngine *engine, int stage) : QThread(0)
+{
+  m_engine = engine;
+  m_stage = stage;
+}
+
+void ImportStage::run() { m_engine->runStage(m_stage); }
+
+//-------------------------------
+//-------------------------------
+ImportEngine::ImportEngine()
+{
+  m_error.clear();
+  m_abort = false;
+  m_written.store(0);
+
+  memset(m_stats, 0, sizeof(m_stats));
+
+  m_volData = 0;
+  m_rawFileManager = 0;
+  m_pvlFileManager = 0;
+}
+
+ImportEngine::~ImportEngine()
+{
+  clearQueues();
+}
+
+QString ImportEngine::errorString() { return m_error; }
+
+static bool
+boolValue(QString str)
+{
+  str = str.trimmed().toLower();
+  return (str == "true" || str == "yes" || str == "1");
+}
+
+static QString
+jobPath(QDir dir, QString flnm)
+{
+  flnm = flnm.trimmed();
+  if (QFileInfo(flnm).isAbsolute())
+    return flnm;
+  return dir.absoluteFilePath(flnm);
+}
+
+bool
+ImportEngine::loadJob(QString jobFile, ImportJob &job, QString &error)
+{
+  QFile f(jobFile);
+  if (!f.open(QIODevice::ReadOnly))
+    {
+      error = QString("Cannot open %1").arg(jobFile);
+      return false;
+    }
+
+  QDomDocument doc;
+  QString mesg;
+  int line;
+  if (!doc.setContent(&f, &mesg, &line))
+    {
+      error = QString("%1 line %2 : %3").arg(jobFile).arg(line).arg(mesg);
+      return false;
+    }
+  f.close();
+
+  // relative paths are relative to the job file
+  QDir dir = QFileInfo(jobFile).absoluteDir();
+
+  job = ImportJob();
+
+  QDomElement main = doc.documentElement();
+  QDomNodeList dlist = main.childNodes();
+  for(int i=0; i<dlist.count(); i++)
+    {
+      if (!dlist.at(i).isElement())
+	continue;
+
+      QString tag = dlist.at(i).nodeName();
+      QString str = dlist.at(i).toElement().text();
+      QStringList words = str.split(" ", QString::SkipEmptyParts);
+
+      if (tag == "plugin")
+	{
+	  // plain plugin names are looked up in the importplugins directory
+	  job.plugin = jobPath(dir, str);
+	  if (!QFileInfo(job.plugin).exists())
+	    job.plugin = QDir(qApp->applicationDirPath() + QDir::separator() +
+			      "importplugins").absoluteFilePath(str.trimmed());
+	}
+      else if (tag == "file")
+	job.files << jobPath(dir, str);
+      else if (tag == "timeseries")
+	job.timeseries = boolValue(str);
+      else if (tag == "pvlfile")
+	job.pvlFile = jobPath(dir, str);
+      else if (tag == "rawfile")
+	job.rawFile = jobPath(dir, str);
+      else if (tag == "slicezeroattop")
+	job.sliceZeroAtTop = boolValue(str);
+      else if (tag == "overwrite")
+	job.overwrite = boolValue(str);
+      else if (tag == "subvolume" && words.count() == 6)
+	{
+	  job.dmin = words[0].toInt();
+	  job.dmax = words[1].toInt();
+	  job.wmin = words[2].toInt();
+	  job.wmax = words[3].toInt();
+	  job.hmin = words[4].toInt();
+	  job.hmax = words[5].toInt();
+	}
+      else if (tag == "subsampling" && words.count() == 2)
+	{
+	  job.zSubsampling = words[0].toInt();
+	  job.xySubsampling = words[1].toInt();
+	}
+      else if (tag == "filter")
+	job.spread = str.toInt();
+      else if (tag == "dilate")
+	job.dilateFilter = boolValue(str);
+      else if (tag == "voxelsize" && words.count() == 3)
+	{
+	  job.vx = words[0].toFloat();
+	  job.vy = words[1].toFloat();
+	  job.vz = words[2].toFloat();
+	}
+      else if (tag == "voxelunit")
+	{
+	  QStringList units;
+	  units << "no units" << "angstrom" << "nanometer"
+		<< "micron" << "millimeter" << "centimeter"
+		<< "meter" << "kilometer" << "parsec" << "kiloparsec";
+	  job.voxelUnit = units.indexOf(str.trimmed().toLower());
+	}
+      else if (tag == "description")
+	{
+	  job.hasDescription = true;
+	  job.description = str;
+	}
+      else if (tag == "rawmap")
+	{
+	  for(int w=0; w<words.count(); w++)
+	    job.rawMap << words[w].toFloat();
+	}
+      else if (tag == "pvlmap")
+	{
+	  for(int w=0; w<words.count(); w++)
+	    job.pvlMap << words[w].toInt();
+	}
+      else if (tag == "slabsize")
+	job.slabSize = str.toInt();
+      else if (tag == "queuesize")
+	job.queueSize = str.toInt();
+      else
+	{
+	  error = QString("%1 : unknown or malformed <%2>").arg(jobFile).arg(tag);
+	  return false;
+	}
+    }
+
+  if (job.plugin.isEmpty() || job.files.count() == 0 || job.pvlFile.isEmpty())
+    {
+      error = QString("%1 : plugin, file and pvlfile are required").arg(jobFile);
+      return false;
+    }
+
+  if (!job.pvlFile.endsWith(".pvl.nc"))
+    job.pvlFile += ".pvl.nc";
+
+  return true;
+}
+
+bool
+ImportEngine::open(VolumeData *volData, ImportJob &job)
+{
+  m_error.clear();
+
+  if (!QFileInfo(job.plugin).exists())
+    {
+      m_error = QString("Plugin %1 not found").arg(job.plugin);
+      return false;
+    }
+
+  // same as RemapWidget::handleTimeSeries
+  bool vol4d = (job.timeseries &&
+		job.plugin.contains("nc", Qt::CaseInsensitive));
+
+  if (!volData->setFile(job.files, job.plugin, vol4d))
+    {
+      m_error = QString("Cannot read %1").arg(job.files[0]);
+      return false;
+    }
+
+  if (job.rawMap.count() > 0 || job.pvlMap.count() > 0)
+    {
+      if (job.rawMap.count() < 2 ||
+	  job.rawMap.count() != job.pvlMap.count())
+	{
+	  m_error = "rawmap and pvlmap need the same number (>1) of values";
+	  return false;
+	}
+      volData->setMap(job.rawMap, job.pvlMap);
+    }
+
+  return true;
+}
+
+bool
+ImportEngine::run(VolumeData *volData,
+		  ImportJob &job,
+		  QProgressDialog *progress)
+{
+  m_error.clear();
+  m_abort = false;
+  memset(m_stats, 0, sizeof(m_stats));
+
+  m_volData = volData;
+  m_volData->gridSize(m_rvdepth, m_rvwidth, m_rvheight);
+
+  m_voxelType = m_volData->voxelType();
+  if (m_voxelType == _Rgb || m_voxelType == _Rgba)
+    {
+      m_error = "RGB volumes are saved with saveTrimmed";
+      return false;
+    }
+
+  m_bpv = 1;
+  if (m_voxelType == _UShort || m_voxelType == _Short) m_bpv = 2;
+  else if (m_voxelType == _Int || m_voxelType == _Float) m_bpv = 4;
+
+  int dmin = (job.dmin < 0 ? 0 : job.dmin);
+  int wmin = (job.wmin < 0 ? 0 : job.wmin);
+  int hmin = (job.hmin < 0 ? 0 : job.hmin);
+  int dmax = (job.dmax < 0 ? m_rvdepth-1 : qMin(job.dmax, m_rvdepth-1));
+  int wmax = (job.wmax < 0 ? m_rvwidth-1 : qMin(job.wmax, m_rvwidth-1));
+  int hmax = (job.hmax < 0 ? m_rvheight-1 : qMin(job.hmax, m_rvheight-1));
+
+  int dsz = dmax-dmin+1;
+  int wsz = wmax-wmin+1;
+  int hsz = hmax-hmin+1;
+
+  m_svslz = qMax(1, job.zSubsampling);
+  m_svsl = qMax(1, job.xySubsampling);
+
+  m_dsz2 = dsz/m_svslz;
+  m_wsz2 = wsz/m_svsl;
+  m_hsz2 = hsz/m_svsl;
+  if (m_dsz2 < 1 || m_wsz2 < 1 || m_hsz2 < 1)
+    {
+      m_error = "Empty subvolume";
+      return false;
+    }
+
+  m_dmin = dmin;
+  m_wmin = wmin;
+  m_hmin = hmin;
+  m_spread = qMax(0, job.spread);
+  m_dilateFilter = job.dilateFilter;
+  m_queueSize = qMax(1, job.queueSize);
+
+  int slabSize = (job.slabSize > 0 ? job.slabSize : dsz+1);
+
+  float vx = job.vx;
+  float vy = job.vy;
+  float vz = job.vz;
+  if (vx < 0 || vy < 0 || vz < 0)
+    {
+      m_volData->voxelSize(vx, vy, vz);
+      vx *= m_svsl;
+      vy *= m_svsl;
+      vz *= m_svslz;
+    }
+  int voxelUnit = (job.voxelUnit >= 0 ? job.voxelUnit : m_volData->voxelUnit());
+  QString description = (job.hasDescription ?
+			 job.description : m_volData->description());
+
+  m_rawMap = m_volData->rawMap();
+  m_pvlMap = m_volData->pvlMap();
+
+  m_pvlbpv = 1;
+  if (m_pvlMap[m_pvlMap.count()-1] > 255)
+    m_pvlbpv = 2;
+
+  int pvlVoxelType = 0;
+  if (m_pvlbpv == 2) pvlVoxelType = 2;
+
+  m_subsample = (m_svsl > 1 || m_svslz > 1);
+  m_trim = (dmin != 0 ||
+	    wmin != 0 ||
+	    hmin != 0 ||
+	    m_dsz2 != m_rvdepth ||
+	    m_wsz2 != m_rvwidth ||
+	    m_hsz2 != m_rvheight);
+
+  bool saveRawFile = !job.rawFile.isEmpty();
+
+  //------------------------------------------------------
+  QStringList timeseriesFiles;
+  if (job.timeseries)
+    timeseriesFiles = job.files;
+  int tsfcount = qMax(1, timeseriesFiles.count());
+
+  QStringList pvlNames, rawNames;
+  for (int tsf=0; tsf<tsfcount; tsf++)
+    {
+      QString pvlflnm = job.pvlFile;
+      QString rawflnm = job.rawFile;
+
+      if (tsfcount > 1)
+	{
+	  QFileInfo ftpvl(job.pvlFile);
+	  QFileInfo ftraw(timeseriesFiles[tsf]);
+	  pvlflnm = QFileInfo(ftpvl.absolutePath(),
+			      ftraw.completeBaseName() + ".pvl.nc").absoluteFilePath();
+
+	  rawflnm = QFileInfo(ftpvl.absolutePath(),
+			      ftraw.completeBaseName() + ".raw").absoluteFilePath();
+	}
+      pvlNames << pvlflnm;
+      rawNames << rawflnm;
+
+      if (saveRawFile && !job.overwrite)
+	{
+	  VolumeFileManager rfm;
+	  rfm.setBaseFilename(rawflnm);
+	  rfm.setDepth(m_dsz2);
+	  rfm.setWidth(m_wsz2);
+	  rfm.setHeight(m_hsz2);
+	  rfm.setVoxelType(m_voxelType);
+	  rfm.setHeaderSize(13);
+	  rfm.setSlabSize(slabSize);
+	  if (rfm.exists())
+	    {
+	      m_error = QString("%1 exists").arg(rfm.fileName());
+	      return false;
+	    }
+	}
+    }
+  //------------------------------------------------------
+
+  VolumeFileManager rawFileManager;
+  VolumeFileManager pvlFileManager;
+  m_rawFileManager = (saveRawFile ? &rawFileManager : 0);
+  m_pvlFileManager = &pvlFileManager;
+
+  for (int tsf=0; tsf<tsfcount; tsf++)
+    {
+      if (tsfcount > 1)
+	m_volData->replaceFile(timeseriesFiles[tsf]);
+
+      pvlFileManager.setBaseFilename(pvlNames[tsf]);
+      pvlFileManager.setDepth(m_dsz2);
+      pvlFileManager.setWidth(m_wsz2);
+      pvlFileManager.setHeight(m_hsz2);
+      pvlFileManager.setVoxelType(pvlVoxelType);
+      pvlFileManager.setHeaderSize(13);
+      pvlFileManager.setSlabSize(slabSize);
+      pvlFileManager.setSliceZeroAtTop(job.sliceZeroAtTop);
+      pvlFileManager.createFile(true, progress != 0);
+
+      if (saveRawFile)
+	{
+	  rawFileManager.setBaseFilename(rawNames[tsf]);
+	  rawFileManager.setDepth(m_dsz2);
+	  rawFileManager.setWidth(m_wsz2);
+	  rawFileManager.setHeight(m_hsz2);
+	  rawFileManager.setVoxelType(m_voxelType);
+	  rawFileManager.setHeaderSize(13);
+	  rawFileManager.setSlabSize(slabSize);
+	  rawFileManager.setSliceZeroAtTop(job.sliceZeroAtTop);
+	  rawFileManager.createFile(true, progress != 0);
+	}
+
+      Raw2Pvl::savePvlHeader(pvlNames[tsf],
+			     saveRawFile, rawNames[tsf],
+			     m_voxelType, pvlVoxelType, voxelUnit,
+			     m_dsz2, m_wsz2, m_hsz2,
+			     vx, vy, vz,
+			     m_rawMap, m_pvlMap,
+			     description,
+			     slabSize);
+
+      if (progress)
+	progress->setLabelText(pvlNames[tsf]);
+
+      if (!runPipeline(progress, tsf, tsfcount))
+	break;
+    }
+
+  m_rawFileManager = 0;
+  m_pvlFileManager = 0;
+  m_volData = 0;
+
+  return !m_abort;
+}
+
+bool
+ImportEngine::runPipeline(QProgressDialog *progress,
+			  int tsf, int tsfcount)
+{
+  for(int i=0; i<NumStages-1; i++)
+    m_queue[i].reset(m_queueSize);
+  m_written.store(0);
+
+  ImportStage *stage[NumStages];
+  for(int i=0; i<NumStages; i++)
+    {
+      stage[i] = new ImportStage(this, i);
+      stage[i]->start();
+    }
+
+  if (progress)
+    {
+      int total = tsfcount*m_dsz2;
+      while (!stage[Write]->wait(100))
+	{
+	  progress->setValue((int)(100*(float)(tsf*m_dsz2 + m_written.load())/
+				   (float)total));
+	  qApp->processEvents();
+	  if (progress->wasCanceled() && !m_abort)
+	    {
+	      m_abort = true;
+	      for(int i=0; i<NumStages-1; i++)
+		m_queue[i].abort();
+	    }
+	}
+    }
+
+  for(int i=0; i<NumStages; i++)
+    {
+      stage[i]->wait();
+      delete stage[i];
+    }
+
+  clearQueues();
+
+  if (m_abort)
+    m_error = "Cancelled";
+
+  return !m_abort;
+}
+
+void
+ImportEngine::clearQueues()
+{
+  for(int i=0; i<NumStages-1; i++)
+    {
+      QList<SliceQueue::Item> items = m_queue[i].takeAll();
+      for(int j=0; j<items.count(); j++)
+	{
+	  delete [] items[j].raw;
+	  delete [] items[j].pvl;
+	}
+    }
+}
+
+void
+ImportEngine::runStage(int stage)
+{
+  if (stage == Decode) decodeStage();
+  else if (stage == Filter) filterStage();
+  else if (stage == Remap) remapStage();
+  else if (stage == Write) writeStage();
+}
+
+//-------------------------------
+// read every slice that contributes to the output once, in order.
+// with a filter the slices within spread of the subvolume are
+// read as well, clamped to the volume
+//-------------------------------
+void
+ImportEngine::decodeStage()
+{
+  StageStats &stats = m_stats[Decode];
+  qint64 nbytes = (qint64)m_rvwidth*m_rvheight*m_bpv;
+
+  int dlast = m_dmin + m_dsz2*m_svslz - 1;
+  int rlo = qMax(0, m_dmin-m_spread);
+  int rhi = qMin(m_rvdepth-1, dlast+m_spread);
+
+  QElapsedTimer timer;
+  for(int d=rlo; d<=rhi && !m_abort; d++)
+    {
+      timer.start();
+      SliceQueue::Item item;
+      item.slice = d;
+      item.raw = new uchar[nbytes];
+      item.pvl = 0;
+      m_volData->getDepthSlice(d, item.raw);
+      stats.busy += timer.nsecsElapsed();
+      stats.slices++;
+      stats.bytes += nbytes;
+
+      timer.start();
+      bool ok = m_queue[Decode].push(item);
+      stats.wait += timer.nsecsElapsed();
+      if (!ok)
+	{
+	  delete [] item.raw;
+	  break;
+	}
+    }
+
+  m_queue[Decode].close();
+}
+
+//-------------------------------
+// every slice is smoothed in plane once when it arrives and kept
+// till the last output slice within spread of it has been built.
+// this gives the same slices as the sliding window in savePvl,
+// which smooths the window again at the start of every output slice
+//-------------------------------
+void
+ImportEngine::filterStage()
+{
+  StageStats &stats = m_stats[Filter];
+  qint64 nbytes = (qint64)m_rvwidth*m_rvheight*m_bpv;
+
+  QElapsedTimer timer;
+  SliceQueue::Item item;
+
+  if (m_spread == 0)
+    {
+      for(;;)
+	{
+	  timer.start();
+	  bool ok = m_queue[Decode].pop(item);
+	  stats.wait += timer.nsecsElapsed();
+	  if (!ok)
+	    break;
+
+	  stats.slices++;
+	  stats.bytes += nbytes;
+
+	  timer.start();
+	  ok = m_queue[Filter].push(item);
+	  stats.wait += timer.nsecsElapsed();
+	  if (!ok)
+	    {
+	      delete [] item.raw;
+	      break;
+	    }
+	}
+      m_queue[Filter].close();
+      return;
+    }
+
+  int dlast = m_dmin + m_dsz2*m_svslz - 1;
+  int nval = 2*m_spread+1;
+  uchar **val = new uchar*[nval];
+  uchar *scratch = new uchar[nbytes];
+  QMap<int, uchar*> window;
+
+  int d = m_dmin;
+  bool ok = true;
+  while (ok && d <= dlast)
+    {
+      timer.start();
+      ok = m_queue[Decode].pop(item);
+      stats.wait += timer.nsecsElapsed();
+      if (!ok)
+	break;
+
+      timer.start();
+      Raw2Pvl::applyMeanFilterToSlice(item.raw, scratch,
+				      m_voxelType, m_rvwidth, m_rvheight,
+				      m_spread, m_dilateFilter);
+      window[item.slice] = item.raw;
+      stats.busy += timer.nsecsElapsed();
+
+      while (ok && d <= dlast &&
+	     qMin(d+m_spread, m_rvdepth-1) <= item.slice)
+	{
+	  timer.start();
+	  for(int i=0; i<nval; i++)
+	    val[i] = window[qBound(0, d-m_spread+i, m_rvdepth-1)];
+
+	  SliceQueue::Item fitem;
+	  fitem.slice = d;
+	  fitem.raw = new uchar[nbytes];
+	  fitem.pvl = 0;
+	  Raw2Pvl::applyMeanFilter(val, fitem.raw,
+				   m_voxelType, m_rvwidth, m_rvheight,
+				   m_spread, m_dilateFilter);
+	  stats.busy += timer.nsecsElapsed();
+	  stats.slices++;
+	  stats.bytes += nbytes;
+
+	  timer.start();
+	  ok = m_queue[Filter].push(fitem);
+	  stats.wait += timer.nsecsElapsed();
+	  if (!ok)
+	    delete [] fitem.raw;
+
+	  d++;
+
+	  // slices below d-spread are not needed any more
+	  while (window.count() > 0 &&
+		 window.firstKey() < qMax(0, d-m_spread))
+	    delete [] window.take(window.firstKey());
+	}
+    }
+
+  QMap<int, uchar*>::iterator it;
+  for(it=window.begin(); it!=window.end(); it++)
+    delete [] it.value();
+  delete [] scratch;
+  delete [] val;
+
+  // drain what the decoder still has in flight
+  while (m_queue[Decode].pop(item))
+    delete [] item.raw;
+
+  m_queue[Filter].close();
+}
+
+#define SUBSAMPLESLICE()					\
+  {								\
+    int fi = 0;							\
+    for(int j=0; j<m_wsz2; j++)					\
+      {								\
+	int y0 = m_wmin+j*m_svsl;				\
+	int y1 = y0+m_svsl-1;					\
+	for(int i=0; i<m_hsz2; i++)				\
+	  {							\
+	    int x0 = m_hmin+i*m_svsl;				\
+	    int x1 = x0+m_svsl-1;				\
+	    for(int y=y0; y<=y1; y++)				\
+	      for(int x=x0; x<=x1; x++)				\
+		filtervol[fi] += ptr[y*m_rvheight+x];		\
+	    fi++;						\
+	  }							\
+      }								\
+  }
+
+#define STORESLICE()						\
+  {								\
+    for(int fi=0; fi<nout; fi++)				\
+      ptr[fi] = filtervol[fi];					\
+  }
+
+//-------------------------------
+// trim, subsample and remap.  filtervol is accumulated in the
+// same order as in savePvl so that the results are bit identical
+//-------------------------------
+void
+ImportEngine::remapStage()
+{
+  StageStats &stats = m_stats[Remap];
+
+  int nout = m_wsz2*m_hsz2;
+  int svsl3 = m_svslz*m_svsl*m_svsl;
+  double *filtervol = new double[nout];
+
+  QElapsedTimer timer;
+  SliceQueue::Item item;
+  bool ok = true;
+
+  for(int dd=0; ok && dd<m_dsz2; dd++)
+    {
+      int d0 = m_dmin + dd*m_svslz;
+      int d1 = d0 + m_svslz-1;
+
+      uchar *raw = 0;
+      memset(filtervol, 0, 8*nout);
+      for (int d=d0; ok && d<=d1; d++)
+	{
+	  timer.start();
+	  ok = m_queue[Filter].pop(item);
+	  stats.wait += timer.nsecsElapsed();
+	  if (!ok)
+	    break;
+
+	  timer.start();
+	  if (m_trim || m_subsample)
+	    {
+	      if (m_voxelType == _UChar)
+		{ uchar *ptr = item.raw; SUBSAMPLESLICE(); }
+	      else if (m_voxelType == _Char)
+		{ char *ptr = (char*)item.raw; SUBSAMPLESLICE(); }
+	      else if (m_voxelType == _UShort)
+		{ ushort *ptr = (ushort*)item.raw; SUBSAMPLESLICE(); }
+	      else if (m_voxelType == _Short)
+		{ short *ptr = (short*)item.raw; SUBSAMPLESLICE(); }
+	      else if (m_voxelType == _Int)
+		{ int *ptr = (int*)item.raw; SUBSAMPLESLICE(); }
+	      else if (m_voxelType == _Float)
+		{ float *ptr = (float*)item.raw; SUBSAMPLESLICE(); }
+
+	      delete [] item.raw;
+	    }
+	  else
+	    raw = item.raw;
+	  stats.busy += timer.nsecsElapsed();
+	}
+      if (!ok)
+	break;
+
+      timer.start();
+      if (m_trim || m_subsample)
+	{
+	  if (m_subsample)
+	    {
+	      for(int fi=0; fi<nout; fi++)
+		filtervol[fi] /= svsl3;
+	    }
+
+	  raw = new uchar[nout*m_bpv];
+	  if (m_voxelType == _UChar)
+	    { uchar *ptr = raw; STORESLICE(); }
+	  else if (m_voxelType == _Char)
+	    { char *ptr = (char*)raw; STORESLICE(); }
+	  else if (m_voxelType == _UShort)
+	    { ushort *ptr = (ushort*)raw; STORESLICE(); }
+	  else if (m_voxelType == _Short)
+	    { short *ptr = (short*)raw; STORESLICE(); }
+	  else if (m_voxelType == _Int)
+	    { int *ptr = (int*)raw; STORESLICE(); }
+	  else if (m_voxelType == _Float)
+	    { float *ptr = (float*)raw; STORESLICE(); }
+	}
+
+      SliceQueue::Item ritem;
+      ritem.slice = dd;
+      ritem.raw = raw;
+      ritem.pvl = new uchar[nout*m_pvlbpv];
+      Raw2Pvl::applyMapping(raw, m_voxelType, m_rawMap,
+			    ritem.pvl, m_pvlbpv, m_pvlMap,
+			    m_wsz2, m_hsz2);
+      stats.busy += timer.nsecsElapsed();
+      stats.slices++;
+      stats.bytes += (qint64)nout*m_pvlbpv;
+
+      timer.start();
+      ok = m_queue[Remap].push(ritem);
+      stats.wait += timer.nsecsElapsed();
+      if (!ok)
+	{
+	  delete [] ritem.raw;
+	  delete [] ritem.pvl;
+	}
+    }
+
+  delete [] filtervol;
+
+  while (m_queue[Filter].pop(item))
+    delete [] item.raw;
+
+  m_queue[Remap].close();
+}
+
+void
+ImportEngine::writeStage()
+{
+  StageStats &stats = m_stats[Write];
+  qint64 nout = (qint64)m_wsz2*m_hsz2;
+
+  QElapsedTimer timer;
+  SliceQueue::Item item;
+  for(;;)
+    {
+      timer.start();
+      bool ok = m_queue[Remap].pop(item);
+      stats.wait += timer.nsecsElapsed();
+      if (!ok)
+	break;
+
+      timer.start();
+      if (m_rawFileManager)
+	{
+	  m_rawFileManager->setSlice(item.slice, item.raw);
+	  stats.bytes += nout*m_bpv;
+	}
+      m_pvlFileManager->setSlice(item.slice, item.pvl);
+      stats.bytes += nout*m_pvlbpv;
+      stats.busy += timer.nsecsElapsed();
+      stats.slices++;
+
+      delete [] item.raw;
+      delete [] item.pvl;
+
+      m_written.ref();
+    }
+}
+
+QStringList
+ImportEngine::statistics()
+{
+  QStringList names;
+  names << "decode" << "filter" << "remap" << "write";
+
+  QStringList lines;
+  for(int i=0; i<NumStages; i++)
+    {
+      const StageStats &s = m_stats[i];
+      float mb = s.bytes/(1024.0*1024.0);
+      float busy = s.busy*1e-9;
+      float total = (s.busy + s.wait)*1e-9;
+      lines << QString("%1 : %2 slices  %3 MB  busy %4 s  %5 MB/s  waiting %6%").\
+	arg(names[i], -6).
+	arg(s.slices).
+	arg(mb, 0, 'f', 1).
+	arg(busy, 0, 'f', 2).
+	arg(busy > 0 ? mb/busy : 0, 0, 'f', 1).
+	arg(total > 0 ? (int)(100*(total-busy)/total) : 0);
+    }
+  return lines;
+}
+
+int
+ImportEngine::batch(QStringList jobFiles)
+{
+  QTextStream out(stdout);
+
+  int failed = 0;
+  for(int j=0; j<jobFiles.count(); j++)
+    {
+      out << jobFiles[j] << "\n";
+      out.flush();
+
+      ImportJob job;
+      QString error;
+      if (!loadJob(jobFiles[j], job, error))
+	{
+	  out << "  " << error << "\n";
+	  failed++;
+	  continue;
+	}
+
+      VolumeData volData;
+      ImportEngine engine;
+      QElapsedTimer timer;
+      timer.start();
+      if (!engine.open(&volData, job) ||
+	  !engine.run(&volData, job))
+	{
+	  out << "  " << engine.errorString() << "\n";
+	  failed++;
+	  continue;
+	}
+
+      out << "  " << job.pvlFile << QString(" : %1 s\n").arg(timer.elapsed()*0.001);
+      QStringList stats = engine.statistics();
+      for(int i=0; i<stats.count(); i++)
+	out << "  " << stats[i] << "\n";
+      out.flush();
+    }
+
+  return failed;
+}
+
+//-------------------------------
+// the job with the values the dialogs of Raw2Pvl::savePvl start
+// from filled in - the values of the volume
+//-------------------------------
+static ImportJob
+dialogJob(VolumeData *volData, ImportJob job)
+{
+  int rvdepth, rvwidth, rvheight;
+  volData->gridSize(rvdepth, rvwidth, rvheight);
+
+  if (job.dmin < 0) job.dmin = 0;
+  if (job.wmin < 0) job.wmin = 0;
+  if (job.hmin < 0) job.hmin = 0;
+  if (job.dmax < 0) job.dmax = rvdepth-1;
+  if (job.wmax < 0) job.wmax = rvwidth-1;
+  if (job.hmax < 0) job.hmax = rvheight-1;
+
+  if (job.vx < 0 || job.vy < 0 || job.vz < 0)
+    {
+      volData->voxelSize(job.vx, job.vy, job.vz);
+      job.vx *= qMax(1, job.xySubsampling);
+      job.vy *= qMax(1, job.xySubsampling);
+      job.vz *= qMax(1, job.zSubsampling);
+    }
+  if (job.voxelUnit < 0)
+    job.voxelUnit = volData->voxelUnit();
+  if (!job.hasDescription)
+    {
+      job.hasDescription = true;
+      job.description = volData->description();
+    }
+  if (job.slabSize <= 0)
+    job.slabSize = job.dmax-job.dmin+2;
+  job.overwrite = true;
+
+  return job;
+}
+
+int
+ImportEngine::check(QStringList jobFiles)
+{
+  QTextStream out(stdout);
+
+  QDir tmpDir(QDir::tempPath() + QDir::separator() + "drishtiimport-check");
+  tmpDir.mkpath(tmpDir.absolutePath());
+
+  int failed = 0;
+  for(int j=0; j<jobFiles.count(); j++)
+    {
+      out << jobFiles[j] << "\n";
+      out.flush();
+
+      ImportJob job;
+      QString error;
+      if (!loadJob(jobFiles[j], job, error))
+	{
+	  out << "  " << error << "\n";
+	  failed++;
+	  continue;
+	}
+
+      VolumeData volData;
+      ImportEngine engine;
+      if (!engine.open(&volData, job) ||
+	  !engine.run(&volData, job))
+	{
+	  out << "  " << engine.errorString() << "\n";
+	  failed++;
+	  continue;
+	}
+
+      // same file names in the temporary directory, so that the
+      // relative raw file path in the header is the same as well
+      ImportJob gjob = dialogJob(&volData, job);
+      gjob.pvlFile = tmpDir.absoluteFilePath(QFileInfo(job.pvlFile).fileName());
+      if (!job.rawFile.isEmpty())
+	gjob.rawFile = tmpDir.absoluteFilePath(QFileInfo(job.rawFile).fileName());
+
+      QProgressDialog progress("Saving processed volume",
+			       "Cancel",
+			       0, 100,
+			       0);
+      progress.setMinimumDuration(0);
+
+      ImportEngine gengine;
+      bool ok = gengine.run(&volData, gjob, &progress);
+      progress.setValue(100);
+      if (!ok)
+	{
+	  out << "  " << gengine.errorString() << "\n";
+	  failed++;
+	  continue;
+	}
+
+      // every file written by the second run against the first
+      QDir pvlDir = QFileInfo(job.pvlFile).absoluteDir();
+      QDir rawDir = QFileInfo(job.rawFile).absoluteDir();
+      QFileInfoList written = tmpDir.entryInfoList(QDir::Files);
+      int ndiff = 0;
+      for(int i=0; i<written.count(); i++)
+	{
+	  QString name = written[i].fileName();
+	  QString batchFile = pvlDir.absoluteFilePath(name);
+	  if (!QFile::exists(batchFile))
+	    batchFile = rawDir.absoluteFilePath(name);
+
+	  QFile f0(batchFile);
+	  QFile f1(written[i].absoluteFilePath());
+	  bool same = (f0.open(QFile::ReadOnly) && f1.open(QFile::ReadOnly) &&
+		       f0.size() == f1.size());
+	  while (same && !f0.atEnd())
+	    same = (f0.read(1024*1024) == f1.read(1024*1024));
+	  f0.close();
+	  f1.close();
+
+	  if (!same)
+	    {
+	      out << "  " << batchFile << " differs\n";
+	      ndiff++;
+	    }
+	  QFile::remove(written[i].absoluteFilePath());
+	}
+
+      out << QString("  %1 files compared, %2 differ\n").\
+	arg(written.count()).arg(ndiff);
+      out.flush();
+      if (ndiff > 0)
+	failed++;
+    }
+
+  tmpDir.rmdir(tmpDir.absolutePath());
+
+  return failed;
+}
@@ -0,0 +1,183 @@
+#ifndef IMPORTENGINE_H
+#define IMPORTENGINE_H
+
+#include <QMutex>
+#include <QThread>
+#include <QWaitCondition>
+#include <QAtomicInt>
+
+#include "volumedata.h"
+#include "volumefilemanager.h"
+
+//---------------------------------------
+// everything needed to turn a volume into a .pvl.nc without
+// asking the user.  -1 and empty values are taken from the
+// volume, the same way the save dialogs initialise them.
+//---------------------------------------
+class ImportJob
+{
+ public :
+  ImportJob();
+
+  QString plugin;
+  QStringList files;
+  bool timeseries;
+
+  QString pvlFile;
+  QString rawFile; // empty : no raw file
+  bool sliceZeroAtTop;
+  bool overwrite;
+
+  int dmin, dmax, wmin, wmax, hmin, hmax;
+  int zSubsampling, xySubsampling;
+
+  int spread;
+  bool dilateFilter;
+
+  float vx, vy, vz;  // -1 : volume voxel size scaled by subsampling
+  int voxelUnit;
+  bool hasDescription;
+  QString description;
+
+  QList<float> rawMap;
+  QList<int> pvlMap;
+
+  int slabSize;  // -1 : everything in one slab
+  int queueSize; // slices in flight between two stages
+};
+
+//---------------------------------------
+// bounded queue of slices between two pipeline stages
+//---------------------------------------
+class SliceQueue
+{
+ public :
+  struct Item
+  {
+    int slice;
+    uchar *raw;
+    uchar *pvl;
+  };
+
+  SliceQueue();
+
+  void reset(int);
+  bool push(Item);
+  bool pop(Item&);
+  void close();
+  void abort();
+  QList<Item> takeAll();
+
+ private :
+  QMutex m_mutex;
+  QWaitCondition m_notEmpty;
+  QWaitCondition m_notFull;
+  QList<Item> m_items;
+  int m_capacity;
+  bool m_closed;
+  bool m_abort;
+};
+
+class ImportEngine;
+
+class ImportStage : public QThread
+{
+ public :
+  ImportStage(ImportEngine*, int);
+
+ protected :
+  void run();
+
+ private :
+  ImportEngine *m_engine;
+  int m_stage;
+};
+
+//---------------------------------------
+// headless import.
+// decode -> filter -> remap -> write run in their own threads and
+// hand slices over through bounded queues, so that reading through
+// the plugin overlaps with the filtering, remapping and writing of
+// earlier slices.  the arithmetic is the same as in the
+// interactive save, slice for slice.
+//---------------------------------------
+class ImportEngine
+{
+ public :
+  ImportEngine();
+  ~ImportEngine();
+
+  static bool loadJob(QString, ImportJob&, QString&);
+
+  // runs the jobs in the given files, returns the number of failures
+  static int batch(QStringList);
+
+  // determinism check - runs every job as batch does and again
+  // through the same engine with a progress dialog and the job
+  // values the save dialogs start from, returns the number of jobs
+  // whose files differ.  it does not run Raw2Pvl::savePvl itself
+  static int check(QStringList);
+
+  bool open(VolumeData*, ImportJob&);
+
+  // blocks till done.  with a progress dialog events are
+  // processed while waiting and cancel aborts the run
+  bool run(VolumeData*, ImportJob&, QProgressDialog *progress=0);
+
+  QString errorString();
+  QStringList statistics();
+
+ private :
+  friend class ImportStage;
+
+  enum
+  {
+    Decode = 0,
+    Filter,
+    Remap,
+    Write,
+    NumStages
+  };
+
+  struct StageStats
+  {
+    int slices;
+    qint64 bytes;
+    qint64 busy;  // nsecs
+    qint64 wait;  // nsecs blocked on a queue
+  };
+
+  QString m_error;
+  volatile bool m_abort;
+  QAtomicInt m_written;
+
+  SliceQueue m_queue[NumStages-1];
+  StageStats m_stats[NumStages];
+
+  // parameters of the current run
+  VolumeData *m_volData;
+  int m_voxelType, m_bpv, m_pvlbpv;
+  int m_rvdepth, m_rvwidth, m_rvheight;
+  int m_dmin, m_wmin, m_hmin;
+  int m_dsz2, m_wsz2, m_hsz2;
+  int m_svslz, m_svsl;
+  int m_spread;
+  bool m_dilateFilter;
+  int m_queueSize;
+  bool m_trim, m_subsample;
+  QList<float> m_rawMap;
+  QList<int> m_pvlMap;
+  VolumeFileManager *m_rawFileManager;
+  VolumeFileManager *m_pvlFileManager;
+
+  void runStage(int);
+  void decodeStage();
+  void filterStage();
+  void remapStage();
+  void writeStage();
+
+  bool runPipeline(QProgressDialog*, int, int);
+  void clearQueues();
+};
+
+#endif
@@ -1,9 +1,32 @@
 #include "drishtiimport.h"
+#include "importengine.h"
+#include "benchmark.h"
 
 int main(int argv, char **args)
 {
     QApplication app(argv, args);
 
+    // drishtiimport --batch job.xml [job.xml ...]
+    // runs the import jobs without opening the main window
+    QStringList arguments = app.arguments();
+    int bidx = arguments.indexOf("--batch");
+    if (bidx > 0)
+	return (ImportEngine::batch(arguments.mid(bidx+1)) > 0 ? 1 : 0);
+
+    // drishtiimport --check job.xml [job.xml ...]
+    // runs the jobs twice through the import engine, as --batch
+    // does and with a progress dialog, and compares the files
+    // that the two runs write
+    int cidx = arguments.indexOf("--check");
+    if (cidx > 0)
+	return (ImportEngine::check(arguments.mid(cidx+1)) > 0 ? 1 : 0);
+
+    // drishtiimport --benchmark [size ...]
+    // times filtering, remapping and writing of synthetic volumes
+    int pidx = arguments.indexOf("--benchmark");
+    if (pidx > 0)
+	return Benchmark::run(arguments.mid(pidx+1));
+
     DrishtiImport mainWindow;
     mainWindow.show();
 
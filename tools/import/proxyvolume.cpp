@@ -0,0 +1,173 @@
+#include "proxyvolume.h"
+
+#include <string.h>
+
+// longest side of the proxy
+static const int proxyDim = 256;
+
+// smaller volumes are fast enough to show at full resolution
+static const qint64 minProxyBytes = (qint64)64*1024*1024;
+
+ProxyVolume::ProxyVolume(QObject *parent) : QThread(parent)
+{
+  m_volInterface = 0;
+  m_volMutex = 0;
+  m_abort = false;
+  m_ready = false;
+  m_depth = m_width = m_height = 0;
+  m_bytesPerVoxel = 1;
+  m_step = 1;
+  m_pDepth = m_pWidth = m_pHeight = 0;
+  m_proxy = 0;
+}
+
+ProxyVolume::~ProxyVolume()
+{
+  clear();
+}
+
+bool ProxyVolume::ready() { return m_ready; }
+int ProxyVolume::step() { return m_step; }
+
+void
+ProxyVolume::gridSize(int& d, int& w, int& h)
+{
+  d = m_pDepth;
+  w = m_pWidth;
+  h = m_pHeight;
+}
+
+void
+ProxyVolume::clear()
+{
+  m_abort = true;
+  wait();
+  m_abort = false;
+  m_ready = false;
+
+  if (m_proxy)
+    delete [] m_proxy;
+  m_proxy = 0;
+
+  m_volInterface = 0;
+  m_volMutex = 0;
+  m_step = 1;
+  m_pDepth = m_pWidth = m_pHeight = 0;
+}
+
+void
+ProxyVolume::build(VolInterface *volInterface,
+		   QMutex *volMutex,
+		   int d, int w, int h,
+		   int bpv)
+{
+  clear();
+
+  if ((qint64)d*w*h*bpv < minProxyBytes)
+    return;
+
+  int maxDim = qMax(d, qMax(w, h));
+  m_step = (maxDim + proxyDim-1)/proxyDim;
+  if (m_step < 2)
+    return;
+
+  m_volInterface = volInterface;
+  m_volMutex = volMutex;
+  m_depth = d;
+  m_width = w;
+  m_height = h;
+  m_bytesPerVoxel = bpv;
+
+  m_pDepth = (d + m_step-1)/m_step;
+  m_pWidth = (w + m_step-1)/m_step;
+  m_pHeight = (h + m_step-1)/m_step;
+
+  m_proxy = new uchar[(qint64)m_pDepth*m_pWidth*m_pHeight*bpv];
+
+  start(QThread::LowPriority);
+}
+
+void
+ProxyVolume::run()
+{
+  int bpv = m_bytesPerVoxel;
+  qint64 pslice = (qint64)m_pWidth*m_pHeight*bpv;
+  uchar *tmp = new uchar[(qint64)m_width*m_height*bpv];
+
+  for(int k=0; k<m_pDepth; k++)
+    {
+      if (m_abort)
+	{
+	  delete [] tmp;
+	  return;
+	}
+
+      m_volMutex->lock();
+      m_volInterface->getDepthSlice(k*m_step, tmp);
+      m_volMutex->unlock();
+
+      uchar *p = m_proxy + k*pslice;
+      for(int w=0; w<m_pWidth; w++)
+	{
+	  uchar *row = tmp + (qint64)w*m_step*m_height*bpv;
+	  for(int h=0; h<m_pHeight; h++)
+	    {
+	      memcpy(p, row + (qint64)h*m_step*bpv, bpv);
+	      p += bpv;
+	    }
+	}
+    }
+
+  delete [] tmp;
+
+  m_ready = true;
+}
+
+bool
+ProxyVolume::getSlice(int axis, int slc,
+		      uchar *slice,
+		      int& sw, int& sh)
+{
+  if (!m_ready)
+    return false;
+
+  int bpv = m_bytesPerVoxel;
+  int s = slc/m_step;
+
+  if (axis == 0)
+    {
+      s = qBound(0, s, m_pDepth-1);
+      sw = m_pHeight;
+      sh = m_pWidth;
+      memcpy(slice,
+	     m_proxy + (qint64)s*m_pWidth*m_pHeight*bpv,
+	     (qint64)m_pWidth*m_pHeight*bpv);
+      return true;
+    }
+
+  if (axis == 1)
+    {
+      s = qBound(0, s, m_pWidth-1);
+      sw = m_pHeight;
+      sh = m_pDepth;
+      for(int d=0; d<m_pDepth; d++)
+	memcpy(slice + (qint64)d*m_pHeight*bpv,
+	       m_proxy + ((qint64)d*m_pWidth + s)*m_pHeight*bpv,
+	       m_pHeight*bpv);
+      return true;
+    }
+
+  s = qBound(0, s, m_pHeight-1);
+  sw = m_pWidth;
+  sh = m_pDepth;
+  uchar *p = slice;
+  for(int d=0; d<m_pDepth; d++)
+    for(int w=0; w<m_pWidth; w++)
+      {
+	memcpy(p,
+	       m_proxy + (((qint64)d*m_pWidth + w)*m_pHeight + s)*bpv,
+	       bpv);
+	p += bpv;
+      }
+  return true;
+}
@@ -0,0 +1,58 @@
+#ifndef PROXYVOLUME_H
+#define PROXYVOLUME_H
+
+#include <QMutex>
+#include <QThread>
+
+#include "volinterface.h"
+
+//---------------------------------------
+// downsampled copy of the volume for interactive slice preview.
+// every step'th depth slice is read through the plugin in the
+// background and subsampled in width and height, so that width
+// and height slices can be shown without touching every file
+// of the stack.  raw values are kept, remapping is left to the
+// caller.
+//---------------------------------------
+class ProxyVolume : public QThread
+{
+  Q_OBJECT
+
+ public :
+  ProxyVolume(QObject *parent=0);
+  ~ProxyVolume();
+
+  // plugin access has to be serialised through the given mutex
+  void build(VolInterface*, QMutex*,
+	     int, int, int, int);
+  void clear();
+
+  bool ready();
+  int step();
+  void gridSize(int&, int&, int&);
+
+  // raw proxy slice for slice slc of the full volume.
+  // axis is 0 for depth, 1 for width and 2 for height slices.
+  // returns false if the proxy is not ready
+  bool getSlice(int axis, int slc,
+		uchar*, int&, int&);
+
+ protected :
+  void run();
+
+ private :
+  VolInterface *m_volInterface;
+  QMutex *m_volMutex;
+
+  volatile bool m_abort;
+  volatile bool m_ready;
+
+  int m_depth, m_width, m_height;
+  int m_bytesPerVoxel;
+
+  int m_step;
+  int m_pDepth, m_pWidth, m_pHeight;
+  uchar *m_proxy;
+};
+
+#endif
@@ -14,6 +14,7 @@
 
 #include "savepvldialog.h"
 #include "volumefilemanager.h"
+#include "importengine.h"
 
 #ifdef Q_OS_WIN
 #include <float.h>
@@ -1491,7 +1492,6 @@ Raw2Pvl::savePvl(VolumeData* volData,
   int hsz=hmax-hmin+1;
 
   uchar voxelType = volData->voxelType();  
-  int headerBytes = volData->headerBytes();
 
   int bpv = 1;
   if (voxelType == _UChar) bpv = 1;
@@ -1550,7 +1550,6 @@ Raw2Pvl::savePvl(VolumeData* volData,
   int dsz2 = dsz/svslz;
   int wsz2 = wsz/svsl;
   int hsz2 = hsz/svsl;
-  int svsl3 = svslz*svsl*svsl;
   //------------------------------------------------------
 
   //------------------------------------------------------
@@ -1572,300 +1571,90 @@ Raw2Pvl::savePvl(VolumeData* volData,
   QString description = savePvlDialog.description();
   savePvlDialog.voxelSize(vx, vy, vz);
 
-  QList<float> rawMap = volData->rawMap();
-  QList<int> pvlMap = volData->pvlMap();
-
-  int pvlbpv = 1;
-  if (pvlMap[pvlMap.count()-1] > 255)
-    pvlbpv = 2;
-
-  int pvlVoxelType = 0;
-  if (pvlbpv == 2) pvlVoxelType = 2;
-
-  int nbytes = rvwidth*rvheight*bpv;
-  double *filtervol = new double[wsz2*hsz2];
-  uchar *pvlslice = new uchar[pvlbpv*wsz2*hsz2];
-  uchar *raw = new uchar[nbytes];
-  uchar **val;
-  if (spread > 0)
-    {
-      val = new uchar*[2*spread+1];
-      for (int i=0; i<2*spread+1; i++)
-	val[i] = new uchar[nbytes];
-    }
-  int rawSize = rawMap.size()-1;
-  int width = wsz2;
-  int height = hsz2;
-  bool subsample = (svsl > 1 || svslz > 1);
-  bool trim = (dmin != 0 ||
-	       wmin != 0 ||
-	       hmin != 0 ||
-	       dsz2 != rvdepth ||
-	       wsz2 != rvwidth ||
-	       hsz2 != rvheight);
-
-
-  VolumeFileManager rawFileManager;
-  VolumeFileManager pvlFileManager;
-
-  QProgressDialog progress("Saving processed volume",
-			   "Cancel",
-			   0, 100,
-			   0);
-  progress.setMinimumDuration(0);
-
   //------------------------------------------------------
+  // ask about existing raw files up front, the engine
+  // itself does not ask
   int tsfcount = qMax(1, timeseriesFiles.count());
-  for (int tsf=0; tsf<tsfcount; tsf++)
+  for (int tsf=0; saveRawFile && tsf<tsfcount; tsf++)
     {
-      QString pvlflnm = pvlFilename;
       QString rawflnm = rawfile;
-
       if (tsfcount > 1)
 	{
 	  QFileInfo ftpvl(pvlFilename);
 	  QFileInfo ftraw(timeseriesFiles[tsf]);
-	  pvlflnm = QFileInfo(ftpvl.absolutePath(),
-			      ftraw.completeBaseName() + ".pvl.nc").absoluteFilePath();
-
 	  rawflnm = QFileInfo(ftpvl.absolutePath(),
 			      ftraw.completeBaseName() + ".raw").absoluteFilePath();
-
-	  volData->replaceFile(timeseriesFiles[tsf]);
 	}
 
-      pvlFileManager.setBaseFilename(pvlflnm);
-      pvlFileManager.setDepth(dsz2);
-      pvlFileManager.setWidth(wsz2);
-      pvlFileManager.setHeight(hsz2);
-      pvlFileManager.setVoxelType(pvlVoxelType);
-      pvlFileManager.setHeaderSize(13);
-      pvlFileManager.setSlabSize(slabSize);
-      pvlFileManager.setSliceZeroAtTop(save0AtTop);
-      pvlFileManager.createFile(true);
-      
-      if (saveRawFile)
+      VolumeFileManager rawFileManager;
+      rawFileManager.setBaseFilename(rawflnm);
+      rawFileManager.setDepth(dsz2);
+      rawFileManager.setWidth(wsz2);
+      rawFileManager.setHeight(hsz2);
+      rawFileManager.setVoxelType(voxelType);
+      rawFileManager.setHeaderSize(13);
+      rawFileManager.setSlabSize(slabSize);
+      if (rawFileManager.exists())
 	{
-	  rawFileManager.setBaseFilename(rawflnm);
-	  rawFileManager.setDepth(dsz2);
-	  rawFileManager.setWidth(wsz2);
-	  rawFileManager.setHeight(hsz2);
-	  rawFileManager.setVoxelType(voxelType);
-	  rawFileManager.setHeaderSize(13);
-	  rawFileManager.setSlabSize(slabSize);
-	  rawFileManager.setSliceZeroAtTop(save0AtTop);
-	  if (rawFileManager.exists())
-	    {
-	      bool ok = false;
-	      QStringList slevels;
-	      slevels << "Yes - overwrite";
-	      slevels << "No";  
-	      QString option = QInputDialog::getItem(0,
-						     "Save RAW Volume",
-						     QString("%1 exists - Overwrite ?"). \
-						     arg(rawFileManager.fileName()),
-						     slevels,
-						     0,
-						     false,
-						     &ok);
-	      if (!ok)
-		return;
+	  bool ok = false;
+	  QStringList slevels;
+	  slevels << "Yes - overwrite";
+	  slevels << "No";  
+	  QString option = QInputDialog::getItem(0,
+						 "Save RAW Volume",
+						 QString("%1 exists - Overwrite ?"). \
+						 arg(rawFileManager.fileName()),
+						 slevels,
+						 0,
+						 false,
+						 &ok);
+	  if (!ok)
+	    return;
 	      
-	      QStringList op = option.split(' ');
-	      if (op[0] != "Yes")
-		{
-		  QMessageBox::information(0, "Save",
+	  QStringList op = option.split(' ');
+	  if (op[0] != "Yes")
+	    {
+	      QMessageBox::information(0, "Save",
 	        QString("Please choose a different name for the preprocessed volume - RAW file not overwritten"));
-		  return;
-		}
+	      return;
 	    }
-	  rawFileManager.createFile(true);
 	}
-      //------------------------------------------------------
-
+    }
+  //------------------------------------------------------
 
-      savePvlHeader(pvlflnm,
-		    saveRawFile, rawflnm,
-		    voxelType, pvlVoxelType, voxelUnit,
-		    dsz/svslz, wsz/svsl, hsz/svsl,
-		    vx, vy, vz,
-		    rawMap, pvlMap,
-		    description,
-		    slabSize);
-      
-      for(int dd=0; dd<dsz2; dd++)
-	{
-	  int d0 = dmin + dd*svslz; 
-	  int d1 = d0 + svslz-1;
-	  
-	  progress.setValue((int)(100*(float)dd/(float)dsz2));
-	  qApp->processEvents();
-	  
-	  memset(filtervol, 0, 8*wsz2*hsz2);
-	  for (int d=d0; d<=d1; d++)
-	    {
-	      if (spread > 0)
-		{
-		  if (d == d0)
-		    {
-		      volData->getDepthSlice(d, val[spread]);
-		      applyMeanFilterToSlice(val[spread], raw,
-					     voxelType, rvwidth, rvheight,
-					     spread, dilateFilter);
-
-		      for(int i=-spread; i<0; i++)
-			{
-			  if (d+i >= 0)
-			    volData->getDepthSlice(d+i, val[spread+i]);
-			  else
-			    volData->getDepthSlice(0, val[spread+i]);
-
-			  applyMeanFilterToSlice(val[spread+i], raw,
-						 voxelType, rvwidth, rvheight,
-						 spread, dilateFilter);
-			}
-		      
-		      for(int i=1; i<=spread; i++)
-			{
-			  if (d+i < rvdepth)
-			    volData->getDepthSlice(d+i, val[spread+i]);
-			  else
-			    volData->getDepthSlice(rvdepth-1, val[spread+i]);
-
-			  applyMeanFilterToSlice(val[spread+i], raw,
-						 voxelType, rvwidth, rvheight,
-						 spread, dilateFilter);
-			}
-		    }
-		  else if (d < rvdepth-spread)
-		    {
-		      volData->getDepthSlice(d+spread, val[2*spread]);
-		      applyMeanFilterToSlice(val[2*spread], raw,
-					     voxelType, rvwidth, rvheight,
-					     spread, dilateFilter);
-		    }		  
-		  else
-		    {
-		      volData->getDepthSlice(rvdepth-1, val[2*spread]);
-		      applyMeanFilterToSlice(val[2*spread], raw,
-					     voxelType, rvwidth, rvheight,
-					     spread, dilateFilter);
-		    }		  
-		}
-	      else
-		volData->getDepthSlice(d, raw);
-	      
-	      if (spread > 0)
-		{
-		  applyMeanFilter(val, raw,
-				  voxelType, rvwidth, rvheight,
-				  spread, dilateFilter);
-		  
-		  // now shift the planes
-		  uchar *tmp = val[0];
-		  for(int i=0; i<2*spread; i++)
-		    val[i] = val[i+1];
-		  val[2*spread] = tmp;
-		}
-	      
-	      if (trim || subsample)
-		{
-		  int fi = 0;
-		  for(int j=0; j<wsz2; j++)
-		    {
-		      int y0 = wmin+j*svsl;
-		      int y1 = y0+svsl-1;
-		      for(int i=0; i<hsz2; i++)
-			{
-			  int x0 = hmin+i*svsl;
-			  int x1 = x0+svsl-1;
-			  for(int y=y0; y<=y1; y++)
-			    for(int x=x0; x<=x1; x++)
-			      {
-				if (voxelType == _UChar)
-				  { uchar *ptr = raw; filtervol[fi] += ptr[y*rvheight+x]; }
-				else if (voxelType == _Char)
-				  { char *ptr = (char*)raw; filtervol[fi] += ptr[y*rvheight+x]; }
-				else if (voxelType == _UShort)
-				  { ushort *ptr = (ushort*)raw; filtervol[fi] += ptr[y*rvheight+x]; }
-				else if (voxelType == _Short)
-				  { short *ptr = (short*)raw; filtervol[fi] += ptr[y*rvheight+x]; }
-				else if (voxelType == _Int)
-				  { int *ptr = (int*)raw; filtervol[fi] += ptr[y*rvheight+x]; }
-				else if (voxelType == _Float)
-				  { float *ptr = (float*)raw; filtervol[fi] += ptr[y*rvheight+x]; }
-			      }
-			  fi++;
-			}
-		    }
-		} // trim || subsample
-	    }
-	  
-	  if (trim || subsample)
-	    {
-	      if (subsample)
-		{
-		  for(int fi=0; fi<wsz2*hsz2; fi++)
-		    filtervol[fi] /= svsl3;
-		}
-	      
-	      if (voxelType == _UChar)
-		{
-		  uchar *ptr = raw;
-		  for(int fi=0; fi<wsz2*hsz2; fi++)
-		    ptr[fi] = filtervol[fi];
-		}
-	      else if (voxelType == _Char)
-		{
-		  char *ptr = (char*)raw;
-		  for(int fi=0; fi<wsz2*hsz2; fi++)
-		    ptr[fi] = filtervol[fi];
-		}
-	      else if (voxelType == _UShort)
-		{
-		  ushort *ptr = (ushort*)raw;
-		  for(int fi=0; fi<wsz2*hsz2; fi++)
-		    ptr[fi] = filtervol[fi];
-		}
-	      else if (voxelType == _Short)
-		{
-		  short *ptr = (short*)raw;
-		  for(int fi=0; fi<wsz2*hsz2; fi++)
-		    ptr[fi] = filtervol[fi];
-		}
-	      else if (voxelType == _Int)
-		{
-		  int *ptr = (int*)raw;
-		  for(int fi=0; fi<wsz2*hsz2; fi++)
-		    ptr[fi] = filtervol[fi];
-		}
-	      else if (voxelType == _Float)
-		{
-		  float *ptr = (float*)raw;
-		  for(int fi=0; fi<wsz2*hsz2; fi++)
-		    ptr[fi] = filtervol[fi];
-		}
-	    } // trim || subsample
-	  
-	  if (saveRawFile)
-	    rawFileManager.setSlice(dd, raw);
-	  
-	  applyMapping(raw, voxelType, rawMap,
-		       pvlslice, pvlbpv, pvlMap,
-		       width, height);
+  ImportJob job;
+  job.files = timeseriesFiles;
+  job.timeseries = (timeseriesFiles.count() > 0);
+  job.pvlFile = pvlFilename;
+  if (saveRawFile)
+    job.rawFile = rawfile;
+  job.sliceZeroAtTop = save0AtTop;
+  job.overwrite = true;
+  job.dmin = dmin; job.dmax = dmax;
+  job.wmin = wmin; job.wmax = wmax;
+  job.hmin = hmin; job.hmax = hmax;
+  job.zSubsampling = svslz;
+  job.xySubsampling = svsl;
+  job.spread = spread;
+  job.dilateFilter = dilateFilter;
+  job.vx = vx; job.vy = vy; job.vz = vz;
+  job.voxelUnit = voxelUnit;
+  job.hasDescription = true;
+  job.description = description;
+  job.slabSize = slabSize;
 
-	  pvlFileManager.setSlice(dd, pvlslice);
-	}
-    }
+  QProgressDialog progress("Saving processed volume",
+			   "Cancel",
+			   0, 100,
+			   0);
+  progress.setMinimumDuration(0);
 
-  delete [] filtervol;
-  delete [] pvlslice;
-  delete [] raw;
-  if (spread > 0)
+  ImportEngine engine;
+  if (!engine.run(volData, job, &progress))
     {
-      for (int i=0; i<2*spread+1; i++)
-	delete [] val[i];
-      delete [] val;
+      progress.setValue(100);
+      QMessageBox::information(0, "Save", engine.errorString());
+      return;
     }
   
   progress.setValue(100);
@@ -2038,7 +1827,6 @@ Raw2Pvl::batchProcess(VolumeData* volData,
 
   int svslz = getZSubsampling(1024, 1024, 1024);
   int svsl = getXYSubsampling(svslz, 1024, 1024, 1024);
-  int svsl3 = svslz*svsl*svsl;
   //------------------------------------------------------
 
   //------------------------------------------------------
@@ -2058,9 +1846,6 @@ Raw2Pvl::batchProcess(VolumeData* volData,
   QString description = savePvlDialog.description();
   savePvlDialog.voxelSize(vx, vy, vz);
 
-  bool subsample = (svsl > 1 || svslz > 1);
-  bool trim = false;
-
   QProgressDialog progress("Saving processed volume",
 			   "Cancel",
 			   0, 100,
@@ -2070,18 +1855,10 @@ Raw2Pvl::batchProcess(VolumeData* volData,
   //------------------------------
   int rvdepth, rvwidth, rvheight;    
   volData->gridSize(rvdepth, rvwidth, rvheight);
-  int dmin = 0;
-  int wmin = 0;
-  int hmin = 0;
-  int dmax = rvdepth-1;
-  int wmax = rvwidth-1;
-  int hmax = rvheight-1;
-  int dsz=rvdepth;
   int wsz=rvwidth;
   int hsz=rvheight;
 
   uchar voxelType = volData->voxelType();  
-  int headerBytes = volData->headerBytes();
       
   int bpv = 1;
   if (voxelType == _UChar) bpv = 1;
@@ -2094,277 +1871,31 @@ Raw2Pvl::batchProcess(VolumeData* volData,
   //*** max 1Gb per slab
   int slabSize;
   slabSize = (1024*1024*1024)/(bpv*wsz*hsz);
-  
-  int dsz2 = dsz/svslz;
-  int wsz2 = wsz/svsl;
-  int hsz2 = hsz/svsl;
-
-  QList<float> rawMap = volData->rawMap();
-  QList<int> pvlMap = volData->pvlMap();
-  
-  int pvlbpv = 1;
-  if (pvlMap[pvlMap.count()-1] > 255)
-    pvlbpv = 2;
-      
-  int pvlVoxelType = 0;
-  if (pvlbpv == 2) pvlVoxelType = 2;
-
-  int nbytes = rvwidth*rvheight*bpv;
-  double *filtervol = new double[wsz2*hsz2];
-  uchar *pvlslice = new uchar[pvlbpv*wsz2*hsz2];
-  uchar *raw = new uchar[nbytes];
-  uchar **val;
-  if (spread > 0)
-    {
-      val = new uchar*[2*spread+1];
-      for (int i=0; i<2*spread+1; i++)
-	val[i] = new uchar[nbytes];
-    }
-  int rawSize = rawMap.size()-1;
-  int width = wsz2;
-  int height = hsz2;
-  //------------------------------
 
-  
-  //------------------------------------------------------
-  int tsfcount = qMax(1, timeseriesFiles.count());
-  bool vol4d = tsfcount > 0;
-  for (int tsf=0; tsf<tsfcount; tsf++)
+  ImportJob job;
+  job.files = timeseriesFiles;
+  job.timeseries = (timeseriesFiles.count() > 0);
+  job.pvlFile = pvlFilename;
+  if (saveRawFile)
+    job.rawFile = rawfile;
+  job.sliceZeroAtTop = save0AtTop;
+  job.overwrite = true;
+  job.zSubsampling = svslz;
+  job.xySubsampling = svsl;
+  job.spread = spread;
+  job.dilateFilter = dilateFilter;
+  job.vx = vx; job.vy = vy; job.vz = vz;
+  job.voxelUnit = voxelUnit;
+  job.hasDescription = true;
+  job.description = description;
+  job.slabSize = slabSize;
+
+  ImportEngine engine;
+  if (!engine.run(volData, job, &progress))
     {
-      QString pvlflnm = pvlFilename;
-      QString rawflnm = rawfile;
-
-      if (tsfcount > 1)
-	{
-	  QFileInfo ftpvl(pvlFilename);
-	  QFileInfo ftraw(timeseriesFiles[tsf]);
-	  pvlflnm = QFileInfo(ftpvl.absolutePath(),
-			      ftraw.completeBaseName() + ".pvl.nc").absoluteFilePath();
-
-	  rawflnm = QFileInfo(ftpvl.absolutePath(),
-			      ftraw.completeBaseName() + ".raw").absoluteFilePath();
-
-	  volData->replaceFile(timeseriesFiles[tsf]);
-	  //QStringList flnms;
-	  //flnms << timeseriesFiles[tsf];
-	  //volData->setFile(flnms, (tsf>0));
-	  //volData->setFile(flnms, vol4d);
-	}
-
-      VolumeFileManager rawFileManager;
-      VolumeFileManager pvlFileManager;
-
-      pvlFileManager.setBaseFilename(pvlflnm);
-      pvlFileManager.setDepth(dsz2);
-      pvlFileManager.setWidth(wsz2);
-      pvlFileManager.setHeight(hsz2);
-      pvlFileManager.setVoxelType(pvlVoxelType);
-      pvlFileManager.setHeaderSize(13);
-      pvlFileManager.setSlabSize(slabSize);
-      pvlFileManager.setSliceZeroAtTop(save0AtTop);
-      pvlFileManager.createFile(true);
-      
-      if (saveRawFile)
-	{
-	  rawFileManager.setBaseFilename(rawflnm);
-	  rawFileManager.setDepth(dsz2);
-	  rawFileManager.setWidth(wsz2);
-	  rawFileManager.setHeight(hsz2);
-	  rawFileManager.setVoxelType(voxelType);
-	  rawFileManager.setHeaderSize(13);
-	  rawFileManager.setSlabSize(slabSize);
-	  rawFileManager.setSliceZeroAtTop(save0AtTop);
-	  rawFileManager.createFile(true);
-	}
-      //------------------------------------------------------
-
-
-      savePvlHeader(pvlflnm,
-		    saveRawFile, rawflnm,
-		    voxelType, pvlVoxelType, voxelUnit,
-		    dsz/svslz, wsz/svsl, hsz/svsl,
-		    vx, vy, vz,
-		    rawMap, pvlMap,
-		    description,
-		    slabSize);
-
-      progress.setLabelText(pvlflnm);
-      
-      for(int dd=0; dd<dsz2; dd++)
-	{
-	  int d0 = dmin + dd*svslz; 
-	  int d1 = d0 + svslz-1;
-	  
-	  progress.setValue((int)(100*(float)dd/(float)dsz2));
-	  qApp->processEvents();
-	  
-	  memset(filtervol, 0, 8*wsz2*hsz2);
-	  for (int d=d0; d<=d1; d++)
-	    {
-	      if (spread > 0)
-		{
-		  if (d == d0)
-		    {
-		      volData->getDepthSlice(d, val[spread]);
-		      applyMeanFilterToSlice(val[spread], raw,
-					     voxelType, rvwidth, rvheight,
-					     spread, dilateFilter);
-
-		      for(int i=-spread; i<0; i++)
-			{
-			  if (d+i >= 0)
-			    volData->getDepthSlice(d+i, val[spread+i]);
-			  else
-			    volData->getDepthSlice(0, val[spread+i]);
-
-			  applyMeanFilterToSlice(val[spread+i], raw,
-						 voxelType, rvwidth, rvheight,
-						 spread, dilateFilter);
-			}
-		      
-		      for(int i=1; i<=spread; i++)
-			{
-			  if (d+i < rvdepth)
-			    volData->getDepthSlice(d+i, val[spread+i]);
-			  else
-			    volData->getDepthSlice(rvdepth-1, val[spread+i]);
-
-			  applyMeanFilterToSlice(val[spread+i], raw,
-						 voxelType, rvwidth, rvheight,
-						 spread, dilateFilter);
-			}
-		    }
-		  else if (d < rvdepth-spread)
-		    {
-		      volData->getDepthSlice(d+spread, val[2*spread]);
-		      applyMeanFilterToSlice(val[2*spread], raw,
-					     voxelType, rvwidth, rvheight,
-					     spread, dilateFilter);
-		    }
-		  else
-		    {
-		      volData->getDepthSlice(rvdepth-1, val[2*spread]);
-		      applyMeanFilterToSlice(val[2*spread], raw,
-					     voxelType, rvwidth, rvheight,
-					     spread, dilateFilter);
-		    }
-		}
-	      else
-		volData->getDepthSlice(d, raw);
-	      
-	      if (spread > 0)
-		{
-		  applyMeanFilter(val, raw,
-				  voxelType, rvwidth, rvheight,
-				  spread, dilateFilter);
-		  
-		  // now shift the planes
-		  uchar *tmp = val[0];
-		  for(int i=0; i<2*spread; i++)
-		    val[i] = val[i+1];
-		  val[2*spread] = tmp;
-		}
-	      
-	      if (trim || subsample)
-		{
-		  int fi = 0;
-		  for(int j=0; j<wsz2; j++)
-		    {
-		      int y0 = wmin+j*svsl;
-		      int y1 = y0+svsl-1;
-		      for(int i=0; i<hsz2; i++)
-			{
-			  int x0 = hmin+i*svsl;
-			  int x1 = x0+svsl-1;
-			  for(int y=y0; y<=y1; y++)
-			    for(int x=x0; x<=x1; x++)
-			      {
-				if (voxelType == _UChar)
-				  { uchar *ptr = raw; filtervol[fi] += ptr[y*rvheight+x]; }
-				else if (voxelType == _Char)
-				  { char *ptr = (char*)raw; filtervol[fi] += ptr[y*rvheight+x]; }
-				else if (voxelType == _UShort)
-				  { ushort *ptr = (ushort*)raw; filtervol[fi] += ptr[y*rvheight+x]; }
-				else if (voxelType == _Short)
-				  { short *ptr = (short*)raw; filtervol[fi] += ptr[y*rvheight+x]; }
-				else if (voxelType == _Int)
-				  { int *ptr = (int*)raw; filtervol[fi] += ptr[y*rvheight+x]; }
-				else if (voxelType == _Float)
-				  { float *ptr = (float*)raw; filtervol[fi] += ptr[y*rvheight+x]; }
-			      }
-			  fi++;
-			}
-		    }
-		} // trim || subsample
-	    }
-	  
-	  if (trim || subsample)
-	    {
-	      if (subsample)
-		{
-		  for(int fi=0; fi<wsz2*hsz2; fi++)
-		    filtervol[fi] /= svsl3;
-		}
-	      
-	      if (voxelType == _UChar)
-		{
-		  uchar *ptr = raw;
-		  for(int fi=0; fi<wsz2*hsz2; fi++)
-		    ptr[fi] = filtervol[fi];
-		}
-	      else if (voxelType == _Char)
-		{
-		  char *ptr = (char*)raw;
-		  for(int fi=0; fi<wsz2*hsz2; fi++)
-		    ptr[fi] = filtervol[fi];
-		}
-	      else if (voxelType == _UShort)
-		{
-		  ushort *ptr = (ushort*)raw;
-		  for(int fi=0; fi<wsz2*hsz2; fi++)
-		    ptr[fi] = filtervol[fi];
-		}
-	      else if (voxelType == _Short)
-		{
-		  short *ptr = (short*)raw;
-		  for(int fi=0; fi<wsz2*hsz2; fi++)
-		    ptr[fi] = filtervol[fi];
-		}
-	      else if (voxelType == _Int)
-		{
-		  int *ptr = (int*)raw;
-		  for(int fi=0; fi<wsz2*hsz2; fi++)
-		    ptr[fi] = filtervol[fi];
-		}
-	      else if (voxelType == _Float)
-		{
-		  float *ptr = (float*)raw;
-		  for(int fi=0; fi<wsz2*hsz2; fi++)
-		    ptr[fi] = filtervol[fi];
-		}
-	    } // trim || subsample
-	  
-	  if (saveRawFile)
-	    rawFileManager.setSlice(dd, raw);
-	  
-	  applyMapping(raw, voxelType, rawMap,
-		       pvlslice, pvlbpv, pvlMap,
-		       width, height);
-	  
-	  pvlFileManager.setSlice(dd, pvlslice);
-	} // end of dd loop
-
-      progress.setLabelText(QString("Processed %1 of %2").arg(tsf).arg(tsfcount));
-    }
-
-  delete [] filtervol;
-  delete [] pvlslice;
-  delete [] raw;
-  if (spread > 0)
-    {
-      for (int i=0; i<2*spread+1; i++)
-	delete [] val[i];
-      delete [] val;
+      progress.setValue(100);
+      QMessageBox::information(0, "Batch Processing", engine.errorString());
+      return;
     }
 
   progress.setValue(100);
@@ -69,16 +69,6 @@ class Raw2Pvl
 
   static void batchProcess(VolumeData*, QStringList);
 
- private :
-  static void createPvlNcFile(QString,
-			      bool, QString,
-			      int, int,
-			      int, int, int,
-			      float, float, float,
-			      QList<float>, QList<int>,
-			      QString,
-			      int);
-
   static void savePvlHeader(QString,
 			    bool, QString,
 			    int, int, int,
@@ -96,7 +86,17 @@ class Raw2Pvl
 				     int,
 				     int, int,
 				     int, bool);
-  
+
+ private :
+  static void createPvlNcFile(QString,
+			      bool, QString,
+			      int, int,
+			      int, int, int,
+			      float, float, float,
+			      QList<float>, QList<int>,
+			      QString,
+			      int);
+
 
   static void Old2NewScalar(QString, QString);
   static void Old2NewRGBA(QString, QString);
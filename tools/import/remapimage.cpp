@@ -345,13 +345,21 @@ RemapImage::setGradientStops(QGradientStops stops)
 void
 RemapImage::setImage(QImage img)
 {
+  setImage(img, img.width(), img.height());
+}
+
+void
+RemapImage::setImage(QImage img, int wd, int ht)
+{
+  // a proxy image is smaller than the slice it stands for,
+  // picking and zoom work on the size of the full slice
   m_image = img;
 
   if (m_image.format() == QImage::Format_Indexed8)
     m_image.setColorTable(m_colorMap);  
 
-  m_imgHeight = m_image.height();
-  m_imgWidth = m_image.width();
+  m_imgHeight = ht;
+  m_imgWidth = wd;
 
   resizeImage();
 
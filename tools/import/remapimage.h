@@ -31,6 +31,7 @@ class RemapImage : public QWidget
   void setGridSize(int, int, int);
   void setSliceType(int);
   void setImage(QImage);
+  void setImage(QImage, int, int);
   void setRawValue(QPair<QVariant, QVariant>);
 
   QVector<QRgb> colorMap();
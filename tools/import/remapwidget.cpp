@@ -44,6 +44,11 @@ RemapWidget::RemapWidget(QWidget *parent) :
 
   m_fileNames.clear();
   m_timeseriesFiles.clear();
+
+  m_refineTimer.setSingleShot(true);
+  m_refineTimer.setInterval(250);
+  connect(&m_refineTimer, SIGNAL(timeout()),
+	  this, SLOT(refineSlice()));
 }
 
 void
@@ -93,6 +98,8 @@ RemapWidget::setFile(QList<QString> flnm,
   m_timeseriesFiles.clear();
   Global::statusBar()->clearMessage();
 
+  m_refineTimer.stop();
+
   hideWidgets();
 
   if (m_histogramWidget)
@@ -205,6 +212,8 @@ RemapWidget::setFile(QList<QString> flnm,
   
   showWidgets();
 
+  m_volData.buildProxy();
+
   return true;
 }
 
@@ -282,14 +291,51 @@ RemapWidget::getSlice(int slc)
 {
   m_currSlice = slc;
 
+  showSlice(true);
+
+  m_slider->setValue(slc);
+}
+
+void
+RemapWidget::refineSlice()
+{
+  showSlice(false);
+}
+
+void
+RemapWidget::showSlice(bool interactive)
+{
+  //----------------------------
+  // while the user is scrubbing show the proxy slice
+  // and fetch the full resolution slice on a pause
+  if (interactive && m_volData.proxyReady())
+    {
+      int d, w, h;
+      m_volData.gridSize(d, w, h);
+
+      if (ui.butZ->isChecked())
+	m_imageWidget->setImage(m_volData.getProxySliceImage(0, m_currSlice),
+				h, w);
+      else if (ui.butY->isChecked())
+	m_imageWidget->setImage(m_volData.getProxySliceImage(1, m_currSlice),
+				h, d);
+      else if (ui.butX->isChecked())
+	m_imageWidget->setImage(m_volData.getProxySliceImage(2, m_currSlice),
+				w, d);
+
+      m_refineTimer.start();
+      return;
+    }
+  //----------------------------
+
+  m_refineTimer.stop();
+
   if (ui.butZ->isChecked())
     m_imageWidget->setImage(m_volData.getDepthSliceImage(m_currSlice));
   else if (ui.butY->isChecked())
     m_imageWidget->setImage(m_volData.getWidthSliceImage(m_currSlice));
   else if (ui.butX->isChecked())
     m_imageWidget->setImage(m_volData.getHeightSliceImage(m_currSlice));
-
-  m_slider->setValue(slc);
 }
 
 void
@@ -303,12 +349,7 @@ RemapWidget::newMapping()
 
   m_volData.setMap(rawMap, pvlMap);
   
-  if (ui.butZ->isChecked())
-    m_imageWidget->setImage(m_volData.getDepthSliceImage(m_currSlice));
-  else if (ui.butY->isChecked())
-    m_imageWidget->setImage(m_volData.getWidthSliceImage(m_currSlice));
-  else if (ui.butX->isChecked())
-    m_imageWidget->setImage(m_volData.getHeightSliceImage(m_currSlice));
+  showSlice(true);
 }
 
 void
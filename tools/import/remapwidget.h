@@ -8,6 +8,7 @@
 #include "gradienteditorwidget.h"
 #include "myslider.h"
 #include <QScrollArea>
+#include <QTimer>
 
 class RemapWidget : public QWidget
 {
@@ -64,6 +65,8 @@ class RemapWidget : public QWidget
 
   void handleTimeSeries(QString, QString);
 
+  void refineSlice();
+
  private :
   Ui::RemapWidget ui;
 
@@ -84,8 +87,12 @@ class RemapWidget : public QWidget
 
   int m_currSlice;
 
+  // full resolution slice is fetched once scrubbing pauses
+  QTimer m_refineTimer;
+
   void showWidgets();
   void hideWidgets();
+  void showSlice(bool);
 
 };
 
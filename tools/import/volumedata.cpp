@@ -4,6 +4,7 @@
 VolumeData::VolumeData()
 {
   m_image = 0;
+  m_proxy = new ProxyVolume(this);
   clear();
 }
 
@@ -15,6 +16,8 @@ VolumeData::~VolumeData()
 void
 VolumeData::clear()
 {
+  m_proxy->clear();
+
   m_fileName.clear();
   m_description.clear();
   m_depth = m_width = m_height = 0;
@@ -54,6 +57,7 @@ VolumeData::setMinMax(float rmin, float rmax)
   m_rawMin = rmin;
   m_rawMax = rmax;
   
+  QMutexLocker locker(&m_volMutex);
   m_volInterface->setMinMax(m_rawMin, m_rawMax);
   m_histogram = m_volInterface->histogram();
 }
@@ -86,6 +90,10 @@ VolumeData::replaceFile(QString flnm)
 {
 //  m_fileName.clear();
 //  m_fileName << flnm;
+
+  // proxy belongs to the previous file
+  m_proxy->clear();
+
   m_volInterface->replaceFile(flnm);
 }
 
@@ -200,6 +208,7 @@ void
 VolumeData::getDepthSlice(int slc,
 			      uchar *slice)
 {
+  QMutexLocker locker(&m_volMutex);
   m_volInterface->getDepthSlice(slc, slice);
 }
 
@@ -229,7 +238,9 @@ VolumeData::getDepthSliceImage(int slc)
 
   uchar *tmp = new uchar[nbytes];
 
+  m_volMutex.lock();
   m_volInterface->getDepthSlice(slc, tmp);
+  m_volMutex.unlock();
 
   if (m_voxelType == _Rgb || m_voxelType == _Rgba)
     {  
@@ -243,55 +254,7 @@ VolumeData::getDepthSliceImage(int slc)
       return img;
     }
 
-  int rawSize = m_rawMap.size()-1;
-  for(int i=0; i<nY*nZ; i++)
-    {
-      int idx = 0;
-      float frc = 0;
-      float v;
-
-      if (m_voxelType == _UChar)
-	v = ((uchar *)tmp)[i];
-      else if (m_voxelType == _Char)
-	v = ((char *)tmp)[i];
-      else if (m_voxelType == _UShort)
-	v = ((ushort *)tmp)[i];
-      else if (m_voxelType == _Short)
-	v = ((short *)tmp)[i];
-      else if (m_voxelType == _Int)
-	v = ((int *)tmp)[i];
-      else if (m_voxelType == _Float)
-	v = ((float *)tmp)[i];
-
-      if (v < m_rawMap[0])
-	{
-	  idx = 0;
-	  frc = 0;
-	}
-      else if (v > m_rawMap[rawSize])
-	{
-	  idx = rawSize-1;
-	  frc = 1;
-	}
-      else
-	{
-	  for(int m=0; m<rawSize; m++)
-	    {
-	      if (v >= m_rawMap[m] &&
-		  v <= m_rawMap[m+1])
-		{
-		  idx = m;
-		  frc = ((float)v-(float)m_rawMap[m])/
-		    ((float)m_rawMap[m+1]-(float)m_rawMap[m]);
-		}
-	    }
-	}
-
-      int pv = m_pvlMap[idx] + frc*(m_pvlMap[idx+1]-m_pvlMap[idx]);
-      if (m_pvlMapMax > 255)
-	pv/=256;
-      m_image[i] = pv;
-    }
+  remapSlice(tmp, m_image, nY*nZ);
   QImage img = QImage(m_image, nZ, nY, nZ, QImage::Format_Indexed8);
 
   delete [] tmp;
@@ -330,7 +293,9 @@ VolumeData::getWidthSliceImage(int slc)
 
   uchar *tmp = new uchar[nbytes];
 
+  m_volMutex.lock();
   m_volInterface->getWidthSlice(slc, tmp);
+  m_volMutex.unlock();
 
   if (m_voxelType == _Rgb || m_voxelType == _Rgba)
     {  
@@ -344,55 +309,7 @@ VolumeData::getWidthSliceImage(int slc)
       return img;
     }
 
-  int rawSize = m_rawMap.size()-1;
-  for(int i=0; i<nX*nZ; i++)
-    {
-      int idx = m_rawMap.size()-1;
-      float frc = 0;
-      float v;
-
-      if (m_voxelType == _UChar)
-	v = ((uchar *)tmp)[i];
-      else if (m_voxelType == _Char)
-	v = ((char *)tmp)[i];
-      else if (m_voxelType == _UShort)
-	v = ((ushort *)tmp)[i];
-      else if (m_voxelType == _Short)
-	v = ((short *)tmp)[i];
-      else if (m_voxelType == _Int)
-	v = ((int *)tmp)[i];
-      else if (m_voxelType == _Float)
-	v = ((float *)tmp)[i];
-
-      if (v < m_rawMap[0])
-	{
-	  idx = 0;
-	  frc = 0;
-	}
-      else if (v > m_rawMap[rawSize])
-	{
-	  idx = rawSize-1;
-	  frc = 1;
-	}
-      else
-	{
-	  for(int m=0; m<rawSize; m++)
-	    {
-	      if (v >= m_rawMap[m] &&
-		  v <= m_rawMap[m+1])
-		{
-		  idx = m;
-		  frc = ((float)v-(float)m_rawMap[m])/
-		    ((float)m_rawMap[m+1]-(float)m_rawMap[m]);
-		}
-	    }
-	}
-
-      int pv = m_pvlMap[idx] + frc*(m_pvlMap[idx+1]-m_pvlMap[idx]);
-      if (m_pvlMapMax > 255)
-	pv/=256;
-      m_image[i] = pv;
-    }
+  remapSlice(tmp, m_image, nX*nZ);
   QImage img = QImage(m_image, nZ, nX, nZ, QImage::Format_Indexed8);
 
   delete [] tmp;
@@ -431,7 +348,9 @@ VolumeData::getHeightSliceImage(int slc)
 
   uchar *tmp = new uchar[nbytes];
 
+  m_volMutex.lock();
   m_volInterface->getHeightSlice(slc, tmp);
+  m_volMutex.unlock();
 
   if (m_voxelType == _Rgb || m_voxelType == _Rgba)
     {  
@@ -445,25 +364,36 @@ VolumeData::getHeightSliceImage(int slc)
       return img;
     }
 
+  remapSlice(tmp, m_image, nX*nY);
+  QImage img = QImage(m_image, nY, nX, nY, QImage::Format_Indexed8);
+
+  delete [] tmp;
+
+  return img;
+}
+
+void
+VolumeData::remapSlice(uchar *raw, uchar *img, int n)
+{
   int rawSize = m_rawMap.size()-1;
-  for(int i=0; i<nX*nY; i++)
+  for(int i=0; i<n; i++)
     {
-      int idx = m_rawMap.size()-1;
+      int idx = 0;
       float frc = 0;
       float v;
 
       if (m_voxelType == _UChar)
-	v = ((uchar *)tmp)[i];
+	v = ((uchar *)raw)[i];
       else if (m_voxelType == _Char)
-	v = ((char *)tmp)[i];
+	v = ((char *)raw)[i];
       else if (m_voxelType == _UShort)
-	v = ((ushort *)tmp)[i];
+	v = ((ushort *)raw)[i];
       else if (m_voxelType == _Short)
-	v = ((short *)tmp)[i];
+	v = ((short *)raw)[i];
       else if (m_voxelType == _Int)
-	v = ((int *)tmp)[i];
+	v = ((int *)raw)[i];
       else if (m_voxelType == _Float)
-	v = ((float *)tmp)[i];
+	v = ((float *)raw)[i];
 
       if (v < m_rawMap[0])
 	{
@@ -492,9 +422,63 @@ VolumeData::getHeightSliceImage(int slc)
       int pv = m_pvlMap[idx] + frc*(m_pvlMap[idx+1]-m_pvlMap[idx]);
       if (m_pvlMapMax > 255)
 	pv/=256;
-      m_image[i] = pv;
+      img[i] = pv;
+    }
+}
+
+void
+VolumeData::buildProxy()
+{
+  int bpv = m_bytesPerVoxel;
+  if (m_voxelType == _Rgb || m_voxelType == _Rgba)
+    bpv = 4;
+
+  m_proxy->build(m_volInterface, &m_volMutex,
+		 m_depth, m_width, m_height,
+		 bpv);
+}
+
+bool VolumeData::proxyReady() { return m_proxy->ready(); }
+
+QImage
+VolumeData::getProxySliceImage(int axis, int slc)
+{
+  int pd, pw, ph;
+  m_proxy->gridSize(pd, pw, ph);
+
+  int bpv = m_bytesPerVoxel;
+  bool rgb = (m_voxelType == _Rgb || m_voxelType == _Rgba);
+  if (rgb)
+    bpv = 4;
+
+  int maxSlice = qMax(pw*ph, qMax(pd*ph, pd*pw));
+  uchar *tmp = new uchar[maxSlice*bpv];
+
+  int sw, sh;
+  if (!m_proxy->getSlice(axis, slc, tmp, sw, sh))
+    {
+      delete [] tmp;
+      return QImage();
+    }
+
+  QImage img;
+  if (rgb)
+    {
+      img = QImage(sw, sh, QImage::Format_ARGB32);
+      for(int y=0; y<sh; y++)
+	memcpy(img.scanLine(y), tmp + 4*y*sw, 4*sw);
+    }
+  else
+    {
+      uchar *pvl = new uchar[sw*sh];
+      remapSlice(tmp, pvl, sw*sh);
+
+      img = QImage(sw, sh, QImage::Format_Indexed8);
+      for(int y=0; y<sh; y++)
+	memcpy(img.scanLine(y), pvl + y*sw, sw);
+
+      delete [] pvl;
     }
-  QImage img = QImage(m_image, nY, nX, nY, QImage::Format_Indexed8);
 
   delete [] tmp;
 
@@ -515,7 +499,9 @@ VolumeData::rawValue(int d, int w, int h)
       return pair;
     }
 
+  m_volMutex.lock();
   QVariant v = m_volInterface->rawValue(d, w, h);
+  m_volMutex.unlock();
 
   if (v.type() == QVariant::String)
     {
@@ -578,6 +564,7 @@ VolumeData::saveTrimmed(QString trimFile,
 		       int wmin, int wmax,
 		       int hmin, int hmax)
 {
+  QMutexLocker locker(&m_volMutex);
   m_volInterface->saveTrimmed(trimFile,
 			      dmin, dmax,
 			      wmin, wmax,
@@ -2,6 +2,7 @@
 #define VOLUMEDATA_H
 
 #include "volinterface.h"
+#include "proxyvolume.h"
 
 class VolumeData : public QObject
 {
@@ -40,6 +41,12 @@ class VolumeData : public QObject
   QImage getWidthSliceImage(int);
   QImage getHeightSliceImage(int);
 
+  // low resolution preview, built in the background.
+  // axis is 0 for depth, 1 for width and 2 for height slices
+  void buildProxy();
+  bool proxyReady();
+  QImage getProxySliceImage(int, int);
+
   QPair<QVariant,QVariant> rawValue(int, int, int);
 
   void saveTrimmed(QString, int, int, int, int, int, int);
@@ -47,6 +54,10 @@ class VolumeData : public QObject
  private :
   VolInterface *m_volInterface;
 
+  // serialises plugin access with the proxy thread
+  QMutex m_volMutex;
+  ProxyVolume *m_proxy;
+
   QStringList m_fileName;
   int m_depth, m_width, m_height;
   int m_voxelUnit;
@@ -70,6 +81,7 @@ class VolumeData : public QObject
 
   void clear();
   bool loadPlugin(QString);
+  void remapSlice(uchar*, uchar*, int);
 };
 
 #endif
@@ -88,7 +88,7 @@ VolumeFileManager::exists()
 }
 
 void
-VolumeFileManager::createFile(bool writeHeader)
+VolumeFileManager::createFile(bool writeHeader, bool showProgress)
 {
   int bps = m_width*m_height*m_bytesPerVoxel;
   if (!m_slice)
@@ -107,20 +107,27 @@ VolumeFileManager::createFile(bool writeHeader)
   if (m_voxelType == _Int) vt = 4; // int
   if (m_voxelType == _Float) vt = 8; // float
 
-  QProgressDialog progress(QString("Allocating space for\n%1\non disk").\
-			   arg(m_baseFilename),
-			   "Cancel",
-			   0, 100,
-			   0);
-  progress.setMinimumDuration(0);
+  QProgressDialog *progress = 0;
+  if (showProgress)
+    {
+      progress = new QProgressDialog(QString("Allocating space for\n%1\non disk"). \
+				     arg(m_baseFilename),
+				     "Cancel",
+				     0, 100,
+				     0);
+      progress->setMinimumDuration(0);
+    }
 
   for(int ns=0; ns<nslabs; ns++)
     {
       m_filename = m_baseFilename +
 	QString(".%1").arg(ns+1, 3, 10, QChar('0'));
 
-      progress.setLabelText(m_filename);
-      qApp->processEvents();
+      if (progress)
+	{
+	  progress->setLabelText(m_filename);
+	  qApp->processEvents();
+	}
 
       m_qfile.setFileName(m_filename);
       m_qfile.open(QFile::WriteOnly);
@@ -144,7 +151,11 @@ VolumeFileManager::createFile(bool writeHeader)
       m_qfile.close();
     }
 
-  progress.setValue(100);
+  if (progress)
+    {
+      progress->setValue(100);
+      delete progress;
+    }
 }
 
 uchar*
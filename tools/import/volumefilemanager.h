@@ -32,7 +32,8 @@ class VolumeFileManager
   void setDepth(int);
   void setWidth(int);
   void setHeight(int);
-  void createFile(bool);
+  // showProgress false : no dialog, for headless runs
+  void createFile(bool, bool showProgress=true);
   
   void removeFile();
 
@@ -0,0 +1,340 @@
+#include "benchmark.h"
+#include "benchmarkdata.h"
+#include "volumefilemanager.h"
+#include "marchingcubes.h"
+#include "livewire.h"
+#include "maskfilter.h"
+
+#include <QDir>
+#include <QElapsedTimer>
+
+#include "graphcut.h"
+
+#include <math.h>
+#include <string.h>
+
+int
+Benchmark::run(QStringList args)
+{
+  QList<int> sizes;
+  for(int i=0; i<args.count(); i++)
+    {
+      bool ok;
+      int n = args[i].toInt(&ok);
+      if (ok && n >= 8)
+	sizes << n;
+    }
+  if (sizes.count() == 0)
+    sizes << 64 << 128 << 256;
+
+  QTextStream out(stdout);
+
+  int failed = 0;
+  for(int s=0; s<sizes.count(); s++)
+    {
+      failed += fileAccess(out, VolumeFileManager::_UChar, sizes[s]);
+      failed += fileAccess(out, VolumeFileManager::_UShort, sizes[s]);
+    }
+
+  for(int s=0; s<sizes.count(); s++)
+    failed += meshGeneration(out, sizes[s]);
+
+  for(int s=0; s<sizes.count(); s++)
+    failed += maskFilter(out, sizes[s]);
+
+  for(int s=0; s<sizes.count(); s++)
+    {
+      failed += graphCut(out, sizes[s]);
+      failed += liveWire(out, sizes[s]);
+    }
+
+  return (failed > 0 ? 1 : 0);
+}
+
+int
+Benchmark::fileAccess(QTextStream &out, int voxelType, int n)
+{
+  int bpv = (voxelType == VolumeFileManager::_UShort) ? 2 : 1;
+  QString type = (bpv == 1) ? "uchar" : "ushort";
+
+  // two slabs so that switching between files is part of the timing
+  int slabSize = qMax(1, (n+1)/2);
+  QString baseFilename = QDir(QDir::tempPath()).
+                           filePath(QString("drishtipaint-benchmark-%1").arg(n));
+  uchar *vol = BenchmarkData::syntheticVolume(voxelType, n);
+  BenchmarkData::writeVolume(baseFilename, voxelType, n, slabSize, vol);
+
+  VolumeFileManager vfm;
+  vfm.setBaseFilename(baseFilename);
+  vfm.setDepth(n);
+  vfm.setWidth(n);
+  vfm.setHeight(n);
+  vfm.setHeaderSize(13);
+  vfm.setSlabSize(slabSize);
+  vfm.setVoxelType(voxelType);
+
+  int failed = 0;
+  qint64 bps = (qint64)bpv*n*n;
+  QElapsedTimer timer;
+
+  //-------- depth slices
+  timer.start();
+  for(int d=0; d<n; d++)
+    {
+      uchar *slice = vfm.getSlice(d);
+      if (memcmp(slice, vol + d*bps, bps) != 0)
+	failed++;
+    }
+  BenchmarkData::report(out, "getSlice", type, n, timer.nsecsElapsed(),
+			n*bps, (qint64)n*n*n, "voxels");
+
+  //-------- width and height slices read across all slices
+  int nsample = qMin(n, 16);
+  timer.start();
+  for(int s=0; s<nsample; s++)
+    {
+      int w = s*(n-1)/qMax(1, nsample-1);
+      uchar *slice = vfm.getWidthSlice(w);
+      for(int d=0; d<n; d++)
+	if (memcmp(slice + d*n*bpv, vol + d*bps + w*n*bpv, n*bpv) != 0)
+	  failed++;
+    }
+  BenchmarkData::report(out, "getWidthSlice", type, n, timer.nsecsElapsed(),
+			nsample*bps, (qint64)nsample*n*n, "voxels");
+
+  nsample = qMin(n, 4);
+  timer.start();
+  for(int s=0; s<nsample; s++)
+    {
+      int h = s*(n-1)/qMax(1, nsample-1);
+      uchar *slice = vfm.getHeightSlice(h);
+      for(int d=0; d<n; d++)
+	for(int w=0; w<n; w++)
+	  if (memcmp(slice + (d*n+w)*bpv,
+		     vol + d*bps + (w*n+h)*bpv, bpv) != 0)
+	    failed++;
+    }
+  BenchmarkData::report(out, "getHeightSlice", type, n, timer.nsecsElapsed(),
+			nsample*bps, (qint64)nsample*n*n, "voxels");
+
+  if (failed > 0)
+    out << QString("  %1 : %2 mismatches\n").arg(baseFilename).arg(failed);
+
+  vfm.removeFile();
+  delete [] vol;
+
+  return (failed > 0 ? 1 : 0);
+}
+
+int
+Benchmark::meshGeneration(QTextStream &out, int n)
+{
+  uchar *vol = BenchmarkData::syntheticVolume(VolumeFileManager::_UChar, n);
+
+  MarchingCubes mc;
+  mc.set_progress(false);
+  mc.set_resolution(n, n, n);
+  mc.set_ext_data(vol);
+  mc.init_all();
+
+  QElapsedTimer timer;
+  timer.start();
+  mc.run(128);
+  qint64 nsecs = timer.nsecsElapsed();
+
+  BenchmarkData::report(out, "MarchingCubes", "uchar", n, nsecs,
+			0, mc.ntrigs(), "triangles");
+
+  int failed = (mc.ntrigs() == 0);
+  mc.clean_all();
+  delete [] vol;
+
+  return failed;
+}
+
+// thresholded box filter of one line of on/off voxels
+// as done by the per slice filters, window clipped at the ends
+static void
+boxLine(uchar *in, uchar *out, int len, qint64 stride,
+	int spread, int thresh)
+{
+  for(int x=0; x<len; x++)
+    {
+      int x0 = qMax(0, x-spread);
+      int x1 = qMin(len-1, x+spread);
+      int sum = 0;
+      for(int i=x0; i<=x1; i++)
+	sum += (in[i*stride] > 0 ? 255 : 0);
+      out[x*stride] = (sum > thresh*(x1-x0+1) ? 255 : 0);
+    }
+}
+
+// the per slice filters for all tags - non-zero voxels are one
+// region, filtered along w and h for every threshold and then along
+// d, and only untagged voxels are written back
+static void
+perSliceFilter(uchar *mask, int n, int op, int spread, uchar *res)
+{
+  qint64 slc = (qint64)n*n;
+  qint64 nvox = slc*n;
+  uchar *on = new uchar[nvox];
+  uchar *tmp = new uchar[nvox];
+  memcpy(on, mask, nvox);
+
+  QList<int> thresholds;
+  if (op == MaskFilter::Dilate) thresholds << 64;
+  else if (op == MaskFilter::Erode) thresholds << 192;
+  else thresholds << 64 << 192;
+
+  for(int t=0; t<thresholds.count(); t++)
+    for(int d=0; d<n; d++)
+      {
+	for(int h=0; h<n; h++)
+	  boxLine(on + d*slc + h, tmp + d*slc + h, n, n,
+		  spread, thresholds[t]);
+	for(int w=0; w<n; w++)
+	  boxLine(tmp + d*slc + w*n, on + d*slc + w*n, n, 1,
+		  spread, thresholds[t]);
+      }
+
+  for(int t=0; t<thresholds.count(); t++)
+    {
+      for(qint64 i=0; i<slc; i++)
+	boxLine(on + i, tmp + i, n, slc, spread, thresholds[t]);
+      memcpy(on, tmp, nvox);
+    }
+
+  for(qint64 i=0; i<nvox; i++)
+    res[i] = (mask[i] == 0 ? on[i] : mask[i]);
+
+  delete [] on;
+  delete [] tmp;
+}
+
+int
+Benchmark::maskFilter(QTextStream &out, int n)
+{
+  uchar *vol = BenchmarkData::syntheticVolume(VolumeFileManager::_UChar, n);
+
+  // two tags and untagged voxels between the shells
+  qint64 nvox = (qint64)n*n*n;
+  uchar *mask = new uchar[nvox];
+  for(qint64 i=0; i<nvox; i++)
+    mask[i] = (vol[i] > 160 ? 2 : (vol[i] > 96 ? 1 : 0));
+
+  uchar *res = new uchar[nvox];
+  uchar *ref = new uchar[nvox];
+  QList<int> tags;
+  tags << -1;
+
+  QString names[3] = { "smooth", "dilate", "erode" };
+  int failed = 0;
+  for(int op=0; op<3; op++)
+    {
+      int spread = 2;
+      QElapsedTimer timer;
+      timer.start();
+      MaskFilter::apply(mask, n, n, n, n, n, tags, op, spread, res);
+      qint64 nsecs = timer.nsecsElapsed();
+
+      BenchmarkData::report(out, "MaskFilter "+names[op], "uchar", n, nsecs,
+			    0, nvox, "voxels");
+
+      // the direct per slice filters cost spread per voxel and axis,
+      // keep the comparison small
+      if (n > 64)
+	continue;
+
+      perSliceFilter(mask, n, op, spread, ref);
+      int mismatch = 0;
+      for(qint64 i=0; i<nvox; i++)
+	if (res[i] != ref[i])
+	  mismatch++;
+      if (mismatch > 0)
+	{
+	  out << QString("  MaskFilter %1 : %2 voxels differ "
+			 "from the per slice filters\n").arg(names[op]).arg(mismatch);
+	  failed++;
+	}
+    }
+
+  delete [] vol;
+  delete [] mask;
+  delete [] res;
+  delete [] ref;
+
+  return (failed > 0 ? 1 : 0);
+}
+
+int
+Benchmark::graphCut(QTextStream &out, int n)
+{
+  uchar *vol = BenchmarkData::syntheticVolume(VolumeFileManager::_UChar, n);
+  uchar *image = vol + (qint64)(n/2)*n*n;
+
+  // background along the border, object in the middle
+  int tag = 1;
+  uchar *mask = new uchar[n*n];
+  uchar *tags = new uchar[n*n];
+  memset(mask, 0, n*n);
+  memset(tags, 0, n*n);
+  int rad = qMax(1, n/16);
+  for(int j=0; j<n; j++)
+    for(int i=0; i<n; i++)
+      {
+	if (i == 0 || j == 0 || i == n-1 || j == n-1)
+	  mask[j*n+i] = 255;
+	else if (qAbs(i-n/2) < rad && qAbs(j-n/2) < rad)
+	  mask[j*n+i] = tag;
+      }
+
+  MaxFlowMinCut mfmc;
+  QElapsedTimer timer;
+  timer.start();
+  int tagged = mfmc.run(n, n, 5, 1.0f, false,
+			image, mask, tag, tags);
+  qint64 nsecs = timer.nsecsElapsed();
+
+  BenchmarkData::report(out, "graphcut", "uchar", n, nsecs,
+			0, (qint64)n*n, "pixels");
+
+  delete [] mask;
+  delete [] tags;
+  delete [] vol;
+
+  return (tagged == 0 ? 1 : 0);
+}
+
+int
+Benchmark::liveWire(QTextStream &out, int n)
+{
+  uchar *vol = BenchmarkData::syntheticVolume(VolumeFileManager::_UChar, n);
+  uchar *image = vol + (qint64)(n/2)*n*n;
+
+  // seeds around the innermost shell
+  QVector<QPoint> seeds;
+  float c = 0.5f*(n-1);
+  float rad = c/3;
+  for(int i=0; i<8; i++)
+    {
+      float a = 2*3.14159265f*i/8;
+      seeds << QPoint((int)(c + rad*cosf(a)), (int)(c + rad*sinf(a)));
+    }
+
+  // reset sets up the gradient cost table, as in ImageWidget
+  LiveWire livewire;
+  livewire.reset();
+  QElapsedTimer timer;
+  timer.start();
+  livewire.setImageData(n, n, image);
+  livewire.setGuessCurve(seeds);
+  livewire.livewireFromSeeds(seeds);
+  qint64 nsecs = timer.nsecsElapsed();
+
+  BenchmarkData::report(out, "livewire", "uchar", n, nsecs,
+			0, (qint64)n*n, "pixels");
+
+  delete [] vol;
+
+  return (livewire.poly().count() == 0 ? 1 : 0);
+}
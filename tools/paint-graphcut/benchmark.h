@@ -0,0 +1,28 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <QStringList>
+#include <QTextStream>
+
+//---------------------------------------
+// drishtipaint --benchmark [size ...]
+// times volume file access, mesh generation, the mask filters and
+// the graphcut and livewire solvers on synthetic size^3 volumes
+// without opening any window or dialog.  the mask filters are also
+// checked against the per slice filters for all tags (-1).  one line is printed per case so that the output
+// of two runs can be compared directly.
+//---------------------------------------
+class Benchmark
+{
+ public :
+  static int run(QStringList);
+
+ private :
+  static int fileAccess(QTextStream&, int, int);
+  static int meshGeneration(QTextStream&, int);
+  static int maskFilter(QTextStream&, int);
+  static int graphCut(QTextStream&, int);
+  static int liveWire(QTextStream&, int);
+};
+
+#endif
@@ -1,47 +1,94 @@
 #include "bitmapthread.h"
 
+#include <QtConcurrentMap>
+
+// voxels per slab - slabs are the unit of reuse and of parallel work
+static const int slabVoxels = 1<<22;
+
 BitmapThread::BitmapThread(QObject *parent) : QThread(parent)
 {
   m_interrupt = false;
+  m_abort = false;
+  m_busy = false;
+  m_reset = false;
+  m_volData = 0;
   m_depth = m_height = m_width = 0;
   m_bitmask.clear();
+
+  m_slabDepth = 0;
+  m_nslabs = 0;
+  m_present = 0;
+  m_built = 0;
+  m_scanned = 0;
+  m_pending = false;
 }
 
 BitmapThread::~BitmapThread()
 {
   mutex.lock();
+  m_abort = true;
   m_interrupt = true;
   condition.wakeOne();
   mutex.unlock();
 
   wait();
+
+  if (m_present) delete [] m_present;
+  if (m_built) delete [] m_built;
+  if (m_scanned) delete [] m_scanned;
+}
+
+void
+BitmapThread::cancel()
+{
+  QMutexLocker locker(&mutex);
+  m_depth = m_width = m_height = 0;
+  m_volData = 0;
+  m_reset = true;
+  m_bitmask.clear();
+
+  if (m_busy)
+    {
+      m_interrupt = true;
+      condition.wakeOne();
+      while (m_busy)
+	idle.wait(&mutex);
+    }
 }
 
 void
-BitmapThread::setFiles(QString pvlfile, QString gradfile,
+BitmapThread::setFiles(QString pvlfile, QStringList pvlnames,
+		       int headerSize,
 		       int depth, int width, int height,
-		       int slabSize)
+		       int slabSize,
+		       uchar *volData)
 {
+  cancel();
+
+  QMutexLocker locker(&mutex);
+
   m_depth = depth;
   m_width = width;
   m_height = height;
+  m_volData = volData;
+  m_reset = true;
 
+  if (pvlnames.count() > 0)
+    m_pvlFileManager.setFilenameList(pvlnames);
   m_pvlFileManager.setBaseFilename(pvlfile);
   m_pvlFileManager.setDepth(depth);
   m_pvlFileManager.setWidth(width);
   m_pvlFileManager.setHeight(height);
-  m_pvlFileManager.setHeaderSize(13);
+  m_pvlFileManager.setHeaderSize(headerSize);
   m_pvlFileManager.setSlabSize(slabSize);
-
-//  m_gradFileManager.setBaseFilename(gradfile);
-//  m_gradFileManager.setDepth(depth);
-//  m_gradFileManager.setWidth(width);
-//  m_gradFileManager.setHeight(height);
-//  m_gradFileManager.setHeaderSize(13);
-//  m_gradFileManager.setSlabSize(slabSize);
 }
 
-QBitArray BitmapThread::bitmask() { return m_bitmask; }
+QBitArray
+BitmapThread::bitmask()
+{
+  QMutexLocker locker(&mutex);
+  return m_bitmask;
+}
 
 void
 BitmapThread::createBitmask(uchar *lut)
@@ -56,7 +103,36 @@ BitmapThread::createBitmask(uchar *lut)
       m_interrupt = true;
       condition.wakeOne();
     }
-  
+
+}
+
+void
+BitmapThread::resetSlabs()
+{
+  if (m_present) delete [] m_present;
+  if (m_built) delete [] m_built;
+  if (m_scanned) delete [] m_scanned;
+  m_present = 0;
+  m_built = 0;
+  m_scanned = 0;
+  m_nslabs = 0;
+  m_pending = false;
+
+  m_bits.resize(m_depth, m_width, m_height);
+  m_work.resize((qint64)m_depth*m_width*m_height);
+  m_work.fill(false);
+
+  if (m_depth == 0)
+    return;
+
+  m_slabDepth = qMax(1, slabVoxels/qMax(1, m_width*m_height));
+  m_nslabs = (m_depth+m_slabDepth-1)/m_slabDepth;
+  m_present = new quint64[4*m_nslabs];
+  m_built = new quint64[4*m_nslabs];
+  m_scanned = new bool[m_nslabs];
+  memset(m_present, 0, 4*m_nslabs*sizeof(quint64));
+  memset(m_built, 0, 4*m_nslabs*sizeof(quint64));
+  memset(m_scanned, 0, m_nslabs);
 }
 
 void
@@ -65,72 +141,263 @@ BitmapThread::run()
   forever
     {
       mutex.lock();
+      if (m_abort)
+	{
+	  mutex.unlock();
+	  return;
+	}
+      m_busy = true;
       uchar lut[4*256*256];
       memcpy(lut, m_lut, 4*256*256);
+      if (m_reset)
+	{
+	  m_reset = false;
+	  resetSlabs();
+	}
+      uchar *volData = m_volData;
       mutex.unlock();
 
-      QBitArray bitmask;
-      bitmask.resize((qint64)m_depth*m_width*m_height);
-      bitmask.fill(false);
-      
-      int nbytes = m_width*m_height;
-      uchar *tmp = new uchar [2*nbytes];
-      
-      int nonZeroVoxels = 0;
-      
-      qint64 bidx = 0;
-      for(int d=0; d<m_depth; d++)
+      //----------------------------------
+      // opacity of every voxel value
+      uchar op[256];
+      quint64 opacity[4] = { 0, 0, 0, 0 };
+      for(int v=0; v<256; v++)
+	{
+	  op[v] = (lut[4*v+3] > 0);
+	  if (op[v])
+	    opacity[v/64] |= 1ULL << (v%64);
+	}
+
+      //----------------------------------
+      // slabs containing values whose opacity changed
+      QList<SlabJob> jobs;
+      for(int s=0; s<m_nslabs; s++)
+	{
+	  quint64 *present = m_present + 4*s;
+	  quint64 *built = m_built + 4*s;
+	  bool dirty = !m_scanned[s];
+	  for(int i=0; i<4; i++)
+	    dirty |= (((built[i]^opacity[i]) & present[i]) != 0);
+	  if (!dirty)
+	    continue;
+
+	  SlabJob job;
+	  job.d0 = s*m_slabDepth;
+	  job.d1 = qMin(m_depth, job.d0+m_slabDepth)-1;
+	  job.vol = 0;
+	  if (volData)
+	    job.vol = volData + (qint64)job.d0*m_width*m_height;
+	  job.bits = &m_bits;
+	  job.op = op;
+	  job.opacity = opacity;
+	  job.present = present;
+	  job.built = built;
+	  job.scan = !m_scanned[s];
+	  job.interrupt = &m_interrupt;
+	  job.done = false;
+	  jobs << job;
+	}
+
+      //----------------------------------
+      // a batch at a time so that progress can be shown
+      int batch = qMax(1, 4*QThread::idealThreadCount());
+      uchar *slab = 0;
+      if (!volData && jobs.count() > 0)
+	slab = new uchar[(qint64)m_slabDepth*m_width*m_height];
+      for(int b0=0; b0<jobs.count(); b0+=batch)
 	{
 	  if (m_interrupt)
 	    break;
-	  
-	  emit progressChanged((int)(100.0*(float)d/(float)m_depth));
-	  
-	  memset(tmp, 0, 2*nbytes);
-
-	  uchar *vslice;
-	  vslice = m_pvlFileManager.getSlice(d);
-	  for(int t=0; t<nbytes; t++)
-	    tmp[2*t] = vslice[t];
-	  
-	  //vslice = m_gradFileManager.getSlice(d);
-	  //for(int t=0; t<nbytes; t++)
-	  //  tmp[2*t+1] = vslice[t];
-	  
-	  for(int w=0; w<m_width; w++)
-	    for(int h=0; h<m_height; h++)
-	      {
-		unsigned char v,g;
-		int idx = (w*m_height + h);
-		v = tmp[2*idx];
-		g = tmp[2*idx+1];
-		bool op = (lut[4*(256*g + v)+3] > 0);	   
-		if (op)
-		  {
-		    bitmask.setBit(bidx);
-		    
-		    // count number of nonzero voxels
-		    // that will give us volume
-		    nonZeroVoxels++;		    
-		  }
-		bidx++;
-	      }
+
+	  emit progressChanged((int)(100.0*(float)b0/(float)jobs.count()));
+
+	  int b1 = qMin(jobs.count(), b0+batch);
+	  if (volData)
+	    {
+	      QList<SlabJob> bjobs = jobs.mid(b0, b1-b0);
+	      QtConcurrent::blockingMap(bjobs, BitmapThread::buildSlab);
+	      for(int j=b0; j<b1; j++)
+		jobs[j].done = bjobs[j-b0].done;
+	    }
+	  else
+	    {
+	      // volume not in memory - slices have to be read in order
+	      qint64 nbytes = (qint64)m_width*m_height;
+	      for(int j=b0; j<b1 && !m_interrupt; j++)
+		{
+		  for(int d=jobs[j].d0; d<=jobs[j].d1; d++)
+		    memcpy(slab + (d-jobs[j].d0)*nbytes,
+			   m_pvlFileManager.getSlice(d), nbytes);
+		  jobs[j].vol = slab;
+		  buildSlab(jobs[j]);
+		}
+	    }
+	}
+      if (slab)
+	delete [] slab;
+
+      //----------------------------------
+      // slabs copied during an interrupted run are
+      // published by the next run that completes
+      for(int j=0; j<jobs.count(); j++)
+	{
+	  if (jobs[j].done)
+	    {
+	      m_scanned[jobs[j].d0/m_slabDepth] = true;
+	      copySlab(jobs[j].d0, jobs[j].d1);
+	      m_pending = true;
+	    }
 	}
-      
-      delete [] tmp;
-      
-      emit progressReset();
 
-      m_bitmask = bitmask;
+      if (jobs.count() > 0)
+	emit progressReset();
+
+      bool publish = false;
+      mutex.lock();
+      if (m_pending && !m_interrupt)
+	{
+	  m_bitmask = m_work;
+	  m_pending = false;
+	  publish = true;
+	}
+      mutex.unlock();
+
+      if (publish)
+	emit bitmaskChanged();
 
       // now that we have finished our work
       // go to sleep by waiting for interrupt to become true
       // it interrupt is already true then continue with
       // the next job
       mutex.lock();
+      m_busy = false;
+      idle.wakeAll();
       if (!m_interrupt)
 	condition.wait(&mutex);
       m_interrupt = false;
       mutex.unlock();
     }
 }
+
+void
+BitmapThread::buildSlab(SlabJob &job)
+{
+  int width = job.bits->width();
+  int height = job.bits->height();
+  int wpr = job.bits->wordsPerRow();
+  qint64 wh = (qint64)width*height;
+
+  // mask for the unused bits of the last word of a row
+  quint64 tail = ~0ULL;
+  if (height%64)
+    tail = (1ULL << (height%64)) - 1;
+
+  // slab contains only transparent or only opaque values -
+  // no need to look at the voxels
+  int fill = -1;
+  if (!job.scan)
+    {
+      bool anyOn = false, anyOff = false;
+      for(int i=0; i<4; i++)
+	{
+	  anyOn |= ((job.present[i] & job.opacity[i]) != 0);
+	  anyOff |= ((job.present[i] & ~job.opacity[i]) != 0);
+	}
+      if (!anyOn) fill = 0;
+      else if (!anyOff) fill = 1;
+    }
+
+  const uchar *op = job.op;
+  quint64 present[4] = { 0, 0, 0, 0 };
+
+  for(int d=job.d0; d<=job.d1; d++)
+    {
+      if (*job.interrupt)
+	return;
+
+      const uchar *slice = job.vol + (d-job.d0)*wh;
+      for(int w=0; w<width; w++)
+	{
+	  quint64 *r = job.bits->row(d, w);
+	  const uchar *v = slice + w*height;
+
+	  if (fill >= 0)
+	    {
+	      for(int i=0; i<wpr; i++)
+		r[i] = (fill ? ~0ULL : 0);
+	      r[wpr-1] &= tail;
+	      continue;
+	    }
+
+	  int h = 0;
+	  int i = 0;
+	  for(; h+64<=height; h+=64, i++)
+	    {
+	      const uchar *p = v + h;
+	      quint64 word = 0;
+	      for(int b=0; b<64; b++)
+		word |= (quint64)op[p[b]] << b;
+	      r[i] = word;
+	    }
+	  if (h < height)
+	    {
+	      quint64 word = 0;
+	      for(int b=0; h+b<height; b++)
+		word |= (quint64)op[v[h+b]] << b;
+	      r[i] = word;
+	    }
+
+	  if (job.scan)
+	    for(h=0; h<height; h++)
+	      present[v[h]>>6] |= 1ULL << (v[h]&63);
+	}
+    }
+
+  if (job.scan)
+    for(int i=0; i<4; i++)
+      job.present[i] = present[i];
+  for(int i=0; i<4; i++)
+    job.built[i] = job.opacity[i];
+  job.done = true;
+}
+
+void
+BitmapThread::copySlab(int d0, int d1)
+{
+  qint64 bidx = (qint64)d0*m_width*m_height;
+  m_work.fill(false, bidx, (qint64)(d1+1)*m_width*m_height);
+
+  for(int d=d0; d<=d1; d++)
+    for(int w=0; w<m_width; w++)
+      {
+	const quint64 *r = m_bits.constRow(d, w);
+	int h = 0;
+	while (h < m_height)
+	  {
+	    quint64 word = r[h/64] >> (h%64);
+	    if (word == 0)
+	      {
+		h = (h/64+1)*64;
+		continue;
+	      }
+	    while (!(word & 1))
+	      {
+		word >>= 1;
+		h++;
+	      }
+	    int h0 = h;
+	    while (h < m_height)
+	      {
+		if (h%64 == 0 && r[h/64] == ~0ULL)
+		  h += 64;
+		else if ((r[h/64] >> (h%64)) & 1)
+		  h++;
+		else
+		  break;
+	      }
+	    h = qMin(h, m_height);
+	    m_work.fill(true, bidx+h0, bidx+h);
+	  }
+	bidx += m_height;
+      }
+}
@@ -6,7 +6,16 @@
 #include <QWaitCondition>
 
 #include "volumefilemanager.h"
+#include "bitmorphology.h"
 
+//---------------------------------------
+// builds the opacity bitmask (voxels with non-zero lut alpha)
+// in the background.  the volume is split into slabs of slices
+// that are built in parallel, 64 voxels per word.  for every slab
+// we remember which voxel values it contains and the opacity of
+// those values it was last built with, so a lut edit only rebuilds
+// slabs that contain values whose opacity actually changed.
+//---------------------------------------
 class BitmapThread : public QThread
 {
   Q_OBJECT
@@ -15,27 +24,70 @@ public :
   BitmapThread(QObject *parent = 0);
   ~BitmapThread();
 
-  void setFiles(QString, QString,
-		int, int, int, int);
+  // pvl file, pvl file list, header size,
+  // depth, width, height, slab size,
+  // in-memory volume (0 if the volume is not loaded in memory)
+  void setFiles(QString, QStringList, int,
+		int, int, int, int,
+		uchar*);
   void createBitmask(uchar*);
   QBitArray bitmask();
 
+  // stop the current build and forget the volume
+  void cancel();
+
  signals :
   void progressChanged(int);
   void progressReset();
+  void bitmaskChanged();
 
  protected:
   void run();
 
  private:
+  struct SlabJob
+  {
+    // voxels of slice d0 onwards
+    const uchar *vol;
+    BitVolume *bits;
+    int d0, d1;
+    const uchar *op;
+    const quint64 *opacity;
+    quint64 *present;
+    quint64 *built;
+    bool scan;
+    volatile bool *interrupt;
+    bool done;
+  };
+
   QWaitCondition condition;
+  QWaitCondition idle;
   QMutex mutex;
-  bool m_interrupt;
+  volatile bool m_interrupt;
+  bool m_abort;
+  bool m_busy;
+  bool m_reset;
   VolumeFileManager m_pvlFileManager;
-  //VolumeFileManager m_gradFileManager;
+  uchar *m_volData;
   int m_depth, m_width, m_height;
   uchar m_lut[4*256*256];
   QBitArray m_bitmask;
+
+  // build state - only touched by the worker
+  BitVolume m_bits;
+  QBitArray m_work;
+  int m_slabDepth;
+  int m_nslabs;
+  quint64 *m_present;
+  quint64 *m_built;
+  bool *m_scanned;
+  // m_work has slabs that are not in m_bitmask yet
+  bool m_pending;
+
+  void resetSlabs();
+  void copySlab(int, int);
+
+  static void buildSlab(SlabJob&);
 };
 
 #endif
@@ -0,0 +1,662 @@
+#include "bitmorphology.h"
+
+#include <QThread>
+#include <QtConcurrentMap>
+
+//------------------------------------------------------
+// row helpers
+//------------------------------------------------------
+static inline void
+dilateRow1(quint64 *t, int n)
+{
+  quint64 prev = 0;
+  for(int i=0; i<n; i++)
+    {
+      quint64 cur = t[i];
+      quint64 next = (i+1 < n ? t[i+1] : 0);
+      t[i] = cur | (cur << 1) | (prev >> 63) | (cur >> 1) | (next << 63);
+      prev = cur;
+    }
+}
+
+static inline quint64
+reverseBits(quint64 v)
+{
+  v = ((v >> 1) & 0x5555555555555555ULL) | ((v & 0x5555555555555555ULL) << 1);
+  v = ((v >> 2) & 0x3333333333333333ULL) | ((v & 0x3333333333333333ULL) << 2);
+  v = ((v >> 4) & 0x0F0F0F0F0F0F0F0FULL) | ((v & 0x0F0F0F0F0F0F0F0FULL) << 4);
+  v = ((v >> 8) & 0x00FF00FF00FF00FFULL) | ((v & 0x00FF00FF00FF00FFULL) << 8);
+  v = ((v >> 16) & 0x0000FFFF0000FFFFULL) | ((v & 0x0000FFFF0000FFFFULL) << 16);
+  return (v >> 32) | (v << 32);
+}
+
+static inline void
+reverseRow(const quint64 *src, quint64 *dst, int n)
+{
+  for(int i=0; i<n; i++)
+    dst[n-1-i] = reverseBits(src[i]);
+}
+
+// extend every set bit of x towards higher h up to the end
+// of the run of m it lies in.  adding x to m carries through
+// the run above each seed.  x must be a subset of m.
+static inline void
+fillRowUp(const quint64 *m, quint64 *x, int n)
+{
+  quint64 carry = 0;
+  for(int i=0; i<n; i++)
+    {
+      quint64 t = m[i] + x[i];
+      quint64 c1 = (t < m[i]);
+      quint64 s = t + carry;
+      quint64 c2 = (s < t);
+      carry = c1 | c2;
+      x[i] |= (s ^ m[i]) & m[i];
+    }
+}
+
+// fill whole runs of m that contain a bit of x
+static void
+fillRow(const quint64 *m, quint64 *x, int n,
+	quint64 *rm, quint64 *rx)
+{
+  fillRowUp(m, x, n);
+  reverseRow(m, rm, n);
+  reverseRow(x, rx, n);
+  fillRowUp(rm, rx, n);
+  reverseRow(rx, x, n);
+}
+
+static QList< QPair<int, int> >
+depthRanges(int mind, int maxd)
+{
+  QList< QPair<int, int> > ranges;
+  int nd = maxd-mind+1;
+  int nblocks = qMin(nd, qMax(1, 4*QThread::idealThreadCount()));
+  for(int b=0; b<nblocks; b++)
+    ranges << qMakePair(mind + (int)((qint64)b*nd/nblocks),
+			mind + (int)((qint64)(b+1)*nd/nblocks) - 1);
+  return ranges;
+}
+
+//------------------------------------------------------
+// BitVolume
+//------------------------------------------------------
+BitVolume::BitVolume()
+{
+  m_depth = m_width = m_height = 0;
+  m_wpr = 0;
+}
+
+void
+BitVolume::resize(int d, int w, int h)
+{
+  m_depth = d;
+  m_width = w;
+  m_height = h;
+  m_wpr = (h+63)/64;
+  m_words.clear();
+  m_words.fill(0, (qint64)m_depth*m_width*m_wpr);
+}
+
+void
+BitVolume::fill(bool val)
+{
+  if (!val)
+    {
+      m_words.fill(0);
+      return;
+    }
+
+  // keep the padding bits beyond height clear
+  quint64 last = (m_height%64 == 0 ? ~0ULL : ((1ULL << (m_height%64)) - 1));
+  qint64 nrows = (qint64)m_depth*m_width;
+  quint64 *p = m_words.data();
+  for(qint64 r=0; r<nrows; r++)
+    {
+      for(int i=0; i<m_wpr-1; i++)
+	p[i] = ~0ULL;
+      p[m_wpr-1] = last;
+      p += m_wpr;
+    }
+}
+
+bool
+BitVolume::testBit(int d, int w, int h) const
+{
+  return (constRow(d, w)[h/64] >> (h%64)) & 1;
+}
+
+void
+BitVolume::setBit(int d, int w, int h, bool val)
+{
+  quint64 b = 1ULL << (h%64);
+  if (val)
+    row(d, w)[h/64] |= b;
+  else
+    row(d, w)[h/64] &= ~b;
+}
+
+qint64
+BitVolume::count() const
+{
+  qint64 n = 0;
+  const quint64 *p = m_words.constData();
+  qint64 nw = m_words.count();
+  for(qint64 i=0; i<nw; i++)
+    {
+      quint64 v = p[i];
+      while (v)
+	{
+	  v &= v-1;
+	  n++;
+	}
+    }
+  return n;
+}
+
+struct BitVolumeMaskJob
+{
+  BitVolume *vol;
+  uchar *mask;
+  int tag;
+  int d0, d1;
+};
+
+static void
+maskJob(BitVolumeMaskJob &job)
+{
+  BitVolume *vol = job.vol;
+  int width = vol->width();
+  int height = vol->height();
+  int wpr = vol->wordsPerRow();
+  for(int d=job.d0; d<=job.d1; d++)
+    for(int w=0; w<width; w++)
+      {
+	uchar *m = job.mask + ((qint64)d*width + w)*height;
+	quint64 *r = vol->row(d, w);
+	for(int i=0; i<wpr; i++)
+	  {
+	    int h0 = i*64;
+	    int h1 = qMin(height, h0+64);
+	    quint64 v = 0;
+	    for(int h=h0; h<h1; h++)
+	      if (m[h] == job.tag)
+		v |= 1ULL << (h-h0);
+	    r[i] = v;
+	  }
+      }
+}
+
+void
+BitVolume::fromMask(uchar *mask, int tag)
+{
+  if (m_depth == 0)
+    return;
+
+  m_words.data(); // detach before handing rows to threads
+
+  QList<BitVolumeMaskJob> jobs;
+  QList< QPair<int, int> > ranges = depthRanges(0, m_depth-1);
+  for(int i=0; i<ranges.count(); i++)
+    {
+      BitVolumeMaskJob job;
+      job.vol = this;
+      job.mask = mask;
+      job.tag = tag;
+      job.d0 = ranges[i].first;
+      job.d1 = ranges[i].second;
+      jobs << job;
+    }
+  QtConcurrent::blockingMap(jobs, maskJob);
+}
+
+void
+BitVolume::fromBitArray(const QBitArray &bits)
+{
+  m_words.fill(0);
+  qint64 bidx = 0;
+  for(int d=0; d<m_depth; d++)
+    for(int w=0; w<m_width; w++)
+      {
+	quint64 *r = row(d, w);
+	for(int h=0; h<m_height; h++)
+	  {
+	    if (bits.testBit(bidx))
+	      r[h/64] |= 1ULL << (h%64);
+	    bidx++;
+	  }
+      }
+}
+
+QBitArray
+BitVolume::toBitArray() const
+{
+  QBitArray bits;
+  bits.resize((qint64)m_depth*m_width*m_height);
+
+  qint64 bidx = 0;
+  for(int d=0; d<m_depth; d++)
+    for(int w=0; w<m_width; w++)
+      {
+	const quint64 *r = constRow(d, w);
+	int h = 0;
+	while (h < m_height)
+	  {
+	    // skip empty words
+	    if (h%64 == 0 && r[h/64] == 0)
+	      {
+		h += 64;
+		continue;
+	      }
+	    if (!((r[h/64] >> (h%64)) & 1))
+	      {
+		h++;
+		continue;
+	      }
+	    int h0 = h;
+	    while (h < m_height && ((r[h/64] >> (h%64)) & 1))
+	      h++;
+	    bits.fill(true, bidx+h0, bidx+h);
+	  }
+	bidx += m_height;
+      }
+
+  return bits;
+}
+
+//------------------------------------------------------
+// BitMorphology
+//------------------------------------------------------
+BitMorphology::Box
+BitMorphology::makeBox(const BitVolume &v,
+		       int mind, int maxd,
+		       int minw, int maxw,
+		       int minh, int maxh)
+{
+  Box box;
+  box.mind = qMax(mind, 0);
+  box.maxd = qMin(maxd, v.depth()-1);
+  box.minw = qMax(minw, 0);
+  box.maxw = qMin(maxw, v.width()-1);
+  box.minh = qMax(minh, 0);
+  box.maxh = qMin(maxh, v.height()-1);
+
+  box.hmask.fill(0, v.wordsPerRow());
+  for(int h=box.minh; h<=box.maxh; h++)
+    box.hmask[h/64] |= 1ULL << (h%64);
+
+  return box;
+}
+
+void
+BitMorphology::passJob(PassJob &job)
+{
+  const Box &box = *job.box;
+  const quint64 *hm = box.hmask.constData();
+  int wpr = job.src->wordsPerRow();
+  int r = job.radius;
+
+  QVector<quint64> buf(wpr);
+  quint64 *t = buf.data();
+
+  if (job.axis == 0) // along h
+    {
+      for(int d=job.d0; d<=job.d1; d++)
+	for(int w=box.minw; w<=box.maxw; w++)
+	  {
+	    const quint64 *s = job.src->constRow(d, w);
+	    for(int i=0; i<wpr; i++)
+	      t[i] = s[i] & hm[i];
+	    for(int k=0; k<r; k++)
+	      dilateRow1(t, wpr);
+	    quint64 *o = job.dst->row(d, w);
+	    for(int i=0; i<wpr; i++)
+	      o[i] = (o[i] & ~hm[i]) | (t[i] & hm[i]);
+	  }
+    }
+  else if (job.axis == 1) // along w
+    {
+      int nw = box.maxw-box.minw+1;
+      QVector<quint64> slice(nw*wpr);
+      quint64 *sl = slice.data();
+      for(int d=job.d0; d<=job.d1; d++)
+	{
+	  // copy first so that src may be the same as dst
+	  for(int w=box.minw; w<=box.maxw; w++)
+	    {
+	      const quint64 *s = job.src->constRow(d, w);
+	      quint64 *c = sl + (w-box.minw)*wpr;
+	      for(int i=0; i<wpr; i++)
+		c[i] = s[i] & hm[i];
+	    }
+	  for(int w=box.minw; w<=box.maxw; w++)
+	    {
+	      int w0 = qMax(w-r, box.minw);
+	      int w1 = qMin(w+r, box.maxw);
+	      memset(t, 0, wpr*sizeof(quint64));
+	      for(int w2=w0; w2<=w1; w2++)
+		{
+		  quint64 *c = sl + (w2-box.minw)*wpr;
+		  for(int i=0; i<wpr; i++)
+		    t[i] |= c[i];
+		}
+	      quint64 *o = job.dst->row(d, w);
+	      for(int i=0; i<wpr; i++)
+		o[i] = (o[i] & ~hm[i]) | t[i];
+	    }
+	}
+    }
+  else // along d, src and dst must differ
+    {
+      for(int d=job.d0; d<=job.d1; d++)
+	{
+	  int d0 = qMax(d-r, box.mind);
+	  int d1 = qMin(d+r, box.maxd);
+	  for(int w=box.minw; w<=box.maxw; w++)
+	    {
+	      memset(t, 0, wpr*sizeof(quint64));
+	      for(int d2=d0; d2<=d1; d2++)
+		{
+		  const quint64 *s = job.src->constRow(d2, w);
+		  for(int i=0; i<wpr; i++)
+		    t[i] |= s[i];
+		}
+	      quint64 *o = job.dst->row(d, w);
+	      for(int i=0; i<wpr; i++)
+		o[i] = (o[i] & ~hm[i]) | (t[i] & hm[i]);
+	    }
+	}
+    }
+}
+
+// dst has to hold a copy of src (or be src for axis 0 and 1)
+void
+BitMorphology::runPass(const BitVolume &src, BitVolume &dst,
+		       const Box &box, int axis, int radius)
+{
+  if (box.mind > box.maxd ||
+      box.minw > box.maxw ||
+      box.minh > box.maxh)
+    return;
+
+  dst.data(); // detach before handing rows to threads
+
+  QList<PassJob> jobs;
+  QList< QPair<int, int> > ranges = depthRanges(box.mind, box.maxd);
+  for(int i=0; i<ranges.count(); i++)
+    {
+      PassJob job;
+      job.src = &src;
+      job.dst = &dst;
+      job.box = &box;
+      job.d0 = ranges[i].first;
+      job.d1 = ranges[i].second;
+      job.axis = axis;
+      job.radius = radius;
+      jobs << job;
+    }
+  QtConcurrent::blockingMap(jobs, BitMorphology::passJob);
+}
+
+void
+BitMorphology::orInto(BitVolume &a, const BitVolume &b, const Box &box)
+{
+  int wpr = a.wordsPerRow();
+  const quint64 *hm = box.hmask.constData();
+  for(int d=box.mind; d<=box.maxd; d++)
+    for(int w=box.minw; w<=box.maxw; w++)
+      {
+	quint64 *o = a.row(d, w);
+	const quint64 *s = b.constRow(d, w);
+	for(int i=0; i<wpr; i++)
+	  o[i] |= s[i] & hm[i];
+      }
+}
+
+// one step of the 6 or 18 neighbourhood
+void
+BitMorphology::neighbourhoodStep(BitVolume &a, int nbhd, const Box &box)
+{
+  if (nbhd == 6)
+    {
+      // union of the three axis-aligned lines
+      BitVolume h = a;
+      runPass(a, h, box, 0, 1);
+      BitVolume w = a;
+      runPass(a, w, box, 1, 1);
+      BitVolume d = a;
+      runPass(a, d, box, 2, 1);
+      orInto(a, h, box);
+      orInto(a, w, box);
+      orInto(a, d, box);
+    }
+  else
+    {
+      // union of the three axis-aligned 3x3 squares
+      BitVolume x = a;
+      runPass(a, x, box, 0, 1);
+      BitVolume xy = x;
+      runPass(x, xy, box, 1, 1);
+      BitVolume xz = x;
+      runPass(x, xz, box, 2, 1);
+      x = a;
+      runPass(a, x, box, 1, 1);
+      BitVolume yz = x;
+      runPass(x, yz, box, 2, 1);
+      orInto(a, xy, box);
+      orInto(a, xz, box);
+      orInto(a, yz, box);
+    }
+}
+
+void
+BitMorphology::dilate(BitVolume &v, int radius, int nbhd)
+{
+  dilate(v, radius, nbhd,
+	 0, v.depth()-1,
+	 0, v.width()-1,
+	 0, v.height()-1);
+}
+
+void
+BitMorphology::dilate(BitVolume &v, int radius, int nbhd,
+		      int mind, int maxd,
+		      int minw, int maxw,
+		      int minh, int maxh)
+{
+  if (radius <= 0)
+    return;
+
+  Box box = makeBox(v, mind, maxd, minw, maxw, minh, maxh);
+
+  if (nbhd == 6 || nbhd == 18)
+    {
+      for(int i=0; i<radius; i++)
+	neighbourhoodStep(v, nbhd, box);
+      return;
+    }
+
+  // 26 neighbourhood - cube of side 2*radius+1
+  runPass(v, v, box, 0, radius);
+  runPass(v, v, box, 1, radius);
+  BitVolume t = v;
+  runPass(v, t, box, 2, radius);
+  v = t;
+}
+
+void
+BitMorphology::erode(BitVolume &v, int radius, int nbhd)
+{
+  erode(v, radius, nbhd,
+	0, v.depth()-1,
+	0, v.width()-1,
+	0, v.height()-1);
+}
+
+void
+BitMorphology::erode(BitVolume &v, int radius, int nbhd,
+		     int mind, int maxd,
+		     int minw, int maxw,
+		     int minh, int maxh)
+{
+  if (radius <= 0)
+    return;
+
+  Box box = makeBox(v, mind, maxd, minw, maxw, minh, maxh);
+  int wpr = v.wordsPerRow();
+  const quint64 *hm = box.hmask.constData();
+
+  // erosion is the complement of the dilated complement.
+  // voxels outside the box count as set.
+  BitVolume c;
+  c.resize(v.depth(), v.width(), v.height());
+  for(int d=box.mind; d<=box.maxd; d++)
+    for(int w=box.minw; w<=box.maxw; w++)
+      {
+	const quint64 *s = v.constRow(d, w);
+	quint64 *o = c.row(d, w);
+	for(int i=0; i<wpr; i++)
+	  o[i] = ~s[i] & hm[i];
+      }
+
+  dilate(c, radius, nbhd,
+	 mind, maxd,
+	 minw, maxw,
+	 minh, maxh);
+
+  for(int d=box.mind; d<=box.maxd; d++)
+    for(int w=box.minw; w<=box.maxw; w++)
+      {
+	const quint64 *s = c.constRow(d, w);
+	quint64 *o = v.row(d, w);
+	for(int i=0; i<wpr; i++)
+	  o[i] &= ~s[i];
+      }
+}
+
+void
+BitMorphology::reconstruct(BitVolume &x, const BitVolume &m, int nbhd)
+{
+  reconstruct(x, m, nbhd,
+	      0, x.depth()-1,
+	      0, x.width()-1,
+	      0, x.height()-1);
+}
+
+void
+BitMorphology::reconstruct(BitVolume &x, const BitVolume &m, int nbhd,
+			   int mind, int maxd,
+			   int minw, int maxw,
+			   int minh, int maxh)
+{
+  Box box = makeBox(x, mind, maxd, minw, maxw, minh, maxh);
+  if (box.mind > box.maxd ||
+      box.minw > box.maxw ||
+      box.minh > box.maxh)
+    return;
+
+  int wpr = x.wordsPerRow();
+  const quint64 *hm = box.hmask.constData();
+
+  QVector<quint64> buffers(5*wpr);
+  quint64 *mm = buffers.data();
+  quint64 *nbd = mm + wpr;
+  quint64 *nbp = nbd + wpr;
+  quint64 *rm = nbp + wpr;
+  quint64 *rx = rm + wpr;
+
+  for(int d=box.mind; d<=box.maxd; d++)
+    for(int w=box.minw; w<=box.maxw; w++)
+      {
+	quint64 *o = x.row(d, w);
+	const quint64 *s = m.constRow(d, w);
+	for(int i=0; i<wpr; i++)
+	  o[i] &= s[i] & hm[i];
+      }
+
+  // alternate forward and backward raster sweeps.  each row
+  // takes what its already visited neighbours reached and is
+  // then filled along h through the runs of the mask.
+  bool changed = true;
+  int pass = 0;
+  while (changed)
+    {
+      changed = false;
+      bool forward = (pass%2 == 0);
+      int ds = (forward ? 1 : -1);
+      int dbeg = (forward ? box.mind : box.maxd);
+      int wbeg = (forward ? box.minw : box.maxw);
+      int nd = box.maxd-box.mind+1;
+      int nw = box.maxw-box.minw+1;
+      for(int di=0; di<nd; di++)
+	for(int wi=0; wi<nw; wi++)
+	  {
+	    int d = dbeg + ds*di;
+	    int w = wbeg + ds*wi;
+	    int pw = w-ds; // previous row in this slice
+	    int pd = d-ds; // previous slice
+
+	    memset(nbd, 0, wpr*sizeof(quint64));
+	    memset(nbp, 0, wpr*sizeof(quint64));
+
+	    quint64 *acc = (nbhd == 6 ? nbp : nbd);
+	    if (pw >= box.minw && pw <= box.maxw)
+	      {
+		const quint64 *s = x.constRow(d, pw);
+		for(int i=0; i<wpr; i++)
+		  acc[i] |= s[i];
+	      }
+	    if (pd >= box.mind && pd <= box.maxd)
+	      {
+		const quint64 *s = x.constRow(pd, w);
+		for(int i=0; i<wpr; i++)
+		  acc[i] |= s[i];
+
+		if (nbhd != 6)
+		  {
+		    // 18 - only edge neighbours, 26 - corners as well
+		    quint64 *acc2 = (nbhd == 18 ? nbp : nbd);
+		    for(int w2=w-1; w2<=w+1; w2+=2)
+		      if (w2 >= box.minw && w2 <= box.maxw)
+			{
+			  const quint64 *s = x.constRow(pd, w2);
+			  for(int i=0; i<wpr; i++)
+			    acc2[i] |= s[i];
+			}
+		  }
+	      }
+	    dilateRow1(nbd, wpr);
+
+	    quint64 *o = x.row(d, w);
+	    const quint64 *s = m.constRow(d, w);
+	    bool grow = (pass == 0);
+	    for(int i=0; i<wpr; i++)
+	      {
+		mm[i] = s[i] & hm[i];
+		quint64 v = (nbd[i] | nbp[i]) & mm[i];
+		if (v & ~o[i])
+		  {
+		    o[i] |= v;
+		    grow = true;
+		  }
+	      }
+
+	    if (grow)
+	      {
+		for(int i=0; i<wpr; i++)
+		  nbp[i] = o[i];
+		fillRow(mm, o, wpr, rm, rx);
+		for(int i=0; i<wpr; i++)
+		  if (o[i] != nbp[i])
+		    changed = true;
+		if (pass > 0)
+		  changed = true;
+	      }
+	  }
+      pass++;
+      // the first sweep only propagates one way
+      if (pass == 1)
+	changed = true;
+    }
+}
@@ -0,0 +1,106 @@
+#ifndef BITMORPHOLOGY_H
+#define BITMORPHOLOGY_H
+
+#include <QBitArray>
+#include <QVector>
+
+//---------------------------------------
+// binary volume with every (d, w) row of height bits
+// packed into 64-bit words, bit h of a row is bit h%64
+// of word h/64.
+//---------------------------------------
+class BitVolume
+{
+ public :
+  BitVolume();
+
+  void resize(int, int, int);
+  void fill(bool);
+
+  int depth() const { return m_depth; }
+  int width() const { return m_width; }
+  int height() const { return m_height; }
+  int wordsPerRow() const { return m_wpr; }
+
+  quint64* data() { return m_words.data(); }
+  const quint64* constData() const { return m_words.constData(); }
+  quint64* row(int d, int w)
+  { return m_words.data() + ((qint64)d*m_width + w)*m_wpr; }
+  const quint64* constRow(int d, int w) const
+  { return m_words.constData() + ((qint64)d*m_width + w)*m_wpr; }
+
+  bool testBit(int, int, int) const;
+  void setBit(int, int, int, bool val=true);
+
+  qint64 count() const;
+
+  // voxels of a d*w*h byte volume equal to tag
+  void fromMask(uchar*, int);
+  void fromBitArray(const QBitArray&);
+  QBitArray toBitArray() const;
+
+ private :
+  int m_depth, m_width, m_height;
+  int m_wpr;
+  QVector<quint64> m_words;
+};
+
+//---------------------------------------
+// word-parallel binary morphology on BitVolume.
+// structuring elements are the 6, 18 or 26 neighbourhood
+// applied radius times; the 26 neighbourhood is done as
+// three separable passes of the given radius.
+// operations are restricted to the box mind-maxd, minw-maxw,
+// minh-maxh - voxels outside the box are neither read nor
+// written, so for erosion the box border does not erode.
+// work is split into depth ranges that run concurrently.
+//---------------------------------------
+class BitMorphology
+{
+ public :
+  static void dilate(BitVolume&, int radius, int nbhd);
+  static void dilate(BitVolume&, int radius, int nbhd,
+		     int, int,
+		     int, int,
+		     int, int);
+
+  static void erode(BitVolume&, int radius, int nbhd);
+  static void erode(BitVolume&, int radius, int nbhd,
+		    int, int,
+		    int, int,
+		    int, int);
+
+  // grow seeds within mask through nbhd-connected voxels.
+  // seeds not in mask are dropped
+  static void reconstruct(BitVolume&, const BitVolume&, int nbhd);
+  static void reconstruct(BitVolume&, const BitVolume&, int nbhd,
+			  int, int,
+			  int, int,
+			  int, int);
+
+ private :
+  struct Box
+  {
+    int mind, maxd, minw, maxw, minh, maxh;
+    QVector<quint64> hmask;
+  };
+
+  struct PassJob
+  {
+    const BitVolume *src;
+    BitVolume *dst;
+    const Box *box;
+    int d0, d1;
+    int axis, radius;
+  };
+
+  static Box makeBox(const BitVolume&,
+		     int, int, int, int, int, int);
+  static void runPass(const BitVolume&, BitVolume&,
+		      const Box&, int, int);
+  static void passJob(PassJob&);
+  static void orInto(BitVolume&, const BitVolume&, const Box&);
+  static void neighbourhoodStep(BitVolume&, int, const Box&);
+};
+
+#endif
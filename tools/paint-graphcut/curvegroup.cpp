@@ -2,6 +2,11 @@
 #include "morphcurve.h"
 #include "global.h"
 
+#include <QProgressDialog>
+#include <QFutureWatcher>
+#include <QEventLoop>
+#include <QtConcurrentMap>
+
 Curve::Curve()
 {
   tag = 0;
@@ -568,49 +573,79 @@ CurveGroup::morphCurves()
     }
 
   QList<int> keys = cg.keys();
+  QList<MorphJob> jobs;
   for (int ncg=0; ncg<keys.count()-1; ncg++)
     {
-      QMap<int, QVector<QPoint> > gmcg;
-      gmcg.insert(keys[ncg], cg[keys[ncg]].pts);
-      gmcg.insert(keys[ncg+1], cg[keys[ncg+1]].pts);
+      MorphJob job;
+      job.paths.insert(keys[ncg], cg[keys[ncg]].pts);
+      job.paths.insert(keys[ncg+1], cg[keys[ncg+1]].pts);
+      job.closed = cg[keys[ncg]].closed;
+      job.thick0 = cg[keys[ncg]].thickness;
+      job.thick1 = cg[keys[ncg+1]].thickness;
+      job.tag = cg[keys[ncg]].tag;
+      jobs << job;
+    }
 
-      bool is_closed = cg[keys[ncg]].closed;
-      int thick0 = cg[keys[ncg]].thickness;
-      int thick1 = cg[keys[ncg+1]].thickness;
-      int mtag = cg[keys[ncg]].tag;
+  // morph all pairs concurrently
+  QProgressDialog progress("Morphing curves",
+			   QString(),
+			   0, jobs.count(),
+			   0);
+  progress.setMinimumDuration(0);
+
+  QFutureWatcher<void> watcher;
+  QEventLoop loop;
+  QObject::connect(&watcher, SIGNAL(progressValueChanged(int)),
+		   &progress, SLOT(setValue(int)));
+  QObject::connect(&watcher, SIGNAL(finished()),
+		   &loop, SLOT(quit()));
+  watcher.setFuture(QtConcurrent::map(jobs, CurveGroup::morphPair));
+  loop.exec();
+
+  QStringList warnings;
+  for (int i=0; i<jobs.count(); i++)
+    {
+      m_mcg << jobs[i].morphed;
+      warnings += jobs[i].warnings;
+    }
 
-      if (is_closed)
-	alignClosedCurves(gmcg);
-      else
-	alignOpenCurves(gmcg);
+  if (warnings.count() > 0)
+    QMessageBox::information(0, "", warnings.join("\n"));
+
+  QMessageBox::information(0, "", "morphed intermediate curves");
+}
+
+void
+CurveGroup::morphPair(MorphJob &job)
+{
+  if (job.closed)
+    alignClosedCurves(job.paths);
+  else
+    alignOpenCurves(job.paths);
       
-      MorphCurve mc;
-      mc.setPaths(gmcg);
+  MorphCurve mc;
+  mc.setPaths(job.paths);
       
-      QList<Perimeter> all_perimeters = mc.getMorphedPaths(is_closed);
-      int nperi = all_perimeters.count();
-      QMap<int, Curve> morphedCurves;
-      for (int i=1; i<nperi; i++)
-	{
-	  QVector<QPoint> a;
+  QList<Perimeter> all_perimeters = mc.getMorphedPaths(job.closed);
+  job.warnings = mc.warnings();
+
+  int nperi = all_perimeters.count();
+  for (int i=1; i<nperi; i++)
+    {
+      QVector<QPoint> a;
 	  
-	  Perimeter p = all_perimeters[i];
-	  for (int j=0; j<p.length; j++)
-	    a << QPoint(p.x[j],p.y[j]);
+      Perimeter p = all_perimeters[i];
+      for (int j=0; j<p.length; j++)
+	a << QPoint(p.x[j],p.y[j]);
 	  
-	  Curve c;
-	  c.tag = mtag;
-	  c.pts = a;
-	  c.closed = is_closed;
-	  c.thickness = thick0 + (thick1-thick0)*((float)i/(float)(nperi-1));
+      Curve c;
+      c.tag = job.tag;
+      c.pts = a;
+      c.closed = job.closed;
+      c.thickness = job.thick0 + (job.thick1-job.thick0)*((float)i/(float)(nperi-1));
 
-	  morphedCurves.insert(p.z, c);
-	}
-      
-      m_mcg << morphedCurves;
+      job.morphed.insert(p.z, c);
     }
-  
-  QMessageBox::information(0, "", "morphed intermediate curves");
 }
 
 int
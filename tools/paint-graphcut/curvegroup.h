@@ -105,8 +105,20 @@ class CurveGroup
   Curve m_copyCurve;
   int m_moveCurve;
 
-  void alignClosedCurves(QMap<int, QVector<QPoint> >&);
-  void alignOpenCurves(QMap<int, QVector<QPoint> >&);
+  // a pair of consecutive selected curves to morph between
+  struct MorphJob
+  {
+    QMap<int, QVector<QPoint> > paths;
+    bool closed;
+    int thick0, thick1;
+    int tag;
+    QMap<int, Curve> morphed;
+    QStringList warnings;
+  };
+
+  static void alignClosedCurves(QMap<int, QVector<QPoint> >&);
+  static void alignOpenCurves(QMap<int, QVector<QPoint> >&);
+  static void morphPair(MorphJob&);
   void clearMorphedCurves();
   float pathLength(Curve*);
   float area(Curve*);
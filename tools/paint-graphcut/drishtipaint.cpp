@@ -1,6 +1,8 @@
 #include "drishtipaint.h"
 #include "global.h"
 #include "staticfunctions.h"
+#include "maskfilter.h"
+#include "multilabelmesher.h"
 
 #include <QDockWidget>
 #include <QFileDialog>
@@ -188,8 +190,8 @@ DrishtiPaint::DrishtiPaint(QWidget *parent) :
   connect(m_imageWidget, SIGNAL(getRawValue(int, int, int)),
 	  this, SLOT(getRawValue(int, int, int)));
 
-  connect(m_imageWidget, SIGNAL(applyMaskOperation(int, int, int)),
-	  this, SLOT(applyMaskOperation(int, int, int)));
+  connect(m_imageWidget, SIGNAL(applyMaskOperation(QList<int>, int, int)),
+	  this, SLOT(applyMaskOperation(QList<int>, int, int)));
 
   connect(m_tagColorEditor, SIGNAL(tagColorChanged()),
 	  m_imageWidget, SLOT(updateTagColors()));
@@ -263,6 +265,9 @@ DrishtiPaint::DrishtiPaint(QWidget *parent) :
 
   connect(m_imageWidget, SIGNAL(updateViewerBox(int, int, int, int, int, int)),
 	  m_viewer, SLOT(updateViewerBox(int, int, int, int, int, int)));
+
+  connect(m_volume, SIGNAL(maskChanged(int, int)),
+	  m_viewer, SLOT(maskChanged(int, int)));
   //------------------------
 
 
@@ -988,239 +993,19 @@ DrishtiPaint::keyPressEvent(QKeyEvent *event)
       return;
     }
 
+  // undo last mask edit
+  if (event->key() == Qt::Key_Z &&
+      (event->modifiers() & Qt::ControlModifier))
+    {
+      if (m_volume->undo())
+	getSlice(m_currSlice);
+      return;
+    }
+
   // pass all keypressevents on to image widget
   m_imageWidget->keyPressEvent(event);
 }
 
-// smooth dilate/erode based on threshold
-void
-DrishtiPaint::sliceSmooth(int tag, int spread,
-			  uchar *pv, uchar *p,
-			  int width, int height,
-			  int thresh)
-{ 
-  int a;
-  for(int i=0; i<height; i++)				  
-    for(int j=0; j<width; j++)			  
-      {						  
-	float pj = 0;					  
-	int jst = qMax(0, j-spread);			  
-	int jed = qMin(width-1, j+spread);			  
-	for(int j1=jst; j1<=jed; j1++)		  
-	  {						  
-	    int idx = qBound(0, j1, width-1)*height+i;  
-	    if (tag > -1)
-	      a = (pv[idx]==tag ? 255 : 0);
-	    else
-	      a = (pv[idx]>tag ? 255 : 0);
-	    pj += a;
-	  }
-	pj /= (jed-jst+1);
-	if (tag > -1)
-	  p[j*height+i] = (pj>thresh ? tag : 0);
-	else
-	  p[j*height+i] = (pj>thresh ? 255 : 0);
-      }						  
-  
-  for(int j=0; j<width; j++)				  
-    for(int i=0; i<height; i++)			  
-      {						  
-	float pi = 0;					  
-	int ist = qMax(0, i-spread);			  
-	int ied = qMin(height-1, i+spread);		  
-	for(int i1=ist; i1<=ied; i1++)		  
-	  {						  
-	    int idx = j*height+qBound(0, i1, height-1); 
-	    if (tag > -1)
-	      a = (p[idx]==tag ? 255 : 0);
-	    else
-	      a = (p[idx]>tag ? 255 : 0);
-	    pi += a;
-	  }						  
-	pi /= (ied-ist+1);
-	if (tag > -1)
-	  pv[j*height+i] = (pi>thresh ? tag : 0);
-	else
-	  pv[j*height+i] = (pi>thresh ? 255 : 0);
-      }						  
-}
-
-// smooth dilate/erode based on threshold
-void
-DrishtiPaint::smooth(int tag, int spread,
-		     uchar **pv, uchar *p,
-		     int width, int height,
-		     int thresh)
-{ 
-  int a;
-  for(int j=0; j<width; j++) 
-    for(int k=0; k<height; k++) 
-      {
-	float avg = 0; 
-	for(int i=0; i<2*spread+1; i++) 
-	  {
-	    if (tag > -1)
-	      a = (pv[i][j*height+k]==tag ? 255 : 0);
-	    else
-	      a = (pv[i][j*height+k]>tag ? 255 : 0);
-	    avg += a;
-	  }
-	avg /= (2*spread+1);
-	if (tag > -1)
-	  p[j*height + k] = (avg>thresh ? tag : 0);
-	else
-	  p[j*height + k] = (avg>thresh ? 255 : 0);
-      } 
-}
-
-void
-DrishtiPaint::sliceDilate(int tag, int spread,
-			  uchar *pv, uchar *p,
-			  int width, int height)
-{ 
-  int a;
-  for(int i=0; i<height; i++)				  
-    for(int j=0; j<width; j++)			  
-      {						  
-	int pj = 0;					  
-	int jst = qMax(0, j-spread);			  
-	int jed = qMin(width-1, j+spread);			  
-	for(int j1=jst; j1<=jed; j1++)		  
-	  {						  
-	    int idx = qBound(0, j1, width-1)*height+i;  
-	    if (tag > -1)
-	      a = (pv[idx]==tag ? 1 : 0);
-	    else
-	      a = (pv[idx]>tag ? 1 : 0);
-	    pj = qMax(a,pj);
-	  }
-	if (tag > -1)
-	  p[j*height+i] = tag*pj;
-	else
-	  p[j*height+i] = 255*pj;
-      }						  
-  
-  for(int j=0; j<width; j++)				  
-    for(int i=0; i<height; i++)			  
-      {						  
-	int pi = 0;					  
-	int ist = qMax(0, i-spread);			  
-	int ied = qMin(height-1, i+spread);		  
-	for(int i1=ist; i1<=ied; i1++)		  
-	  {						  
-	    int idx = j*height+qBound(0, i1, height-1); 
-	    if (tag > -1)
-	      a = (p[idx]==tag ? 1 : 0);
-	    else
-	      a = (p[idx]>tag ? 1 : 0);
-	    pi = qMax(a,pi);		  
-	  }						  
-	if (tag > -1)
-	  pv[j*height+i] = tag*pi;
-	else
-	  pv[j*height+i] = 255*pi;
-      }						  
-}
-
-void
-DrishtiPaint::dilate(int tag, int spread,
-		     uchar **pv, uchar *p,
-		     int width, int height)
-{ 
-  int a;
-  for(int j=0; j<width; j++) 
-    for(int k=0; k<height; k++) 
-      {
-	int avg = 0; 
-	for(int i=0; i<2*spread+1; i++) 
-	  {
-	    if (tag > -1)
-	      a = (pv[i][j*height+k]==tag ? 1 : 0);
-	    else
-	      a = (pv[i][j*height+k]>tag ? 1 : 0);
-	    avg = qMax(avg,a); 
-	  }
-	if (tag > -1)
-	  p[j*height + k] = tag*avg;
-	else
-	  p[j*height + k] = 255*avg;
-      } 
-}
-
-void
-DrishtiPaint::sliceErode(int tag, int spread,
-			 uchar *pv, uchar *p,
-			 int width, int height)
-{ 
-  int a;
-  for(int i=0; i<height; i++)				  
-    for(int j=0; j<width; j++)			  
-      {						  
-	int pj = 1;					  
-	int jst = qMax(0, j-spread);			  
-	int jed = qMin(width-1, j+spread);			  
-	for(int j1=jst; j1<=jed; j1++)		  
-	  {						  
-	    int idx = qBound(0, j1, width-1)*height+i;  
-	    if (tag > -1)
-	      a = (pv[idx]==tag ? 1 : 0);
-	    else
-	      a = (pv[idx]>tag ? 1 : 0);
-	    pj = qMin(a,pj);
-	  }
-	if (tag > -1)
-	  p[j*height+i] = tag*pj;
-	else
-	  p[j*height+i] = 255*pj;
-      }						  
-  
-  for(int j=0; j<width; j++)				  
-    for(int i=0; i<height; i++)			  
-      {						  
-	int pi = 1;					  
-	int ist = qMax(0, i-spread);			  
-	int ied = qMin(height-1, i+spread);		  
-	for(int i1=ist; i1<=ied; i1++)		  
-	  {						  
-	    int idx = j*height+qBound(0, i1, height-1); 
-	    if (tag > -1)
-	      a = (p[idx]==tag ? 1 : 0);
-	    else
-	      a = (p[idx]>tag ? 1 : 0);
-	    pi = qMin(a,pi);		  
-	  }						  
-	if (tag > -1)
-	  pv[j*height+i] = tag*pi;
-	else
-	  pv[j*height+i] = 255*pi;
-      }						  
-}
-
-void
-DrishtiPaint::erode(int tag, int spread,
-		    uchar **pv, uchar *p,
-		    int width, int height)
-{ 
-  int a;
-  for(int j=0; j<width; j++) 
-    for(int k=0; k<height; k++) 
-      {
-	int avg = 1; 
-	for(int i=0; i<2*spread+1; i++) 
-	  {
-	    if (tag > -1)
-	      a = (pv[i][j*height+k]==tag ? 1 : 0);
-	    else
-	      a = (pv[i][j*height+k]>tag ? 1 : 0);
-	    avg = qMin(avg,a); 
-	  }
-	if (tag > -1)
-	  p[j*height + k] = tag*avg;
-	else
-	  p[j*height + k] = 255*avg;
-      } 
-}
-
 void
 DrishtiPaint::savePvlHeader(QString volfile,
 			    QString pvlfile,
@@ -1355,13 +1140,19 @@ DrishtiPaint::savePvlHeader(QString volfile,
 }
 
 void
-DrishtiPaint::applyMaskOperation(int tag,
+DrishtiPaint::applyMaskOperation(QList<int> tags,
 				 int smoothType,
 				 int spread)
 {
-  int thresh = 127;
-  if (smoothType == 1) thresh = 64;
-  else if (smoothType == 2) thresh = 192;
+  // MaskFilter handles up to 8 tags in one pass
+  if (tags.count() == 0)
+    return;
+  if (tags.count() > 8)
+    {
+      QMessageBox::information(0, "Mask Operation",
+			       "Only the first 8 tags will be filtered");
+      tags = tags.mid(0, 8);
+    }
 
   int depth, width, height;
   m_volume->gridSize(depth, width, height);
@@ -1372,9 +1163,15 @@ DrishtiPaint::applyMaskOperation(int tag,
   m_imageWidget->getBox(minDSlice, maxDSlice,
 			minWSlice, maxWSlice,
 			minHSlice, maxHSlice);
-  int tdepth = maxDSlice-minDSlice+1;
-  int twidth = maxWSlice-minWSlice+1;
-  int theight = maxHSlice-minHSlice+1;
+
+  // the filter looks beyond the box, clipped to the volume
+  int margin = MaskFilter::margin(smoothType, spread);
+  int d0 = qMax(0, minDSlice-margin), d1 = qMin(depth-1, maxDSlice+margin);
+  int w0 = qMax(0, minWSlice-margin), w1 = qMin(width-1, maxWSlice+margin);
+  int h0 = qMax(0, minHSlice-margin), h1 = qMin(height-1, maxHSlice+margin);
+  int nd = d1-d0+1;
+  int nw = w1-w0+1;
+  int nh = h1-h0+1;
   
   //----------------
   QString mesg;
@@ -1382,202 +1179,86 @@ DrishtiPaint::applyMaskOperation(int tag,
   if (smoothType == 1) mesg = "Dilating";
   if (smoothType == 2) mesg = "Eroding";
   //----------------
-  QProgressDialog progress(QString("%1 tagged(%2) region").arg(mesg).arg(tag),
+  QStringList tagstr;
+  for(int i=0; i<tags.count(); i++)
+    tagstr << QString("%1").arg(tags[i]);
+  QProgressDialog progress(QString("%1 tagged(%2) region").\
+			   arg(mesg).arg(tagstr.join(",")),
 			   QString(),
 			   0, 100,
 			   0);
   progress.setMinimumDuration(0);
+  progress.setValue(10);
+  qApp->processEvents();
+
+  qint64 nvox = (qint64)nd*nw*nh;
+  uchar *result = new uchar[nvox];
+
+  uchar *maskData = m_volume->memMaskDataPtr();
+  if (maskData)
+    MaskFilter::apply(maskData + ((qint64)d0*width + w0)*height + h0,
+		      width, height,
+		      nd, nw, nh,
+		      tags, smoothType, spread,
+		      result);
+  else
+    {
+      uchar *block = new uchar[nvox];
+      for(int d=d0; d<=d1; d++)
+	{
+	  uchar *slice = m_volume->getMaskDepthSliceImage(d);
+	  for(int w=w0; w<=w1; w++)
+	    memcpy(block + ((qint64)(d-d0)*nw + (w-w0))*nh,
+		   slice + w*height + h0,
+		   nh);
+	}
+      MaskFilter::apply(block, nw, nh,
+			nd, nw, nh,
+			tags, smoothType, spread,
+			result);
+      delete [] block;
+    }
+
+  progress.setValue(50);
+  qApp->processEvents();
 
+  // write back the box, all slices form one undo step
   int nbytes = width*height;
   uchar *tagData = new uchar[nbytes];
-  uchar *raw = new uchar[nbytes];
-  uchar **val;
-  val = new uchar*[2*spread+1];
-  for (int i=0; i<2*spread+1; i++)
-    val[i] = new uchar[nbytes];
-
+  int tdepth = maxDSlice-minDSlice+1;
+  m_volume->beginMaskEdit();
   for(int d=minDSlice; d<=maxDSlice; d++)
     {
-      int slc = d-minDSlice;
-      progress.setValue((int)(100*(float)slc/(float)tdepth));
+      progress.setValue(50 + (int)(50*(float)(d-minDSlice)/(float)tdepth));
       qApp->processEvents();
 
-      uchar *slice = m_volume->getDepthSliceImage(d);
-      // we get value+grad from volume
-      // we need only value part
-      int i=0;
-      for(int w=minWSlice; w<=maxWSlice; w++)
-	for(int h=minHSlice; h<=maxHSlice; h++)
-	  {
-	    slice[i] = slice[2*(w*height+h)];
-	    i++;
-	  }
-
       memcpy(tagData, m_volume->getMaskDepthSliceImage(d), nbytes);
 
-      if (slc == 0)
-	{
-	  memcpy(val[spread], m_volume->getMaskDepthSliceImage(d), nbytes);
-
-	  if (smoothType == 0)
-	    {
-	      sliceSmooth(tag, spread,
-			  val[spread], raw,
-			  width, height,
-			  64);
-	      sliceSmooth(tag, spread,
-			  val[spread], raw,
-			  width, height,
-			  192);
-	    }
-	  else
-	    sliceSmooth(tag, spread,
-			val[spread], raw,
-			width, height,
-			thresh);
-	  
-	  for(int i=-spread; i<0; i++)
-	    {
-	      if (d+i >= 0)
-		memcpy(val[spread+i], m_volume->getMaskDepthSliceImage(d+i), nbytes);
-	      else
-		memcpy(val[spread+i], m_volume->getMaskDepthSliceImage(0), nbytes);
-	      
-	      if (smoothType == 0)
-		{
-		  sliceSmooth(tag, spread,
-			      val[spread+i], raw,
-			      width, height,
-			      64);
-		  sliceSmooth(tag, spread,
-			      val[spread+i], raw,
-			      width, height,
-			      192);
-		}
-	      else
-		sliceSmooth(tag, spread,
-			    val[spread+i], raw,
-			    width, height,
-			    thresh);
-	    }
-	  
-	  for(int i=1; i<=spread; i++)
-	    {
-	      if (d+i < depth)
-		memcpy(val[spread+i], m_volume->getMaskDepthSliceImage(d+i), nbytes);
-	      else
-		memcpy(val[spread+i], m_volume->getMaskDepthSliceImage(depth-1), nbytes);
-	      
-	      if (smoothType == 0)
-		{
-		  sliceSmooth(tag, spread,
-			      val[spread+i], raw,
-			      width, height,
-			      64);
-		  sliceSmooth(tag, spread,
-			      val[spread+i], raw,
-			      width, height,
-			      192);
-		}
-	      else
-		sliceSmooth(tag, spread,
-			    val[spread+i], raw,
-			    width, height,
-			    thresh);
-	    }
-	}
-      else if (d < depth-spread)
-	{
-	  memcpy(val[2*spread], m_volume->getMaskDepthSliceImage(d+spread), nbytes);
-	  
-	  if (smoothType == 0)
-	    {
-	      sliceSmooth(tag, spread,
-			  val[2*spread], raw,
-			  width, height,
-			  64);
-	      sliceSmooth(tag, spread,
-			  val[2*spread], raw,
-			  width, height,
-			  192);
-	    }
-	  else
-	    sliceSmooth(tag, spread,
-			val[2*spread], raw,
-			width, height,
-			thresh);
-	}		  
-      else
+      bool changed = false;
+      for(int w=minWSlice; w<=maxWSlice; w++)
 	{
-	  memcpy(val[2*spread], m_volume->getMaskDepthSliceImage(depth-1), nbytes);
-	  
-	  if (smoothType == 0)
+	  uchar *r = result + ((qint64)(d-d0)*nw + (w-w0))*nh + (minHSlice-h0);
+	  uchar *t = tagData + w*height + minHSlice;
+	  int len = maxHSlice-minHSlice+1;
+	  if (memcmp(t, r, len) != 0)
 	    {
-	      sliceSmooth(tag, spread,
-			  val[2*spread], raw,
-			  width, height,
-			  64);
-	      sliceSmooth(tag, spread,
-			  val[2*spread], raw,
-			  width, height,
-			  192);
+	      memcpy(t, r, len);
+	      changed = true;
 	    }
-	  else
-	    sliceSmooth(tag, spread,
-			val[2*spread], raw,
-			width, height,
-			thresh);
-	}		  
-      
-      if (smoothType == 0)
-	{
-	  smooth(tag, spread,
-		 val, raw,
-		 width, height,
-		 64);
-	  memcpy(val[0], raw, nbytes);
-	  smooth(tag, spread,
-		 val, raw,
-		 width, height,
-		 192);
 	}
-      else
-	smooth(tag, spread,
-	       val, raw,
-	       width, height,
-	       thresh);
-      
-      
-      // now shift the planes
-      uchar *tmp = val[0];
-      for(int i=0; i<2*spread; i++)
-	val[i] = val[i+1];
-      val[2*spread] = tmp;
-  
-      for(int w=minWSlice; w<=maxWSlice; w++)
-	for(int h=minHSlice; h<=maxHSlice; h++)
-	  {
-	    if (tagData[w*height+h] == 0 || tagData[w*height+h] == tag)
-	      tagData[w*height+h] = raw[w*height+h];
-	  }
-      m_volume->setMaskDepthSlice(d, tagData);
+      if (changed)
+	m_volume->setMaskDepthSlice(d, tagData);
     }
+  m_volume->endMaskEdit();
   
-  delete [] raw;
   delete [] tagData;
-  if (spread > 0)
-    {
-      for (int i=0; i<2*spread+1; i++)
-	delete [] val[i];
-      delete [] val;
-    }
+  delete [] result;
   
   progress.setValue(100);  
 
   getSlice(m_slider->value());
 }
 
-
 void
 DrishtiPaint::on_actionExtractTag_triggered()
 {
@@ -1920,6 +1601,16 @@ DrishtiPaint::on_actionMeshTag_triggered()
     tag << -1;  
   //----------------
 
+  //----------------
+  // several tags can go into one mesh or a mesh per tag
+  bool perTag = false;
+  if (tag[0] == -1 || tag.count() > 1)
+    perTag = (QMessageBox::question(0, "Save Mesh",
+				    "Save a separate mesh for each tag ?",
+				    QMessageBox::Yes | QMessageBox::No) ==
+	      QMessageBox::Yes);
+  //----------------
+
   //----------------
   int colorType = 1; // apply tag colors 
   dtypes.clear();
@@ -1976,9 +1667,6 @@ DrishtiPaint::on_actionMeshTag_triggered()
 			   0);
   progress.setMinimumDuration(0);
 
-  uchar *meshingData = new uchar[tdepth*twidth*theight];
-  memset(meshingData, 0, tdepth*twidth*theight);
-
   //----------------------------------
   uchar *curveMask = new uchar[tdepth*twidth*theight];
   memset(curveMask, 0, tdepth*twidth*theight);
@@ -2049,6 +1737,20 @@ DrishtiPaint::on_actionMeshTag_triggered()
 
   //----------------------------------
 
+  if (perTag)
+    {
+      saveTagMeshes(colorType, tflnm, tag,
+		    curveMask,
+		    minDSlice, minWSlice, minHSlice,
+		    maxDSlice, maxWSlice, maxHSlice);
+      delete [] curveMask;
+      QMessageBox::information(0, "Save", "-----Done-----");
+      return;
+    }
+
+  uchar *meshingData = new uchar[tdepth*twidth*theight];
+  memset(meshingData, 0, tdepth*twidth*theight);
+
   int nbytes = width*height;
   uchar *raw = new uchar[width*height];
   uchar *mask = new uchar[width*height]; 
@@ -2165,8 +1867,9 @@ DrishtiPaint::on_actionMeshTag_triggered()
   if (colorType > 0)
     saveMesh(colorType,
 	     tflnm,
-	     &mc,
-	     curveMask,
+	     mc.nverts(), mc.vertices(),
+	     mc.ntrigs(), mc.triangles(),
+	     curveMask, -1,
 	     minHSlice, minWSlice, minDSlice,
 	     theight, twidth, tdepth);
   else
@@ -2180,6 +1883,95 @@ DrishtiPaint::on_actionMeshTag_triggered()
   QMessageBox::information(0, "Save", "-----Done-----");
 }
 
+// one mesh per tag from a single pass over the mask.
+// adjacent tags share their boundary surfaces.
+// curveMask is not modified.
+void
+DrishtiPaint::saveTagMeshes(int colorType,
+			    QString flnm,
+			    QList<int> tag,
+			    const uchar *curveMask,
+			    int minDSlice, int minWSlice, int minHSlice,
+			    int maxDSlice, int maxWSlice, int maxHSlice)
+{
+  int depth, width, height;
+  m_volume->gridSize(depth, width, height);
+
+  int tdepth = maxDSlice-minDSlice+1;
+  int twidth = maxWSlice-minWSlice+1;
+  int theight = maxHSlice-minHSlice+1;
+
+  QProgressDialog progress("Extracting tag surfaces",
+			   QString(),
+			   0, 100,
+			   0);
+  progress.setMinimumDuration(0);
+
+  MultiLabelMesher mesher;
+  mesher.begin(twidth, theight);
+
+  // curves merged with the painted tags
+  qint64 tvox = (qint64)tdepth*twidth*theight;
+  uchar *tagMask = new uchar[tvox];
+  memcpy(tagMask, curveMask, tvox);
+
+  int nbytes = width*height;
+  uchar *mask = new uchar[nbytes];
+  uchar *labels = new uchar[twidth*theight];
+  for(int d=minDSlice; d<=maxDSlice; d++)
+    {
+      int slc = d-minDSlice;
+      progress.setValue((int)(100*(float)slc/(float)tdepth));
+      qApp->processEvents();
+
+      memcpy(mask, m_volume->getMaskDepthSliceImage(d), nbytes);
+
+      // curves take precedence over painted tags
+      uchar *cm = tagMask + (qint64)slc*twidth*theight;
+      for(int w=minWSlice; w<=maxWSlice; w++)
+	for(int h=minHSlice; h<=maxHSlice; h++)
+	  {
+	    int idx = (w-minWSlice)*theight + (h-minHSlice);
+	    if (cm[idx] == 0)
+	      cm[idx] = mask[w*height+h];
+
+	    uchar t = cm[idx];
+	    if (tag[0] != -1 && !tag.contains(t))
+	      t = 0;
+	    labels[idx] = t;
+	  }
+
+      mesher.addSlice(labels);
+    }
+  mesher.end();
+
+  delete [] mask;
+  delete [] labels;
+
+  progress.setValue(100);
+
+  QString base = flnm;
+  base.chop(4);
+
+  QList<int> lbl = mesher.labels();
+  for(int i=0; i<lbl.count(); i++)
+    {
+      QVector<Vertex> vertices;
+      QVector<Triangle> triangles;
+      mesher.mesh(lbl[i], vertices, triangles);
+
+      saveMesh(colorType,
+	       base + QString("_%1.ply").arg(lbl[i]),
+	       vertices.count(), vertices.data(),
+	       triangles.count(), triangles.data(),
+	       tagMask, lbl[i],
+	       minHSlice, minWSlice, minDSlice,
+	       theight, twidth, tdepth);
+    }
+
+  delete [] tagMask;
+}
+
 void
 DrishtiPaint::smoothData(uchar *gData,
 			 int nX, int nY, int nZ,
@@ -2275,8 +2067,9 @@ DrishtiPaint::smoothData(uchar *gData,
 void
 DrishtiPaint::saveMesh(int colorType,
 		       QString flnm,
-		       MarchingCubes *mc,
-		       uchar *tagdata,
+		       int nvertices, Vertex *vertices,
+		       int ntriangles, Triangle *triangles,
+		       uchar *tagdata, int meshTag,
 		       int minHSlice, int minWSlice, int minDSlice,
 		       int theight, int twidth, int tdepth)
 {
@@ -2309,13 +2102,6 @@ DrishtiPaint::saveMesh(int colorType,
       plyStrings << s;
     }
 
-  int ntriangles = mc->ntrigs();
-  Triangle *triangles = mc->triangles();
-
-  int nvertices = mc->nverts();
-  Vertex *vertices = mc->vertices();
-
-
   typedef struct PlyFace
   {
     unsigned char nverts;    /* number of Vertex indices in list */
@@ -2346,6 +2132,7 @@ DrishtiPaint::saveMesh(int colorType,
      1, Uint8, Uint8, offsetof(PlyFace,nverts)},
   };
 
+  bool bin = true;
   PlyFile    *ply;
   FILE       *fp = fopen(flnm.toLatin1().data(),
 			 bin ? "wb" : "w");
@@ -2399,19 +2186,24 @@ DrishtiPaint::saveMesh(int colorType,
       vertex.nz = vertices[ni].nz;
 
       // now get color
-      int h = vertex.x;
-      int w = vertex.y;
-      int d = vertex.z;
-      int tag = 0;
-      for(int dd=qMax(d-1, 0); dd<=qMin(tdepth-1,d+1); dd++)
-	for(int ww=qMax(w-1, 0); ww<=qMin(twidth-1,w+1); ww++)
-	  for(int hh=qMax(h-1, 0); hh<=qMin(theight-1,h+1); hh++)
-	    tag = qMax(tag, (int)tagdata[dd*twidth*theight +
-				    ww*theight + hh]);
+      int h = qBound(0, (int)vertex.x, theight-1);
+      int w = qBound(0, (int)vertex.y, twidth-1);
+      int d = qBound(0, (int)vertex.z, tdepth-1);
+      int tag = qMax(meshTag, 0);
+      if (meshTag < 0) // largest tag around the vertex
+	{
+	  for(int dd=qMax(d-1, 0); dd<=qMin(tdepth-1,d+1); dd++)
+	    for(int ww=qMax(w-1, 0); ww<=qMin(twidth-1,w+1); ww++)
+	      for(int hh=qMax(h-1, 0); hh<=qMin(theight-1,h+1); hh++)
+		tag = qMax(tag, (int)tagdata[dd*twidth*theight +
+					     ww*theight + hh]);
+	}
  
       uchar r,g,b;
 
-      if (colorType == 1) // apply tag colors
+      if (colorType == 0)
+	r = g = b = 255;
+      else if (colorType == 1) // apply tag colors
 	{
 	  r = Global::tagColors()[4*tag+0];
 	  g = Global::tagColors()[4*tag+1];
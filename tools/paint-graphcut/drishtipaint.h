@@ -97,7 +97,7 @@ class DrishtiPaint : public QMainWindow
 	     int, int,
 	     int, int);
 
-  void applyMaskOperation(int, int, int);
+  void applyMaskOperation(QList<int>, int, int);
 
  private :
   Ui::DrishtiPaint ui;
@@ -131,25 +131,22 @@ class DrishtiPaint : public QMainWindow
   void updateRecentFileAction();
   QString loadVolumeFromProject(const char*);
 
-  void sliceDilate(int, int, uchar*, uchar*, int, int);
-  void dilate(int, int, uchar**, uchar*, int, int);
-
-  void sliceErode(int, int, uchar*, uchar*, int, int);
-  void erode(int, int, uchar**, uchar*, int, int);
-
-  void sliceSmooth(int, int, uchar*, uchar*, int, int, int);
-  void smooth(int, int, uchar**, uchar*, int, int, int);
-
   void savePvlHeader(QString, QString, int, int, int, bool);
 
   void smoothData(uchar*, int, int ,int, int);
 
   void saveMesh(int,
 		QString,
-		MarchingCubes*,
-		uchar*,
+		int, Vertex*,
+		int, Triangle*,
+		uchar*, int,
 		int, int, int,
 		int, int, int);
+
+  void saveTagMeshes(int, QString, QList<int>,
+		     const uchar*,
+		     int, int, int,
+		     int, int, int);
 };
 
 #endif
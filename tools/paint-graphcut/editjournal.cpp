@@ -0,0 +1,515 @@
+#include "editjournal.h"
+
+#include <QMutexLocker>
+#include <QMap>
+
+static const char journalMagic[4] = { 'D', 'P', 'J', '2' };
+static const int journalHeaderSize = 4 + 4*4;
+
+// flush buffered runs once they reach this size
+static const int maxPendingBytes = 64*1024*1024;
+
+// edit groups kept for undo when the journal is compacted
+static const int maxUndoSteps = 32;
+
+EditJournal::EditJournal()
+{
+  m_bpv = 1;
+  m_editDepth = 0;
+  m_group = 0;
+  m_nextGroup = 0;
+  m_pendingRuns = 0;
+}
+
+EditJournal::~EditJournal()
+{
+  close(false);
+}
+
+bool EditJournal::isOpen() { return m_file.isOpen(); }
+
+bool EditJournal::canUndo()
+{
+  QMutexLocker lock(&m_mutex);
+  return (m_undoRecords.count() > 0 || m_pendingRuns > 0);
+}
+
+int
+EditJournal::undoSteps()
+{
+  QMutexLocker lock(&m_mutex);
+  int n = 0;
+  int g = -1;
+  for(int i=0; i<m_undoGroups.count(); i++)
+    if (m_undoGroups[i] != g)
+      {
+	g = m_undoGroups[i];
+	n++;
+      }
+  return n;
+}
+
+bool
+EditJournal::open(QString flnm, int d, int w, int h, int bpv)
+{
+  close(false);
+
+  QMutexLocker lock(&m_mutex);
+
+  m_bpv = bpv;
+  m_editDepth = 0;
+  m_nextGroup = 0;
+  m_pending.clear();
+  m_pendingRuns = 0;
+  m_undoRecords.clear();
+  m_undoGroups.clear();
+
+  m_file.setFileName(flnm);
+
+  bool valid = false;
+  if (m_file.exists() && m_file.open(QFile::ReadWrite))
+    {
+      char magic[4];
+      int dim[4];
+      if (m_file.read(magic, 4) == 4 &&
+	  m_file.read((char*)dim, 16) == 16)
+	valid = (memcmp(magic, journalMagic, 4) == 0 &&
+		 dim[0] == d && dim[1] == w &&
+		 dim[2] == h && dim[3] == bpv);
+      if (!valid)
+	m_file.close();
+    }
+
+  if (!valid)
+    {
+      if (!m_file.open(QFile::ReadWrite | QFile::Truncate))
+	return false;
+
+      int dim[4] = { d, w, h, bpv };
+      m_file.write(journalMagic, 4);
+      m_file.write((char*)dim, 16);
+      m_file.flush();
+      return true;
+    }
+
+  // rebuild the undo stack, drop a partly written last record
+  qint64 pos = journalHeaderSize;
+  qint64 fsize = m_file.size();
+  while (pos < fsize)
+    {
+      m_file.seek(pos);
+      char type;
+      if (m_file.read(&type, 1) != 1)
+	break;
+
+      if (type == 'E')
+	{
+	  int hdr[2];
+	  qint64 nbytes;
+	  if (m_file.read((char*)hdr, 8) != 8 ||
+	      m_file.read((char*)&nbytes, 8) != 8 ||
+	      pos + 17 + nbytes > fsize)
+	    break;
+	  m_undoRecords << pos;
+	  m_undoGroups << hdr[0];
+	  m_nextGroup = qMax(m_nextGroup, hdr[0]+1);
+	  pos += 17 + nbytes;
+	}
+      else if (type == 'U' || type == 'C')
+	{
+	  qint64 v;
+	  if (m_file.read((char*)&v, 8) != 8)
+	    break;
+	  if (type == 'U' &&
+	      m_undoRecords.count() > 0 &&
+	      m_undoRecords.last() == v)
+	    {
+	      m_undoRecords.removeLast();
+	      m_undoGroups.removeLast();
+	    }
+	  pos += 9;
+	}
+      else
+	break;
+    }
+
+  if (pos < fsize)
+    m_file.resize(pos);
+
+  return true;
+}
+
+void
+EditJournal::close(bool removeFile)
+{
+  QMutexLocker lock(&m_mutex);
+
+  if (!m_file.isOpen())
+    return;
+
+  writePending();
+  m_file.close();
+  if (removeFile)
+    m_file.remove();
+
+  m_undoRecords.clear();
+  m_undoGroups.clear();
+  m_editDepth = 0;
+}
+
+void
+EditJournal::beginEdit()
+{
+  QMutexLocker lock(&m_mutex);
+  if (m_editDepth == 0)
+    m_group = m_nextGroup++;
+  m_editDepth++;
+}
+
+void
+EditJournal::endEdit()
+{
+  QMutexLocker lock(&m_mutex);
+  m_editDepth = qMax(0, m_editDepth-1);
+  if (m_editDepth == 0)
+    writePending();
+}
+
+void
+EditJournal::addRun(qint64 offset, int length,
+		    uchar *oldValues, uchar *newValues)
+{
+  QMutexLocker lock(&m_mutex);
+
+  if (m_editDepth == 0)
+    m_group = m_nextGroup++;
+
+  int nbytes = length*m_bpv;
+  m_pending.append((char*)&offset, 8);
+  m_pending.append((char*)&length, 4);
+  m_pending.append((char*)oldValues, nbytes);
+  m_pending.append((char*)newValues, nbytes);
+  m_pendingRuns++;
+
+  if (m_editDepth == 0 ||
+      m_pending.size() > maxPendingBytes)
+    writePending();
+}
+
+// m_mutex is held by the caller
+void
+EditJournal::writePending()
+{
+  if (m_pendingRuns == 0 || !m_file.isOpen())
+    {
+      m_pending.clear();
+      m_pendingRuns = 0;
+      return;
+    }
+
+  // runs of a mask edit are mostly a few repeated tag values
+  QByteArray packed = qCompress(m_pending, 1);
+
+  qint64 pos = m_file.size();
+  qint64 nbytes = packed.size();
+  char type = 'E';
+  m_file.seek(pos);
+  m_file.write(&type, 1);
+  m_file.write((char*)&m_group, 4);
+  m_file.write((char*)&m_pendingRuns, 4);
+  m_file.write((char*)&nbytes, 8);
+  m_file.write(packed);
+  m_file.flush();
+
+  m_undoRecords << pos;
+  m_undoGroups << m_group;
+
+  m_pending.clear();
+  m_pendingRuns = 0;
+}
+
+qint64
+EditJournal::flush()
+{
+  QMutexLocker lock(&m_mutex);
+  writePending();
+  return m_file.size();
+}
+
+void
+EditJournal::checkpoint(qint64 pos)
+{
+  QMutexLocker lock(&m_mutex);
+  if (!m_file.isOpen())
+    return;
+
+  compact(pos);
+}
+
+// m_mutex is held by the caller
+// end of the record at pos, v is the position stored in U and C records
+qint64
+EditJournal::recordEnd(qint64 pos, char &type, qint64 &v)
+{
+  m_file.seek(pos);
+  if (m_file.read(&type, 1) != 1)
+    return -1;
+
+  if (type == 'E')
+    {
+      m_file.seek(pos+9);
+      if (m_file.read((char*)&v, 8) != 8)
+	return -1;
+      return pos + 17 + v;
+    }
+
+  if (m_file.read((char*)&v, 8) != 8)
+    return -1;
+  return pos + 9;
+}
+
+// m_mutex is held by the caller
+// the volume files hold everything journalled before pos.  keep the
+// last maxUndoSteps edit groups of the undo stack, every record made
+// after pos and the edits that those later undo records refer to,
+// so that recover() still replays what has not been saved.
+void
+EditJournal::compact(qint64 pos)
+{
+  qint64 fsize = m_file.size();
+
+  // undo stack entries that stay
+  int first = m_undoGroups.count();
+  int ngroups = 0;
+  int g = -1;
+  for(int i=m_undoGroups.count()-1; i>=0; i--)
+    {
+      if (m_undoGroups[i] != g)
+	{
+	  g = m_undoGroups[i];
+	  if (++ngroups > maxUndoSteps)
+	    break;
+	}
+      first = i;
+    }
+
+  QList<qint64> keep;
+  for(int i=0; i<m_undoRecords.count(); i++)
+    if (i >= first || m_undoRecords[i] >= pos)
+      keep << m_undoRecords[i];
+
+  char type;
+  qint64 v;
+  qint64 p = journalHeaderSize;
+  while (p < fsize)
+    {
+      qint64 end = recordEnd(p, type, v);
+      if (end < 0)
+	break;
+      if (p >= pos && type == 'U' && !keep.contains(v))
+	keep << v;
+      p = end;
+    }
+
+  QFile fout(m_file.fileName() + ".tmp");
+  if (!fout.open(QFile::WriteOnly | QFile::Truncate))
+    return;
+
+  m_file.seek(0);
+  fout.write(m_file.read(journalHeaderSize));
+
+  QMap<qint64, qint64> newPos;
+  qint64 start = -1;
+  p = journalHeaderSize;
+  while (p < fsize)
+    {
+      qint64 end = recordEnd(p, type, v);
+      if (end < 0)
+	break;
+
+      if (p >= pos && start < 0)
+	start = fout.pos();
+
+      if (type == 'E' && (p >= pos || keep.contains(p)))
+	{
+	  newPos[p] = fout.pos();
+	  m_file.seek(p);
+	  fout.write(m_file.read(end-p));
+	}
+      else if (type == 'U' && p >= pos)
+	{
+	  qint64 nv = newPos.value(v, -1);
+	  fout.write(&type, 1);
+	  fout.write((char*)&nv, 8);
+	}
+      p = end;
+    }
+  if (start < 0)
+    start = fout.pos();
+
+  type = 'C';
+  fout.write(&type, 1);
+  fout.write((char*)&start, 8);
+  fout.close();
+
+  QString flnm = m_file.fileName();
+  m_file.close();
+  QFile::remove(flnm);
+  QFile::rename(fout.fileName(), flnm);
+  m_file.setFileName(flnm);
+  m_file.open(QFile::ReadWrite);
+
+  QList<qint64> records = m_undoRecords;
+  QList<int> groups = m_undoGroups;
+  m_undoRecords.clear();
+  m_undoGroups.clear();
+  for(int i=0; i<records.count(); i++)
+    if (newPos.contains(records[i]))
+      {
+	m_undoRecords << newPos[records[i]];
+	m_undoGroups << groups[i];
+      }
+}
+
+// m_mutex is held by the caller
+bool
+EditJournal::readRecord(qint64 pos, QList<Run>& runs,
+			bool newValues, int& group)
+{
+  m_file.seek(pos);
+  char type;
+  int nruns;
+  qint64 nbytes;
+  if (m_file.read(&type, 1) != 1 || type != 'E' ||
+      m_file.read((char*)&group, 4) != 4 ||
+      m_file.read((char*)&nruns, 4) != 4 ||
+      m_file.read((char*)&nbytes, 8) != 8)
+    return false;
+
+  QByteArray packed = m_file.read(nbytes);
+  if (packed.size() != nbytes)
+    return false;
+
+  QByteArray payload = qUncompress(packed);
+  if (payload.isEmpty())
+    return false;
+
+  const char *p = payload.constData();
+  for(int i=0; i<nruns; i++)
+    {
+      Run run;
+      memcpy(&run.offset, p, 8);
+      memcpy(&run.length, p+8, 4);
+      p += 12;
+      int rb = run.length*m_bpv;
+      run.data = QByteArray(newValues ? p+rb : p, rb);
+      p += 2*rb;
+      runs << run;
+    }
+
+  return true;
+}
+
+QList<EditJournal::Run>
+EditJournal::undo()
+{
+  QMutexLocker lock(&m_mutex);
+
+  QList<Run> runs;
+  writePending();
+  if (m_undoRecords.count() == 0)
+    return runs;
+
+  int g = m_undoGroups.last();
+  while (m_undoGroups.count() > 0 &&
+	 m_undoGroups.last() == g)
+    {
+      qint64 pos = m_undoRecords.takeLast();
+      m_undoGroups.removeLast();
+
+      // later records first so that overlapping runs
+      // end up with their oldest value
+      QList<Run> rr;
+      int rg;
+      readRecord(pos, rr, false, rg);
+      for(int i=rr.count()-1; i>=0; i--)
+	runs << rr[i];
+
+      char type = 'U';
+      m_file.seek(m_file.size());
+      m_file.write(&type, 1);
+      m_file.write((char*)&pos, 8);
+    }
+  m_file.flush();
+
+  return runs;
+}
+
+QList<EditJournal::Run>
+EditJournal::recover()
+{
+  QMutexLocker lock(&m_mutex);
+
+  QList<Run> runs;
+  if (!m_file.isOpen())
+    return runs;
+
+  // volume file has everything before the last checkpoint
+  qint64 fsize = m_file.size();
+  qint64 start = journalHeaderSize;
+  qint64 pos = journalHeaderSize;
+  while (pos < fsize)
+    {
+      m_file.seek(pos);
+      char type;
+      m_file.read(&type, 1);
+      if (type == 'E')
+	{
+	  qint64 nbytes;
+	  m_file.seek(pos+9);
+	  m_file.read((char*)&nbytes, 8);
+	  pos += 17 + nbytes;
+	}
+      else
+	{
+	  qint64 v;
+	  m_file.read((char*)&v, 8);
+	  if (type == 'C')
+	    start = qMax(start, v);
+	  pos += 9;
+	}
+    }
+
+  // replay edits and undos made after that
+  pos = start;
+  while (pos < fsize)
+    {
+      m_file.seek(pos);
+      char type;
+      m_file.read(&type, 1);
+      if (type == 'E')
+	{
+	  qint64 nbytes;
+	  m_file.seek(pos+9);
+	  m_file.read((char*)&nbytes, 8);
+	  int g;
+	  readRecord(pos, runs, true, g);
+	  pos += 17 + nbytes;
+	}
+      else
+	{
+	  qint64 v;
+	  m_file.read((char*)&v, 8);
+	  if (type == 'U')
+	    {
+	      QList<Run> rr;
+	      int g;
+	      readRecord(v, rr, false, g);
+	      runs += rr;
+	    }
+	  pos += 9;
+	}
+    }
+
+  return runs;
+}
@@ -0,0 +1,75 @@
+#ifndef EDITJOURNAL_H
+#define EDITJOURNAL_H
+
+#include <QFile>
+#include <QMutex>
+#include <QByteArray>
+#include <QList>
+
+//---------------------------------------
+// append-only journal of voxel edits for an in-memory volume.
+//   E records hold old and new values of changed voxel runs,
+//     compressed with qCompress,
+//   U records mark an E record as undone,
+//   C records say that the volume file holds every change
+//     journalled before a given journal position.
+// records of one edit group are undone together.
+// a checkpoint rewrites the journal with only the last few
+// undo steps and the records made after the saved position.
+//---------------------------------------
+class EditJournal
+{
+ public :
+  struct Run
+  {
+    qint64 offset; // voxel offset in the volume
+    int length;    // voxels
+    QByteArray data;
+  };
+
+  EditJournal();
+  ~EditJournal();
+
+  // opens an existing journal or starts a new one.
+  // journal for different dimensions is discarded
+  bool open(QString, int, int, int, int);
+  void close(bool);
+  bool isOpen();
+
+  void beginEdit();
+  void endEdit();
+
+  void addRun(qint64, int, uchar*, uchar*);
+
+  // write buffered runs and return journal position
+  qint64 flush();
+  void checkpoint(qint64);
+
+  bool canUndo();
+  int undoSteps();
+  // runs, with old values, of the last edit group
+  QList<Run> undo();
+
+  // changes made after the last checkpoint
+  QList<Run> recover();
+
+ private :
+  QFile m_file;
+  QMutex m_mutex;
+  int m_bpv;
+  int m_editDepth;
+  int m_group, m_nextGroup;
+
+  QByteArray m_pending;
+  int m_pendingRuns;
+
+  QList<qint64> m_undoRecords;
+  QList<int> m_undoGroups;
+
+  void writePending();
+  bool readRecord(qint64, QList<Run>&, bool, int&);
+  qint64 recordEnd(qint64, char&, qint64&);
+  void compact(qint64);
+};
+
+#endif
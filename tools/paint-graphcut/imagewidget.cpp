@@ -1191,6 +1191,44 @@ ImageWidget::drawRawValue(QPainter *p)
   p->drawLine(xe, yp, xp, yp);  
 }
 
+// tags for the 3D mask operations - the current tag,
+// or a list of tags filtered together when asked for
+QList<int>
+ImageWidget::maskOperationTags(bool ask)
+{
+  QList<int> tags;
+  if (!ask)
+    {
+      tags << Global::tag();
+      return tags;
+    }
+
+  bool ok;
+  QString tagstr = QInputDialog::getText(0, "Tags",
+	    "Tag Numbers (-1 for all tags; for e.g. 1,2,5 will filter tags 1, 2 and 5)",
+					 QLineEdit::Normal,
+					 QString("%1").arg(Global::tag()),
+					 &ok);
+  if (!ok)
+    return tags;
+
+  QStringList tglist = tagstr.split(",", QString::SkipEmptyParts);
+  for(int i=0; i<tglist.count(); i++)
+    {
+      int t = tglist[i].toInt();
+      if (t == -1)
+	{
+	  tags.clear();
+	  tags << -1;
+	  break;
+	}
+      else if (t >= 0 && t <= 255 && !tags.contains(t))
+	tags << t;
+    }
+
+  return tags;
+}
+
 void
 ImageWidget::applyRecursive(int key)
 {
@@ -1795,7 +1833,7 @@ ImageWidget::keyPressEvent(QKeyEvent *event)
     {
       if (ctrlModifier)
 	{
-	  emit applyMaskOperation(Global::tag(),
+	  emit applyMaskOperation(maskOperationTags(shiftModifier),
 				  1, // smoothType dilate
 				  Global::smooth());
 	}
@@ -1811,7 +1849,7 @@ ImageWidget::keyPressEvent(QKeyEvent *event)
     {
       if (ctrlModifier)
 	{
-	  emit applyMaskOperation(Global::tag(),
+	  emit applyMaskOperation(maskOperationTags(shiftModifier),
 				  2, // smoothType erode
 				  Global::smooth());
 	}
@@ -1827,7 +1865,7 @@ ImageWidget::keyPressEvent(QKeyEvent *event)
     {
       if (ctrlModifier)
 	{
-	  emit applyMaskOperation(Global::tag(),
+	  emit applyMaskOperation(maskOperationTags(shiftModifier),
 				  0, // smoothType smooth
 				  Global::smooth());
 	}
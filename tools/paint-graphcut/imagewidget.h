@@ -121,7 +121,7 @@ class ImageWidget : public QWidget
 
   void applySmooth(int, bool);
   void simulateKeyPressEvent(QKeyEvent*);
-  void applyMaskOperation(int, int, int);
+  void applyMaskOperation(QList<int>, int, int);
   void polygonLevels(QList<int>);
   void updateViewerBox(int, int, int, int, int, int);
 
@@ -240,6 +240,7 @@ class ImageWidget : public QWidget
 
   void applyRecursive(int);
   void checkRecursive();
+  QList<int> maskOperationTags(bool);
   
   void paintUsingCurves(CurveGroup*, int, int, int, uchar*, QList<int>);
   void paintUsingCurves(uchar*);
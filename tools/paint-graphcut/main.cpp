@@ -1,9 +1,18 @@
 #include "drishtipaint.h"
+#include "benchmark.h"
 
 int main(int argv, char **args)
 {
     QApplication app(argv, args);
 
+    // drishtipaint --benchmark [size ...]
+    // times file access, meshing and segmentation on synthetic
+    // volumes without opening the main window
+    QStringList arguments = app.arguments();
+    int bidx = arguments.indexOf("--benchmark");
+    if (bidx > 0)
+	return Benchmark::run(arguments.mid(bidx+1));
+
     DrishtiPaint mainWindow;
     mainWindow.show();
 
@@ -39,6 +39,7 @@ MarchingCubes::MarchingCubes( const int size_x /*= -1*/, const int size_y /*= -1
 //-----------------------------------------------------------------------------
   _originalMC(false),
   _ext_data  (false),
+  _progress  (true),
   _size_x    (size_x),
   _size_y    (size_y),
   _size_z    (size_z),
@@ -101,13 +102,20 @@ void MarchingCubes::run( real iso )
 
   compute_intersection_points( iso ) ;
 
-  QProgressDialog progress("Mesh Generation : Generating triangles", QString(), 0, 100);
-  progress.setMinimumDuration(0);
+  QProgressDialog *progress = 0;
+  if (_progress)
+    {
+      progress = new QProgressDialog("Mesh Generation : Generating triangles", QString(), 0, 100);
+      progress->setMinimumDuration(0);
+    }
 
   for( _k = 0 ; _k < _size_z-1 ; _k++ )
     {
-      progress.setValue((int)(100.0*(float)_k/(float)(_size_z-1)));
-      qApp->processEvents();
+      if (progress)
+	{
+	  progress->setValue((int)(100.0*(float)_k/(float)(_size_z-1)));
+	  qApp->processEvents();
+	}
 
       for( _j = 0 ; _j < _size_y-1 ; _j++ )
 	for( _i = 0 ; _i < _size_x-1 ; _i++ )
@@ -143,7 +151,11 @@ void MarchingCubes::run( real iso )
 //    }
 //  //-----------------------
   
-  progress.setValue(100);
+  if (progress)
+    {
+      progress->setValue(100);
+      delete progress;
+    }
 }
 //_____________________________________________________________________________
 
@@ -239,13 +251,20 @@ void MarchingCubes::clean_all()
 void MarchingCubes::compute_intersection_points( real iso )
 //-----------------------------------------------------------------------------
 {
-  QProgressDialog progress("Mesh Generation : Compute intersection points", QString(), 0, 100);
-  progress.setMinimumDuration(0);
+  QProgressDialog *progress = 0;
+  if (_progress)
+    {
+      progress = new QProgressDialog("Mesh Generation : Compute intersection points", QString(), 0, 100);
+      progress->setMinimumDuration(0);
+    }
 
   for( _k = 0 ; _k < _size_z ; _k++ )
     {
-      progress.setValue((int)(100.0*(float)_k/(float)(_size_z-1)));
-      qApp->processEvents();
+      if (progress)
+	{
+	  progress->setValue((int)(100.0*(float)_k/(float)(_size_z-1)));
+	  qApp->processEvents();
+	}
 
       for( _j = 0 ; _j < _size_y ; _j++ )
 	for( _i = 0 ; _i < _size_x ; _i++ )
@@ -279,7 +298,11 @@ void MarchingCubes::compute_intersection_points( real iso )
 	      }
 	  }
     }
-  progress.setValue(100);
+  if (progress)
+    {
+      progress->setValue(100);
+      delete progress;
+    }
 }
 //_____________________________________________________________________________
 
@@ -129,6 +129,11 @@ public :
    * \param originalMC true for the original Marching Cubes
    */
   inline void set_method    ( const bool originalMC = false ) { _originalMC = originalMC ; }
+  /**
+   * selects wether progress dialogs are shown while the mesh is generated
+   * \param progress false to run without any dialogs (batch and benchmark runs)
+   */
+  inline void set_progress  ( const bool progress = true ) { _progress = progress ; }
   /**
    * selects to use data from another class
    * \param data is the pointer to the external data, allocated as a size_x*size_y*size_z vector running in x first
@@ -317,6 +322,7 @@ protected :
 protected :
   bool      _originalMC ;   /**< selects wether the algorithm will use the enhanced topologically controlled lookup table or the original MarchingCubes */
   bool      _ext_data   ;   /**< selects wether to allocate data or use data from another class */
+  bool      _progress   ;   /**< selects wether progress dialogs are shown */
 
   int       _size_x     ;  /**< width  of the grid */
   int       _size_y     ;  /**< depth  of the grid */
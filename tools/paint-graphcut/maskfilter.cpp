@@ -0,0 +1,233 @@
+#include "maskfilter.h"
+
+#include <QThread>
+#include <QtConcurrentMap>
+
+int
+MaskFilter::margin(int op, int spread)
+{
+  // smooth filters every axis twice
+  if (op == Smooth)
+    return 2*spread;
+  return spread;
+}
+
+// thresholded box filter of one line of tag flags
+void
+MaskFilter::filterLine(uchar *in, uchar *out, int len, qint64 stride,
+		       int spread, int thresh, int ntags)
+{
+  int cnt[8];
+  for(int k=0; k<ntags; k++)
+    cnt[k] = 0;
+
+  int e = qMin(spread, len-1);
+  for(int i=0; i<=e; i++)
+    {
+      uchar f = in[i*stride];
+      for(int k=0; k<ntags; k++)
+	cnt[k] += (f >> k) & 1;
+    }
+
+  for(int x=0; x<len; x++)
+    {
+      int n = qMin(x+spread, len-1) - qMax(x-spread, 0) + 1;
+      uchar f = 0;
+      for(int k=0; k<ntags; k++)
+	if (cnt[k]*255 > thresh*n)
+	  f |= (1 << k);
+      out[x*stride] = f;
+
+      // slide the window
+      if (x+spread+1 < len)
+	{
+	  uchar a = in[(x+spread+1)*stride];
+	  for(int k=0; k<ntags; k++)
+	    cnt[k] += (a >> k) & 1;
+	}
+      if (x-spread >= 0)
+	{
+	  uchar r = in[(x-spread)*stride];
+	  for(int k=0; k<ntags; k++)
+	    cnt[k] -= (r >> k) & 1;
+	}
+    }
+}
+
+void
+MaskFilter::passJob(PassJob &job)
+{
+  qint64 nw = job.nw;
+  qint64 nh = job.nh;
+  qint64 slc = nw*nh;
+
+  if (job.axis == 2) // along d, for w in l0-l1
+    {
+      for(int w=job.l0; w<=job.l1; w++)
+	for(int h=0; h<nh; h++)
+	  filterLine(job.src + w*nh + h,
+		     job.dst + w*nh + h,
+		     job.nd, slc,
+		     job.spread, job.thresh, job.ntags);
+      return;
+    }
+
+  for(int d=job.l0; d<=job.l1; d++)
+    {
+      if (job.axis == 0) // along w
+	{
+	  for(int h=0; h<nh; h++)
+	    filterLine(job.src + d*slc + h,
+		       job.dst + d*slc + h,
+		       job.nw, nh,
+		       job.spread, job.thresh, job.ntags);
+	}
+      else // along h
+	{
+	  for(int w=0; w<nw; w++)
+	    filterLine(job.src + d*slc + w*nh,
+		       job.dst + d*slc + w*nh,
+		       job.nh, 1,
+		       job.spread, job.thresh, job.ntags);
+	}
+    }
+}
+
+void
+MaskFilter::apply(uchar *src, int srcWidth, int srcHeight,
+		  int nd, int nw, int nh,
+		  QList<int> tags, int op, int spread,
+		  uchar *dst)
+{
+  qint64 nvox = (qint64)nd*nw*nh;
+
+  int tagIndex[256];
+  for(int i=0; i<256; i++)
+    tagIndex[i] = -1;
+  QList<int> tlist;
+  bool allTags = tags.contains(-1);
+  if (allTags)
+    {
+      // all tagged voxels form one region,
+      // voxels added to it are tagged 255
+      for(int i=1; i<256; i++)
+	tagIndex[i] = 0;
+      tlist << 255;
+    }
+  else
+    {
+      for(int i=0; i<tags.count() && tlist.count()<8; i++)
+	if (tags[i] >= 0 && tags[i] <= 255 && tagIndex[tags[i]] < 0)
+	  {
+	    tagIndex[tags[i]] = tlist.count();
+	    tlist << tags[i];
+	  }
+    }
+  int ntags = tlist.count();
+
+  // bit k of a flag is set when the voxel carries tlist[k]
+  uchar *flags = new uchar[nvox];
+  uchar *tmp = new uchar[nvox];
+  for(int d=0; d<nd; d++)
+    for(int w=0; w<nw; w++)
+      {
+	uchar *s = src + ((qint64)d*srcWidth + w)*srcHeight;
+	uchar *f = flags + ((qint64)d*nw + w)*nh;
+	for(int h=0; h<nh; h++)
+	  {
+	    int k = tagIndex[s[h]];
+	    f[h] = (k >= 0 ? (1 << k) : 0);
+	  }
+      }
+
+  QList<int> thresholds;
+  if (op == Dilate) thresholds << 64;
+  else if (op == Erode) thresholds << 192;
+  else thresholds << 64 << 192;
+
+  // same order as the per slice filters this replaces - every
+  // threshold within the slices first, then across the slices
+  QList<int> passAxis, passThresh;
+  for(int t=0; t<thresholds.count(); t++)
+    {
+      passAxis << 0 << 1;
+      passThresh << thresholds[t] << thresholds[t];
+    }
+  for(int t=0; t<thresholds.count(); t++)
+    {
+      passAxis << 2;
+      passThresh << thresholds[t];
+    }
+
+  for(int p=0; p<passAxis.count() && ntags>0; p++)
+    {
+      int axis = passAxis[p];
+
+      // split depth, or width for passes along depth,
+      // into blocks that run concurrently
+      int nl = (axis == 2 ? nw : nd);
+      int step = qMax(1, nl/(4*QThread::idealThreadCount()));
+
+      QList<PassJob> jobs;
+      for(int l=0; l<nl; l+=step)
+	{
+	  PassJob job;
+	  job.src = flags;
+	  job.dst = tmp;
+	  job.nd = nd;
+	  job.nw = nw;
+	  job.nh = nh;
+	  job.axis = axis;
+	  job.spread = spread;
+	  job.thresh = passThresh[p];
+	  job.ntags = ntags;
+	  job.l0 = l;
+	  job.l1 = qMin(nl-1, l+step-1);
+	  jobs << job;
+	}
+      QtConcurrent::blockingMap(jobs, MaskFilter::passJob);
+
+      uchar *swp = flags;
+      flags = tmp;
+      tmp = swp;
+    }
+
+  //--------
+  // voxels with a filtered tag, or no tag, take the tag that
+  // survived the filter - their own if it did.
+  // for all tags only untagged voxels are written, as the per
+  // slice filters did - tagged voxels are never cleared
+  for(int d=0; d<nd; d++)
+    for(int w=0; w<nw; w++)
+      {
+	uchar *s = src + ((qint64)d*srcWidth + w)*srcHeight;
+	qint64 idx = ((qint64)d*nw + w)*nh;
+	uchar *f = flags + idx;
+	uchar *o = dst + idx;
+	for(int h=0; h<nh; h++)
+	  {
+	    uchar v = s[h];
+	    int k = tagIndex[v];
+	    if (allTags)
+	      o[h] = (v > 0 ? v : ((f[h] & 1) ? 255 : 0));
+	    else if (v > 0 && k < 0)
+	      o[h] = v;
+	    else if (k >= 0 && ((f[h] >> k) & 1))
+	      o[h] = v;
+	    else
+	      {
+		o[h] = 0;
+		for(k=0; k<ntags; k++)
+		  if ((f[h] >> k) & 1)
+		    {
+		      o[h] = tlist[k];
+		      break;
+		    }
+	      }
+	  }
+      }
+  //--------
+
+  delete [] flags;
+  delete [] tmp;
+}
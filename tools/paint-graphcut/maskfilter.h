@@ -0,0 +1,58 @@
+#ifndef MASKFILTER_H
+#define MASKFILTER_H
+
+#include <QList>
+
+//---------------------------------------
+// smooth, dilate and erode tagged regions of a mask block.
+// each operation is a sequence of thresholded box filters of
+// width 2*spread+1 (dilate : threshold 64, erode : 192, smooth :
+// 64 followed by 192), applied along w and h for every threshold
+// and then along d for every threshold.
+// box sums are running sums, so the cost per voxel does not
+// depend on spread; windows are clipped at the block border.
+// up to 8 tags are filtered together in one pass, tag -1 filters
+// all non-zero voxels as one region and only tags untagged voxels
+// (255) that end up in it.
+//---------------------------------------
+class MaskFilter
+{
+ public :
+  enum Operation
+    {
+      Smooth = 0,
+      Dilate,
+      Erode
+    };
+
+  // voxels the operation looks at beyond a box on each side
+  static int margin(int, int);
+
+  // voxel (d,w,h) of the nd*nw*nh block is
+  // src[(d*srcWidth + w)*srcHeight + h].
+  // dst receives the block with filtered tags; voxels carrying
+  // other non-zero tags keep their value.
+  static void apply(uchar *src, int srcWidth, int srcHeight,
+		    int nd, int nw, int nh,
+		    QList<int> tags, int op, int spread,
+		    uchar *dst);
+
+ private :
+  struct PassJob
+  {
+    uchar *src;
+    uchar *dst;
+    int nd, nw, nh;
+    int axis;
+    int spread;
+    int thresh;
+    int ntags;
+    int l0, l1; // depth range, or width range for the depth axis
+  };
+
+  static void filterLine(uchar*, uchar*, int, qint64,
+			 int, int, int);
+  static void passJob(PassJob&);
+};
+
+#endif
@@ -5,7 +5,7 @@
 #include <QMessageBox>
 #include <QFile>
 #include <QTextStream>
-#include <QProgressDialog>
+#include <QThreadStorage>
 
 #define PI 3.1415926535897931
 #define DLARGE 100000000.0
@@ -102,121 +102,69 @@ Perimeter::operator=(const Perimeter& p)
 
 
 //--------------------------------------------------
-MinDist::MinDist()
+EditMatrix::EditMatrix()
 {
-  min_j = 0;
-  min_dist = 0;
-  matrix = 0;
-  matrix_e = 0;
-  ndim = 0;
-  mdim = 0;
+  m_n = m_m = 0;
+  m_band = m_width = 0;
+  m_data = 0;
 }
-MinDist::~MinDist()
-{
-  min_j = 0;
-  min_dist = 0;
-
-  if (ndim > 0)
-    {
-      for (int i=0; i<ndim; i++)
-	delete [] matrix[i];
-      for (int i=0; i<ndim; i++)
-	delete [] matrix_e[i];
-
-      delete [] matrix;
-      delete [] matrix_e;
-    }
 
-  matrix = 0;
-  matrix_e = 0;
-  ndim = 0;
-  mdim = 0;
-}
-MinDist::MinDist(const MinDist& m)
+qint64
+EditMatrix::size(int n, int m, int band)
 {
-  min_j = m.min_j;
-  min_dist = m.min_dist;
-
-  ndim = m.ndim;
-  mdim = m.mdim;
-
-  matrix = new double*[ndim];
-  for(int i=0; i<ndim; i++)
-    {
-      matrix[i] = new double[mdim];
-      memcpy(matrix[i], m.matrix[i], mdim*sizeof(double));
-    }
-
-  matrix_e = new double*[ndim];
-  for(int i=0; i<ndim; i++)
-    {
-      matrix_e[i] = new double[mdim];
-      memcpy(matrix_e[i], m.matrix_e[i], mdim*sizeof(double));
-    }
+  int width = qMin(2*band+1, m+1);
+  return (qint64)(n+1)*width;
 }
-MinDist&
-MinDist::operator=(const MinDist& m)
-{
-  min_j = m.min_j;
-  min_dist = m.min_dist;
-
-  if (ndim > 0)
-    {
-      for (int i=0; i<ndim; i++) delete [] matrix[i];
-      for (int i=0; i<ndim; i++) delete [] matrix_e[i];
-
-      delete [] matrix;
-      delete [] matrix_e;
-    }
 
-  ndim = m.ndim;
-  mdim = m.mdim;
+void
+EditMatrix::setup(int n, int m, int band, double *data)
+{
+  m_n = qMax(1, n);
+  m_m = m;
+  m_band = band;
+  m_width = qMin(2*band+1, m+1);
+  m_data = data;
+}
 
-  matrix = new double*[ndim];
-  for(int i=0; i<ndim; i++)
-    {
-      matrix[i] = new double[mdim];
-      memcpy(matrix[i], m.matrix[i], mdim*sizeof(double));
-    }
+double
+EditMatrix::value(int i, int j)
+{
+  if (j < lo(i) || j > hi(i))
+    return DLARGE;
+  return row(i)[j];
+}
+//--------------------------------------------------
 
-  matrix_e = new double*[ndim];
-  for(int i=0; i<ndim; i++)
-    {
-      matrix_e[i] = new double[mdim];
-      memcpy(matrix_e[i], m.matrix_e[i], mdim*sizeof(double));
-    }
 
-  return *this;
-}
-void
-MinDist::set(double** mat, double** mate, int n, int m)
+//--------------------------------------------------
+// per thread scratch buffers for edit matrices,
+// reused across perimeter pairs
+class MorphArena
 {
-  if (ndim > 0)
-    {
-      for (int i=0; i<ndim; i++) delete [] matrix[i];
-      for (int i=0; i<ndim; i++) delete [] matrix_e[i];
-
-      delete [] matrix;
-      delete [] matrix_e;
-    }
+ public :
+  double* buffer(int k, qint64 n)
+  {
+    if (m_buffer[k].count() < n)
+      m_buffer[k].resize(n);
+    return m_buffer[k].data();
+  }
 
-  ndim = n;
-  mdim = m;  
+ private :
+  QVector<double> m_buffer[2];
+};
 
-  matrix = new double*[ndim];
-  for(int i=0; i<ndim; i++)
-    {
-      matrix[i] = new double[mdim];
-      memcpy(matrix[i], mat[i], mdim*sizeof(double));
-    }
+static QThreadStorage<MorphArena*> morphArenas;
 
-  matrix_e = new double*[ndim];
-  for(int i=0; i<ndim; i++)
-    {
-      matrix_e[i] = new double[mdim];
-      memcpy(matrix_e[i], mate[i], mdim*sizeof(double));
-    }
+static MorphArena*
+morphArena()
+{
+  if (!morphArenas.hasLocalData())
+    morphArenas.setLocalData(new MorphArena());
+  return morphArenas.localData();
 }
+
+// alignments with more cells than this are restricted to a band
+static const qint64 maxFullMatrixCells = 4*1024*1024;
 //--------------------------------------------------
 
 
@@ -267,8 +215,13 @@ MorphCurve::getMorphedPaths(bool is_closed_curve)
   int n_interpolates = -1; //from 0 to infinite
   
   double user_delta = 0.0; // 0 means "use average point interdistance as delta"
+  m_warnings.clear();
+  if (m_result) delete m_result;
   m_result = getAllPerimeters(m_perimeters, m_perimeters.count(),
 			       n_interpolates, user_delta, is_closed_curve);
+  if (!m_result)
+    return QList<Perimeter>();
+
   return m_result->p;  
 }
 
@@ -513,10 +466,10 @@ MorphCurve::subsample(Perimeter p, double delta_orig, bool is_closed_curve)
  * 0 is the starting point for p1
  * 'first' is the starting point for p2
  */
-double**
-MorphCurve::findEditMatrix(Perimeter p1, Perimeter p2,
+void
+MorphCurve::findEditMatrix(const Perimeter& p1, const Perimeter& p2,
 			   int first, double delta,
-			   double** matrix)
+			   EditMatrix& matrix)
 {
   // iterators
   int i;
@@ -526,6 +479,10 @@ MorphCurve::findEditMatrix(Perimeter p1, Perimeter p2,
   // catch array pointers, for readability (and speed, I believe, saving dereferences)
   int n = p1.length;
   int m = p2.length;
+  const double *v1x = p1.v_x.constData();
+  const double *v1y = p1.v_y.constData();
+  const double *v2x = p2.v_x.constData();
+  const double *v2y = p2.v_y.constData();
 
   // the reason why we came here down to C: speed up this loop
   double fun1;
@@ -533,47 +490,66 @@ MorphCurve::findEditMatrix(Perimeter p1, Perimeter p2,
   double fun3;
   double vs_x, vs_y;
 
+  // first row is j * delta
+  double* mat0 = matrix.row(0);
+  for (jj=matrix.lo(0); jj<=matrix.hi(0); jj++)
+    mat0[jj] = jj * delta;
+
   double* mati;
   double* mat1;
   for (i=1; i< n + 1; i++)
     {
-      mati = matrix[i];
-      mat1 = matrix[i-1];
-      for (jj=1; jj< m + 1; jj++)
+      mati = matrix.row(i);
+      mat1 = matrix.row(i-1);
+      int lo = matrix.lo(i);
+      int hi = matrix.hi(i);
+      int plo = matrix.lo(i-1);
+      int phi = matrix.hi(i-1);
+
+      ii = i;
+      if (ii == n) ii--; // PATCH ! For valgrind's complain. Of course one can't read a vector one element after the end of the string!
+
+      // first column is i * delta
+      int jst = lo;
+      if (lo == 0)
+	{
+	  mati[0] = i * delta;
+	  jst = 1;
+	}
+
+      for (jj=jst; jj<=hi; jj++)
 	{
 	  // offset j to first:
 	  j = first + jj -1; //-1 so it starts at 'first'
 	  if (j >= m)
 	    j = j - m;
 	  
-	  ii = i;
-	  if (ii == n) ii--; // PATCH ! For valgrind's complain. Of course one can't read a vector one element after the end of the string!
 	  // TODO this can be indenting the curves sometimes. FIX
 	  // cost deletion:
-	  fun1 =  mat1[jj] + delta; 
+	  fun1 = (jj <= phi ? mat1[jj] + delta : DLARGE);
 	  // cost insertion:
-	  fun2 = mati[jj-1] + delta;
+	  fun2 = (jj > lo ? mati[jj-1] + delta : DLARGE);
 	  // cost mutation:
-	  if (i == n || j == m)
+	  if (jj-1 < plo || jj-1 > phi)
+	    fun3 = DLARGE;
+	  else if (i == n || j == m)
 	    fun3 = mat1[jj-1];
 	  else
 	    {
-	      vs_x = p1.v_x[ii] - p2.v_x[j];
-	      vs_y = p1.v_y[ii] - p2.v_y[j];
+	      vs_x = v1x[ii] - v2x[j];
+	      vs_y = v1y[ii] - v2y[j];
 	      fun3 = mat1[jj-1] + sqrt(vs_x*vs_x + vs_y*vs_y);
 	    }
 	  // put the lowest value:
 	  // since most are mutations, start with fun3:
 	  if (fun3 <= fun1 && fun3 <= fun2)
 	    mati[jj] = fun3;
-	else if (fun1 <= fun2 && fun1 <= fun3)
-	  mati[jj] = fun1;
-	else
-	  mati[jj] = fun2;
+	  else if (fun1 <= fun2 && fun1 <= fun3)
+	    mati[jj] = fun1;
+	  else
+	    mati[jj] = fun2;
 	}
     }
-
-  return matrix;
 }
 
 /** Find the minimum sum of the edges of all triangular faces drawn between two perimeters, by applying a crawling test starting at point 0, 1, 2 .. etc of the second perimeter. Always starts at point 0 of the first perimeter.
@@ -697,175 +673,138 @@ MorphCurve::findStartingPoint(Perimeter p1, Perimeter p2)
   return start;
 }
 
-/** A recursive function to find the min_j for the minimum distance between p1 and p2.
- *  Uses a divide and conquer approach: given the interval length, it will recurse using halfs of it.
+/** Find the min_j for the minimum distance between p1 and p2.
+ *  Uses a divide and conquer approach: try one every interval_length points,
+ *  then look around the best one with half the interval, and so on.
  *  Puts more than 65 minutes to 5 minutes !!!! Awesome. But it's not perfect:
  *  	- ends may be computed twice
  *  	- one of the planes was not aligned correctly in the thresholded, hard model.
+ *  The two matrices are swapped rather than copied; the one holding the
+ *  best match is returned.  Returns 0, with min_j -1, when no starting
+ *  point gives a distance below DLARGE.
  */
-MinDist
-MorphCurve::findMinDist(Perimeter p1, Perimeter p2,
-			double delta, int first, int last, int interval_length,
-			MinDist result)
+EditMatrix*
+MorphCurve::findMinDist(const Perimeter& p1, const Perimeter& p2,
+			double delta,
+			EditMatrix& matrix1, EditMatrix& matrix2,
+			int& min_j)
 {
-  double** matrix = result.matrix;
-  double** matrix_e = result.matrix_e; // editable matrix
-  double** matrix1 = matrix_e;
-  double** matrix2 = matrix;
-  
-  // the iterator over p2
-  int j;
+  EditMatrix *matrix = &matrix1;   // best so far
+  EditMatrix *matrix_e = &matrix2; // editable matrix
 
-  // size of the interval to explore
-  int k = 0;
-  int length;
-  if (last < first)
-    length = p2.length - first + last;
-  else
-    length = last - first + 1;
-
-  // gather data
   int n = p1.length;
   int m = p2.length;
-  int min_j = result.min_j;
-  double min_dist = result.min_dist;
 
-  while (k < length)
+  int first = 0;
+  int last = m-1;
+  int interval_length = (int) ceil(m * 0.1);
+  double min_dist = DLARGE;
+  min_j = -1;
+
+  while (true)
     {
-      j = first + k;
-      // correct circular array
-      if (j >= p2.length)
-	j = j - p2.length;
-
-      // don't do some twice: TODO this setup does not save the case when the computation was done not in the previous iteration but before.
-      if (j == result.min_j)
-	matrix_e = result.matrix_e;
+      // size of the interval to explore
+      int length;
+      if (last < first)
+	length = m - first + last;
       else
-	matrix_e = findEditMatrix(p1, p2, j, delta, matrix_e);
-    
-      if (matrix_e[n][m] < min_dist)
+	length = last - first + 1;
+
+      int k = 0;
+      while (k < length)
 	{
-	  // record values
-	  min_j = j;
-	  matrix = matrix_e;
-	  min_dist = matrix[n][m];
-	  // swap editable matrix
-	  if (*matrix_e == *matrix1)
-	    //dereference, to compare the addresses of the arrays.
-	    matrix_e = matrix2;
+	  int j = first + k;
+	  // correct circular array
+	  if (j >= m)
+	    j = j - m;
+
+	  // don't do the current best twice
+	  if (j != min_j)
+	    {
+	      findEditMatrix(p1, p2, j, delta, *matrix_e);
+	      double dist = matrix_e->value(n, m);
+	      if (dist < min_dist)
+		{
+		  // record values and swap editable matrix
+		  min_j = j;
+		  min_dist = dist;
+		  EditMatrix *t = matrix;
+		  matrix = matrix_e;
+		  matrix_e = t;
+		}
+	    }
+
+	  // advance iterator
+	  if (length -1 != k && k + interval_length >= length)
+	    // do the last one (and then finish)
+	    k = length -1;
 	  else
-	    matrix_e = matrix1;
+	    k += interval_length;      
 	}
-		
-      // advance iterator
-      if (length -1 != k && k + interval_length >= length)
-	// do the last one (and then finish)
-	k = length -1;
-      else
-	k += interval_length;      
-    }
 
-  MinDist res;
-  res.min_j = min_j;
-  res.min_dist = min_dist;
-  res.set(matrix, matrix_e, n+1, m+1);
+      // nothing matched - matrix was never filled
+      if (min_j < 0)
+	return 0;
+
+      if (interval_length <= 1)
+	break;
 
-  if (interval_length > 1)
-    {
       first = min_j - (interval_length -1);
       last = min_j + (interval_length -1);
       // correct first:
       if (first < 0)
-	first = p2.length + first; // a '+' so it is substracted from p2.length
+	first = m + first; // a '+' so it is substracted from p2.length
 
       // correct last:
-      if (last >= p2.length)
-	last -= p2.length;
+      if (last >= m)
+	last -= m;
 
-      // recurse, with half the interval length
+      // continue with half the interval length
       interval_length = (int) ceil(interval_length / 2.0f);
-      return findMinDist(p1, p2, delta, first, last, interval_length, res);
     }
 
-  // otherwise done!
-  return res;
+  return matrix;
 }
 
 /** Find the minimum edit distance between Perimeter p1 and p2.
- * Returns the matrix as returned by findEditMatrix().
+ * Returns whichever of the two matrices holds the result of findEditMatrix()
+ * for the best starting point; p2 is reordered to start at that point.
  */
-double**
-MorphCurve::findMinimumEditDistance(Perimeter& p1, Perimeter& p2, double delta, bool is_closed_curve)
+EditMatrix*
+MorphCurve::findMinimumEditDistance(const Perimeter& p1, Perimeter& p2,
+				    double delta, bool is_closed_curve,
+				    EditMatrix& matrix1, EditMatrix& matrix2)
 {
-
   // iterators
   int j, i;
   
-  int min_j = 0;
-  int n = p1.length;
   int m = p2.length;
 
-  // allocate the first matrix
-  double** matrix1 = new double*[n+1];
-  for(int i=0; i<n+1; i++)
-    {
-      matrix1[i] = new double[m+1];
-      memset(matrix1[i], 0, (m+1)*sizeof(double));
-      // make the first element be i*delta
-      matrix1[i][0] = i * delta;
-    }
-
-  // make the first j row be j * delta
-  for (j=0; j < m + 1; j++)
-    matrix1[0][j] = j * delta;
-
   // return the matrix made matching point 0 of both curves, if the curve is open.
   if (!is_closed_curve)
-    return findEditMatrix(p1, p2, 0, delta, matrix1);
-
-  // else try every point in the second curve to see which one is the best possible match.
-  
-  // allocate the second matrix
-  double** matrix2 = new double*[n+1];
-  for(int i=0; i<n+1; i++)
     {
-      matrix2[i] = new double[m+1];
-      memset(matrix2[i], 0, (m+1)*sizeof(double));
-      // make the first element be i*delta
-      matrix2[i][0] = i * delta;
+      findEditMatrix(p1, p2, 0, delta, matrix1);
+      return &matrix1;
     }
 
-  // make the first j row be j * delta
-  for (j=0; j < m + 1; j++)
-    matrix2[0][j] = j * delta;
-
-  // Store the distances, to trace a curve and find the different valleys.
+  // else try every point in the second curve to see which one is the best possible match.
 
   // A 'divide and conquer' approach:
   // Find the value of one every 10% of points. Then find those intervals with the lowest starting and ending values, and then look for 50% intervals inside those, and so on, until locking into the lowest value. It will save about 80% or more of all computations.
-  MinDist mindata;
-  mindata.min_j = -1;
-  mindata.min_dist = DLARGE;
-  mindata.ndim = n+1;
-  mindata.mdim = m+1;
-  mindata.matrix = matrix2;
-  mindata.matrix_e = matrix1;
-
-  MinDist min_data = findMinDist(p1, p2, delta,
-				 0, m-1, (int) ceil(m * 0.1), mindata);
-
-  min_j = min_data.min_j;
-
-  // the one to keep
-  double** matrix = new double*[n+1];
-  for(int i=0; i<n+1; i++)
+  int min_j = 0;
+  EditMatrix *matrix = findMinDist(p1, p2, delta,
+				   matrix1, matrix2, min_j);
+  if (!matrix)
     {
-      matrix[i] = new double[m+1];
-      memcpy(matrix[i], min_data.matrix[i], (m+1)*sizeof(double));
+      // match point 0 of both curves, as for open curves
+      m_warnings << QString("No starting point found to match curves of length %1 and %2 - matching their first points").\
+	                arg(p1.length).arg(m);
+      findEditMatrix(p1, p2, 0, delta, matrix1);
+      return &matrix1;
     }
 
   // Reorder the second array, so that min_j is index zero (i.e. simply making both curves start at points that are closest to each other in terms of curve similarity).
-  if (min_j != 0)
+  if (min_j > 0)
     {
       QVector<double> tmp;
       tmp.resize(m);
@@ -902,26 +841,6 @@ MorphCurve::findMinimumEditDistance(Perimeter& p1, Perimeter& p2, double delta,
   return matrix;
 }
 
-// Makes an enlarged copy of the given editions array.
-QVector<int>
-MorphCurve::resizeAndFillEditionsCopy(QVector<int> editions, int ed_length, int new_length)
-{
-  //check: 
-  if ( new_length <= ed_length)
-    {
-      QMessageBox::information(0, "", "editions array not resized, new_length is shorter or equal.");
-      return editions;
-    }
-
-  QVector<int> editions2;
-  editions2.resize(3*new_length);
-
-  for(int i=0; i<3*ed_length; i++)
-    editions[i] = editions[i];
-
-  return editions2;
-}
-
 /** Find the optimal path in the matrix.
  *  Returns a 2D array such as [n][3]:
  *  	- the second dimension records:
@@ -933,153 +852,91 @@ MorphCurve::resizeAndFillEditionsCopy(QVector<int> editions, int ed_length, int
  *  		- the j
  * 
  * Find the optimal edit sequence, and also reorder the second array to be matchable with the first starting at index zero of both. This method, applied to all consecutive pairs of curves, reorders all but the first (whose zero will be used as zero for all) of the non-interpolated perimeters (the originals) at findMinimumEditDistance.
+ * Long perimeters are aligned within a band around the diagonal of the edit matrix.
  * */
 Editions
-MorphCurve::findOptimalEditSequence(Perimeter p1, Perimeter p2,
+MorphCurve::findOptimalEditSequence(const Perimeter& p1, Perimeter& p2,
 				    double delta, bool is_closed_curve)
 {
-  // fetch the optimal matrix:
-  double** matrix = findMinimumEditDistance(p1, p2, delta, is_closed_curve);
-
   int n = p1.length;
   int m = p2.length;
-  int initial_length = sqrtf((n*n)+(m*m));
-  int i = 0;
+
+  int band = m;
+  if ((qint64)(n+1)*(m+1) > maxFullMatrixCells)
+    band = qMax(qMax(64, qMax(n, m)/8), m/qMax(1, n) + 2);
+
+  // matrices live in this thread's arena
+  MorphArena *arena = morphArena();
+  qint64 msize = EditMatrix::size(n, m, band);
+  EditMatrix matrix1, matrix2;
+  matrix1.setup(n, m, band, arena->buffer(0, msize));
+  if (is_closed_curve)
+    matrix2.setup(n, m, band, arena->buffer(1, msize));
+
+  // fetch the optimal matrix:
+  EditMatrix *matrix = findMinimumEditDistance(p1, p2, delta, is_closed_curve,
+					       matrix1, matrix2);
+
+  // editions are collected backwards, three ints each
   QVector<int> editions;
-  editions.resize(3*initial_length);
-  
-  int ed_length = initial_length;
-  int next = 0;
-  i = n;
+  editions.reserve(3*(n+m+2));
+
+  int i = n;
   int j = m;
   int k;
   double error = 0.00001; //for floating-point math.
   while (0 != i && 0 != j)
     { // the matrix is n+1 x m+1 in size
-      // check editions array
-      if (next == ed_length)
-	{
-	  //enlarge editions array
-	  editions = resizeAndFillEditionsCopy(editions, ed_length, ed_length + 20);
-	  ed_length += 20;
-	}
       // find next i, j and the type of transform:
-      if (error > qAbs(matrix[i][j] - matrix[i-1][j] - delta))
+      double mij = matrix->value(i, j);
+      if (error > qAbs(mij - matrix->value(i-1, j) - delta))
 	{
 	  // a deletion:
-	  editions[3*next+0] = DELETION;
-	  editions[3*next+1] = i;
-	  editions[3*next+2] = j;
+	  editions << DELETION << i << j;
 	  i = i-1;
 	}
-      else if (error > qAbs(matrix[i][j] - matrix[i][j-1] - delta))
+      else if (error > qAbs(mij - matrix->value(i, j-1) - delta))
 	{
 	  // an insertion:
-	  editions[3*next+0] = INSERTION;
-	  editions[3*next+1] = i;
-	  editions[3*next+2] = j;
+	  editions << INSERTION << i << j;
 	  j = j-1;
 	}
       else
 	{
 	  // a mutation (a trace between two elements of the string of vectors)
-	  editions[3*next+0] = MUTATION;
-	  editions[3*next+1] = i;
-	  editions[3*next+2] = j;
+	  editions << MUTATION << i << j;
 	  i = i-1;
 	  j = j-1;
 	}
-      //prepare next
-      next++;
     }
 
   // add unnoticed insertions/deletions. It happens if 'i' and 'j' don't reach the zero value at the same time.
   if (j != 0)
     {
       for (k=j; k>-1; k--)
-	{
-	  if (next == ed_length)
-	    {
-	      //enlarge editions array
-	      editions = resizeAndFillEditionsCopy(editions, ed_length, ed_length + 20);
-	      ed_length += 20;
-	    }
-	  editions[3*next+0] = INSERTION;
-	  editions[3*next+1] = 0;
-	  editions[3*next+2] = k;
-	  next++;
-	}
+	editions << INSERTION << 0 << k;
     }
   if (i != 0)
     {
       for (k=i; k>-1; k--)
-	{
-	  if (next == ed_length)
-	    {
-	      //enlarge editions array
-	      editions = resizeAndFillEditionsCopy(editions, ed_length, ed_length + 20);
-	      ed_length += 20;
-	    }
-	  editions[3*next+0] = DELETION;
-	  editions[3*next+1] = k;
-	  editions[3*next+2] = 0;
-	  next++;
-	}
+	editions << DELETION << k << 0;
     }
 
-  // override edition at zero! A mutation by definition
-  // check editions array
-  //editions[next-1][0] = MUTATION;
-  //editions[next-1][1] = 0;
-  //editions[next-1][2] = 0;
-  
-
-
-  // reverse and resize editions array, and DO NOT slice out the last element.
-  QVector<int> editions2;
-  if (next != ed_length)
-    {
-      // allocate a new editions array  ('next' is the length now, since it is the index of the element after the last element)
-      editions2.resize(3*next);
-      for (i=0, j=next-1; i<next; i++, j--)
-	{
-	  editions2[3*i+0] = editions[3*j+0];
-	  editions2[3*i+1] = editions[3*j+1];
-	  editions2[3*i+2] = editions[3*j+2];
-	}
-      // release old editions array
-      editions.clear();
-    }
-  else
-    {
-      //simply reorder in place
-      for (i=0; i<next; i++)
-	{
-	  int temp = editions[3*i+0];
-	  editions[3*i+0] = editions[3*(next-1-i)+0];
-	  editions[3*(next-1-i)+0] = temp;
-
-	  temp = editions[3*i+1];
-	  editions[3*i+1] = editions[3*(next-1-i)+1];
-	  editions[3*(next-1-i)+1] = temp;
-
-	  temp = editions[3*i+2];
-	  editions[3*i+2] = editions[3*(next-1-i)+2];
-	  editions[3*(next-1-i)+2] = temp;
-	}
-      editions2 = editions;
-    }
+  // reverse editions array, and DO NOT slice out the last element.
+  int next = editions.count()/3;
+  for (i=0; i<next/2; i++)
+    for (k=0; k<3; k++)
+      {
+	int temp = editions[3*i+k];
+	editions[3*i+k] = editions[3*(next-1-i)+k];
+	editions[3*(next-1-i)+k] = temp;
+      }
 
   // return in a struct:
   Editions e;
-  e.editions = editions2;
+  e.editions = editions;
   e.length = next;
-  e.distance = matrix[n][m];
-
-  // release the matrix
-  for (i=0; i<n+1; i++)
-    delete [] matrix[i];
-  delete [] matrix;
+  e.distance = matrix->value(n, m);
   
   return e;
 }
@@ -1166,13 +1023,9 @@ MorphCurve::getMorphedPerimeter(Perimeter p1, Perimeter p2,
 	  vs_y = p1.v_y[i] * (1.0 - alpha) + p2.v_y[j] * alpha;
 	  break;
 	default:
-	  QMessageBox::information(0, "", "\ngetMorphedPerimeter: Nothing added!");
 	  break;
 	}
 
-      if (next+1 > n_editions/*-1*/)
-	QMessageBox::information(0, "", "\nWARNING: out of bounds at 1259");
-
       // store the point
       x[next+1] = x[next] + vs_x;
       y[next+1] = y[next] + vs_y;
@@ -1205,7 +1058,7 @@ MorphCurve::getMorphedPerimeters(Perimeter p1_, Perimeter p2_,
       delta <= 0 ||
       p1_.length <= 0 || p2_.length <=0)
     {
-      QMessageBox::information(0, "", QString("\nERROR: args are not acceptable at getMorphedPerimeters:\n\t n_morphed_perimeters %1, delta %2, p1->length %3, p2->length %4").arg(n_morphed_perimeters).arg(delta).arg(p1_.length).arg(p2_.length));
+      m_warnings << QString("args are not acceptable at getMorphedPerimeters: n_morphed_perimeters %1, delta %2, p1->length %3, p2->length %4").arg(n_morphed_perimeters).arg(delta).arg(p1_.length).arg(p2_.length);
       return NULL;
     }
 
@@ -1260,16 +1113,10 @@ MorphCurve::getAllPerimeters(QList<Perimeter> perimeters,
   //check preconditions:
   if (n_morphed_perimeters < -1 || n_perimeters <=0)
     {
-      QMessageBox::information(0, "", QString("\nERROR: args are not acceptable at getAllPerimeters:\n\t n_morphed_perimeters %1, n_perimeters %2").arg(n_morphed_perimeters).arg(n_perimeters));
+      m_warnings << QString("args are not acceptable at getAllPerimeters: n_morphed_perimeters %1, n_perimeters %2").arg(n_morphed_perimeters).arg(n_perimeters);
       return NULL;
     }
 
-  QProgressDialog progress(QString("Morphing Curves"),
-			   QString(),
-			   0, 100,
-			   0);
-  progress.setMinimumDuration(0);
-
   // get all morphed curves and return them.
   int i, j;
 
@@ -1299,12 +1146,6 @@ MorphCurve::getAllPerimeters(QList<Perimeter> perimeters,
       all_perimeters << perimeters[i-1];
       next++;
 
-      progress.setValue((int)(100*(float)i/(float)n_perimeters));
-      progress.setLabelText(QString("morphing curves between %1 and %2").\
-			    arg(perimeters[i-1].z).\
-			    arg(perimeters[i].z));
-      qApp->processEvents();
-
       // get every morphed curve
       int nmp = qMax(0, (int)qAbs(perimeters[i-1].z - perimeters[i].z)-1);
       if (n_morphed_perimeters > 0)
@@ -1325,8 +1166,8 @@ MorphCurve::getAllPerimeters(QList<Perimeter> perimeters,
 	}
       else
 	{
-	  QMessageBox::information(0, "", QString("No morphed perimeters between z1=%1 and z2=%2").\
-				   arg(perimeters[i-1].z).arg(perimeters[i].z));
+	  m_warnings << QString("No morphed perimeters between z1=%1 and z2=%2").\
+	                arg(perimeters[i-1].z).arg(perimeters[i].z);
 	}
     }
   // append the last one
@@ -1341,8 +1182,6 @@ MorphCurve::getAllPerimeters(QList<Perimeter> perimeters,
       perimeters[i].subsampled = 0; //used as a flag to indicate if vectors exist
     }
 
-  progress.setValue(100);
-
   // Done!
   Result* result = new Result;
   result->p = all_perimeters;
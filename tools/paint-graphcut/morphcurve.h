@@ -45,23 +45,35 @@ class Perimeter
   QList<Editions> editions; // may be null if it was not one of the original perimeters.
 };
 
-/** A tuple containing the starting index and the matrix for that index. Used only in the findMinimumEditDistance below, in the divide and conquer approach */
-class MinDist
+/** Edit distance matrix of n+1 rows and m+1 columns in one flat buffer.
+ *  For long perimeters each row only holds the columns within 'band' of the
+ *  diagonal; cells outside the band read as infinitely expensive.
+ *  The buffer is not owned by the matrix.
+ */
+class EditMatrix
 {
  public :
-  MinDist();
-  ~MinDist();
+  EditMatrix();
+
+  static qint64 size(int, int, int);
+  void setup(int, int, int, double*);
+
+  // first and last column stored for row i
+  int lo(int i)
+  {
+    int c = ((qint64)i*m_m + m_n/2)/m_n;
+    return qBound(0, c-m_band, m_m+1-m_width);
+  }
+  int hi(int i) { return lo(i)+m_width-1; }
 
-  MinDist(const MinDist&);
-  MinDist& operator=(const MinDist&);
+  // row i indexed by column, valid from lo(i) to hi(i)
+  double* row(int i) { return m_data + (qint64)i*m_width - lo(i); }
 
-  void set(double**, double**, int, int);
+  double value(int, int);
 
-  int ndim, mdim;
-  int min_j;
-  double min_dist;
-  double** matrix;
-  double** matrix_e;
+ private :
+  int m_n, m_m, m_band, m_width;
+  double *m_data;
 };
 
 /** A tuple to be used to return the array of interpolated perimeters and its length.*/
@@ -106,6 +118,9 @@ class MorphCurve
   void setPaths(QMap< int, QVector<QPoint> >);
   QList<Perimeter> getMorphedPaths(bool);
 
+  // pairs of perimeters for which nothing was morphed
+  QStringList warnings() { return m_warnings; }
+
   enum EditOperation
     {
       DELETION = 1,
@@ -116,18 +131,20 @@ class MorphCurve
  private :
   QList<Perimeter> m_perimeters;
   Result *m_result;
+  QStringList m_warnings;
   
   double getAngle(double, double);
   
   double getAndSetAveragePointInterdistance(Perimeter&);
   QVector<double> recalculate(QVector<double>, int, double);
   Perimeter subsample(Perimeter, double, bool);
-  double** findEditMatrix(Perimeter, Perimeter, int, double, double**);
+  void findEditMatrix(const Perimeter&, const Perimeter&, int, double, EditMatrix&);
   int findStartingPoint(Perimeter, Perimeter);
-  MinDist findMinDist(Perimeter, Perimeter, double, int, int, int, MinDist);
-  double** findMinimumEditDistance(Perimeter&, Perimeter&, double, bool);
-  QVector<int> resizeAndFillEditionsCopy(QVector<int>, int, int);
-  Editions findOptimalEditSequence(Perimeter, Perimeter, double, bool);
+  EditMatrix* findMinDist(const Perimeter&, const Perimeter&, double,
+			  EditMatrix&, EditMatrix&, int&);
+  EditMatrix* findMinimumEditDistance(const Perimeter&, Perimeter&, double, bool,
+				      EditMatrix&, EditMatrix&);
+  Editions findOptimalEditSequence(const Perimeter&, Perimeter&, double, bool);
   Perimeter getMorphedPerimeter(Perimeter, Perimeter, QVector<int>, int, double);
   Result* getMorphedPerimeters(Perimeter, Perimeter, int, double, bool);
   Result* getAllPerimeters(QList<Perimeter>, int, int, double, bool);
@@ -0,0 +1,298 @@
+#include "multilabelmesher.h"
+
+#include <math.h>
+
+MultiLabelMesher::MultiLabelMesher()
+{
+  m_nw = m_nh = 0;
+  m_nslices = 0;
+  m_prev = m_cur = 0;
+  m_prevCells = m_curCells = 0;
+}
+
+MultiLabelMesher::~MultiLabelMesher()
+{
+  clear();
+}
+
+void
+MultiLabelMesher::clear()
+{
+  if (m_prev) delete [] m_prev;
+  if (m_cur) delete [] m_cur;
+  if (m_prevCells) delete [] m_prevCells;
+  if (m_curCells) delete [] m_curCells;
+  m_prev = m_cur = 0;
+  m_prevCells = m_curCells = 0;
+
+  m_vertices.clear();
+  for(int i=0; i<256; i++)
+    m_quads[i].clear();
+
+  m_nw = m_nh = 0;
+  m_nslices = 0;
+}
+
+void
+MultiLabelMesher::begin(int nw, int nh)
+{
+  clear();
+
+  m_nw = nw;
+  m_nh = nh;
+
+  int psize = (nw+2)*(nh+2);
+  m_prev = new uchar[psize];
+  m_cur = new uchar[psize];
+  memset(m_prev, 0, psize);
+  memset(m_cur, 0, psize);
+
+  int csize = (nw+1)*(nh+1);
+  m_prevCells = new int[csize];
+  m_curCells = new int[csize];
+  for(int i=0; i<csize; i++)
+    m_prevCells[i] = -1;
+}
+
+void
+MultiLabelMesher::addSlice(uchar *slice)
+{
+  int ph = m_nh+2;
+  if (slice)
+    {
+      for(int w=0; w<m_nw; w++)
+	memcpy(m_cur + (w+1)*ph + 1, slice + w*m_nh, m_nh);
+    }
+  else
+    memset(m_cur, 0, (m_nw+2)*ph);
+
+  processLayer();
+
+  uchar *t = m_prev;
+  m_prev = m_cur;
+  m_cur = t;
+
+  int *c = m_prevCells;
+  m_prevCells = m_curCells;
+  m_curCells = c;
+
+  m_nslices++;
+}
+
+void
+MultiLabelMesher::end()
+{
+  // close the surfaces against the empty slice past the end
+  addSlice(0);
+
+  delete [] m_prev;
+  delete [] m_cur;
+  delete [] m_prevCells;
+  delete [] m_curCells;
+  m_prev = m_cur = 0;
+  m_prevCells = m_curCells = 0;
+}
+
+void
+MultiLabelMesher::addQuad(int la, int lb,
+			  int c0, int c1, int c2, int c3)
+{
+  // c0-c3 run anticlockwise seen from lb
+  if (la > 0)
+    m_quads[la] << c0 << c1 << c2 << c3;
+  if (lb > 0)
+    m_quads[lb] << c3 << c2 << c1 << c0;
+}
+
+// cells between m_prev (slice m_nslices-1) and m_cur
+void
+MultiLabelMesher::processLayer()
+{
+  int ph = m_nh+2;
+  int ch = m_nh+1;
+  float z0 = m_nslices-1;
+
+  //--------
+  // cell vertices
+  for(int cw=0; cw<=m_nw; cw++)
+    for(int c=0; c<=m_nh; c++)
+      {
+	// corner i is at h+(i&1), w+((i>>1)&1), d+((i>>2)&1)
+	uchar v[8];
+	v[0] = m_prev[cw*ph + c];
+	v[1] = m_prev[cw*ph + c+1];
+	v[2] = m_prev[(cw+1)*ph + c];
+	v[3] = m_prev[(cw+1)*ph + c+1];
+	v[4] = m_cur[cw*ph + c];
+	v[5] = m_cur[cw*ph + c+1];
+	v[6] = m_cur[(cw+1)*ph + c];
+	v[7] = m_cur[(cw+1)*ph + c+1];
+
+	bool same = true;
+	for(int i=1; i<8 && same; i++)
+	  same = (v[i] == v[0]);
+	if (same)
+	  {
+	    m_curCells[cw*ch + c] = -1;
+	    continue;
+	  }
+
+	float x = 0, y = 0, z = 0;
+	int ne = 0;
+	for(int i=0; i<8; i++)
+	  for(int b=1; b<8; b<<=1)
+	    if (!(i & b) && v[i] != v[i|b])
+	      {
+		int j = i|b;
+		x += ((i&1) + (j&1))*0.5f;
+		y += (((i>>1)&1) + ((j>>1)&1))*0.5f;
+		z += (((i>>2)&1) + ((j>>2)&1))*0.5f;
+		ne++;
+	      }
+
+	// padded voxel p is volume voxel p-1
+	m_curCells[cw*ch + c] = m_vertices.count()/3;
+	m_vertices << c-1 + x/ne
+		   << cw-1 + y/ne
+		   << z0 + z/ne;
+      }
+  //--------
+
+  //--------
+  // faces between the two slices
+  for(int w=1; w<=m_nw; w++)
+    for(int h=1; h<=m_nh; h++)
+      {
+	uchar la = m_prev[w*ph + h];
+	uchar lb = m_cur[w*ph + h];
+	if (la != lb)
+	  addQuad(la, lb,
+		  m_curCells[(w-1)*ch + h-1],
+		  m_curCells[(w-1)*ch + h],
+		  m_curCells[w*ch + h],
+		  m_curCells[w*ch + h-1]);
+      }
+  //--------
+
+  // the slice before the first one is empty
+  if (m_nslices == 0)
+    return;
+
+  //--------
+  // faces within the previous slice, their cells lie in
+  // the previous and the current cell layer
+  for(int w=1; w<=m_nw; w++)
+    for(int h=0; h<=m_nh; h++)
+      {
+	uchar la = m_prev[w*ph + h];
+	uchar lb = m_prev[w*ph + h+1];
+	if (la != lb)
+	  addQuad(la, lb,
+		  m_prevCells[(w-1)*ch + h],
+		  m_prevCells[w*ch + h],
+		  m_curCells[w*ch + h],
+		  m_curCells[(w-1)*ch + h]);
+      }
+
+  for(int w=0; w<=m_nw; w++)
+    for(int h=1; h<=m_nh; h++)
+      {
+	uchar la = m_prev[w*ph + h];
+	uchar lb = m_prev[(w+1)*ph + h];
+	if (la != lb)
+	  addQuad(la, lb,
+		  m_prevCells[w*ch + h-1],
+		  m_curCells[w*ch + h-1],
+		  m_curCells[w*ch + h],
+		  m_prevCells[w*ch + h]);
+      }
+  //--------
+}
+
+QList<int>
+MultiLabelMesher::labels()
+{
+  QList<int> lbl;
+  for(int i=1; i<256; i++)
+    if (m_quads[i].count() > 0)
+      lbl << i;
+  return lbl;
+}
+
+void
+MultiLabelMesher::mesh(int label,
+		       QVector<Vertex>& verts,
+		       QVector<Triangle>& tris)
+{
+  verts.clear();
+  tris.clear();
+  if (label < 1 || label > 255)
+    return;
+
+  const QVector<int>& quads = m_quads[label];
+  int nq = quads.count()/4;
+  if (nq == 0)
+    return;
+
+  // compact vertex indices for this label
+  QVector<int> vmap(m_vertices.count()/3, -1);
+  QVector<int> idx(quads.count());
+  for(int i=0; i<quads.count(); i++)
+    {
+      int v = quads[i];
+      if (vmap[v] < 0)
+	{
+	  vmap[v] = verts.count();
+	  Vertex vx;
+	  vx.x = m_vertices[3*v+0];
+	  vx.y = m_vertices[3*v+1];
+	  vx.z = m_vertices[3*v+2];
+	  vx.nx = vx.ny = vx.nz = 0;
+	  verts << vx;
+	}
+      idx[i] = vmap[v];
+    }
+
+  tris.resize(2*nq);
+  for(int q=0; q<nq; q++)
+    {
+      int *c = idx.data() + 4*q;
+      tris[2*q].v1 = c[0];
+      tris[2*q].v2 = c[1];
+      tris[2*q].v3 = c[2];
+      tris[2*q+1].v1 = c[0];
+      tris[2*q+1].v2 = c[2];
+      tris[2*q+1].v3 = c[3];
+    }
+
+  //--------
+  // area weighted vertex normals
+  Vertex *vp = verts.data();
+  for(int t=0; t<tris.count(); t++)
+    {
+      Vertex &a = vp[tris[t].v1];
+      Vertex &b = vp[tris[t].v2];
+      Vertex &c = vp[tris[t].v3];
+      float ux = b.x-a.x, uy = b.y-a.y, uz = b.z-a.z;
+      float wx = c.x-a.x, wy = c.y-a.y, wz = c.z-a.z;
+      float nx = uy*wz - uz*wy;
+      float ny = uz*wx - ux*wz;
+      float nz = ux*wy - uy*wx;
+      a.nx += nx; a.ny += ny; a.nz += nz;
+      b.nx += nx; b.ny += ny; b.nz += nz;
+      c.nx += nx; c.ny += ny; c.nz += nz;
+    }
+  for(int i=0; i<verts.count(); i++)
+    {
+      float len = sqrt(vp[i].nx*vp[i].nx +
+		       vp[i].ny*vp[i].ny +
+		       vp[i].nz*vp[i].nz);
+      if (len > 0)
+	{
+	  vp[i].nx /= len;
+	  vp[i].ny /= len;
+	  vp[i].nz /= len;
+	}
+    }
+  //--------
+}
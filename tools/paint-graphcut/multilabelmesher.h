@@ -0,0 +1,58 @@
+#ifndef MULTILABELMESHER_H
+#define MULTILABELMESHER_H
+
+#include <QList>
+#include <QVector>
+
+#include "marchingcubes.h"
+
+//---------------------------------------
+// surfaces of all labels of a label volume in one pass.
+// slices are added one at a time, only two slices are held.
+// every cell (2x2x2 voxels) whose corners carry more than one
+// label gets one vertex at the mean of the midpoints of its
+// label changing edges; each voxel face between two labels
+// becomes a quad joining the four cells around it, added to
+// both labels with opposite orientation.  neighbouring labels
+// therefore share their boundary vertices exactly.
+// voxels outside the volume are label 0 so that meshes are
+// closed; label 0 itself is not meshed.
+// vertex coordinates are x=h, y=w, z=d in voxel units.
+//---------------------------------------
+class MultiLabelMesher
+{
+ public :
+  MultiLabelMesher();
+  ~MultiLabelMesher();
+
+  // slice voxel (w,h) is slice[w*nh + h]
+  void begin(int nw, int nh);
+  void addSlice(uchar*);
+  void end();
+
+  void clear();
+
+  // labels that have a surface
+  QList<int> labels();
+
+  // compact mesh for a label, normals point out of the label
+  void mesh(int, QVector<Vertex>&, QVector<Triangle>&);
+
+ private :
+  int m_nw, m_nh;
+  int m_nslices;
+
+  // padded slices (nw+2)*(nh+2), prev is slice m_nslices-1
+  uchar *m_prev, *m_cur;
+
+  // vertex index of each cell in the last two cell layers
+  int *m_prevCells, *m_curCells;
+
+  QVector<float> m_vertices;
+  QVector<int> m_quads[256];
+
+  void processLayer();
+  void addQuad(int, int, int, int, int, int);
+};
+
+#endif
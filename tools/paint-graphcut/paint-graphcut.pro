@@ -9,6 +9,7 @@ DEPENDPATH += .
 
 QT += opengl
 QT += widgets core gui xml
+QT += concurrent
 
 CONFIG += release
 
@@ -18,6 +19,9 @@ TARGET = drishtipaint
 
 INCLUDEPATH += graphcut
 
+# benchmark helpers shared with drishti and drishtiimport
+INCLUDEPATH += ../../common
+
 # Input
 FORMS += drishtipaint.ui
 
@@ -27,7 +31,14 @@ QMAKE_LIBDIR += c:\Qt\libQGLViewer-2.6.1\lib
 
 HEADERS += commonqtclasses.h \
 	drishtipaint.h \
+	benchmark.h \
+	../../common/benchmarkdata.h \
 	bitmapthread.h \
+	bitmorphology.h \
+	editjournal.h \
+	surfacevoxelindex.h \
+	maskfilter.h \
+	multilabelmesher.h \
 	curvegroup.h \
 	dcolordialog.h \
 	dcolorwheel.h \
@@ -64,7 +75,14 @@ HEADERS += commonqtclasses.h \
 
 SOURCES += drishtipaint.cpp \
 	main.cpp \
+	benchmark.cpp \
+	../../common/benchmarkdata.cpp \
 	bitmapthread.cpp \
+	bitmorphology.cpp \
+	editjournal.cpp \
+	surfacevoxelindex.cpp \
+	maskfilter.cpp \
+	multilabelmesher.cpp \
 	curvegroup.cpp \
 	dcolordialog.cpp \
 	dcolorwheel.cpp \
@@ -0,0 +1,213 @@
+#include "surfacevoxelindex.h"
+
+#include <QtConcurrentMap>
+
+SurfaceVoxelIndex::SurfaceVoxelIndex()
+{
+  m_depth = m_width = m_height = 0;
+  m_volPtr = 0;
+  m_maskPtr = 0;
+  m_skip = 5;
+  m_slabDepth = 16;
+}
+
+void
+SurfaceVoxelIndex::setGridSize(int d, int w, int h)
+{
+  m_depth = d;
+  m_width = w;
+  m_height = h;
+  resetSlabs();
+}
+
+void
+SurfaceVoxelIndex::setDataPtrs(uchar *vol, uchar *mask)
+{
+  m_volPtr = vol;
+  m_maskPtr = mask;
+  markAllDirty();
+}
+
+void
+SurfaceVoxelIndex::setSkip(int s)
+{
+  m_skip = qMax(0, s);
+  resetSlabs();
+}
+
+void
+SurfaceVoxelIndex::resetSlabs()
+{
+  // at least 16 slices, and at least one sampled slice, per slab
+  m_slabDepth = qMax(16, m_skip);
+  int nslabs = (m_depth+m_slabDepth-1)/m_slabDepth;
+
+  m_slabs.clear();
+  m_slabs.resize(nslabs);
+  m_dirty.fill(true, nslabs);
+
+  m_vertices.clear();
+  m_tags.clear();
+  m_values.clear();
+  m_colors.clear();
+}
+
+void
+SurfaceVoxelIndex::markAllDirty()
+{
+  m_dirty.fill(true);
+}
+
+void
+SurfaceVoxelIndex::markDirty(int mind, int maxd)
+{
+  if (m_dirty.size() == 0)
+    return;
+
+  // sampled slices look skip slices either side
+  mind = qMax(0, mind-m_skip);
+  maxd = qMin(m_depth-1, maxd+m_skip);
+  if (mind > maxd)
+    return;
+
+  m_dirty.fill(true, mind/m_slabDepth, maxd/m_slabDepth+1);
+}
+
+bool
+SurfaceVoxelIndex::isDirty()
+{
+  return (m_dirty.count(true) > 0);
+}
+
+bool
+SurfaceVoxelIndex::isBoundary(int d, int w, int h, uchar tag)
+{
+  int d0 = qMax(0, d-m_skip), d1 = qMin(m_depth-1, d+m_skip);
+  int w0 = qMax(0, w-m_skip), w1 = qMin(m_width-1, w+m_skip);
+  int h0 = qMax(0, h-m_skip), h1 = qMin(m_height-1, h+m_skip);
+
+  for(int dd=d0; dd<=d1; dd++)
+    for(int ww=w0; ww<=w1; ww++)
+      {
+	uchar *m = m_maskPtr + ((qint64)dd*m_width + ww)*m_height;
+	for(int hh=h0; hh<=h1; hh++)
+	  if (m[hh] != tag)
+	    return true;
+      }
+
+  return false;
+}
+
+void
+SurfaceVoxelIndex::computeSlab(SlabJob &job)
+{
+  SurfaceVoxelIndex *si = job.index;
+  Slab *slab = job.slab;
+  int skip = si->m_skip;
+
+  slab->vertices.clear();
+  slab->tags.clear();
+  slab->values.clear();
+
+  // first sampled slice in the slab
+  int d = 1;
+  if (job.d0 > 1)
+    d = 1 + ((job.d0-1+skip-1)/skip)*skip;
+
+  for(; d<=job.d1 && d<si->m_depth-1; d+=skip)
+    for(int w=1; w<si->m_width-1; w+=skip)
+      {
+	qint64 ridx = ((qint64)d*si->m_width + w)*si->m_height;
+	for(int h=1; h<si->m_height-1; h+=skip)
+	  {
+	    uchar tag = si->m_maskPtr[ridx + h];
+	    if (tag > 0 && si->isBoundary(d, w, h, tag))
+	      {
+		slab->vertices << h << w << d;
+		slab->tags << tag;
+		slab->values << si->m_volPtr[ridx + h];
+	      }
+	  }
+      }
+}
+
+void
+SurfaceVoxelIndex::update()
+{
+  if (!m_maskPtr || !m_volPtr || m_skip == 0)
+    return;
+
+  if (!isDirty())
+    return;
+
+  QList<SlabJob> jobs;
+  for(int s=0; s<m_slabs.count(); s++)
+    {
+      if (!m_dirty.testBit(s))
+	continue;
+
+      SlabJob job;
+      job.index = this;
+      job.slab = m_slabs.data() + s;
+      job.d0 = s*m_slabDepth;
+      job.d1 = qMin(m_depth-1, (s+1)*m_slabDepth-1);
+      jobs << job;
+    }
+  QtConcurrent::blockingMap(jobs, SurfaceVoxelIndex::computeSlab);
+
+  m_dirty.fill(false);
+
+  //--------
+  // pack slabs into contiguous arrays
+  int npts = 0;
+  for(int s=0; s<m_slabs.count(); s++)
+    npts += m_slabs[s].tags.count();
+
+  m_vertices.resize(3*npts);
+  m_tags.resize(npts);
+  m_values.resize(npts);
+
+  int np = 0;
+  for(int s=0; s<m_slabs.count(); s++)
+    {
+      int n = m_slabs[s].tags.count();
+      if (n == 0)
+	continue;
+
+      memcpy(m_vertices.data() + 3*np,
+	     m_slabs[s].vertices.constData(), 3*n*sizeof(float));
+      memcpy(m_tags.data() + np, m_slabs[s].tags.constData(), n);
+      memcpy(m_values.data() + np, m_slabs[s].values.constData(), n);
+      np += n;
+    }
+  //--------
+
+  m_colors.clear();
+}
+
+const uchar*
+SurfaceVoxelIndex::colors(uchar *tagColors)
+{
+  // rebuild when points or tag colours have changed
+  if (m_colors.count() == 3*m_tags.count() &&
+      m_colorTable.count() == 1024 &&
+      memcmp(m_colorTable.constData(), tagColors, 1024) == 0)
+    return m_colors.constData();
+
+  m_colorTable.resize(1024);
+  memcpy(m_colorTable.data(), tagColors, 1024);
+
+  int npts = m_tags.count();
+  m_colors.resize(3*npts);
+  uchar *c = m_colors.data();
+  for(int i=0; i<npts; i++)
+    {
+      int t = m_tags[i];
+      int v = m_values[i];
+      c[3*i+0] = (tagColors[4*t+0] + v)/2;
+      c[3*i+1] = (tagColors[4*t+1] + v)/2;
+      c[3*i+2] = (tagColors[4*t+2] + v)/2;
+    }
+
+  return m_colors.constData();
+}
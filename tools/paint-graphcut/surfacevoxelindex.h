@@ -0,0 +1,78 @@
+#ifndef SURFACEVOXELINDEX_H
+#define SURFACEVOXELINDEX_H
+
+#include <QVector>
+#include <QBitArray>
+
+//---------------------------------------
+// boundary voxels of the painted mask for the 3D preview.
+// voxels are sampled every skip voxels (starting at 1), a
+// sampled voxel is on the boundary when some voxel within skip
+// of it carries a different tag.
+// points are kept per depth slab and only slabs marked dirty
+// are recomputed; the result is packed into vertex and colour
+// arrays that can be drawn with a single glDrawArrays call.
+//---------------------------------------
+class SurfaceVoxelIndex
+{
+ public :
+  SurfaceVoxelIndex();
+
+  void setGridSize(int, int, int);
+  void setDataPtrs(uchar*, uchar*);
+  void setSkip(int);
+  int skip() { return m_skip; }
+
+  // mask changed between depth slices mind and maxd
+  void markDirty(int, int);
+  void markAllDirty();
+  bool isDirty();
+
+  // recompute dirty slabs and repack the point arrays
+  void update();
+
+  int count() { return m_tags.count(); }
+
+  // h, w, d for each point
+  const float* vertices() { return m_vertices.constData(); }
+
+  // rgb for each point - tag colour blended with voxel value
+  const uchar* colors(uchar*);
+
+ private :
+  struct Slab
+  {
+    QVector<float> vertices;
+    QVector<uchar> tags;
+    QVector<uchar> values;
+  };
+
+  struct SlabJob
+  {
+    SurfaceVoxelIndex *index;
+    Slab *slab;
+    int d0, d1;
+  };
+
+  int m_depth, m_width, m_height;
+  uchar *m_volPtr;
+  uchar *m_maskPtr;
+  int m_skip;
+  int m_slabDepth;
+
+  QVector<Slab> m_slabs;
+  QBitArray m_dirty;
+
+  QVector<float> m_vertices;
+  QVector<uchar> m_tags;
+  QVector<uchar> m_values;
+
+  QVector<uchar> m_colors;
+  QVector<uchar> m_colorTable; // tag colours used for m_colors
+
+  void resetSlabs();
+  bool isBoundary(int, int, int, uchar);
+  static void computeSlab(SlabJob&);
+};
+
+#endif
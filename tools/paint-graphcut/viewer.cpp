@@ -21,7 +21,7 @@ Viewer::init()
   m_pointSkip = 5;
   m_pointSize = 5;
 
-  m_voxels.clear();
+  m_surfaceVoxels.setSkip(m_pointSkip);
 
   m_minDSlice = 0;
   m_maxDSlice = 0;
@@ -31,8 +31,28 @@ Viewer::init()
   m_maxHSlice = 0;
 }
 
-void Viewer::setMaskDataPtr(uchar *ptr) { m_maskPtr = ptr; }
-void Viewer::setVolDataPtr(uchar *ptr) { m_volPtr = ptr; }
+void
+Viewer::setMaskDataPtr(uchar *ptr)
+{
+  m_maskPtr = ptr;
+  m_surfaceVoxels.setDataPtrs(m_volPtr, m_maskPtr);
+}
+
+void
+Viewer::setVolDataPtr(uchar *ptr)
+{
+  m_volPtr = ptr;
+  m_surfaceVoxels.setDataPtrs(m_volPtr, m_maskPtr);
+}
+
+void
+Viewer::maskChanged(int mind, int maxd)
+{
+  // recompute only the slabs around modified depth slices
+  m_surfaceVoxels.markDirty(mind, maxd);
+  m_surfaceVoxels.update();
+  update();
+}
 
 void
 Viewer::updateViewerBox(int minD, int maxD, int minW, int maxW, int minH, int maxH)
@@ -65,6 +85,7 @@ Viewer::keyPressEvent(QKeyEvent *event)
 					 "Point Interval",
 					 "Interval for display of points for painted mask",
 					 m_pointSkip, 0, 100);
+      m_surfaceVoxels.setSkip(m_pointSkip);
       updateVoxels();
       return;
     }
@@ -96,6 +117,8 @@ Viewer::setGridSize(int d, int w, int h)
   m_maxWSlice = w;
   m_maxHSlice = h;
 
+  m_surfaceVoxels.setGridSize(m_depth, m_width, m_height);
+
   setSceneBoundingBox(Vec(0,0,0), Vec(m_height, m_width, m_depth));
   showEntireScene();
 }
@@ -233,45 +256,8 @@ Viewer::draw()
 void
 Viewer::updateVoxels()
 {
-  m_voxels.clear();
-  
-  if (m_pointSkip == 0)
-    return;
-
-  for(int d=1; d<m_depth-1; d+=m_pointSkip)
-    {
-      for(int w=1; w<m_width-1; w+=m_pointSkip)
-	{
-	  for(int h=1; h<m_height-1; h+=m_pointSkip)
-	    {
-	      uchar tag = m_maskPtr[d*m_width*m_height + w*m_height + h];
-	      if (tag > 0)
-		{
-		  bool ok = false;
-		  for(int dd=-m_pointSkip; dd<=m_pointSkip; dd++)
-		    for(int ww=-m_pointSkip; ww<=m_pointSkip; ww++)
-		      for(int hh=-m_pointSkip; hh<=m_pointSkip; hh++)
-			{
-			  int d1 = qBound(0, d+dd, m_depth);
-			  int w1 = qBound(0, w+ww, m_width);
-			  int h1 = qBound(0, h+hh, m_height);
-			  if (m_maskPtr[d1*m_width*m_height + w1*m_height + h1] != tag)
-			    {
-			      ok = true;
-			      break;
-			    }
-			}
-
-		  if (ok)
-		    {
-		      uchar vol = m_volPtr[d*m_width*m_height + w*m_height + h];
-		      m_voxels << d << w << h << tag << vol;
-		    }
-
-		}
-	    }
-	}
-    }
+  m_surfaceVoxels.markAllDirty();
+  m_surfaceVoxels.update();
 }
 
 void
@@ -280,27 +266,20 @@ Viewer::drawVolMask()
   if (m_pointSkip == 0)
     return;
 
+  int npts = m_surfaceVoxels.count();
+  if (npts == 0)
+    return;
+
   glPointSize(m_pointSize);
-  int nv = m_voxels.count()/5;
-  for(int i=0; i<nv; i++)
-    {
-      int d = m_voxels[5*i+0];
-      int w = m_voxels[5*i+1];
-      int h = m_voxels[5*i+2];
-      int t = m_voxels[5*i+3];
-      float v = (float)m_voxels[5*i+4]/255.0;
-
-      glBegin(GL_POINTS);
-      float r = Global::tagColors()[4*t+0]*1.0/255.0;
-      float g = Global::tagColors()[4*t+1]*1.0/255.0;
-      float b = Global::tagColors()[4*t+2]*1.0/255.0;
-      r = r*0.5 + 0.5*v;
-      g = g*0.5 + 0.5*v;
-      b = b*0.5 + 0.5*v;
-      glColor3f(r,g,b);
-      glVertex3f(h, w, d);
-      glEnd();
-    }
+
+  glEnableClientState(GL_VERTEX_ARRAY);
+  glEnableClientState(GL_COLOR_ARRAY);
+  glVertexPointer(3, GL_FLOAT, 0, m_surfaceVoxels.vertices());
+  glColorPointer(3, GL_UNSIGNED_BYTE, 0,
+		 m_surfaceVoxels.colors(Global::tagColors()));
+  glDrawArrays(GL_POINTS, 0, npts);
+  glDisableClientState(GL_COLOR_ARRAY);
+  glDisableClientState(GL_VERTEX_ARRAY);
 }
 
 
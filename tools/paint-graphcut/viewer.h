@@ -6,6 +6,7 @@
 using namespace qglviewer;
 
 #include "curvegroup.h"
+#include "surfacevoxelindex.h"
 
 class Viewer : public QGLViewer
 {
@@ -26,6 +27,7 @@ class Viewer : public QGLViewer
 
   public slots :
     void updateViewerBox(int, int, int, int, int, int);
+    void maskChanged(int, int);
 
  private :
   int m_depth, m_width, m_height;
@@ -45,7 +47,7 @@ class Viewer : public QGLViewer
   QList< QMap<int, Curve> > *m_Wmcg;  
   QList< QMap<int, Curve> > *m_Hmcg;  
 
-  QList<ushort> m_voxels;
+  SurfaceVoxelIndex m_surfaceVoxels;
 
   void drawBox();
   
@@ -2,10 +2,21 @@
 #include "staticfunctions.h"
 #include "global.h"
 
-void Volume::setBitmapThread(BitmapThread *bt) {thread = bt;}
+void
+Volume::setBitmapThread(BitmapThread *bt)
+{
+  thread = bt;
+  connect(thread, SIGNAL(bitmaskChanged()),
+	  this, SLOT(updateBitmask()));
+}
 
 void Volume::saveIntermediateResults() { m_mask.saveIntermediateResults(); }
 
+bool Volume::undo() { return m_mask.undo(); }
+
+void Volume::beginMaskEdit() { m_mask.beginEdit(); }
+void Volume::endMaskEdit() { m_mask.endEdit(); }
+
 void
 Volume::setMaskDepthSlice(int slc, uchar* tagData)
 {
@@ -33,6 +44,7 @@ Volume::getMaskHeightSliceImage(int slc)
 Volume::Volume()
 {
   m_valid = false;
+  thread = 0;
 
   m_depth = m_height = m_width = 0;
   m_slice = 0;
@@ -56,6 +68,8 @@ Volume::Volume()
 	  this, SIGNAL(progressChanged(int)));
   connect(&m_mask, SIGNAL(progressReset()),
 	  this, SIGNAL(progressReset()));
+  connect(&m_mask, SIGNAL(maskChanged(int, int)),
+	  this, SIGNAL(maskChanged(int, int)));
 }
 
 Volume::~Volume() { reset(); }
@@ -66,6 +80,10 @@ void Volume::reset()
 {
   m_valid = false;
 
+  // the bitmap thread may still be reading the in-memory volume
+  if (thread)
+    thread->cancel();
+
   m_pvlFileManager.reset();
 
   m_mask.reset();
@@ -166,6 +184,11 @@ Volume::setFile(QString volfile)
 
   m_valid = true;
 
+  if (thread)
+    thread->setFiles(m_fileName, pvlnames, headerSize,
+		     m_depth, m_width, m_height, slabSize,
+		     m_pvlFileManager.memVolDataPtr());
+
   return true;
 }
 
@@ -529,7 +552,21 @@ Volume::tagAllVisible(int mind, int maxd,
 void
 Volume::createBitmask()
 {
-  return;
+  if (!m_valid || !thread)
+    return;
+
+  // built in the background, updateBitmask picks up the result
+  thread->createBitmask(Global::lut());
+}
+
+void
+Volume::updateBitmask()
+{
+  QBitArray bitmask = thread->bitmask();
+
+  // ignore results for a volume that is no longer loaded
+  if (bitmask.size() == m_bitmask.size())
+    m_bitmask = bitmask;
 }
 
 void
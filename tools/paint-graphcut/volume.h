@@ -22,6 +22,11 @@ class Volume : public QObject
   QString fileName() { return m_fileName; }
 
   void saveIntermediateResults();
+  bool undo();
+
+  // mask changes between these form one undo step
+  void beginMaskEdit();
+  void endMaskEdit();
 
   void gridSize(int&, int&, int&);
   QImage histogramImage1D()  { return m_histogramImage1D; }
@@ -71,6 +76,10 @@ class Volume : public QObject
  signals :
   void progressChanged(int);
   void progressReset();
+  void maskChanged(int, int);
+
+ private slots :
+  void updateBitmask();
 
  private :
   BitmapThread *thread;
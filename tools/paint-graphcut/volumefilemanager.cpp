@@ -1,6 +1,7 @@
 #include "volumefilemanager.h"
 #include <QtGui>
 #include <QMessageBox>
+#include <QtConcurrentRun>
 
 VolumeFileManager::VolumeFileManager()
 {
@@ -11,7 +12,10 @@ VolumeFileManager::VolumeFileManager()
   m_filenames.clear();
   m_volData = 0;
   m_memmapped = false;
+  m_memChanged = false;
+  m_rowsPerUnit = m_unitsPerSlice = 1;
   reset();
+  resetChangedRange();
 }
 
 VolumeFileManager::~VolumeFileManager() { reset(); }
@@ -29,6 +33,11 @@ bool VolumeFileManager::isMemMapped() { return m_memmapped; }
 void
 VolumeFileManager::reset()
 {
+  // keep the journal if there are unsaved changes
+  waitForSave();
+  m_journal.close(!m_memChanged);
+  m_dirty.clear();
+
   m_baseFilename.clear();
   m_filenames.clear();
   m_header = m_slabSize = 0;
@@ -227,7 +236,11 @@ VolumeFileManager::createFile(bool writeHeader, bool writeData)
   progress.setValue(100);
 
   if (m_memmapped)
-    createMemFile();
+    {
+      // journal of an earlier volume does not apply to this one
+      QFile::remove(journalFilename());
+      createMemFile();
+    }
 }
 
 uchar*
@@ -284,7 +297,7 @@ VolumeFileManager::getWidthSlice(int w)
       int slab = d/m_slabSize;
       if (pslab != slab)
 	{
-	  if (pslab > -1) m_qfile.close();
+	  if (m_qfile.isOpen()) m_qfile.close();
 
 	  if (slab < m_filenames.count())
 	    m_filename = m_filenames[slab];
@@ -294,6 +307,7 @@ VolumeFileManager::getWidthSlice(int w)
 
 	  m_qfile.setFileName(m_filename);
 	  m_qfile.open(QFile::ReadWrite);
+	  pslab = slab;
 	}
 
       m_qfile.seek((qint64)(m_header +
@@ -324,7 +338,7 @@ VolumeFileManager::getHeightSlice(int h)
       int slab = d/m_slabSize;
       if (pslab != slab)
 	{
-	  if (pslab > -1) m_qfile.close();
+	  if (m_qfile.isOpen()) m_qfile.close();
 
 	  if (slab < m_filenames.count())
 	    m_filename = m_filenames[slab];
@@ -334,6 +348,7 @@ VolumeFileManager::getHeightSlice(int h)
 
 	  m_qfile.setFileName(m_filename);
 	  m_qfile.open(QFile::ReadWrite);
+	  pslab = slab;
 	}
 
       for(int j=0; j<m_width; j++, it++)
@@ -389,7 +404,7 @@ VolumeFileManager::setWidthSlice(int w, uchar *tmp)
       int slab = d/m_slabSize;
       if (pslab != slab)
 	{
-	  if (pslab > -1) m_qfile.close();
+	  if (m_qfile.isOpen()) m_qfile.close();
 
 	  if (slab < m_filenames.count())
 	    m_filename = m_filenames[slab];
@@ -399,6 +414,7 @@ VolumeFileManager::setWidthSlice(int w, uchar *tmp)
 
 	  m_qfile.setFileName(m_filename);
 	  m_qfile.open(QFile::ReadWrite);
+	  pslab = slab;
 	}
 
       m_qfile.seek((qint64)(m_header +
@@ -425,7 +441,7 @@ VolumeFileManager::setHeightSlice(int h, uchar *tmp)
       int slab = d/m_slabSize;
       if (pslab != slab)
 	{
-	  if (pslab > -1) m_qfile.close();
+	  if (m_qfile.isOpen()) m_qfile.close();
 
 	  if (slab < m_filenames.count())
 	    m_filename = m_filenames[slab];
@@ -435,6 +451,7 @@ VolumeFileManager::setHeightSlice(int h, uchar *tmp)
 
 	  m_qfile.setFileName(m_filename);
 	  m_qfile.open(QFile::ReadWrite);
+	  pslab = slab;
 	}
 
       for(int j=0; j<m_width; j++, it++)
@@ -794,11 +811,8 @@ VolumeFileManager::blockInterpolatedRawValue(float dv, float wv, float hv)
 }
 
 void
-VolumeFileManager::saveMemFile()
+VolumeFileManager::saveAllMemFile()
 {
-  if (!m_memmapped || !m_memChanged)
-    return;
-
   uchar vt;
   if (m_voxelType == _UChar) vt = 0; // unsigned byte
   if (m_voxelType == _Char) vt = 1; // signed byte
@@ -855,8 +869,278 @@ VolumeFileManager::saveMemFile()
     }
 
   progress.setValue(100);
+
+  if (m_qfile.isOpen())
+    m_qfile.close();
+}
+
+QString
+VolumeFileManager::slabFilename(int ns)
+{
+  if (ns < m_filenames.count())
+    return m_filenames[ns];
+
+  return m_baseFilename +
+    QString(".%1").arg(ns+1, 3, 10, QChar('0'));
+}
+
+QString
+VolumeFileManager::journalFilename()
+{
+  return slabFilename(0) + ".journal";
 }
 
+void
+VolumeFileManager::openJournal()
+{
+  if (!m_memmapped || m_journal.isOpen())
+    return;
+
+  m_journal.open(journalFilename(),
+		 m_depth, m_width, m_height,
+		 m_bytesPerVoxel);
+}
+
+void VolumeFileManager::beginEdit() { openJournal(); m_journal.beginEdit(); }
+void VolumeFileManager::endEdit() { m_journal.endEdit(); }
+int VolumeFileManager::undoSteps() { return m_journal.undoSteps(); }
+
+bool
+VolumeFileManager::undo()
+{
+  if (!m_memmapped || !m_journal.isOpen())
+    return false;
+
+  QList<EditJournal::Run> runs = m_journal.undo();
+  for(int i=0; i<runs.count(); i++)
+    {
+      memcpy(m_volData + runs[i].offset*m_bytesPerVoxel,
+	     runs[i].data.constData(),
+	     runs[i].data.size());
+      markDirty(runs[i].offset, runs[i].length);
+    }
+
+  if (runs.count() > 0)
+    m_memChanged = true;
+
+  return (runs.count() > 0);
+}
+
+void
+VolumeFileManager::resetChangedRange()
+{
+  m_changedMinD = m_depth;
+  m_changedMaxD = -1;
+}
+
+bool
+VolumeFileManager::changedRange(int& mind, int& maxd)
+{
+  mind = m_changedMinD;
+  maxd = m_changedMaxD;
+  return (mind <= maxd);
+}
+
+void
+VolumeFileManager::initDirty()
+{
+  qint64 rowBytes = (qint64)m_height*m_bytesPerVoxel;
+  m_rowsPerUnit = qMax((qint64)1, (1<<20)/qMax((qint64)1, rowBytes));
+  m_rowsPerUnit = qMin(m_rowsPerUnit, qMax(1, m_width));
+  m_unitsPerSlice = (m_width+m_rowsPerUnit-1)/m_rowsPerUnit;
+
+  m_dirty.fill(false, m_depth*m_unitsPerSlice);
+}
+
+void
+VolumeFileManager::markDirty(qint64 offset, qint64 nvox)
+{
+  if (nvox <= 0 || m_dirty.size() == 0)
+    return;
+
+  qint64 sliceVox = (qint64)m_width*m_height;
+  qint64 o0 = offset;
+  qint64 o1 = offset+nvox-1;
+  m_changedMinD = qMin(m_changedMinD, (int)(o0/sliceVox));
+  m_changedMaxD = qMax(m_changedMaxD, (int)(o1/sliceVox));
+
+  int u0 = (o0/sliceVox)*m_unitsPerSlice + ((o0%sliceVox)/m_height)/m_rowsPerUnit;
+  int u1 = (o1/sliceVox)*m_unitsPerSlice + ((o1%sliceVox)/m_height)/m_rowsPerUnit;
+  m_dirty.fill(true, u0, u1+1);
+}
+
+// copy nvox voxels into the volume, journalling the runs that change
+void
+VolumeFileManager::updateVoxels(qint64 offset, uchar *src, qint64 nvox)
+{
+  int bpv = m_bytesPerVoxel;
+  uchar *dst = m_volData + offset*bpv;
+
+  if (memcmp(dst, src, nvox*bpv) == 0)
+    return;
+
+  qint64 i = 0;
+  while (i < nvox)
+    {
+      if (memcmp(dst+i*bpv, src+i*bpv, bpv) == 0)
+	{
+	  i++;
+	  continue;
+	}
+
+      qint64 j = i+1;
+      while (j < nvox && memcmp(dst+j*bpv, src+j*bpv, bpv) != 0)
+	j++;
+
+      m_journal.addRun(offset+i, j-i, dst+i*bpv, src+i*bpv);
+      memcpy(dst+i*bpv, src+i*bpv, (j-i)*bpv);
+      markDirty(offset+i, j-i);
+
+      i = j;
+    }
+
+  m_memChanged = true;
+}
+
+bool
+VolumeFileManager::slabFilesValid()
+{
+  if (m_header != 13)
+    return false;
+
+  qint64 bps = (qint64)m_width*m_height*m_bytesPerVoxel;
+  int nslabs = m_depth/m_slabSize;
+  if (nslabs*m_slabSize < m_depth) nslabs++;
+  for(int ns=0; ns<nslabs; ns++)
+    {
+      int nslices = qMin(m_slabSize, m_depth-ns*m_slabSize);
+      QFileInfo fi(slabFilename(ns));
+      if (!fi.exists() || fi.size() != m_header + nslices*bps)
+	return false;
+    }
+
+  return true;
+}
+
+// contiguous dirty units within a slab file
+QList<VolumeFileManager::SaveChunk>
+VolumeFileManager::dirtyChunks()
+{
+  QList<SaveChunk> chunks;
+
+  qint64 rowBytes = (qint64)m_height*m_bytesPerVoxel;
+  qint64 bps = m_width*rowBytes;
+  int nunits = m_dirty.size();
+  int u = 0;
+  while (u < nunits)
+    {
+      if (!m_dirty.testBit(u))
+	{
+	  u++;
+	  continue;
+	}
+
+      int d = u/m_unitsPerSlice;
+      int slab = d/m_slabSize;
+      int ulast = qMin(nunits, (slab+1)*m_slabSize*m_unitsPerSlice);
+      int v = u+1;
+      while (v < ulast && m_dirty.testBit(v))
+	v++;
+
+      // byte range [b0, b1) in the volume
+      int d1 = (v-1)/m_unitsPerSlice;
+      int w0 = (u%m_unitsPerSlice)*m_rowsPerUnit;
+      int w1 = qMin(m_width, ((v-1)%m_unitsPerSlice + 1)*m_rowsPerUnit);
+      qint64 b0 = d*bps + w0*rowBytes;
+      qint64 b1 = d1*bps + w1*rowBytes;
+
+      SaveChunk chunk;
+      chunk.filename = slabFilename(slab);
+      chunk.offset = m_header + b0 - (qint64)slab*m_slabSize*bps;
+      chunk.data = QByteArray((char*)(m_volData + b0), b1-b0);
+      chunks << chunk;
+
+      m_dirty.fill(false, u, v);
+      u = v;
+    }
+
+  return chunks;
+}
+
+void
+VolumeFileManager::writeChunks(QList<SaveChunk> chunks,
+			       EditJournal *journal,
+			       qint64 journalPos)
+{
+  QFile fout;
+  for(int i=0; i<chunks.count(); i++)
+    {
+      if (fout.fileName() != chunks[i].filename)
+	{
+	  if (fout.isOpen()) fout.close();
+	  fout.setFileName(chunks[i].filename);
+	  fout.open(QFile::ReadWrite);
+	}
+      fout.seek(chunks[i].offset);
+      fout.write(chunks[i].data);
+    }
+  if (fout.isOpen())
+    fout.close();
+
+  // volume files now hold everything journalled before journalPos
+  if (journal)
+    journal->checkpoint(journalPos);
+}
+
+void
+VolumeFileManager::saveMemFile()
+{
+  if (!m_memmapped || !m_memChanged)
+    return;
+
+  waitForSave();
+
+  qint64 jpos = m_journal.flush();
+  if (slabFilesValid())
+    writeChunks(dirtyChunks(), &m_journal, jpos);
+  else
+    {
+      saveAllMemFile();
+      m_dirty.fill(false);
+      m_journal.checkpoint(jpos);
+    }
+
+  m_memChanged = false;
+}
+
+// write dirty regions on a worker thread, edits can continue
+// while it runs
+void
+VolumeFileManager::saveMemFileInBackground()
+{
+  if (!m_memmapped || !m_memChanged)
+    return;
+
+  // dirty regions are picked up by the next save
+  if (m_saveFuture.isRunning())
+    return;
+
+  if (!slabFilesValid())
+    {
+      saveMemFile();
+      return;
+    }
+
+  qint64 jpos = m_journal.flush();
+  QList<SaveChunk> chunks = dirtyChunks();
+  m_memChanged = false;
+
+  m_saveFuture = QtConcurrent::run(VolumeFileManager::writeChunks,
+				   chunks, &m_journal, jpos);
+}
+
+void VolumeFileManager::waitForSave() { m_saveFuture.waitForFinished(); }
+
 void
 VolumeFileManager::loadMemFile()
 {
@@ -909,6 +1193,29 @@ VolumeFileManager::loadMemFile()
   progress.setValue(100);
 
   m_memChanged = false;
+
+  //--------
+  // apply edits that did not make it to the volume files
+  if (QFile::exists(journalFilename()))
+    {
+      openJournal();
+      QList<EditJournal::Run> runs = m_journal.recover();
+      for(int i=0; i<runs.count(); i++)
+	{
+	  memcpy(m_volData + runs[i].offset*m_bytesPerVoxel,
+		 runs[i].data.constData(),
+		 runs[i].data.size());
+	  markDirty(runs[i].offset, runs[i].length);
+	}
+      if (runs.count() > 0)
+	{
+	  m_memChanged = true;
+	  QMessageBox::information(0, "Recovered edits",
+				   QString("Recovered %1 unsaved edits for\n%2").\
+				   arg(runs.count()).arg(m_baseFilename));
+	}
+    }
+  //--------
 }
 
 void
@@ -921,6 +1228,8 @@ VolumeFileManager::createMemFile()
   vsize *= m_depth;
   m_volData = new uchar[vsize];
   memset(m_volData, 0, vsize);
+
+  initDirty();
 }
 
 uchar*
@@ -949,33 +1258,11 @@ VolumeFileManager::setSliceMem(int d, uchar *tmp)
       return;
     }    
 
-  qint64 bps = m_width*m_height*m_bytesPerVoxel;
-  memcpy(m_volData+d*bps, tmp, bps);
-
-  //--------
-  // save to file straight away
-  QString pflnm = m_filename;
-  m_slabno = d/m_slabSize;
-  if (m_slabno < m_filenames.count())
-    m_filename = m_filenames[m_slabno];
-  else
-    m_filename = m_baseFilename +
-                 QString(".%1").arg(m_slabno+1, 3, 10, QChar('0'));
-
-  if (pflnm != m_filename ||
-      !m_qfile.isOpen() ||
-      !m_qfile.isWritable())
-    {
-      if (m_qfile.isOpen()) m_qfile.close();
-      m_qfile.setFileName(m_filename);
-      m_qfile.open(QFile::ReadWrite);
-    }
-  m_qfile.seek((qint64)(m_header + (d-m_slabno*m_slabSize)*bps));
-  m_qfile.write((char*)tmp, bps);
-  m_qfile.close();
-  //--------
-
-  m_memChanged = true;
+  // changes go to the journal, volume files are written by saveMemFile
+  qint64 sliceVox = (qint64)m_width*m_height;
+  beginEdit();
+  updateVoxels(d*sliceVox, tmp, sliceVox);
+  endEdit();
 }
 
 uchar*
@@ -1007,13 +1294,13 @@ VolumeFileManager::setWidthSliceMem(int w, uchar *tmp)
       return;
     }    
 
-  qint64 bps = m_width*m_height*m_bytesPerVoxel;
+  qint64 sliceVox = (qint64)m_width*m_height;
+  beginEdit();
   for(int d=0; d<m_depth; d++)
-    memcpy(m_volData + d*bps + w*m_height*m_bytesPerVoxel,
-	   tmp + d*m_height*m_bytesPerVoxel,
-	   m_height*m_bytesPerVoxel);
-
-  m_memChanged = true;
+    updateVoxels(d*sliceVox + (qint64)w*m_height,
+		 tmp + d*m_height*m_bytesPerVoxel,
+		 m_height);
+  endEdit();
 }
 
 uchar*
@@ -1049,17 +1336,17 @@ VolumeFileManager::setHeightSliceMem(int h, uchar *tmp)
       return;
     }    
 
-  qint64 bps = m_width*m_height*m_bytesPerVoxel;
+  qint64 sliceVox = (qint64)m_width*m_height;
   int it = 0;
+  beginEdit();
   for(int d=0; d<m_depth; d++)
     {
       for(int j=0; j<m_width; j++, it++)
-	memcpy(m_volData + d*bps + (j*m_height + h)*m_bytesPerVoxel,
-	       tmp + it*m_bytesPerVoxel,
-	       m_bytesPerVoxel);
+	updateVoxels(d*sliceVox + (qint64)j*m_height + h,
+		     tmp + it*m_bytesPerVoxel,
+		     1);
     }
-
-  m_memChanged = true;
+  endEdit();
 }
 
 uchar*
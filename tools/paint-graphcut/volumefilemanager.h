@@ -6,6 +6,10 @@
 #include <QProgressDialog>
 #include <QStringList>
 #include <QFile>
+#include <QBitArray>
+#include <QFuture>
+
+#include "editjournal.h"
 
 class VolumeFileManager
 {
@@ -68,6 +72,8 @@ class VolumeFileManager
 
   void loadMemFile();
   void saveMemFile();
+  void saveMemFileInBackground();
+  void waitForSave();
   uchar* getSliceMem(int);
   void setSliceMem(int, uchar*);
   uchar* getWidthSliceMem(int);
@@ -78,7 +84,24 @@ class VolumeFileManager
 
   uchar* memVolDataPtr() { return m_volData; }
 
+  // edits between beginEdit and endEdit are undone together
+  void beginEdit();
+  void endEdit();
+  bool undo();
+  int undoSteps();
+
+  // depth slices modified since resetChangedRange
+  void resetChangedRange();
+  bool changedRange(int&, int&);
+
  private :
+  struct SaveChunk
+  {
+    QString filename;
+    qint64 offset;
+    QByteArray data;
+  };
+
   bool m_memmapped;
   bool m_memChanged;
   QString m_baseFilename;
@@ -97,9 +120,30 @@ class VolumeFileManager
 
   uchar *m_volData;
 
+  // dirty units of m_rowsPerUnit rows of a depth slice
+  QBitArray m_dirty;
+  int m_rowsPerUnit, m_unitsPerSlice;
+  int m_changedMinD, m_changedMaxD;
+
+  EditJournal m_journal;
+  QFuture<void> m_saveFuture;
+
   void readBlocks(int);
 
   void createMemFile();  
+
+  QString slabFilename(int);
+  QString journalFilename();
+  void openJournal();
+
+  void initDirty();
+  void markDirty(qint64, qint64);
+  void updateVoxels(qint64, uchar*, qint64);
+
+  bool slabFilesValid();
+  void saveAllMemFile();
+  QList<SaveChunk> dirtyChunks();
+  static void writeChunks(QList<SaveChunk>, EditJournal*, qint64);
 };
 
 #endif
@@ -7,7 +7,7 @@ VolumeMask::VolumeMask()
   m_maskfile.clear();
   m_maskslice = 0;
   m_depth = m_width = m_height = 0;
-  m_bitmask.clear();
+  m_editDepth = 0;
 }
 
 VolumeMask::~VolumeMask()
@@ -28,13 +28,55 @@ VolumeMask::reset()
   m_maskslice = 0;
   m_depth = m_width = m_height = 0;
 
-  m_bitmask.clear();
+  m_bitmask.resize(0, 0, 0);
 }
 
 void
 VolumeMask::saveIntermediateResults()
 {
-  m_maskFileManager.saveMemFile();
+  m_maskFileManager.saveMemFileInBackground();
+}
+
+bool
+VolumeMask::undo()
+{
+  m_maskFileManager.resetChangedRange();
+  if (!m_maskFileManager.undo())
+    return false;
+
+  m_maskFileManager.saveMemFileInBackground();
+
+  int mind, maxd;
+  if (m_maskFileManager.changedRange(mind, maxd))
+    emit maskChanged(mind, maxd);
+
+  return true;
+}
+
+// edits may nest, the outermost one forms the undo group
+void
+VolumeMask::beginEdit()
+{
+  if (m_editDepth == 0)
+    m_maskFileManager.resetChangedRange();
+  m_editDepth++;
+  m_maskFileManager.beginEdit();
+}
+
+// changed regions are written to the mask file in the background
+void
+VolumeMask::endEdit()
+{
+  m_maskFileManager.endEdit();
+  m_editDepth = qMax(0, m_editDepth-1);
+  if (m_editDepth > 0)
+    return;
+
+  m_maskFileManager.saveMemFileInBackground();
+
+  int mind, maxd;
+  if (m_maskFileManager.changedRange(mind, maxd))
+    emit maskChanged(mind, maxd);
 }
 
 void
@@ -56,7 +98,7 @@ VolumeMask::setGridSize(int d, int w, int h, int slabsize)
   m_width = w;
   m_height= h;  
   
-  m_bitmask.resize(m_depth*m_width*m_height);
+  m_bitmask.resize(m_depth, m_width, m_height);
 
   m_maskFileManager.setDepth(m_depth);
   m_maskFileManager.setWidth(m_width);
@@ -175,7 +217,9 @@ void
 VolumeMask::setMaskDepthSlice(int slc, uchar* tagData)
 {
   checkMaskFile();
+  beginEdit();
   m_maskFileManager.setSliceMem(slc, tagData);
+  endEdit();
 }
 
 uchar*
@@ -269,7 +313,9 @@ VolumeMask::tagDSlice(int d, QBitArray bitmask, uchar *usermask)
 	idx ++;
       }
   
+  beginEdit();
   m_maskFileManager.setSliceMem(d, mask);
+  endEdit();
   delete [] mask;
 }
 
@@ -283,6 +329,7 @@ VolumeMask::tagWSlice(int w, QBitArray bitmask, uchar *usermask)
   int tag = Global::tag();
   qint64 bidx = 0;
 
+  beginEdit();
   for(int d=0; d<m_depth; d++)
     {
       uchar *mslice = m_maskFileManager.getSliceMem(d);      
@@ -301,6 +348,7 @@ VolumeMask::tagWSlice(int w, QBitArray bitmask, uchar *usermask)
   
       m_maskFileManager.setSliceMem(d, mask);
     }
+  endEdit();
 
   delete [] mask;
 }
@@ -315,6 +363,7 @@ VolumeMask::tagHSlice(int h, QBitArray bitmask, uchar *usermask)
   int tag = Global::tag();
   qint64 bidx = 0;
 
+  beginEdit();
   for(int d=0; d<m_depth; d++)
     {
       uchar *mslice = m_maskFileManager.getSliceMem(d);      
@@ -333,6 +382,7 @@ VolumeMask::tagHSlice(int h, QBitArray bitmask, uchar *usermask)
   
       m_maskFileManager.setSliceMem(d, mask);
     }
+  endEdit();
 
   delete [] mask;
 }
@@ -345,20 +395,26 @@ VolumeMask::tagDSlice(int d, uchar *tags)
   int nbytes = m_width*m_height;
   uchar *mask = new uchar[nbytes];
   memcpy(mask, tags, nbytes);
+  beginEdit();
   m_maskFileManager.setSliceMem(d, mask);
+  endEdit();
   delete [] mask;
 }
 void
 VolumeMask::tagWSlice(int w, uchar *tags)
 {
   checkMaskFile();
+  beginEdit();
   m_maskFileManager.setWidthSliceMem(w, tags);
+  endEdit();
 }
 void
 VolumeMask::tagHSlice(int h, uchar *tags)
 {
   checkMaskFile();
+  beginEdit();
   m_maskFileManager.setHeightSliceMem(h, tags);
+  endEdit();
 }
 
 
@@ -381,6 +437,7 @@ VolumeMask::tagUsingBitmask(QList<int> pos,
   int tag = Global::tag();
 
   qint64 bidx = 0;
+  beginEdit();
   for(int d=0; d<m_depth; d++)
     {
       emit progressChanged((int)(100.0*(float)d/(float)m_depth));
@@ -404,6 +461,7 @@ VolumeMask::tagUsingBitmask(QList<int> pos,
 
       m_maskFileManager.setSliceMem(d, mask);
     }
+  endEdit();
   
   delete [] mask;
 
@@ -413,56 +471,12 @@ VolumeMask::tagUsingBitmask(QList<int> pos,
 void
 VolumeMask::dilate(QBitArray vbitmask)
 {
-  createBitmask();
-
-  //int thickness = Global::spread();
-  int thickness = 1;
-  while (thickness > 0)
-    {
-      dilateBitmask();
-      thickness --;
-    }
-
-  // m_bitmask now contains region dilated by thickness
-
-//  QProgressDialog progress("Updating Mask",
-//			   "Cancel",
-//			   0, 100,
-//			   0);
-
-  int nbytes = m_width*m_height;
-  unsigned char *mask = new unsigned char[nbytes];
-
-  qint64 bidx = 0;
-  for(int d=0; d<m_depth; d++)
-    { 
-      emit progressChanged((int)(100.0*(float)d/(float)m_depth));
-      qApp->processEvents();
-      
-      uchar *mslice = m_maskFileManager.getSliceMem(d);      
-      memcpy(mask, mslice, nbytes);
-
-      for(int w=0; w<m_width; w++)
-	for(int h=0; h<m_height; h++)
-	  {
-	    if ( vbitmask.testBit(bidx) &&
-		m_bitmask.testBit(bidx))
-	      {
-		qint64 idx = (w*m_height + h);
-		mask[idx] = Global::tag();
-	      }
-	    bidx++;
-	  }
- 
-      m_maskFileManager.setSliceMem(d, mask);
-    }
-
-  delete [] mask;
-
-  emit progressReset();
+  dilate(0, m_depth-1,
+	 0, m_width-1,
+	 0, m_height-1,
+	 vbitmask);
 }
 
-
 void
 VolumeMask::dilate(int mind, int maxd,
 		   int minw, int maxw,
@@ -471,110 +485,30 @@ VolumeMask::dilate(int mind, int maxd,
 {
   createBitmask();
 
+  BitVolume tagged = m_bitmask;
+
   //int thickness = Global::spread();
   int thickness = 1;
-  while (thickness > 0)
-    {
-      dilateBitmask(mind, maxd,
-		    minw, maxw,
-		    minh, maxh);
-      thickness --;
-    }
+  BitMorphology::dilate(m_bitmask, thickness, 26,
+			mind, maxd,
+			minw, maxw,
+			minh, maxh);
 
   // m_bitmask now contains region dilated by thickness
-
-//  QProgressDialog progress("Updating Mask",
-//			   "Cancel",
-//			   0, 100,
-//			   0);
-
-  int nbytes = m_width*m_height;
-  unsigned char *mask = new unsigned char[nbytes];
-
-  for(int d=mind; d<=maxd; d++)
-    { 
-      emit progressChanged((int)(100.0*(float)d/(float)m_depth));
-      qApp->processEvents();
-      
-      uchar *mslice = m_maskFileManager.getSliceMem(d);      
-      memcpy(mask, mslice, nbytes);
-
-      for(int w=minw; w<=maxw; w++)
-	for(int h=minh; h<=maxh; h++)
-	  {
-	    qint64 bidx = (d*m_width*m_height +
-			   w*m_height + h);
-	    if ( vbitmask.testBit(bidx) &&
-		m_bitmask.testBit(bidx))
-	      {
-		qint64 idx = (w*m_height + h);
-		mask[idx] = Global::tag();
-	      }
-	  }
-
-      m_maskFileManager.setSliceMem(d, mask);
-    }
-
-  delete [] mask;
-
-  emit progressReset();
+  updateMask(tagged,
+	     mind, maxd,
+	     minw, maxw,
+	     minh, maxh,
+	     vbitmask, true);
 }
 
-
 void
 VolumeMask::erode(QBitArray vbitmask)
 {
-  createBitmask();
-
-  //int thickness = Global::spread();
-  int thickness = 1;
-  while (thickness > 0)
-    {
-      erodeBitmask();
-      thickness --;
-    }
-
-  // m_bitmask now contains region eroded by thickness
-
-//  QProgressDialog progress("Updating Mask",
-//			   "Cancel",
-//			   0, 100,
-//			   0);
-
-  int nbytes = m_width*m_height;
-  unsigned char *mask = new unsigned char[nbytes];
-
-  qint64 bidx = 0;
-  for(int d=0; d<m_depth; d++)
-    { 
-      emit progressChanged((int)(100.0*(float)d/(float)m_depth));
-      qApp->processEvents();
-      
-      uchar *mslice = m_maskFileManager.getSliceMem(d);      
-      memcpy(mask, mslice, nbytes);
-
-      for(int w=0; w<m_width; w++)
-	for(int h=0; h<m_height; h++)
-	  {	    
-	    if (  vbitmask.testBit(bidx) &&
-		!m_bitmask.testBit(bidx))
-	      {
-		// reset mask to 0 if the
-		// mask value is same as supplied tag value
-		qint64 idx = (w*m_height + h);
-		if ( mask[idx] == Global::tag())
-		  mask[idx] = 0;
-	      }
-
-	    bidx++;
-	  }
-
-      m_maskFileManager.setSliceMem(d, mask);
-    }
-
-  delete [] mask;
-
-  emit progressReset();
+  erode(0, m_depth-1,
+	0, m_width-1,
+	0, m_height-1,
+	vbitmask);
 }
 
 void
@@ -585,92 +519,101 @@ VolumeMask::erode(int mind, int maxd,
 {
   createBitmask();
 
+  BitVolume tagged = m_bitmask;
+
   //int thickness = Global::spread();
   int thickness = 1;
-  while (thickness > 0)
-    {
-      erodeBitmask(mind, maxd,
-		   minw, maxw,
-		   minh, maxh);
-      thickness --;
-    }
+  BitMorphology::erode(m_bitmask, thickness, 26,
+		       mind, maxd,
+		       minw, maxw,
+		       minh, maxh);
 
   // m_bitmask now contains region eroded by thickness
+  updateMask(tagged,
+	     mind, maxd,
+	     minw, maxw,
+	     minh, maxh,
+	     vbitmask, false);
+}
 
-//  QProgressDialog progress("Updating Mask",
-//			   "Cancel",
-//			   0, 100,
-//			   0);
-
+void
+VolumeMask::updateMask(const BitVolume& tagged,
+		       int mind, int maxd,
+		       int minw, int maxw,
+		       int minh, int maxh,
+		       QBitArray vbitmask,
+		       bool grow)
+{
+  // only voxels that differ between tagged and m_bitmask
+  // are visited and only modified slices are written back
   int nbytes = m_width*m_height;
   unsigned char *mask = new unsigned char[nbytes];
+  int wpr = m_bitmask.wordsPerRow();
+  uchar tag = Global::tag();
 
+  mind = qMax(mind, 0);  maxd = qMin(maxd, m_depth-1);
+  minw = qMax(minw, 0);  maxw = qMin(maxw, m_width-1);
+  minh = qMax(minh, 0);  maxh = qMin(maxh, m_height-1);
+
+  beginEdit();
   for(int d=mind; d<=maxd; d++)
     { 
-      emit progressChanged((int)(100.0*(float)d/(float)m_depth));
-      qApp->processEvents();
-      
-      uchar *mslice = m_maskFileManager.getSliceMem(d);      
-      memcpy(mask, mslice, nbytes);
+      if (d%16 == 0)
+	{
+	  emit progressChanged((int)(100.0*(float)d/(float)m_depth));
+	  qApp->processEvents();
+	}
 
+      bool loaded = false;
+      bool changed = false;
       for(int w=minw; w<=maxw; w++)
-	for(int h=minh; h<=maxh; h++)
-	  {
-	    qint64 bidx = (d*m_width*m_height +
-			w*m_height + h);	    
-	    if (  vbitmask.testBit(bidx) &&
-		!m_bitmask.testBit(bidx))
-	      {
-		// reset mask to 0 if the
-		// mask value is same as supplied tag value
-		qint64 idx = (w*m_height + h);
-		if ( mask[idx] == Global::tag())
-		  mask[idx] = 0;
-	      }
-	  }
-
-      m_maskFileManager.setSliceMem(d, mask);
-    }
-
-  delete [] mask;
-
-  emit progressReset();
-}
-
-void
-VolumeMask::createBitmask()
-{
-  checkMaskFile();
+	{
+	  const quint64 *t = tagged.constRow(d, w);
+	  const quint64 *b = m_bitmask.constRow(d, w);
+	  for(int i=0; i<wpr; i++)
+	    {
+	      // grow : newly added voxels, shrink : removed voxels
+	      quint64 diff = (grow ? b[i] & ~t[i] : t[i] & ~b[i]);
+	      if (!diff)
+		continue;
 
-  m_bitmask.fill(false);
+	      if (!loaded)
+		{
+		  uchar *mslice = m_maskFileManager.getSliceMem(d);      
+		  memcpy(mask, mslice, nbytes);
+		  loaded = true;
+		}
 
-//  QProgressDialog progress("Identifying Tagged Region",
-//			   "Cancel",
-//			   0, 100,
-//			   0);
+	      for(int k=0; k<64; k++)
+		{
+		  if (!((diff >> k) & 1))
+		    continue;
 
-  int nbytes = m_width*m_height;
-  unsigned char *mask = new unsigned char[nbytes];
+		  int h = i*64 + k;
+		  if (h < minh || h > maxh)
+		    continue;
 
-  qint64 bidx = 0;
-  for(int d=0; d<m_depth; d++)
-    {
-      emit progressChanged((int)(100.0*(float)d/(float)m_depth));
-      qApp->processEvents();
-      
-      uchar *mslice = m_maskFileManager.getSliceMem(d);      
-      memcpy(mask, mslice, nbytes);
-
-      for(int w=0; w<m_width; w++)
-	for(int h=0; h<m_height; h++)
-	  {
-	    qint64 idx = (w*m_height + h);
-	    if (mask[idx] == Global::tag())
-	      m_bitmask.setBit(bidx);
+		  qint64 bidx = ((qint64)d*m_width*m_height +
+				 w*m_height + h);
+		  if (vbitmask.testBit(bidx))
+		    {
+		      qint64 idx = (w*m_height + h);
+		      if (grow)
+			mask[idx] = tag;
+		      else if (mask[idx] == tag)
+			// reset mask to 0 if the
+			// mask value is same as supplied tag value
+			mask[idx] = 0;
+		      changed = true;
+		    }
+		}
+	    }
+	}
 
-	    bidx++;
-	  }
+      if (changed)
+	m_maskFileManager.setSliceMem(d, mask);
     }
+  endEdit();
 
   delete [] mask;
 
@@ -678,274 +621,104 @@ VolumeMask::createBitmask()
 }
 
 void
-VolumeMask::dilateBitmask()
+VolumeMask::createBitmask()
 {
-//  QProgressDialog progress("Dilating Tag Mask",
-//			   "Cancel",
-//			   0, 100,
-//			   0);
+  checkMaskFile();
 
-  QBitArray bitcopy = m_bitmask;
-  m_bitmask.fill(false);
+  uchar tag = Global::tag();
 
-  qint64 bidx = 0;
-  for(int d=0; d<m_depth; d++)
+  uchar *vol = memMaskDataPtr();
+  if (vol && m_maskFileManager.isMemMapped())
     {
-      emit progressChanged((int)(100.0*(float)d/(float)m_depth));
-      qApp->processEvents();
-
-      for(int w=0; w<m_width; w++)
-	for(int h=0; h<m_height; h++)
-	  {
-	    if (bitcopy.testBit(bidx))
-	      {
-		int d0 = qMax(d-1, 0);
-		int d1 = qMin(d+1, m_depth-1);
-		int w0 = qMax(w-1, 0);
-		int w1 = qMin(w+1, m_width-1);
-		int h0 = qMax(h-1, 0);
-		int h1 = qMin(h+1, m_height-1);
-
-		for(int d2=d0; d2<=d1; d2++)
-		  for(int w2=w0; w2<=w1; w2++)
-		    for(int h2=h0; h2<=h1; h2++)
-		      {
-			qint64 idx = d2*m_width*m_height +
-			             w2*m_height + h2;
-			m_bitmask.setBit(idx);
-		      }
-	      }
-	    bidx ++;	   
-	  }
+      m_bitmask.fromMask(vol, tag);
+      return;
     }
 
-  emit progressReset();
-}
-
-void
-VolumeMask::dilateBitmask(int mind, int maxd,
-			  int minw, int maxw,
-			  int minh, int maxh)
-{
-//  QProgressDialog progress("Dilating Tag Mask",
-//			   "Cancel",
-//			   0, 100,
-//			   0);
-
-  QBitArray bitcopy = m_bitmask;
   m_bitmask.fill(false);
 
-  for(int d=mind; d<=maxd; d++)
-    {
-      emit progressChanged((int)(100.0*(float)d/(float)m_depth));
-      qApp->processEvents();
-
-      for(int w=minw; w<=maxw; w++)
-	for(int h=minh; h<=maxh; h++)
-	  {
-	    qint64 bidx = (d*m_width*m_height +
-			   w*m_height + h);
-	    if (bitcopy.testBit(bidx))
-	      {
-		int d0 = qMax(d-1, mind);
-		int d1 = qMin(d+1, maxd);
-		int w0 = qMax(w-1, minw);
-		int w1 = qMin(w+1, maxw);
-		int h0 = qMax(h-1, minh);
-		int h1 = qMin(h+1, maxh);
-
-		for(int d2=d0; d2<=d1; d2++)
-		  for(int w2=w0; w2<=w1; w2++)
-		    for(int h2=h0; h2<=h1; h2++)
-		      {
-			qint64 idx = d2*m_width*m_height +
-			             w2*m_height + h2;
-			m_bitmask.setBit(idx);
-		      }
-	      }
-	    bidx ++;
-	    
-	  }
-    }
-
-  emit progressReset();
-}
-
-void
-VolumeMask::erodeBitmask()
-{
-//  QProgressDialog progress("Eroding Tag Mask",
-//			   "Cancel",
-//			   0, 100,
-//			   0);
-
-  QBitArray bitcopy = m_bitmask;
-
-  qint64 bidx = 0;
+  int nbytes = m_width*m_height;
   for(int d=0; d<m_depth; d++)
     {
       emit progressChanged((int)(100.0*(float)d/(float)m_depth));
       qApp->processEvents();
-
+      
+      uchar *mslice = m_maskFileManager.getSliceMem(d);      
       for(int w=0; w<m_width; w++)
-	for(int h=0; h<m_height; h++)
-	  {
-	    if (bitcopy.testBit(bidx))
-	      {
-		int d0 = qMax(d-1, 0);
-		int d1 = qMin(d+1, m_depth-1);
-		int w0 = qMax(w-1, 0);
-		int w1 = qMin(w+1, m_width-1);
-		int h0 = qMax(h-1, 0);
-		int h1 = qMin(h+1, m_height-1);
-
-		bool ok = true;
-		for(int d2=d0; d2<=d1; d2++)
-		  for(int w2=w0; w2<=w1; w2++)
-		    for(int h2=h0; h2<=h1; h2++)
-		      {
-			qint64 idx = d2*m_width*m_height +
-			             w2*m_height + h2;
-			ok &= bitcopy.testBit(idx);
-		      }
-
-		if (!ok) // surface voxel
-		  m_bitmask.setBit(bidx, false); // set bit to 0
-	      }
-	    bidx ++;
-	    
-	  }
+	{
+	  quint64 *r = m_bitmask.row(d, w);
+	  uchar *m = mslice + w*m_height;
+	  for(int h=0; h<m_height; h++)
+	    if (m[h] == tag)
+	      r[h/64] |= 1ULL << (h%64);
+	}
     }
 
   emit progressReset();
 }
 
 void
-VolumeMask::erodeBitmask(int mind, int maxd,
-			 int minw, int maxw,
-			 int minh, int maxh)
+VolumeMask::findConnectedRegion(QList<int> pos)
 {
-//  QProgressDialog progress("Eroding Tag Mask",
-//			   "Cancel",
-//			   0, 100,
-//			   0);
+  // region grows from the seeds through voxels of m_bitmask
+  // with mask value equal to tag, or unmasked voxels when
+  // tag is nonzero, or masked voxels when tag is zero
+  uchar tag = Global::tag();
 
-  QBitArray bitcopy = m_bitmask;
+  BitVolume region;
+  region.resize(m_depth, m_width, m_height);
 
-  for(int d=mind; d<=maxd; d++)
+  BitVolume domain;
+  domain.resize(m_depth, m_width, m_height);
+  if (tag == 0)
+    domain = m_bitmask;
+  else
     {
-      emit progressChanged((int)(100.0*(float)d/(float)m_depth));
-      qApp->processEvents();
-
-      for(int w=minw; w<=maxw; w++)
-	for(int h=minh; h<=maxh; h++)
-	  {
-	    qint64 bidx = (d*m_width*m_height +
-			   w*m_height + h);
-	    if (bitcopy.testBit(bidx))
-	      {
-		int d0 = qMax(d-1, mind);
-		int d1 = qMin(d+1, maxd);
-		int w0 = qMax(w-1, minw);
-		int w1 = qMin(w+1, maxw);
-		int h0 = qMax(h-1, minh);
-		int h1 = qMin(h+1, maxh);
-
-		bool ok = true;
-		for(int d2=d0; d2<=d1; d2++)
-		  for(int w2=w0; w2<=w1; w2++)
-		    for(int h2=h0; h2<=h1; h2++)
-		      {
-			qint64 idx = d2*m_width*m_height +
-			             w2*m_height + h2;
-			ok &= bitcopy.testBit(idx);
-		      }
-
-		if (!ok) // surface voxel
-		  m_bitmask.setBit(bidx, false); // set bit to 0
-	      }
-	    
-	  }
+      for(int d=0; d<m_depth; d++)
+	{
+	  uchar *mslice = m_maskFileManager.getSliceMem(d);
+	  for(int w=0; w<m_width; w++)
+	    {
+	      const quint64 *b = m_bitmask.constRow(d, w);
+	      quint64 *r = domain.row(d, w);
+	      uchar *m = mslice + w*m_height;
+	      for(int i=0; i<m_bitmask.wordsPerRow(); i++)
+		{
+		  if (!b[i])
+		    continue;
+		  int h0 = i*64;
+		  int h1 = qMin(m_height, h0+64);
+		  quint64 v = 0;
+		  for(int h=h0; h<h1; h++)
+		    if (m[h] == tag || m[h] == 0)
+		      v |= 1ULL << (h-h0);
+		  r[i] = v & b[i];
+		}
+	    }
+	}
     }
 
-  emit progressReset();
-}
-
-void
-VolumeMask::findConnectedRegion(QList<int> pos)
-{
-  QBitArray bitcopy = m_bitmask;
-  m_bitmask.fill(false);
-
-
-  QStack<int> stack;
-
   // put the seeds in
   for(int pi=0; pi<pos.size()/3; pi++)
     {
       int d = pos[3*pi];
       int w = pos[3*pi+1];
       int h = pos[3*pi+2];
-      qint64 idx = d*m_width*m_height + w*m_height + h;
-      if (bitcopy.testBit(idx))
+      if (m_bitmask.testBit(d, w, h))
 	{
-	  uchar mask;
+	  uchar mask = 0;
 	  uchar *mslice = m_maskFileManager.rawValueMem(d, w, h);
 	  if (mslice)
 	    mask = mslice[0];
 	  
-	  if (mask != Global::tag())
+	  if (mask != tag)
 	    {
-	      m_bitmask.setBit(idx);
-	      stack.push(d);
-	      stack.push(w);
-	      stack.push(h);
+	      region.setBit(d, w, h);
+	      domain.setBit(d, w, h);
 	    }
 	}
     }
 
-  uchar tag = Global::tag();
-  while(!stack.isEmpty())
-    {
-      int h = stack.pop();
-      int w = stack.pop();
-      int d = stack.pop();
-      qint64 idx = d*m_width*m_height + w*m_height + h;
-      if (bitcopy.testBit(idx))
-	{
-	  int d0 = qMax(d-1, 0);
-	  int d1 = qMin(d+1, m_depth-1);
-	  int w0 = qMax(w-1, 0);
-	  int w1 = qMin(w+1, m_width-1);
-	  int h0 = qMax(h-1, 0);
-	  int h1 = qMin(h+1, m_height-1);
-	      
-	  for(int d2=d0; d2<=d1; d2++)
-	    for(int w2=w0; w2<=w1; w2++)
-	      for(int h2=h0; h2<=h1; h2++)
-		{
-		  uchar mask;
-		  qint64 idx = d2*m_width*m_height +
-		               w2*m_height + h2;
-		  uchar *mslice = m_maskFileManager.rawValueMem(d2, w2, h2);
-		  if (mslice)
-		    mask = mslice[0];
-
-		  if (tag == mask ||
-		      (tag && !mask) ||
-		      (!tag && mask) )
-		    {
-		      if (   bitcopy.testBit(idx) &&
-			  !m_bitmask.testBit(idx) )
-			{
-			  m_bitmask.setBit(idx);
-			  stack.push(d2);
-			  stack.push(w2);
-			  stack.push(h2);
-			}
-		    }
-		}
-	}
-    } // end find connected
-  //------------------------------------------------------
+  BitMorphology::reconstruct(region, domain, 26);
+
+  m_bitmask = region;
 }
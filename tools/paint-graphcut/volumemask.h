@@ -2,6 +2,7 @@
 #define VOLUMEMASK_H
 
 #include "volumefilemanager.h"
+#include "bitmorphology.h"
 
 class VolumeMask : public QObject
 {
@@ -16,6 +17,10 @@ class VolumeMask : public QObject
   void setGridSize(int, int, int, int);
 
   void saveIntermediateResults();
+  bool undo();
+
+  void beginEdit();
+  void endEdit();
 
   uchar* getMaskDepthSliceImage(int);
   uchar* getMaskWidthSliceImage(int);
@@ -53,6 +58,7 @@ class VolumeMask : public QObject
  signals :
   void progressChanged(int);
   void progressReset();
+  void maskChanged(int, int);
 
  private:
   VolumeFileManager m_maskFileManager;
@@ -60,18 +66,16 @@ class VolumeMask : public QObject
   int m_depth, m_width, m_height;
 
   uchar* m_maskslice;
-  QBitArray m_bitmask;
+  int m_editDepth;
+  BitVolume m_bitmask;
 
   void checkMaskFile();
   void createBitmask();
-  void dilateBitmask();
-  void dilateBitmask(int, int,
-		     int, int,
-		     int, int);
-  void erodeBitmask();
-  void erodeBitmask(int, int,
-		    int, int,
-		    int, int);
+  void updateMask(const BitVolume&,
+		  int, int,
+		  int, int,
+		  int, int,
+		  QBitArray, bool);
   void findConnectedRegion(QList<int>);
 };
 